@@ -0,0 +1,1002 @@
+/*
+ * wtree3_bench.c - Workload benchmarks for wtree3 against raw LMDB
+ *
+ * Every case runs twice on a fresh environment: once through the wtree3
+ * API and once as the equivalent hand-written mdb_* code (index entries
+ * maintained by hand in DUPSORT databases), so the difference between the
+ * two rows is the library's overhead.
+ *
+ * Workloads:
+ * - get, get_many                point and batched lookups
+ * - insert, upsert               auto-txn writes with 0/1/4/8 indexes
+ * - scan_range, scan_prefix,     one read txn per op, ~BENCH_SCAN_LEN entries
+ *   scan_reverse
+ * - delete_if                    one write txn per op, half of a key window
+ * - index_build                  one op builds an index over the whole tree
+ *
+ * Sweeps value size, key distribution (sequential, uniform, scrambled
+ * zipfian) and thread count. Each row reports ops/s, p50/p99/p999 latency,
+ * the user bytes written and how much the data file grew. Runs are
+ * reproducible for a given --seed.
+ *
+ * Preloaded keys use even ids, inserted keys odd ids, so inserts never
+ * collide with the preload. Keys are 8-byte big-endian ids; index j keys
+ * on the 2 bytes at value offset 2*j.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+    #include <process.h>
+    #define mkdir(path, mode) _mkdir(path)
+    #define getpid() _getpid()
+    #define strtok_r strtok_s
+#else
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "wtree3.h"
+#include "wthread.h"
+
+/* ============================================================
+ * Constants
+ * ============================================================ */
+
+#define BENCH_MAX_INDEXES   8
+#define BENCH_MAX_SWEEP     8
+#define BENCH_MAX_THREADS   64
+#define BENCH_SCAN_LEN      100         /* Entries per scan / delete_if window */
+#define BENCH_MANY_BATCH    64          /* Keys per get_many */
+#define BENCH_PRELOAD_TXN   10000       /* Preload entries per commit */
+#define BENCH_KEY_LEN       8
+#define BENCH_FIELD_LEN     2
+#define BENCH_ZIPF_THETA    0.99
+
+/* ============================================================
+ * Configuration
+ * ============================================================ */
+
+typedef enum {
+    DIST_SEQ,
+    DIST_UNIFORM,
+    DIST_ZIPF,
+    DIST_COUNT
+} bench_dist_t;
+
+typedef enum {
+    IMPL_WTREE3,
+    IMPL_LMDB,
+    IMPL_COUNT
+} bench_impl_t;
+
+typedef enum {
+    W_GET,
+    W_GET_MANY,
+    W_INSERT,
+    W_UPSERT,
+    W_SCAN_RANGE,
+    W_SCAN_PREFIX,
+    W_SCAN_REVERSE,
+    W_DELETE_IF,
+    W_INDEX_BUILD,
+    W_COUNT
+} bench_workload_t;
+
+static const struct {
+    const char *name;
+    bool index_sweep;       /* Runs once per --indexes value */
+    bool threaded;          /* Runs once per --threads value */
+} workloads[W_COUNT] = {
+    [W_GET]          = {"get",          false, true},
+    [W_GET_MANY]     = {"get_many",     false, true},
+    [W_INSERT]       = {"insert",       true,  true},
+    [W_UPSERT]       = {"upsert",       true,  true},
+    [W_SCAN_RANGE]   = {"scan_range",   false, true},
+    [W_SCAN_PREFIX]  = {"scan_prefix",  false, true},
+    [W_SCAN_REVERSE] = {"scan_reverse", false, true},
+    [W_DELETE_IF]    = {"delete_if",    false, false},
+    [W_INDEX_BUILD]  = {"index_build",  false, false},
+};
+
+static const char *dist_names[DIST_COUNT] = {"seq", "uniform", "zipf"};
+static const char *impl_names[IMPL_COUNT] = {"wtree3", "lmdb"};
+
+typedef struct {
+    size_t keys;                            /* Preloaded entries */
+    size_t ops;                             /* Measured ops per case */
+    size_t value_sizes[BENCH_MAX_SWEEP];
+    size_t n_value_sizes;
+    unsigned threads[BENCH_MAX_SWEEP];
+    size_t n_threads;
+    unsigned indexes[BENCH_MAX_SWEEP];
+    size_t n_indexes;
+    bool dists[DIST_COUNT];
+    bool workloads[W_COUNT];
+    uint64_t seed;
+    bool sync;
+    bool csv;
+    char dir[256];
+} bench_config_t;
+
+static bench_config_t cfg;
+
+/* ============================================================
+ * Random Numbers and Key Distributions
+ * ============================================================ */
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+/* splitmix64 */
+static uint64_t rng_next(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static double rng_double(uint64_t *state) {
+    return (double)(rng_next(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Zipfian ranks over [0, n) (Gray et al., as used by YCSB) */
+typedef struct {
+    uint64_t n;
+    double theta, alpha, zetan, eta;
+} zipf_t;
+
+static void zipf_init(zipf_t *z, uint64_t n, double theta) {
+    double zeta2 = 1.0 + pow(0.5, theta);
+    double zetan = 0;
+    for (uint64_t i = 1; i <= n; i++) zetan += 1.0 / pow((double)i, theta);
+
+    z->n = n;
+    z->theta = theta;
+    z->alpha = 1.0 / (1.0 - theta);
+    z->zetan = zetan;
+    z->eta = (1.0 - pow(2.0 / (double)n, 1.0 - theta)) / (1.0 - zeta2 / zetan);
+}
+
+static uint64_t zipf_next(const zipf_t *z, uint64_t *state) {
+    double u = rng_double(state);
+    double uz = u * z->zetan;
+    if (uz < 1.0) return 0;
+    if (uz < 1.0 + pow(0.5, z->theta)) return 1;
+    uint64_t r = (uint64_t)((double)z->n * pow(z->eta * u - z->eta + 1.0, z->alpha));
+    return r < z->n ? r : z->n - 1;
+}
+
+static uint64_t gcd_u64(uint64_t a, uint64_t b) {
+    while (b) { uint64_t t = a % b; a = b; b = t; }
+    return a;
+}
+
+/* ============================================================
+ * Records
+ * ============================================================ */
+
+static void key_of(uint64_t id, uint8_t out[BENCH_KEY_LEN]) {
+    for (int i = BENCH_KEY_LEN - 1; i >= 0; i--) {
+        out[i] = (uint8_t)id;
+        id >>= 8;
+    }
+}
+
+static uint64_t id_of(const void *key) {
+    const uint8_t *p = key;
+    uint64_t id = 0;
+    for (int i = 0; i < BENCH_KEY_LEN; i++) id = (id << 8) | p[i];
+    return id;
+}
+
+/* Deterministic value for (id, version); version changes on upsert */
+static void fill_value(uint8_t *buf, size_t len, uint64_t id, uint64_t version) {
+    uint64_t state = mix64(id * 31 + version);
+    for (size_t i = 0; i < len; i += 8) {
+        uint64_t r = rng_next(&state);
+        size_t n = len - i < 8 ? len - i : 8;
+        memcpy(buf + i, &r, n);
+    }
+}
+
+static size_t field_offset(unsigned index, size_t value_len) {
+    return (BENCH_FIELD_LEN * index) % (value_len - BENCH_FIELD_LEN + 1);
+}
+
+/* Zero-copy extractor: user_data holds the index number */
+static bool field_extractor(const void *value, size_t value_len, void *user_data,
+                            void *buf, size_t buf_cap,
+                            const void **out_key, size_t *out_len) {
+    (void)buf; (void)buf_cap;
+    uint32_t index;
+    memcpy(&index, user_data, sizeof(index));
+    if (value_len < BENCH_FIELD_LEN) return false;
+
+    *out_key = (const uint8_t *)value + field_offset(index, value_len);
+    *out_len = BENCH_FIELD_LEN;
+    return true;
+}
+
+/* ============================================================
+ * Case State
+ * ============================================================ */
+
+typedef struct {
+    bench_workload_t workload;
+    bench_impl_t impl;
+    size_t value_size;
+    bench_dist_t dist;
+    unsigned threads;
+    unsigned indexes;
+
+    char path[300];
+    wtree3_db_t *db;
+    wtree3_tree_t *tree;
+    MDB_env *env;
+    MDB_dbi main_dbi;
+    MDB_dbi idx_dbi[BENCH_MAX_INDEXES];
+
+    zipf_t zipf;
+    uint64_t insert_stride;     /* Coprime with ops: scatters insert order */
+} bench_case_t;
+
+typedef struct {
+    bench_case_t *c;
+    unsigned tid;
+    size_t first, count;        /* Op numbers [first, first + count) */
+    uint64_t rng;
+    uint64_t *lat;
+    uint64_t user_bytes;
+    uint64_t checksum;          /* Keeps scan callbacks from being elided */
+    size_t scan_seen;           /* Entries visited by the current prefix scan */
+    MDB_txn *read_txn;          /* Raw get: reset/renew like the read pool */
+    uint8_t *value;             /* Scratch value of c->value_size */
+    bool failed;
+} bench_worker_t;
+
+static void die(const char *what, const char *detail) {
+    fprintf(stderr, "wtree3_bench: %s: %s\n", what, detail ? detail : "");
+    exit(1);
+}
+
+static void check_mdb(int rc, const char *what) {
+    if (rc != 0) die(what, mdb_strerror(rc));
+}
+
+static void check_wtree(int rc, const char *what, const gerror_t *error) {
+    if (rc != WTREE3_OK) die(what, error->message);
+}
+
+/* Preloaded id for a read or overwrite, drawn from the case distribution */
+static uint64_t pick_id(bench_worker_t *w, size_t op, uint64_t n) {
+    switch (w->c->dist) {
+        case DIST_SEQ:     return 2 * (op % n);
+        case DIST_UNIFORM: return 2 * (rng_next(&w->rng) % n);
+        default:           return 2 * (mix64(zipf_next(&w->c->zipf, &w->rng)) % n);
+    }
+}
+
+/* Fresh (odd) id for insert op number `op` */
+static uint64_t insert_id(const bench_case_t *c, size_t op) {
+    if (c->dist == DIST_SEQ) return 2 * (uint64_t)op + 1;
+    return 2 * (((uint64_t)op * c->insert_stride) % cfg.ops) + 1;
+}
+
+static size_t index_bytes(const bench_case_t *c) {
+    return c->indexes * (BENCH_FIELD_LEN + BENCH_KEY_LEN);
+}
+
+/* ============================================================
+ * Environment Setup
+ * ============================================================ */
+
+static size_t case_mapsize(const bench_case_t *c) {
+    size_t per_entry = c->value_size + 64 + c->indexes * 48;
+    return (cfg.keys + cfg.ops) * per_entry * 4 + ((size_t)64 << 20);
+}
+
+static void remove_dir(const char *path) {
+    char cmd[600];
+#ifdef _WIN32
+    snprintf(cmd, sizeof(cmd), "rd /s /q \"%s\"", path);
+#else
+    snprintf(cmd, sizeof(cmd), "rm -rf \"%s\"", path);
+#endif
+    (void)system(cmd);
+}
+
+static uint64_t data_size(const bench_case_t *c) {
+    MDB_env *env = c->impl == IMPL_WTREE3 ? wtree3_db_get_env(c->db) : c->env;
+    MDB_envinfo info;
+    MDB_stat st;
+    mdb_env_info(env, &info);
+    mdb_env_stat(env, &st);
+    return ((uint64_t)info.me_last_pgno + 1) * st.ms_psize;
+}
+
+static void raw_put(bench_case_t *c, MDB_txn *txn, const uint8_t *key,
+                    const uint8_t *value, unsigned int flags) {
+    MDB_val k = {.mv_size = BENCH_KEY_LEN, .mv_data = (void *)key};
+    MDB_val v = {.mv_size = c->value_size, .mv_data = (void *)value};
+    check_mdb(mdb_put(txn, c->main_dbi, &k, &v, flags), "mdb_put");
+
+    for (unsigned j = 0; j < c->indexes; j++) {
+        MDB_val ik = {.mv_size = BENCH_FIELD_LEN,
+                      .mv_data = (void *)(value + field_offset(j, c->value_size))};
+        int rc = mdb_put(txn, c->idx_dbi[j], &ik, &k, MDB_NODUPDATA);
+        if (rc != MDB_KEYEXIST) check_mdb(rc, "mdb_put (index)");
+    }
+}
+
+static void raw_unindex(bench_case_t *c, MDB_txn *txn, const uint8_t *key,
+                        const MDB_val *old) {
+    MDB_val k = {.mv_size = BENCH_KEY_LEN, .mv_data = (void *)key};
+    for (unsigned j = 0; j < c->indexes; j++) {
+        MDB_val ik = {.mv_size = BENCH_FIELD_LEN,
+                      .mv_data = (uint8_t *)old->mv_data + field_offset(j, old->mv_size)};
+        int rc = mdb_del(txn, c->idx_dbi[j], &ik, &k);
+        if (rc != MDB_NOTFOUND) check_mdb(rc, "mdb_del (index)");
+    }
+}
+
+static void add_wtree_index(bench_case_t *c, unsigned index) {
+    gerror_t error = {0};
+    char name[16];
+    uint32_t ud = index;
+    snprintf(name, sizeof(name), "idx%u", index);
+    wtree3_index_config_t ic = {.name = name, .user_data = &ud, .user_data_len = sizeof(ud)};
+    check_wtree(wtree3_tree_add_index(c->tree, &ic, &error), "wtree3_tree_add_index", &error);
+}
+
+static void open_raw_index(bench_case_t *c, MDB_txn *txn, unsigned index) {
+    char name[16];
+    snprintf(name, sizeof(name), "idx%u", index);
+    check_mdb(mdb_dbi_open(txn, name, MDB_CREATE | MDB_DUPSORT, &c->idx_dbi[index]),
+              "mdb_dbi_open (index)");
+}
+
+static void case_open(bench_case_t *c, unsigned case_no) {
+    gerror_t error = {0};
+    unsigned int env_flags = cfg.sync ? 0 : MDB_NOSYNC;
+
+    snprintf(c->path, sizeof(c->path), "%s/case_%u", cfg.dir, case_no);
+    mkdir(c->path, 0755);
+
+    if (c->impl == IMPL_WTREE3) {
+        c->db = wtree3_db_open(c->path, case_mapsize(c), 16, WTREE3_VERSION(1, 0),
+                               env_flags, &error);
+        if (!c->db) die("wtree3_db_open", error.message);
+        check_wtree(wtree3_db_register_key_extractor_into(c->db, WTREE3_VERSION(1, 0), 0,
+                                                          field_extractor, &error),
+                    "register extractor", &error);
+        c->tree = wtree3_tree_open(c->db, "main", MDB_CREATE, 0, &error);
+        if (!c->tree) die("wtree3_tree_open", error.message);
+        for (unsigned j = 0; j < c->indexes; j++) add_wtree_index(c, j);
+    } else {
+        check_mdb(mdb_env_create(&c->env), "mdb_env_create");
+        check_mdb(mdb_env_set_mapsize(c->env, case_mapsize(c)), "mdb_env_set_mapsize");
+        check_mdb(mdb_env_set_maxdbs(c->env, 16), "mdb_env_set_maxdbs");
+        check_mdb(mdb_env_open(c->env, c->path, env_flags, 0664), "mdb_env_open");
+
+        MDB_txn *txn;
+        check_mdb(mdb_txn_begin(c->env, NULL, 0, &txn), "mdb_txn_begin");
+        check_mdb(mdb_dbi_open(txn, "main", MDB_CREATE, &c->main_dbi), "mdb_dbi_open");
+        for (unsigned j = 0; j < c->indexes; j++) open_raw_index(c, txn, j);
+        check_mdb(mdb_txn_commit(txn), "mdb_txn_commit");
+    }
+}
+
+static void case_close(bench_case_t *c) {
+    if (c->impl == IMPL_WTREE3) {
+        wtree3_tree_close(c->tree);
+        wtree3_db_close(c->db);
+    } else {
+        mdb_env_close(c->env);
+    }
+    remove_dir(c->path);
+}
+
+/* Preload ids 0, 2, 4, ... in batched txns, indexes maintained */
+static void case_preload(bench_case_t *c) {
+    gerror_t error = {0};
+    uint8_t key[BENCH_KEY_LEN];
+    uint8_t *value = malloc(c->value_size);
+    if (!value) die("preload", "out of memory");
+
+    for (size_t i = 0; i < cfg.keys; i += BENCH_PRELOAD_TXN) {
+        size_t end = i + BENCH_PRELOAD_TXN < cfg.keys ? i + BENCH_PRELOAD_TXN : cfg.keys;
+
+        if (c->impl == IMPL_WTREE3) {
+            wtree3_txn_t *txn = wtree3_txn_begin(c->db, true, &error);
+            if (!txn) die("preload", error.message);
+            for (size_t n = i; n < end; n++) {
+                key_of(2 * n, key);
+                fill_value(value, c->value_size, 2 * n, 0);
+                check_wtree(wtree3_insert_one_txn(txn, c->tree, key, sizeof(key),
+                                                  value, c->value_size, &error),
+                            "preload insert", &error);
+            }
+            check_wtree(wtree3_txn_commit(txn, &error), "preload commit", &error);
+        } else {
+            MDB_txn *txn;
+            check_mdb(mdb_txn_begin(c->env, NULL, 0, &txn), "mdb_txn_begin");
+            for (size_t n = i; n < end; n++) {
+                key_of(2 * n, key);
+                fill_value(value, c->value_size, 2 * n, 0);
+                raw_put(c, txn, key, value, MDB_NOOVERWRITE);
+            }
+            check_mdb(mdb_txn_commit(txn), "mdb_txn_commit");
+        }
+    }
+    free(value);
+}
+
+/* ============================================================
+ * Operations
+ * ============================================================ */
+
+static bool scan_visit(const void *key, size_t key_len,
+                       const void *value, size_t value_len, void *user_data) {
+    (void)key; (void)value;
+    bench_worker_t *w = user_data;
+    w->checksum += key_len + value_len;
+    return true;
+}
+
+/* Stop after BENCH_SCAN_LEN entries */
+static bool scan_visit_limited(const void *key, size_t key_len,
+                               const void *value, size_t value_len, void *user_data) {
+    bench_worker_t *w = user_data;
+    scan_visit(key, key_len, value, value_len, user_data);
+    return ++w->scan_seen < BENCH_SCAN_LEN;
+}
+
+static bool delete_every_other(const void *key, size_t key_len,
+                               const void *value, size_t value_len, void *user_data) {
+    (void)key_len; (void)value; (void)value_len; (void)user_data;
+    return (id_of(key) / 2) % 2 == 0;
+}
+
+static void op_wtree3(bench_worker_t *w, size_t op) {
+    bench_case_t *c = w->c;
+    gerror_t error = {0};
+    uint8_t key[BENCH_KEY_LEN], end[BENCH_KEY_LEN];
+    uint64_t id;
+
+    switch (c->workload) {
+        case W_GET: {
+            key_of(pick_id(w, op, cfg.keys), key);
+            void *value = NULL;
+            size_t value_len = 0;
+            check_wtree(wtree3_get(c->tree, key, sizeof(key), &value, &value_len, &error),
+                        "wtree3_get", &error);
+            w->checksum += value_len;
+            free(value);
+            break;
+        }
+        case W_GET_MANY: {
+            uint8_t keys[BENCH_MANY_BATCH][BENCH_KEY_LEN];
+            wtree3_kv_t kv[BENCH_MANY_BATCH];
+            const void *values[BENCH_MANY_BATCH];
+            size_t lens[BENCH_MANY_BATCH];
+            for (size_t i = 0; i < BENCH_MANY_BATCH; i++) {
+                key_of(pick_id(w, op * BENCH_MANY_BATCH + i, cfg.keys), keys[i]);
+                kv[i] = (wtree3_kv_t){.key = keys[i], .key_len = BENCH_KEY_LEN};
+            }
+            wtree3_txn_t *txn = wtree3_txn_begin(c->db, false, &error);
+            if (!txn) die("wtree3_txn_begin", error.message);
+            check_wtree(wtree3_get_many_txn(txn, c->tree, kv, BENCH_MANY_BATCH, values, lens, &error),
+                        "wtree3_get_many_txn", &error);
+            for (size_t i = 0; i < BENCH_MANY_BATCH; i++) w->checksum += lens[i];
+            wtree3_txn_abort(txn);
+            break;
+        }
+        case W_INSERT:
+            id = insert_id(c, op);
+            key_of(id, key);
+            fill_value(w->value, c->value_size, id, 0);
+            check_wtree(wtree3_insert_one(c->tree, key, sizeof(key), w->value, c->value_size, &error),
+                        "wtree3_insert_one", &error);
+            w->user_bytes += sizeof(key) + c->value_size + index_bytes(c);
+            break;
+        case W_UPSERT:
+            id = pick_id(w, op, cfg.keys);
+            key_of(id, key);
+            fill_value(w->value, c->value_size, id, op + 1);
+            check_wtree(wtree3_upsert(c->tree, key, sizeof(key), w->value, c->value_size, &error),
+                        "wtree3_upsert", &error);
+            w->user_bytes += sizeof(key) + c->value_size + 2 * index_bytes(c);
+            break;
+        case W_SCAN_RANGE:
+        case W_SCAN_REVERSE:
+        case W_SCAN_PREFIX: {
+            id = pick_id(w, op, cfg.keys);
+            wtree3_txn_t *txn = wtree3_txn_begin(c->db, false, &error);
+            if (!txn) die("wtree3_txn_begin", error.message);
+            int rc;
+            if (c->workload == W_SCAN_RANGE) {
+                key_of(id, key);
+                key_of(id + 2 * (BENCH_SCAN_LEN - 1), end);
+                rc = wtree3_scan_range_txn(txn, c->tree, key, sizeof(key), end, sizeof(end),
+                                           scan_visit, w, &error);
+            } else if (c->workload == W_SCAN_REVERSE) {
+                key_of(id + 2 * (BENCH_SCAN_LEN - 1), key);
+                key_of(id, end);
+                rc = wtree3_scan_reverse_txn(txn, c->tree, key, sizeof(key), end, sizeof(end),
+                                             scan_visit, w, &error);
+            } else {
+                /* 7-byte prefix: 256 ids, of which 128 are preloaded */
+                key_of(id, key);
+                w->scan_seen = 0;
+                rc = wtree3_scan_prefix_txn(txn, c->tree, key, BENCH_KEY_LEN - 1,
+                                            scan_visit_limited, w, &error);
+            }
+            check_wtree(rc, "wtree3_scan", &error);
+            wtree3_txn_abort(txn);
+            break;
+        }
+        case W_DELETE_IF: {
+            uint64_t windows = cfg.keys / BENCH_SCAN_LEN ? cfg.keys / BENCH_SCAN_LEN : 1;
+            uint64_t win = (pick_id(w, op, windows) / 2);
+            key_of(2 * win * BENCH_SCAN_LEN, key);
+            key_of(2 * (win + 1) * BENCH_SCAN_LEN - 1, end);
+            wtree3_txn_t *txn = wtree3_txn_begin(c->db, true, &error);
+            if (!txn) die("wtree3_txn_begin", error.message);
+            size_t deleted = 0;
+            check_wtree(wtree3_delete_if_txn(txn, c->tree, key, sizeof(key), end, sizeof(end),
+                                             delete_every_other, NULL, &deleted, &error),
+                        "wtree3_delete_if_txn", &error);
+            check_wtree(wtree3_txn_commit(txn, &error), "wtree3_txn_commit", &error);
+            w->checksum += deleted;
+            break;
+        }
+        case W_INDEX_BUILD:
+            add_wtree_index(c, 0);
+            check_wtree(wtree3_tree_populate_index(c->tree, "idx0", &error),
+                        "wtree3_tree_populate_index", &error);
+            w->user_bytes += cfg.keys * (BENCH_FIELD_LEN + BENCH_KEY_LEN);
+            break;
+        default:
+            break;
+    }
+}
+
+static void raw_scan(bench_worker_t *w, MDB_txn *txn, const uint8_t *start,
+                     const uint8_t *bound, MDB_cursor_op step) {
+    bench_case_t *c = w->c;
+    MDB_cursor *cur;
+    check_mdb(mdb_cursor_open(txn, c->main_dbi, &cur), "mdb_cursor_open");
+
+    MDB_val k = {.mv_size = BENCH_KEY_LEN, .mv_data = (void *)start};
+    MDB_val v;
+    int rc = mdb_cursor_get(cur, &k, &v, MDB_SET_RANGE);
+    if (step == MDB_PREV) {
+        /* Position at the last key <= start */
+        if (rc == MDB_NOTFOUND) rc = mdb_cursor_get(cur, &k, &v, MDB_LAST);
+        else if (rc == 0 && memcmp(k.mv_data, start, BENCH_KEY_LEN) > 0) {
+            rc = mdb_cursor_get(cur, &k, &v, MDB_PREV);
+        }
+    }
+
+    bool prefix = c->workload == W_SCAN_PREFIX;
+    size_t cmp_len = prefix ? BENCH_KEY_LEN - 1 : BENCH_KEY_LEN;
+    size_t seen = 0;
+    while (rc == 0 && seen < BENCH_SCAN_LEN) {
+        int cmp = memcmp(k.mv_data, bound, cmp_len);
+        bool past = step == MDB_PREV ? cmp < 0 : (prefix ? cmp != 0 : cmp > 0);
+        if (past) break;
+        w->checksum += k.mv_size + v.mv_size;
+        seen++;
+        rc = mdb_cursor_get(cur, &k, &v, step);
+    }
+    if (rc != 0 && rc != MDB_NOTFOUND) check_mdb(rc, "mdb_cursor_get");
+    mdb_cursor_close(cur);
+}
+
+static MDB_txn *raw_read_begin(bench_worker_t *w) {
+    if (w->read_txn) {
+        check_mdb(mdb_txn_renew(w->read_txn), "mdb_txn_renew");
+    } else {
+        check_mdb(mdb_txn_begin(w->c->env, NULL, MDB_RDONLY, &w->read_txn), "mdb_txn_begin");
+    }
+    return w->read_txn;
+}
+
+static void op_lmdb(bench_worker_t *w, size_t op) {
+    bench_case_t *c = w->c;
+    uint8_t key[BENCH_KEY_LEN], end[BENCH_KEY_LEN];
+    MDB_txn *txn;
+    MDB_val k = {.mv_size = BENCH_KEY_LEN, .mv_data = key}, v;
+    uint64_t id;
+
+    switch (c->workload) {
+        case W_GET: {
+            key_of(pick_id(w, op, cfg.keys), key);
+            txn = raw_read_begin(w);
+            check_mdb(mdb_get(txn, c->main_dbi, &k, &v), "mdb_get");
+            /* wtree3_get hands back a copy; so does the baseline */
+            void *copy = malloc(v.mv_size);
+            if (!copy) die("mdb_get", "out of memory");
+            memcpy(copy, v.mv_data, v.mv_size);
+            mdb_txn_reset(txn);
+            w->checksum += v.mv_size;
+            free(copy);
+            break;
+        }
+        case W_GET_MANY:
+            txn = raw_read_begin(w);
+            for (size_t i = 0; i < BENCH_MANY_BATCH; i++) {
+                key_of(pick_id(w, op * BENCH_MANY_BATCH + i, cfg.keys), key);
+                check_mdb(mdb_get(txn, c->main_dbi, &k, &v), "mdb_get");
+                w->checksum += v.mv_size;
+            }
+            mdb_txn_reset(txn);
+            break;
+        case W_INSERT:
+            id = insert_id(c, op);
+            key_of(id, key);
+            fill_value(w->value, c->value_size, id, 0);
+            check_mdb(mdb_txn_begin(c->env, NULL, 0, &txn), "mdb_txn_begin");
+            raw_put(c, txn, key, w->value, MDB_NOOVERWRITE);
+            check_mdb(mdb_txn_commit(txn), "mdb_txn_commit");
+            w->user_bytes += sizeof(key) + c->value_size + index_bytes(c);
+            break;
+        case W_UPSERT:
+            id = pick_id(w, op, cfg.keys);
+            key_of(id, key);
+            fill_value(w->value, c->value_size, id, op + 1);
+            check_mdb(mdb_txn_begin(c->env, NULL, 0, &txn), "mdb_txn_begin");
+            if (c->indexes > 0) {
+                int rc = mdb_get(txn, c->main_dbi, &k, &v);
+                if (rc == 0) raw_unindex(c, txn, key, &v);
+                else check_mdb(rc == MDB_NOTFOUND ? 0 : rc, "mdb_get");
+            }
+            raw_put(c, txn, key, w->value, 0);
+            check_mdb(mdb_txn_commit(txn), "mdb_txn_commit");
+            w->user_bytes += sizeof(key) + c->value_size + 2 * index_bytes(c);
+            break;
+        case W_SCAN_RANGE:
+        case W_SCAN_REVERSE:
+        case W_SCAN_PREFIX:
+            id = pick_id(w, op, cfg.keys);
+            check_mdb(mdb_txn_begin(c->env, NULL, MDB_RDONLY, &txn), "mdb_txn_begin");
+            if (c->workload == W_SCAN_RANGE) {
+                key_of(id, key);
+                key_of(id + 2 * (BENCH_SCAN_LEN - 1), end);
+                raw_scan(w, txn, key, end, MDB_NEXT);
+            } else if (c->workload == W_SCAN_REVERSE) {
+                key_of(id + 2 * (BENCH_SCAN_LEN - 1), key);
+                key_of(id, end);
+                raw_scan(w, txn, key, end, MDB_PREV);
+            } else {
+                key_of(id, end);
+                memcpy(key, end, BENCH_KEY_LEN);
+                key[BENCH_KEY_LEN - 1] = 0;
+                raw_scan(w, txn, key, end, MDB_NEXT);
+            }
+            mdb_txn_abort(txn);
+            break;
+        case W_DELETE_IF: {
+            uint64_t windows = cfg.keys / BENCH_SCAN_LEN ? cfg.keys / BENCH_SCAN_LEN : 1;
+            uint64_t win = (pick_id(w, op, windows) / 2);
+            key_of(2 * win * BENCH_SCAN_LEN, key);
+            key_of(2 * (win + 1) * BENCH_SCAN_LEN - 1, end);
+            check_mdb(mdb_txn_begin(c->env, NULL, 0, &txn), "mdb_txn_begin");
+            MDB_cursor *cur;
+            check_mdb(mdb_cursor_open(txn, c->main_dbi, &cur), "mdb_cursor_open");
+            int rc = mdb_cursor_get(cur, &k, &v, MDB_SET_RANGE);
+            while (rc == 0 && memcmp(k.mv_data, end, BENCH_KEY_LEN) <= 0) {
+                if (delete_every_other(k.mv_data, k.mv_size, v.mv_data, v.mv_size, NULL)) {
+                    check_mdb(mdb_cursor_del(cur, 0), "mdb_cursor_del");
+                    w->checksum++;
+                }
+                /* After a delete MDB_NEXT lands on the entry that followed it */
+                rc = mdb_cursor_get(cur, &k, &v, MDB_NEXT);
+            }
+            if (rc != 0 && rc != MDB_NOTFOUND) check_mdb(rc, "mdb_cursor_get");
+            mdb_cursor_close(cur);
+            check_mdb(mdb_txn_commit(txn), "mdb_txn_commit");
+            break;
+        }
+        case W_INDEX_BUILD: {
+            check_mdb(mdb_txn_begin(c->env, NULL, 0, &txn), "mdb_txn_begin");
+            open_raw_index(c, txn, 0);
+            MDB_cursor *cur;
+            check_mdb(mdb_cursor_open(txn, c->main_dbi, &cur), "mdb_cursor_open");
+            int rc = mdb_cursor_get(cur, &k, &v, MDB_FIRST);
+            while (rc == 0) {
+                MDB_val ik = {.mv_size = BENCH_FIELD_LEN,
+                              .mv_data = (uint8_t *)v.mv_data + field_offset(0, v.mv_size)};
+                int prc = mdb_put(txn, c->idx_dbi[0], &ik, &k, MDB_NODUPDATA);
+                if (prc != MDB_KEYEXIST) check_mdb(prc, "mdb_put (index)");
+                rc = mdb_cursor_get(cur, &k, &v, MDB_NEXT);
+            }
+            if (rc != MDB_NOTFOUND) check_mdb(rc, "mdb_cursor_get");
+            mdb_cursor_close(cur);
+            check_mdb(mdb_txn_commit(txn), "mdb_txn_commit");
+            w->user_bytes += cfg.keys * (BENCH_FIELD_LEN + BENCH_KEY_LEN);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+/* ============================================================
+ * Runner
+ * ============================================================ */
+
+static void *worker_main(void *arg) {
+    bench_worker_t *w = arg;
+    for (size_t i = 0; i < w->count; i++) {
+        size_t op = w->first + i;
+        uint64_t t0 = wtime_now_ns();
+        if (w->c->impl == IMPL_WTREE3) op_wtree3(w, op);
+        else op_lmdb(w, op);
+        w->lat[i] = wtime_now_ns() - t0;
+    }
+    if (w->read_txn) mdb_txn_abort(w->read_txn);
+    return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static double quantile_us(const uint64_t *sorted, size_t n, double q) {
+    size_t i = (size_t)(q * (double)(n - 1) + 0.5);
+    return (double)sorted[i] / 1000.0;
+}
+
+static void print_header(void) {
+    if (cfg.csv) {
+        printf("workload,impl,indexes,value_size,dist,threads,ops,ops_per_sec,"
+               "p50_us,p99_us,p999_us,user_mb,file_growth_mb\n");
+    } else {
+        printf("%-12s %-6s %3s %6s %-7s %3s %12s %9s %9s %9s %9s %9s\n",
+               "workload", "impl", "idx", "value", "dist", "thr", "ops/s",
+               "p50_us", "p99_us", "p999_us", "user_MB", "grow_MB");
+    }
+}
+
+static void run_case(bench_case_t *c, unsigned case_no) {
+    bool single = c->workload == W_INDEX_BUILD;
+    size_t ops = single ? 1 : cfg.ops;
+    if (c->workload == W_DELETE_IF) {
+        size_t windows = cfg.keys / BENCH_SCAN_LEN ? cfg.keys / BENCH_SCAN_LEN : 1;
+        if (ops > windows) ops = windows;
+    }
+
+    case_open(c, case_no);
+    case_preload(c);
+    if (c->dist == DIST_ZIPF) zipf_init(&c->zipf, cfg.keys, BENCH_ZIPF_THETA);
+    c->insert_stride = 1;
+    for (uint64_t s = 0x9e3779b97f4a7c15ULL % cfg.ops; cfg.ops > 1; s++) {
+        if (s > 1 && gcd_u64(s, cfg.ops) == 1) { c->insert_stride = s; break; }
+    }
+
+    bench_worker_t workers[BENCH_MAX_THREADS];
+    wthread_t threads[BENCH_MAX_THREADS];
+    uint64_t *lat = calloc(ops, sizeof(uint64_t));
+    if (!lat) die("run", "out of memory");
+
+    unsigned nthreads = c->threads < ops ? c->threads : (unsigned)ops;
+    size_t per = ops / nthreads, extra = ops % nthreads, next = 0;
+    for (unsigned t = 0; t < nthreads; t++) {
+        bench_worker_t *w = &workers[t];
+        memset(w, 0, sizeof(*w));
+        w->c = c;
+        w->tid = t;
+        w->first = next;
+        w->count = per + (t < extra ? 1 : 0);
+        w->rng = mix64(cfg.seed ^ ((uint64_t)case_no << 32) ^ t);
+        w->lat = lat + next;
+        w->value = malloc(c->value_size);
+        if (!w->value) die("run", "out of memory");
+        next += w->count;
+    }
+
+    uint64_t grow0 = data_size(c);
+    uint64_t start = wtime_now_ns();
+    if (nthreads == 1) {
+        worker_main(&workers[0]);
+    } else {
+        for (unsigned t = 0; t < nthreads; t++) {
+            if (wthread_create(&threads[t], worker_main, &workers[t]) != 0) die("run", "thread create failed");
+        }
+        for (unsigned t = 0; t < nthreads; t++) wthread_join(threads[t], NULL);
+    }
+    uint64_t elapsed = wtime_now_ns() - start;
+    uint64_t grow = data_size(c) - grow0;
+
+    uint64_t user_bytes = 0;
+    for (unsigned t = 0; t < nthreads; t++) {
+        user_bytes += workers[t].user_bytes;
+        free(workers[t].value);
+    }
+
+    /* Index builds count entries indexed; everything else counts ops */
+    double units = single ? (double)cfg.keys : (double)ops;
+    double per_sec = elapsed ? units * 1e9 / (double)elapsed : 0;
+
+    qsort(lat, ops, sizeof(uint64_t), cmp_u64);
+    double p50 = quantile_us(lat, ops, 0.50);
+    double p99 = quantile_us(lat, ops, 0.99);
+    double p999 = quantile_us(lat, ops, 0.999);
+    double user_mb = (double)user_bytes / (1024.0 * 1024.0);
+    double grow_mb = (double)grow / (1024.0 * 1024.0);
+
+    const char *name = workloads[c->workload].name;
+    if (cfg.csv) {
+        printf("%s,%s,%u,%zu,%s,%u,%zu,%.0f,%.2f,%.2f,%.2f,%.2f,%.2f\n",
+               name, impl_names[c->impl], c->indexes, c->value_size, dist_names[c->dist],
+               nthreads, ops, per_sec, p50, p99, p999, user_mb, grow_mb);
+    } else {
+        printf("%-12s %-6s %3u %6zu %-7s %3u %12.0f %9.2f %9.2f %9.2f %9.2f %9.2f\n",
+               name, impl_names[c->impl], c->indexes, c->value_size, dist_names[c->dist],
+               nthreads, per_sec, p50, p99, p999, user_mb, grow_mb);
+    }
+    fflush(stdout);
+
+    free(lat);
+    case_close(c);
+}
+
+/* ============================================================
+ * Command Line
+ * ============================================================ */
+
+static void usage(void) {
+    printf("Usage: wtree3_bench [options]\n"
+           "  --keys N            preloaded entries (default 100000)\n"
+           "  --ops N             measured operations per case (default 100000)\n"
+           "  --value-sizes LIST  value sizes in bytes (default 16,256,4096)\n"
+           "  --dist LIST         seq,uniform,zipf (default all)\n"
+           "  --threads LIST      thread counts (default 1,4)\n"
+           "  --indexes LIST      index counts for insert/upsert (default 0,1,4,8)\n"
+           "  --workload LIST     get,get_many,insert,upsert,scan_range,scan_prefix,\n"
+           "                      scan_reverse,delete_if,index_build (default all)\n"
+           "  --dir PATH          scratch directory (default: temp dir)\n"
+           "  --seed N            random seed (default 42)\n"
+           "  --sync              fsync every commit (default MDB_NOSYNC)\n"
+           "  --csv               CSV output\n");
+}
+
+static size_t parse_list(const char *arg, size_t *out, size_t max) {
+    size_t n = 0;
+    char *copy = strdup(arg), *save = NULL;
+    if (!copy) die("options", "out of memory");
+    for (char *tok = strtok_r(copy, ",", &save); tok && n < max; tok = strtok_r(NULL, ",", &save)) {
+        out[n++] = (size_t)strtoull(tok, NULL, 10);
+    }
+    free(copy);
+    return n;
+}
+
+static void parse_names(const char *arg, bool *out, const char *const *names, size_t count,
+                        const char *what) {
+    memset(out, 0, count * sizeof(bool));
+    char *copy = strdup(arg), *save = NULL;
+    if (!copy) die("options", "out of memory");
+    for (char *tok = strtok_r(copy, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        size_t i = 0;
+        while (i < count && strcmp(tok, names[i]) != 0) i++;
+        if (i == count) die(what, tok);
+        out[i] = true;
+    }
+    free(copy);
+}
+
+static void parse_args(int argc, char **argv) {
+    size_t tmp[BENCH_MAX_SWEEP];
+    const char *workload_names[W_COUNT];
+    for (int i = 0; i < W_COUNT; i++) workload_names[i] = workloads[i].name;
+
+    cfg.keys = 100000;
+    cfg.ops = 100000;
+    cfg.n_value_sizes = parse_list("16,256,4096", cfg.value_sizes, BENCH_MAX_SWEEP);
+    cfg.n_threads = 2;
+    cfg.threads[0] = 1;
+    cfg.threads[1] = 4;
+    cfg.n_indexes = 4;
+    cfg.indexes[0] = 0;
+    cfg.indexes[1] = 1;
+    cfg.indexes[2] = 4;
+    cfg.indexes[3] = 8;
+    for (int i = 0; i < DIST_COUNT; i++) cfg.dists[i] = true;
+    for (int i = 0; i < W_COUNT; i++) cfg.workloads[i] = true;
+    cfg.seed = 42;
+#ifdef _WIN32
+    snprintf(cfg.dir, sizeof(cfg.dir), "%s\\wtree3_bench_%d", getenv("TEMP"), getpid());
+#else
+    snprintf(cfg.dir, sizeof(cfg.dir), "/tmp/wtree3_bench_%d", getpid());
+#endif
+
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+        bool takes = true;
+
+        if (strcmp(a, "--keys") == 0 && v) cfg.keys = (size_t)strtoull(v, NULL, 10);
+        else if (strcmp(a, "--ops") == 0 && v) cfg.ops = (size_t)strtoull(v, NULL, 10);
+        else if (strcmp(a, "--value-sizes") == 0 && v) cfg.n_value_sizes = parse_list(v, cfg.value_sizes, BENCH_MAX_SWEEP);
+        else if (strcmp(a, "--dist") == 0 && v) parse_names(v, cfg.dists, dist_names, DIST_COUNT, "unknown distribution");
+        else if (strcmp(a, "--workload") == 0 && v) parse_names(v, cfg.workloads, workload_names, W_COUNT, "unknown workload");
+        else if (strcmp(a, "--dir") == 0 && v) snprintf(cfg.dir, sizeof(cfg.dir), "%s", v);
+        else if (strcmp(a, "--seed") == 0 && v) cfg.seed = strtoull(v, NULL, 10);
+        else if (strcmp(a, "--threads") == 0 && v) {
+            cfg.n_threads = parse_list(v, tmp, BENCH_MAX_SWEEP);
+            for (size_t t = 0; t < cfg.n_threads; t++) cfg.threads[t] = (unsigned)tmp[t];
+        } else if (strcmp(a, "--indexes") == 0 && v) {
+            cfg.n_indexes = parse_list(v, tmp, BENCH_MAX_SWEEP);
+            for (size_t t = 0; t < cfg.n_indexes; t++) cfg.indexes[t] = (unsigned)tmp[t];
+        } else {
+            takes = false;
+            if (strcmp(a, "--sync") == 0) cfg.sync = true;
+            else if (strcmp(a, "--csv") == 0) cfg.csv = true;
+            else if (strcmp(a, "--help") == 0 || strcmp(a, "-h") == 0) { usage(); exit(0); }
+            else { usage(); exit(2); }
+        }
+        if (takes) i++;
+    }
+
+    if (cfg.keys < 2 || cfg.ops < 1) die("options", "--keys must be >= 2 and --ops >= 1");
+    for (size_t i = 0; i < cfg.n_value_sizes; i++) {
+        if (cfg.value_sizes[i] < 2 * BENCH_MAX_INDEXES) die("options", "value sizes must be >= 16");
+    }
+    for (size_t i = 0; i < cfg.n_threads; i++) {
+        if (cfg.threads[i] < 1 || cfg.threads[i] > BENCH_MAX_THREADS) die("options", "threads must be 1..64");
+    }
+    for (size_t i = 0; i < cfg.n_indexes; i++) {
+        if (cfg.indexes[i] > BENCH_MAX_INDEXES) die("options", "indexes must be 0..8");
+    }
+}
+
+int main(int argc, char **argv) {
+    parse_args(argc, argv);
+    mkdir(cfg.dir, 0755);
+    print_header();
+
+    unsigned case_no = 0;
+    for (int wl = 0; wl < W_COUNT; wl++) {
+        if (!cfg.workloads[wl]) continue;
+        size_t n_idx = workloads[wl].index_sweep ? cfg.n_indexes : 1;
+        size_t n_thr = workloads[wl].threaded ? cfg.n_threads : 1;
+
+        for (size_t vi = 0; vi < cfg.n_value_sizes; vi++)
+        for (int d = 0; d < DIST_COUNT; d++) {
+            if (!cfg.dists[d]) continue;
+            for (size_t ti = 0; ti < n_thr; ti++)
+            for (size_t ii = 0; ii < n_idx; ii++)
+            for (int impl = 0; impl < IMPL_COUNT; impl++) {
+                bench_case_t c = {
+                    .workload = (bench_workload_t)wl,
+                    .impl = (bench_impl_t)impl,
+                    .value_size = cfg.value_sizes[vi],
+                    .dist = (bench_dist_t)d,
+                    .threads = workloads[wl].threaded ? cfg.threads[ti] : 1,
+                    .indexes = workloads[wl].index_sweep ? cfg.indexes[ii] : 0,
+                };
+                run_case(&c, case_no++);
+            }
+        }
+    }
+
+    remove_dir(cfg.dir);
+    return 0;
+}
@@ -1,26 +1,253 @@
 /*
  * gerror.c - Simple error handling
+ *
+ * Errors are formatted when set, unless the gerror_t is in lazy mode:
+ * then set_error records the format pointer and the arguments (strings
+ * copied, since they may not outlive the call) and formatting happens on
+ * the first error_message/error_message_ex. Callers that only look at
+ * the code - misses, duplicate keys - never pay for vsnprintf. Formats
+ * the recorder cannot hold ('*' widths, too many or too long arguments)
+ * are formatted at once as usual.
  */
 
 #include "gerror.h"
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
 #include <string.h>
 
+/* ============================================================
+ * Format Specs
+ * ============================================================ */
+
+#define SPEC_MAX 24                 /* Longest conversion spec kept lazily */
+
+typedef struct {
+    const char *start;              /* The '%' */
+    size_t len;                     /* Through the conversion character */
+    char conv;                      /* '%' for a literal percent */
+    char length;                    /* 0, 'H' (hh), 'h', 'l', 'L' (ll), 'z', 'j', 't' */
+} spec_t;
+
+/* Next spec from *p: 1 found, 0 end of format, -1 not supported lazily */
+static int next_spec(const char **p, spec_t *s) {
+    const char *c = strchr(*p, '%');
+    if (!c) return 0;
+
+    s->start = c++;
+    s->length = 0;
+    while (*c && strchr("-+ #0", *c)) c++;
+    while (*c >= '0' && *c <= '9') c++;
+    if (*c == '.') {
+        c++;
+        while (*c >= '0' && *c <= '9') c++;
+    }
+    if (*c == '*') return -1;
+
+    switch (*c) {
+        case 'h': s->length = (c[1] == 'h') ? 'H' : 'h'; c += (c[1] == 'h') ? 2 : 1; break;
+        case 'l': s->length = (c[1] == 'l') ? 'L' : 'l'; c += (c[1] == 'l') ? 2 : 1; break;
+        case 'z': case 'j': case 't': s->length = *c++; break;
+        default: break;
+    }
+
+    s->conv = *c;
+    if (!strchr("%diuoxXcspfFeEgGaA", s->conv) || s->conv == '\0') return -1;
+    s->len = (size_t)(c + 1 - s->start);
+    if (s->len >= SPEC_MAX) return -1;
+    *p = c + 1;
+    return 1;
+}
+
+/* ============================================================
+ * Lazy Recording
+ * ============================================================ */
+
+static long long take_signed(va_list *ap, char length) {
+    switch (length) {
+        case 'l': return va_arg(*ap, long);
+        case 'L': return va_arg(*ap, long long);
+        case 'z': return (long long)va_arg(*ap, size_t);
+        case 'j': return (long long)va_arg(*ap, intmax_t);
+        case 't': return (long long)va_arg(*ap, ptrdiff_t);
+        default:  return va_arg(*ap, int);
+    }
+}
+
+static unsigned long long take_unsigned(va_list *ap, char length) {
+    switch (length) {
+        case 'l': return va_arg(*ap, unsigned long);
+        case 'L': return va_arg(*ap, unsigned long long);
+        case 'z': return va_arg(*ap, size_t);
+        case 'j': return (unsigned long long)va_arg(*ap, uintmax_t);
+        case 't': return (unsigned long long)va_arg(*ap, ptrdiff_t);
+        default:  return va_arg(*ap, unsigned int);
+    }
+}
+
+/* Record format's arguments into error; false if it has to be formatted now */
+static bool lazy_record(gerror_t *error, const char *format, va_list *ap) {
+    size_t n = 0;
+    size_t used = 0;
+    const char *p = format;
+    spec_t s;
+    int found;
+
+    while ((found = next_spec(&p, &s)) > 0) {
+        if (s.conv == '%') continue;
+        if (n == GERROR_LAZY_ARGS) return false;
+        gerror_arg_t *arg = &error->lazy_args[n++];
+
+        switch (s.conv) {
+            case 'd': case 'i':
+                arg->i = take_signed(ap, s.length);
+                break;
+            case 'u': case 'o': case 'x': case 'X':
+                arg->u = take_unsigned(ap, s.length);
+                break;
+            case 'c':
+                arg->i = va_arg(*ap, int);
+                break;
+            case 'p':
+                arg->p = va_arg(*ap, void *);
+                break;
+            case 's': {
+                const char *str = va_arg(*ap, const char *);
+                if (!str) str = "(null)";
+                size_t len = strlen(str);
+                if (len + 1 > sizeof(error->lazy_strs) - used) return false;
+                memcpy(error->lazy_strs + used, str, len + 1);
+                arg->str = used;
+                used += len + 1;
+                break;
+            }
+            default:
+                if (s.length) return false;     /* %Lf and friends */
+                arg->d = va_arg(*ap, double);
+                break;
+        }
+    }
+    return found == 0;
+}
+
+/* ============================================================
+ * Lazy Formatting
+ * ============================================================ */
+
+static size_t append(char *out, size_t cap, size_t pos, const char *src, size_t len) {
+    if (pos + 1 >= cap) return pos;
+    if (len > cap - 1 - pos) len = cap - 1 - pos;
+    memcpy(out + pos, src, len);
+    out[pos + len] = '\0';
+    return pos + len;
+}
+
+static int format_arg(char *out, size_t cap, const char *spec, const spec_t *s,
+                      const gerror_arg_t *arg, const char *strs) {
+    switch (s->conv) {
+        case 'd': case 'i':
+            switch (s->length) {
+                case 'l': return snprintf(out, cap, spec, (long)arg->i);
+                case 'L': return snprintf(out, cap, spec, arg->i);
+                case 'z': return snprintf(out, cap, spec, (size_t)arg->i);
+                case 'j': return snprintf(out, cap, spec, (intmax_t)arg->i);
+                case 't': return snprintf(out, cap, spec, (ptrdiff_t)arg->i);
+                default:  return snprintf(out, cap, spec, (int)arg->i);
+            }
+        case 'u': case 'o': case 'x': case 'X':
+            switch (s->length) {
+                case 'l': return snprintf(out, cap, spec, (unsigned long)arg->u);
+                case 'L': return snprintf(out, cap, spec, arg->u);
+                case 'z': return snprintf(out, cap, spec, (size_t)arg->u);
+                case 'j': return snprintf(out, cap, spec, (uintmax_t)arg->u);
+                case 't': return snprintf(out, cap, spec, (ptrdiff_t)arg->u);
+                default:  return snprintf(out, cap, spec, (unsigned int)arg->u);
+            }
+        case 'c': return snprintf(out, cap, spec, (int)arg->i);
+        case 'p': return snprintf(out, cap, spec, arg->p);
+        case 's': return snprintf(out, cap, spec, strs + arg->str);
+        default:  return snprintf(out, cap, spec, arg->d);
+    }
+}
+
+/* Fill in lib and message from what set_error recorded */
+static void lazy_format(gerror_t *error) {
+    const char *format = error->lazy_format;
+    error->lazy_format = NULL;
+    snprintf(error->lib, sizeof(error->lib), "%s", error->lazy_lib ? error->lazy_lib : "unknown");
+
+    char *out = error->message;
+    size_t cap = sizeof(error->message);
+    size_t pos = 0;
+    size_t n = 0;
+    const char *p = format;
+    const char *literal = format;
+    spec_t s;
+    out[0] = '\0';
+
+    while (next_spec(&p, &s) > 0) {
+        pos = append(out, cap, pos, literal, (size_t)(s.start - literal));
+        literal = p;
+        if (s.conv == '%') {
+            pos = append(out, cap, pos, "%", 1);
+            continue;
+        }
+
+        char spec[SPEC_MAX];
+        memcpy(spec, s.start, s.len);
+        spec[s.len] = '\0';
+        if (pos + 1 < cap) {
+            int w = format_arg(out + pos, cap - pos, spec, &s, &error->lazy_args[n], error->lazy_strs);
+            if (w > 0) pos = ((size_t)w < cap - pos) ? pos + (size_t)w : cap - 1;
+        }
+        n++;
+    }
+    append(out, cap, pos, literal, strlen(literal));
+}
+
+/* ============================================================
+ * API
+ * ============================================================ */
+
 void set_error(gerror_t *error, const char *lib, int code, const char *format, ...) {
     if (!error) return;
 
+    error->code = code;
+    error->lazy_format = NULL;
+
+    if (error->flags & GERROR_LAZY) {
+        /* Plain messages need no arguments at all */
+        if (!strchr(format, '%')) {
+            error->lazy_lib = lib;
+            error->lazy_format = format;
+            return;
+        }
+
+        va_list args;
+        va_start(args, format);
+        va_list copy;
+        va_copy(copy, args);
+        bool recorded = lazy_record(error, format, &copy);
+        va_end(copy);
+        va_end(args);
+        if (recorded) {
+            error->lazy_lib = lib;
+            error->lazy_format = format;
+            return;
+        }
+    }
+
     va_list args;
     va_start(args, format);
-
-    error->code = code;
     snprintf(error->lib, sizeof(error->lib), "%s", lib ? lib : "unknown");
     vsnprintf(error->message, sizeof(error->message), format, args);
-
     va_end(args);
 }
 
 const char* error_message(const gerror_t *error) {
+    if (error && error->lazy_format) lazy_format((gerror_t *)error);
     if (!error || error->message[0] == '\0') {
         return "No error";
     }
@@ -32,6 +259,7 @@ const char* error_message_ex(const gerror_t *error, char *buffer, size_t buffer_
         return "Invalid buffer";
     }
 
+    if (error && error->lazy_format) lazy_format((gerror_t *)error);
     if (!error || error->message[0] == '\0') {
         snprintf(buffer, buffer_size, "No error");
         return buffer;
@@ -46,9 +274,24 @@ const char* error_message_ex(const gerror_t *error, char *buffer, size_t buffer_
     return buffer;
 }
 
+void error_copy(gerror_t *dst, const gerror_t *src) {
+    if (!dst || !src || dst == src) return;
+    unsigned int flags = dst->flags;
+    *dst = *src;
+    dst->flags = flags;
+}
+
 void error_clear(gerror_t *error) {
     if (!error) return;
     error->code = 0;
     error->lib[0] = '\0';
     error->message[0] = '\0';
+    error->lazy_format = NULL;
+}
+
+void error_set_lazy(gerror_t *error, int lazy) {
+    if (!error) return;
+    if (error->lazy_format) lazy_format(error);
+    if (lazy) error->flags |= GERROR_LAZY;
+    else error->flags &= ~(unsigned int)GERROR_LAZY;
 }
@@ -7,10 +7,38 @@
 extern "C" {
 #endif
 
+/* gerror_t.flags */
+#define GERROR_LAZY 0x1             /* Record errors, format them on first read */
+
+#define GERROR_LAZY_ARGS 4          /* Arguments a lazy error can hold */
+#define GERROR_LAZY_STRS 96         /* Bytes for its %s arguments */
+
+/* One recorded printf argument */
+typedef union gerror_arg {
+    long long i;
+    unsigned long long u;
+    double d;
+    const void *p;
+    size_t str;                     /* Offset of a %s argument in lazy_strs */
+} gerror_arg_t;
+
 typedef struct gerror_t {
     int code;
     char lib[64];
     char message[256];
+
+    /*
+     * Lazy mode (flags & GERROR_LAZY): set_error only records the code,
+     * the lib and format pointers (string literals at every call site)
+     * and the arguments; lib and message are filled in by error_message
+     * or error_message_ex. Read the message through those, not the
+     * fields. Formats without arguments are never formatted at all.
+     */
+    unsigned int flags;
+    const char *lazy_lib;
+    const char *lazy_format;        /* NULL = lib and message are current */
+    gerror_arg_t lazy_args[GERROR_LAZY_ARGS];
+    char lazy_strs[GERROR_LAZY_STRS];
 } gerror_t;
 
 /* Set error with printf-style formatting */
@@ -22,9 +50,15 @@ const char* error_message(const gerror_t *error);
 /* Get formatted error message: "lib: message" */
 const char* error_message_ex(const gerror_t *error, char *buffer, size_t buffer_size);
 
-/* Clear error state */
+/* Copy src into dst, keeping dst's flags (e.g. a worker's error to the caller's) */
+void error_copy(gerror_t *dst, const gerror_t *src);
+
+/* Clear error state (keeps flags) */
 void error_clear(gerror_t *error);
 
+/* Switch an error to lazy formatting (or back) */
+void error_set_lazy(gerror_t *error, int lazy);
+
 #ifdef __cplusplus
 }
 #endif
@@ -217,6 +217,16 @@
 #define WTREE_ASSUME(cond) ((void)0)
 #endif
 
+/* ============================================================
+ * Thread-Local Storage
+ * ============================================================ */
+
+#if WTREE_MSVC
+#define WTREE_THREAD_LOCAL __declspec(thread)
+#else
+#define WTREE_THREAD_LOCAL _Thread_local
+#endif
+
 /* ============================================================
  * Common Patterns
  * ============================================================ */
@@ -0,0 +1,194 @@
+/*
+ * whash.c - Generic hash table implementation
+ */
+
+#include "whash.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* ============================================================
+ * Constants
+ * ============================================================ */
+
+#define WHASH_DEFAULT_CAPACITY 8
+#define WHASH_MAX_LOAD_NUM 3        /* Grow past 3/4 full */
+#define WHASH_MAX_LOAD_DEN 4
+
+/* ============================================================
+ * Internal Structure
+ * ============================================================ */
+
+typedef struct {
+    uint64_t hash;
+    void *element;                  /* NULL = empty slot */
+} whash_slot_t;
+
+struct whash {
+    whash_slot_t *slots;
+    size_t capacity;                /* Power of two */
+    size_t size;
+    whash_cleanup_fn cleanup_fn;    /* Optional cleanup function */
+};
+
+/* ============================================================
+ * Helper Functions
+ * ============================================================ */
+
+static size_t slot_count_for(size_t elements) {
+    size_t capacity = WHASH_DEFAULT_CAPACITY;
+    while (capacity * WHASH_MAX_LOAD_NUM < elements * WHASH_MAX_LOAD_DEN) capacity *= 2;
+    return capacity;
+}
+
+/* Place without growing or duplicate checks (a free slot must exist) */
+static void place(whash_slot_t *slots, size_t capacity, uint64_t hash, void *element) {
+    size_t mask = capacity - 1;
+    size_t i = (size_t)hash & mask;
+    while (slots[i].element) i = (i + 1) & mask;
+    slots[i].hash = hash;
+    slots[i].element = element;
+}
+
+static bool grow(whash_t *map) {
+    size_t capacity = map->capacity * 2;
+    whash_slot_t *slots = calloc(capacity, sizeof(whash_slot_t));
+    if (!slots) return false;
+
+    for (size_t i = 0; i < map->capacity; i++) {
+        if (map->slots[i].element) place(slots, capacity, map->slots[i].hash, map->slots[i].element);
+    }
+    free(map->slots);
+    map->slots = slots;
+    map->capacity = capacity;
+    return true;
+}
+
+static whash_slot_t *find_slot(const whash_t *map, uint64_t hash, const void *key,
+                               whash_match_fn match) {
+    size_t mask = map->capacity - 1;
+    for (size_t i = (size_t)hash & mask; map->slots[i].element; i = (i + 1) & mask) {
+        whash_slot_t *slot = &map->slots[i];
+        if (slot->hash == hash && match(slot->element, key)) return slot;
+    }
+    return NULL;
+}
+
+/* ============================================================
+ * Lifecycle
+ * ============================================================ */
+
+whash_t* whash_create(size_t initial_capacity, whash_cleanup_fn cleanup_fn) {
+    whash_t *map = malloc(sizeof(whash_t));
+    if (!map) return NULL;
+
+    map->capacity = slot_count_for(initial_capacity);
+    map->slots = calloc(map->capacity, sizeof(whash_slot_t));
+    if (!map->slots) {
+        free(map);
+        return NULL;
+    }
+
+    map->size = 0;
+    map->cleanup_fn = cleanup_fn;
+    return map;
+}
+
+void whash_destroy(whash_t *map) {
+    if (!map) return;
+
+    whash_clear(map);
+    free(map->slots);
+    free(map);
+}
+
+/* ============================================================
+ * Operations
+ * ============================================================ */
+
+bool whash_put(whash_t *map, uint64_t hash, void *element) {
+    if (!map || !element) return false;
+
+    if ((map->size + 1) * WHASH_MAX_LOAD_DEN > map->capacity * WHASH_MAX_LOAD_NUM) {
+        if (!grow(map)) return false;
+    }
+
+    place(map->slots, map->capacity, hash, element);
+    map->size++;
+    return true;
+}
+
+void* whash_get(const whash_t *map, uint64_t hash, const void *key, whash_match_fn match) {
+    if (!map || !match) return NULL;
+
+    whash_slot_t *slot = find_slot(map, hash, key, match);
+    return slot ? slot->element : NULL;
+}
+
+void* whash_remove(whash_t *map, uint64_t hash, const void *key, whash_match_fn match) {
+    if (!map || !match) return NULL;
+
+    whash_slot_t *slot = find_slot(map, hash, key, match);
+    if (!slot) return NULL;
+    void *element = slot->element;
+
+    /* Backward-shift deletion: pull later entries of the probe run into the hole */
+    size_t mask = map->capacity - 1;
+    size_t hole = (size_t)(slot - map->slots);
+    for (size_t i = (hole + 1) & mask; map->slots[i].element; i = (i + 1) & mask) {
+        size_t home = (size_t)map->slots[i].hash & mask;
+        /* Entry at i may move to hole if its home is not in (hole, i] */
+        bool movable = hole <= i ? (home <= hole || home > i) : (home <= hole && home > i);
+        if (movable) {
+            map->slots[hole] = map->slots[i];
+            hole = i;
+        }
+    }
+    map->slots[hole].element = NULL;
+    map->slots[hole].hash = 0;
+
+    map->size--;
+    return element;
+}
+
+void whash_clear(whash_t *map) {
+    if (!map) return;
+
+    for (size_t i = 0; i < map->capacity; i++) {
+        if (map->slots[i].element && map->cleanup_fn) map->cleanup_fn(map->slots[i].element);
+        map->slots[i].element = NULL;
+        map->slots[i].hash = 0;
+    }
+    map->size = 0;
+}
+
+size_t whash_size(const whash_t *map) {
+    return map ? map->size : 0;
+}
+
+/* ============================================================
+ * Hash Functions
+ * ============================================================ */
+
+uint64_t whash_bytes(const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+uint64_t whash_string(const char *str) {
+    return whash_bytes(str, strlen(str));
+}
+
+uint64_t whash_u64(uint64_t value) {
+    /* splitmix64 finalizer */
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9ULL;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111ebULL;
+    value ^= value >> 31;
+    return value;
+}
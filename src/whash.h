@@ -0,0 +1,125 @@
+/*
+ * whash.h - Generic hash table of void* elements
+ *
+ * Open addressing with linear probing over a power-of-two slot array.
+ * The caller hashes keys (whash_bytes/whash_u64) and supplies a match
+ * function; the table stores each element with its hash, so probes only
+ * call the match function on full-hash hits.
+ */
+
+#ifndef WHASH_H
+#define WHASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================
+ * Data Types
+ * ============================================================ */
+
+typedef struct whash whash_t;
+
+/* Match function for lookups
+ * Returns: true if element has the given key
+ */
+typedef bool (*whash_match_fn)(const void *element, const void *key);
+
+/* Cleanup function called on remaining elements when destroying or clearing
+ * Can be NULL if elements don't need cleanup
+ */
+typedef void (*whash_cleanup_fn)(void *element);
+
+/* ============================================================
+ * Lifecycle
+ * ============================================================ */
+
+/**
+ * Create a new hash table
+ *
+ * @param initial_capacity Expected number of elements (0 = default)
+ * @param cleanup_fn Optional function to call when freeing elements (can be NULL)
+ * @return New table or NULL on allocation failure
+ */
+whash_t* whash_create(size_t initial_capacity, whash_cleanup_fn cleanup_fn);
+
+/**
+ * Destroy table and optionally cleanup all elements
+ *
+ * @param map Table to destroy (can be NULL)
+ */
+void whash_destroy(whash_t *map);
+
+/* ============================================================
+ * Operations
+ * ============================================================ */
+
+/**
+ * Insert an element under a hash (no duplicate check: look up first)
+ *
+ * @param map Table
+ * @param hash Hash of the element's key
+ * @param element Element to insert (not NULL)
+ * @return true on success, false on allocation failure
+ */
+bool whash_put(whash_t *map, uint64_t hash, void *element);
+
+/**
+ * Find the element with the given key
+ *
+ * @param map Table
+ * @param hash Hash of key
+ * @param key Key passed to match
+ * @param match Match function
+ * @return Element or NULL if not found
+ */
+void* whash_get(const whash_t *map, uint64_t hash, const void *key, whash_match_fn match);
+
+/**
+ * Remove the element with the given key (cleanup function is NOT called)
+ *
+ * @param map Table
+ * @param hash Hash of key
+ * @param key Key passed to match
+ * @param match Match function
+ * @return Removed element or NULL if not found
+ */
+void* whash_remove(whash_t *map, uint64_t hash, const void *key, whash_match_fn match);
+
+/**
+ * Remove all elements (calls cleanup function if set)
+ *
+ * @param map Table
+ */
+void whash_clear(whash_t *map);
+
+/**
+ * Get number of elements
+ *
+ * @param map Table
+ * @return Number of elements
+ */
+size_t whash_size(const whash_t *map);
+
+/* ============================================================
+ * Hash Functions
+ * ============================================================ */
+
+/* 64-bit FNV-1a of a byte string */
+uint64_t whash_bytes(const void *data, size_t len);
+
+/* Hash of a NUL-terminated string (same as whash_bytes over strlen bytes) */
+uint64_t whash_string(const char *str);
+
+/* Bit mixer for integer keys */
+uint64_t whash_u64(uint64_t value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WHASH_H */
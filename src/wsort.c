@@ -0,0 +1,102 @@
+/*
+ * wsort.c - Generic stable sort with a comparator context
+ *
+ * Bottom-up merge sort with an insertion-sorted base run. Elements are
+ * moved with memcpy, so it is meant for small records (pointers, MDB_val
+ * pairs), not for large structs.
+ */
+
+#include "wsort.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* ============================================================
+ * Constants
+ * ============================================================ */
+
+#define WSORT_INSERTION_RUN 16
+
+/* ============================================================
+ * Internal Helpers
+ * ============================================================ */
+
+static void insertion_sort(char *base, size_t count, size_t size,
+                           wsort_cmp_fn cmp, void *ctx, char *tmp) {
+    for (size_t i = 1; i < count; i++) {
+        char *elem = base + i * size;
+        if (cmp(elem - size, elem, ctx) <= 0) continue;
+
+        memcpy(tmp, elem, size);
+        size_t j = i;
+        while (j > 0 && cmp(base + (j - 1) * size, tmp, ctx) > 0) {
+            j--;
+        }
+        memmove(base + (j + 1) * size, base + j * size, (i - j) * size);
+        memcpy(base + j * size, tmp, size);
+    }
+}
+
+static void merge_runs(const char *src, char *dst, size_t lo, size_t mid, size_t hi,
+                       size_t size, wsort_cmp_fn cmp, void *ctx) {
+    size_t i = lo, j = mid, k = lo;
+    while (i < mid && j < hi) {
+        /* <= keeps the sort stable */
+        if (cmp(src + i * size, src + j * size, ctx) <= 0) {
+            memcpy(dst + k++ * size, src + i++ * size, size);
+        } else {
+            memcpy(dst + k++ * size, src + j++ * size, size);
+        }
+    }
+    if (i < mid) memcpy(dst + k * size, src + i * size, (mid - i) * size);
+    else if (j < hi) memcpy(dst + k * size, src + j * size, (hi - j) * size);
+}
+
+/* ============================================================
+ * Operations
+ * ============================================================ */
+
+bool wsort(void *base, size_t count, size_t size, wsort_cmp_fn cmp, void *ctx) {
+    if (!base || !cmp || size == 0 || count < 2) return true;
+    if (wsort_is_sorted(base, count, size, cmp, ctx)) return true;
+
+    char *buf = malloc(count * size);
+    char *tmp = malloc(size);
+    if (!buf || !tmp) {
+        free(buf);
+        free(tmp);
+        return false;
+    }
+
+    char *src = base;
+    for (size_t lo = 0; lo < count; lo += WSORT_INSERTION_RUN) {
+        size_t n = count - lo < WSORT_INSERTION_RUN ? count - lo : WSORT_INSERTION_RUN;
+        insertion_sort(src + lo * size, n, size, cmp, ctx, tmp);
+    }
+
+    char *dst = buf;
+    for (size_t width = WSORT_INSERTION_RUN; width < count; width *= 2) {
+        for (size_t lo = 0; lo < count; lo += 2 * width) {
+            size_t mid = lo + width < count ? lo + width : count;
+            size_t hi = lo + 2 * width < count ? lo + 2 * width : count;
+            merge_runs(src, dst, lo, mid, hi, size, cmp, ctx);
+        }
+        char *swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    if (src != base) memcpy(base, src, count * size);
+
+    free(tmp);
+    free(buf);
+    return true;
+}
+
+bool wsort_is_sorted(const void *base, size_t count, size_t size,
+                     wsort_cmp_fn cmp, void *ctx) {
+    const char *p = base;
+    for (size_t i = 1; i < count; i++) {
+        if (cmp(p + (i - 1) * size, p + i * size, ctx) > 0) return false;
+    }
+    return true;
+}
@@ -0,0 +1,54 @@
+/*
+ * wsort.h - Generic stable sort with a comparator context
+ *
+ * qsort() has no context argument and qsort_r() differs between platforms;
+ * wtree3 needs to sort with LMDB comparators that depend on a transaction
+ * and DBI, so it carries its own merge sort.
+ */
+
+#ifndef WSORT_H
+#define WSORT_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================
+ * Data Types
+ * ============================================================ */
+
+/* Comparison function: <0, 0, >0 like memcmp; ctx is passed through */
+typedef int (*wsort_cmp_fn)(const void *a, const void *b, void *ctx);
+
+/* ============================================================
+ * Operations
+ * ============================================================ */
+
+/**
+ * Sort an array in place (stable, O(n log n))
+ *
+ * @param base Array to sort
+ * @param count Number of elements
+ * @param size Size of each element in bytes
+ * @param cmp Comparison function
+ * @param ctx Context passed to every cmp call
+ * @return true on success, false on allocation failure (array unchanged)
+ */
+bool wsort(void *base, size_t count, size_t size, wsort_cmp_fn cmp, void *ctx);
+
+/**
+ * Check whether an array is already sorted (non-descending)
+ *
+ * @return true if sorted (always true for count < 2)
+ */
+bool wsort_is_sorted(const void *base, size_t count, size_t size,
+                     wsort_cmp_fn cmp, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WSORT_H */
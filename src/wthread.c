@@ -0,0 +1,217 @@
+/*
+ * wthread.c - Portable threading primitives
+ */
+
+#include "wthread.h"
+#include <stdlib.h>
+
+#if WTREE_OS_WINDOWS
+#include <process.h>
+#else
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#endif
+
+/* ============================================================
+ * Mutex
+ * ============================================================ */
+
+int wmutex_init(wmutex_t *mutex) {
+#if WTREE_OS_WINDOWS
+    InitializeSRWLock(mutex);
+    return 0;
+#else
+    return pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+void wmutex_destroy(wmutex_t *mutex) {
+#if WTREE_OS_WINDOWS
+    (void)mutex;  /* SRW locks need no cleanup */
+#else
+    pthread_mutex_destroy(mutex);
+#endif
+}
+
+void wmutex_lock(wmutex_t *mutex) {
+#if WTREE_OS_WINDOWS
+    AcquireSRWLockExclusive(mutex);
+#else
+    pthread_mutex_lock(mutex);
+#endif
+}
+
+void wmutex_unlock(wmutex_t *mutex) {
+#if WTREE_OS_WINDOWS
+    ReleaseSRWLockExclusive(mutex);
+#else
+    pthread_mutex_unlock(mutex);
+#endif
+}
+
+/* ============================================================
+ * Condition Variable
+ * ============================================================ */
+
+int wcond_init(wcond_t *cond) {
+#if WTREE_OS_WINDOWS
+    InitializeConditionVariable(cond);
+    return 0;
+#else
+    return pthread_cond_init(cond, NULL);
+#endif
+}
+
+void wcond_destroy(wcond_t *cond) {
+#if WTREE_OS_WINDOWS
+    (void)cond;
+#else
+    pthread_cond_destroy(cond);
+#endif
+}
+
+void wcond_signal(wcond_t *cond) {
+#if WTREE_OS_WINDOWS
+    WakeConditionVariable(cond);
+#else
+    pthread_cond_signal(cond);
+#endif
+}
+
+void wcond_broadcast(wcond_t *cond) {
+#if WTREE_OS_WINDOWS
+    WakeAllConditionVariable(cond);
+#else
+    pthread_cond_broadcast(cond);
+#endif
+}
+
+void wcond_wait(wcond_t *cond, wmutex_t *mutex) {
+#if WTREE_OS_WINDOWS
+    SleepConditionVariableSRW(cond, mutex, INFINITE, 0);
+#else
+    pthread_cond_wait(cond, mutex);
+#endif
+}
+
+bool wcond_timedwait(wcond_t *cond, wmutex_t *mutex, uint64_t timeout_us) {
+#if WTREE_OS_WINDOWS
+    DWORD ms = (DWORD)((timeout_us + 999) / 1000);
+    return SleepConditionVariableSRW(cond, mutex, ms, 0) != 0;
+#else
+    /* pthread_cond_timedwait takes an absolute CLOCK_REALTIME deadline */
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint64_t nsec = (uint64_t)ts.tv_nsec + (timeout_us % 1000000) * 1000;
+    ts.tv_sec += (time_t)(timeout_us / 1000000 + nsec / 1000000000);
+    ts.tv_nsec = (long)(nsec % 1000000000);
+    return pthread_cond_timedwait(cond, mutex, &ts) != ETIMEDOUT;
+#endif
+}
+
+/* ============================================================
+ * Threads
+ * ============================================================ */
+
+#if WTREE_OS_WINDOWS
+/* Win32 thread entry points have a different signature - trampoline */
+typedef struct {
+    wthread_fn fn;
+    void *arg;
+} wthread_start_t;
+
+static unsigned __stdcall wthread_trampoline(void *p) {
+    wthread_start_t start = *(wthread_start_t *)p;
+    free(p);
+    start.fn(start.arg);
+    return 0;
+}
+#endif
+
+int wthread_create(wthread_t *thread, wthread_fn fn, void *arg) {
+#if WTREE_OS_WINDOWS
+    wthread_start_t *start = malloc(sizeof(*start));
+    if (!start) return -1;
+    start->fn = fn;
+    start->arg = arg;
+    uintptr_t h = _beginthreadex(NULL, 0, wthread_trampoline, start, 0, NULL);
+    if (h == 0) {
+        free(start);
+        return -1;
+    }
+    *thread = (HANDLE)h;
+    return 0;
+#else
+    return pthread_create(thread, NULL, fn, arg);
+#endif
+}
+
+int wthread_join(wthread_t thread, void **ret) {
+#if WTREE_OS_WINDOWS
+    if (ret) *ret = NULL;  /* Return values are not propagated on Win32 */
+    if (WaitForSingleObject(thread, INFINITE) != WAIT_OBJECT_0) return -1;
+    CloseHandle(thread);
+    return 0;
+#else
+    return pthread_join(thread, ret);
+#endif
+}
+
+unsigned int wthread_cpu_count(void) {
+#if WTREE_OS_WINDOWS
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (unsigned int)info.dwNumberOfProcessors : 1;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (unsigned int)n : 1;
+#else
+    return 1;
+#endif
+}
+
+/* ============================================================
+ * Time
+ * ============================================================ */
+
+uint64_t wtime_now_us(void) {
+#if WTREE_OS_WINDOWS
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    if (freq.QuadPart == 0) QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (uint64_t)(now.QuadPart / freq.QuadPart) * 1000000 +
+           (uint64_t)(now.QuadPart % freq.QuadPart) * 1000000 / (uint64_t)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+#endif
+}
+
+uint64_t wtime_now_ns(void) {
+#if WTREE_OS_WINDOWS
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    if (freq.QuadPart == 0) QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (uint64_t)(now.QuadPart / freq.QuadPart) * 1000000000 +
+           (uint64_t)(now.QuadPart % freq.QuadPart) * 1000000000 / (uint64_t)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+void wtime_sleep_us(uint64_t us) {
+#if WTREE_OS_WINDOWS
+    Sleep((DWORD)((us + 999) / 1000));
+#else
+    struct timespec ts = {.tv_sec = (time_t)(us / 1000000),
+                          .tv_nsec = (long)(us % 1000000) * 1000};
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+#endif
+}
@@ -0,0 +1,259 @@
+/*
+ * wthread.h - Portable threading primitives
+ *
+ * Thin wrappers over pthreads (POSIX) and Win32 SRW locks / condition
+ * variables, so wtree3 modules can coordinate threads without sprinkling
+ * platform #ifdefs over every call site.
+ */
+
+#ifndef WTHREAD_H
+#define WTHREAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "macros.h"
+
+#if WTREE_OS_WINDOWS
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================
+ * Data Types
+ * ============================================================ */
+
+#if WTREE_OS_WINDOWS
+typedef SRWLOCK wmutex_t;
+typedef CONDITION_VARIABLE wcond_t;
+typedef HANDLE wthread_t;
+#else
+typedef pthread_mutex_t wmutex_t;
+typedef pthread_cond_t wcond_t;
+typedef pthread_t wthread_t;
+#endif
+
+/* Thread entry point */
+typedef void* (*wthread_fn)(void *arg);
+
+/* ============================================================
+ * Mutex
+ * ============================================================ */
+
+/**
+ * Initialize a mutex
+ *
+ * @return 0 on success, non-zero on failure
+ */
+int wmutex_init(wmutex_t *mutex);
+
+void wmutex_destroy(wmutex_t *mutex);
+void wmutex_lock(wmutex_t *mutex);
+void wmutex_unlock(wmutex_t *mutex);
+
+/* ============================================================
+ * Condition Variable
+ * ============================================================ */
+
+/**
+ * Initialize a condition variable
+ *
+ * @return 0 on success, non-zero on failure
+ */
+int wcond_init(wcond_t *cond);
+
+void wcond_destroy(wcond_t *cond);
+void wcond_signal(wcond_t *cond);
+void wcond_broadcast(wcond_t *cond);
+
+/* Wait on cond (mutex must be held; re-acquired before returning) */
+void wcond_wait(wcond_t *cond, wmutex_t *mutex);
+
+/**
+ * Wait on cond for at most timeout_us microseconds
+ *
+ * @return true if woken (possibly spuriously), false on timeout
+ */
+bool wcond_timedwait(wcond_t *cond, wmutex_t *mutex, uint64_t timeout_us);
+
+/* ============================================================
+ * Threads
+ * ============================================================ */
+
+/**
+ * Start a new thread running fn(arg)
+ *
+ * @return 0 on success, non-zero on failure
+ */
+int wthread_create(wthread_t *thread, wthread_fn fn, void *arg);
+
+/**
+ * Wait for a thread to finish
+ *
+ * @param ret Output: value returned by the thread function (can be NULL)
+ * @return 0 on success, non-zero on failure
+ */
+int wthread_join(wthread_t thread, void **ret);
+
+/* Number of online CPUs (at least 1) */
+unsigned int wthread_cpu_count(void);
+
+/* ============================================================
+ * Time
+ * ============================================================ */
+
+/* Monotonic clock in microseconds (arbitrary epoch) */
+uint64_t wtime_now_us(void);
+
+/* Monotonic clock in nanoseconds (arbitrary epoch) */
+uint64_t wtime_now_ns(void);
+
+/* Sleep the calling thread for at least us microseconds */
+void wtime_sleep_us(uint64_t us);
+
+/* ============================================================
+ * Atomics (relaxed - counters and flags only, no ordering)
+ * ============================================================ */
+
+#if WTREE_OS_WINDOWS && !WTREE_GCC_LIKE
+static inline void watomic_add_u64(uint64_t *p, uint64_t v) {
+    InterlockedExchangeAdd64((volatile LONG64 *)p, (LONG64)v);
+}
+
+static inline uint64_t watomic_load_u64(const uint64_t *p) {
+    return (uint64_t)InterlockedCompareExchange64((volatile LONG64 *)p, 0, 0);
+}
+
+static inline void watomic_store_u64(uint64_t *p, uint64_t v) {
+    InterlockedExchange64((volatile LONG64 *)p, (LONG64)v);
+}
+
+static inline void watomic_or_u64(uint64_t *p, uint64_t v) {
+    InterlockedOr64((volatile LONG64 *)p, (LONG64)v);
+}
+
+static inline void watomic_max_u64(uint64_t *p, uint64_t v) {
+    LONG64 cur = InterlockedCompareExchange64((volatile LONG64 *)p, 0, 0);
+    while ((uint64_t)cur < v) {
+        LONG64 seen = InterlockedCompareExchange64((volatile LONG64 *)p, (LONG64)v, cur);
+        if (seen == cur) break;
+        cur = seen;
+    }
+}
+
+static inline uint32_t watomic_load_u32(const uint32_t *p) {
+    return *(const volatile uint32_t *)p;
+}
+
+/* Returns the previous value */
+static inline uint32_t watomic_add_u32(uint32_t *p, int32_t v) {
+    return (uint32_t)InterlockedExchangeAdd((volatile LONG *)p, (LONG)v);
+}
+
+static inline void watomic_store_u32(uint32_t *p, uint32_t v) {
+    InterlockedExchange((volatile LONG *)p, (LONG)v);
+}
+#else
+static inline void watomic_add_u64(uint64_t *p, uint64_t v) {
+    __atomic_fetch_add(p, v, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t watomic_load_u64(const uint64_t *p) {
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+static inline void watomic_store_u64(uint64_t *p, uint64_t v) {
+    __atomic_store_n(p, v, __ATOMIC_RELAXED);
+}
+
+static inline void watomic_or_u64(uint64_t *p, uint64_t v) {
+    __atomic_fetch_or(p, v, __ATOMIC_RELAXED);
+}
+
+static inline void watomic_max_u64(uint64_t *p, uint64_t v) {
+    uint64_t cur = __atomic_load_n(p, __ATOMIC_RELAXED);
+    while (cur < v &&
+           !__atomic_compare_exchange_n(p, &cur, v, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+static inline uint32_t watomic_load_u32(const uint32_t *p) {
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+/* Returns the previous value */
+static inline uint32_t watomic_add_u32(uint32_t *p, int32_t v) {
+    return __atomic_fetch_add(p, (uint32_t)v, __ATOMIC_RELAXED);
+}
+
+static inline void watomic_store_u32(uint32_t *p, uint32_t v) {
+    __atomic_store_n(p, v, __ATOMIC_RELAXED);
+}
+#endif
+
+/* ============================================================
+ * Atomics (ordered - publication and grace periods)
+ *
+ * Pointer loads acquire and stores release, so a reader that sees a
+ * published pointer also sees what it points to. The _sc operations are
+ * sequentially consistent: a store followed by a load of another word
+ * cannot be reordered (the pattern epoch-based reclamation relies on).
+ * ============================================================ */
+
+#if WTREE_OS_WINDOWS && !WTREE_GCC_LIKE
+static inline void *watomic_load_ptr(void *const *p) {
+    return InterlockedCompareExchangePointer((PVOID volatile *)p, NULL, NULL);
+}
+
+static inline void watomic_store_ptr(void **p, void *v) {
+    InterlockedExchangePointer((PVOID volatile *)p, v);
+}
+
+static inline uint32_t watomic_sc_load_u32(const uint32_t *p) {
+    return (uint32_t)InterlockedCompareExchange((volatile LONG *)p, 0, 0);
+}
+
+static inline void watomic_sc_store_u32(uint32_t *p, uint32_t v) {
+    InterlockedExchange((volatile LONG *)p, (LONG)v);
+}
+
+/* Returns the previous value */
+static inline uint32_t watomic_sc_add_u32(uint32_t *p, int32_t v) {
+    return (uint32_t)InterlockedExchangeAdd((volatile LONG *)p, (LONG)v);
+}
+#else
+static inline void *watomic_load_ptr(void *const *p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static inline void watomic_store_ptr(void **p, void *v) {
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+static inline uint32_t watomic_sc_load_u32(const uint32_t *p) {
+    return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+}
+
+static inline void watomic_sc_store_u32(uint32_t *p, uint32_t v) {
+    __atomic_store_n(p, v, __ATOMIC_SEQ_CST);
+}
+
+/* Returns the previous value */
+static inline uint32_t watomic_sc_add_u32(uint32_t *p, int32_t v) {
+    return __atomic_fetch_add(p, (uint32_t)v, __ATOMIC_SEQ_CST);
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WTHREAD_H */
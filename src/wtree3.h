@@ -154,23 +154,37 @@
  * - wtree3_scan_range_txn(): Forward range scan with callback
  * - wtree3_scan_reverse_txn(): Reverse range scan
  * - wtree3_scan_prefix_txn(): Prefix-based scan
+ * - wtree3_scan_*_batch_txn(): Same scans, one callback per page of entries
+ * - wtree3_scan_parallel(): Partitioned multi-threaded scan with reduce
+ * - wtree3_index_scan_join_txn(): Index range resolved to main-tree records
  * - wtree3_iterator_*(): Manual cursor-based iteration
  *
  * @subsection batch_ops Batch Operations
  * - wtree3_insert_many_txn(): Batch insert for performance
+ * - wtree3_bulk_load_txn(): Append-only load of pre-sorted data
+ * - wtree3_tree_build_index(): Parallel, sort-based index build
+ * - wtree3_tree_build_index_online(): Chunked, resumable background index build
  * - wtree3_get_many_txn(): Batch read
  * - wtree3_exists_many_txn(): Batch existence check
  * - wtree3_collect_range_txn(): Collect range into arrays
+ * - wtree3_collect_range_result_txn(): Collect range into one arena (or zero-copy)
+ * - wtree3_tree_export(), wtree3_tree_import(): Streaming tree snapshots
+ * - wtree3_db_copy(): Hot (optionally compacted) copy of the environment
+ * - wtree3_changelog_cursor_*(): Incremental consumption of a tree's change log
  *
  * @subsection atomic_ops Atomic Operations
  * - wtree3_modify_txn(): Atomic read-modify-write
  * - wtree3_delete_if_txn(): Conditional bulk delete
- * - wtree3_upsert_txn(): Insert or update with custom merge
+ * - wtree3_delete_range_txn(): Range delete with batched index maintenance
+ * - wtree3_tree_clear(): Empty a tree and its indexes in O(pages)
+ * - wtree3_upsert_txn(): Insert or update with custom merge (single lookup)
+ * - wtree3_tree_enable_combining(): Fold hot-key upserts in memory before writing
  *
  * @subsection mem_ops Memory Optimization
  * - wtree3_db_madvise(): Hint access patterns (random, sequential, willneed)
  * - wtree3_db_mlock(): Lock pages in RAM (prevent swapping)
  * - wtree3_db_prefetch(): Async prefetch for specific ranges
+ * - wtree3_tree_warmup(): Warm a tree and its indexes, branch pages first
  *
  * @section error_sec Error Handling
  *
@@ -191,6 +205,18 @@
  * }
  * @endcode
  *
+ * Hot paths that expect misses can make errors lazy: the code is set at
+ * once, but the message is only formatted when error_message() or
+ * error_message_ex() reads it (read it through those, not the fields).
+ * NOT_FOUND and KEY_EXISTS then cost a couple of stores.
+ *
+ * @code{.c}
+ * gerror_t error = {.flags = GERROR_LAZY};
+ * if (wtree3_get_txn(txn, tree, key, klen, &val, &vlen, &error) == WTREE3_NOT_FOUND) {
+ *     // No vsnprintf ran
+ * }
+ * @endcode
+ *
  * @section thread_safety Thread Safety
  *
  * - Database (wtree3_db_t): Thread-safe, can be shared
@@ -351,6 +377,28 @@ typedef struct wtree3_tree_t wtree3_tree_t;
  */
 typedef struct wtree3_iterator_t wtree3_iterator_t;
 
+/**
+ * @brief Prepared index handle
+ *
+ * An index resolved once by name, with a cached cursor that seeks run on
+ * inside caller-owned transactions. NOT thread-safe - one per thread.
+ *
+ * @see wtree3_index_handle_open()
+ * @see wtree3_index_handle_close()
+ */
+typedef struct wtree3_index_handle_t wtree3_index_handle_t;
+
+/**
+ * @brief Collected result set
+ *
+ * Entries of one wtree3_collect_range_result_txn() call, with copied keys
+ * and values packed into a single arena: freed with one call.
+ *
+ * @see wtree3_collect_range_result_txn()
+ * @see wtree3_result_free()
+ */
+typedef struct wtree3_result_t wtree3_result_t;
+
 /** @} */ /* end of opaque_types group */
 
 /**
@@ -420,6 +468,57 @@ typedef bool (*wtree3_index_key_fn)(
     size_t *out_len
 );
 
+/**
+ * @brief Allocation-free key extraction callback
+ *
+ * Alternative to wtree3_index_key_fn for hot write paths. Instead of
+ * returning a malloc'd key, the extractor writes into a scratch buffer
+ * owned by WTree3, or points straight into the value. Register it with
+ * wtree3_db_register_key_extractor_into().
+ *
+ * **Returning the key:**
+ * - Copied: write the key into `buf` and set `*out_key = buf`
+ * - Zero-copy: set `*out_key` to a slice of `value` (e.g. a fixed-offset field)
+ * - Too large: set `*out_key = NULL` and `*out_len` to the required size;
+ *   WTree3 calls the extractor again with a buffer of at least that size
+ *
+ * The returned key is only used until the next call into the extractor
+ * and is never freed by WTree3.
+ *
+ * @param value       Raw value bytes from main tree
+ * @param value_len   Length of value in bytes
+ * @param user_data   User context from wtree3_index_config_t
+ * @param buf         Scratch buffer the key may be written into
+ * @param buf_cap     Capacity of buf in bytes
+ * @param[out] out_key  Key data (buf, a pointer into value, or NULL to request more space)
+ * @param[out] out_len  Length of extracted key (or required size when out_key is NULL)
+ *
+ * @return true if the entry should be indexed
+ * @return false if field missing/null (skip for sparse index)
+ *
+ * @par Example: Zero-copy fixed-width field
+ * @code{.c}
+ * bool id_extractor(const void *value, size_t value_len, void *user_data,
+ *                   void *buf, size_t buf_cap,
+ *                   const void **out_key, size_t *out_len) {
+ *     (void)user_data; (void)buf; (void)buf_cap;
+ *     if (value_len < 8) return false;
+ *     *out_key = value;   // First 8 bytes of the record
+ *     *out_len = 8;
+ *     return true;
+ * }
+ * @endcode
+ */
+typedef bool (*wtree3_index_key_into_fn)(
+    const void *value,
+    size_t value_len,
+    void *user_data,
+    void *buf,
+    size_t buf_cap,
+    const void **out_key,
+    size_t *out_len
+);
+
 /**
  * @brief Merge callback for upsert operations
  *
@@ -476,6 +575,66 @@ typedef void* (*wtree3_merge_fn)(
     size_t *out_len
 );
 
+/**
+ * @brief Allocation-free merge callback for upsert operations
+ *
+ * Same role as wtree3_merge_fn, but the merged value is written into out
+ * (out_cap bytes) instead of a malloc'd buffer. On trees without indexes
+ * or a value codec, out is space reserved in the database page itself
+ * (MDB_RESERVE), so the merged value is written exactly once, in place.
+ *
+ * **Contract:**
+ * - Set *out_len to the merged length. If it exceeds out_cap, write
+ *   nothing and return true: the callback is called again with room for
+ *   *out_len bytes
+ * - It may therefore run more than once per upsert and must give the
+ *   same result every time (no side effects)
+ * - existing_value never overlaps out
+ * - Return false to fail the upsert (the old value is kept)
+ *
+ * Reserving starts at existing_len, so fixed-size values such as counters
+ * are merged with a single call.
+ *
+ * @param existing_value Current value in database
+ * @param existing_len   Current value length
+ * @param new_value      New value being upserted
+ * @param new_len        New value length
+ * @param user_data      User context from wtree3_tree_set_merge_into_fn()
+ * @param out            Where to write the merged value
+ * @param out_cap        Bytes available at out
+ * @param[out] out_len   Length of the merged value
+ *
+ * @return true on success, false to fail the upsert (WTREE3_ERROR)
+ *
+ * @see wtree3_tree_set_merge_into_fn()
+ *
+ * @par Example: Increment a 64-bit counter
+ * @code{.c}
+ * bool merge_add(const void *existing_value, size_t existing_len,
+ *                const void *new_value, size_t new_len,
+ *                void *user_data, void *out, size_t out_cap, size_t *out_len) {
+ *     uint64_t a, b;
+ *     *out_len = sizeof(uint64_t);
+ *     if (out_cap < sizeof(uint64_t)) return true;
+ *     memcpy(&a, existing_value, sizeof(a));
+ *     memcpy(&b, new_value, sizeof(b));
+ *     a += b;
+ *     memcpy(out, &a, sizeof(a));
+ *     return true;
+ * }
+ * @endcode
+ */
+typedef bool (*wtree3_merge_into_fn)(
+    const void *existing_value,
+    size_t existing_len,
+    const void *new_value,
+    size_t new_len,
+    void *user_data,
+    void *out,
+    size_t out_cap,
+    size_t *out_len
+);
+
 /**
  * @brief Scan callback for range iteration
  *
@@ -522,6 +681,84 @@ typedef bool (*wtree3_scan_fn)(
     void *user_data
 );
 
+/**
+ * @brief One entry of a batch scan page
+ *
+ * Key and value point straight into the LMDB map (zero-copy). Unlike
+ * wtree3_scan_fn arguments they stay valid until the transaction ends,
+ * or until the next write when scanning inside a write transaction.
+ *
+ * @see wtree3_scan_batch_fn
+ */
+typedef struct wtree3_batch_entry {
+    MDB_val key;           /**< Entry key */
+    MDB_val value;         /**< Entry value */
+} wtree3_batch_entry_t;
+
+/**
+ * @brief Batch scan callback - receives one page of entries per call
+ *
+ * Called by the *_batch_txn scans with up to `capacity` entries at a time,
+ * in scan order. Every entry in a page is already inside the requested
+ * range, so the callback can loop over the page without checking bounds.
+ * Pages are never empty; only the last page may be short.
+ *
+ * @param entries   Page of entries (the caller's buffer, overwritten per page)
+ * @param count     Number of entries in the page (>= 1)
+ * @param user_data User context passed to the scan function
+ *
+ * @return true to continue scanning
+ * @return false to stop scanning (early termination)
+ *
+ * @see wtree3_scan_range_batch_txn()
+ */
+typedef bool (*wtree3_scan_batch_fn)(
+    const wtree3_batch_entry_t *entries,
+    size_t count,
+    void *user_data
+);
+
+/**
+ * @brief Reduce callback for parallel scans
+ *
+ * Called by wtree3_scan_parallel() on the calling thread once per
+ * partition, in key order, after all workers have finished. Merges one
+ * worker's partial state into the caller's result.
+ *
+ * @param partial   Worker partial state (opts->partial_size bytes)
+ * @param user_data User context passed to wtree3_scan_parallel()
+ *
+ * @see wtree3_scan_parallel()
+ */
+typedef void (*wtree3_reduce_fn)(void *partial, void *user_data);
+
+/**
+ * @brief Index join callback - one record reached through an index
+ *
+ * Called by wtree3_index_scan_join_txn() and wtree3_index_get_many_txn()
+ * for each index hit, with the main-tree record it points to. All
+ * pointers are zero-copy and valid until the transaction ends; the
+ * callback must not write through the same transaction.
+ *
+ * @param index_key     Index key of the hit
+ * @param index_key_len Index key length
+ * @param main_key      Main tree key
+ * @param main_key_len  Main tree key length
+ * @param value         Main tree value
+ * @param value_len     Main tree value length
+ * @param user_data     User context passed to the join function
+ *
+ * @return true to continue, false to stop early
+ *
+ * @see wtree3_index_scan_join_txn()
+ */
+typedef bool (*wtree3_join_fn)(
+    const void *index_key, size_t index_key_len,
+    const void *main_key, size_t main_key_len,
+    const void *value, size_t value_len,
+    void *user_data
+);
+
 /**
  * @brief Modify callback for atomic read-modify-write operations
  *
@@ -645,6 +882,66 @@ typedef bool (*wtree3_predicate_fn)(
 #define WTREE3_VERSION(major, minor) \
     (((uint32_t)(major) << 16) | (uint16_t)(minor))
 
+/**
+ * @brief Field types of a declarative index key
+ *
+ * Integers are read in host byte order and stored big-endian (signed ones
+ * with the sign bit flipped), so the default lexicographic comparator
+ * orders them numerically.
+ *
+ * @see wtree3_key_spec_t
+ */
+typedef enum wtree3_key_type {
+    WTREE3_KEY_U32 = 1,     /**< uint32_t, 4 key bytes */
+    WTREE3_KEY_U64,         /**< uint64_t, 8 key bytes */
+    WTREE3_KEY_I64,         /**< int64_t, 8 key bytes */
+    WTREE3_KEY_BYTES,       /**< `length` raw bytes */
+    WTREE3_KEY_STRING       /**< NUL-terminated string in a field of `length` bytes */
+} wtree3_key_type_t;
+
+/** One field of a declarative index key */
+typedef struct wtree3_key_part {
+    uint32_t offset;            /**< Byte offset of the field in the value */
+    uint32_t length;            /**< Field size for BYTES/STRING (ignored for integers) */
+    wtree3_key_type_t type;     /**< How the field is read and encoded */
+    bool sparse_if_zero;        /**< Skip the entry when the field is 0, all zero bytes, or "" */
+} wtree3_key_part_t;
+
+/** Most parts a composite key may have */
+#define WTREE3_KEY_PARTS_MAX 8
+
+/**
+ * @brief Declarative index key: fixed-offset fields of a packed value
+ *
+ * Keys are the parts' encodings concatenated in order. A STRING part
+ * contributes its bytes up to the NUL (or the field end); when more parts
+ * follow, a 0x00 terminator keeps composite keys in field order. Keys are
+ * at most 256 bytes.
+ *
+ * Indexes with a spec need no registered extractor and run no callback:
+ * the spec is persisted with the index and applied inline, from multiple
+ * threads if need be. Values too short for a field are skipped by sparse
+ * indexes and rejected by dense ones.
+ *
+ * @par Example: index (country, age) of a packed user struct
+ * @code{.c}
+ * typedef struct { uint64_t id; char country[4]; uint32_t age; } user_t;
+ *
+ * wtree3_key_spec_t spec = {
+ *     .part_count = 2,
+ *     .parts = {
+ *         {.offset = offsetof(user_t, country), .length = 4, .type = WTREE3_KEY_STRING},
+ *         {.offset = offsetof(user_t, age), .type = WTREE3_KEY_U32},
+ *     },
+ * };
+ * wtree3_index_config_t cfg = {.name = "country_age", .key_spec = &spec};
+ * @endcode
+ */
+typedef struct wtree3_key_spec {
+    size_t part_count;                              /**< 1..WTREE3_KEY_PARTS_MAX */
+    wtree3_key_part_t parts[WTREE3_KEY_PARTS_MAX];
+} wtree3_key_spec_t;
+
 /**
  * @brief Index configuration structure
  *
@@ -696,6 +993,41 @@ typedef struct wtree3_index_config {
      * Only applies to non-unique indexes
      */
     MDB_cmp_func *dupsort_compare;
+
+    /**
+     * Covering projection (NULL for a plain index)
+     *
+     * Called like an extractor on the main value; its output is stored in
+     * the index entry next to the main key, so queries that only need the
+     * projected fields never touch the main tree (see
+     * wtree3_index_iterator_payload). The payload is refreshed on every
+     * update. Cannot be combined with dupsort_compare. Register the same
+     * function with wtree3_db_register_projection() so the index can be
+     * loaded when the tree is reopened.
+     */
+    wtree3_index_key_fn project;
+
+    /**
+     * Declarative key (NULL to use the registered extractor)
+     *
+     * Copied and persisted with the index; no extractor needs to be
+     * registered for it, now or at reopen (see wtree3_key_spec_t).
+     */
+    const wtree3_key_spec_t *key_spec;
+
+    /**
+     * Width in bytes of every main key (0 = variable)
+     *
+     * With fixed-width main keys the duplicates of a plain index are
+     * packed contiguously (MDB_DUPFIXED), which shrinks the index and
+     * lets them be read a page at a time (MDB_GET_MULTIPLE). On a tree
+     * opened with MDB_INTEGERKEY (size must then be sizeof(unsigned int)
+     * or sizeof(size_t)) they are also kept in numeric order
+     * (MDB_INTEGERDUP). Writes of other key lengths then fail with
+     * WTREE3_EINVAL. Cannot be combined with project or dupsort_compare.
+     * Persisted with the index.
+     */
+    uint32_t main_key_size;
 } wtree3_index_config_t;
 
 /**
@@ -720,6 +1052,197 @@ typedef struct wtree3_kv {
     size_t value_len;      /**< Value length in bytes (0 for read operations) */
 } wtree3_kv_t;
 
+/**
+ * @brief Group-commit configuration
+ *
+ * Controls how the group-commit batcher trades write latency for commit
+ * frequency. A batch is committed as soon as it holds max_batch writes or
+ * the leader has waited max_wait_us for more writers, whichever comes first.
+ *
+ * **Tuning:**
+ * - max_wait_us = 0: no added latency; batches form naturally from writers
+ *   that queue up while the previous batch is committing
+ * - Larger max_wait_us: fewer, larger commits (fewer fsyncs) at the cost of
+ *   up to max_wait_us extra latency per write
+ *
+ * @see wtree3_db_enable_group_commit()
+ */
+typedef struct wtree3_group_commit_config {
+    size_t max_batch;      /**< Max writes per commit (0 for default of 128) */
+    uint32_t max_wait_us;  /**< Max time the leader waits for the batch to fill */
+} wtree3_group_commit_config_t;
+
+/**
+ * @brief Deferred-sync configuration
+ *
+ * Controls when the flusher thread started by
+ * wtree3_db_enable_deferred_sync() calls mdb_env_sync(). It syncs once per
+ * interval while there are unsynced commits, and early once max_commits
+ * commits or max_bytes written bytes have piled up since the last sync.
+ *
+ * **Tuning:**
+ * - interval_us bounds how much committed work a crash can lose, and how
+ *   long wtree3_txn_commit_durable() waits
+ * - max_commits/max_bytes cap that loss under bursts
+ *
+ * @see wtree3_db_enable_deferred_sync()
+ */
+typedef struct wtree3_durability_config {
+    uint32_t interval_us;  /**< Max time between syncs (0 for default of 10 ms) */
+    uint64_t max_bytes;    /**< Sync early after this many written key+value bytes (0 for no limit) */
+    uint64_t max_commits;  /**< Sync early after this many commits (0 for no limit) */
+} wtree3_durability_config_t;
+
+/**
+ * @brief Index build options
+ *
+ * Controls wtree3_tree_build_index(). A zero-initialized struct gives a
+ * single-threaded build with a 64 MiB sort buffer.
+ *
+ * **Threading:** with threads > 1 the main tree is split into disjoint key
+ * ranges and the index extractor runs concurrently on several threads, so
+ * it must be thread-safe (the built-in extractors and pure functions of
+ * the value are).
+ *
+ * @see wtree3_tree_build_index()
+ */
+typedef struct wtree3_index_build_opts {
+    unsigned int threads;  /**< Extractor threads (0 or 1 for single-threaded) */
+    size_t memory_budget;  /**< Bytes of buffered index entries before spilling to disk (0 for 64 MiB) */
+    const char *tmp_dir;   /**< Directory for spill files (NULL for tmpfile()) */
+} wtree3_index_build_opts_t;
+
+/**
+ * @brief Online index build options
+ *
+ * Controls the chunk size of wtree3_tree_build_index_step(). Each chunk is
+ * one write transaction; it ends after chunk_rows main-tree rows or
+ * chunk_bytes of key+value data, whichever comes first. Smaller chunks
+ * hold the writer lock for less time (lower writer latency), larger
+ * chunks finish the build sooner.
+ *
+ * @see wtree3_tree_build_index_online()
+ */
+typedef struct wtree3_online_build_opts {
+    size_t chunk_rows;     /**< Max rows per chunk (0 for 10000) */
+    size_t chunk_bytes;    /**< Max key+value bytes per chunk (0 for 16 MiB) */
+} wtree3_online_build_opts_t;
+
+/**
+ * @brief Parallel scan options
+ *
+ * Controls wtree3_scan_parallel(). Each worker gets partial_size bytes of
+ * zeroed private state, passed to the scan callback as user_data and
+ * merged afterwards by the reduce callback. With partial_size = 0 the
+ * scan callback receives the caller's user_data directly on every thread
+ * (so it must synchronize itself) and no reduce step runs.
+ *
+ * @see wtree3_scan_parallel()
+ */
+typedef struct wtree3_parallel_scan_opts {
+    unsigned int threads;  /**< Worker threads (0 for one per CPU) */
+    size_t partial_size;   /**< Bytes of per-worker partial state (0 for none) */
+} wtree3_parallel_scan_opts_t;
+
+/** What a verification mismatch is (see wtree3_verify_mismatch_t) */
+typedef enum wtree3_verify_kind {
+    WTREE3_VERIFY_MISSING = 1,      /**< Row has no entry under its index key */
+    WTREE3_VERIFY_MISSING_PK,       /**< Index key exists, but not with the row's primary key */
+    WTREE3_VERIFY_STALE_PAYLOAD,    /**< Covering payload differs from the row's projection */
+    WTREE3_VERIFY_ORPHAN,           /**< Index entry points at a row that does not exist */
+    WTREE3_VERIFY_DUPLICATE         /**< Unique index key has several entries */
+} wtree3_verify_kind_t;
+
+/**
+ * @brief One inconsistency found by wtree3_tree_verify()
+ *
+ * key is the main-tree key for row mismatches and the index key for
+ * ORPHAN and DUPLICATE; pk is the primary key the index entry names
+ * (ORPHAN only, NULL otherwise). Pointers are valid during the callback.
+ */
+typedef struct wtree3_verify_mismatch {
+    wtree3_verify_kind_t kind;
+    const char *index_name;
+    const void *key;
+    size_t key_len;
+    const void *pk;
+    size_t pk_len;
+} wtree3_verify_mismatch_t;
+
+/* Called once per mismatch (serialized across workers); return false to stop */
+typedef bool (*wtree3_verify_fn)(const wtree3_verify_mismatch_t *mismatch, void *user_data);
+
+#define WTREE3_VERIFY_POS_MAX 1024  /* Key plus dup bytes a checkpoint can hold */
+
+/**
+ * @brief Where an unfinished verification stopped
+ *
+ * Plain data - it can be stored anywhere and passed back later, even to
+ * another process. active is false once a walk completed; resuming from
+ * it starts over.
+ */
+typedef struct wtree3_verify_checkpoint {
+    bool active;            /**< There is something to resume */
+    uint32_t pass;          /**< 0 = main-tree rows, 1 = index entries */
+    uint64_t index_id;      /**< Index being walked in pass 1 (name hash) */
+    uint32_t key_len;       /**< 0 = from the start of the pass */
+    uint32_t data_len;      /**< Dup bytes after the key (0 = first dup) */
+    unsigned char pos[WTREE3_VERIFY_POS_MAX];
+} wtree3_verify_checkpoint_t;
+
+/** Outcome of wtree3_tree_verify() */
+typedef struct wtree3_verify_report {
+    uint64_t rows_checked;      /**< Main-tree rows looked up in the indexes */
+    uint64_t entries_checked;   /**< Index entries checked for orphans */
+    uint64_t mismatches;        /**< Mismatches found */
+    uint64_t est_mismatches;    /**< Extrapolated to the whole tree (= mismatches unless sampling) */
+    uint64_t total_rows;        /**< Rows in the tree when the call started */
+    bool complete;              /**< Every pass ran to the end */
+} wtree3_verify_report_t;
+
+/**
+ * @brief Index verification options
+ *
+ * Controls wtree3_tree_verify(). A zero-initialized struct checks every
+ * row on the calling thread under one read snapshot, like
+ * wtree3_verify_indexes() without the orphan pass, and keeps going after
+ * a mismatch.
+ *
+ * **Modes** (freely combined, except that sampling ignores threads and
+ * resume):
+ * - Sampled: sample_rows random rows (and with check_orphans as many
+ *   entries of each index) are checked and the mismatch count is
+ *   extrapolated; analyzed trees are sampled by histogram bucket, so
+ *   skewed keys are drawn by count rather than by key space
+ * - Parallel: each pass is split into key ranges, one thread and read
+ *   transaction each; checks are per row, so no shared snapshot is needed
+ * - Throttled: the walk runs in chunks of chunk_rows, each on a fresh read
+ *   snapshot (a slow walk never pins old pages), sleeping as needed to
+ *   stay under the row and byte rates. drop_pages reads leaf pages ahead
+ *   and releases every page checked (MADV_DONTNEED) after its chunk
+ *
+ * **Resuming:** a walk stopped by max_rows or by the callback writes its
+ * position to checkpoint; pass that back as resume to continue, e.g. a
+ * background job verifying max_rows rows per run.
+ *
+ * @see wtree3_tree_verify()
+ */
+typedef struct wtree3_verify_opts {
+    size_t sample_rows;         /**< Random rows to check (0 to walk every row) */
+    uint64_t seed;              /**< Sampling seed (0 for a time-based one) */
+    unsigned int threads;       /**< Worker threads (0 or 1 for the calling thread) */
+    bool check_orphans;         /**< Also walk every index for orphans and unique violations */
+    size_t chunk_rows;          /**< Rows per read txn (0 for a single snapshot, or 1024 when throttled) */
+    uint64_t max_rows;          /**< Stop after this many rows and entries (0 for no limit) */
+    uint64_t rows_per_sec;      /**< CPU budget: rows and entries per second (0 for no limit) */
+    uint64_t bytes_per_sec;     /**< I/O budget: bytes of pages touched per second (0 for no limit) */
+    bool drop_pages;            /**< Read ahead, then release checked pages */
+    const wtree3_verify_checkpoint_t *resume;   /**< Where to continue (NULL to start over) */
+    wtree3_verify_checkpoint_t *checkpoint;     /**< Output: where the walk stopped (can be NULL) */
+    wtree3_verify_fn on_mismatch;               /**< Mismatch callback (NULL to only count) */
+    void *user_data;                            /**< Passed to on_mismatch */
+} wtree3_verify_opts_t;
+
 /** @} */ /* end of config_types group */
 
 /* ============================================================
@@ -757,6 +1280,14 @@ int wtree3_db_sync(wtree3_db_t *db, bool force, gerror_t *error);
 /* Resize the database map */
 int wtree3_db_resize(wtree3_db_t *db, size_t new_mapsize, gerror_t *error);
 
+/*
+ * Hot copy of the whole environment into path (an existing, empty
+ * directory). With compact the copy is rewritten without free pages, in
+ * key order (MDB_CP_COMPACT). The copy runs under its own read txn, so
+ * writers keep going.
+ */
+int wtree3_db_copy(wtree3_db_t *db, const char *path, bool compact, gerror_t *error);
+
 /* Get current mapsize */
 size_t wtree3_db_get_mapsize(wtree3_db_t *db);
 
@@ -793,96 +1324,377 @@ int wtree3_db_register_key_extractor(
     gerror_t *error
 );
 
-/* ============================================================
- * Memory Optimization API
- * ============================================================ */
+/*
+ * Register an allocation-free key extractor (library maintainer use only)
+ *
+ * Same as wtree3_db_register_key_extractor() but for the scratch-buffer
+ * callback type (see wtree3_index_key_into_fn). Both kinds share one ID
+ * space: a version+flags combination holds either kind, not both.
+ *
+ * Returns: 0 on success, error code on failure
+ */
+int wtree3_db_register_key_extractor_into(
+    wtree3_db_t *db,
+    uint32_t version,
+    uint32_t flags,
+    wtree3_index_key_into_fn key_fn,
+    gerror_t *error
+);
 
 /*
- * Memory access advice flags (portable abstraction over POSIX madvise)
- * Used with wtree3_db_madvise()
+ * Register a covering index projection (library maintainer use only)
+ *
+ * Covering indexes (wtree3_index_config_t.project) persist only the fact
+ * that they are covering; like extractors, the projection function is
+ * looked up by version+flags when the tree is reopened. A covering index
+ * whose projection is not registered is skipped with a warning.
+ *
+ * Returns: 0 on success, error code on failure
  */
-#define WTREE3_MADV_NORMAL      0x00  /* Default behavior */
-#define WTREE3_MADV_RANDOM      0x01  /* Expect random access (disable readahead) */
-#define WTREE3_MADV_SEQUENTIAL  0x02  /* Expect sequential access (aggressive readahead) */
-#define WTREE3_MADV_WILLNEED    0x04  /* Pages will be accessed soon (prefetch) */
-#define WTREE3_MADV_DONTNEED    0x08  /* Pages won't be needed (can free) */
+int wtree3_db_register_projection(
+    wtree3_db_t *db,
+    uint32_t version,
+    uint32_t flags,
+    wtree3_index_key_fn project_fn,
+    gerror_t *error
+);
 
 /*
- * Memory locking flags
- * Used with wtree3_db_mlock()
+ * Encode the index key a spec yields for value (e.g. to build seek keys
+ * from a probe struct)
+ *
+ * Writes at most buf_cap bytes; 256 always suffice.
+ *
+ * Returns: 0 on success, WTREE3_NOT_FOUND if the value would not be
+ *          indexed (too short, or a sparse_if_zero field is zero),
+ *          WTREE3_EINVAL for an invalid spec or a too small buffer
  */
-#define WTREE3_MLOCK_CURRENT    0x01  /* Lock currently mapped pages */
-#define WTREE3_MLOCK_FUTURE     0x02  /* Lock future mapped pages (POSIX only) */
+int wtree3_key_spec_encode(
+    const wtree3_key_spec_t *spec,
+    const void *value, size_t value_len,
+    void *buf, size_t buf_cap,
+    size_t *out_len,
+    gerror_t *error
+);
 
 /*
- * Apply memory access advice to database mapping
+ * Enable group commit for the auto-transaction write wrappers
  *
- * Provides hints to the OS about expected access patterns.
- * Equivalent to POSIX madvise() but portable.
+ * Once enabled, wtree3_insert_one(), wtree3_update(), wtree3_upsert() and
+ * wtree3_delete_one() queue their write instead of committing it alone.
+ * One of the waiting callers becomes the leader and applies the whole
+ * queue in a single write transaction (indexes maintained as usual), then
+ * wakes everyone. Each write runs in a nested transaction, so every caller
+ * still gets its own result code and a failing write does not affect the
+ * others in its batch.
  *
- * @param db Database handle
- * @param advice Advice flags (WTREE3_MADV_*)
- * @param error Error output
- * @return WTREE3_OK on success, error code otherwise
+ * Calling this again while enabled just updates the configuration.
+ * Explicit transactions (wtree3_*_txn) are not affected.
  *
- * Platform support:
- * - Linux/BSD/macOS: Full support (uses madvise)
- * - Windows: Partial support (WILLNEED uses PrefetchVirtualMemory)
- * - Other: Returns error
+ * Parameters:
+ *   db     - Database handle (not MDB_RDONLY, not MDB_WRITEMAP)
+ *   config - Batch limits (NULL for defaults)
+ *   error  - Error output
  *
- * Common patterns:
- * - Random workloads: WTREE3_MADV_RANDOM (disables readahead)
- * - Sequential scans: WTREE3_MADV_SEQUENTIAL (aggressive readahead)
- * - Warming cache: WTREE3_MADV_WILLNEED (prefetch pages)
+ * Returns: 0 on success, WTREE3_EINVAL if the environment cannot nest
+ *          write transactions
  */
-int wtree3_db_madvise(wtree3_db_t *db, unsigned int advice, gerror_t *error);
+int wtree3_db_enable_group_commit(
+    wtree3_db_t *db,
+    const wtree3_group_commit_config_t *config,
+    gerror_t *error
+);
 
 /*
- * Lock database pages in physical memory (prevent swapping)
+ * Disable group commit
  *
- * Locks the database memory map in RAM, preventing it from being
- * swapped to disk. Useful for latency-sensitive applications.
+ * Waits for queued writes to finish, then returns the write wrappers to
+ * one-transaction-per-call. Must not race with new writes on this database.
+ */
+void wtree3_db_disable_group_commit(wtree3_db_t *db);
+
+/*
+ * Enable deferred sync
  *
- * @param db Database handle
- * @param flags Locking flags (WTREE3_MLOCK_*)
- * @param error Error output
- * @return WTREE3_OK on success, error code otherwise
+ * Switches the environment to MDB_NOSYNC and starts a flusher thread that
+ * syncs per the configuration. Commits then return without an fsync and
+ * are durable once the next sync completes; a crash loses at most the
+ * commits since the last sync, never consistency. Callers that need a
+ * commit on disk use wtree3_txn_commit_durable() or
+ * wtree3_db_wait_durable().
  *
- * Platform support:
- * - Linux/BSD/macOS: Full support (uses mlock/mlockall)
- * - Windows: Full support (uses VirtualLock)
+ * Calling this again while enabled just updates the configuration.
+ * wtree3_db_close() disables it (after a final sync).
  *
- * Notes:
- * - May require elevated privileges (CAP_IPC_LOCK on Linux)
- * - Locks only currently mapped region; grows with database
- * - Can degrade system performance if too much memory locked
- * - MLOCK_FUTURE flag uses mlockall(MCL_FUTURE) on POSIX
+ * Parameters:
+ *   db     - Database handle (not MDB_RDONLY)
+ *   config - Sync triggers (NULL for defaults)
+ *   error  - Error output
  *
- * Recommendation: Only lock if database < 50% of system RAM
+ * Returns: 0 on success, error code on failure
  */
-int wtree3_db_mlock(wtree3_db_t *db, unsigned int flags, gerror_t *error);
+int wtree3_db_enable_deferred_sync(
+    wtree3_db_t *db,
+    const wtree3_durability_config_t *config,
+    gerror_t *error
+);
 
 /*
- * Unlock database pages (allow swapping)
+ * Disable deferred sync
  *
- * Reverses the effect of wtree3_db_mlock(), allowing pages to be
- * swapped to disk again.
+ * Syncs once more, stops the flusher and restores synchronous commits
+ * (unless the environment was opened with MDB_NOSYNC). Must not race
+ * with commits or durability waits on this database.
+ */
+void wtree3_db_disable_deferred_sync(wtree3_db_t *db);
+
+/*
+ * Commit and wait until the commit is on disk
  *
- * @param db Database handle
- * @param error Error output
- * @return WTREE3_OK on success, error code otherwise
+ * With deferred sync the caller waits for the flusher's next sync, which
+ * it shares with every commit made meanwhile. Without it this is
+ * wtree3_txn_commit(), plus an explicit sync if the environment was
+ * opened with MDB_NOSYNC/MDB_NOMETASYNC/MDB_MAPASYNC.
  *
- * Platform support:
- * - Linux/BSD/macOS: Full support (uses munlock)
- * - Windows: Full support (uses VirtualUnlock)
+ * Returns: 0 once durable, error code if the commit or the sync failed
+ *          (a failed sync leaves the commit applied but not yet durable)
  */
-int wtree3_db_munlock(wtree3_db_t *db, gerror_t *error);
+int wtree3_txn_commit_durable(wtree3_txn_t *txn, gerror_t *error);
 
 /*
- * Get memory mapping information
+ * Wait until every commit made so far is on disk
  *
- * Returns the address and size of the database memory map.
- * Useful for advanced memory management or custom optimizations.
+ * For writes done through the auto-transaction wrappers: call this after
+ * them to get the same guarantee as wtree3_txn_commit_durable().
+ *
+ * Returns: 0 once durable, error code if the sync failed
+ */
+int wtree3_db_wait_durable(wtree3_db_t *db, gerror_t *error);
+
+/*
+ * Configure the read transaction pool
+ *
+ * The auto-transaction read APIs (wtree3_get(), wtree3_exists(),
+ * wtree3_iterator_create(), wtree3_index_seek*() and internal read
+ * helpers) take their read-only transaction from a per-database pool
+ * instead of beginning a new one. Idle transactions are kept reset
+ * (mdb_txn_reset) and renewed on reuse, and keep their cursors open so
+ * repeated iterators and index seeks skip cursor allocation too.
+ *
+ * The pool is enabled by default and keeps up to 16 idle transactions.
+ * Idle transactions hold no snapshot. With MDB_NOTLS each one does keep a
+ * reader slot, so size the pool below the environment's max readers.
+ *
+ * Parameters:
+ *   db       - Database handle
+ *   max_txns - Max idle transactions kept (0 disables pooling)
+ *   error    - Error output
+ *
+ * Returns: 0 on success, error code on failure
+ */
+int wtree3_db_set_read_pool_size(
+    wtree3_db_t *db,
+    size_t max_txns,
+    gerror_t *error
+);
+
+/* ============================================================
+ * Metrics
+ *
+ * Optional instrumentation, off by default. While disabled every
+ * instrumented call pays one predictable branch; building with
+ * -DWTREE3_ENABLE_METRICS=OFF removes even that.
+ * ============================================================ */
+
+/* Instrumented operations (wtree3_metrics_t.ops / wtree3_counters_t.ops) */
+typedef enum {
+    WTREE3_METRIC_GET = 0,          /* wtree3_get_txn */
+    WTREE3_METRIC_INSERT,           /* wtree3_insert_one_txn (index: entries added) */
+    WTREE3_METRIC_UPDATE,           /* wtree3_update_txn */
+    WTREE3_METRIC_UPSERT,           /* wtree3_upsert_txn */
+    WTREE3_METRIC_DELETE,           /* wtree3_delete_one_txn (index: entries removed) */
+    WTREE3_METRIC_SCAN,             /* Range/prefix/reverse scans, get_many, delete_if, collect */
+    WTREE3_METRIC_INDEX_MAINT,      /* Index maintenance of one write, all indexes */
+    WTREE3_METRIC_EXTRACT,          /* Extractor calls on the write path */
+    WTREE3_METRIC_UNIQUE_CHECK,     /* Unique constraint probes */
+    WTREE3_METRIC_COMMIT,           /* Write txn commits, including fsync */
+    WTREE3_METRIC_SYNC,             /* wtree3_db_sync */
+    WTREE3_METRIC_COUNT
+} wtree3_metric_op_t;
+
+/* Error kinds counted from LMDB results (wtree3_metrics_t.errors) */
+typedef enum {
+    WTREE3_METRIC_ERR_NOT_FOUND = 0,
+    WTREE3_METRIC_ERR_KEY_EXISTS,
+    WTREE3_METRIC_ERR_MAP_FULL,
+    WTREE3_METRIC_ERR_TXN_FULL,
+    WTREE3_METRIC_ERR_OTHER,
+    WTREE3_METRIC_ERR_COUNT
+} wtree3_metric_err_t;
+
+/*
+ * Summary of one log-linear histogram
+ *
+ * Buckets are 4 per power of two (HdrHistogram-style, ~25% precision);
+ * percentiles report the upper edge of their bucket.
+ */
+typedef struct wtree3_histogram {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t p50;
+    uint64_t p99;
+    uint64_t p999;
+} wtree3_histogram_t;
+
+/* Database-wide snapshot (see wtree3_db_metrics) */
+typedef struct wtree3_metrics {
+    wtree3_histogram_t ops[WTREE3_METRIC_COUNT];  /* Latencies in nanoseconds */
+    wtree3_histogram_t commit_bytes;              /* Key+value bytes written per commit */
+    uint64_t errors[WTREE3_METRIC_ERR_COUNT];     /* Translated LMDB errors */
+} wtree3_metrics_t;
+
+/* Per-tree or per-index operation counts (see wtree3_tree_metrics) */
+typedef struct wtree3_counters {
+    uint64_t ops[WTREE3_METRIC_COUNT];
+} wtree3_counters_t;
+
+/*
+ * Enable or disable metrics collection
+ *
+ * Counters live in per-thread shards, so enabled collection adds two
+ * clock reads and a few uncontended atomic adds per operation. Disabling
+ * keeps the collected values; re-enabling continues from them. Do not
+ * call concurrently with itself or wtree3_db_close().
+ *
+ * Commit sizes are the key and value bytes passed to the write calls of
+ * the committing thread. LMDB error counts are process-wide (errors have
+ * no database attached) and collected while any database has metrics on.
+ *
+ * Returns: 0 on success, WTREE3_ENOMEM, or WTREE3_ERROR if metrics were
+ *          compiled out
+ */
+int wtree3_db_enable_metrics(wtree3_db_t *db, bool enable, gerror_t *error);
+
+/*
+ * Snapshot the database-wide metrics
+ *
+ * Safe to call while other threads are recording; the snapshot is not
+ * atomic across counters. All zero if metrics were never enabled.
+ *
+ * Returns: 0 on success, error code on failure
+ */
+int wtree3_db_metrics(wtree3_db_t *db, wtree3_metrics_t *out, gerror_t *error);
+
+/* Zero the database-wide metrics of db (tree handle counts are kept) */
+void wtree3_db_metrics_reset(wtree3_db_t *db);
+
+/*
+ * Operation counts of a tree handle (index_name NULL) or one of its indexes
+ *
+ * Trees count their GET/INSERT/UPDATE/UPSERT/DELETE/SCAN/INDEX_MAINT
+ * calls; indexes count EXTRACT, UNIQUE_CHECK, and entries added (INSERT)
+ * and removed (DELETE). Counts belong to the handle, not the stored tree.
+ *
+ * Returns: 0 on success, WTREE3_NOT_FOUND if the index does not exist
+ */
+int wtree3_tree_metrics(
+    wtree3_tree_t *tree,
+    const char *index_name,
+    wtree3_counters_t *out,
+    gerror_t *error
+);
+
+/* ============================================================
+ * Memory Optimization API
+ * ============================================================ */
+
+/*
+ * Memory access advice flags (portable abstraction over POSIX madvise)
+ * Used with wtree3_db_madvise()
+ */
+#define WTREE3_MADV_NORMAL      0x00  /* Default behavior */
+#define WTREE3_MADV_RANDOM      0x01  /* Expect random access (disable readahead) */
+#define WTREE3_MADV_SEQUENTIAL  0x02  /* Expect sequential access (aggressive readahead) */
+#define WTREE3_MADV_WILLNEED    0x04  /* Pages will be accessed soon (prefetch) */
+#define WTREE3_MADV_DONTNEED    0x08  /* Pages won't be needed (can free) */
+
+/*
+ * Memory locking flags
+ * Used with wtree3_db_mlock()
+ */
+#define WTREE3_MLOCK_CURRENT    0x01  /* Lock currently mapped pages */
+#define WTREE3_MLOCK_FUTURE     0x02  /* Lock future mapped pages (POSIX only) */
+
+/*
+ * Apply memory access advice to database mapping
+ *
+ * Provides hints to the OS about expected access patterns.
+ * Equivalent to POSIX madvise() but portable.
+ *
+ * @param db Database handle
+ * @param advice Advice flags (WTREE3_MADV_*)
+ * @param error Error output
+ * @return WTREE3_OK on success, error code otherwise
+ *
+ * Platform support:
+ * - Linux/BSD/macOS: Full support (uses madvise)
+ * - Windows: Partial support (WILLNEED uses PrefetchVirtualMemory)
+ * - Other: Returns error
+ *
+ * Common patterns:
+ * - Random workloads: WTREE3_MADV_RANDOM (disables readahead)
+ * - Sequential scans: WTREE3_MADV_SEQUENTIAL (aggressive readahead)
+ * - Warming cache: WTREE3_MADV_WILLNEED (prefetch pages)
+ */
+int wtree3_db_madvise(wtree3_db_t *db, unsigned int advice, gerror_t *error);
+
+/*
+ * Lock database pages in physical memory (prevent swapping)
+ *
+ * Locks the database memory map in RAM, preventing it from being
+ * swapped to disk. Useful for latency-sensitive applications.
+ *
+ * @param db Database handle
+ * @param flags Locking flags (WTREE3_MLOCK_*)
+ * @param error Error output
+ * @return WTREE3_OK on success, error code otherwise
+ *
+ * Platform support:
+ * - Linux/BSD/macOS: Full support (uses mlock/mlockall)
+ * - Windows: Full support (uses VirtualLock)
+ *
+ * Notes:
+ * - May require elevated privileges (CAP_IPC_LOCK on Linux)
+ * - Locks only currently mapped region; grows with database
+ * - Can degrade system performance if too much memory locked
+ * - MLOCK_FUTURE flag uses mlockall(MCL_FUTURE) on POSIX
+ *
+ * Recommendation: Only lock if database < 50% of system RAM
+ */
+int wtree3_db_mlock(wtree3_db_t *db, unsigned int flags, gerror_t *error);
+
+/*
+ * Unlock database pages (allow swapping)
+ *
+ * Reverses the effect of wtree3_db_mlock(), allowing pages to be
+ * swapped to disk again.
+ *
+ * @param db Database handle
+ * @param error Error output
+ * @return WTREE3_OK on success, error code otherwise
+ *
+ * Platform support:
+ * - Linux/BSD/macOS: Full support (uses munlock)
+ * - Windows: Full support (uses VirtualUnlock)
+ */
+int wtree3_db_munlock(wtree3_db_t *db, gerror_t *error);
+
+/*
+ * Get memory mapping information
+ *
+ * Returns the address and size of the database memory map.
+ * Useful for advanced memory management or custom optimizations.
  *
  * @param db Database handle
  * @param out_addr Output: memory map address (can be NULL)
@@ -925,6 +1737,51 @@ int wtree3_db_prefetch(wtree3_db_t *db,
                        size_t length,
                        gerror_t *error);
 
+/* Warmup flags */
+#define WTREE3_WARMUP_INDEXES        0x01  /* Also warm the tree's indexes */
+#define WTREE3_WARMUP_LOCK_BRANCHES  0x02  /* mlock the branch pages warmed */
+#define WTREE3_WARMUP_BRANCHES_ONLY  0x04  /* Skip leaf pages */
+
+/* What a warmup covered (see wtree3_tree_warmup) */
+typedef struct wtree3_warmup_stats {
+    uint64_t branch_pages;
+    uint64_t leaf_pages;
+    uint64_t bytes;
+} wtree3_warmup_stats_t;
+
+/*
+ * Warm the pages of a tree (and optionally its indexes) into cache
+ *
+ * Unlike wtree3_db_prefetch(), which needs raw map offsets, this walks
+ * the B-trees themselves: the branch levels of every tree are fetched
+ * first, level by level, since every lookup goes through them; leaf
+ * pages are then prefetched in sorted runs until the budget is spent.
+ * Leaf hints are asynchronous; the branch walk reads its pages, so run
+ * this from a background thread for large trees (it is thread-safe and
+ * uses its own read transaction).
+ *
+ * WTREE3_WARMUP_LOCK_BRANCHES additionally mlocks the branch pages so
+ * they stay resident; undo with wtree3_db_munlock().
+ *
+ * @param tree Tree handle
+ * @param flags WTREE3_WARMUP_* flags
+ * @param budget_bytes Max bytes to warm, branch pages first (0 for no limit)
+ * @param out Output: pages and bytes covered (can be NULL)
+ * @param error Error output
+ * @return WTREE3_OK on success, WTREE3_ERROR if locking failed (pages
+ *         are still prefetched)
+ *
+ * Notes:
+ * - Overflow pages (large values) and the subtrees of index keys with
+ *   many duplicates are not prefetched
+ * - Pages changed after the call are not covered
+ */
+int wtree3_tree_warmup(wtree3_tree_t *tree,
+                       unsigned int flags,
+                       size_t budget_bytes,
+                       wtree3_warmup_stats_t *out,
+                       gerror_t *error);
+
 /* ============================================================
  * Transaction Operations
  * ============================================================ */
@@ -972,8 +1829,11 @@ wtree3_db_t* wtree3_txn_get_db(wtree3_txn_t *txn);
  * Parameters:
  *   db          - Database handle
  *   name        - Tree name (e.g., "users")
- *   flags       - LMDB flags (MDB_CREATE to create if not exists)
- *   entry_count - Initial entry count (0 for new, persisted value for existing)
+ *   flags       - LMDB flags (MDB_CREATE to create if not exists;
+ *                 MDB_INTEGERKEY for native unsigned int / size_t keys).
+ *                 An existing tree keeps the flags it was created with.
+ *   entry_count - Ignored; kept for source compatibility. Entry counts are
+ *                 persisted by LMDB and read back in O(1) (see wtree3_tree_count)
  *   error       - Error output
  *
  * Note: This function automatically loads all persisted indexes for the tree
@@ -996,11 +1856,41 @@ void wtree3_tree_close(wtree3_tree_t *tree);
 /* Delete a tree and all its indexes */
 int wtree3_tree_delete(wtree3_db_t *db, const char *name, gerror_t *error);
 
+/*
+ * Remove every entry of a tree, keeping the tree and its index definitions
+ *
+ * The main DBI and every index DBI are emptied with mdb_drop(dbi, 0), which
+ * frees their pages without visiting the rows: cost depends on the page
+ * count, not on extractors or per-row deletes. The entry count LMDB keeps
+ * with each DBI drops to 0 with it. Key filters stay allocated and count
+ * the dropped keys as removed (see wtree3_tree_filter_stats).
+ *
+ * Parameters:
+ *   deleted_out - Output: number of entries removed (can be NULL)
+ *
+ * Returns: 0 on success, error code on failure
+ */
+int wtree3_tree_clear_txn(wtree3_txn_t *txn, wtree3_tree_t *tree,
+                          size_t *deleted_out, gerror_t *error);
+int wtree3_tree_clear(wtree3_tree_t *tree, size_t *deleted_out, gerror_t *error);
+
 /* Get tree name */
 const char* wtree3_tree_name(wtree3_tree_t *tree);
 
-/* Get current entry count */
+/*
+ * Get current entry count
+ *
+ * Read in O(1) from the count LMDB persists with the tree, so it is exact
+ * after reopen, after aborted transactions and with several processes
+ * sharing the environment. wtree3_tree_count() sees the last committed
+ * state (it uses a pooled read txn - call the _txn variant from a thread
+ * that already holds a read txn); wtree3_tree_count_txn() includes the
+ * uncommitted writes of txn.
+ *
+ * Returns: entry count, 0 for a NULL tree, -1 if it cannot be read
+ */
 int64_t wtree3_tree_count(wtree3_tree_t *tree);
+int64_t wtree3_tree_count_txn(wtree3_txn_t *txn, wtree3_tree_t *tree);
 
 /* Get parent database from tree */
 wtree3_db_t* wtree3_tree_get_db(wtree3_tree_t *tree);
@@ -1008,9 +1898,13 @@ wtree3_db_t* wtree3_tree_get_db(wtree3_tree_t *tree);
 /* Set custom key comparison function */
 int wtree3_tree_set_compare(wtree3_tree_t *tree, MDB_cmp_func *cmp, gerror_t *error);
 
-/* Set merge callback for upsert operations */
+/* Set merge callback for upsert operations (clears a merge_into callback) */
 void wtree3_tree_set_merge_fn(wtree3_tree_t *tree, wtree3_merge_fn merge_fn, void *user_data);
 
+/* Set allocation-free merge callback for upsert operations (clears a merge callback) */
+void wtree3_tree_set_merge_into_fn(wtree3_tree_t *tree, wtree3_merge_into_fn merge_fn,
+                                   void *user_data);
+
 /* ============================================================
  * Index Management
  * ============================================================ */
@@ -1023,6 +1917,10 @@ void wtree3_tree_set_merge_fn(wtree3_tree_t *tree, wtree3_merge_fn merge_fn, voi
  *
  * Index tree naming: idx:<tree_name>:<index_name>
  *
+ * Safe while other threads read and write the tree: writes that started
+ * before the index became visible do not maintain it, so populate or
+ * build it afterwards. Adds and drops on one tree run one at a time.
+ *
  * Returns: 0 on success, error code on failure
  */
 int wtree3_tree_add_index(
@@ -1045,8 +1943,100 @@ int wtree3_tree_populate_index(
     gerror_t *error
 );
 
+/*
+ * Build an index from existing tree entries (sort-based)
+ *
+ * Same result as wtree3_tree_populate_index(), which calls this with
+ * default options. The build runs in three stages inside one write
+ * transaction, so it either fully succeeds or leaves the index untouched:
+ *   1. Workers walk disjoint key ranges of the main tree (each under its
+ *      own read transaction of the same snapshot) and run the extractor
+ *   2. (index key, main key) pairs are sorted in memory; once a worker's
+ *      buffer exceeds its share of memory_budget the sorted run is spilled
+ *      to a temporary file
+ *   3. All runs are merged and written in order - with MDB_APPEND when the
+ *      index is empty - and unique violations are detected as adjacent
+ *      duplicates during the merge
+ *
+ * Parameters:
+ *   tree       - Tree handle
+ *   index_name - Index to build (added with wtree3_tree_add_index())
+ *   opts       - Build options (NULL for defaults)
+ *   error      - Error output
+ *
+ * Returns: 0 on success, WTREE3_INDEX_ERROR on unique violation
+ */
+int wtree3_tree_build_index(
+    wtree3_tree_t *tree,
+    const char *index_name,
+    const wtree3_index_build_opts_t *opts,
+    gerror_t *error
+);
+
+/*
+ * Run one chunk of an online (background) index build
+ *
+ * Unlike wtree3_tree_build_index(), an online build never holds the writer
+ * lock for long: every call indexes one bounded chunk of rows in its own
+ * write transaction and saves a progress cursor (the last main key
+ * indexed) in the index metadata. Other writers proceed between chunks
+ * and keep the index in sync for keys the build has already passed.
+ *
+ * The first call clears the index and starts the build. Until the last
+ * chunk completes, the index is hidden from wtree3_index_seek() (returns
+ * WTREE3_NOT_FOUND) and skipped by wtree3_verify_indexes(). An interrupted
+ * build resumes from the persisted cursor after the tree is reopened.
+ *
+ * On a unique violation the build stops with WTREE3_INDEX_ERROR and stays
+ * in progress; fix the data and call again, or drop the index.
+ *
+ * Parameters:
+ *   tree       - Tree handle
+ *   index_name - Index to build (added with wtree3_tree_add_index())
+ *   opts       - Chunk limits (NULL for defaults)
+ *   done       - Output: true once the build has completed (can be NULL)
+ *   error      - Error output
+ *
+ * Returns: 0 on success, WTREE3_INDEX_ERROR on unique violation
+ */
+int wtree3_tree_build_index_step(
+    wtree3_tree_t *tree,
+    const char *index_name,
+    const wtree3_online_build_opts_t *opts,
+    bool *done,
+    gerror_t *error
+);
+
+/*
+ * Run an online index build to completion
+ *
+ * Calls wtree3_tree_build_index_step() until done. Meant to be run from a
+ * background thread; writers on other threads interleave between chunks.
+ *
+ * Returns: 0 on success, error code on failure (build stays resumable)
+ */
+int wtree3_tree_build_index_online(
+    wtree3_tree_t *tree,
+    const char *index_name,
+    const wtree3_online_build_opts_t *opts,
+    gerror_t *error
+);
+
+/*
+ * Check if an online build of an index is still in progress
+ */
+bool wtree3_index_is_building(wtree3_tree_t *tree, const char *index_name);
+
 /*
  * Drop an index from a tree
+ *
+ * Safe while other threads read and write the tree: the index disappears
+ * from new operations at once and is freed after the ones already running
+ * finish (the call waits for them). Iterators, prepared handles and query
+ * streams opened on the index itself must be closed first. Called from a
+ * callback of a running operation it cannot wait for itself: the index
+ * tree is then emptied but left in the environment, and its memory is
+ * freed by a later add/drop or when the tree is closed.
  */
 int wtree3_tree_drop_index(
     wtree3_tree_t *tree,
@@ -1069,11 +2059,38 @@ size_t wtree3_tree_index_count(wtree3_tree_t *tree);
  * 3. Checks for orphaned index entries
  * 4. Validates unique constraints
  *
+ * Indexes with an online build in progress are skipped.
+ *
  * Returns: 0 if all indexes are consistent, WTREE3_INDEX_ERROR if inconsistencies found
  * The error parameter will contain details about the first inconsistency detected.
  */
 int wtree3_verify_indexes(wtree3_tree_t *tree, gerror_t *error);
 
+/*
+ * Verify index consistency incrementally
+ *
+ * The engine behind wtree3_verify_indexes(), for trees too large to
+ * check in one go: it can sample, split the work across threads, pace
+ * itself, and stop and resume at a checkpoint (see wtree3_verify_opts_t).
+ * Every mismatch goes to opts->on_mismatch instead of ending the check.
+ * Must not be called from a thread that holds a write transaction on
+ * the same database.
+ *
+ * Parameters:
+ *   opts   - Mode, budgets, checkpoints and callback (NULL for defaults)
+ *   report - Output: what was checked and found (can be NULL)
+ *
+ * Returns: 0 if no mismatch was found (the walk may be incomplete, see
+ * report->complete), WTREE3_INDEX_ERROR if any was (error describes the
+ * first), or an error code on failure (the checkpoint is still written)
+ */
+int wtree3_tree_verify(
+    wtree3_tree_t *tree,
+    const wtree3_verify_opts_t *opts,
+    wtree3_verify_report_t *report,
+    gerror_t *error
+);
+
 /*
  * Check if a tree/DB exists without creating it
  *
@@ -1107,73 +2124,323 @@ int wtree3_index_get_extractor_id(
 );
 
 /* ============================================================
- * Data Operations (With Transaction)
- *
- * These operations automatically maintain all registered indexes.
+ * Statistics and Cardinality Estimation
  * ============================================================ */
 
 /*
- * Get value by key (zero-copy)
+ * Statistics of a tree or index as of its last analyze
  *
- * Returned value is valid only during transaction.
+ * For an index, entries counts (index key, main key) pairs, so
+ * entries / distinct_keys is the average number of rows per index key.
+ */
+typedef struct wtree3_stats {
+    uint64_t entries;               /* Entries when analyzed */
+    uint64_t distinct_keys;         /* Distinct keys (== entries for the main tree) */
+    uint64_t max_dups;              /* Most entries sharing one key */
+    uint32_t samples;               /* Histogram buckets stored */
+} wtree3_stats_t;
+
+/*
+ * Analyze a tree and all of its indexes
  *
- * Returns: 0 on success, WTREE3_NOT_FOUND if key doesn't exist
+ * Walks each one once under a single read snapshot and stores an
+ * equi-depth histogram (up to 64 buckets) plus key counts in the metadata
+ * DB, replacing earlier statistics. The writer lock is only held to store
+ * the results. Indexes with an online build in progress are skipped.
+ *
+ * Statistics are not updated by writes; estimates are scaled by the live
+ * entry count instead, so re-analyze after large or skewed changes.
+ *
+ * Returns: 0 on success, error code on failure
  */
-int wtree3_get_txn(
-    wtree3_txn_t *txn,
-    wtree3_tree_t *tree,
-    const void *key, size_t key_len,
-    const void **value, size_t *value_len,
-    gerror_t *error
-);
+int wtree3_tree_analyze(wtree3_tree_t *tree, gerror_t *error);
 
 /*
- * Insert a key-value pair
+ * Analyze a single index (see wtree3_tree_analyze)
  *
- * Automatically:
- * - Checks unique constraints on all indexes
- * - Inserts into all index trees
- * - Increments entry count
+ * Returns: 0 on success, WTREE3_NOT_FOUND if the index does not exist or
+ *          is still being built
+ */
+int wtree3_index_analyze(wtree3_tree_t *tree, const char *index_name, gerror_t *error);
+
+/*
+ * Read the stored statistics of a tree (index_name NULL) or index
  *
- * Returns: 0 on success, WTREE3_KEY_EXISTS on duplicate key,
- *          WTREE3_INDEX_ERROR on unique index violation
+ * Returns: 0 on success, WTREE3_NOT_FOUND if never analyzed
  */
-int wtree3_insert_one_txn(
+int wtree3_stats_get_txn(
     wtree3_txn_t *txn,
     wtree3_tree_t *tree,
-    const void *key, size_t key_len,
-    const void *value, size_t value_len,
+    const char *index_name,
+    wtree3_stats_t *out,
     gerror_t *error
 );
 
 /*
- * Update an existing key's value
+ * Estimate how many entries fall in [start_key, end_key]
  *
- * Automatically:
- * - Removes old index entries
- * - Checks unique constraints for new index keys
- * - Inserts new index entries
+ * Counts main-tree entries (index_name NULL) or index entries, i.e. rows
+ * reachable through the index. NULL bounds are open. Meant for choosing
+ * between an index seek and a scan, or sizing wtree3_collect_range_txn()
+ * buffers - not for exact counts, except:
+ * - start == end is exact (one lookup; mdb_cursor_count for an index)
+ * - trees/indexes never analyzed yield the live entry count (upper bound)
  *
- * Note: Does NOT change entry count (key already exists)
+ * Otherwise the cost is a binary search of the stored histogram, and the
+ * result is within about one bucket (entries/64) of the true count as of
+ * the analyze, scaled to the current entry count.
  *
- * Returns: 0 on success, WTREE3_NOT_FOUND if key doesn't exist
+ * Parameters:
+ *   txn           - Transaction (read or write)
+ *   tree          - Tree handle
+ *   index_name    - Index to estimate through, or NULL for the main tree
+ *   start_key     - Inclusive lower bound (NULL = first key)
+ *   end_key       - Inclusive upper bound (NULL = last key)
+ *   out_estimate  - Output: estimated entry count
+ *
+ * Returns: 0 on success, WTREE3_NOT_FOUND if the index does not exist or
+ *          is still being built
  */
-int wtree3_update_txn(
+int wtree3_estimate_range_txn(
     wtree3_txn_t *txn,
     wtree3_tree_t *tree,
-    const void *key, size_t key_len,
-    const void *value, size_t value_len,
+    const char *index_name,
+    const void *start_key, size_t start_len,
+    const void *end_key, size_t end_len,
+    uint64_t *out_estimate,
     gerror_t *error
 );
 
-/*
+/* Auto-transaction version (pooled read txn) */
+int wtree3_estimate_range(
+    wtree3_tree_t *tree,
+    const char *index_name,
+    const void *start_key, size_t start_len,
+    const void *end_key, size_t end_len,
+    uint64_t *out_estimate,
+    gerror_t *error
+);
+
+/* ============================================================
+ * Membership Filters
+ * ============================================================ */
+
+/*
+ * Filter tuning (all fields 0 = defaults)
+ */
+typedef struct wtree3_filter_opts {
+    uint32_t bits_per_key;          /* Memory per key; 10 (default) is ~1% false positives */
+    uint64_t expected_keys;         /* Size for at least this many keys (default 1.5x current) */
+} wtree3_filter_opts_t;
+
+/*
+ * State of a filter (see wtree3_tree_filter_stats)
+ */
+typedef struct wtree3_filter_stats {
+    uint64_t capacity;              /* Keys the filter was sized for */
+    uint64_t keys;                  /* Keys at the last (re)build plus keys added since */
+    uint64_t removed;               /* Deletes since the last (re)build (still "maybe") */
+    size_t memory_bytes;            /* Size of the bit array */
+    double false_positive_rate;     /* Estimated from the fraction of bits set */
+    bool rebuild_advised;           /* Over capacity or many deletes: rebuild */
+} wtree3_filter_stats_t;
+
+/*
+ * Enable an in-memory membership filter on the main tree (index_name
+ * NULL) or on a unique index
+ *
+ * A blocked Bloom filter of the keys, built by one pass inside a write
+ * txn. Lookups of keys it rules out skip the B-tree descent:
+ * - main tree: wtree3_get_txn, wtree3_exists_txn, wtree3_exists_many_txn,
+ *   wtree3_get_many_txn, and the existence check of update/delete
+ * - unique index: the duplicate probe on insert/update
+ * Hits and false positives fall through to LMDB, so results never change.
+ *
+ * Deleted keys stay "maybe" until wtree3_tree_rebuild_filter(); check
+ * wtree3_tree_filter_stats() to decide when. The configuration is
+ * persisted and the filter rebuilt by wtree3_tree_open(); enabling again
+ * rebuilds with the new options.
+ *
+ * Enabling, rebuilding and disabling replace state on the tree handle,
+ * like adding or dropping an index: do not run them concurrently with
+ * other operations on the same handle.
+ *
+ * Returns: 0 on success, WTREE3_NOT_FOUND if the index does not exist or
+ *          is still being built, WTREE3_EINVAL for non-unique indexes
+ */
+int wtree3_tree_enable_filter(
+    wtree3_tree_t *tree,
+    const char *index_name,
+    const wtree3_filter_opts_t *opts,
+    gerror_t *error
+);
+
+/*
+ * Rebuild a filter from the live keys, resized to the current count
+ *
+ * Returns: 0 on success, WTREE3_NOT_FOUND if no filter is enabled
+ */
+int wtree3_tree_rebuild_filter(wtree3_tree_t *tree, const char *index_name, gerror_t *error);
+
+/*
+ * Disable a filter and forget its persisted configuration
+ *
+ * Returns: 0 on success, WTREE3_NOT_FOUND if no filter is enabled
+ */
+int wtree3_tree_disable_filter(wtree3_tree_t *tree, const char *index_name, gerror_t *error);
+
+/*
+ * Report the state of a filter
+ *
+ * Returns: 0 on success, WTREE3_NOT_FOUND if no filter is enabled
+ */
+int wtree3_tree_filter_stats(
+    wtree3_tree_t *tree,
+    const char *index_name,
+    wtree3_filter_stats_t *out,
+    gerror_t *error
+);
+
+/* ============================================================
+ * Value Compression
+ * ============================================================ */
+
+/* Largest dictionary a codec accepts */
+#define WTREE3_CODEC_DICT_MAX 32768
+
+/*
+ * Value codec of a tree (all fields 0 = defaults, no dictionary)
+ */
+typedef struct wtree3_codec_config {
+    uint32_t min_size;              /* Shorter values are stored raw (default 64) */
+    const void *dict;               /* Dictionary from wtree3_codec_train (NULL = none) */
+    size_t dict_len;                /* At most WTREE3_CODEC_DICT_MAX bytes */
+} wtree3_codec_config_t;
+
+/*
+ * Compress the values of a tree transparently
+ *
+ * Values are LZ-compressed on insert/update/upsert/modify and bulk load,
+ * with matches reaching into the dictionary, so small records with
+ * shared structure (field names, enums, common prefixes) shrink too.
+ * Values below min_size or that would not shrink are stored raw behind
+ * a one-byte tag. Every read path returns the original bytes, and
+ * extractors and merge/modify callbacks see them as well.
+ *
+ * Decompressed values returned by wtree3_get_txn, wtree3_get_many_txn
+ * and the batch scans live in a buffer owned by the transaction, so they
+ * stay valid until it ends as usual. Callback scans, joins, queries and
+ * iterators decode into a buffer reused per entry.
+ *
+ * The codec is persisted and reloaded by wtree3_tree_open(). It can only
+ * be set, changed or removed (config NULL) while the tree is empty, since
+ * stored values are framed by it; like enabling a filter, do not call it
+ * concurrently with other operations on the handle.
+ *
+ * Returns: 0 on success, WTREE3_EINVAL if the tree is not empty, is a
+ *          DUPSORT tree, or the dictionary is too large
+ */
+int wtree3_tree_set_codec(
+    wtree3_tree_t *tree,
+    const wtree3_codec_config_t *config,
+    gerror_t *error
+);
+
+/*
+ * Train a codec dictionary from sample values
+ *
+ * Picks the fragments shared by the most samples and packs them into
+ * dict (up to dict_cap bytes, capped at WTREE3_CODEC_DICT_MAX). A few
+ * hundred representative values are usually enough; samples that share
+ * nothing yield an empty dictionary.
+ *
+ * Returns: 0 on success with *dict_len set, WTREE3_EINVAL, WTREE3_ENOMEM
+ */
+int wtree3_codec_train(
+    const void *const *samples,
+    const size_t *sample_lens,
+    size_t count,
+    void *dict, size_t dict_cap,
+    size_t *dict_len,
+    gerror_t *error
+);
+
+/* ============================================================
+ * Data Operations (With Transaction)
+ *
+ * These operations automatically maintain all registered indexes.
+ * ============================================================ */
+
+/*
+ * Get value by key (zero-copy)
+ *
+ * Returned value is valid only during transaction.
+ *
+ * Returns: 0 on success, WTREE3_NOT_FOUND if key doesn't exist
+ */
+int wtree3_get_txn(
+    wtree3_txn_t *txn,
+    wtree3_tree_t *tree,
+    const void *key, size_t key_len,
+    const void **value, size_t *value_len,
+    gerror_t *error
+);
+
+/*
+ * Insert a key-value pair
+ *
+ * Automatically:
+ * - Checks unique constraints on all indexes
+ * - Inserts into all index trees
+ * - Increments entry count
+ *
+ * Returns: 0 on success, WTREE3_KEY_EXISTS on duplicate key,
+ *          WTREE3_INDEX_ERROR on unique index violation
+ */
+int wtree3_insert_one_txn(
+    wtree3_txn_t *txn,
+    wtree3_tree_t *tree,
+    const void *key, size_t key_len,
+    const void *value, size_t value_len,
+    gerror_t *error
+);
+
+/*
+ * Update an existing key's value
+ *
+ * Automatically:
+ * - Removes old index entries
+ * - Checks unique constraints for new index keys
+ * - Inserts new index entries
+ *
+ * Indexes whose extracted key is unchanged by the update are left
+ * untouched (no delete/insert round trip).
+ *
+ * Note: Does NOT change entry count (key already exists)
+ *
+ * Returns: 0 on success, WTREE3_NOT_FOUND if key doesn't exist
+ */
+int wtree3_update_txn(
+    wtree3_txn_t *txn,
+    wtree3_tree_t *tree,
+    const void *key, size_t key_len,
+    const void *value, size_t value_len,
+    gerror_t *error
+);
+
+/*
  * Upsert a key-value pair (insert or update)
  *
  * If key doesn't exist, inserts it (same as insert_one_txn).
  * If key exists:
  *   - If tree has merge_fn set: calls merge_fn to combine existing + new values
+ *   - If tree has merge_into_fn set: merges without allocating, straight
+ *     into the page when the tree has no indexes and no value codec
  *   - Otherwise: overwrites with new value (same as update_txn)
  *
+ * The key is looked up once: the write goes through the cursor that found
+ * it (or, for a new key, lands on the leaf the lookup already loaded).
+ *
  * Automatically:
  * - Updates all index entries if value changes
  * - Increments entry count only on new insert
@@ -1232,6 +2499,79 @@ int wtree3_upsert_many_txn(
     gerror_t *error
 );
 
+/*
+ * Reserve room for a new value and serialize it in place (zero-copy insert)
+ *
+ * Inserts key with value_len uninitialized bytes (MDB_RESERVE) and returns
+ * a pointer to them inside the map, so the caller writes the record
+ * straight into the page instead of into a buffer LMDB then copies. Finish
+ * with wtree3_commit_reserved, which extracts index keys from the written
+ * bytes and completes the insert:
+ *
+ *   void *p;
+ *   wtree3_reserve_txn(txn, tree, key, key_len, len, &p, &error);
+ *   serialize_record(rec, p, len);
+ *   wtree3_commit_reserved(txn, &error);
+ *
+ * Until then the txn has one pending reservation: *out_ptr stays valid as
+ * long as no other write runs in the txn, so other writes through
+ * wtree3_*_txn are refused with WTREE3_EINVAL, and so is committing the
+ * txn (which aborts it instead).
+ *
+ * Not supported on trees with a value codec (the stored bytes are the
+ * compressed frame) or on MDB_DUPSORT trees.
+ *
+ * Returns: 0 on success, WTREE3_KEY_EXISTS on duplicate key,
+ *          WTREE3_EINVAL if a reservation is already pending or the tree
+ *          does not support reservations
+ */
+int wtree3_reserve_txn(
+    wtree3_txn_t *txn,
+    wtree3_tree_t *tree,
+    const void *key, size_t key_len,
+    size_t value_len,
+    void **out_ptr,
+    gerror_t *error
+);
+
+/*
+ * Complete the txn's pending wtree3_reserve_txn insert
+ *
+ * Runs index maintenance (unique checks included) and change capture over
+ * the bytes written into the reservation. On failure the reserved entry
+ * is removed again; as with any failed write, abort the txn.
+ *
+ * Returns: 0 on success, WTREE3_EINVAL if nothing is reserved,
+ *          WTREE3_INDEX_ERROR on unique index violation
+ */
+int wtree3_commit_reserved(
+    wtree3_txn_t *txn,
+    gerror_t *error
+);
+
+/*
+ * Bulk-load pre-sorted key-value pairs
+ *
+ * Fast path for initial loads of data that is already sorted (e.g. snapshot
+ * restores). Keys must be strictly ascending under the tree's comparator
+ * and must sort after every key already in the tree.
+ *
+ * The main tree is written with MDB_APPEND. For each index the extracted
+ * keys are buffered, sorted and written with MDB_APPEND/MDB_APPENDDUP when
+ * the index is empty (ordinary sorted puts otherwise). Both produce densely
+ * packed pages and skip the per-entry existence probes of insert_many_txn.
+ *
+ * Returns: 0 on success, WTREE3_EINVAL if keys are not strictly ascending,
+ *          WTREE3_KEY_EXISTS if they do not sort after existing entries,
+ *          WTREE3_INDEX_ERROR on unique index violation
+ */
+int wtree3_bulk_load_txn(
+    wtree3_txn_t *txn,
+    wtree3_tree_t *tree,
+    const wtree3_kv_t *kvs, size_t count,
+    gerror_t *error
+);
+
 /* ============================================================
  * Data Operations (Auto-transaction)
  *
@@ -1351,6 +2691,102 @@ int wtree3_scan_prefix_txn(
     gerror_t *error
 );
 
+/*
+ * Scan a range of key-value pairs in pages (forward)
+ *
+ * Same range semantics as wtree3_scan_range_txn(), but entries are
+ * gathered into the caller's entries[] array and batch_fn is called once
+ * per page of up to capacity entries. The end_key bound is checked once
+ * per page rather than once per row.
+ *
+ * Parameters:
+ *   entries  - Caller-provided page buffer
+ *   capacity - Number of slots in entries (must be > 0)
+ *   batch_fn - Callback for each page (return false to stop early)
+ *
+ * Returns: 0 on success, error code on failure
+ */
+int wtree3_scan_range_batch_txn(
+    wtree3_txn_t *txn,
+    wtree3_tree_t *tree,
+    const void *start_key, size_t start_len,
+    const void *end_key, size_t end_len,
+    wtree3_batch_entry_t *entries, size_t capacity,
+    wtree3_scan_batch_fn batch_fn,
+    void *user_data,
+    gerror_t *error
+);
+
+/*
+ * Scan a range of key-value pairs in pages (reverse)
+ *
+ * Same range semantics as wtree3_scan_reverse_txn(); entries within a
+ * page are in descending key order.
+ *
+ * Returns: 0 on success, error code on failure
+ */
+int wtree3_scan_reverse_batch_txn(
+    wtree3_txn_t *txn,
+    wtree3_tree_t *tree,
+    const void *start_key, size_t start_len,
+    const void *end_key, size_t end_len,
+    wtree3_batch_entry_t *entries, size_t capacity,
+    wtree3_scan_batch_fn batch_fn,
+    void *user_data,
+    gerror_t *error
+);
+
+/*
+ * Scan all keys with a given prefix in pages
+ *
+ * Same matching as wtree3_scan_prefix_txn(); the prefix is checked once
+ * per page.
+ *
+ * Returns: 0 on success, error code on failure
+ */
+int wtree3_scan_prefix_batch_txn(
+    wtree3_txn_t *txn,
+    wtree3_tree_t *tree,
+    const void *prefix, size_t prefix_len,
+    wtree3_batch_entry_t *entries, size_t capacity,
+    wtree3_scan_batch_fn batch_fn,
+    void *user_data,
+    gerror_t *error
+);
+
+/*
+ * Scan a range of key-value pairs on several threads
+ *
+ * Splits [start_key, end_key] (NULL = open) into up to opts->threads
+ * disjoint key ranges and scans each on its own thread and read
+ * transaction. All workers read the same snapshot: the writer lock is
+ * held while they start (not while they scan). scan_fn runs concurrently
+ * and receives the worker's partial state; returning false stops only
+ * that worker's range. reduce_fn (optional) then merges the partials on
+ * the calling thread in key order.
+ *
+ * Small trees are scanned on the calling thread. Must not be called from
+ * a thread that holds a write transaction on the same database.
+ *
+ * Parameters:
+ *   opts      - Thread count and partial state size (NULL for defaults)
+ *   scan_fn   - Per-entry callback, called with the worker's partial
+ *   reduce_fn - Per-partition merge callback (NULL to skip)
+ *   user_data - Context passed to reduce_fn
+ *
+ * Returns: 0 on success, error code on failure
+ */
+int wtree3_scan_parallel(
+    wtree3_tree_t *tree,
+    const void *start_key, size_t start_len,
+    const void *end_key, size_t end_len,
+    const wtree3_parallel_scan_opts_t *opts,
+    wtree3_scan_fn scan_fn,
+    wtree3_reduce_fn reduce_fn,
+    void *user_data,
+    gerror_t *error
+);
+
 /*
  * Atomic read-modify-write operation
  *
@@ -1362,6 +2798,8 @@ int wtree3_scan_prefix_txn(
  * - If modify_fn returns value for missing key: inserts entry
  * - If modify_fn returns value for existing key: updates entry
  *
+ * Like upsert, the read and the write share one cursor (one lookup).
+ *
  * Parameters:
  *   key       - Key to modify
  *   modify_fn - Transformation callback
@@ -1393,6 +2831,10 @@ int wtree3_modify_txn(
  * Note: If a key doesn't exist, corresponding value pointer is set to NULL
  *       and value_len to 0. This is NOT an error.
  *
+ * Keys are resolved in key order on a single cursor (already sorted input
+ * is detected and not re-sorted); results are written at each key's input
+ * position. Upcoming pages are prefetched with MADV_WILLNEED on read txns.
+ *
  * Returns: 0 on success, error code on failure
  */
 int wtree3_get_many_txn(
@@ -1422,6 +2864,9 @@ int wtree3_get_many_txn(
  *   user_data   - Context passed to predicate
  *   deleted_out - Output: number of entries deleted (can be NULL)
  *
+ * Index entries are extracted while the row is still on its page and
+ * deleted in batches, sorted per index, so rows are never copied.
+ *
  * Returns: 0 on success, error code on failure
  */
 int wtree3_delete_if_txn(
@@ -1435,6 +2880,32 @@ int wtree3_delete_if_txn(
     gerror_t *error
 );
 
+/*
+ * Delete every entry in a key range
+ *
+ * Like wtree3_delete_if_txn() without a predicate. With both bounds NULL
+ * it is wtree3_tree_clear_txn(). Otherwise rows are deleted through one
+ * cursor and their index entries are removed in batches, sorted by
+ * (index key, main key) per index so each index is walked in order.
+ *
+ * Parameters:
+ *   start_key   - First key to delete (NULL for beginning)
+ *   start_len   - Start key length
+ *   end_key     - Last key to delete, inclusive (NULL for end)
+ *   end_len     - End key length
+ *   deleted_out - Output: number of entries deleted (can be NULL)
+ *
+ * Returns: 0 on success, error code on failure
+ */
+int wtree3_delete_range_txn(
+    wtree3_txn_t *txn,
+    wtree3_tree_t *tree,
+    const void *start_key, size_t start_len,
+    const void *end_key, size_t end_len,
+    size_t *deleted_out,
+    gerror_t *error
+);
+
 /*
  * Collect key-value pairs from a range into arrays
  *
@@ -1475,6 +2946,46 @@ int wtree3_collect_range_txn(
     gerror_t *error
 );
 
+/* Result set flags */
+#define WTREE3_COLLECT_ZERO_COPY 0x01  /* Point into the map instead of copying */
+
+/*
+ * Collect a range into a result set
+ *
+ * Same scan as wtree3_collect_range_txn(), without one allocation per key
+ * and value: entries are a single wtree3_batch_entry_t table, and copied
+ * keys and values sit back to back in one growable arena. max_count, when
+ * given, sizes both up front.
+ *
+ * With WTREE3_COLLECT_ZERO_COPY nothing is copied: keys and values point
+ * straight into the LMDB map and stay valid until txn ends (or its next
+ * write). Values of a compressed tree are still copied, decoded.
+ *
+ * Returns: 0 with *result_out set (free with wtree3_result_free),
+ *          error code on failure
+ */
+int wtree3_collect_range_result_txn(
+    wtree3_txn_t *txn,
+    wtree3_tree_t *tree,
+    const void *start_key, size_t start_len,
+    const void *end_key, size_t end_len,
+    wtree3_predicate_fn predicate,
+    void *user_data,
+    size_t max_count,
+    unsigned int flags,
+    wtree3_result_t **result_out,
+    gerror_t *error
+);
+
+/* Number of entries in a result set */
+size_t wtree3_result_count(const wtree3_result_t *result);
+
+/* Entries of a result set, in key order (wtree3_result_count of them) */
+const wtree3_batch_entry_t* wtree3_result_entries(const wtree3_result_t *result);
+
+/* Free a result set and everything it copied (NULL is a no-op) */
+void wtree3_result_free(wtree3_result_t *result);
+
 /*
  * Batch existence check
  *
@@ -1486,6 +2997,9 @@ int wtree3_collect_range_txn(
  *   key_count - Number of keys
  *   results   - Output: array of booleans (true if key exists)
  *
+ * Keys are resolved in key order on a single cursor, like
+ * wtree3_get_many_txn(); results follow the input order.
+ *
  * Returns: 0 on success, error code on failure
  */
 int wtree3_exists_many_txn(
@@ -1577,6 +3091,969 @@ bool wtree3_index_iterator_main_key(
     size_t *main_key_len
 );
 
+/*
+ * Get the projected payload from a covering index iterator
+ *
+ * Returns the projection stored with the current entry (zero-copy, valid
+ * until the iterator moves), so index-only queries skip the main tree.
+ * Returns false for plain indexes and main tree iterators.
+ */
+bool wtree3_index_iterator_payload(
+    wtree3_iterator_t *iter,
+    const void **payload,
+    size_t *payload_len
+);
+
+/*
+ * Prepared index handles
+ *
+ * For request paths doing many small index lookups: the index is resolved
+ * once, and each seek reuses the handle's cursor inside the caller's txn
+ * instead of looking the index up by name, acquiring a txn and opening a
+ * cursor. Between read txns the cursor is moved with mdb_cursor_renew();
+ * in a write txn it is opened once and reused until the txn ends.
+ *
+ * Hits are zero-copy and valid until the next call on the handle or the
+ * end of the txn. Close handles before dropping their index or closing
+ * the tree.
+ */
+
+/* One index entry */
+typedef struct wtree3_index_hit {
+    const void *index_key;
+    size_t index_key_len;
+    const void *main_key;
+    size_t main_key_len;
+    const void *payload;            /* Covering indexes only (else NULL/0) */
+    size_t payload_len;
+} wtree3_index_hit_t;
+
+/* Seek flags */
+#define WTREE3_SEEK_RANGE   0x01    /* First key >= key, and next walks on past it */
+
+/*
+ * Resolve an index for repeated seeks
+ *
+ * Returns: the handle, or NULL with WTREE3_NOT_FOUND if the index does not
+ *          exist or is still being built
+ */
+wtree3_index_handle_t* wtree3_index_handle_open(
+    wtree3_tree_t *tree,
+    const char *index_name,
+    gerror_t *error
+);
+
+void wtree3_index_handle_close(wtree3_index_handle_t *handle);
+
+/*
+ * Position on the first entry for key
+ *
+ * Without WTREE3_SEEK_RANGE the key must match exactly, and
+ * wtree3_index_handle_next() stops after its last entry.
+ *
+ * Returns: 0 with *hit filled, WTREE3_NOT_FOUND if there is no such entry
+ */
+int wtree3_index_handle_seek(
+    wtree3_index_handle_t *handle,
+    wtree3_txn_t *txn,
+    const void *key, size_t key_len,
+    unsigned int flags,
+    wtree3_index_hit_t *hit,
+    gerror_t *error
+);
+
+/*
+ * Advance to the next entry of the last seek
+ *
+ * Returns: 0 with *hit filled, WTREE3_NOT_FOUND at the end
+ */
+int wtree3_index_handle_next(
+    wtree3_index_handle_t *handle,
+    wtree3_index_hit_t *hit,
+    gerror_t *error
+);
+
+/*
+ * Posting-list pages
+ *
+ * A run of main keys of one index key, back to back: main_keys holds
+ * count keys of key_size bytes each. On fixed-width indexes
+ * (main_key_size) a page is a whole LMDB page of packed duplicates,
+ * returned by one MDB_GET_MULTIPLE/MDB_NEXT_MULTIPLE; other indexes yield
+ * one main key per page. Zero-copy, like hits.
+ */
+typedef struct wtree3_index_page {
+    const void *main_keys;
+    size_t count;
+    size_t key_size;
+} wtree3_index_page_t;
+
+/*
+ * Advance past the current entry of an exact seek, a page at a time
+ *
+ * Returns the remaining main keys of the seek key, starting right after
+ * the last hit or page returned; can be mixed with wtree3_index_handle_next().
+ *
+ * Returns: 0 with *page filled (count >= 1), WTREE3_NOT_FOUND at the end,
+ *          WTREE3_EINVAL after a WTREE3_SEEK_RANGE seek
+ */
+int wtree3_index_handle_next_page(
+    wtree3_index_handle_t *handle,
+    wtree3_index_page_t *page,
+    gerror_t *error
+);
+
+/* Index join flags */
+#define WTREE3_JOIN_SORTED  0x01  /* Resolve hits in main-key order, per batch */
+
+/*
+ * Scan an index key range and fetch the main-tree record of every hit
+ *
+ * Walks [start_key, end_key] (inclusive, NULL = open) of the index and
+ * resolves each main key on a main-tree cursor in the same transaction,
+ * calling join_fn with the index key, main key and value (zero-copy).
+ *
+ * Without flags, records are delivered in index order. With
+ * WTREE3_JOIN_SORTED, hits are gathered in batches and fetched in
+ * main-key order within each batch, which improves locality when index
+ * order and main-key order are unrelated.
+ *
+ * Returns: 0 on success (also when join_fn stops early),
+ *          WTREE3_NOT_FOUND if the index is missing or still being built,
+ *          WTREE3_INDEX_ERROR if an entry points to a missing main key
+ */
+int wtree3_index_scan_join_txn(
+    wtree3_txn_t *txn,
+    wtree3_tree_t *tree,
+    const char *index_name,
+    const void *start_key, size_t start_len,
+    const void *end_key, size_t end_len,
+    unsigned int flags,
+    wtree3_join_fn join_fn,
+    void *user_data,
+    gerror_t *error
+);
+
+/*
+ * Fetch every main-tree record whose index key equals key
+ *
+ * Same as wtree3_index_scan_join_txn() with start_key = end_key = key.
+ */
+int wtree3_index_get_many_txn(
+    wtree3_txn_t *txn,
+    wtree3_tree_t *tree,
+    const char *index_name,
+    const void *key, size_t key_len,
+    unsigned int flags,
+    wtree3_join_fn join_fn,
+    void *user_data,
+    gerror_t *error
+);
+
+/* Auto-transaction versions (pooled read txn) */
+int wtree3_index_scan_join(
+    wtree3_tree_t *tree,
+    const char *index_name,
+    const void *start_key, size_t start_len,
+    const void *end_key, size_t end_len,
+    unsigned int flags,
+    wtree3_join_fn join_fn,
+    void *user_data,
+    gerror_t *error
+);
+
+int wtree3_index_get_many(
+    wtree3_tree_t *tree,
+    const char *index_name,
+    const void *key, size_t key_len,
+    unsigned int flags,
+    wtree3_join_fn join_fn,
+    void *user_data,
+    gerror_t *error
+);
+
+/*
+ * One predicate of a multi-index query
+ *
+ * Exact match (range = false): entries whose index key equals key.
+ * Range (range = true): index keys in [key, end_key], inclusive, where a
+ * NULL bound is open.
+ */
+typedef struct wtree3_index_pred {
+    const char *index_name;
+    const void *key;
+    size_t key_len;
+    const void *end_key;
+    size_t end_len;
+    bool range;
+} wtree3_index_pred_t;
+
+/* Multi-index query flags */
+#define WTREE3_QUERY_AND     0x00  /* Intersect predicates (default) */
+#define WTREE3_QUERY_OR      0x01  /* Union of predicates */
+#define WTREE3_QUERY_VALUES  0x02  /* Also fetch the main-tree value of every hit */
+
+/*
+ * Intersect or union the main keys matched by several index predicates
+ *
+ * Streams the main keys of all predicates in a sorted merge and calls fn
+ * once per matching main key, in ascending main-key order (memcmp).
+ * Exact-match predicates are read straight from the index cursor, and
+ * intersections skip ahead with MDB_GET_BOTH_RANGE, so the larger posting
+ * lists are mostly never read. Range predicates, and indexes with a
+ * custom dupsort comparator, are gathered and sorted first.
+ *
+ * fn gets (main_key, value); value is NULL/0 unless WTREE3_QUERY_VALUES
+ * is set. All pointers are zero-copy. fn must not write in txn.
+ *
+ * Returns: 0 on success (also when fn stops early),
+ *          WTREE3_NOT_FOUND if an index is missing or still being built,
+ *          WTREE3_INDEX_ERROR if an entry points to a missing main key
+ */
+int wtree3_index_query_txn(
+    wtree3_txn_t *txn,
+    wtree3_tree_t *tree,
+    const wtree3_index_pred_t *preds, size_t pred_count,
+    unsigned int flags,
+    wtree3_scan_fn fn,
+    void *user_data,
+    gerror_t *error
+);
+
+/* Auto-transaction version (pooled read txn) */
+int wtree3_index_query(
+    wtree3_tree_t *tree,
+    const wtree3_index_pred_t *preds, size_t pred_count,
+    unsigned int flags,
+    wtree3_scan_fn fn,
+    void *user_data,
+    gerror_t *error
+);
+
+/*
+ * Posting-list callback: one page of main keys (see wtree3_index_page_t)
+ * Return false to stop.
+ */
+typedef bool (*wtree3_posting_fn)(
+    const wtree3_index_page_t *page,
+    void *user_data
+);
+
+/*
+ * Hand every main key stored under one index key to fn, a page at a time
+ *
+ * Pages come in duplicate order; on fixed-width indexes each is a
+ * contiguous array of main keys, so posting-list scans (and SIMD
+ * intersections over them) run at memory bandwidth instead of one cursor
+ * step per entry. fn must not write in txn.
+ *
+ * Returns: 0 on success (also when fn stops early or the key is absent),
+ *          WTREE3_NOT_FOUND if the index is missing or still being built
+ */
+int wtree3_index_get_all_txn(
+    wtree3_txn_t *txn,
+    wtree3_tree_t *tree,
+    const char *index_name,
+    const void *key, size_t key_len,
+    wtree3_posting_fn fn,
+    void *user_data,
+    gerror_t *error
+);
+
+/* Auto-transaction version (pooled read txn) */
+int wtree3_index_get_all(
+    wtree3_tree_t *tree,
+    const char *index_name,
+    const void *key, size_t key_len,
+    wtree3_posting_fn fn,
+    void *user_data,
+    gerror_t *error
+);
+
+/* ============================================================
+ * Snapshots
+ * ============================================================ */
+
+/*
+ * Stream callbacks. write_fn receives the snapshot in order; read_fn must
+ * fill buf with exactly len bytes. Both return 0 on success; anything else
+ * aborts the export or import.
+ */
+typedef int (*wtree3_snapshot_write_fn)(const void *data, size_t len, void *user_data);
+typedef int (*wtree3_snapshot_read_fn)(void *buf, size_t len, void *user_data);
+
+/* Snapshot flags */
+#define WTREE3_SNAPSHOT_COMPRESS        0x01  /* Export: compress every block */
+#define WTREE3_SNAPSHOT_NO_INDEXES      0x02  /* Export: index definitions only, import rebuilds */
+#define WTREE3_SNAPSHOT_REBUILD_INDEXES 0x04  /* Import: re-extract instead of loading index DBIs */
+
+/*
+ * Stream a tree, its metadata and its index DBIs
+ *
+ * The snapshot holds a versioned header, the tree's records from the
+ * metadata DBI (index definitions, codec, filter and stats records), its
+ * rows and the entries of every loaded index, each as a run of
+ * length-prefixed, checksummed blocks of sorted key/value records.
+ * Values are written as stored, so a tree with a codec stays compressed.
+ * Everything comes from txn's snapshot: run it in a read txn and writers
+ * are never blocked. Indexes the handle could not load are left out.
+ *
+ * Parameters:
+ *   flags     - WTREE3_SNAPSHOT_COMPRESS, WTREE3_SNAPSHOT_NO_INDEXES
+ *   write_fn  - Receives the stream
+ *   user_data - Context passed to write_fn
+ *
+ * Returns: 0 on success, WTREE3_ERROR if write_fn failed
+ */
+int wtree3_tree_export_txn(
+    wtree3_txn_t *txn,
+    wtree3_tree_t *tree,
+    unsigned int flags,
+    wtree3_snapshot_write_fn write_fn,
+    void *user_data,
+    gerror_t *error
+);
+
+/* Auto-transaction version (own read txn for the whole export) */
+int wtree3_tree_export(
+    wtree3_tree_t *tree,
+    unsigned int flags,
+    wtree3_snapshot_write_fn write_fn,
+    void *user_data,
+    gerror_t *error
+);
+
+/*
+ * Create a tree from a snapshot
+ *
+ * Rows and index entries arrive in key order and are appended with
+ * MDB_APPEND / MDB_APPENDDUP in one write transaction, so nothing is
+ * re-extracted and every page is filled once. Indexes exported without
+ * their entries (or all of them, with WTREE3_SNAPSHOT_REBUILD_INDEXES)
+ * are rebuilt with wtree3_tree_build_index() after the commit. The tree
+ * is then opened like wtree3_tree_open() and returned; indexes need
+ * their extractors registered unless they use declarative keys.
+ *
+ * Parameters:
+ *   name      - Tree to create (NULL = the name stored in the snapshot);
+ *               it must not exist yet
+ *   flags     - WTREE3_SNAPSHOT_REBUILD_INDEXES
+ *   read_fn   - Supplies the stream
+ *   user_data - Context passed to read_fn
+ *
+ * Nothing is left behind when the stream is bad. If a rebuild fails, the
+ * committed tree stays and NULL is returned; delete it or rebuild the index.
+ *
+ * Returns: Tree handle, or NULL on error (WTREE3_ERROR for a truncated or
+ *          corrupt stream, WTREE3_EINVAL if the tree exists)
+ */
+wtree3_tree_t* wtree3_tree_import(
+    wtree3_db_t *db,
+    const char *name,
+    unsigned int flags,
+    wtree3_snapshot_read_fn read_fn,
+    void *user_data,
+    gerror_t *error
+);
+
+/* ============================================================
+ * Change Log
+ * ============================================================ */
+
+/* Kinds of change recorded in a tree's change log */
+typedef enum {
+    WTREE3_CHANGE_INSERT = 1,       /* Key added (insert, upsert of a new key, bulk load) */
+    WTREE3_CHANGE_UPDATE = 2,       /* Value of an existing key replaced */
+    WTREE3_CHANGE_DELETE = 3,       /* Key removed */
+    WTREE3_CHANGE_CLEAR  = 4        /* Every key removed (wtree3_tree_clear); no key */
+} wtree3_change_op_t;
+
+/* One change log record (key and value point into the reading txn) */
+typedef struct {
+    uint64_t seq;                   /* Sequence number, ascending from 1 */
+    wtree3_change_op_t op;
+    const void *key;
+    size_t key_len;
+    const void *value;              /* New value (NULL unless the log keeps values) */
+    size_t value_len;
+} wtree3_change_t;
+
+/* Change log configuration */
+typedef struct {
+    bool values;                    /* Also log the new value of inserts and updates */
+} wtree3_changelog_config_t;
+
+/*
+ * Enable the change log of a tree
+ *
+ * Every write through this handle then appends a (sequence, op, key,
+ * optional value) record to the tree's log DBI in the same transaction,
+ * so the log commits or aborts with the change it describes. Sequence
+ * numbers follow commit order and never repeat, truncation included. The
+ * log is persisted and reopened by wtree3_tree_open(); other handles that
+ * were already open stay unaware of it until reopened.
+ *
+ * Calling it again changes the configuration and keeps the log. Not
+ * supported on DUPSORT trees.
+ *
+ * To bootstrap a consumer, read wtree3_changelog_bounds_txn() and scan
+ * the tree in one read txn, then consume from last + 1.
+ *
+ * Parameters:
+ *   config - NULL for the defaults (keys only)
+ *
+ * Returns: 0 on success, error code on failure
+ */
+int wtree3_tree_enable_changelog(
+    wtree3_tree_t *tree,
+    const wtree3_changelog_config_t *config,
+    gerror_t *error
+);
+
+/* Stop logging and drop the log (sequence numbers restart if re-enabled) */
+int wtree3_tree_disable_changelog(wtree3_tree_t *tree, gerror_t *error);
+
+/*
+ * Oldest and newest sequence numbers in txn's view of the log. An empty
+ * log reports first = last + 1, last being the newest sequence ever
+ * handed out (0 if none).
+ */
+int wtree3_changelog_bounds_txn(
+    wtree3_txn_t *txn,
+    wtree3_tree_t *tree,
+    uint64_t *first_out,
+    uint64_t *last_out,
+    gerror_t *error
+);
+
+/*
+ * Read up to max records with sequence >= from_seq (0 = the oldest kept)
+ *
+ * Records are returned in sequence order, zero-copy: keys and values
+ * stay valid until txn ends. *count_out is 0 once the log is caught up.
+ *
+ * Returns: 0 on success; WTREE3_NOT_FOUND if records from from_seq on
+ *          were already truncated (the consumer must resync)
+ */
+int wtree3_changelog_read_txn(
+    wtree3_txn_t *txn,
+    wtree3_tree_t *tree,
+    uint64_t from_seq,
+    wtree3_change_t *out,
+    size_t max,
+    size_t *count_out,
+    gerror_t *error
+);
+
+/*
+ * Remove every record with sequence < before_seq (retention). Dropping
+ * the whole log empties its DBI in O(pages).
+ */
+int wtree3_changelog_truncate_txn(
+    wtree3_txn_t *txn,
+    wtree3_tree_t *tree,
+    uint64_t before_seq,
+    size_t *removed_out,
+    gerror_t *error
+);
+
+/* Auto-transaction version */
+int wtree3_changelog_truncate(
+    wtree3_tree_t *tree,
+    uint64_t before_seq,
+    size_t *removed_out,
+    gerror_t *error
+);
+
+/*
+ * Consumer cursor: a loop of batched reads from a sequence number
+ *
+ * The cursor keeps one read txn and renews it before every batch, so
+ * each batch sees the changes committed since the previous one. Records
+ * of a batch stay valid until the next call or close. A single thread
+ * should use the cursor; it can run beside writers.
+ */
+typedef struct wtree3_changelog_cursor_t wtree3_changelog_cursor_t;
+
+wtree3_changelog_cursor_t* wtree3_changelog_cursor_open(
+    wtree3_tree_t *tree,
+    uint64_t from_seq,
+    gerror_t *error
+);
+
+/* Next batch (count 0 = caught up); errors as wtree3_changelog_read_txn() */
+int wtree3_changelog_cursor_next(
+    wtree3_changelog_cursor_t *cursor,
+    wtree3_change_t *out,
+    size_t max,
+    size_t *count_out,
+    gerror_t *error
+);
+
+/* Sequence number the next batch starts at (acknowledge/truncate below it) */
+uint64_t wtree3_changelog_cursor_position(const wtree3_changelog_cursor_t *cursor);
+
+void wtree3_changelog_cursor_close(wtree3_changelog_cursor_t *cursor);
+
+/* ============================================================
+ * Write Combining
+ * ============================================================ */
+
+/* Write combining configuration (0 = default for each threshold) */
+typedef struct {
+    wtree3_merge_fn combine_fn;     /* Folds (older operand, newer operand) into one */
+    void *user_data;                /* Passed to combine_fn */
+    size_t max_keys;                /* Flush at this many buffered keys (default 1024) */
+    size_t max_bytes;               /* ... or keys + operands this large (default 1 MB) */
+    uint64_t max_age_us;            /* ... or oldest operand this old (default 100 ms) */
+} wtree3_combine_config_t;
+
+/*
+ * Buffer and combine the auto-transaction upserts of a tree
+ *
+ * For hot keys updated through a merge callback (counters, sums, sets):
+ * wtree3_upsert() on this handle then folds its value into an in-memory
+ * operand per key with combine_fn instead of writing, so N upserts of a
+ * key between flushes cost one read-merge-write (with index maintenance)
+ * of the combined operand. combine_fn returns a malloc'd operand like a
+ * merge callback; it must be associative, and commutative as well, since
+ * concurrent flushes may commit in either order.
+ *
+ * Buffered operands are flushed, in key order in one write txn, by the
+ * upsert that crosses a threshold, by wtree3_tree_flush_combined(), by
+ * disabling and by wtree3_tree_close() (which cannot report errors, so
+ * flush first). The age threshold is checked on upserts only; there is
+ * no timer. A failed flush keeps the operands buffered.
+ *
+ * Until flushed, operands are invisible: reads (wtree3_get_txn included),
+ * scans and the _txn write calls see the stored value only, and a flush
+ * after a delete re-creates the key. Flush first where that matters.
+ * Upserts through wtree3_upsert_txn() are never buffered.
+ *
+ * Calling it again flushes, then changes the configuration. Like enabling
+ * a filter, do not call it concurrently with other operations on the
+ * handle; buffered upserts and flushes themselves are thread-safe.
+ *
+ * Returns: 0 on success, WTREE3_EINVAL without combine_fn
+ */
+int wtree3_tree_enable_combining(
+    wtree3_tree_t *tree,
+    const wtree3_combine_config_t *config,
+    gerror_t *error
+);
+
+/* Flush, then stop buffering (the buffer stays if the flush fails) */
+int wtree3_tree_disable_combining(wtree3_tree_t *tree, gerror_t *error);
+
+/*
+ * Apply every buffered operand now, in one write transaction
+ *
+ * Parameters:
+ *   flushed_out - Output: keys written (can be NULL)
+ *
+ * Returns: 0 on success (also when nothing is buffered), error code of
+ *          the failing upsert or commit otherwise
+ */
+int wtree3_tree_flush_combined(
+    wtree3_tree_t *tree,
+    size_t *flushed_out,
+    gerror_t *error
+);
+
+/* Keys currently buffered (0 when combining is off) */
+size_t wtree3_tree_combining_pending(wtree3_tree_t *tree);
+
+/* ============================================================
+ * Sharded Databases
+ * ============================================================ */
+
+#define WTREE3_SHARDS_MAX 256
+
+typedef struct wtree3_sharded_db_t wtree3_sharded_db_t;
+typedef struct wtree3_sharded_tree_t wtree3_sharded_tree_t;
+
+/* How keys are assigned to shards */
+typedef enum {
+    WTREE3_SHARD_HASH = 0,          /* Hash of the key: even spread, scans merge every shard */
+    WTREE3_SHARD_RANGE = 1          /* Key ranges: scans visit only overlapping shards
+                                       (bytewise-ordered trees only, see splits) */
+} wtree3_shard_mode_t;
+
+/* Sharded database configuration (every shard is opened with the same settings) */
+typedef struct {
+    size_t shards;                  /* Environments, 1..WTREE3_SHARDS_MAX (0 = layout stored on disk) */
+    wtree3_shard_mode_t mode;
+    const MDB_val *splits;          /* RANGE: shards - 1 ascending split keys (shard i holds
+                                       splits[i-1] <= key < splits[i], bytewise order).
+                                       Routing always compares bytewise; scans of a tree
+                                       with MDB_INTEGERKEY, MDB_REVERSEKEY or a custom
+                                       comparator visit every shard instead of pruning */
+    size_t mapsize;                 /* Per shard, as for wtree3_db_open() */
+    unsigned int max_dbs;
+    uint32_t version;
+    unsigned int flags;
+} wtree3_shard_config_t;
+
+/*
+ * Open (or create) a database split over several LMDB environments
+ *
+ * LMDB serializes write transactions per environment. A sharded database
+ * keeps shards independent databases in path/shard-000, path/shard-001,
+ * ... and routes every key to one of them, so writes to different shards
+ * commit in parallel. The layout is recorded in shard 0 and must match on
+ * reopen (pass shards = 0 to take it from disk); the hash mode's routing
+ * is fixed, so a hash layout cannot change its shard count in place.
+ *
+ * Each shard keeps its own metadata and indexes. Nothing spans shards:
+ * every call is atomic within the one shard it touches, there are no
+ * cross-shard transactions, and unique indexes reject duplicates within
+ * a shard only (route on the unique field, or check it elsewhere).
+ *
+ * Returns: Sharded database or NULL on error (WTREE3_EINVAL for a bad
+ *          or mismatching layout)
+ */
+wtree3_sharded_db_t *wtree3_sharded_db_open(
+    const char *path,
+    const wtree3_shard_config_t *config,
+    gerror_t *error
+);
+
+/* Close every shard (close the sharded trees first) */
+void wtree3_sharded_db_close(wtree3_sharded_db_t *sdb);
+
+/* Number of shards */
+size_t wtree3_sharded_db_count(const wtree3_sharded_db_t *sdb);
+
+/* One shard's database, for per-shard transactions (NULL if out of range) */
+wtree3_db_t *wtree3_sharded_db_shard(wtree3_sharded_db_t *sdb, size_t shard);
+
+/* Register an extractor on every shard (see wtree3_db_register_key_extractor) */
+int wtree3_sharded_db_register_key_extractor(
+    wtree3_sharded_db_t *sdb,
+    uint32_t version,
+    uint32_t flags,
+    wtree3_index_key_fn key_fn,
+    gerror_t *error
+);
+
+/* Shard a key lives in (stable for a given layout) */
+size_t wtree3_sharded_shard_of(const wtree3_sharded_db_t *sdb, const void *key, size_t key_len);
+
+/* Open (or create) a tree on every shard; flags as for wtree3_tree_open() */
+wtree3_sharded_tree_t *wtree3_sharded_tree_open(
+    wtree3_sharded_db_t *sdb,
+    const char *name,
+    unsigned int flags,
+    gerror_t *error
+);
+
+void wtree3_sharded_tree_close(wtree3_sharded_tree_t *st);
+
+/* The tree on one shard, for _txn calls and per-shard settings (NULL if out of range) */
+wtree3_tree_t *wtree3_sharded_tree_shard(wtree3_sharded_tree_t *st, size_t shard);
+
+/* Entries over all shards (each shard's count is committed state), -1 if a shard fails */
+int64_t wtree3_sharded_tree_count(wtree3_sharded_tree_t *st);
+
+/* Add, populate or drop an index on every shard (add is undone if one shard fails) */
+int wtree3_sharded_tree_add_index(
+    wtree3_sharded_tree_t *st,
+    const wtree3_index_config_t *config,
+    gerror_t *error
+);
+int wtree3_sharded_tree_populate_index(wtree3_sharded_tree_t *st, const char *index_name,
+                                       gerror_t *error);
+int wtree3_sharded_tree_drop_index(wtree3_sharded_tree_t *st, const char *index_name,
+                                   gerror_t *error);
+
+/* Point operations: the auto-transaction calls on the key's shard */
+int wtree3_sharded_get(wtree3_sharded_tree_t *st, const void *key, size_t key_len,
+                       void **value, size_t *value_len, gerror_t *error);
+int wtree3_sharded_insert_one(wtree3_sharded_tree_t *st, const void *key, size_t key_len,
+                              const void *value, size_t value_len, gerror_t *error);
+int wtree3_sharded_update(wtree3_sharded_tree_t *st, const void *key, size_t key_len,
+                          const void *value, size_t value_len, gerror_t *error);
+int wtree3_sharded_upsert(wtree3_sharded_tree_t *st, const void *key, size_t key_len,
+                          const void *value, size_t value_len, gerror_t *error);
+int wtree3_sharded_delete_one(wtree3_sharded_tree_t *st, const void *key, size_t key_len,
+                              bool *deleted, gerror_t *error);
+bool wtree3_sharded_exists(wtree3_sharded_tree_t *st, const void *key, size_t key_len,
+                           gerror_t *error);
+
+/*
+ * Scan [start_key, end_key] over all shards in key order
+ *
+ * Bounds as for wtree3_scan_range_txn() (inclusive, NULL = open). Opens a
+ * read txn per shard and merges their cursors, so the callback sees one
+ * ascending stream; every shard is read at its own snapshot. Range
+ * layouts only open the shards the range overlaps.
+ *
+ * Returns: 0 on success (also when the callback stops), error code on failure
+ */
+int wtree3_sharded_scan_range(
+    wtree3_sharded_tree_t *st,
+    const void *start_key, size_t start_len,
+    const void *end_key, size_t end_len,
+    wtree3_scan_fn scan_fn,
+    void *user_data,
+    gerror_t *error
+);
+
+/*
+ * Scan [start_key, end_key] with one thread per shard, in no global order
+ *
+ * For aggregations that do not need order. scan_fn runs concurrently from
+ * several threads (each shard's entries arrive in order on one thread);
+ * returning false stops every shard soon after.
+ *
+ * Returns: 0 on success, the first failing shard's error code otherwise
+ */
+int wtree3_sharded_scan_parallel(
+    wtree3_sharded_tree_t *st,
+    const void *start_key, size_t start_len,
+    const void *end_key, size_t end_len,
+    wtree3_scan_fn scan_fn,
+    void *user_data,
+    gerror_t *error
+);
+
+/*
+ * Index range scan over all shards
+ *
+ * Seeks index_name on every shard for index keys in [start_key, end_key]
+ * (inclusive, NULL = open) and merges the results by index key, then main
+ * key. scan_fn receives each matching entry's main key and value.
+ *
+ * Returns: 0 on success, WTREE3_NOT_FOUND if a shard lacks the index or
+ *          is still building it, error code on failure
+ */
+int wtree3_sharded_index_scan(
+    wtree3_sharded_tree_t *st,
+    const char *index_name,
+    const void *start_key, size_t start_len,
+    const void *end_key, size_t end_len,
+    wtree3_scan_fn scan_fn,
+    void *user_data,
+    gerror_t *error
+);
+
+/* ============================================================
+ * Asynchronous Reads
+ * ============================================================ */
+
+typedef struct wtree3_async_t wtree3_async_t;
+
+/* wtree3_async_config_t.flags */
+#define WTREE3_ASYNC_POLL       0x01  /* Queue worker completions for wtree3_async_poll() */
+#define WTREE3_ASYNC_NO_INLINE  0x02  /* Never complete on the submitting thread */
+
+typedef struct {
+    size_t workers;                 /* Worker threads (default 4) */
+    size_t max_pending;             /* Queued requests before callers run their own (default 4096) */
+    unsigned int flags;             /* WTREE3_ASYNC_* */
+} wtree3_async_config_t;
+
+/* One completion */
+typedef struct {
+    int rc;                         /* WTREE3_OK, WTREE3_NOT_FOUND or an error code */
+    const gerror_t *error;          /* Details when rc is an error (NULL otherwise) */
+    size_t index;                   /* get_many: key position; index_get: match number / match count */
+    const void *key;                /* Main key (NULL on an index_get's final completion) */
+    size_t key_len;
+    const void *value;              /* NULL unless rc is WTREE3_OK */
+    size_t value_len;
+    bool last;                      /* No more completions for this request */
+} wtree3_async_result_t;
+
+/*
+ * Completion callback
+ *
+ * key and value are valid for the duration of the call only. It runs on
+ * the submitting thread (inline hits), on a worker thread, or - with
+ * WTREE3_ASYNC_POLL - on the thread calling wtree3_async_poll().
+ */
+typedef void (*wtree3_async_fn)(const wtree3_async_result_t *result, void *user_data);
+
+/* Counters since create (requests, not keys) */
+typedef struct {
+    uint64_t inline_hits;           /* Completed on the submitting thread, all pages resident */
+    uint64_t queued;                /* Handed to the worker pool */
+    uint64_t caller_runs;           /* Run by the submitter because the queue was full */
+} wtree3_async_stats_t;
+
+/*
+ * Create an asynchronous reader for db
+ *
+ * For event loops on databases larger than RAM, where a point lookup can
+ * block its thread on a major page fault. Each submission first checks,
+ * with mincore, whether every page the lookup would read is resident
+ * (root-to-leaf path, plus overflow pages of a large value). If so the
+ * request completes inline, before the submit call returns. Otherwise
+ * the missing page is prefetched (MADV_WILLNEED) and a worker completes
+ * the request on a pooled read txn; get_many workers prefetch every key
+ * of the batch, level by level, before the first lookup.
+ *
+ * With WTREE3_ASYNC_POLL, worker completions (key and value copied) wait
+ * in a queue and wtree3_async_fd() becomes readable; the owner runs them
+ * with wtree3_async_poll(). Without it they run on the worker, zero-copy.
+ *
+ * When max_pending requests are queued, a submission runs its request on
+ * the calling thread instead, which bounds memory at the cost of
+ * blocking that caller. Where mincore is unavailable (Windows) nothing
+ * completes inline. Trees must stay open while their requests are
+ * pending; reads see the latest committed state when they run.
+ *
+ * Returns: Async reader or NULL on error
+ */
+wtree3_async_t *wtree3_async_create(
+    wtree3_db_t *db,
+    const wtree3_async_config_t *config,
+    gerror_t *error
+);
+
+/* Complete every pending request (polled ones included), then stop the workers */
+void wtree3_async_destroy(wtree3_async_t *as);
+
+/*
+ * Look up key; fn gets one completion (last = true)
+ *
+ * Returns: 0 once the request is completed or queued (the outcome comes
+ *          through fn), WTREE3_EINVAL / WTREE3_ENOMEM if it was not taken
+ */
+int wtree3_async_get(
+    wtree3_async_t *as,
+    wtree3_tree_t *tree,
+    const void *key, size_t key_len,
+    wtree3_async_fn fn,
+    void *user_data,
+    gerror_t *error
+);
+
+/*
+ * Look up count keys; fn gets one completion per key, in the given order
+ * (result.index = position), the last with last = true. Completes inline
+ * only if every key's pages are resident. Keys are copied.
+ */
+int wtree3_async_get_many(
+    wtree3_async_t *as,
+    wtree3_tree_t *tree,
+    const MDB_val *keys, size_t count,
+    wtree3_async_fn fn,
+    void *user_data,
+    gerror_t *error
+);
+
+/*
+ * Fetch every record whose index key equals key (see wtree3_index_get_many)
+ *
+ * Always runs on a worker. fn gets one completion per match (main key and
+ * value), then a final one with last = true, no key, index = the number
+ * of matches and rc = the outcome (WTREE3_NOT_FOUND if the index is
+ * missing or still being built).
+ */
+int wtree3_async_index_get(
+    wtree3_async_t *as,
+    wtree3_tree_t *tree,
+    const char *index_name,
+    const void *key, size_t key_len,
+    wtree3_async_fn fn,
+    void *user_data,
+    gerror_t *error
+);
+
+/*
+ * Descriptor that is readable while polled completions wait (eventfd on
+ * Linux, a pipe on other POSIX systems); -1 without WTREE3_ASYNC_POLL or
+ * on Windows, where the owner polls on its own schedule.
+ */
+int wtree3_async_fd(const wtree3_async_t *as);
+
+/* Run up to max queued completions on this thread (0 = all); returns how many ran */
+size_t wtree3_async_poll(wtree3_async_t *as, size_t max);
+
+void wtree3_async_stats(const wtree3_async_t *as, wtree3_async_stats_t *out);
+
+/* ============================================================
+ * Write Batches
+ * ============================================================ */
+
+typedef struct wtree3_batch_t wtree3_batch_t;
+
+/*
+ * Create an empty write batch for db
+ *
+ * A batch records writes against any trees of db, copying keys and
+ * values, and applies them together in one write transaction. Applying
+ * sorts the ops by tree and key, folds the ops on one key (in the order
+ * they were added) into a single write, and defers index maintenance:
+ * the index entries the batch adds and removes are collected per index,
+ * sorted, and written after the main trees - removals first, so a unique
+ * index key may move between rows of one batch. Large batches touch each
+ * page once instead of once per op, and index pages split less.
+ *
+ * Semantics per key match the single-op calls run in order: an insert of
+ * a key that exists (stored or added earlier in the batch) fails with
+ * WTREE3_KEY_EXISTS, an update of a missing key with WTREE3_NOT_FOUND,
+ * upserts use the tree's merge callback, and deleting a missing key is
+ * fine. Change logs record one entry per key: its net change.
+ *
+ * Trees opened with MDB_DUPSORT are not accepted.
+ *
+ * Returns: Batch or NULL on error
+ */
+wtree3_batch_t *wtree3_batch_create(wtree3_db_t *db, gerror_t *error);
+
+void wtree3_batch_free(wtree3_batch_t *batch);
+
+/* Drop every recorded op, keeping the buffers for reuse */
+void wtree3_batch_clear(wtree3_batch_t *batch);
+
+/* Number of recorded ops */
+size_t wtree3_batch_count(const wtree3_batch_t *batch);
+
+/* Record a write (nothing touches the database until the batch is applied) */
+int wtree3_batch_insert(
+    wtree3_batch_t *batch,
+    wtree3_tree_t *tree,
+    const void *key, size_t key_len,
+    const void *value, size_t value_len,
+    gerror_t *error
+);
+
+int wtree3_batch_update(
+    wtree3_batch_t *batch,
+    wtree3_tree_t *tree,
+    const void *key, size_t key_len,
+    const void *value, size_t value_len,
+    gerror_t *error
+);
+
+int wtree3_batch_upsert(
+    wtree3_batch_t *batch,
+    wtree3_tree_t *tree,
+    const void *key, size_t key_len,
+    const void *value, size_t value_len,
+    gerror_t *error
+);
+
+int wtree3_batch_delete(
+    wtree3_batch_t *batch,
+    wtree3_tree_t *tree,
+    const void *key, size_t key_len,
+    gerror_t *error
+);
+
+/*
+ * Apply the batch in a write transaction
+ *
+ * On error the transaction holds part of the batch and must be aborted.
+ * The batch is left as it was; clear it to reuse it.
+ */
+int wtree3_batch_apply_txn(wtree3_txn_t *txn, const wtree3_batch_t *batch, gerror_t *error);
+
+/* Apply the batch in its own write transaction: all of it or nothing */
+int wtree3_batch_commit(const wtree3_batch_t *batch, gerror_t *error);
+
 /* ============================================================
  * Utility Functions
  * ============================================================ */
@@ -0,0 +1,639 @@
+/*
+ * wtree3_async.c - Asynchronous Reads
+ *
+ * A point lookup on a database larger than RAM can block its thread on a
+ * major page fault; on an event loop that stalls every connection served
+ * by the thread. The async API takes get, get_many and index get requests
+ * and completes them through a callback, without blocking the submitter
+ * on disk.
+ *
+ * Submission first probes residency (memopt_probe_key): the lookup's
+ * root-to-leaf path is walked with mincore before each page is read. If
+ * every page is in memory the request completes inline, before the
+ * submit call returns - hot hits cost one probe more than a plain get.
+ * Otherwise the missing page is advised with MADV_WILLNEED and the
+ * request goes to a worker pool, whose threads take pooled read txns.
+ * Workers handling get_many probe all keys first, level by level, so the
+ * reads for a batch are in flight together before the first lookup.
+ *
+ * Completions from workers either run on the worker (zero-copy, while
+ * its txn is open) or, with WTREE3_ASYNC_POLL, are copied to a completion
+ * queue; an eventfd (a pipe off Linux) becomes readable and the owner
+ * runs them with wtree3_async_poll() on its own thread.
+ *
+ * Where mincore is not available every request goes to the pool.
+ *
+ * This module provides:
+ * - Lifecycle: async_create, async_destroy
+ * - Requests: async_get, async_get_many, async_index_get
+ * - Completion delivery: async_fd, async_poll
+ * - Statistics: async_stats
+ */
+
+#include "wtree3_internal.h"
+#include "wthread.h"
+#include "macros.h"
+
+#if defined(__linux__)
+    #include <sys/eventfd.h>
+    #include <unistd.h>
+    #include <fcntl.h>
+    #define ASYNC_EVENTFD 1
+#elif WTREE_OS_POSIX
+    #include <unistd.h>
+    #include <fcntl.h>
+    #define ASYNC_EVENTFD 0
+#endif
+
+/* ============================================================
+ * Constants
+ * ============================================================ */
+
+#define ASYNC_DEFAULT_WORKERS       4
+#define ASYNC_DEFAULT_MAX_PENDING   4096
+#define ASYNC_PREFETCH_PASSES       8       /* Tree levels prefetched per get_many batch */
+
+/* ============================================================
+ * Internal Structures
+ * ============================================================ */
+
+typedef enum {
+    ASYNC_GET,
+    ASYNC_GET_MANY,
+    ASYNC_INDEX_GET
+} async_kind_t;
+
+/* One queued request (keys and index name copied into the same block) */
+typedef struct async_req {
+    struct async_req *next;
+    async_kind_t kind;
+    wtree3_tree_t *tree;
+    const char *index_name;
+    size_t count;
+    MDB_val *keys;
+    wtree3_async_fn fn;
+    void *user_data;
+} async_req_t;
+
+/* One completion waiting for wtree3_async_poll (key and value follow it) */
+typedef struct async_done {
+    struct async_done *next;
+    wtree3_async_fn fn;
+    void *user_data;
+    wtree3_async_result_t result;
+    gerror_t error;
+} async_done_t;
+
+struct wtree3_async_t {
+    wtree3_db_t *db;
+    unsigned int flags;
+    size_t max_pending;
+
+    wmutex_t lock;
+    wcond_t work_cond;              /* Workers: a request was queued or stopping */
+    wcond_t idle_cond;              /* Destroy: pending dropped to zero */
+    async_req_t *head, *tail;
+    size_t pending;                 /* Queued or running */
+    bool stopping;
+
+    async_done_t *done_head, *done_tail;
+    int fds[2];                     /* Readable while completions wait (-1 = none) */
+
+    wthread_t *threads;
+    size_t thread_count;
+
+    wtree3_async_stats_t stats;     /* Updated with relaxed atomics */
+};
+
+/* ============================================================
+ * Completion Delivery
+ * ============================================================ */
+
+static void fd_signal(wtree3_async_t *as) {
+#if WTREE_OS_POSIX
+    if (as->fds[1] < 0) return;
+#if ASYNC_EVENTFD
+    uint64_t one = 1;
+    ssize_t w = write(as->fds[1], &one, sizeof(one));
+#else
+    char one = 1;
+    ssize_t w = write(as->fds[1], &one, 1);
+#endif
+    (void)w;                        /* Full pipe: already readable */
+#else
+    (void)as;
+#endif
+}
+
+static void fd_drain(wtree3_async_t *as) {
+#if WTREE_OS_POSIX
+    if (as->fds[0] < 0) return;
+    char buf[64];
+    while (read(as->fds[0], buf, sizeof(buf)) > 0) { }
+#else
+    (void)as;
+#endif
+}
+
+/* Hand one result to the caller: directly, or queued copied for poll */
+static void deliver(wtree3_async_t *as, bool inline_call, wtree3_async_fn fn, void *user_data,
+                    const wtree3_async_result_t *result) {
+    if (inline_call || !(as->flags & WTREE3_ASYNC_POLL)) {
+        fn(result, user_data);
+        return;
+    }
+
+    async_done_t *d = malloc(sizeof(async_done_t) + result->key_len + result->value_len);
+    if (!d) {
+        /* Cannot queue it: report the failure in place of the result */
+        wtree3_async_result_t oom = *result;
+        gerror_t error = {0};
+        set_error(&error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to queue async completion");
+        oom.rc = WTREE3_ENOMEM;
+        oom.key = oom.value = NULL;
+        oom.key_len = oom.value_len = 0;
+        oom.error = &error;
+        fn(&oom, user_data);
+        return;
+    }
+
+    d->next = NULL;
+    d->fn = fn;
+    d->user_data = user_data;
+    d->result = *result;
+    d->result.error = NULL;
+    d->error = (gerror_t){0};
+    if (result->error) {
+        error_copy(&d->error, result->error);
+        d->result.error = &d->error;
+    }
+    unsigned char *p = (unsigned char *)(d + 1);
+    if (result->key) {
+        memcpy(p, result->key, result->key_len);
+        d->result.key = p;
+        p += result->key_len;
+    }
+    if (result->value) {
+        memcpy(p, result->value, result->value_len);
+        d->result.value = p;
+    }
+
+    wmutex_lock(&as->lock);
+    if (as->done_tail) as->done_tail->next = d;
+    else as->done_head = d;
+    as->done_tail = d;
+    wmutex_unlock(&as->lock);
+    fd_signal(as);
+}
+
+int wtree3_async_fd(const wtree3_async_t *as) {
+    return as ? as->fds[0] : -1;
+}
+
+size_t wtree3_async_poll(wtree3_async_t *as, size_t max) {
+    if (!as) return 0;
+
+    fd_drain(as);
+    wmutex_lock(&as->lock);
+    async_done_t *list = as->done_head;
+    as->done_head = as->done_tail = NULL;
+    wmutex_unlock(&as->lock);
+
+    size_t ran = 0;
+    while (list && (max == 0 || ran < max)) {
+        async_done_t *d = list;
+        list = d->next;
+        d->fn(&d->result, d->user_data);
+        free(d);
+        ran++;
+    }
+
+    /* Put back what max left over, ahead of anything queued meanwhile */
+    if (list) {
+        async_done_t *last = list;
+        while (last->next) last = last->next;
+        wmutex_lock(&as->lock);
+        last->next = as->done_head;
+        if (!as->done_head) as->done_tail = last;
+        as->done_head = list;
+        wmutex_unlock(&as->lock);
+        fd_signal(as);
+    }
+    return ran;
+}
+
+/* ============================================================
+ * Lookups
+ * ============================================================ */
+
+/* Look key up in txn and deliver the result */
+static void run_get(wtree3_async_t *as, bool inline_call, wtree3_txn_t *txn, wtree3_tree_t *tree,
+                    const MDB_val *key, size_t index, bool last,
+                    wtree3_async_fn fn, void *user_data) {
+    gerror_t error = {.flags = GERROR_LAZY};
+    wtree3_async_result_t r = {
+        .index = index,
+        .key = key->mv_data,
+        .key_len = key->mv_size,
+        .last = last,
+    };
+
+    MDB_val k = *key;
+    MDB_val v;
+    int mrc = mdb_get(txn->txn, tree->dbi, &k, &v);
+    if (mrc == 0) {
+        r.rc = tree_value_decode_txn(tree, txn, &v);
+        if (r.rc == 0) {
+            r.value = v.mv_data;
+            r.value_len = v.mv_size;
+        } else {
+            set_error(&error, WTREE3_LIB, r.rc, "Failed to decode value");
+        }
+    } else if (mrc == MDB_NOTFOUND) {
+        r.rc = WTREE3_NOT_FOUND;
+    } else {
+        r.rc = translate_mdb_error(mrc, &error);
+    }
+    if (r.rc != WTREE3_OK && r.rc != WTREE3_NOT_FOUND) r.error = &error;
+    deliver(as, inline_call, fn, user_data, &r);
+}
+
+/* Deliver a failure for every key of a request that could not run */
+static void fail_request(wtree3_async_t *as, bool inline_call, const async_req_t *req,
+                         const gerror_t *error) {
+    wtree3_async_result_t r = {
+        .rc = error->code ? error->code : WTREE3_ERROR,
+        .error = error,
+        .last = true,
+    };
+    if (req->kind == ASYNC_GET_MANY) {
+        for (size_t i = 0; i < req->count; i++) {
+            r.index = i;
+            r.key = req->keys[i].mv_data;
+            r.key_len = req->keys[i].mv_size;
+            r.last = (i + 1 == req->count);
+            deliver(as, inline_call, req->fn, req->user_data, &r);
+        }
+        return;
+    }
+    deliver(as, inline_call, req->fn, req->user_data, &r);
+}
+
+typedef struct {
+    wtree3_async_t *as;
+    const async_req_t *req;
+    size_t matches;
+} index_ctx_t;
+
+static bool index_match(const void *index_key, size_t index_key_len,
+                        const void *main_key, size_t main_key_len,
+                        const void *value, size_t value_len,
+                        void *user_data) {
+    (void)index_key;
+    (void)index_key_len;
+    index_ctx_t *ctx = (index_ctx_t *)user_data;
+    wtree3_async_result_t r = {
+        .rc = WTREE3_OK,
+        .index = ctx->matches++,
+        .key = main_key,
+        .key_len = main_key_len,
+        .value = value,
+        .value_len = value_len,
+    };
+    deliver(ctx->as, false, ctx->req->fn, ctx->req->user_data, &r);
+    return true;
+}
+
+/* Run a queued request on a worker */
+static void run_request(wtree3_async_t *as, const async_req_t *req) {
+    gerror_t error = {0};
+    wtree3_txn_t *txn = read_pool_acquire(as->db, &error);
+    if (!txn) {
+        fail_request(as, false, req, &error);
+        return;
+    }
+
+    switch (req->kind) {
+        case ASYNC_GET:
+            run_get(as, false, txn, req->tree, &req->keys[0], 0, true, req->fn, req->user_data);
+            break;
+
+        case ASYNC_GET_MANY: {
+            /* Start every key's reads before blocking on any: one level per pass */
+            for (int pass = 0; pass < ASYNC_PREFETCH_PASSES; pass++) {
+                bool missing = false;
+                for (size_t i = 0; i < req->count; i++) {
+                    int probe = memopt_probe_key(txn->txn, req->tree->dbi, req->tree->name,
+                                                 &req->keys[i], true);
+                    if (probe == MEMOPT_PROBE_MISSING) missing = true;
+                }
+                if (!missing) break;
+            }
+            for (size_t i = 0; i < req->count; i++) {
+                run_get(as, false, txn, req->tree, &req->keys[i], i, i + 1 == req->count,
+                        req->fn, req->user_data);
+            }
+            break;
+        }
+
+        case ASYNC_INDEX_GET: {
+            index_ctx_t ctx = {.as = as, .req = req};
+            int rc = wtree3_index_get_many_txn(txn, req->tree, req->index_name,
+                                               req->keys[0].mv_data, req->keys[0].mv_size,
+                                               0, index_match, &ctx, &error);
+            wtree3_async_result_t done = {
+                .rc = rc,
+                .index = ctx.matches,
+                .error = rc != WTREE3_OK ? &error : NULL,
+                .last = true,
+            };
+            deliver(as, false, req->fn, req->user_data, &done);
+            break;
+        }
+    }
+
+    read_pool_release(txn);
+}
+
+/* ============================================================
+ * Worker Pool
+ * ============================================================ */
+
+static void *async_worker(void *arg) {
+    wtree3_async_t *as = (wtree3_async_t *)arg;
+
+    wmutex_lock(&as->lock);
+    for (;;) {
+        while (!as->head && !as->stopping) wcond_wait(&as->work_cond, &as->lock);
+        if (!as->head) break;       /* Stopping and drained */
+
+        async_req_t *req = as->head;
+        as->head = req->next;
+        if (!as->head) as->tail = NULL;
+        wmutex_unlock(&as->lock);
+
+        run_request(as, req);
+        free(req);
+
+        wmutex_lock(&as->lock);
+        if (--as->pending == 0) wcond_broadcast(&as->idle_cond);
+    }
+    wmutex_unlock(&as->lock);
+    return NULL;
+}
+
+WTREE_COLD WTREE_WARN_UNUSED
+wtree3_async_t *wtree3_async_create(wtree3_db_t *db, const wtree3_async_config_t *config,
+                                    gerror_t *error) {
+    if (WTREE_UNLIKELY(!db)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Database cannot be NULL");
+        return NULL;
+    }
+
+    wtree3_async_t *as = calloc(1, sizeof(wtree3_async_t));
+    if (WTREE_UNLIKELY(!as)) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate async reader");
+        return NULL;
+    }
+    as->db = db;
+    as->flags = config ? config->flags : 0;
+    as->thread_count = (config && config->workers) ? config->workers : ASYNC_DEFAULT_WORKERS;
+    as->max_pending = (config && config->max_pending) ? config->max_pending
+                                                      : ASYNC_DEFAULT_MAX_PENDING;
+    as->fds[0] = as->fds[1] = -1;
+
+    if (wmutex_init(&as->lock) != 0) {
+        free(as);
+        set_error(error, WTREE3_LIB, WTREE3_ERROR, "Failed to initialize async lock");
+        return NULL;
+    }
+    wcond_init(&as->work_cond);
+    wcond_init(&as->idle_cond);
+
+#if WTREE_OS_POSIX
+    if (as->flags & WTREE3_ASYNC_POLL) {
+#if ASYNC_EVENTFD
+        as->fds[0] = as->fds[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        int ok = as->fds[0] >= 0;
+#else
+        int ok = pipe(as->fds) == 0;
+        if (ok) {
+            for (int i = 0; i < 2; i++) {
+                (void)fcntl(as->fds[i], F_SETFL, fcntl(as->fds[i], F_GETFL) | O_NONBLOCK);
+                (void)fcntl(as->fds[i], F_SETFD, FD_CLOEXEC);
+            }
+        } else {
+            as->fds[0] = as->fds[1] = -1;
+        }
+#endif
+        if (!ok) {
+            set_error(error, WTREE3_LIB, WTREE3_ERROR, "Failed to create completion descriptor");
+            wtree3_async_destroy(as);
+            return NULL;
+        }
+    }
+#endif
+
+    as->threads = calloc(as->thread_count, sizeof(wthread_t));
+    if (!as->threads) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate async workers");
+        as->thread_count = 0;
+        wtree3_async_destroy(as);
+        return NULL;
+    }
+    for (size_t i = 0; i < as->thread_count; i++) {
+        if (wthread_create(&as->threads[i], async_worker, as) != 0) {
+            set_error(error, WTREE3_LIB, WTREE3_ERROR, "Failed to start async worker");
+            as->thread_count = i;
+            wtree3_async_destroy(as);
+            return NULL;
+        }
+    }
+    return as;
+}
+
+WTREE_COLD
+void wtree3_async_destroy(wtree3_async_t *as) {
+    if (!as) return;
+
+    /* Finish everything queued, then stop the workers */
+    wmutex_lock(&as->lock);
+    while (as->pending > 0 && as->thread_count > 0) wcond_wait(&as->idle_cond, &as->lock);
+    as->stopping = true;
+    wcond_broadcast(&as->work_cond);
+    wmutex_unlock(&as->lock);
+
+    for (size_t i = 0; i < as->thread_count; i++) wthread_join(as->threads[i], NULL);
+    free(as->threads);
+
+    /* Completions nobody polled for still reach their callbacks */
+    if (as->flags & WTREE3_ASYNC_POLL) (void)wtree3_async_poll(as, 0);
+
+#if WTREE_OS_POSIX
+    if (as->fds[0] >= 0) close(as->fds[0]);
+    if (as->fds[1] >= 0 && as->fds[1] != as->fds[0]) close(as->fds[1]);
+#endif
+    wcond_destroy(&as->work_cond);
+    wcond_destroy(&as->idle_cond);
+    wmutex_destroy(&as->lock);
+    free(as);
+}
+
+void wtree3_async_stats(const wtree3_async_t *as, wtree3_async_stats_t *out) {
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+    if (!as) return;
+    out->inline_hits = watomic_load_u64(&as->stats.inline_hits);
+    out->queued = watomic_load_u64(&as->stats.queued);
+    out->caller_runs = watomic_load_u64(&as->stats.caller_runs);
+}
+
+/* ============================================================
+ * Submission
+ * ============================================================ */
+
+/* Copy a request into one block; NULL on ENOMEM */
+static async_req_t *req_create(async_kind_t kind, wtree3_tree_t *tree, const char *index_name,
+                               const MDB_val *keys, size_t count,
+                               wtree3_async_fn fn, void *user_data) {
+    size_t size = sizeof(async_req_t) + count * sizeof(MDB_val);
+    size_t name_len = index_name ? strlen(index_name) + 1 : 0;
+    size += name_len;
+    for (size_t i = 0; i < count; i++) size += keys[i].mv_size;
+
+    async_req_t *req = malloc(size);
+    if (!req) return NULL;
+    *req = (async_req_t){
+        .kind = kind,
+        .tree = tree,
+        .count = count,
+        .keys = (MDB_val *)(req + 1),
+        .fn = fn,
+        .user_data = user_data,
+    };
+
+    unsigned char *p = (unsigned char *)(req->keys + count);
+    for (size_t i = 0; i < count; i++) {
+        memcpy(p, keys[i].mv_data, keys[i].mv_size);
+        req->keys[i].mv_data = p;
+        req->keys[i].mv_size = keys[i].mv_size;
+        p += keys[i].mv_size;
+    }
+    if (index_name) {
+        memcpy(p, index_name, name_len);
+        req->index_name = (const char *)p;
+    }
+    return req;
+}
+
+/* Queue req for the workers; false if the queue is full (caller runs it) */
+static bool enqueue(wtree3_async_t *as, async_req_t *req) {
+    wmutex_lock(&as->lock);
+    if (as->pending >= as->max_pending || as->stopping) {
+        wmutex_unlock(&as->lock);
+        return false;
+    }
+    req->next = NULL;
+    if (as->tail) as->tail->next = req;
+    else as->head = req;
+    as->tail = req;
+    as->pending++;
+    wcond_signal(&as->work_cond);
+    wmutex_unlock(&as->lock);
+    return true;
+}
+
+/*
+ * Common submit path: complete inline when the probe finds every key's
+ * pages resident, otherwise queue (or run here when the queue is full)
+ */
+static int submit(wtree3_async_t *as, async_kind_t kind, wtree3_tree_t *tree,
+                  const char *index_name, const MDB_val *keys, size_t count,
+                  wtree3_async_fn fn, void *user_data, gerror_t *error) {
+    /* Index gets resolve many main keys: always worth a worker */
+    if (kind != ASYNC_INDEX_GET && !(as->flags & WTREE3_ASYNC_NO_INLINE)) {
+        wtree3_txn_t *txn = read_pool_acquire(as->db, error);
+        if (WTREE_UNLIKELY(!txn)) return error ? error->code : WTREE3_ERROR;
+
+        bool resident = true;
+        for (size_t i = 0; i < count; i++) {
+            /* Keep probing after a miss: the advice starts those reads too */
+            if (memopt_probe_key(txn->txn, tree->dbi, tree->name, &keys[i], true)
+                    != MEMOPT_PROBE_RESIDENT) {
+                resident = false;
+            }
+        }
+        if (resident) {
+            for (size_t i = 0; i < count; i++) {
+                run_get(as, true, txn, tree, &keys[i], i, i + 1 == count, fn, user_data);
+            }
+            read_pool_release(txn);
+            watomic_add_u64(&as->stats.inline_hits, 1);
+            return WTREE3_OK;
+        }
+        read_pool_release(txn);
+    }
+
+    async_req_t *req = req_create(kind, tree, index_name, keys, count, fn, user_data);
+    if (WTREE_UNLIKELY(!req)) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate async request");
+        return WTREE3_ENOMEM;
+    }
+    if (enqueue(as, req)) {
+        watomic_add_u64(&as->stats.queued, 1);
+        return WTREE3_OK;
+    }
+
+    /* Backlog full: run it on the caller rather than grow without bound */
+    watomic_add_u64(&as->stats.caller_runs, 1);
+    run_request(as, req);
+    free(req);
+    return WTREE3_OK;
+}
+
+WTREE_HOT
+int wtree3_async_get(wtree3_async_t *as, wtree3_tree_t *tree,
+                     const void *key, size_t key_len,
+                     wtree3_async_fn fn, void *user_data, gerror_t *error) {
+    if (WTREE_UNLIKELY(!as || !tree || !key || !fn)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Async reader, tree, key and callback cannot be NULL");
+        return WTREE3_EINVAL;
+    }
+    if (WTREE_UNLIKELY(tree->db != as->db)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Tree belongs to another database");
+        return WTREE3_EINVAL;
+    }
+    MDB_val k = {.mv_size = key_len, .mv_data = (void *)key};
+    return submit(as, ASYNC_GET, tree, NULL, &k, 1, fn, user_data, error);
+}
+
+int wtree3_async_get_many(wtree3_async_t *as, wtree3_tree_t *tree,
+                          const MDB_val *keys, size_t count,
+                          wtree3_async_fn fn, void *user_data, gerror_t *error) {
+    if (WTREE_UNLIKELY(!as || !tree || !keys || count == 0 || !fn)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                 "Async reader, tree, keys and callback cannot be NULL or empty");
+        return WTREE3_EINVAL;
+    }
+    if (WTREE_UNLIKELY(tree->db != as->db)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Tree belongs to another database");
+        return WTREE3_EINVAL;
+    }
+    return submit(as, ASYNC_GET_MANY, tree, NULL, keys, count, fn, user_data, error);
+}
+
+int wtree3_async_index_get(wtree3_async_t *as, wtree3_tree_t *tree, const char *index_name,
+                           const void *key, size_t key_len,
+                           wtree3_async_fn fn, void *user_data, gerror_t *error) {
+    if (WTREE_UNLIKELY(!as || !tree || !index_name || !key || !fn)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                 "Async reader, tree, index name, key and callback cannot be NULL");
+        return WTREE3_EINVAL;
+    }
+    if (WTREE_UNLIKELY(tree->db != as->db)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Tree belongs to another database");
+        return WTREE3_EINVAL;
+    }
+    MDB_val k = {.mv_size = key_len, .mv_data = (void *)key};
+    return submit(as, ASYNC_INDEX_GET, tree, index_name, &k, 1, fn, user_data, error);
+}
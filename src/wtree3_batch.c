@@ -0,0 +1,685 @@
+/*
+ * wtree3_batch.c - Cross-Tree Write Batches
+ *
+ * A batch records inserts, updates, upserts and deletes against any trees
+ * of one database (keys and values copied) and applies them in a single
+ * write transaction. Nothing is written while ops are added.
+ *
+ * Applying sorts the ops by tree, then by key with the tree's comparator,
+ * keeping the order they were added in among ops on one key (wsort is
+ * stable). Each run of ops on one key costs a single cursor seek: the run
+ * is folded in memory into the key's final state, and only that state is
+ * written - so an insert followed by an update is one put, and an insert
+ * followed by a delete writes nothing. The main tree sees its keys in
+ * ascending order, which keeps consecutive writes on the same leaf.
+ *
+ * Index entries are not written per op. The net change of each key (old
+ * stored value -> final value) is turned into index deletes and puts,
+ * buffered per index across the whole batch; once a tree's main writes
+ * are done, each index applies its sorted deletes, then its sorted puts
+ * (index_write_sorted: unique probes, adjacent duplicates, MDB_APPEND when
+ * the index is empty). Deletes go first, so a unique key can move from one
+ * row to another within a batch.
+ *
+ * The batch is all or nothing only as far as the transaction is: on error
+ * the caller must abort it. wtree3_batch_commit does that itself.
+ *
+ * This module provides:
+ * - Lifecycle: batch_create, batch_free, batch_clear, batch_count
+ * - Recording: batch_insert, batch_update, batch_upsert, batch_delete
+ * - Applying: batch_apply_txn, batch_commit
+ */
+
+#include "wtree3_internal.h"
+#include "wsort.h"
+#include "macros.h"
+
+/* ============================================================
+ * Constants
+ * ============================================================ */
+
+#define BATCH_INITIAL_OPS   64
+#define BATCH_INITIAL_DATA  4096
+#define BATCH_INITIAL_TREES 4
+
+/* ============================================================
+ * Internal Structures
+ * ============================================================ */
+
+typedef enum {
+    BATCH_INSERT = 0,
+    BATCH_UPDATE,
+    BATCH_UPSERT,
+    BATCH_DELETE
+} batch_kind_t;
+
+/* One recorded op; key and value live in the batch's data buffer */
+typedef struct {
+    uint32_t slot;                  /* Index into batch->trees */
+    uint32_t kind;                  /* batch_kind_t */
+    size_t key_off;
+    size_t key_len;
+    size_t value_off;
+    size_t value_len;
+} batch_op_t;
+
+struct wtree3_batch_t {
+    wtree3_db_t *db;
+
+    batch_op_t *ops;
+    size_t count;
+    size_t ops_cap;
+
+    unsigned char *data;            /* Copied keys and values (offsets survive growth) */
+    size_t data_len;
+    size_t data_cap;
+
+    wtree3_tree_t **trees;          /* Distinct trees, in order of first use */
+    size_t tree_count;
+    size_t trees_cap;
+};
+
+/* Growable list of index entries (keys owned, see index_entry_fill) */
+typedef struct {
+    index_entry_t *items;
+    size_t count;
+    size_t cap;
+} entry_vec_t;
+
+/* State of one tree's share of an apply */
+typedef struct {
+    wtree3_txn_t *txn;
+    wtree3_tree_t *tree;
+    const index_set_t *set;         /* Pinned for the whole pass */
+    MDB_cursor *cursor;             /* Main tree */
+    entry_vec_t *vecs;              /* set->count delete lists, then set->count put lists */
+} batch_pass_t;
+
+static inline MDB_val op_key(const wtree3_batch_t *batch, const batch_op_t *op) {
+    MDB_val v = {.mv_size = op->key_len, .mv_data = batch->data + op->key_off};
+    return v;
+}
+
+static inline MDB_val op_value(const wtree3_batch_t *batch, const batch_op_t *op) {
+    MDB_val v = {.mv_size = op->value_len, .mv_data = batch->data + op->value_off};
+    return v;
+}
+
+/* ============================================================
+ * Recording
+ * ============================================================ */
+
+/* buf with room for need items (NULL on ENOMEM, buf left as is) */
+static void *grow(void *buf, size_t *cap, size_t need, size_t size, size_t initial) {
+    if (need <= *cap) return buf;
+    size_t new_cap = *cap ? *cap : initial;
+    while (new_cap < need) new_cap *= 2;
+    void *grown = realloc(buf, new_cap * size);
+    if (WTREE_LIKELY(grown != NULL)) *cap = new_cap;
+    return grown;
+}
+
+/* Slot of tree in batch->trees, adding it on first use (-1 on ENOMEM) */
+static int64_t batch_slot(wtree3_batch_t *batch, wtree3_tree_t *tree) {
+    /* Batches touch a handful of trees, usually the last one again */
+    for (size_t i = batch->tree_count; i > 0; i--) {
+        if (batch->trees[i - 1] == tree) return (int64_t)(i - 1);
+    }
+    wtree3_tree_t **trees = grow(batch->trees, &batch->trees_cap, batch->tree_count + 1,
+                                 sizeof(wtree3_tree_t *), BATCH_INITIAL_TREES);
+    if (WTREE_UNLIKELY(!trees)) return -1;
+    batch->trees = trees;
+    batch->trees[batch->tree_count] = tree;
+    return (int64_t)batch->tree_count++;
+}
+
+static int batch_add(wtree3_batch_t *batch, wtree3_tree_t *tree, batch_kind_t kind,
+                     const void *key, size_t key_len,
+                     const void *value, size_t value_len,
+                     gerror_t *error) {
+    if (WTREE_UNLIKELY(!batch || !tree || !key || (kind != BATCH_DELETE && !value))) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+    if (WTREE_UNLIKELY(tree->db != batch->db)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Tree '%s' belongs to another database",
+                 tree->name);
+        return WTREE3_EINVAL;
+    }
+    /* A batch folds each key to one value; duplicate lists have many */
+    if (WTREE_UNLIKELY(tree->flags & MDB_DUPSORT)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                 "Write batches need a tree without MDB_DUPSORT");
+        return WTREE3_EINVAL;
+    }
+
+    int64_t slot = batch_slot(batch, tree);
+    batch_op_t *ops = slot < 0 ? NULL
+                               : grow(batch->ops, &batch->ops_cap, batch->count + 1,
+                                      sizeof(batch_op_t), BATCH_INITIAL_OPS);
+    if (ops) batch->ops = ops;
+    unsigned char *data = !ops ? NULL
+                               : grow(batch->data, &batch->data_cap,
+                                      batch->data_len + key_len + value_len + 1, 1,
+                                      BATCH_INITIAL_DATA);
+    if (WTREE_UNLIKELY(!data)) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate batch op");
+        return WTREE3_ENOMEM;
+    }
+    batch->data = data;
+
+    batch_op_t *op = &batch->ops[batch->count++];
+    op->slot = (uint32_t)slot;
+    op->kind = (uint32_t)kind;
+    op->key_off = batch->data_len;
+    op->key_len = key_len;
+    memcpy(batch->data + batch->data_len, key, key_len);
+    batch->data_len += key_len;
+    op->value_off = batch->data_len;
+    op->value_len = value_len;
+    if (value_len > 0) memcpy(batch->data + batch->data_len, value, value_len);
+    batch->data_len += value_len;
+    return WTREE3_OK;
+}
+
+/* ============================================================
+ * Applying: Main Tree
+ * ============================================================ */
+
+typedef struct {
+    MDB_txn *txn;
+    const wtree3_batch_t *batch;
+} batch_sort_ctx_t;
+
+/* Tree slot, then key; equal keys keep their order (wsort is stable) */
+static int batch_op_cmp(const void *a, const void *b, void *ctx) {
+    const batch_sort_ctx_t *sc = (const batch_sort_ctx_t *)ctx;
+    const batch_op_t *oa = &sc->batch->ops[*(const size_t *)a];
+    const batch_op_t *ob = &sc->batch->ops[*(const size_t *)b];
+
+    if (oa->slot != ob->slot) return oa->slot < ob->slot ? -1 : 1;
+    MDB_val ka = op_key(sc->batch, oa);
+    MDB_val kb = op_key(sc->batch, ob);
+    return mdb_cmp(sc->txn, sc->batch->trees[oa->slot]->dbi, &ka, &kb);
+}
+
+/* Upsert onto an existing value with the tree's merge callback; *out is malloc'd */
+static int batch_merge(wtree3_tree_t *tree, const MDB_val *old, const MDB_val *value,
+                       MDB_val *out, gerror_t *error) {
+    if (!tree->merge_into_fn) {
+        size_t len;
+        void *merged = tree->merge_fn(old->mv_data, old->mv_size, value->mv_data,
+                                      value->mv_size, tree->merge_user_data, &len);
+        if (!merged) {
+            set_error(error, WTREE3_LIB, WTREE3_ERROR, "Merge callback returned NULL");
+            return WTREE3_ERROR;
+        }
+        out->mv_data = merged;
+        out->mv_size = len;
+        return WTREE3_OK;
+    }
+
+    /* Start at the old length, as the reserving upsert does */
+    size_t cap = old->mv_size ? old->mv_size : 1;
+    size_t len = 0;
+    void *buf = malloc(cap);
+    bool merged = buf && tree->merge_into_fn(old->mv_data, old->mv_size, value->mv_data,
+                                             value->mv_size, tree->merge_user_data,
+                                             buf, cap, &len);
+    if (merged && len > cap) {
+        void *grown = realloc(buf, len);
+        if (grown) {
+            buf = grown;
+            cap = len;
+            merged = tree->merge_into_fn(old->mv_data, old->mv_size, value->mv_data,
+                                         value->mv_size, tree->merge_user_data,
+                                         buf, cap, &len) && len <= cap;
+        } else {
+            merged = false;
+        }
+    }
+
+    if (WTREE_UNLIKELY(!merged)) {
+        free(buf);
+        set_error(error, WTREE3_LIB, WTREE3_ERROR, "Merge callback failed");
+        return WTREE3_ERROR;
+    }
+    out->mv_data = buf;
+    out->mv_size = len;
+    return WTREE3_OK;
+}
+
+static index_entry_t *entry_vec_push(entry_vec_t *v) {
+    index_entry_t *items = grow(v->items, &v->cap, v->count + 1, sizeof(index_entry_t), 16);
+    if (WTREE_UNLIKELY(!items)) return NULL;
+    v->items = items;
+    return &v->items[v->count];
+}
+
+/* Fill the next entry of v from an extracted key (consumed either way) */
+static int entry_vec_add(entry_vec_t *v, const wtree3_index_t *idx, index_key_t *idx_key,
+                         const MDB_val *main_key, const void *value, size_t value_len,
+                         gerror_t *error) {
+    index_entry_t *entry = entry_vec_push(v);
+    if (WTREE_UNLIKELY(!entry)) {
+        index_key_release(idx_key);
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate index buffer");
+        return WTREE3_ENOMEM;
+    }
+    int rc = index_entry_fill(idx, idx_key, main_key, value, value_len, entry, error);
+    if (WTREE_LIKELY(rc == 0)) v->count++;
+    return rc;
+}
+
+/*
+ * Buffer the index changes of one key going from old to value (either
+ * NULL when the row is absent). main_key must outlive the pass: plain
+ * index entries point at it.
+ */
+static int batch_index_delta(batch_pass_t *p, const MDB_val *main_key,
+                             const MDB_val *old, const MDB_val *value,
+                             gerror_t *error) {
+    const index_set_t *set = p->set;
+    for (size_t i = 0; i < set->count; i++) {
+        wtree3_index_t *idx = set->items[i];
+        if (WTREE_UNLIKELY(!index_covers_key(p->txn->txn, p->tree, idx,
+                                             main_key->mv_data, main_key->mv_size))) {
+            continue;
+        }
+
+        index_key_t old_key, new_key;
+        old_key.heap = NULL;
+        new_key.heap = NULL;
+        bool had_old = old && index_key_extract(idx, old->mv_data, old->mv_size, &old_key) &&
+                       old_key.data;
+        bool has_new = value && index_key_extract(idx, value->mv_data, value->mv_size, &new_key);
+
+        if (WTREE_UNLIKELY(has_new && !new_key.data)) {
+            index_key_release(&old_key);
+            index_key_release(&new_key);
+            set_error(error, WTREE3_LIB, WTREE3_ERROR,
+                     "Index key extraction failed for '%s'", idx->name);
+            return WTREE3_ERROR;
+        }
+
+        /* Unchanged key: the entry is right, unless a covering payload may have moved */
+        bool same_key = had_old && has_new && old_key.len == new_key.len &&
+                        memcmp(old_key.data, new_key.data, old_key.len) == 0;
+        if (same_key && !idx->project_fn) {
+            index_key_release(&old_key);
+            index_key_release(&new_key);
+            continue;
+        }
+
+        int rc = WTREE3_OK;
+        if (had_old) {
+            rc = entry_vec_add(&p->vecs[i], idx, &old_key, main_key, NULL, 0, error);
+        } else {
+            index_key_release(&old_key);
+        }
+        if (has_new && rc == 0) {
+            rc = entry_vec_add(&p->vecs[set->count + i], idx, &new_key, main_key,
+                               value->mv_data, value->mv_size, error);
+        } else {
+            index_key_release(&new_key);
+        }
+        if (WTREE_UNLIKELY(rc != 0)) return rc;
+    }
+    return WTREE3_OK;
+}
+
+/* Write a key's final state through the cursor crud_seek left on it */
+static int batch_write_main(batch_pass_t *p, const MDB_val *key, bool found,
+                            const MDB_val *value, gerror_t *error) {
+    wtree3_tree_t *tree = p->tree;
+    MDB_txn *txn = p->txn->txn;
+    int rc;
+
+    if (!value) {
+        rc = changelog_note(tree, txn, WTREE3_CHANGE_DELETE, key->mv_data, key->mv_size,
+                            NULL, 0, error);
+        if (WTREE_UNLIKELY(rc != 0)) return rc;
+        rc = mdb_cursor_del(p->cursor, 0);
+        if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+        filter_note_remove(tree->filter);
+        return WTREE3_OK;
+    }
+
+    MDB_val mkey = *key;
+    MDB_val mval = *value;
+    codec_buf_t frame = {0};
+    rc = tree_value_encode(tree, &mval, &frame);
+    if (WTREE_LIKELY(rc == 0)) {
+        rc = mdb_cursor_put(p->cursor, &mkey, &mval, found ? MDB_CURRENT : MDB_NOOVERWRITE);
+    }
+    codec_buf_release(&frame);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+
+    if (!found) filter_note_add(tree->filter, key->mv_data, key->mv_size);
+    return changelog_note(tree, txn, found ? WTREE3_CHANGE_UPDATE : WTREE3_CHANGE_INSERT,
+                          key->mv_data, key->mv_size, value->mv_data, value->mv_size, error);
+}
+
+/* Fold the ops on one key (run, in batch order) into one write */
+static int batch_apply_run(batch_pass_t *p, const wtree3_batch_t *batch,
+                           const size_t *run, size_t n, gerror_t *error) {
+    wtree3_tree_t *tree = p->tree;
+    MDB_val key = op_key(batch, &batch->ops[run[0]]);
+    MDB_val old = {0};
+    bool found;
+    int rc = crud_seek(p->txn->txn, tree, p->cursor, &key, &old, &found);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+
+    codec_buf_t old_buf = {0};
+    void *merged = NULL;
+    if (found) {
+        rc = tree_value_decode(tree, &old, &old_buf);
+        if (WTREE_UNLIKELY(rc != 0)) {
+            rc = translate_mdb_error(rc, error);
+            goto done;
+        }
+    }
+
+    bool exists = found;
+    MDB_val cur = old;
+    for (size_t i = 0; i < n; i++) {
+        const batch_op_t *op = &batch->ops[run[i]];
+        MDB_val value = op_value(batch, op);
+
+        if (op->kind == BATCH_DELETE) {
+            exists = false;
+            continue;
+        }
+        if (op->kind == BATCH_INSERT && exists) {
+            set_error(error, WTREE3_LIB, WTREE3_KEY_EXISTS, "Key already exists");
+            rc = WTREE3_KEY_EXISTS;
+            goto done;
+        }
+        if (op->kind == BATCH_UPDATE && !exists) {
+            set_error(error, WTREE3_LIB, WTREE3_NOT_FOUND, "Key not found");
+            rc = WTREE3_NOT_FOUND;
+            goto done;
+        }
+        if (op->kind == BATCH_UPSERT && exists && (tree->merge_into_fn || tree->merge_fn)) {
+            MDB_val out;
+            rc = batch_merge(tree, &cur, &value, &out, error);
+            if (WTREE_UNLIKELY(rc != 0)) goto done;
+            free(merged);
+            merged = out.mv_data;
+            value = out;
+        }
+        cur = value;
+        exists = true;
+    }
+
+    /* Inserted and deleted again, or deleted while absent */
+    if (!found && !exists) goto done;
+
+    if (WTREE_UNLIKELY(!found && !tree_key_len_ok(tree, p->set, key.mv_size))) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                 "Key of %zu bytes does not fit the tree's fixed key width", key.mv_size);
+        rc = WTREE3_EINVAL;
+        goto done;
+    }
+
+    /* Before the write: an in-place put may overwrite the old value's bytes */
+    if (p->set->count > 0) {
+        rc = batch_index_delta(p, &key, found ? &old : NULL, exists ? &cur : NULL, error);
+        if (WTREE_UNLIKELY(rc != 0)) goto done;
+    }
+    rc = batch_write_main(p, &key, found, exists ? &cur : NULL, error);
+
+done:
+    free(merged);
+    codec_buf_release(&old_buf);
+    return rc;
+}
+
+/* ============================================================
+ * Applying: Indexes
+ * ============================================================ */
+
+/* Remove sorted entries through one cursor (missing ones are fine) */
+static int batch_delete_sorted(MDB_txn *txn, wtree3_index_t *idx,
+                               const entry_vec_t *dels, gerror_t *error) {
+    if (dels->count == 0) return WTREE3_OK;
+
+    MDB_cursor *cursor;
+    int rc = mdb_cursor_open(txn, idx->dbi, &cursor);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+
+    for (size_t i = 0; i < dels->count; i++) {
+        MDB_val k = dels->items[i].key;
+        MDB_val v = dels->items[i].main_key;
+        rc = mdb_cursor_get(cursor, &k, &v, MDB_GET_BOTH);
+        if (rc == MDB_NOTFOUND) {
+            rc = 0;
+            continue;
+        }
+        if (rc == 0) rc = mdb_cursor_del(cursor, 0);
+        if (WTREE_UNLIKELY(rc != 0)) break;
+        filter_note_remove(idx->filter);
+    }
+
+    mdb_cursor_close(cursor);
+    return rc != 0 ? translate_mdb_error(rc, error) : WTREE3_OK;
+}
+
+/* Each index: its sorted deletes, then its sorted puts */
+static int batch_write_indexes(batch_pass_t *p, gerror_t *error) {
+    MDB_txn *txn = p->txn->txn;
+    const index_set_t *set = p->set;
+
+    for (size_t i = 0; i < set->count; i++) {
+        wtree3_index_t *idx = set->items[i];
+        entry_vec_t *dels = &p->vecs[i];
+        entry_vec_t *puts = &p->vecs[set->count + i];
+
+        if (WTREE_UNLIKELY(!index_entries_sort(txn, idx, dels->items, dels->count) ||
+                           !index_entries_sort(txn, idx, puts->items, puts->count))) {
+            set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to sort index entries");
+            return WTREE3_ENOMEM;
+        }
+
+        int rc = batch_delete_sorted(txn, idx, dels, error);
+        if (WTREE_UNLIKELY(rc != 0)) return rc;
+        rc = index_write_sorted(txn, idx, puts->items, puts->count, error);
+        if (WTREE_UNLIKELY(rc != 0)) return rc;
+    }
+    return WTREE3_OK;
+}
+
+/* ============================================================
+ * Applying: Driver
+ * ============================================================ */
+
+/* Apply one tree's ops (order: their positions, sorted by key) */
+static int batch_apply_tree(wtree3_txn_t *txn, const wtree3_batch_t *batch,
+                            wtree3_tree_t *tree, const size_t *order, size_t n,
+                            gerror_t *error) {
+    batch_pass_t p = {.txn = txn, .tree = tree};
+    index_pin_t pin;
+    p.set = index_set_pin(tree, &pin);
+
+    int rc = WTREE3_OK;
+    if (p.set->count > 0) {
+        p.vecs = calloc(2 * p.set->count, sizeof(entry_vec_t));
+        if (WTREE_UNLIKELY(!p.vecs)) {
+            set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate index buffers");
+            rc = WTREE3_ENOMEM;
+            goto cleanup;
+        }
+    }
+
+    rc = mdb_cursor_open(txn->txn, tree->dbi, &p.cursor);
+    if (WTREE_UNLIKELY(rc != 0)) {
+        rc = translate_mdb_error(rc, error);
+        goto cleanup;
+    }
+
+    for (size_t i = 0; i < n && rc == 0; ) {
+        MDB_val first = op_key(batch, &batch->ops[order[i]]);
+        size_t j = i + 1;
+        while (j < n) {
+            MDB_val next = op_key(batch, &batch->ops[order[j]]);
+            if (mdb_cmp(txn->txn, tree->dbi, &first, &next) != 0) break;
+            j++;
+        }
+        rc = batch_apply_run(&p, batch, order + i, j - i, error);
+        i = j;
+    }
+    mdb_cursor_close(p.cursor);
+
+    if (rc == 0 && p.set->count > 0) {
+        uint64_t t0 = metrics_begin(tree->db);
+        rc = batch_write_indexes(&p, error);
+        metrics_end(tree->db, tree, WTREE3_METRIC_INDEX_MAINT, t0, 0);
+    }
+
+cleanup:
+    if (p.vecs) {
+        for (size_t v = 0; v < 2 * p.set->count; v++) {
+            for (size_t e = 0; e < p.vecs[v].count; e++) free(p.vecs[v].items[e].key.mv_data);
+            free(p.vecs[v].items);
+        }
+        free(p.vecs);
+    }
+    index_set_unpin(&pin);
+    return rc;
+}
+
+/* ============================================================
+ * API
+ * ============================================================ */
+
+wtree3_batch_t *wtree3_batch_create(wtree3_db_t *db, gerror_t *error) {
+    if (!db) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Database cannot be NULL");
+        return NULL;
+    }
+
+    wtree3_batch_t *batch = calloc(1, sizeof(wtree3_batch_t));
+    if (!batch) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate batch");
+        return NULL;
+    }
+    batch->db = db;
+    return batch;
+}
+
+void wtree3_batch_free(wtree3_batch_t *batch) {
+    if (!batch) return;
+    free(batch->ops);
+    free(batch->data);
+    free(batch->trees);
+    free(batch);
+}
+
+void wtree3_batch_clear(wtree3_batch_t *batch) {
+    if (!batch) return;
+    batch->count = 0;
+    batch->data_len = 0;
+    batch->tree_count = 0;
+}
+
+size_t wtree3_batch_count(const wtree3_batch_t *batch) {
+    return batch ? batch->count : 0;
+}
+
+int wtree3_batch_insert(wtree3_batch_t *batch, wtree3_tree_t *tree,
+                        const void *key, size_t key_len,
+                        const void *value, size_t value_len,
+                        gerror_t *error) {
+    return batch_add(batch, tree, BATCH_INSERT, key, key_len, value, value_len, error);
+}
+
+int wtree3_batch_update(wtree3_batch_t *batch, wtree3_tree_t *tree,
+                        const void *key, size_t key_len,
+                        const void *value, size_t value_len,
+                        gerror_t *error) {
+    return batch_add(batch, tree, BATCH_UPDATE, key, key_len, value, value_len, error);
+}
+
+int wtree3_batch_upsert(wtree3_batch_t *batch, wtree3_tree_t *tree,
+                        const void *key, size_t key_len,
+                        const void *value, size_t value_len,
+                        gerror_t *error) {
+    return batch_add(batch, tree, BATCH_UPSERT, key, key_len, value, value_len, error);
+}
+
+int wtree3_batch_delete(wtree3_batch_t *batch, wtree3_tree_t *tree,
+                        const void *key, size_t key_len,
+                        gerror_t *error) {
+    return batch_add(batch, tree, BATCH_DELETE, key, key_len, NULL, 0, error);
+}
+
+WTREE_WARN_UNUSED
+int wtree3_batch_apply_txn(wtree3_txn_t *txn, const wtree3_batch_t *batch, gerror_t *error) {
+    if (WTREE_UNLIKELY(!txn || !batch)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+    if (WTREE_UNLIKELY(!txn->is_write)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Write operation requires write transaction");
+        return WTREE3_EINVAL;
+    }
+    if (WTREE_UNLIKELY(txn->db != batch->db)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Transaction belongs to another database");
+        return WTREE3_EINVAL;
+    }
+    /* Another write could move the page the reservation points into */
+    if (WTREE_UNLIKELY(txn->reserved.cursor != NULL)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Transaction has a pending reservation");
+        return WTREE3_EINVAL;
+    }
+    if (batch->count == 0) return WTREE3_OK;
+
+    size_t *order = malloc(batch->count * sizeof(size_t));
+    if (WTREE_UNLIKELY(!order)) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate batch order");
+        return WTREE3_ENOMEM;
+    }
+    for (size_t i = 0; i < batch->count; i++) order[i] = i;
+
+    batch_sort_ctx_t ctx = {.txn = txn->txn, .batch = batch};
+    if (WTREE_UNLIKELY(!wsort(order, batch->count, sizeof(size_t), batch_op_cmp, &ctx))) {
+        free(order);
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to sort batch");
+        return WTREE3_ENOMEM;
+    }
+
+    int rc = WTREE3_OK;
+    for (size_t i = 0; i < batch->count && rc == 0; ) {
+        uint32_t slot = batch->ops[order[i]].slot;
+        size_t j = i + 1;
+        while (j < batch->count && batch->ops[order[j]].slot == slot) j++;
+        rc = batch_apply_tree(txn, batch, batch->trees[slot], order + i, j - i, error);
+        i = j;
+    }
+
+    free(order);
+    durability_write(batch->db, batch->data_len);
+    return rc;
+}
+
+WTREE_WARN_UNUSED
+int wtree3_batch_commit(const wtree3_batch_t *batch, gerror_t *error) {
+    if (!batch) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Batch cannot be NULL");
+        return WTREE3_EINVAL;
+    }
+    if (batch->count == 0) return WTREE3_OK;
+
+    wtree3_txn_t *txn = wtree3_txn_begin(batch->db, true, error);
+    if (!txn) return WTREE3_ERROR;
+
+    int rc = wtree3_batch_apply_txn(txn, batch, error);
+
+    if (rc == 0) {
+        rc = wtree3_txn_commit(txn, error);
+    } else {
+        wtree3_txn_abort(txn);
+    }
+
+    return rc;
+}
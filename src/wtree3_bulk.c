@@ -0,0 +1,345 @@
+/*
+ * wtree3_bulk.c - Sorted Bulk Loading
+ *
+ * Fast path for loading pre-sorted data. The main tree is written with
+ * MDB_APPEND, which skips the B-tree descent and fills leaf pages
+ * completely. Secondary index keys are buffered per index, sorted by
+ * (index key, main key) and written in order with MDB_APPEND /
+ * MDB_APPENDDUP, so index pages end up densely packed as well.
+ *
+ * This module provides:
+ * - wtree3_bulk_load_txn: bulk load of strictly ascending key-value pairs
+ * - Sorted index write helpers: index_entry_fill, index_entries_sort,
+ *   index_write_sorted, and the streaming index_writer_* used by the
+ *   index build engine
+ */
+
+#include "wtree3_internal.h"
+#include "macros.h"
+
+/* ============================================================
+ * Sorted Index Write Helpers
+ * ============================================================ */
+
+typedef struct {
+    MDB_txn *txn;
+    MDB_dbi dbi;
+} index_sort_ctx_t;
+
+static int index_entry_cmp(const void *a, const void *b, void *ctx) {
+    const index_entry_t *ea = (const index_entry_t *)a;
+    const index_entry_t *eb = (const index_entry_t *)b;
+    index_sort_ctx_t *sc = (index_sort_ctx_t *)ctx;
+
+    int c = mdb_cmp(sc->txn, sc->dbi, &ea->key, &eb->key);
+    if (c != 0) return c;
+    return mdb_dcmp(sc->txn, sc->dbi, &ea->main_key, &eb->main_key);
+}
+
+WTREE_WARN_UNUSED
+bool index_entries_sort(MDB_txn *txn, wtree3_index_t *idx,
+                        index_entry_t *entries, size_t count) {
+    index_sort_ctx_t ctx = {.txn = txn, .dbi = idx->dbi};
+    return wsort(entries, count, sizeof(index_entry_t), index_entry_cmp, &ctx);
+}
+
+WTREE_WARN_UNUSED
+int index_entry_fill(const wtree3_index_t *idx, index_key_t *idx_key,
+                     const MDB_val *main_key, const void *value, size_t value_len,
+                     index_entry_t *entry, gerror_t *error) {
+    size_t idx_key_len = idx_key->len;
+
+    if (WTREE_LIKELY(!idx->project_fn)) {
+        void *owned = index_key_detach(idx_key);
+        if (WTREE_UNLIKELY(!owned)) {
+            set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate index key");
+            return WTREE3_ENOMEM;
+        }
+        entry->key.mv_data = owned;
+        entry->key.mv_size = idx_key_len;
+        entry->main_key = *main_key;
+        return WTREE3_OK;
+    }
+
+    index_dup_t dup;
+    int rc = index_dup_build(idx, main_key->mv_data, main_key->mv_size,
+                             value, value_len, &dup, error);
+    if (WTREE_UNLIKELY(rc != 0)) {
+        index_key_release(idx_key);
+        return rc;
+    }
+
+    unsigned char *owned = malloc(idx_key_len + dup.val.mv_size);
+    if (WTREE_LIKELY(owned != NULL)) {
+        memcpy(owned, idx_key->data, idx_key_len);
+        memcpy(owned + idx_key_len, dup.val.mv_data, dup.val.mv_size);
+        entry->key.mv_data = owned;
+        entry->key.mv_size = idx_key_len;
+        entry->main_key.mv_data = owned + idx_key_len;
+        entry->main_key.mv_size = dup.val.mv_size;
+    }
+    index_dup_release(&dup);
+    index_key_release(idx_key);
+
+    if (WTREE_UNLIKELY(!owned)) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate index key");
+        return WTREE3_ENOMEM;
+    }
+    return WTREE3_OK;
+}
+
+/* Remember the last written entry (caller's buffers may be reused) */
+static int writer_remember(index_writer_t *w, const MDB_val *key, const MDB_val *main_key,
+                           gerror_t *error) {
+    size_t need = key->mv_size + main_key->mv_size;
+    if (need > w->prev_cap) {
+        size_t cap = w->prev_cap ? w->prev_cap : 256;
+        while (cap < need) cap *= 2;
+        void *buf = realloc(w->prev_buf, cap);
+        if (WTREE_UNLIKELY(!buf)) {
+            set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate index writer buffer");
+            return WTREE3_ENOMEM;
+        }
+        w->prev_buf = buf;
+        w->prev_cap = cap;
+    }
+    memcpy(w->prev_buf, key->mv_data, key->mv_size);
+    memcpy((char *)w->prev_buf + key->mv_size, main_key->mv_data, main_key->mv_size);
+    w->prev_key.mv_data = w->prev_buf;
+    w->prev_key.mv_size = key->mv_size;
+    w->prev_main.mv_data = (char *)w->prev_buf + key->mv_size;
+    w->prev_main.mv_size = main_key->mv_size;
+    w->have_prev = true;
+    return WTREE3_OK;
+}
+
+WTREE_WARN_UNUSED
+int index_writer_begin(index_writer_t *w, MDB_txn *txn, wtree3_index_t *idx,
+                       gerror_t *error) {
+    memset(w, 0, sizeof(*w));
+    w->txn = txn;
+    w->idx = idx;
+
+    /* Appending is only valid when nothing sorts after our first entry */
+    MDB_stat st;
+    int rc = mdb_stat(txn, idx->dbi, &st);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+    w->append = st.ms_entries == 0;
+    return WTREE3_OK;
+}
+
+WTREE_HOT WTREE_WARN_UNUSED
+int index_writer_put(index_writer_t *w, const MDB_val *key, const MDB_val *main_key,
+                     gerror_t *error) {
+    wtree3_index_t *idx = w->idx;
+    bool same_key = w->have_prev && mdb_cmp(w->txn, idx->dbi, &w->prev_key, key) == 0;
+
+    if (same_key) {
+        if (WTREE_UNLIKELY(idx->unique)) {
+            set_error(error, WTREE3_LIB, WTREE3_INDEX_ERROR,
+                     "Duplicate key for unique index '%s'", idx->name);
+            return WTREE3_INDEX_ERROR;
+        }
+        /* Identical (index key, main key) pair - already written */
+        if (mdb_dcmp(w->txn, idx->dbi, &w->prev_main, main_key) == 0) return WTREE3_OK;
+    }
+
+    MDB_val k = *key;
+    MDB_val v = *main_key;
+    unsigned int flags;
+    if (w->append) {
+        flags = same_key ? MDB_APPENDDUP : MDB_APPEND;
+    } else {
+        if (WTREE_UNLIKELY(idx->unique)) {
+            MDB_val existing;
+            int get_rc = filter_rules_out(idx->filter, w->txn, k.mv_data, k.mv_size)
+                             ? MDB_NOTFOUND : mdb_get(w->txn, idx->dbi, &k, &existing);
+            if (get_rc == 0 && mdb_dcmp(w->txn, idx->dbi, &existing, &v) != 0) {
+                set_error(error, WTREE3_LIB, WTREE3_INDEX_ERROR,
+                         "Duplicate key for unique index '%s'", idx->name);
+                return WTREE3_INDEX_ERROR;
+            }
+        }
+        flags = MDB_NODUPDATA;
+    }
+
+    int rc = mdb_put(w->txn, idx->dbi, &k, &v, flags);
+    if (WTREE_UNLIKELY(rc != 0 && !(rc == MDB_KEYEXIST && !w->append))) {
+        return translate_mdb_error(rc, error);
+    }
+    if (rc == 0) filter_note_add(idx->filter, k.mv_data, k.mv_size);
+
+    return writer_remember(w, key, main_key, error);
+}
+
+void index_writer_end(index_writer_t *w) {
+    free(w->prev_buf);
+    w->prev_buf = NULL;
+    w->prev_cap = 0;
+}
+
+WTREE_HOT WTREE_WARN_UNUSED
+int index_write_sorted(MDB_txn *txn, wtree3_index_t *idx,
+                       const index_entry_t *entries, size_t count,
+                       gerror_t *error) {
+    if (count == 0) return WTREE3_OK;
+
+    index_writer_t writer;
+    int rc = index_writer_begin(&writer, txn, idx, error);
+    if (WTREE_UNLIKELY(rc != 0)) return rc;
+
+    for (size_t i = 0; i < count && rc == 0; i++) {
+        rc = index_writer_put(&writer, &entries[i].key, &entries[i].main_key, error);
+    }
+
+    index_writer_end(&writer);
+    return rc;
+}
+
+/* ============================================================
+ * Bulk Load
+ * ============================================================ */
+
+/* Extract, sort and append all index entries for one index */
+static int bulk_load_index(MDB_txn *txn, wtree3_index_t *idx,
+                           const wtree3_kv_t *kvs, size_t count,
+                           gerror_t *error) {
+    index_entry_t *entries = malloc(count * sizeof(index_entry_t));
+    if (WTREE_UNLIKELY(!entries)) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate index buffer");
+        return WTREE3_ENOMEM;
+    }
+
+    int rc = WTREE3_OK;
+    size_t n = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        index_key_t idx_key;
+        bool should_index = index_key_extract(idx, kvs[i].value, kvs[i].value_len, &idx_key);
+        if (!should_index) continue;
+        if (WTREE_UNLIKELY(!idx_key.data)) {
+            index_key_release(&idx_key);
+            set_error(error, WTREE3_LIB, WTREE3_ERROR,
+                     "Index key extraction failed for '%s'", idx->name);
+            rc = WTREE3_ERROR;
+            goto cleanup;
+        }
+
+        MDB_val main_key = {.mv_size = kvs[i].key_len, .mv_data = (void *)kvs[i].key};
+        rc = index_entry_fill(idx, &idx_key, &main_key, kvs[i].value, kvs[i].value_len,
+                              &entries[n], error);
+        if (WTREE_UNLIKELY(rc != 0)) goto cleanup;
+        n++;
+    }
+
+    if (WTREE_UNLIKELY(!index_entries_sort(txn, idx, entries, n))) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to sort index entries");
+        rc = WTREE3_ENOMEM;
+        goto cleanup;
+    }
+
+    rc = index_write_sorted(txn, idx, entries, n, error);
+
+cleanup:
+    for (size_t i = 0; i < n; i++) {
+        free(entries[i].key.mv_data);
+    }
+    free(entries);
+    return rc;
+}
+
+/* Bulk load body; set is pinned so the width check and the index pass agree */
+static int bulk_load_run(wtree3_txn_t *txn, wtree3_tree_t *tree, const index_set_t *set,
+                         const wtree3_kv_t *kvs, size_t count,
+                         gerror_t *error) {
+    /* Validate input order before touching the tree */
+    for (size_t i = 0; i < count; i++) {
+        if (WTREE_UNLIKELY(!kvs[i].key || !kvs[i].value)) {
+            set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                     "Bulk load entry %zu has NULL key or value", i);
+            return WTREE3_EINVAL;
+        }
+        if (WTREE_UNLIKELY(!tree_key_len_ok(tree, set, kvs[i].key_len))) {
+            set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                     "Bulk load entry %zu: key of %zu bytes does not fit the tree's fixed key width",
+                     i, kvs[i].key_len);
+            return WTREE3_EINVAL;
+        }
+        if (i == 0) continue;
+
+        MDB_val prev = {.mv_size = kvs[i - 1].key_len, .mv_data = (void *)kvs[i - 1].key};
+        MDB_val cur = {.mv_size = kvs[i].key_len, .mv_data = (void *)kvs[i].key};
+        if (WTREE_UNLIKELY(mdb_cmp(txn->txn, tree->dbi, &prev, &cur) >= 0)) {
+            set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                     "Bulk load keys are not strictly ascending at position %zu", i);
+            return WTREE3_EINVAL;
+        }
+    }
+
+    /* Main tree: append-only writes */
+    MDB_cursor *cursor;
+    int rc = mdb_cursor_open(txn->txn, tree->dbi, &cursor);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+
+    codec_buf_t frame = {0};
+    for (size_t i = 0; i < count; i++) {
+        MDB_val mkey = {.mv_size = kvs[i].key_len, .mv_data = (void *)kvs[i].key};
+        MDB_val mval = {.mv_size = kvs[i].value_len, .mv_data = (void *)kvs[i].value};
+
+        rc = tree_value_encode(tree, &mval, &frame);
+        if (WTREE_LIKELY(rc == 0)) rc = mdb_cursor_put(cursor, &mkey, &mval, MDB_APPEND);
+        if (WTREE_UNLIKELY(rc != 0)) {
+            mdb_cursor_close(cursor);
+            codec_buf_release(&frame);
+            if (rc == MDB_KEYEXIST) {
+                set_error(error, WTREE3_LIB, WTREE3_KEY_EXISTS,
+                         "Bulk load keys must sort after existing entries");
+                return WTREE3_KEY_EXISTS;
+            }
+            return translate_mdb_error(rc, error);
+        }
+        filter_note_add(tree->filter, mkey.mv_data, mkey.mv_size);
+
+        rc = changelog_note(tree, txn->txn, WTREE3_CHANGE_INSERT, kvs[i].key, kvs[i].key_len,
+                            kvs[i].value, kvs[i].value_len, error);
+        if (WTREE_UNLIKELY(rc != WTREE3_OK)) {
+            mdb_cursor_close(cursor);
+            codec_buf_release(&frame);
+            return rc;
+        }
+    }
+    mdb_cursor_close(cursor);
+    codec_buf_release(&frame);
+
+    /* Secondary indexes: buffered, sorted, appended */
+    for (size_t i = 0; i < set->count; i++) {
+        wtree3_index_t *idx = set->items[i];
+        /* Appended keys sort past any online build cursor - the build picks them up */
+        if (idx->building) continue;
+        rc = bulk_load_index(txn->txn, idx, kvs, count, error);
+        if (WTREE_UNLIKELY(rc != 0)) return rc;
+    }
+
+    return WTREE3_OK;
+}
+
+WTREE_WARN_UNUSED
+int wtree3_bulk_load_txn(wtree3_txn_t *txn, wtree3_tree_t *tree,
+                         const wtree3_kv_t *kvs, size_t count,
+                         gerror_t *error) {
+    if (WTREE_UNLIKELY(!txn || !tree || !kvs || count == 0)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+
+    if (WTREE_UNLIKELY(!txn->is_write)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Write operation requires write transaction");
+        return WTREE3_EINVAL;
+    }
+
+    index_pin_t pin;
+    const index_set_t *set = index_set_pin(tree, &pin);
+    int rc = bulk_load_run(txn, tree, set, kvs, count, error);
+    index_set_unpin(&pin);
+    return rc;
+}
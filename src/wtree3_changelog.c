@@ -0,0 +1,619 @@
+/*
+ * wtree3_changelog.c - Change-Data-Capture Log
+ *
+ * A tree with a change log gets a second DBI, "\x01changes:<tree>", that
+ * maps an 8-byte big-endian sequence number to one record per write:
+ *   [op:1][key_len:4][key][value]
+ * The value is present only when the log was enabled with values. Every
+ * write path appends (MDB_APPEND | MDB_RESERVE) in the writer's txn, so a
+ * record commits or aborts with its change and one write txn at a time
+ * means sequence order is commit order. The next sequence is the last
+ * key + 1: the rightmost leaf is always hot, so this costs no extra I/O.
+ *
+ * Retention removes records from the front. The highest sequence ever
+ * removed is kept as the log's base in its config record
+ * "\x01changes:<tree>:" = [format:4][flags:4][base:8], so an emptied log
+ * continues after it and readers can tell a consumer it fell behind.
+ *
+ * This module provides:
+ * - wtree3_tree_enable_changelog, wtree3_tree_disable_changelog
+ * - wtree3_changelog_bounds_txn, wtree3_changelog_read_txn
+ * - wtree3_changelog_truncate[_txn]
+ * - wtree3_changelog_cursor_open/next/position/close
+ * - changelog_append, changelog_auto_load, changelog_delete_txn
+ */
+
+#include "wtree3_internal.h"
+#include "macros.h"
+
+/* ============================================================
+ * Constants
+ * ============================================================ */
+
+#define CHANGELOG_FORMAT        1
+#define CHANGELOG_CONFIG_SIZE   16      /* [format:4][flags:4][base:8] */
+#define CHANGELOG_FLAG_VALUES   0x01
+#define CHANGELOG_RECORD_HDR    5       /* [op:1][key_len:4] */
+#define CHANGELOG_SEQ_SIZE      8
+
+/* ============================================================
+ * Internal Structures
+ * ============================================================ */
+
+struct wtree3_changelog_cursor_t {
+    wtree3_tree_t *tree;
+    wtree3_txn_t *txn;              /* Renewed for every batch */
+    bool active;                    /* txn holds the previous batch */
+    uint64_t next;                  /* First sequence of the next batch (0 = oldest) */
+};
+
+/* ============================================================
+ * Records
+ * ============================================================ */
+
+static inline void seq_put(uint8_t *out, uint64_t seq) {
+    for (int i = CHANGELOG_SEQ_SIZE - 1; i >= 0; i--) {
+        out[i] = (uint8_t)seq;
+        seq >>= 8;
+    }
+}
+
+static inline uint64_t seq_get(const MDB_val *key) {
+    const uint8_t *p = (const uint8_t *)key->mv_data;
+    uint64_t seq = 0;
+    for (int i = 0; i < CHANGELOG_SEQ_SIZE; i++) seq = (seq << 8) | p[i];
+    return seq;
+}
+
+/* Log DBI name, also the metadata "tree name" owning the config record */
+static char *changelog_name(const char *tree_name) {
+    size_t len = strlen(WTREE3_CHANGELOG_PREFIX) + strlen(tree_name) + 1;
+    char *name = malloc(len);
+    if (WTREE_LIKELY(name)) snprintf(name, len, "%s%s", WTREE3_CHANGELOG_PREFIX, tree_name);
+    return name;
+}
+
+/* Config record of a tree; MDB_NOTFOUND if it has none */
+static int config_load(MDB_txn *txn, const char *tree_name, uint32_t *flags, uint64_t *base) {
+    char *owner = changelog_name(tree_name);
+    char *meta_key = owner ? build_metadata_key(owner, "") : NULL;
+    free(owner);
+    if (WTREE_UNLIKELY(!meta_key)) return ENOMEM;
+
+    MDB_dbi meta_dbi;
+    MDB_val key = {.mv_size = strlen(meta_key), .mv_data = meta_key}, val;
+    int rc = mdb_dbi_open(txn, WTREE3_META_DB, 0, &meta_dbi);
+    if (rc == 0) rc = mdb_get(txn, meta_dbi, &key, &val);
+    free(meta_key);
+    if (rc != 0) return rc;
+
+    uint32_t format = 0;
+    if (val.mv_size == CHANGELOG_CONFIG_SIZE) memcpy(&format, val.mv_data, 4);
+    if (WTREE_UNLIKELY(format != CHANGELOG_FORMAT)) return MDB_CORRUPTED;
+    if (flags) memcpy(flags, (uint8_t *)val.mv_data + 4, 4);
+    if (base) memcpy(base, (uint8_t *)val.mv_data + 8, 8);
+    return 0;
+}
+
+static int config_store(MDB_txn *txn, wtree3_db_t *db, const char *tree_name,
+                        uint32_t flags, uint64_t base, gerror_t *error) {
+    char *owner = changelog_name(tree_name);
+    if (WTREE_UNLIKELY(!owner)) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to build change log key");
+        return WTREE3_ENOMEM;
+    }
+
+    uint8_t record[CHANGELOG_CONFIG_SIZE];
+    uint32_t format = CHANGELOG_FORMAT;
+    memcpy(record, &format, 4);
+    memcpy(record + 4, &flags, 4);
+    memcpy(record + 8, &base, 8);
+
+    int rc = metadata_put_txn(txn, db, owner, "", record, sizeof(record), error);
+    free(owner);
+    return rc;
+}
+
+/* Highest sequence removed so far (0 = none, or no config record) */
+static int log_base(MDB_txn *txn, const char *tree_name, uint64_t *base) {
+    *base = 0;
+    int rc = config_load(txn, tree_name, NULL, base);
+    return rc == MDB_NOTFOUND ? 0 : rc;
+}
+
+/* Newest sequence handed out: the last key, or the base of an empty log */
+static int newest_seq(MDB_txn *txn, MDB_cursor *cursor, const char *tree_name, uint64_t *seq) {
+    MDB_val key, val;
+    int rc = mdb_cursor_get(cursor, &key, &val, MDB_LAST);
+    if (rc == MDB_NOTFOUND) return log_base(txn, tree_name, seq);
+    if (WTREE_UNLIKELY(rc != 0)) return rc;
+    if (WTREE_UNLIKELY(key.mv_size != CHANGELOG_SEQ_SIZE)) return MDB_CORRUPTED;
+    *seq = seq_get(&key);
+    return 0;
+}
+
+static bool record_parse(const MDB_val *key, const MDB_val *val, wtree3_change_t *out) {
+    if (WTREE_UNLIKELY(key->mv_size != CHANGELOG_SEQ_SIZE || val->mv_size < CHANGELOG_RECORD_HDR)) {
+        return false;
+    }
+
+    const uint8_t *p = (const uint8_t *)val->mv_data;
+    uint32_t key_len;
+    memcpy(&key_len, p + 1, 4);
+    if (WTREE_UNLIKELY(key_len > val->mv_size - CHANGELOG_RECORD_HDR ||
+                       p[0] < WTREE3_CHANGE_INSERT || p[0] > WTREE3_CHANGE_CLEAR)) {
+        return false;
+    }
+
+    size_t value_len = val->mv_size - CHANGELOG_RECORD_HDR - key_len;
+    out->seq = seq_get(key);
+    out->op = (wtree3_change_op_t)p[0];
+    out->key = key_len ? p + CHANGELOG_RECORD_HDR : NULL;
+    out->key_len = key_len;
+    out->value = value_len ? p + CHANGELOG_RECORD_HDR + key_len : NULL;
+    out->value_len = value_len;
+    return true;
+}
+
+/* ============================================================
+ * Internal Hooks
+ * ============================================================ */
+
+WTREE_WARN_UNUSED
+int changelog_append(wtree3_tree_t *tree, MDB_txn *txn, wtree3_change_op_t op,
+                     const void *key, size_t key_len,
+                     const void *value, size_t value_len,
+                     gerror_t *error) {
+    const wtree3_changelog_t *log = tree->changelog;
+    if (!log->values || op == WTREE3_CHANGE_DELETE || op == WTREE3_CHANGE_CLEAR) value_len = 0;
+
+    MDB_cursor *cursor;
+    int rc = mdb_cursor_open(txn, log->dbi, &cursor);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+
+    uint64_t seq = 0;
+    rc = newest_seq(txn, cursor, tree->name, &seq);
+
+    uint8_t seq_key[CHANGELOG_SEQ_SIZE];
+    seq_put(seq_key, seq + 1);
+    MDB_val k = {.mv_size = sizeof(seq_key), .mv_data = seq_key};
+    MDB_val v = {.mv_size = CHANGELOG_RECORD_HDR + key_len + value_len, .mv_data = NULL};
+    if (WTREE_LIKELY(rc == 0)) rc = mdb_cursor_put(cursor, &k, &v, MDB_APPEND | MDB_RESERVE);
+
+    if (WTREE_LIKELY(rc == 0)) {
+        uint8_t *p = (uint8_t *)v.mv_data;
+        uint32_t len32 = (uint32_t)key_len;
+        p[0] = (uint8_t)op;
+        memcpy(p + 1, &len32, 4);
+        if (key_len) memcpy(p + CHANGELOG_RECORD_HDR, key, key_len);
+        if (value_len) memcpy(p + CHANGELOG_RECORD_HDR + key_len, value, value_len);
+    }
+    mdb_cursor_close(cursor);
+
+    return WTREE_UNLIKELY(rc != 0) ? translate_mdb_error(rc, error) : WTREE3_OK;
+}
+
+typedef struct {
+    const char *name;               /* Log DBI name */
+    MDB_dbi *out_dbi;
+    gerror_t *error;
+} open_log_ctx_t;
+
+static int open_log_txn(MDB_txn *txn, void *user_data) {
+    open_log_ctx_t *ctx = (open_log_ctx_t *)user_data;
+    int rc = mdb_dbi_open(txn, ctx->name, MDB_CREATE, ctx->out_dbi);
+    return WTREE_UNLIKELY(rc != 0) ? translate_mdb_error(rc, ctx->error) : WTREE3_OK;
+}
+
+WTREE_COLD WTREE_WARN_UNUSED
+int changelog_auto_load(wtree3_tree_t *tree, gerror_t *error) {
+    wtree3_txn_t *txn = read_pool_acquire(tree->db, error);
+    if (WTREE_UNLIKELY(!txn)) return WTREE3_ERROR;
+
+    uint32_t flags = 0;
+    int rc = config_load(txn->txn, tree->name, &flags, NULL);
+    read_pool_release(txn);
+    if (rc == MDB_NOTFOUND) return WTREE3_OK;
+    if (WTREE_UNLIKELY(rc == MDB_CORRUPTED)) {
+        set_error(error, WTREE3_LIB, WTREE3_ERROR,
+                 "Malformed change log record for tree '%s'", tree->name);
+        return WTREE3_ERROR;
+    }
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+
+    /* A log that can't be opened would silently miss changes: fail the open */
+    wtree3_changelog_t *log = calloc(1, sizeof(wtree3_changelog_t));
+    char *name = changelog_name(tree->name);
+    if (WTREE_UNLIKELY(!log || !name)) {
+        free(log);
+        free(name);
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate change log");
+        return WTREE3_ENOMEM;
+    }
+
+    /* In a write txn: the handle must outlive it */
+    open_log_ctx_t ctx = {.name = name, .out_dbi = &log->dbi, .error = error};
+    rc = with_write_txn(tree->db, open_log_txn, &ctx, error);
+    free(name);
+    if (WTREE_UNLIKELY(rc != 0)) {
+        free(log);
+        return rc;
+    }
+
+    log->values = (flags & CHANGELOG_FLAG_VALUES) != 0;
+    tree->changelog = log;
+    return WTREE3_OK;
+}
+
+int changelog_delete_txn(MDB_txn *txn, const char *tree_name) {
+    char *name = changelog_name(tree_name);
+    char *meta_key = name ? build_metadata_key(name, "") : NULL;
+    if (WTREE_UNLIKELY(!meta_key)) {
+        free(name);
+        return ENOMEM;
+    }
+
+    MDB_dbi dbi;
+    int rc = mdb_dbi_open(txn, name, 0, &dbi);
+    if (rc == 0) rc = mdb_drop(txn, dbi, 1);
+    if (rc == 0 || rc == MDB_NOTFOUND) {
+        MDB_val key = {.mv_size = strlen(meta_key), .mv_data = meta_key};
+        rc = mdb_dbi_open(txn, WTREE3_META_DB, 0, &dbi);
+        if (rc == 0) rc = mdb_del(txn, dbi, &key, NULL);
+    }
+    free(meta_key);
+    free(name);
+    return rc == MDB_NOTFOUND ? 0 : rc;
+}
+
+/* ============================================================
+ * Configuration
+ * ============================================================ */
+
+typedef struct {
+    wtree3_tree_t *tree;
+    uint32_t flags;
+    MDB_dbi *out_dbi;
+    gerror_t *error;
+} enable_ctx_t;
+
+static int enable_changelog_txn(MDB_txn *txn, void *user_data) {
+    enable_ctx_t *ctx = (enable_ctx_t *)user_data;
+
+    char *name = changelog_name(ctx->tree->name);
+    if (WTREE_UNLIKELY(!name)) {
+        set_error(ctx->error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to build change log name");
+        return WTREE3_ENOMEM;
+    }
+    int rc = mdb_dbi_open(txn, name, MDB_CREATE, ctx->out_dbi);
+    free(name);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, ctx->error);
+
+    /* Re-enabling keeps the log, and with it the base */
+    uint64_t base = 0;
+    rc = log_base(txn, ctx->tree->name, &base);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, ctx->error);
+
+    return config_store(txn, ctx->tree->db, ctx->tree->name, ctx->flags, base, ctx->error);
+}
+
+WTREE_COLD WTREE_WARN_UNUSED
+int wtree3_tree_enable_changelog(wtree3_tree_t *tree, const wtree3_changelog_config_t *config,
+                                 gerror_t *error) {
+    if (WTREE_UNLIKELY(!tree)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Tree cannot be NULL");
+        return WTREE3_EINVAL;
+    }
+    if (WTREE_UNLIKELY(tree->flags & MDB_DUPSORT)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                 "Change logs are not supported on DUPSORT trees");
+        return WTREE3_EINVAL;
+    }
+
+    wtree3_changelog_t *log = tree->changelog;
+    if (!log) {
+        log = calloc(1, sizeof(wtree3_changelog_t));
+        if (WTREE_UNLIKELY(!log)) {
+            set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate change log");
+            return WTREE3_ENOMEM;
+        }
+    }
+
+    bool values = config && config->values;
+    MDB_dbi dbi;
+    enable_ctx_t ctx = {
+        .tree = tree,
+        .flags = values ? CHANGELOG_FLAG_VALUES : 0,
+        .out_dbi = &dbi,
+        .error = error
+    };
+    int rc = with_write_txn(tree->db, enable_changelog_txn, &ctx, error);
+    if (WTREE_UNLIKELY(rc != 0)) {
+        if (log != tree->changelog) free(log);
+        return rc;
+    }
+
+    log->dbi = dbi;
+    log->values = values;
+    tree->changelog = log;
+    return WTREE3_OK;
+}
+
+typedef struct {
+    wtree3_tree_t *tree;
+    gerror_t *error;
+} disable_ctx_t;
+
+static int disable_changelog_txn(MDB_txn *txn, void *user_data) {
+    disable_ctx_t *ctx = (disable_ctx_t *)user_data;
+    int rc = changelog_delete_txn(txn, ctx->tree->name);
+    return WTREE_UNLIKELY(rc != 0) ? translate_mdb_error(rc, ctx->error) : WTREE3_OK;
+}
+
+WTREE_COLD WTREE_WARN_UNUSED
+int wtree3_tree_disable_changelog(wtree3_tree_t *tree, gerror_t *error) {
+    if (WTREE_UNLIKELY(!tree)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Tree cannot be NULL");
+        return WTREE3_EINVAL;
+    }
+    if (!tree->changelog) return WTREE3_OK;
+
+    disable_ctx_t ctx = {.tree = tree, .error = error};
+    int rc = with_write_txn(tree->db, disable_changelog_txn, &ctx, error);
+    if (WTREE_UNLIKELY(rc != 0)) return rc;
+
+    free(tree->changelog);
+    tree->changelog = NULL;
+    return WTREE3_OK;
+}
+
+/* ============================================================
+ * Reads
+ * ============================================================ */
+
+static bool check_log(wtree3_txn_t *txn, wtree3_tree_t *tree, gerror_t *error) {
+    if (WTREE_UNLIKELY(!txn || !tree)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return false;
+    }
+    if (WTREE_UNLIKELY(!tree->changelog)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Tree '%s' has no change log", tree->name);
+        return false;
+    }
+    return true;
+}
+
+WTREE_WARN_UNUSED
+int wtree3_changelog_bounds_txn(wtree3_txn_t *txn, wtree3_tree_t *tree,
+                                uint64_t *first_out, uint64_t *last_out,
+                                gerror_t *error) {
+    if (WTREE_UNLIKELY(!check_log(txn, tree, error))) return WTREE3_EINVAL;
+
+    MDB_cursor *cursor;
+    int rc = mdb_cursor_open(txn->txn, tree->changelog->dbi, &cursor);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+
+    MDB_val key, val;
+    uint64_t first = 0, last = 0;
+    rc = newest_seq(txn->txn, cursor, tree->name, &last);
+    if (rc == 0) rc = mdb_cursor_get(cursor, &key, &val, MDB_FIRST);
+    if (rc == 0) {
+        first = seq_get(&key);
+    } else if (rc == MDB_NOTFOUND) {
+        first = last + 1;
+        rc = 0;
+    }
+    mdb_cursor_close(cursor);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+
+    if (first_out) *first_out = first;
+    if (last_out) *last_out = last;
+    return WTREE3_OK;
+}
+
+WTREE_WARN_UNUSED
+int wtree3_changelog_read_txn(wtree3_txn_t *txn, wtree3_tree_t *tree, uint64_t from_seq,
+                              wtree3_change_t *out, size_t max, size_t *count_out,
+                              gerror_t *error) {
+    if (WTREE_UNLIKELY(!check_log(txn, tree, error))) return WTREE3_EINVAL;
+    if (WTREE_UNLIKELY(!count_out || (max && !out))) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+    *count_out = 0;
+
+    /* Records from from_seq on are gone: the consumer missed changes */
+    uint64_t base = 0;
+    int rc = from_seq ? log_base(txn->txn, tree->name, &base) : 0;
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+    if (WTREE_UNLIKELY(from_seq && from_seq <= base)) {
+        set_error(error, WTREE3_LIB, WTREE3_NOT_FOUND,
+                 "Change log of '%s' was truncated past sequence %llu",
+                 tree->name, (unsigned long long)base);
+        return WTREE3_NOT_FOUND;
+    }
+    if (max == 0) return WTREE3_OK;
+
+    MDB_cursor *cursor;
+    rc = mdb_cursor_open(txn->txn, tree->changelog->dbi, &cursor);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+
+    uint8_t seq_key[CHANGELOG_SEQ_SIZE];
+    seq_put(seq_key, from_seq);
+    MDB_val key = {.mv_size = sizeof(seq_key), .mv_data = seq_key}, val;
+
+    size_t n = 0;
+    rc = mdb_cursor_get(cursor, &key, &val, MDB_SET_RANGE);
+    while (rc == 0 && n < max) {
+        if (WTREE_UNLIKELY(!record_parse(&key, &val, &out[n]))) {
+            mdb_cursor_close(cursor);
+            set_error(error, WTREE3_LIB, WTREE3_ERROR,
+                     "Malformed change log record in tree '%s'", tree->name);
+            return WTREE3_ERROR;
+        }
+        n++;
+        if (n < max) rc = mdb_cursor_get(cursor, &key, &val, MDB_NEXT);
+    }
+    mdb_cursor_close(cursor);
+    if (WTREE_UNLIKELY(rc != 0 && rc != MDB_NOTFOUND)) return translate_mdb_error(rc, error);
+
+    *count_out = n;
+    return WTREE3_OK;
+}
+
+/* ============================================================
+ * Retention
+ * ============================================================ */
+
+WTREE_WARN_UNUSED
+int wtree3_changelog_truncate_txn(wtree3_txn_t *txn, wtree3_tree_t *tree, uint64_t before_seq,
+                                  size_t *removed_out, gerror_t *error) {
+    if (WTREE_UNLIKELY(!check_log(txn, tree, error))) return WTREE3_EINVAL;
+    if (WTREE_UNLIKELY(!txn->is_write)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Write operation requires write transaction");
+        return WTREE3_EINVAL;
+    }
+    if (removed_out) *removed_out = 0;
+
+    MDB_dbi dbi = tree->changelog->dbi;
+    MDB_cursor *cursor;
+    int rc = mdb_cursor_open(txn->txn, dbi, &cursor);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+
+    MDB_val key, val;
+    size_t removed = 0;
+    uint64_t highest = 0;           /* Highest sequence removed */
+    rc = mdb_cursor_get(cursor, &key, &val, MDB_LAST);
+    if (rc == 0 && seq_get(&key) < before_seq) {
+        /* Everything goes: empty the DBI in place */
+        MDB_stat st;
+        highest = seq_get(&key);
+        mdb_cursor_close(cursor);
+        rc = mdb_stat(txn->txn, dbi, &st);
+        if (rc == 0) rc = mdb_drop(txn->txn, dbi, 0);
+        if (rc == 0) removed = (size_t)st.ms_entries;
+    } else {
+        rc = rc == 0 ? mdb_cursor_get(cursor, &key, &val, MDB_FIRST) : rc;
+        while (rc == 0 && seq_get(&key) < before_seq) {
+            highest = seq_get(&key);
+            rc = mdb_cursor_del(cursor, 0);
+            if (WTREE_UNLIKELY(rc != 0)) break;
+            removed++;
+            /* The cursor was left on the following entry; MDB_NEXT returns it */
+            rc = mdb_cursor_get(cursor, &key, &val, MDB_NEXT);
+        }
+        mdb_cursor_close(cursor);
+    }
+    if (WTREE_UNLIKELY(rc != 0 && rc != MDB_NOTFOUND)) return translate_mdb_error(rc, error);
+    if (removed == 0) return WTREE3_OK;
+
+    /* Remember how far the front moved */
+    uint32_t flags = 0;
+    uint64_t base = 0;
+    rc = config_load(txn->txn, tree->name, &flags, &base);
+    if (WTREE_UNLIKELY(rc != 0 && rc != MDB_NOTFOUND)) return translate_mdb_error(rc, error);
+    if (highest < base) highest = base;
+    rc = config_store(txn->txn, tree->db, tree->name, flags, highest, error);
+    if (WTREE_UNLIKELY(rc != WTREE3_OK)) return rc;
+
+    if (removed_out) *removed_out = removed;
+    return WTREE3_OK;
+}
+
+WTREE_WARN_UNUSED
+int wtree3_changelog_truncate(wtree3_tree_t *tree, uint64_t before_seq,
+                              size_t *removed_out, gerror_t *error) {
+    if (WTREE_UNLIKELY(!tree)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Tree cannot be NULL");
+        return WTREE3_EINVAL;
+    }
+
+    wtree3_txn_t *txn = wtree3_txn_begin(tree->db, true, error);
+    if (WTREE_UNLIKELY(!txn)) return WTREE3_ERROR;
+
+    int rc = wtree3_changelog_truncate_txn(txn, tree, before_seq, removed_out, error);
+    if (rc != WTREE3_OK) {
+        wtree3_txn_abort(txn);
+        return rc;
+    }
+    return wtree3_txn_commit(txn, error);
+}
+
+/* ============================================================
+ * Consumer Cursor
+ * ============================================================ */
+
+WTREE_COLD
+wtree3_changelog_cursor_t* wtree3_changelog_cursor_open(wtree3_tree_t *tree, uint64_t from_seq,
+                                                        gerror_t *error) {
+    if (WTREE_UNLIKELY(!tree)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Tree cannot be NULL");
+        return NULL;
+    }
+    if (WTREE_UNLIKELY(!tree->changelog)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Tree '%s' has no change log", tree->name);
+        return NULL;
+    }
+
+    wtree3_changelog_cursor_t *cursor = calloc(1, sizeof(wtree3_changelog_cursor_t));
+    if (WTREE_UNLIKELY(!cursor)) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate change log cursor");
+        return NULL;
+    }
+
+    /* Not a pooled txn: it is parked in the reset state between batches */
+    cursor->txn = wtree3_txn_begin(tree->db, false, error);
+    if (WTREE_UNLIKELY(!cursor->txn)) {
+        free(cursor);
+        return NULL;
+    }
+    wtree3_txn_reset(cursor->txn);
+
+    cursor->tree = tree;
+    cursor->next = from_seq;
+    return cursor;
+}
+
+WTREE_WARN_UNUSED
+int wtree3_changelog_cursor_next(wtree3_changelog_cursor_t *cursor, wtree3_change_t *out,
+                                 size_t max, size_t *count_out, gerror_t *error) {
+    if (WTREE_UNLIKELY(!cursor || !count_out)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+    *count_out = 0;
+
+    /* The previous batch is released here */
+    if (cursor->active) {
+        wtree3_txn_reset(cursor->txn);
+        cursor->active = false;
+    }
+    int rc = wtree3_txn_renew(cursor->txn, error);
+    if (WTREE_UNLIKELY(rc != WTREE3_OK)) return rc;
+
+    size_t n = 0;
+    rc = wtree3_changelog_read_txn(cursor->txn, cursor->tree, cursor->next, out, max, &n, error);
+
+    /* Caught up (or failed): hold no snapshot while idle */
+    if (rc != WTREE3_OK || n == 0) {
+        wtree3_txn_reset(cursor->txn);
+        return rc;
+    }
+
+    cursor->active = true;
+    cursor->next = out[n - 1].seq + 1;
+    *count_out = n;
+    return WTREE3_OK;
+}
+
+WTREE_PURE
+uint64_t wtree3_changelog_cursor_position(const wtree3_changelog_cursor_t *cursor) {
+    return cursor ? cursor->next : 0;
+}
+
+WTREE_COLD
+void wtree3_changelog_cursor_close(wtree3_changelog_cursor_t *cursor) {
+    if (!cursor) return;
+    wtree3_txn_abort(cursor->txn);
+    free(cursor);
+}
@@ -0,0 +1,757 @@
+/*
+ * wtree3_codec.c - Transparent Value Compression
+ *
+ * A tree with a codec stores every value as a frame:
+ *   [0x00][value]                          stored raw
+ *   [0x01][raw length, LEB128][LZ stream]  compressed
+ * Values shorter than the codec's min_size, and values the compressor
+ * cannot shrink, are stored raw. Readers always see the original bytes.
+ *
+ * The LZ stream is a run of LZ4-style sequences
+ *   [token: literals:4 | match-4:4][literal length ext][literals]
+ *   [offset:2 LE][match length ext]
+ * where a nibble of 15 continues in 255-saturated extension bytes and the
+ * last sequence stops after its literals. Offsets reach up to 64 KiB back
+ * into a window made of the dictionary followed by the output so far, so
+ * even a small value can copy field names and common fragments from the
+ * dictionary instead of carrying them.
+ *
+ * Dictionaries come from wtree3_codec_train(): 8-byte n-grams are counted
+ * by the number of samples they occur in, sample segments are ranked by
+ * how many shared n-grams they hold, and the best segments are packed with
+ * the most valuable ones last, where offsets are shortest.
+ *
+ * Decoded values are written to a caller buffer (callback scans, index
+ * maintenance) or to the transaction's decode arena for the reads whose
+ * results stay valid until the transaction ends (wtree3_get_txn, get_many,
+ * batch scans, joins).
+ *
+ * This module provides:
+ * - wtree3_tree_set_codec, wtree3_codec_train
+ * - codec_encode, codec_decode, codec_decode_txn
+ * - codec_arena_reset, codec_arena_free
+ * - codec_create, codec_auto_load, codec_free
+ */
+
+#include "wtree3_internal.h"
+#include "macros.h"
+
+/* ============================================================
+ * Constants
+ * ============================================================ */
+
+#define CODEC_FORMAT            1
+#define CODEC_RECORD_HDR        12      /* [format:4][min_size:4][dict_len:4] then the dictionary */
+#define CODEC_TAG_RAW           0x00
+#define CODEC_TAG_LZ            0x01
+#define CODEC_DEFAULT_MIN_SIZE  64
+#define CODEC_MIN_MATCH         4
+#define CODEC_MAX_OFFSET        65535
+#define CODEC_DICT_HASH_BITS    14
+#define CODEC_HASH_BITS_MIN     8
+#define CODEC_HASH_BITS_MAX     12
+#define CODEC_ARENA_BLOCK       (64 * 1024)
+
+#define TRAIN_NGRAM             8
+#define TRAIN_SEGMENT           32
+#define TRAIN_STEP              8       /* Distance between candidate segment starts */
+#define TRAIN_TABLE_BITS        16
+
+/* ============================================================
+ * Internal Structures
+ * ============================================================ */
+
+struct wtree3_codec {
+    uint32_t min_size;
+    size_t dict_len;                /* 0 = no dictionary */
+    unsigned char *dict;
+    uint32_t *dict_table;           /* Last dictionary position + 1 per hash (0 = none) */
+};
+
+/* Decode arena block, newest first */
+struct codec_block {
+    codec_block_t *next;
+    size_t used;
+    size_t cap;
+    unsigned char data[];
+};
+
+/* ============================================================
+ * Helpers
+ * ============================================================ */
+
+static inline uint32_t read32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static inline uint32_t hash4(const unsigned char *p, unsigned int bits) {
+    return (read32(p) * 2654435761u) >> (32 - bits);
+}
+
+static size_t varint_put(unsigned char *out, size_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (unsigned char)v;
+    return n;
+}
+
+static bool varint_get(const unsigned char *p, size_t len, size_t *v, size_t *used) {
+    size_t value = 0;
+    for (size_t i = 0; i < len && i < 10; i++) {
+        value |= (size_t)(p[i] & 0x7f) << (7 * i);
+        if (!(p[i] & 0x80)) {
+            *v = value;
+            *used = i + 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool buf_reserve(codec_buf_t *buf, size_t size) {
+    if (buf->cap >= size) return true;
+    size_t cap = buf->cap ? buf->cap : 256;
+    while (cap < size) cap *= 2;
+    unsigned char *grown = realloc(buf->data, cap);
+    if (WTREE_UNLIKELY(!grown)) return false;
+    buf->data = grown;
+    buf->cap = cap;
+    return true;
+}
+
+/* ============================================================
+ * Compressor
+ * ============================================================ */
+
+typedef struct {
+    unsigned char *p;
+    unsigned char *end;
+} lz_out_t;
+
+static inline bool put_len_ext(lz_out_t *o, size_t len) {
+    for (; len >= 255; len -= 255) {
+        if (o->p == o->end) return false;
+        *o->p++ = 255;
+    }
+    if (o->p == o->end) return false;
+    *o->p++ = (unsigned char)len;
+    return true;
+}
+
+/* Emit one sequence; match_len 0 is the closing literals-only sequence */
+static bool lz_emit(lz_out_t *o, const unsigned char *lit, size_t lit_len,
+                    size_t offset, size_t match_len) {
+    size_t ml = match_len ? match_len - CODEC_MIN_MATCH : 0;
+    if (o->p == o->end) return false;
+    *o->p++ = (unsigned char)(((lit_len < 15 ? lit_len : 15) << 4) | (ml < 15 ? ml : 15));
+    if (lit_len >= 15 && !put_len_ext(o, lit_len - 15)) return false;
+
+    if ((size_t)(o->end - o->p) < lit_len) return false;
+    memcpy(o->p, lit, lit_len);
+    o->p += lit_len;
+    if (!match_len) return true;
+
+    if (o->end - o->p < 2) return false;
+    o->p[0] = (unsigned char)offset;
+    o->p[1] = (unsigned char)(offset >> 8);
+    o->p += 2;
+    return ml < 15 || put_len_ext(o, ml - 15);
+}
+
+/* Bytes equal at window position src (dictionary, then input) and at in[i] */
+static size_t match_length(const wtree3_codec_t *c, const unsigned char *in, size_t len,
+                           size_t src, size_t i) {
+    size_t n = 0;
+    while (src + n < c->dict_len && i + n < len && c->dict[src + n] == in[i + n]) n++;
+    if (src + n < c->dict_len) return n;
+
+    /* Continues in the input, always behind i */
+    const unsigned char *a = in + (src + n - c->dict_len);
+    const unsigned char *b = in + i + n;
+    const unsigned char *end = in + len;
+    while (b < end && *a == *b) {
+        a++;
+        b++;
+    }
+    return (size_t)(b - (in + i));
+}
+
+/* Compress in[0, len) into out; returns the stream length, 0 if it exceeds cap */
+static size_t lz_compress(const wtree3_codec_t *c, const unsigned char *in, size_t len,
+                          unsigned char *out, size_t cap) {
+    unsigned int bits = CODEC_HASH_BITS_MIN;
+    while (bits < CODEC_HASH_BITS_MAX && ((size_t)1 << bits) < len) bits++;
+    uint32_t table[1 << CODEC_HASH_BITS_MAX];
+    memset(table, 0, sizeof(uint32_t) << bits);
+
+    lz_out_t o = {.p = out, .end = out + cap};
+    size_t anchor = 0, i = 0;
+
+    while (i + CODEC_MIN_MATCH <= len) {
+        uint32_t word = read32(in + i);
+        size_t best_len = 0, best_off = 0;
+
+        /* Earlier in this value */
+        uint32_t h = hash4(in + i, bits);
+        size_t cand = table[h];
+        table[h] = (uint32_t)i + 1;
+        if (cand && i - (cand - 1) <= CODEC_MAX_OFFSET && read32(in + cand - 1) == word) {
+            best_len = match_length(c, in, len, c->dict_len + cand - 1, i);
+            best_off = i - (cand - 1);
+        }
+
+        /* In the dictionary */
+        if (c->dict_table) {
+            size_t d = c->dict_table[hash4(in + i, CODEC_DICT_HASH_BITS)];
+            size_t off = c->dict_len - (d - 1) + i;
+            if (d && off <= CODEC_MAX_OFFSET && read32(c->dict + d - 1) == word) {
+                size_t n = match_length(c, in, len, d - 1, i);
+                if (n > best_len) {
+                    best_len = n;
+                    best_off = off;
+                }
+            }
+        }
+
+        if (best_len < CODEC_MIN_MATCH) {
+            i++;
+            continue;
+        }
+
+        if (!lz_emit(&o, in + anchor, i - anchor, best_off, best_len)) return 0;
+        i = anchor = i + best_len;
+
+        /* Index the end of the match so a following repeat finds it */
+        if (i >= 2 && i - 2 + CODEC_MIN_MATCH <= len) {
+            table[hash4(in + i - 2, bits)] = (uint32_t)(i - 2) + 1;
+        }
+    }
+
+    if (anchor < len && !lz_emit(&o, in + anchor, len - anchor, 0, 0)) return 0;
+    return (size_t)(o.p - out);
+}
+
+/* ============================================================
+ * Decompressor
+ * ============================================================ */
+
+static inline bool read_len_ext(const unsigned char **ip, const unsigned char *iend,
+                                size_t *len) {
+    unsigned int b;
+    do {
+        if (*ip == iend) return false;
+        b = *(*ip)++;
+        *len += b;
+    } while (b == 255);
+    return true;
+}
+
+WTREE_HOT
+static bool lz_decompress(const wtree3_codec_t *c, const unsigned char *ip, size_t in_len,
+                          unsigned char *out, size_t out_len) {
+    const unsigned char *iend = ip + in_len;
+    size_t op = 0;
+
+    while (ip < iend) {
+        unsigned int token = *ip++;
+
+        size_t lit = token >> 4;
+        if (lit == 15 && !read_len_ext(&ip, iend, &lit)) return false;
+        if ((size_t)(iend - ip) < lit || out_len - op < lit) return false;
+        memcpy(out + op, ip, lit);
+        ip += lit;
+        op += lit;
+        if (ip == iend) break;
+
+        if (iend - ip < 2) return false;
+        size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        size_t ml = token & 15;
+        if (ml == 15 && !read_len_ext(&ip, iend, &ml)) return false;
+        ml += CODEC_MIN_MATCH;
+        if (offset == 0 || offset > c->dict_len + op || out_len - op < ml) return false;
+
+        /* Window position of the source: dictionary part first */
+        size_t src = c->dict_len + op - offset;
+        if (src < c->dict_len) {
+            size_t n = c->dict_len - src < ml ? c->dict_len - src : ml;
+            memcpy(out + op, c->dict + src, n);
+            op += n;
+            ml -= n;
+            src += n;
+        }
+
+        /* Output part; overlapping copies repeat the last offset bytes */
+        unsigned char *from = out + (src - c->dict_len);
+        unsigned char *to = out + op;
+        if ((size_t)(to - from) >= ml) {
+            memcpy(to, from, ml);
+        } else {
+            for (size_t k = 0; k < ml; k++) to[k] = from[k];
+        }
+        op += ml;
+    }
+    return op == out_len;
+}
+
+/* ============================================================
+ * Frames
+ * ============================================================ */
+
+/*
+ * Parse a stored frame. Raw frames are unwrapped into *val and *raw_len
+ * is set to SIZE_MAX; compressed ones leave *val alone and report the
+ * original length and header size.
+ */
+static int frame_parse(MDB_val *val, size_t *raw_len, size_t *hdr) {
+    const unsigned char *p = (const unsigned char *)val->mv_data;
+    if (WTREE_UNLIKELY(val->mv_size == 0)) return MDB_CORRUPTED;
+
+    if (WTREE_LIKELY(p[0] == CODEC_TAG_RAW)) {
+        val->mv_data = (void *)(p + 1);
+        val->mv_size--;
+        *raw_len = SIZE_MAX;
+        return 0;
+    }
+
+    size_t used;
+    if (WTREE_UNLIKELY(p[0] != CODEC_TAG_LZ || !varint_get(p + 1, val->mv_size - 1, raw_len, &used))) {
+        return MDB_CORRUPTED;
+    }
+    *hdr = 1 + used;
+
+    /* A sequence expands at most ~255x; anything more is not ours */
+    size_t body = val->mv_size - *hdr;
+    if (WTREE_UNLIKELY(*raw_len == 0 || *raw_len / 256 > body)) return MDB_CORRUPTED;
+    return 0;
+}
+
+static int frame_expand(const wtree3_codec_t *codec, MDB_val *val, size_t hdr,
+                        unsigned char *out, size_t raw_len) {
+    const unsigned char *p = (const unsigned char *)val->mv_data;
+    if (WTREE_UNLIKELY(!lz_decompress(codec, p + hdr, val->mv_size - hdr, out, raw_len))) {
+        return MDB_CORRUPTED;
+    }
+    val->mv_data = out;
+    val->mv_size = raw_len;
+    return 0;
+}
+
+WTREE_HOT WTREE_WARN_UNUSED
+int codec_encode(const wtree3_codec_t *codec, const void *value, size_t value_len,
+                 codec_buf_t *buf, MDB_val *out) {
+    /* A raw frame also bounds the compressed one */
+    if (WTREE_UNLIKELY(!buf_reserve(buf, value_len + 1))) return ENOMEM;
+    unsigned char *p = buf->data;
+
+    if (value_len >= codec->min_size) {
+        size_t hdr = 1 + varint_put(p + 1, value_len);
+        size_t n = hdr < value_len
+                 ? lz_compress(codec, (const unsigned char *)value, value_len, p + hdr, value_len - hdr)
+                 : 0;
+        if (n) {
+            p[0] = CODEC_TAG_LZ;
+            out->mv_data = p;
+            out->mv_size = hdr + n;
+            return 0;
+        }
+    }
+
+    p[0] = CODEC_TAG_RAW;
+    if (value_len) memcpy(p + 1, value, value_len);
+    out->mv_data = p;
+    out->mv_size = value_len + 1;
+    return 0;
+}
+
+WTREE_HOT WTREE_WARN_UNUSED
+int codec_decode(const wtree3_codec_t *codec, MDB_val *val, codec_buf_t *buf) {
+    size_t raw_len, hdr;
+    int rc = frame_parse(val, &raw_len, &hdr);
+    if (rc != 0 || raw_len == SIZE_MAX) return rc;
+
+    if (WTREE_UNLIKELY(!buf_reserve(buf, raw_len))) return ENOMEM;
+    return frame_expand(codec, val, hdr, buf->data, raw_len);
+}
+
+/* ============================================================
+ * Decode Arena
+ * ============================================================ */
+
+static void *arena_alloc(wtree3_txn_t *txn, size_t size) {
+    size_t need = (size + 7) & ~(size_t)7;
+    codec_block_t *head = txn->decoded;
+    if (head && head->cap - head->used >= need) {
+        void *p = head->data + head->used;
+        head->used += need;
+        return p;
+    }
+
+    /* Large values get a block of their own behind the current one */
+    bool own = need > CODEC_ARENA_BLOCK / 4;
+    size_t cap = own ? need : CODEC_ARENA_BLOCK;
+    codec_block_t *b = malloc(sizeof(codec_block_t) + cap);
+    if (WTREE_UNLIKELY(!b)) return NULL;
+    b->cap = cap;
+    b->used = need;
+
+    if (own && head) {
+        b->next = head->next;
+        head->next = b;
+    } else {
+        b->next = head;
+        txn->decoded = b;
+    }
+    return b->data;
+}
+
+WTREE_HOT WTREE_WARN_UNUSED
+int codec_decode_txn(const wtree3_codec_t *codec, wtree3_txn_t *txn, MDB_val *val) {
+    size_t raw_len, hdr;
+    int rc = frame_parse(val, &raw_len, &hdr);
+    if (rc != 0 || raw_len == SIZE_MAX) return rc;
+
+    unsigned char *out = arena_alloc(txn, raw_len);
+    if (WTREE_UNLIKELY(!out)) return ENOMEM;
+    return frame_expand(codec, val, hdr, out, raw_len);
+}
+
+void codec_arena_reset(wtree3_txn_t *txn) {
+    codec_block_t *keep = NULL;
+    codec_block_t *b = txn->decoded;
+    while (b) {
+        codec_block_t *next = b->next;
+        if (!keep && b->cap == CODEC_ARENA_BLOCK) {
+            keep = b;
+        } else {
+            free(b);
+        }
+        b = next;
+    }
+    if (keep) {
+        keep->next = NULL;
+        keep->used = 0;
+    }
+    txn->decoded = keep;
+}
+
+void codec_arena_free(wtree3_txn_t *txn) {
+    codec_block_t *b = txn->decoded;
+    while (b) {
+        codec_block_t *next = b->next;
+        free(b);
+        b = next;
+    }
+    txn->decoded = NULL;
+}
+
+/* ============================================================
+ * Codec State
+ * ============================================================ */
+
+void codec_free(wtree3_codec_t *codec) {
+    if (!codec) return;
+    free(codec->dict);
+    free(codec->dict_table);
+    free(codec);
+}
+
+wtree3_codec_t *codec_create(uint32_t min_size, const void *dict, size_t dict_len) {
+    wtree3_codec_t *c = calloc(1, sizeof(wtree3_codec_t));
+    if (WTREE_UNLIKELY(!c)) return NULL;
+    c->min_size = min_size ? min_size : CODEC_DEFAULT_MIN_SIZE;
+
+    /* Shorter dictionaries could never hold a match */
+    if (dict_len < CODEC_MIN_MATCH) return c;
+
+    c->dict = malloc(dict_len);
+    c->dict_table = calloc((size_t)1 << CODEC_DICT_HASH_BITS, sizeof(uint32_t));
+    if (WTREE_UNLIKELY(!c->dict || !c->dict_table)) {
+        codec_free(c);
+        return NULL;
+    }
+    memcpy(c->dict, dict, dict_len);
+    c->dict_len = dict_len;
+
+    /* Later positions win: they sit closer to the data */
+    for (size_t i = 0; i + CODEC_MIN_MATCH <= dict_len; i++) {
+        c->dict_table[hash4(c->dict + i, CODEC_DICT_HASH_BITS)] = (uint32_t)i + 1;
+    }
+    return c;
+}
+
+/* Metadata "tree name" owning a tree's codec record */
+static char *codec_owner(const char *tree_name) {
+    size_t len = strlen(WTREE3_CODEC_PREFIX) + strlen(tree_name) + 1;
+    char *owner = malloc(len);
+    if (WTREE_LIKELY(owner)) snprintf(owner, len, "%s%s", WTREE3_CODEC_PREFIX, tree_name);
+    return owner;
+}
+
+WTREE_COLD WTREE_WARN_UNUSED
+int codec_auto_load(wtree3_tree_t *tree, gerror_t *error) {
+    char *owner = codec_owner(tree->name);
+    char *meta_key = owner ? build_metadata_key(owner, "") : NULL;
+    free(owner);
+    if (WTREE_UNLIKELY(!meta_key)) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to build codec key");
+        return WTREE3_ENOMEM;
+    }
+
+    wtree3_txn_t *txn = read_pool_acquire(tree->db, error);
+    if (WTREE_UNLIKELY(!txn)) {
+        free(meta_key);
+        return WTREE3_ERROR;
+    }
+
+    /* No metadata DB or no record: values are stored as given */
+    MDB_dbi meta_dbi;
+    MDB_val key = {.mv_size = strlen(meta_key), .mv_data = meta_key}, val;
+    int rc = mdb_dbi_open(txn->txn, WTREE3_META_DB, 0, &meta_dbi);
+    if (rc == 0) rc = mdb_get(txn->txn, meta_dbi, &key, &val);
+    free(meta_key);
+    if (rc == MDB_NOTFOUND) {
+        read_pool_release(txn);
+        return WTREE3_OK;
+    }
+    if (WTREE_UNLIKELY(rc != 0)) {
+        read_pool_release(txn);
+        return translate_mdb_error(rc, error);
+    }
+
+    /* A codec that can't be loaded would hand out framed bytes: fail the open */
+    uint32_t format = 0, min_size = 0, dict_len = 0;
+    if (val.mv_size >= CODEC_RECORD_HDR) {
+        memcpy(&format, val.mv_data, 4);
+        memcpy(&min_size, (uint8_t *)val.mv_data + 4, 4);
+        memcpy(&dict_len, (uint8_t *)val.mv_data + 8, 4);
+    }
+    if (WTREE_UNLIKELY(format != CODEC_FORMAT || val.mv_size != CODEC_RECORD_HDR + (size_t)dict_len)) {
+        read_pool_release(txn);
+        set_error(error, WTREE3_LIB, WTREE3_ERROR,
+                 "Malformed codec record for tree '%s'", tree->name);
+        return WTREE3_ERROR;
+    }
+
+    tree->codec = codec_create(min_size, (uint8_t *)val.mv_data + CODEC_RECORD_HDR, dict_len);
+    read_pool_release(txn);
+    if (WTREE_UNLIKELY(!tree->codec)) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate codec");
+        return WTREE3_ENOMEM;
+    }
+    return WTREE3_OK;
+}
+
+/* ============================================================
+ * Dictionary Training
+ * ============================================================ */
+
+typedef struct {
+    size_t sample;
+    size_t offset;
+    size_t len;
+    uint64_t score;
+} train_seg_t;
+
+static inline uint32_t ngram_hash(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return (uint32_t)((v * 0x9e3779b97f4a7c15ULL) >> (64 - TRAIN_TABLE_BITS));
+}
+
+/* Shared n-grams in a segment: each counts once per other sample holding it */
+static uint64_t segment_score(const uint32_t *counts, const unsigned char *p, size_t len) {
+    uint64_t score = 0;
+    for (size_t i = 0; i + TRAIN_NGRAM <= len; i++) {
+        uint32_t n = counts[ngram_hash(p + i)];
+        if (n > 1) score += n - 1;
+    }
+    return score;
+}
+
+static int train_seg_cmp(const void *a, const void *b, void *ctx) {
+    (void)ctx;
+    const train_seg_t *x = (const train_seg_t *)a;
+    const train_seg_t *y = (const train_seg_t *)b;
+    if (x->score != y->score) return x->score > y->score ? -1 : 1;
+    if (x->sample != y->sample) return x->sample < y->sample ? -1 : 1;
+    return x->offset < y->offset ? -1 : (x->offset > y->offset);
+}
+
+WTREE_COLD WTREE_WARN_UNUSED
+int wtree3_codec_train(const void *const *samples, const size_t *sample_lens, size_t count,
+                       void *dict, size_t dict_cap, size_t *dict_len,
+                       gerror_t *error) {
+    if (WTREE_UNLIKELY(!samples || !sample_lens || count == 0 || !dict || !dict_len)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+    if (dict_cap > WTREE3_CODEC_DICT_MAX) dict_cap = WTREE3_CODEC_DICT_MAX;
+    *dict_len = 0;
+
+    size_t seg_count = 0;
+    for (size_t s = 0; s < count; s++) {
+        if (sample_lens[s] >= TRAIN_NGRAM) seg_count += (sample_lens[s] - TRAIN_NGRAM) / TRAIN_STEP + 1;
+    }
+    if (seg_count == 0 || dict_cap == 0) return WTREE3_OK;
+
+    uint32_t *counts = calloc((size_t)1 << TRAIN_TABLE_BITS, sizeof(uint32_t));
+    uint32_t *seen = calloc((size_t)1 << TRAIN_TABLE_BITS, sizeof(uint32_t));
+    train_seg_t *segs = malloc(seg_count * sizeof(train_seg_t));
+    if (WTREE_UNLIKELY(!counts || !seen || !segs)) {
+        free(counts);
+        free(seen);
+        free(segs);
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate training state");
+        return WTREE3_ENOMEM;
+    }
+
+    /* Document frequency of every n-gram (seen holds the last sample + 1) */
+    for (size_t s = 0; s < count; s++) {
+        const unsigned char *p = (const unsigned char *)samples[s];
+        for (size_t i = 0; i + TRAIN_NGRAM <= sample_lens[s]; i++) {
+            uint32_t h = ngram_hash(p + i);
+            if (seen[h] != (uint32_t)(s + 1)) {
+                seen[h] = (uint32_t)(s + 1);
+                counts[h]++;
+            }
+        }
+    }
+    free(seen);
+
+    size_t n = 0;
+    for (size_t s = 0; s < count; s++) {
+        const unsigned char *p = (const unsigned char *)samples[s];
+        for (size_t off = 0; off + TRAIN_NGRAM <= sample_lens[s]; off += TRAIN_STEP) {
+            size_t len = sample_lens[s] - off < TRAIN_SEGMENT ? sample_lens[s] - off : TRAIN_SEGMENT;
+            uint64_t score = segment_score(counts, p + off, len);
+            if (score == 0) continue;
+            segs[n++] = (train_seg_t){.sample = s, .offset = off, .len = len, .score = score};
+        }
+    }
+
+    if (WTREE_UNLIKELY(!wsort(segs, n, sizeof(train_seg_t), train_seg_cmp, NULL))) {
+        free(counts);
+        free(segs);
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to sort training segments");
+        return WTREE3_ENOMEM;
+    }
+
+    /* Best segments go last; n-grams taken stop counting for the rest */
+    unsigned char *out = (unsigned char *)dict;
+    size_t pos = dict_cap;
+    for (size_t i = 0; i < n && pos > 0; i++) {
+        const unsigned char *p = (const unsigned char *)samples[segs[i].sample] + segs[i].offset;
+        uint64_t score = segment_score(counts, p, segs[i].len);
+        if (score == 0 || score * 2 < segs[i].score) continue;  /* Mostly covered already */
+
+        size_t take = segs[i].len < pos ? segs[i].len : pos;
+        memcpy(out + pos - take, p, take);
+        pos -= take;
+        for (size_t k = 0; k + TRAIN_NGRAM <= segs[i].len; k++) counts[ngram_hash(p + k)] = 0;
+    }
+
+    free(counts);
+    free(segs);
+
+    *dict_len = dict_cap - pos;
+    memmove(out, out + pos, *dict_len);
+    return WTREE3_OK;
+}
+
+/* ============================================================
+ * Public API
+ * ============================================================ */
+
+typedef struct {
+    wtree3_tree_t *tree;
+    const void *record;             /* NULL = remove the codec */
+    size_t record_len;
+    gerror_t *error;
+} set_codec_ctx_t;
+
+static int set_codec_txn(MDB_txn *txn, void *user_data) {
+    set_codec_ctx_t *ctx = (set_codec_ctx_t *)user_data;
+    wtree3_tree_t *tree = ctx->tree;
+
+    /* Stored values would not carry frames */
+    MDB_stat st;
+    int rc = mdb_stat(txn, tree->dbi, &st);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, ctx->error);
+    if (st.ms_entries != 0) {
+        set_error(ctx->error, WTREE3_LIB, WTREE3_EINVAL,
+                 "Codec of tree '%s' can only change while it is empty", tree->name);
+        return WTREE3_EINVAL;
+    }
+
+    char *owner = codec_owner(tree->name);
+    if (WTREE_UNLIKELY(!owner)) {
+        set_error(ctx->error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to build codec key");
+        return WTREE3_ENOMEM;
+    }
+    rc = ctx->record
+       ? metadata_put_txn(txn, tree->db, owner, "", ctx->record, ctx->record_len, ctx->error)
+       : metadata_delete_txn(txn, tree->db, owner, "", ctx->error);
+    free(owner);
+    return rc;
+}
+
+WTREE_COLD WTREE_WARN_UNUSED
+int wtree3_tree_set_codec(wtree3_tree_t *tree, const wtree3_codec_config_t *config,
+                          gerror_t *error) {
+    if (WTREE_UNLIKELY(!tree)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Tree cannot be NULL");
+        return WTREE3_EINVAL;
+    }
+    if (config && WTREE_UNLIKELY((config->dict_len && !config->dict) ||
+                                 config->dict_len > WTREE3_CODEC_DICT_MAX)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                 "Codec dictionary must be set and at most %d bytes", WTREE3_CODEC_DICT_MAX);
+        return WTREE3_EINVAL;
+    }
+    if (WTREE_UNLIKELY(tree->flags & MDB_DUPSORT)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                 "Codecs are not supported on DUPSORT trees");
+        return WTREE3_EINVAL;
+    }
+
+    wtree3_codec_t *codec = NULL;
+    uint8_t *record = NULL;
+    size_t record_len = 0;
+    if (config) {
+        uint32_t format = CODEC_FORMAT;
+        uint32_t min_size = config->min_size ? config->min_size : CODEC_DEFAULT_MIN_SIZE;
+        uint32_t dict_len = (uint32_t)config->dict_len;
+
+        record_len = CODEC_RECORD_HDR + dict_len;
+        record = malloc(record_len);
+        codec = codec_create(min_size, config->dict, dict_len);
+        if (WTREE_UNLIKELY(!record || !codec)) {
+            free(record);
+            codec_free(codec);
+            set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate codec");
+            return WTREE3_ENOMEM;
+        }
+        memcpy(record, &format, 4);
+        memcpy(record + 4, &min_size, 4);
+        memcpy(record + 8, &dict_len, 4);
+        if (dict_len) memcpy(record + CODEC_RECORD_HDR, config->dict, dict_len);
+    }
+
+    set_codec_ctx_t ctx = {.tree = tree, .record = record, .record_len = record_len, .error = error};
+    int rc = with_write_txn(tree->db, set_codec_txn, &ctx, error);
+    free(record);
+    if (WTREE_UNLIKELY(rc != 0)) {
+        codec_free(codec);
+        return rc;
+    }
+
+    codec_free(tree->codec);
+    tree->codec = codec;
+    return WTREE3_OK;
+}
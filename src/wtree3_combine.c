@@ -0,0 +1,377 @@
+/*
+ * wtree3_combine.c - Write Combining for Merge Upserts
+ *
+ * With combining enabled on a tree, wtree3_upsert() does not write: it
+ * folds the operand into an in-memory buffer keyed by main key, using the
+ * tree's combine callback (older operand, newer operand -> one operand).
+ * N upserts of a hot key between two flushes become one upsert of the
+ * combined operand, which the tree's merge callback then applies to the
+ * stored value with the usual index maintenance.
+ *
+ * A flush detaches the whole buffer under the lock, so new operands keep
+ * landing in a fresh one, sorts the keys with the tree's comparator and
+ * applies them in a single write transaction. If that fails, the detached
+ * operands are folded back in front of anything buffered meanwhile.
+ *
+ * Flushes run on the thread whose upsert crosses a threshold (keys, bytes
+ * or age of the oldest operand), on wtree3_tree_flush_combined(), when
+ * combining is disabled and when the tree is closed. There is no timer:
+ * the age threshold is checked on the next buffered upsert.
+ *
+ * This module provides:
+ * - Configuration: tree_enable_combining, tree_disable_combining
+ * - Flushing: tree_flush_combined
+ * - Internal hooks: combine_add, combine_destroy
+ */
+
+#include "wtree3_internal.h"
+#include "wsort.h"
+#include "macros.h"
+
+/* ============================================================
+ * Constants
+ * ============================================================ */
+
+#define COMBINE_DEFAULT_MAX_KEYS    1024
+#define COMBINE_DEFAULT_MAX_BYTES   (1024 * 1024)
+#define COMBINE_DEFAULT_MAX_AGE_US  100000     /* 100 ms */
+
+/* ============================================================
+ * Internal Structures
+ * ============================================================ */
+
+/* One buffered key: its combined operand so far */
+typedef struct combine_entry {
+    struct combine_entry *next;     /* Buffer order (newest first) */
+    void *operand;
+    size_t operand_len;
+    size_t key_len;
+    unsigned char key[];
+} combine_entry_t;
+
+/* Lookup key for the map */
+typedef struct {
+    const void *key;
+    size_t key_len;
+} combine_probe_t;
+
+/* Buffered operands (detached as a whole by a flush) */
+typedef struct {
+    whash_t *map;
+    combine_entry_t *head;
+    size_t keys;
+    size_t bytes;
+    uint64_t oldest_us;             /* When the first operand arrived */
+} combine_buffer_t;
+
+struct wtree3_combine {
+    wmutex_t lock;
+    wtree3_merge_fn combine_fn;
+    void *user_data;
+    size_t max_keys;
+    size_t max_bytes;
+    uint64_t max_age_us;
+    combine_buffer_t buf;
+};
+
+/* ============================================================
+ * Buffer
+ * ============================================================ */
+
+static bool entry_has_key(const void *entry_ptr, const void *probe_ptr) {
+    const combine_entry_t *e = (const combine_entry_t *)entry_ptr;
+    const combine_probe_t *p = (const combine_probe_t *)probe_ptr;
+    return e->key_len == p->key_len && memcmp(e->key, p->key, p->key_len) == 0;
+}
+
+static void entry_free(combine_entry_t *e) {
+    free(e->operand);
+    free(e);
+}
+
+static void buffer_free(combine_buffer_t *buf) {
+    whash_destroy(buf->map);
+    while (buf->head) {
+        combine_entry_t *next = buf->head->next;
+        entry_free(buf->head);
+        buf->head = next;
+    }
+    memset(buf, 0, sizeof(*buf));
+}
+
+/* Take the buffer out of c, leaving an empty one (lock held) */
+static void buffer_detach(wtree3_combine_t *c, combine_buffer_t *out) {
+    *out = c->buf;
+    memset(&c->buf, 0, sizeof(c->buf));
+}
+
+/*
+ * Fold an operand for key into the buffer (lock held). newer says which
+ * side the incoming operand is on: true for upserts, false when a failed
+ * flush puts back operands older than what was buffered since.
+ */
+static int buffer_fold(wtree3_combine_t *c, const void *key, size_t key_len,
+                       const void *operand, size_t operand_len, bool newer,
+                       gerror_t *error) {
+    combine_buffer_t *buf = &c->buf;
+    if (WTREE_UNLIKELY(!buf->map)) {
+        buf->map = whash_create(0, NULL);
+        if (WTREE_UNLIKELY(!buf->map)) {
+            set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate combine buffer");
+            return WTREE3_ENOMEM;
+        }
+    }
+
+    uint64_t hash = whash_bytes(key, key_len);
+    combine_probe_t probe = {.key = key, .key_len = key_len};
+    combine_entry_t *e = (combine_entry_t *)whash_get(buf->map, hash, &probe, entry_has_key);
+
+    if (e) {
+        size_t out_len = 0;
+        void *out = newer
+            ? c->combine_fn(e->operand, e->operand_len, operand, operand_len, c->user_data, &out_len)
+            : c->combine_fn(operand, operand_len, e->operand, e->operand_len, c->user_data, &out_len);
+        if (WTREE_UNLIKELY(!out)) {
+            set_error(error, WTREE3_LIB, WTREE3_ERROR, "Combine callback returned NULL");
+            return WTREE3_ERROR;
+        }
+        buf->bytes = buf->bytes - e->operand_len + out_len;
+        free(e->operand);
+        e->operand = out;
+        e->operand_len = out_len;
+        return WTREE3_OK;
+    }
+
+    e = malloc(sizeof(combine_entry_t) + key_len);
+    void *copy = malloc(operand_len ? operand_len : 1);
+    if (WTREE_UNLIKELY(!e || !copy)) {
+        free(e);
+        free(copy);
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate combine entry");
+        return WTREE3_ENOMEM;
+    }
+    memcpy(e->key, key, key_len);
+    e->key_len = key_len;
+    if (operand_len > 0) memcpy(copy, operand, operand_len);
+    e->operand = copy;
+    e->operand_len = operand_len;
+
+    if (WTREE_UNLIKELY(!whash_put(buf->map, hash, e))) {
+        entry_free(e);
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate combine buffer");
+        return WTREE3_ENOMEM;
+    }
+    if (buf->keys == 0) buf->oldest_us = wtime_now_us();
+    e->next = buf->head;
+    buf->head = e;
+    buf->keys++;
+    buf->bytes += key_len + operand_len;
+    return WTREE3_OK;
+}
+
+static bool buffer_full(const wtree3_combine_t *c) {
+    const combine_buffer_t *buf = &c->buf;
+    if (buf->keys == 0) return false;
+    return buf->keys >= c->max_keys || buf->bytes >= c->max_bytes ||
+           wtime_now_us() - buf->oldest_us >= c->max_age_us;
+}
+
+/* ============================================================
+ * Flush
+ * ============================================================ */
+
+typedef struct {
+    MDB_txn *txn;
+    MDB_dbi dbi;
+} combine_sort_ctx_t;
+
+static int entry_cmp(const void *a, const void *b, void *ctx) {
+    const combine_entry_t *ea = *(combine_entry_t *const *)a;
+    const combine_entry_t *eb = *(combine_entry_t *const *)b;
+    combine_sort_ctx_t *sc = (combine_sort_ctx_t *)ctx;
+    MDB_val ka = {.mv_size = ea->key_len, .mv_data = (void *)ea->key};
+    MDB_val kb = {.mv_size = eb->key_len, .mv_data = (void *)eb->key};
+    return mdb_cmp(sc->txn, sc->dbi, &ka, &kb);
+}
+
+/* Upsert every detached operand in one write txn, in key order */
+static int buffer_apply(wtree3_tree_t *tree, const combine_buffer_t *buf, gerror_t *error) {
+    combine_entry_t **order = malloc(buf->keys * sizeof(combine_entry_t *));
+    if (WTREE_UNLIKELY(!order)) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate combine flush");
+        return WTREE3_ENOMEM;
+    }
+    size_t n = 0;
+    for (combine_entry_t *e = buf->head; e; e = e->next) order[n++] = e;
+
+    wtree3_txn_t *txn = wtree3_txn_begin(tree->db, true, error);
+    if (WTREE_UNLIKELY(!txn)) {
+        free(order);
+        return WTREE3_ERROR;
+    }
+
+    /* Sorted puts walk the leaves left to right; unsorted is only slower */
+    combine_sort_ctx_t ctx = {.txn = txn->txn, .dbi = tree->dbi};
+    (void)wsort(order, n, sizeof(combine_entry_t *), entry_cmp, &ctx);
+
+    int rc = WTREE3_OK;
+    for (size_t i = 0; i < n && rc == WTREE3_OK; i++) {
+        rc = wtree3_upsert_txn(txn, tree, order[i]->key, order[i]->key_len,
+                               order[i]->operand, order[i]->operand_len, error);
+    }
+    free(order);
+
+    if (rc == WTREE3_OK) return wtree3_txn_commit(txn, error);
+    wtree3_txn_abort(txn);
+    return rc;
+}
+
+/* Apply a detached buffer; on failure fold it back into c */
+static int buffer_flush(wtree3_tree_t *tree, wtree3_combine_t *c, combine_buffer_t *buf,
+                        gerror_t *error) {
+    if (buf->keys == 0) {
+        buffer_free(buf);
+        return WTREE3_OK;
+    }
+
+    int rc = buffer_apply(tree, buf, error);
+    if (WTREE_UNLIKELY(rc != WTREE3_OK)) {
+        wmutex_lock(&c->lock);
+        for (combine_entry_t *e = buf->head; e; e = e->next) {
+            /* Best effort: the flush error is the one reported */
+            (void)buffer_fold(c, e->key, e->key_len, e->operand, e->operand_len, false, NULL);
+        }
+        wmutex_unlock(&c->lock);
+    }
+    buffer_free(buf);
+    return rc;
+}
+
+/* ============================================================
+ * Internal Hooks
+ * ============================================================ */
+
+WTREE_HOT WTREE_WARN_UNUSED
+int combine_add(wtree3_tree_t *tree, const void *key, size_t key_len,
+                const void *operand, size_t operand_len, gerror_t *error) {
+    if (WTREE_UNLIKELY(!key || !operand)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+
+    wtree3_combine_t *c = tree->combine;
+    combine_buffer_t full = {0};
+
+    wmutex_lock(&c->lock);
+    int rc = buffer_fold(c, key, key_len, operand, operand_len, true, error);
+    if (rc == WTREE3_OK && buffer_full(c)) buffer_detach(c, &full);
+    wmutex_unlock(&c->lock);
+
+    if (rc != WTREE3_OK || full.keys == 0) return rc;
+    return buffer_flush(tree, c, &full, error);
+}
+
+WTREE_COLD
+void combine_destroy(wtree3_tree_t *tree) {
+    wtree3_combine_t *c = tree->combine;
+    if (!c) return;
+
+    /* Nobody else may be using the handle: no lock needed */
+    combine_buffer_t buf;
+    buffer_detach(c, &buf);
+    if (buf.keys > 0) (void)buffer_apply(tree, &buf, NULL);
+    buffer_free(&buf);
+
+    tree->combine = NULL;
+    wmutex_destroy(&c->lock);
+    free(c);
+}
+
+/* ============================================================
+ * Configuration
+ * ============================================================ */
+
+WTREE_COLD WTREE_WARN_UNUSED
+int wtree3_tree_enable_combining(wtree3_tree_t *tree, const wtree3_combine_config_t *config,
+                                 gerror_t *error) {
+    if (WTREE_UNLIKELY(!tree || !config || !config->combine_fn)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Tree and combine callback are required");
+        return WTREE3_EINVAL;
+    }
+
+    wtree3_combine_t *c = tree->combine;
+    if (!c) {
+        c = calloc(1, sizeof(wtree3_combine_t));
+        if (WTREE_UNLIKELY(!c)) {
+            set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate combine state");
+            return WTREE3_ENOMEM;
+        }
+        if (WTREE_UNLIKELY(wmutex_init(&c->lock) != 0)) {
+            free(c);
+            set_error(error, WTREE3_LIB, WTREE3_ERROR, "Failed to initialize combine lock");
+            return WTREE3_ERROR;
+        }
+    }
+
+    /* Reconfiguring: operands folded so far keep the old callback's meaning */
+    if (tree->combine) {
+        int rc = wtree3_tree_flush_combined(tree, NULL, error);
+        if (rc != WTREE3_OK) return rc;
+    }
+
+    c->combine_fn = config->combine_fn;
+    c->user_data = config->user_data;
+    c->max_keys = config->max_keys ? config->max_keys : COMBINE_DEFAULT_MAX_KEYS;
+    c->max_bytes = config->max_bytes ? config->max_bytes : COMBINE_DEFAULT_MAX_BYTES;
+    c->max_age_us = config->max_age_us ? config->max_age_us : COMBINE_DEFAULT_MAX_AGE_US;
+    tree->combine = c;
+    return WTREE3_OK;
+}
+
+WTREE_COLD WTREE_WARN_UNUSED
+int wtree3_tree_disable_combining(wtree3_tree_t *tree, gerror_t *error) {
+    if (WTREE_UNLIKELY(!tree)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Tree cannot be NULL");
+        return WTREE3_EINVAL;
+    }
+    if (!tree->combine) return WTREE3_OK;
+
+    int rc = wtree3_tree_flush_combined(tree, NULL, error);
+    if (rc != WTREE3_OK) return rc;
+    combine_destroy(tree);
+    return WTREE3_OK;
+}
+
+/* ============================================================
+ * Flushing
+ * ============================================================ */
+
+WTREE_WARN_UNUSED
+int wtree3_tree_flush_combined(wtree3_tree_t *tree, size_t *flushed_out, gerror_t *error) {
+    if (flushed_out) *flushed_out = 0;
+    if (WTREE_UNLIKELY(!tree)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Tree cannot be NULL");
+        return WTREE3_EINVAL;
+    }
+
+    wtree3_combine_t *c = tree->combine;
+    if (!c) return WTREE3_OK;
+
+    combine_buffer_t buf;
+    wmutex_lock(&c->lock);
+    buffer_detach(c, &buf);
+    wmutex_unlock(&c->lock);
+
+    size_t keys = buf.keys;
+    int rc = buffer_flush(tree, c, &buf, error);
+    if (rc == WTREE3_OK && flushed_out) *flushed_out = keys;
+    return rc;
+}
+
+size_t wtree3_tree_combining_pending(wtree3_tree_t *tree) {
+    if (!tree || !tree->combine) return 0;
+    wmutex_lock(&tree->combine->lock);
+    size_t keys = tree->combine->buf.keys;
+    wmutex_unlock(&tree->combine->lock);
+    return keys;
+}
@@ -4,6 +4,7 @@
  * This module provides the foundation layer for wtree3:
  * - Database lifecycle (open, close, sync, resize, stats)
  * - Transaction management (begin, commit, abort, reset, renew)
+ *   (auto-transaction reads recycle txns through wtree3_read_pool.c)
  * - Error translation from LMDB to wtree3 error codes
  * - Utility functions (strerror, error_recoverable)
  */
@@ -18,27 +19,42 @@
 
 WTREE_COLD
 int translate_mdb_error(int mdb_rc, gerror_t *error) {
+    int code;
     switch (mdb_rc) {
         case 0:
             return WTREE3_OK;
         case MDB_MAP_FULL:
             set_error(error, WTREE3_LIB, WTREE3_MAP_FULL,
                      "Database map is full, resize needed");
-            return WTREE3_MAP_FULL;
+            code = WTREE3_MAP_FULL;
+            break;
         case MDB_TXN_FULL:
             set_error(error, WTREE3_LIB, WTREE3_TXN_FULL,
                      "Transaction has too many dirty pages");
-            return WTREE3_TXN_FULL;
+            code = WTREE3_TXN_FULL;
+            break;
         case MDB_NOTFOUND:
             set_error(error, WTREE3_LIB, WTREE3_NOT_FOUND, "Key not found");
-            return WTREE3_NOT_FOUND;
+            code = WTREE3_NOT_FOUND;
+            break;
         case MDB_KEYEXIST:
             set_error(error, WTREE3_LIB, WTREE3_KEY_EXISTS, "Key already exists");
-            return WTREE3_KEY_EXISTS;
+            code = WTREE3_KEY_EXISTS;
+            break;
+        case ENOMEM:
+            set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Out of memory");
+            code = WTREE3_ENOMEM;
+            break;
         default:
             set_error(error, WTREE3_LIB, WTREE3_ERROR, "%s", mdb_strerror(mdb_rc));
-            return WTREE3_ERROR;
+            code = WTREE3_ERROR;
+            break;
     }
+
+#ifndef WTREE3_NO_METRICS
+    if (WTREE_UNLIKELY(watomic_load_u32(&metrics_error_watchers) != 0)) metrics_note_error(code);
+#endif
+    return code;
 }
 
 /* ============================================================
@@ -85,10 +101,21 @@ wtree3_db_t* wtree3_db_open(const char *path, size_t mapsize,
         return NULL;
     }
 
+    /* Initialize read transaction pool */
+    db->read_pool = read_pool_create(READ_POOL_DEFAULT_SIZE);
+    if (WTREE_UNLIKELY(!db->read_pool)) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to create read transaction pool");
+        wtree3_extractor_registry_destroy(db->extractor_registry);
+        free(db);
+        return NULL;
+    }
+
     int rc = mdb_env_create(&db->env);
     if (WTREE_UNLIKELY(rc != 0)) {
         set_error(error, WTREE3_LIB, WTREE3_ERROR,
                  "Failed to create environment: %s", mdb_strerror(rc));
+        read_pool_destroy(db->read_pool);
+        wtree3_extractor_registry_destroy(db->extractor_registry);
         free(db);
         return NULL;
     }
@@ -102,6 +129,8 @@ wtree3_db_t* wtree3_db_open(const char *path, size_t mapsize,
         set_error(error, WTREE3_LIB, WTREE3_ERROR,
                  "Failed to set mapsize: %s", mdb_strerror(rc));
         mdb_env_close(db->env);
+        read_pool_destroy(db->read_pool);
+        wtree3_extractor_registry_destroy(db->extractor_registry);
         free(db);
         return NULL;
     }
@@ -111,6 +140,8 @@ wtree3_db_t* wtree3_db_open(const char *path, size_t mapsize,
         set_error(error, WTREE3_LIB, WTREE3_ERROR,
                  "Failed to set max databases: %s", mdb_strerror(rc));
         mdb_env_close(db->env);
+        read_pool_destroy(db->read_pool);
+        wtree3_extractor_registry_destroy(db->extractor_registry);
         free(db);
         return NULL;
     }
@@ -120,6 +151,8 @@ wtree3_db_t* wtree3_db_open(const char *path, size_t mapsize,
         set_error(error, WTREE3_LIB, WTREE3_ERROR,
                  "Failed to open environment: %s", mdb_strerror(rc));
         mdb_env_close(db->env);
+        read_pool_destroy(db->read_pool);
+        wtree3_extractor_registry_destroy(db->extractor_registry);
         free(db);
         return NULL;
     }
@@ -134,6 +167,10 @@ wtree3_db_t* wtree3_db_open(const char *path, size_t mapsize,
 
 void wtree3_db_close(wtree3_db_t *db) {
     if (!db) return;
+    group_commit_destroy(db->group_commit);
+    durability_destroy(db->durability);  /* Final sync before the env closes */
+    read_pool_destroy(db->read_pool);  /* Pooled txns must end before the env */
+    metrics_destroy(db);
     if (db->env) mdb_env_close(db->env);
     free(db->path);
 
@@ -149,7 +186,9 @@ int wtree3_db_sync(wtree3_db_t *db, bool force, gerror_t *error) {
         set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Database cannot be NULL");
         return WTREE3_EINVAL;
     }
+    uint64_t t0 = metrics_begin(db);
     int rc = mdb_env_sync(db->env, force ? 1 : 0);
+    metrics_end(db, NULL, WTREE3_METRIC_SYNC, t0, 0);
     if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
     return WTREE3_OK;
 }
@@ -160,12 +199,24 @@ int wtree3_db_resize(wtree3_db_t *db, size_t new_mapsize, gerror_t *error) {
         set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Database cannot be NULL");
         return WTREE3_EINVAL;
     }
+    read_pool_drain(db->read_pool);
     int rc = mdb_env_set_mapsize(db->env, new_mapsize);
     if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
     db->mapsize = new_mapsize;
     return WTREE3_OK;
 }
 
+WTREE_COLD WTREE_WARN_UNUSED
+int wtree3_db_copy(wtree3_db_t *db, const char *path, bool compact, gerror_t *error) {
+    if (WTREE_UNLIKELY(!db || !path)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+    int rc = mdb_env_copy2(db->env, path, compact ? MDB_CP_COMPACT : 0);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+    return WTREE3_OK;
+}
+
 WTREE_PURE
 size_t wtree3_db_get_mapsize(wtree3_db_t *db) {
     return db ? db->mapsize : 0;
@@ -224,21 +275,38 @@ int wtree3_txn_commit(wtree3_txn_t *txn, gerror_t *error) {
         return WTREE3_EINVAL;
     }
 
+    if (WTREE_UNLIKELY(txn->reserved.cursor != NULL)) {
+        /* Its indexes were never written; don't publish the row without them */
+        wtree3_txn_abort(txn);
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                 "Transaction aborted: reservation was never committed");
+        return WTREE3_EINVAL;
+    }
+
+    wtree3_db_t *db = txn->db;
+    bool is_write = txn->is_write;
+    uint64_t t0 = is_write ? metrics_begin(db) : 0;
     int rc = mdb_txn_commit(txn->txn);
+    txn_decoded_free(txn);
     free(txn);
+    if (WTREE_UNLIKELY(t0 != 0)) metrics_txn_end(db, t0, rc == 0);
     if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+    if (is_write) durability_commit(db);
     return WTREE3_OK;
 }
 
 void wtree3_txn_abort(wtree3_txn_t *txn) {
     if (!txn) return;
+    if (txn->is_write && METRICS_ON(txn->db)) metrics_txn_end(txn->db, 0, false);
     mdb_txn_abort(txn->txn);
+    txn_decoded_free(txn);
     free(txn);
 }
 
 void wtree3_txn_reset(wtree3_txn_t *txn) {
     if (!txn || txn->is_write) return;
     mdb_txn_reset(txn->txn);
+    txn_decoded_free(txn);
 }
 
 WTREE_WARN_UNUSED
@@ -330,14 +398,18 @@ int with_write_txn(wtree3_db_t *db,
 
     rc = fn(txn, user_data);
     if (WTREE_UNLIKELY(rc != 0)) {
+        if (METRICS_ON(db)) metrics_txn_end(db, 0, false);
         mdb_txn_abort(txn);
         return rc;  /* Error already set by fn */
     }
 
+    uint64_t t0 = metrics_begin(db);
     rc = mdb_txn_commit(txn);
+    if (WTREE_UNLIKELY(t0 != 0)) metrics_txn_end(db, t0, rc == 0);
     if (WTREE_UNLIKELY(rc != 0)) {
         return translate_mdb_error(rc, error);
     }
+    durability_commit(db);
 
     return WTREE3_OK;
 }
@@ -352,14 +424,11 @@ int with_read_txn(wtree3_db_t *db,
         return WTREE3_EINVAL;
     }
 
-    MDB_txn *txn;
-    int rc = mdb_txn_begin(db->env, NULL, MDB_RDONLY, &txn);
-    if (WTREE_UNLIKELY(rc != 0)) {
-        return translate_mdb_error(rc, error);
-    }
+    wtree3_txn_t *txn = read_pool_acquire(db, error);
+    if (WTREE_UNLIKELY(!txn)) return WTREE3_ERROR;
 
-    rc = fn(txn, user_data);
-    mdb_txn_abort(txn);  /* Always abort read-only txn */
+    int rc = fn(txn->txn, user_data);
+    read_pool_release(txn);  /* Read-only: reset and recycle */
 
     return rc;  /* fn's return code (error already set if needed) */
 }
@@ -390,9 +459,57 @@ int wtree3_db_register_key_extractor(wtree3_db_t *db, uint32_t version,
     return WTREE3_OK;
 }
 
+WTREE_WARN_UNUSED
+int wtree3_db_register_key_extractor_into(wtree3_db_t *db, uint32_t version,
+                                            uint32_t flags, wtree3_index_key_into_fn key_fn,
+                                            gerror_t *error) {
+    if (WTREE_UNLIKELY(!db || !key_fn)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+
+    uint64_t extractor_id = build_extractor_id(version, flags);
+
+    if (WTREE_UNLIKELY(!wtree3_extractor_registry_set_into(db->extractor_registry, extractor_id, key_fn))) {
+        set_error(error, WTREE3_LIB, WTREE3_ERROR,
+                 "Failed to register extractor (version=%u, flags=0x%02x)", version, flags);
+        return WTREE3_ERROR;
+    }
+
+    return WTREE3_OK;
+}
+
+WTREE_WARN_UNUSED
+int wtree3_db_register_projection(wtree3_db_t *db, uint32_t version,
+                                  uint32_t flags, wtree3_index_key_fn project_fn,
+                                  gerror_t *error) {
+    if (WTREE_UNLIKELY(!db || !project_fn || (flags & INDEX_PROJECTION_ID_FLAG))) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+
+    /* Projections live in the extractor registry under their own ID space */
+    uint64_t projection_id = build_projection_id(version, flags);
+
+    if (WTREE_UNLIKELY(!wtree3_extractor_registry_set(db->extractor_registry, projection_id, project_fn))) {
+        set_error(error, WTREE3_LIB, WTREE3_ERROR,
+                 "Failed to register projection (version=%u, flags=0x%02x)", version, flags);
+        return WTREE3_ERROR;
+    }
+
+    return WTREE3_OK;
+}
+
 WTREE_PURE
 wtree3_index_key_fn find_extractor(wtree3_db_t *db, uint64_t extractor_id) {
     if (!db) return NULL;
 
     return wtree3_extractor_registry_get(db->extractor_registry, extractor_id);
 }
+
+WTREE_PURE
+wtree3_index_key_into_fn find_extractor_into(wtree3_db_t *db, uint64_t extractor_id) {
+    if (!db) return NULL;
+
+    return wtree3_extractor_registry_get_into(db->extractor_registry, extractor_id);
+}
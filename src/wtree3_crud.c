@@ -5,7 +5,16 @@
  * - Transactional CRUD: get_txn, insert_one_txn, update_txn, upsert_txn, delete_one_txn, exists_txn
  * - Batch operations: insert_many_txn, upsert_many_txn, get_many_txn
  * - Auto-transaction wrappers: get, insert_one, update, upsert, delete_one, exists
- * - Index maintenance helpers: indexes_insert, indexes_delete
+ *   (writes are routed through the group-commit batcher when it is enabled,
+ *   upserts through the tree's combining buffer)
+ * - Positioned writes: crud_seek, crud_insert_at, crud_replace_at, crud_delete_at
+ * - Reserved writes: reserve_txn, commit_reserved (serialize in place)
+ * - Index maintenance helpers: indexes_insert, indexes_delete, indexes_update,
+ *   index_covers_key, index_key_extract (both extractor ABIs and key specs),
+ *   index_dup_build (covering index entries)
+ *
+ * Every public entry point is bracketed by metrics_begin/metrics_end; the
+ * write bodies live in crud_* helpers so nested calls are not recounted.
  */
 
 #include "wtree3_internal.h"
@@ -16,83 +25,388 @@
  * ============================================================ */
 
 WTREE_HOT
-int indexes_insert(wtree3_tree_t *tree, MDB_txn *txn,
-                          const void *key, size_t key_len,
-                          const void *value, size_t value_len,
-                          gerror_t *error) {
-    size_t index_count = wvector_size(tree->indexes);
-    for (size_t i = 0; i < index_count; i++) {
-        wtree3_index_t *idx = (wtree3_index_t *)wvector_get(tree->indexes, i);
-
-        void *idx_key = NULL;
-        size_t idx_key_len = 0;
-        bool should_index = idx->key_fn(value, value_len, idx->user_data,
-                                        &idx_key, &idx_key_len);
+bool index_key_extract(const wtree3_index_t *idx, const void *value, size_t value_len,
+                       index_key_t *key) {
+    key->data = NULL;
+    key->len = 0;
+    key->heap = NULL;
+
+    if (idx->key_spec) return key_spec_extract(idx->key_spec, idx->sparse, value, value_len, key);
+
+    if (WTREE_LIKELY(idx->key_fn != NULL)) {
+        void *out = NULL;
+        size_t out_len = 0;
+        if (!idx->key_fn(value, value_len, idx->user_data, &out, &out_len)) return false;
+        key->heap = out;
+        key->data = out;
+        key->len = out_len;
+        return true;
+    }
+
+    void *buf = key->buf;
+    size_t cap = sizeof(key->buf);
+    const void *out = NULL;
+    size_t out_len = 0;
+    if (!idx->key_into_fn(value, value_len, idx->user_data, buf, cap, &out, &out_len)) return false;
+
+    if (WTREE_UNLIKELY(!out && out_len > cap)) {
+        /* Scratch too small - retry once with the size the extractor asked for */
+        key->heap = malloc(out_len);
+        if (WTREE_UNLIKELY(!key->heap)) return true;
+        buf = key->heap;
+        cap = out_len;
+        if (!idx->key_into_fn(value, value_len, idx->user_data, buf, cap, &out, &out_len)) {
+            index_key_release(key);
+            return false;
+        }
+    }
+
+    /* A key written into our buffer must fit in it */
+    if (WTREE_UNLIKELY(out == buf && out_len > cap)) out = NULL;
+
+    key->data = out;
+    key->len = out_len;
+    return true;
+}
+
+void *index_key_detach(index_key_t *key) {
+    if (key->heap && key->data == key->heap) {
+        void *owned = key->heap;
+        key->heap = NULL;
+        return owned;
+    }
+
+    void *owned = malloc(key->len ? key->len : 1);
+    if (WTREE_LIKELY(owned != NULL)) memcpy(owned, key->data, key->len);
+    index_key_release(key);
+    return owned;
+}
+
+WTREE_HOT WTREE_WARN_UNUSED
+int index_dup_build(const wtree3_index_t *idx,
+                    const void *main_key, size_t main_key_len,
+                    const void *value, size_t value_len,
+                    index_dup_t *dup, gerror_t *error) {
+    dup->heap = NULL;
+    if (WTREE_LIKELY(!idx->project_fn)) {
+        dup->val.mv_data = (void*)main_key;
+        dup->val.mv_size = main_key_len;
+        return WTREE3_OK;
+    }
+
+    void *payload = NULL;
+    size_t payload_len = 0;
+    if (value && WTREE_UNLIKELY(!idx->project_fn(value, value_len, idx->user_data,
+                                                 &payload, &payload_len))) {
+        set_error(error, WTREE3_LIB, WTREE3_ERROR,
+                 "Index projection failed for '%s'", idx->name);
+        return WTREE3_ERROR;
+    }
+    if (WTREE_UNLIKELY(main_key_len > 0xFFFF)) {
+        free(payload);
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                 "Main key too long for covering index '%s'", idx->name);
+        return WTREE3_EINVAL;
+    }
+
+    size_t total = main_key_len + payload_len + INDEX_COVERING_TRAILER;
+    unsigned char *p = dup->buf;
+    if (total > sizeof(dup->buf)) {
+        p = dup->heap = malloc(total);
+        if (WTREE_UNLIKELY(!p)) {
+            free(payload);
+            set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate index entry");
+            return WTREE3_ENOMEM;
+        }
+    }
+
+    memcpy(p, main_key, main_key_len);
+    if (payload_len > 0) memcpy(p + main_key_len, payload, payload_len);
+    p[total - 2] = (unsigned char)(main_key_len & 0xFF);
+    p[total - 1] = (unsigned char)(main_key_len >> 8);
+    free(payload);
+
+    dup->val.mv_data = p;
+    dup->val.mv_size = total;
+    return WTREE3_OK;
+}
+
+int index_covering_dcmp(const MDB_val *a, const MDB_val *b) {
+    MDB_val ma, mb;
+    if (WTREE_UNLIKELY(!index_dup_split(true, a, &ma, NULL))) ma = *a;
+    if (WTREE_UNLIKELY(!index_dup_split(true, b, &mb, NULL))) mb = *b;
+
+    /* Same order as LMDB's default dup comparator on the main keys */
+    size_t len = ma.mv_size < mb.mv_size ? ma.mv_size : mb.mv_size;
+    int c = len ? memcmp(ma.mv_data, mb.mv_data, len) : 0;
+    if (c != 0) return c;
+    return ma.mv_size < mb.mv_size ? -1 : (ma.mv_size > mb.mv_size ? 1 : 0);
+}
+
+WTREE_HOT
+bool index_covers_key(MDB_txn *txn, wtree3_tree_t *tree, wtree3_index_t *idx,
+                      const void *key, size_t key_len) {
+    if (WTREE_LIKELY(!idx->building)) return true;
+    if (!idx->build_cursor.mv_data) return false;
+
+    /* The build will reach keys past its cursor on its own */
+    MDB_val mkey = {.mv_size = key_len, .mv_data = (void*)key};
+    return mdb_cmp(txn, tree->dbi, &mkey, &idx->build_cursor) <= 0;
+}
+
+/* Main-tree point read that skips LMDB when the key filter rules the key out */
+static inline int main_get(MDB_txn *txn, wtree3_tree_t *tree, MDB_val *key, MDB_val *val) {
+    if (filter_rules_out(tree->filter, txn, key->mv_data, key->mv_size)) return MDB_NOTFOUND;
+    return mdb_get(txn, tree->dbi, key, val);
+}
+
+/* Extractor call on the write path, timed when metrics are on */
+static inline bool crud_extract(wtree3_db_t *db, wtree3_index_t *idx,
+                                const void *value, size_t value_len, index_key_t *key) {
+    uint64_t t0 = metrics_begin(db);
+    bool indexed = index_key_extract(idx, value, value_len, key);
+    if (WTREE_UNLIKELY(t0 != 0)) metrics_record(db, idx->metric_ops, WTREE3_METRIC_EXTRACT, t0, 0);
+    return indexed;
+}
+
+/* Unique constraint probe: true if the index key is already taken */
+static inline bool crud_unique_taken(wtree3_db_t *db, MDB_txn *txn, wtree3_index_t *idx,
+                                     const MDB_val *mk) {
+    uint64_t t0 = metrics_begin(db);
+    MDB_val check_key = *mk;
+    MDB_val check_val;
+    bool taken = !filter_rules_out(idx->filter, txn, mk->mv_data, mk->mv_size) &&
+                 mdb_get(txn, idx->dbi, &check_key, &check_val) == 0;
+    if (WTREE_UNLIKELY(t0 != 0)) metrics_record(db, idx->metric_ops, WTREE3_METRIC_UNIQUE_CHECK, t0, 0);
+    return taken;
+}
+
+static int indexes_insert_run(wtree3_tree_t *tree, const index_set_t *set, MDB_txn *txn,
+                              const void *key, size_t key_len,
+                              const void *value, size_t value_len,
+                              gerror_t *error) {
+    for (size_t i = 0; i < set->count; i++) {
+        wtree3_index_t *idx = set->items[i];
+        if (WTREE_UNLIKELY(!index_covers_key(txn, tree, idx, key, key_len))) continue;
+
+        index_key_t idx_key;
+        bool should_index = crud_extract(tree->db, idx, value, value_len, &idx_key);
 
         if (WTREE_LIKELY(!should_index)) continue;
-        if (WTREE_UNLIKELY(!idx_key)) {
+        if (WTREE_UNLIKELY(!idx_key.data)) {
+            index_key_release(&idx_key);
             set_error(error, WTREE3_LIB, WTREE3_ERROR,
                      "Index key extraction failed for '%s'", idx->name);
             return WTREE3_ERROR;
         }
 
+        MDB_val mk = {.mv_size = idx_key.len, .mv_data = (void*)idx_key.data};
+
         /* Check unique constraint */
         if (WTREE_UNLIKELY(idx->unique)) {
-            MDB_val check_key = {.mv_size = idx_key_len, .mv_data = idx_key};
-            MDB_val check_val;
-            int get_rc = mdb_get(txn, idx->dbi, &check_key, &check_val);
-            if (WTREE_UNLIKELY(get_rc == 0)) {
-                free(idx_key);
+            if (WTREE_UNLIKELY(crud_unique_taken(tree->db, txn, idx, &mk))) {
+                index_key_release(&idx_key);
                 set_error(error, WTREE3_LIB, WTREE3_INDEX_ERROR,
                          "Duplicate key for unique index '%s'", idx->name);
                 return WTREE3_INDEX_ERROR;
             }
         }
 
-        /* Insert: index_key -> main_key */
-        MDB_val mk = {.mv_size = idx_key_len, .mv_data = idx_key};
-        MDB_val mv = {.mv_size = key_len, .mv_data = (void*)key};
-        int rc = mdb_put(txn, idx->dbi, &mk, &mv, MDB_NODUPDATA);
-        free(idx_key);
+        /* Insert: index_key -> main_key (+ projection for covering indexes) */
+        index_dup_t dup;
+        int rc = index_dup_build(idx, key, key_len, value, value_len, &dup, error);
+        if (WTREE_UNLIKELY(rc != 0)) {
+            index_key_release(&idx_key);
+            return rc;
+        }
+        rc = mdb_put(txn, idx->dbi, &mk, &dup.val, MDB_NODUPDATA);
+        index_dup_release(&dup);
+        index_key_release(&idx_key);
 
         if (WTREE_UNLIKELY(rc != 0 && rc != MDB_KEYEXIST)) {
             return translate_mdb_error(rc, error);
         }
+        if (rc == 0) {
+            metrics_count(tree->db, idx, WTREE3_METRIC_INSERT);
+            filter_note_add(idx->filter, mk.mv_data, mk.mv_size);
+        }
     }
 
     return WTREE3_OK;
 }
 
-WTREE_HOT
-int indexes_delete(wtree3_tree_t *tree, MDB_txn *txn,
-                          const void *key, size_t key_len,
-                          const void *value, size_t value_len,
-                          gerror_t *error) {
-    size_t index_count = wvector_size(tree->indexes);
-    for (size_t i = 0; i < index_count; i++) {
-        wtree3_index_t *idx = (wtree3_index_t *)wvector_get(tree->indexes, i);
+static int indexes_delete_run(wtree3_tree_t *tree, const index_set_t *set, MDB_txn *txn,
+                              const void *key, size_t key_len,
+                              const void *value, size_t value_len,
+                              gerror_t *error) {
+    for (size_t i = 0; i < set->count; i++) {
+        wtree3_index_t *idx = set->items[i];
+        if (WTREE_UNLIKELY(!index_covers_key(txn, tree, idx, key, key_len))) continue;
 
-        void *idx_key = NULL;
-        size_t idx_key_len = 0;
-        bool should_index = idx->key_fn(value, value_len, idx->user_data,
-                                        &idx_key, &idx_key_len);
+        index_key_t idx_key;
+        bool should_index = crud_extract(tree->db, idx, value, value_len, &idx_key);
 
-        if (WTREE_LIKELY(!should_index || !idx_key)) continue;
+        if (WTREE_LIKELY(!should_index || !idx_key.data)) {
+            index_key_release(&idx_key);
+            continue;
+        }
 
         /* Delete specific key+value pair from DUPSORT tree */
-        MDB_val mk = {.mv_size = idx_key_len, .mv_data = idx_key};
-        MDB_val mv = {.mv_size = key_len, .mv_data = (void*)key};
-        int rc = mdb_del(txn, idx->dbi, &mk, &mv);
-        free(idx_key);
+        index_dup_t dup;
+        int rc = index_dup_build(idx, key, key_len, NULL, 0, &dup, error);
+        if (WTREE_UNLIKELY(rc != 0)) {
+            index_key_release(&idx_key);
+            return rc;
+        }
+        MDB_val mk = {.mv_size = idx_key.len, .mv_data = (void*)idx_key.data};
+        rc = mdb_del(txn, idx->dbi, &mk, &dup.val);
+        index_dup_release(&dup);
+        index_key_release(&idx_key);
 
         if (WTREE_UNLIKELY(rc != 0 && rc != MDB_NOTFOUND)) {
             return translate_mdb_error(rc, error);
         }
+        if (rc == 0) {
+            metrics_count(tree->db, idx, WTREE3_METRIC_DELETE);
+            filter_note_remove(idx->filter);
+        }
     }
 
     return WTREE3_OK;
 }
 
+static int indexes_update_run(wtree3_tree_t *tree, const index_set_t *set, MDB_txn *txn,
+                              const void *key, size_t key_len,
+                              const void *old_value, size_t old_len,
+                              const void *new_value, size_t new_len,
+                              gerror_t *error) {
+    for (size_t i = 0; i < set->count; i++) {
+        wtree3_index_t *idx = set->items[i];
+        if (WTREE_UNLIKELY(!index_covers_key(txn, tree, idx, key, key_len))) continue;
+
+        index_key_t old_key, new_key;
+        bool had_old = crud_extract(tree->db, idx, old_value, old_len, &old_key) && old_key.data;
+        bool has_new = crud_extract(tree->db, idx, new_value, new_len, &new_key);
+
+        if (WTREE_UNLIKELY(has_new && !new_key.data)) {
+            index_key_release(&old_key);
+            index_key_release(&new_key);
+            set_error(error, WTREE3_LIB, WTREE3_ERROR,
+                     "Index key extraction failed for '%s'", idx->name);
+            return WTREE3_ERROR;
+        }
+
+        /* Indexed field unchanged - the existing entry is already right,
+         * unless a covering index has to refresh its payload */
+        bool same_key = had_old && has_new && old_key.len == new_key.len &&
+                        memcmp(old_key.data, new_key.data, old_key.len) == 0;
+        if (same_key && !idx->project_fn) {
+            index_key_release(&old_key);
+            index_key_release(&new_key);
+            continue;
+        }
+
+        int rc = 0;
+        if (had_old) {
+            index_dup_t probe;
+            MDB_val mk = {.mv_size = old_key.len, .mv_data = (void*)old_key.data};
+            rc = index_dup_build(idx, key, key_len, NULL, 0, &probe, error);
+            if (rc == 0) {
+                rc = mdb_del(txn, idx->dbi, &mk, &probe.val);
+                index_dup_release(&probe);
+                if (WTREE_UNLIKELY(rc != 0 && rc != MDB_NOTFOUND)) {
+                    rc = translate_mdb_error(rc, error);
+                } else {
+                    if (rc == 0) {
+                        metrics_count(tree->db, idx, WTREE3_METRIC_DELETE);
+                        filter_note_remove(idx->filter);
+                    }
+                    rc = 0;
+                }
+            }
+            if (WTREE_UNLIKELY(rc != 0)) {
+                index_key_release(&old_key);
+                index_key_release(&new_key);
+                return rc;
+            }
+        }
+        index_key_release(&old_key);
+
+        if (!has_new) continue;
+
+        MDB_val mk = {.mv_size = new_key.len, .mv_data = (void*)new_key.data};
+
+        /* Check unique constraint (our own entry was just removed) */
+        if (WTREE_UNLIKELY(idx->unique && !same_key)) {
+            if (WTREE_UNLIKELY(crud_unique_taken(tree->db, txn, idx, &mk))) {
+                index_key_release(&new_key);
+                set_error(error, WTREE3_LIB, WTREE3_INDEX_ERROR,
+                         "Duplicate key for unique index '%s'", idx->name);
+                return WTREE3_INDEX_ERROR;
+            }
+        }
+
+        index_dup_t dup;
+        rc = index_dup_build(idx, key, key_len, new_value, new_len, &dup, error);
+        if (WTREE_UNLIKELY(rc != 0)) {
+            index_key_release(&new_key);
+            return rc;
+        }
+        rc = mdb_put(txn, idx->dbi, &mk, &dup.val, MDB_NODUPDATA);
+        index_dup_release(&dup);
+        index_key_release(&new_key);
+        if (WTREE_UNLIKELY(rc != 0 && rc != MDB_KEYEXIST)) {
+            return translate_mdb_error(rc, error);
+        }
+        if (rc == 0) {
+            metrics_count(tree->db, idx, WTREE3_METRIC_INSERT);
+            filter_note_add(idx->filter, mk.mv_data, mk.mv_size);
+        }
+    }
+
+    return WTREE3_OK;
+}
+
+/* Index maintenance entry points: time the whole pass over all indexes */
+
+WTREE_HOT
+int indexes_insert(wtree3_tree_t *tree, const index_set_t *set, MDB_txn *txn,
+                   const void *key, size_t key_len,
+                   const void *value, size_t value_len,
+                   gerror_t *error) {
+    if (set->count == 0) return WTREE3_OK;
+    uint64_t t0 = metrics_begin(tree->db);
+    int rc = indexes_insert_run(tree, set, txn, key, key_len, value, value_len, error);
+    metrics_end(tree->db, tree, WTREE3_METRIC_INDEX_MAINT, t0, 0);
+    return rc;
+}
+
+WTREE_HOT
+int indexes_delete(wtree3_tree_t *tree, const index_set_t *set, MDB_txn *txn,
+                   const void *key, size_t key_len,
+                   const void *value, size_t value_len,
+                   gerror_t *error) {
+    if (set->count == 0) return WTREE3_OK;
+    uint64_t t0 = metrics_begin(tree->db);
+    int rc = indexes_delete_run(tree, set, txn, key, key_len, value, value_len, error);
+    metrics_end(tree->db, tree, WTREE3_METRIC_INDEX_MAINT, t0, 0);
+    return rc;
+}
+
+WTREE_HOT
+int indexes_update(wtree3_tree_t *tree, const index_set_t *set, MDB_txn *txn,
+                   const void *key, size_t key_len,
+                   const void *old_value, size_t old_len,
+                   const void *new_value, size_t new_len,
+                   gerror_t *error) {
+    if (set->count == 0) return WTREE3_OK;
+    uint64_t t0 = metrics_begin(tree->db);
+    int rc = indexes_update_run(tree, set, txn, key, key_len, old_value, old_len,
+                                new_value, new_len, error);
+    metrics_end(tree->db, tree, WTREE3_METRIC_INDEX_MAINT, t0, 0);
+    return rc;
+}
+
 /* ============================================================
  * Data Operations (With Transaction)
  * ============================================================ */
@@ -110,7 +424,10 @@ int wtree3_get_txn(wtree3_txn_t *txn, wtree3_tree_t *tree,
     MDB_val mkey = {.mv_size = key_len, .mv_data = (void*)key};
     MDB_val mval;
 
-    int rc = mdb_get(txn->txn, tree->dbi, &mkey, &mval);
+    uint64_t t0 = metrics_begin(tree->db);
+    int rc = main_get(txn->txn, tree, &mkey, &mval);
+    if (rc == 0) rc = tree_value_decode_txn(tree, txn, &mval);
+    metrics_end(tree->db, tree, WTREE3_METRIC_GET, t0, 0);
     if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
 
     *value = mval.mv_data;
@@ -118,184 +435,453 @@ int wtree3_get_txn(wtree3_txn_t *txn, wtree3_tree_t *tree,
     return WTREE3_OK;
 }
 
+/*
+ * Write bodies behind the public *_txn calls (parameters already checked),
+ * so composite writes like upsert are timed once under their own metric.
+ * The caller pins the index set, so the decode gates and the index
+ * maintenance below agree on one list even while indexes are added.
+ *
+ * Upsert, update, delete and modify find their key once, with a cursor,
+ * and write through it: a replace is an MDB_CURRENT put on the entry the
+ * cursor sits on, and an insert goes to the leaf the probe just loaded,
+ * which LMDB's cursor search checks before descending from the root.
+ */
+
+/* Old and merged values up to this size are copied on the stack */
+#define CRUD_MERGE_STACK 256
+
 WTREE_HOT WTREE_WARN_UNUSED
-int wtree3_insert_one_txn(wtree3_txn_t *txn, wtree3_tree_t *tree,
-                           const void *key, size_t key_len,
-                           const void *value, size_t value_len,
-                           gerror_t *error) {
-    if (WTREE_UNLIKELY(!txn || !tree || !key || !value)) {
-        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
-        return WTREE3_EINVAL;
-    }
+int crud_seek(MDB_txn *txn, wtree3_tree_t *tree, MDB_cursor *cursor,
+              const MDB_val *key, MDB_val *old, bool *found) {
+    *found = false;
+    if (filter_rules_out(tree->filter, txn, key->mv_data, key->mv_size)) return 0;
+
+    MDB_val k = *key;
+    int rc = mdb_cursor_get(cursor, &k, old, MDB_SET_RANGE);
+    if (rc == MDB_NOTFOUND) return 0;
+    if (WTREE_UNLIKELY(rc != 0)) return rc;
+    *found = mdb_cmp(txn, tree->dbi, &k, key) == 0;
+    return 0;
+}
 
-    if (WTREE_UNLIKELY(!txn->is_write)) {
-        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Write operation requires write transaction");
+/* Overwrite the entry under the cursor (DUPSORT mains keep mdb_put's add-a-dup) */
+static inline int crud_put_current(MDB_txn *txn, wtree3_tree_t *tree, MDB_cursor *cursor,
+                                   MDB_val *key, MDB_val *val) {
+    if (WTREE_UNLIKELY(tree->flags & MDB_DUPSORT)) return mdb_put(txn, tree->dbi, key, val, 0);
+    return mdb_cursor_put(cursor, key, val, MDB_CURRENT);
+}
+
+WTREE_HOT WTREE_WARN_UNUSED
+int crud_insert_at(wtree3_txn_t *txn, wtree3_tree_t *tree, const index_set_t *set,
+                   MDB_cursor *cursor,
+                   const void *key, size_t key_len,
+                   const void *value, size_t value_len,
+                   gerror_t *error) {
+    if (WTREE_UNLIKELY(!tree_key_len_ok(tree, set, key_len))) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                 "Key of %zu bytes does not fit the tree's fixed key width", key_len);
         return WTREE3_EINVAL;
     }
 
     /* Insert into indexes first (check unique constraints) */
-    int rc = indexes_insert(tree, txn->txn, key, key_len, value, value_len, error);
+    int rc = indexes_insert(tree, set, txn->txn, key, key_len, value, value_len, error);
     if (WTREE_UNLIKELY(rc != 0)) return rc;
 
     /* Insert into main tree */
     MDB_val mkey = {.mv_size = key_len, .mv_data = (void*)key};
     MDB_val mval = {.mv_size = value_len, .mv_data = (void*)value};
+    codec_buf_t frame = {0};
 
-    rc = mdb_put(txn->txn, tree->dbi, &mkey, &mval, MDB_NOOVERWRITE);
+    rc = tree_value_encode(tree, &mval, &frame);
+    if (WTREE_LIKELY(rc == 0)) {
+        rc = cursor ? mdb_cursor_put(cursor, &mkey, &mval, MDB_NOOVERWRITE)
+                    : mdb_put(txn->txn, tree->dbi, &mkey, &mval, MDB_NOOVERWRITE);
+    }
+    codec_buf_release(&frame);
     if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
 
-    tree->entry_count++;
-    return WTREE3_OK;
+    filter_note_add(tree->filter, key, key_len);
+    return changelog_note(tree, txn->txn, WTREE3_CHANGE_INSERT, key, key_len, value, value_len, error);
 }
 
 WTREE_HOT WTREE_WARN_UNUSED
-int wtree3_update_txn(wtree3_txn_t *txn, wtree3_tree_t *tree,
-                       const void *key, size_t key_len,
-                       const void *value, size_t value_len,
-                       gerror_t *error) {
-    if (WTREE_UNLIKELY(!txn || !tree || !key || !value)) {
-        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
-        return WTREE3_EINVAL;
-    }
-
-    if (WTREE_UNLIKELY(!txn->is_write)) {
-        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Write operation requires write transaction");
-        return WTREE3_EINVAL;
-    }
+int crud_replace_at(wtree3_txn_t *txn, wtree3_tree_t *tree, const index_set_t *set,
+                    MDB_cursor *cursor,
+                    const void *key, size_t key_len,
+                    const void *old_value, size_t old_len,
+                    const void *value, size_t value_len,
+                    gerror_t *error) {
+    /* Rewrite only the index entries whose extracted key changed */
+    int rc = indexes_update(tree, set, txn->txn, key, key_len, old_value, old_len,
+                            value, value_len, error);
+    if (WTREE_UNLIKELY(rc != 0)) return rc;
 
-    /* Get old value for index maintenance (if exists) */
     MDB_val mkey = {.mv_size = key_len, .mv_data = (void*)key};
-    MDB_val old_val;
-    int rc = mdb_get(txn->txn, tree->dbi, &mkey, &old_val);
-
-    if (WTREE_UNLIKELY(rc == MDB_NOTFOUND)) {
-        set_error(error, WTREE3_LIB, WTREE3_NOT_FOUND, "Key not found");
-        return WTREE3_NOT_FOUND;
-    }
+    MDB_val mval = {.mv_size = value_len, .mv_data = (void*)value};
+    codec_buf_t frame = {0};
+    rc = tree_value_encode(tree, &mval, &frame);
+    if (WTREE_LIKELY(rc == 0)) rc = crud_put_current(txn->txn, tree, cursor, &mkey, &mval);
+    codec_buf_release(&frame);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
 
-    if (WTREE_UNLIKELY(rc != 0)) {
-        return translate_mdb_error(rc, error);
-    }
+    return changelog_note(tree, txn->txn, WTREE3_CHANGE_UPDATE, key, key_len, value, value_len, error);
+}
 
-    /* Delete from indexes using old value */
-    rc = indexes_delete(tree, txn->txn, key, key_len, old_val.mv_data, old_val.mv_size, error);
+WTREE_HOT WTREE_WARN_UNUSED
+int crud_delete_at(wtree3_txn_t *txn, wtree3_tree_t *tree, const index_set_t *set,
+                   MDB_cursor *cursor,
+                   const void *key, size_t key_len,
+                   const void *old_value, size_t old_len,
+                   gerror_t *error) {
+    int rc = indexes_delete(tree, set, txn->txn, key, key_len, old_value, old_len, error);
     if (WTREE_UNLIKELY(rc != 0)) return rc;
 
-    /* Insert into indexes with new value */
-    rc = indexes_insert(tree, txn->txn, key, key_len, value, value_len, error);
-    if (WTREE_UNLIKELY(rc != 0)) return rc;
+    rc = mdb_cursor_del(cursor, (tree->flags & MDB_DUPSORT) ? MDB_NODUPDATA : 0);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
 
-    /* Update value in main tree */
-    MDB_val mval = {.mv_size = value_len, .mv_data = (void*)value};
-    rc = mdb_put(txn->txn, tree->dbi, &mkey, &mval, 0);
+    filter_note_remove(tree->filter);
+    return changelog_note(tree, txn->txn, WTREE3_CHANGE_DELETE, key, key_len, NULL, 0, error);
+}
+
+/* Open a main-tree cursor and find key on it */
+static int crud_open_seek(wtree3_txn_t *txn, wtree3_tree_t *tree, const MDB_val *key,
+                          MDB_cursor **cursor, MDB_val *old, bool *found, gerror_t *error) {
+    int rc = mdb_cursor_open(txn->txn, tree->dbi, cursor);
     if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
 
+    rc = crud_seek(txn->txn, tree, *cursor, key, old, found);
+    if (WTREE_UNLIKELY(rc != 0)) {
+        mdb_cursor_close(*cursor);
+        return translate_mdb_error(rc, error);
+    }
     return WTREE3_OK;
 }
 
-WTREE_HOT WTREE_WARN_UNUSED
-int wtree3_upsert_txn(wtree3_txn_t *txn, wtree3_tree_t *tree,
+static int crud_insert(wtree3_txn_t *txn, wtree3_tree_t *tree, const index_set_t *set,
                        const void *key, size_t key_len,
                        const void *value, size_t value_len,
                        gerror_t *error) {
-    if (WTREE_UNLIKELY(!txn || !tree || !key || !value)) {
-        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
-        return WTREE3_EINVAL;
-    }
+    /* One mdb_put: the NOOVERWRITE probe is the only descent */
+    return crud_insert_at(txn, tree, set, NULL, key, key_len, value, value_len, error);
+}
 
-    if (!txn->is_write) {
-        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Write operation requires write transaction");
-        return WTREE3_EINVAL;
+static int crud_update(wtree3_txn_t *txn, wtree3_tree_t *tree, const index_set_t *set,
+                       const void *key, size_t key_len,
+                       const void *value, size_t value_len,
+                       gerror_t *error) {
+    MDB_val mkey = {.mv_size = key_len, .mv_data = (void*)key};
+    MDB_val old_val;
+    MDB_cursor *cursor;
+    bool found;
+    int rc = crud_open_seek(txn, tree, &mkey, &cursor, &old_val, &found, error);
+    if (WTREE_UNLIKELY(rc != 0)) return rc;
+
+    if (WTREE_UNLIKELY(!found)) {
+        mdb_cursor_close(cursor);
+        set_error(error, WTREE3_LIB, WTREE3_NOT_FOUND, "Key not found");
+        return WTREE3_NOT_FOUND;
     }
 
-    /* Try insert first - if key doesn't exist, we're done */
-    int rc = wtree3_insert_one_txn(txn, tree, key, key_len, value, value_len, error);
+    /* The old value only matters to the indexes */
+    codec_buf_t old_buf = {0};
+    if (set->count > 0) rc = tree_value_decode(tree, &old_val, &old_buf);
+    rc = rc != 0 ? translate_mdb_error(rc, error)
+                 : crud_replace_at(txn, tree, set, cursor, key, key_len,
+                                   old_val.mv_data, old_val.mv_size, value, value_len, error);
+    codec_buf_release(&old_buf);
+    mdb_cursor_close(cursor);
+    return rc;
+}
 
-    if (rc == WTREE3_OK) {
-        /* Insert succeeded - key didn't exist */
-        return WTREE3_OK;
+/* Existing key, merge_fn set: the callback allocates the merged value */
+static int crud_merge(wtree3_txn_t *txn, wtree3_tree_t *tree, const index_set_t *set,
+                      MDB_cursor *cursor, MDB_val *old_val,
+                      const void *key, size_t key_len,
+                      const void *value, size_t value_len,
+                      gerror_t *error) {
+    codec_buf_t old_buf = {0};
+    int rc = tree_value_decode(tree, old_val, &old_buf);
+    if (WTREE_UNLIKELY(rc != 0)) {
+        codec_buf_release(&old_buf);
+        return translate_mdb_error(rc, error);
     }
 
-    if (rc != WTREE3_KEY_EXISTS) {
-        /* Some other error occurred */
-        return rc;
+    size_t merged_len;
+    void *merged_value = tree->merge_fn(old_val->mv_data, old_val->mv_size,
+                                        value, value_len,
+                                        tree->merge_user_data, &merged_len);
+    if (!merged_value) {
+        codec_buf_release(&old_buf);
+        set_error(error, WTREE3_LIB, WTREE3_ERROR, "Merge callback returned NULL");
+        return WTREE3_ERROR;
     }
 
-    /* Key exists - need to handle merge (if callback exists) or just update */
-    if (tree->merge_fn) {
-        /* Get old value for merge */
-        MDB_val mkey = {.mv_size = key_len, .mv_data = (void*)key};
-        MDB_val old_val;
-        rc = mdb_get(txn->txn, tree->dbi, &mkey, &old_val);
+    rc = crud_replace_at(txn, tree, set, cursor, key, key_len,
+                         old_val->mv_data, old_val->mv_size, merged_value, merged_len, error);
+    free(merged_value);
+    codec_buf_release(&old_buf);
+    return rc;
+}
 
-        if (WTREE_UNLIKELY(rc != 0)) {
-            return translate_mdb_error(rc, error);
-        }
+/*
+ * Existing key, merge_into_fn set, and nothing needs the old value after
+ * the write: reserve the merged value's room over the old entry and let
+ * the callback write it there. The old value is set aside first, since an
+ * equal-size reserve hands back its own bytes. Reserving the old length
+ * fits fixed-size values (counters) on the first call; otherwise the
+ * callback runs once more on a reserve of the length it asked for.
+ */
+static int crud_merge_reserve(wtree3_txn_t *txn, wtree3_tree_t *tree,
+                              MDB_cursor *cursor, const MDB_val *old_val,
+                              const void *key, size_t key_len,
+                              const void *value, size_t value_len,
+                              gerror_t *error) {
+    unsigned char stack[CRUD_MERGE_STACK];
+    size_t old_len = old_val->mv_size;
+    void *prev = old_len <= sizeof(stack) ? stack : malloc(old_len);
+    if (WTREE_UNLIKELY(!prev)) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate merge buffer");
+        return WTREE3_ENOMEM;
+    }
+    if (old_len > 0) memcpy(prev, old_val->mv_data, old_len);
 
-        /* Call merge callback */
-        size_t merged_len;
-        void *merged_value = tree->merge_fn(
-            old_val.mv_data, old_val.mv_size,
-            value, value_len,
-            tree->merge_user_data,
-            &merged_len
-        );
-
-        if (!merged_value) {
-            set_error(error, WTREE3_LIB, WTREE3_ERROR, "Merge callback returned NULL");
-            return WTREE3_ERROR;
+    MDB_val mkey = {.mv_size = key_len, .mv_data = (void*)key};
+    MDB_val mval = {0};
+    size_t cap = old_len;
+    size_t out_len = 0;
+    bool merged = false;
+    int rc = 0;
+    for (int attempt = 0; attempt < 2 && !merged; attempt++) {
+        mval.mv_size = cap;
+        mval.mv_data = NULL;
+        rc = mdb_cursor_put(cursor, &mkey, &mval, MDB_CURRENT | MDB_RESERVE);
+        if (WTREE_UNLIKELY(rc != 0)) break;
+        if (!tree->merge_into_fn(prev, old_len, value, value_len, tree->merge_user_data,
+                                 mval.mv_data, cap, &out_len)) {
+            break;
         }
+        if (out_len == cap) merged = true;
+        else cap = out_len;
+    }
 
-        /* Update with merged value */
-        rc = wtree3_update_txn(txn, tree, key, key_len, merged_value, merged_len, error);
-        free(merged_value);
-        return rc;
+    int status = WTREE3_OK;
+    if (WTREE_UNLIKELY(rc != 0)) {
+        status = translate_mdb_error(rc, error);
+    } else if (WTREE_UNLIKELY(!merged)) {
+        /* Put the old value back over the half-written reserve */
+        MDB_val restore = {.mv_size = old_len, .mv_data = prev};
+        rc = mdb_cursor_put(cursor, &mkey, &restore, MDB_CURRENT);
+        if (rc != 0) {
+            status = translate_mdb_error(rc, error);
+        } else {
+            set_error(error, WTREE3_LIB, WTREE3_ERROR, "Merge callback failed");
+            status = WTREE3_ERROR;
+        }
+    } else {
+        status = changelog_note(tree, txn->txn, WTREE3_CHANGE_UPDATE, key, key_len,
+                                mval.mv_data, out_len, error);
     }
 
-    /* No merge function - just update with new value */
-    return wtree3_update_txn(txn, tree, key, key_len, value, value_len, error);
+    if (prev != stack) free(prev);
+    return status;
 }
 
-WTREE_HOT WTREE_WARN_UNUSED
-int wtree3_delete_one_txn(wtree3_txn_t *txn, wtree3_tree_t *tree,
+/* Existing key, merge_into_fn set */
+static int crud_merge_into(wtree3_txn_t *txn, wtree3_tree_t *tree, const index_set_t *set,
+                           MDB_cursor *cursor, MDB_val *old_val,
                            const void *key, size_t key_len,
-                           bool *deleted,
+                           const void *value, size_t value_len,
                            gerror_t *error) {
-    if (WTREE_UNLIKELY(!txn || !tree || !key)) {
-        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
-        return WTREE3_EINVAL;
+    /* Indexes need the old value after the write; codecs re-frame the new one */
+    if (set->count == 0 && !tree->codec && !(tree->flags & MDB_DUPSORT)) {
+        return crud_merge_reserve(txn, tree, cursor, old_val, key, key_len, value, value_len, error);
     }
 
-    if (!txn->is_write) {
-        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Write operation requires write transaction");
-        return WTREE3_EINVAL;
+    codec_buf_t old_buf = {0};
+    int rc = tree_value_decode(tree, old_val, &old_buf);
+    if (WTREE_UNLIKELY(rc != 0)) {
+        codec_buf_release(&old_buf);
+        return translate_mdb_error(rc, error);
     }
 
-    if (deleted) *deleted = false;
+    unsigned char stack[CRUD_MERGE_STACK];
+    void *out = stack;
+    size_t out_len = 0;
+    bool merged = tree->merge_into_fn(old_val->mv_data, old_val->mv_size, value, value_len,
+                                      tree->merge_user_data, out, sizeof(stack), &out_len);
+    if (merged && out_len > sizeof(stack)) {
+        size_t cap = out_len;
+        out = malloc(cap);
+        if (WTREE_UNLIKELY(!out)) {
+            codec_buf_release(&old_buf);
+            set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate merged value");
+            return WTREE3_ENOMEM;
+        }
+        merged = tree->merge_into_fn(old_val->mv_data, old_val->mv_size, value, value_len,
+                                     tree->merge_user_data, out, cap, &out_len) &&
+                 out_len <= cap;
+    }
+
+    if (WTREE_UNLIKELY(!merged)) {
+        set_error(error, WTREE3_LIB, WTREE3_ERROR, "Merge callback failed");
+        rc = WTREE3_ERROR;
+    } else {
+        rc = crud_replace_at(txn, tree, set, cursor, key, key_len,
+                             old_val->mv_data, old_val->mv_size, out, out_len, error);
+    }
+    if (out != stack) free(out);
+    codec_buf_release(&old_buf);
+    return rc;
+}
+
+static int crud_upsert(wtree3_txn_t *txn, wtree3_tree_t *tree, const index_set_t *set,
+                       const void *key, size_t key_len,
+                       const void *value, size_t value_len,
+                       gerror_t *error) {
+    MDB_val mkey = {.mv_size = key_len, .mv_data = (void*)key};
+    MDB_val old_val;
+    MDB_cursor *cursor;
+    bool found;
+    int rc = crud_open_seek(txn, tree, &mkey, &cursor, &old_val, &found, error);
+    if (WTREE_UNLIKELY(rc != 0)) return rc;
+
+    if (!found) {
+        rc = crud_insert_at(txn, tree, set, cursor, key, key_len, value, value_len, error);
+    } else if (tree->merge_into_fn) {
+        rc = crud_merge_into(txn, tree, set, cursor, &old_val, key, key_len, value, value_len, error);
+    } else if (tree->merge_fn) {
+        rc = crud_merge(txn, tree, set, cursor, &old_val, key, key_len, value, value_len, error);
+    } else {
+        /* No merge function - just overwrite */
+        codec_buf_t old_buf = {0};
+        if (set->count > 0) rc = tree_value_decode(tree, &old_val, &old_buf);
+        rc = rc != 0 ? translate_mdb_error(rc, error)
+                     : crud_replace_at(txn, tree, set, cursor, key, key_len,
+                                       old_val.mv_data, old_val.mv_size, value, value_len, error);
+        codec_buf_release(&old_buf);
+    }
+
+    mdb_cursor_close(cursor);
+    return rc;
+}
 
-    /* Get value for index maintenance */
+static int crud_delete(wtree3_txn_t *txn, wtree3_tree_t *tree, const index_set_t *set,
+                       const void *key, size_t key_len,
+                       bool *deleted,
+                       gerror_t *error) {
     MDB_val mkey = {.mv_size = key_len, .mv_data = (void*)key};
     MDB_val mval;
-    int rc = mdb_get(txn->txn, tree->dbi, &mkey, &mval);
-    if (rc != 0) {
-        if (rc == MDB_NOTFOUND) return WTREE3_OK;  /* Not an error */
-        return translate_mdb_error(rc, error);
+    MDB_cursor *cursor;
+    bool found;
+    int rc = crud_open_seek(txn, tree, &mkey, &cursor, &mval, &found, error);
+    if (WTREE_UNLIKELY(rc != 0)) return rc;
+    if (!found) {
+        mdb_cursor_close(cursor);
+        return WTREE3_OK;  /* Not an error */
     }
 
-    /* Delete from indexes */
-    rc = indexes_delete(tree, txn->txn, key, key_len, mval.mv_data, mval.mv_size, error);
-    if (rc != 0) return rc;
+    /* The value only matters to the indexes */
+    codec_buf_t buf = {0};
+    if (set->count > 0) rc = tree_value_decode(tree, &mval, &buf);
+    rc = rc != 0 ? translate_mdb_error(rc, error)
+                 : crud_delete_at(txn, tree, set, cursor, key, key_len,
+                                  mval.mv_data, mval.mv_size, error);
+    codec_buf_release(&buf);
+    mdb_cursor_close(cursor);
 
-    /* Delete from main tree */
-    rc = mdb_del(txn->txn, tree->dbi, &mkey, NULL);
-    if (rc == 0) {
-        tree->entry_count--;
-        if (deleted) *deleted = true;
-    } else if (rc != MDB_NOTFOUND) {
-        return translate_mdb_error(rc, error);
+    if (rc == WTREE3_OK && deleted) *deleted = true;
+    return rc;
+}
+
+static bool crud_check_write(wtree3_txn_t *txn, wtree3_tree_t *tree,
+                             const void *key, const void *value, bool need_value,
+                             gerror_t *error) {
+    if (WTREE_UNLIKELY(!txn || !tree || !key || (need_value && !value))) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return false;
     }
 
-    return WTREE3_OK;
+    if (WTREE_UNLIKELY(!txn->is_write)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Write operation requires write transaction");
+        return false;
+    }
+
+    /* Another write could move the page the reservation points into */
+    if (WTREE_UNLIKELY(txn->reserved.cursor != NULL)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Transaction has a pending reservation");
+        return false;
+    }
+    return true;
+}
+
+WTREE_HOT WTREE_WARN_UNUSED
+int wtree3_insert_one_txn(wtree3_txn_t *txn, wtree3_tree_t *tree,
+                           const void *key, size_t key_len,
+                           const void *value, size_t value_len,
+                           gerror_t *error) {
+    if (WTREE_UNLIKELY(!crud_check_write(txn, tree, key, value, true, error))) return WTREE3_EINVAL;
+
+    uint64_t t0 = metrics_begin(tree->db);
+    index_pin_t pin;
+    const index_set_t *set = index_set_pin(tree, &pin);
+    int rc = crud_insert(txn, tree, set, key, key_len, value, value_len, error);
+    index_set_unpin(&pin);
+    metrics_end(tree->db, tree, WTREE3_METRIC_INSERT, t0, key_len + value_len);
+    durability_write(tree->db, key_len + value_len);
+    return rc;
+}
+
+WTREE_HOT WTREE_WARN_UNUSED
+int wtree3_update_txn(wtree3_txn_t *txn, wtree3_tree_t *tree,
+                       const void *key, size_t key_len,
+                       const void *value, size_t value_len,
+                       gerror_t *error) {
+    if (WTREE_UNLIKELY(!crud_check_write(txn, tree, key, value, true, error))) return WTREE3_EINVAL;
+
+    uint64_t t0 = metrics_begin(tree->db);
+    index_pin_t pin;
+    const index_set_t *set = index_set_pin(tree, &pin);
+    int rc = crud_update(txn, tree, set, key, key_len, value, value_len, error);
+    index_set_unpin(&pin);
+    metrics_end(tree->db, tree, WTREE3_METRIC_UPDATE, t0, key_len + value_len);
+    durability_write(tree->db, key_len + value_len);
+    return rc;
+}
+
+WTREE_HOT WTREE_WARN_UNUSED
+int wtree3_upsert_txn(wtree3_txn_t *txn, wtree3_tree_t *tree,
+                       const void *key, size_t key_len,
+                       const void *value, size_t value_len,
+                       gerror_t *error) {
+    if (WTREE_UNLIKELY(!crud_check_write(txn, tree, key, value, true, error))) return WTREE3_EINVAL;
+
+    uint64_t t0 = metrics_begin(tree->db);
+    index_pin_t pin;
+    const index_set_t *set = index_set_pin(tree, &pin);
+    int rc = crud_upsert(txn, tree, set, key, key_len, value, value_len, error);
+    index_set_unpin(&pin);
+    metrics_end(tree->db, tree, WTREE3_METRIC_UPSERT, t0, key_len + value_len);
+    durability_write(tree->db, key_len + value_len);
+    return rc;
+}
+
+WTREE_HOT WTREE_WARN_UNUSED
+int wtree3_delete_one_txn(wtree3_txn_t *txn, wtree3_tree_t *tree,
+                           const void *key, size_t key_len,
+                           bool *deleted,
+                           gerror_t *error) {
+    if (WTREE_UNLIKELY(!crud_check_write(txn, tree, key, NULL, false, error))) return WTREE3_EINVAL;
+
+    if (deleted) *deleted = false;
+
+    uint64_t t0 = metrics_begin(tree->db);
+    index_pin_t pin;
+    const index_set_t *set = index_set_pin(tree, &pin);
+    int rc = crud_delete(txn, tree, set, key, key_len, deleted, error);
+    index_set_unpin(&pin);
+    metrics_end(tree->db, tree, WTREE3_METRIC_DELETE, t0, key_len);
+    durability_write(tree->db, key_len);
+    return rc;
 }
 
 WTREE_HOT
@@ -306,7 +892,7 @@ bool wtree3_exists_txn(wtree3_txn_t *txn, wtree3_tree_t *tree,
 
     MDB_val mkey = {.mv_size = key_len, .mv_data = (void*)key};
     MDB_val mval;
-    return mdb_get(txn->txn, tree->dbi, &mkey, &mval) == 0;
+    return main_get(txn->txn, tree, &mkey, &mval) == 0;
 }
 
 int wtree3_insert_many_txn(wtree3_txn_t *txn, wtree3_tree_t *tree,
@@ -353,6 +939,190 @@ int wtree3_upsert_many_txn(wtree3_txn_t *txn, wtree3_tree_t *tree,
     return WTREE3_OK;
 }
 
+/* ============================================================
+ * Reserved Writes
+ *
+ * reserve_txn inserts the key with an MDB_RESERVE value through a cursor
+ * and hands the caller the uninitialized bytes; commit_reserved then runs
+ * what crud_insert_at runs before its put (indexes) and after it (filter,
+ * change log) over the bytes the caller wrote. The cursor stays open in
+ * between and finds the entry again without a lookup.
+ *
+ * The value itself is only read before the first write to another DBI.
+ * Any later put may spill dirty pages to make room, and an open cursor
+ * keeps only its own page stack from being spilled, not the value's
+ * overflow pages. Without MDB_WRITEMAP a spilled page's memory is freed,
+ * which would leave the value pointer dangling. Large values, the ones
+ * worth reserving, always live on overflow pages. So commit_reserved
+ * copies out the index entries, the key, and the change log payload
+ * first, and writes from the copies.
+ * ============================================================ */
+
+/* One index entry of the reserved row, copied out of the map */
+typedef struct {
+    wtree3_index_t *idx;
+    index_entry_t entry;
+} reserved_entry_t;
+
+/* Extract the row's index entries (count of them in *n) before any index write */
+static int reserved_collect(wtree3_tree_t *tree, const index_set_t *set, MDB_txn *txn,
+                            const MDB_val *key, const MDB_val *value,
+                            reserved_entry_t *out, size_t *n, gerror_t *error) {
+    for (size_t i = 0; i < set->count; i++) {
+        wtree3_index_t *idx = set->items[i];
+        if (WTREE_UNLIKELY(!index_covers_key(txn, tree, idx, key->mv_data, key->mv_size))) continue;
+
+        index_key_t idx_key;
+        bool should_index = crud_extract(tree->db, idx, value->mv_data, value->mv_size, &idx_key);
+        if (WTREE_LIKELY(!should_index)) continue;
+        if (WTREE_UNLIKELY(!idx_key.data)) {
+            index_key_release(&idx_key);
+            set_error(error, WTREE3_LIB, WTREE3_ERROR,
+                     "Index key extraction failed for '%s'", idx->name);
+            return WTREE3_ERROR;
+        }
+
+        int rc = index_entry_fill(idx, &idx_key, key, value->mv_data, value->mv_size,
+                                  &out[*n].entry, error);
+        if (WTREE_UNLIKELY(rc != 0)) return rc;
+        out[(*n)++].idx = idx;
+    }
+    return WTREE3_OK;
+}
+
+/* indexes_insert over collected entries: unique probes, then the puts */
+static int reserved_write(wtree3_tree_t *tree, MDB_txn *txn,
+                          const reserved_entry_t *entries, size_t n, gerror_t *error) {
+    for (size_t i = 0; i < n; i++) {
+        wtree3_index_t *idx = entries[i].idx;
+        MDB_val mk = entries[i].entry.key;
+        MDB_val dup = entries[i].entry.main_key;
+
+        if (WTREE_UNLIKELY(idx->unique && crud_unique_taken(tree->db, txn, idx, &mk))) {
+            set_error(error, WTREE3_LIB, WTREE3_INDEX_ERROR,
+                     "Duplicate key for unique index '%s'", idx->name);
+            return WTREE3_INDEX_ERROR;
+        }
+
+        int rc = mdb_put(txn, idx->dbi, &mk, &dup, MDB_NODUPDATA);
+        if (WTREE_UNLIKELY(rc != 0 && rc != MDB_KEYEXIST)) return translate_mdb_error(rc, error);
+        if (rc == 0) {
+            metrics_count(tree->db, idx, WTREE3_METRIC_INSERT);
+            filter_note_add(idx->filter, mk.mv_data, mk.mv_size);
+        }
+    }
+    return WTREE3_OK;
+}
+
+WTREE_HOT WTREE_WARN_UNUSED
+int wtree3_reserve_txn(wtree3_txn_t *txn, wtree3_tree_t *tree,
+                       const void *key, size_t key_len,
+                       size_t value_len, void **out_ptr,
+                       gerror_t *error) {
+    if (WTREE_UNLIKELY(!out_ptr)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+    *out_ptr = NULL;
+    if (WTREE_UNLIKELY(!crud_check_write(txn, tree, key, NULL, false, error))) return WTREE3_EINVAL;
+
+    if (WTREE_UNLIKELY(tree->codec || (tree->flags & MDB_DUPSORT))) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                 "Reservations need a tree without value codec or MDB_DUPSORT");
+        return WTREE3_EINVAL;
+    }
+
+    index_pin_t pin;
+    bool key_ok = tree_key_len_ok(tree, index_set_pin(tree, &pin), key_len);
+    index_set_unpin(&pin);
+    if (WTREE_UNLIKELY(!key_ok)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                 "Key of %zu bytes does not fit the tree's fixed key width", key_len);
+        return WTREE3_EINVAL;
+    }
+
+    MDB_cursor *cursor;
+    int rc = mdb_cursor_open(txn->txn, tree->dbi, &cursor);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+
+    MDB_val mkey = {.mv_size = key_len, .mv_data = (void*)key};
+    MDB_val mval = {.mv_size = value_len, .mv_data = NULL};
+    rc = mdb_cursor_put(cursor, &mkey, &mval, MDB_NOOVERWRITE | MDB_RESERVE);
+    if (WTREE_UNLIKELY(rc != 0)) {
+        mdb_cursor_close(cursor);
+        return translate_mdb_error(rc, error);
+    }
+
+    txn->reserved.tree = tree;
+    txn->reserved.cursor = cursor;
+    *out_ptr = mval.mv_data;
+    return WTREE3_OK;
+}
+
+WTREE_HOT WTREE_WARN_UNUSED
+int wtree3_commit_reserved(wtree3_txn_t *txn, gerror_t *error) {
+    if (WTREE_UNLIKELY(!txn || !txn->reserved.cursor)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "No pending reservation");
+        return WTREE3_EINVAL;
+    }
+
+    wtree3_tree_t *tree = txn->reserved.tree;
+    MDB_cursor *cursor = txn->reserved.cursor;
+    txn->reserved.tree = NULL;
+    txn->reserved.cursor = NULL;
+
+    uint64_t t0 = metrics_begin(tree->db);
+    MDB_val mkey, mval;
+    int rc = mdb_cursor_get(cursor, &mkey, &mval, MDB_GET_CURRENT);
+    if (WTREE_UNLIKELY(rc != 0)) {
+        mdb_cursor_close(cursor);
+        return translate_mdb_error(rc, error);
+    }
+
+    index_pin_t pin;
+    const index_set_t *set = index_set_pin(tree, &pin);
+    reserved_entry_t *entries = NULL;
+    size_t n = 0;
+
+    /* Copy out everything the writes to other DBIs need (see above) */
+    if (set->count > 0 || tree->changelog) {
+        size_t payload = tree->changelog ? mval.mv_size : 0;
+        entries = malloc(set->count * sizeof(reserved_entry_t) + mkey.mv_size + payload);
+        if (WTREE_UNLIKELY(!entries)) {
+            set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate reserved entry copy");
+            rc = WTREE3_ENOMEM;
+        } else {
+            unsigned char *copy = (unsigned char *)(entries + set->count);
+            memcpy(copy, mkey.mv_data, mkey.mv_size);
+            if (payload) memcpy(copy + mkey.mv_size, mval.mv_data, payload);
+            mkey.mv_data = copy;
+
+            uint64_t ti = metrics_begin(tree->db);
+            rc = reserved_collect(tree, set, txn->txn, &mkey, &mval, entries, &n, error);
+            if (payload) mval.mv_data = copy + mkey.mv_size;
+            if (rc == 0) rc = reserved_write(tree, txn->txn, entries, n, error);
+            if (set->count > 0) metrics_end(tree->db, tree, WTREE3_METRIC_INDEX_MAINT, ti, 0);
+        }
+    }
+    index_set_unpin(&pin);
+
+    if (WTREE_LIKELY(rc == 0)) {
+        filter_note_add(tree->filter, mkey.mv_data, mkey.mv_size);
+        rc = changelog_note(tree, txn->txn, WTREE3_CHANGE_INSERT, mkey.mv_data, mkey.mv_size,
+                            mval.mv_data, mval.mv_size, error);
+    } else {
+        /* Same outcome as a failed insert_one: the row is not there */
+        (void)mdb_cursor_del(cursor, 0);
+    }
+    mdb_cursor_close(cursor);
+    for (size_t i = 0; i < n; i++) free(entries[i].entry.key.mv_data);
+    free(entries);
+
+    metrics_end(tree->db, tree, WTREE3_METRIC_INSERT, t0, mkey.mv_size + mval.mv_size);
+    durability_write(tree->db, mkey.mv_size + mval.mv_size);
+    return rc;
+}
+
 /* ============================================================
  * Data Operations (Auto-transaction)
 /* ============================================================
@@ -368,7 +1138,7 @@ int wtree3_get(wtree3_tree_t *tree,
         return WTREE3_EINVAL;
     }
 
-    wtree3_txn_t *txn = wtree3_txn_begin(tree->db, false, error);
+    wtree3_txn_t *txn = read_pool_acquire(tree->db, error);
     if (!txn) return WTREE3_ERROR;
 
     const void *tmp;
@@ -378,7 +1148,7 @@ int wtree3_get(wtree3_tree_t *tree,
     if (rc == 0) {
         *value = malloc(tmp_len);
         if (!*value) {
-            wtree3_txn_abort(txn);
+            read_pool_release(txn);
             set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate value");
             return WTREE3_ENOMEM;
         }
@@ -386,7 +1156,7 @@ int wtree3_get(wtree3_tree_t *tree,
         *value_len = tmp_len;
     }
 
-    wtree3_txn_abort(txn);
+    read_pool_release(txn);
     return rc;
 }
 
@@ -399,6 +1169,11 @@ int wtree3_insert_one(wtree3_tree_t *tree,
         return WTREE3_EINVAL;
     }
 
+    if (tree->db->group_commit) {
+        return group_commit_submit(tree->db->group_commit, GROUP_COMMIT_INSERT, tree,
+                                   key, key_len, value, value_len, NULL, error);
+    }
+
     wtree3_txn_t *txn = wtree3_txn_begin(tree->db, true, error);
     if (!txn) return WTREE3_ERROR;
 
@@ -422,6 +1197,11 @@ int wtree3_update(wtree3_tree_t *tree,
         return WTREE3_EINVAL;
     }
 
+    if (tree->db->group_commit) {
+        return group_commit_submit(tree->db->group_commit, GROUP_COMMIT_UPDATE, tree,
+                                   key, key_len, value, value_len, NULL, error);
+    }
+
     wtree3_txn_t *txn = wtree3_txn_begin(tree->db, true, error);
     if (!txn) return WTREE3_ERROR;
 
@@ -445,6 +1225,13 @@ int wtree3_upsert(wtree3_tree_t *tree,
         return WTREE3_EINVAL;
     }
 
+    if (tree->combine) return combine_add(tree, key, key_len, value, value_len, error);
+
+    if (tree->db->group_commit) {
+        return group_commit_submit(tree->db->group_commit, GROUP_COMMIT_UPSERT, tree,
+                                   key, key_len, value, value_len, NULL, error);
+    }
+
     wtree3_txn_t *txn = wtree3_txn_begin(tree->db, true, error);
     if (!txn) return WTREE3_ERROR;
 
@@ -468,6 +1255,11 @@ int wtree3_delete_one(wtree3_tree_t *tree,
         return WTREE3_EINVAL;
     }
 
+    if (tree->db->group_commit) {
+        return group_commit_submit(tree->db->group_commit, GROUP_COMMIT_DELETE, tree,
+                                   key, key_len, NULL, 0, deleted, error);
+    }
+
     wtree3_txn_t *txn = wtree3_txn_begin(tree->db, true, error);
     if (!txn) return WTREE3_ERROR;
 
@@ -487,10 +1279,10 @@ bool wtree3_exists(wtree3_tree_t *tree,
                    gerror_t *error) {
     if (!tree || !key) return false;
 
-    wtree3_txn_t *txn = wtree3_txn_begin(tree->db, false, error);
+    wtree3_txn_t *txn = read_pool_acquire(tree->db, error);
     if (!txn) return false;
 
     bool exists = wtree3_exists_txn(txn, tree, key, key_len, error);
-    wtree3_txn_abort(txn);
+    read_pool_release(txn);
     return exists;
 }
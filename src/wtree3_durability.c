@@ -0,0 +1,312 @@
+/*
+ * wtree3_durability.c - Deferred Durability
+ *
+ * With deferred sync enabled the environment runs with MDB_NOSYNC: a
+ * commit writes its pages and the new meta page but does not fsync. A
+ * flusher thread owned by the database calls mdb_env_sync() once per
+ * interval, or sooner when enough commits or written bytes have piled up,
+ * so many commits share one fsync.
+ *
+ * A durability ticket is the LMDB txn id of a commit. Before every sync
+ * the flusher reads the last committed txn id; once the sync returns,
+ * every commit up to that id is on disk. Callers that need durability
+ * (wtree3_txn_commit_durable, wtree3_db_wait_durable) wait until the
+ * synced id reaches their ticket; everyone else just commits.
+ *
+ * Written bytes are those passed to the CRUD write calls (aborted writes
+ * included), an estimate that only decides when to sync early.
+ *
+ * This module provides:
+ * - Configuration: enable_deferred_sync, disable_deferred_sync
+ * - Durability points: txn_commit_durable, db_wait_durable
+ * - Internal hooks: durability_note_write, durability_note_commit,
+ *   durability_destroy
+ */
+
+#include "wtree3_internal.h"
+#include "macros.h"
+
+/* ============================================================
+ * Constants
+ * ============================================================ */
+
+#define DURABILITY_DEFAULT_INTERVAL_US 10000   /* 10 ms */
+
+/* ============================================================
+ * Internal Structures
+ * ============================================================ */
+
+struct wtree3_durability {
+    wtree3_db_t *db;
+    wmutex_t lock;
+    wcond_t wake_cond;              /* Flusher waits here for the next sync */
+    wcond_t synced_cond;            /* Ticket holders wait here */
+    wthread_t thread;
+
+    uint32_t interval_us;
+    uint64_t max_bytes;             /* 0 = no limit */
+    uint64_t max_commits;           /* 0 = no limit */
+
+    uint64_t pending_bytes;         /* Since the last sync (relaxed) */
+    uint64_t pending_commits;       /* Since the last sync (relaxed) */
+    uint64_t synced_txnid;          /* Every commit up to here is on disk */
+    uint64_t syncs;                 /* Sync attempts so far */
+    int sync_rc;                    /* MDB code of the last sync (0 = ok) */
+    bool restore_sync;              /* Clear MDB_NOSYNC again when disabled */
+    bool stop;
+};
+
+/* ============================================================
+ * Flusher
+ * ============================================================ */
+
+static uint64_t last_txnid(wtree3_db_t *db) {
+    MDB_envinfo info;
+    if (mdb_env_info(db->env, &info) != 0) return 0;
+    return (uint64_t)info.me_last_txnid;
+}
+
+static bool threshold_hit(const wtree3_durability_t *d) {
+    return (d->max_commits && watomic_load_u64(&d->pending_commits) >= d->max_commits) ||
+           (d->max_bytes && watomic_load_u64(&d->pending_bytes) >= d->max_bytes);
+}
+
+/* Sync everything committed so far (called and returns with d->lock held) */
+static void flush_locked(wtree3_durability_t *d) {
+    uint64_t target = last_txnid(d->db);
+    if (target <= d->synced_txnid) return;
+
+    watomic_store_u64(&d->pending_bytes, 0);
+    watomic_store_u64(&d->pending_commits, 0);
+
+    wmutex_unlock(&d->lock);
+    uint64_t t0 = metrics_begin(d->db);
+    int rc = mdb_env_sync(d->db->env, 1);
+    metrics_end(d->db, NULL, WTREE3_METRIC_SYNC, t0, 0);
+    wmutex_lock(&d->lock);
+
+    d->syncs++;
+    d->sync_rc = rc;
+    if (rc == 0 && target > d->synced_txnid) d->synced_txnid = target;
+    wcond_broadcast(&d->synced_cond);
+}
+
+static void *flusher_main(void *arg) {
+    wtree3_durability_t *d = (wtree3_durability_t *)arg;
+
+    wmutex_lock(&d->lock);
+    uint64_t next = wtime_now_us() + d->interval_us;
+    while (!d->stop) {
+        uint64_t now = wtime_now_us();
+        if (now < next && !threshold_hit(d)) {
+            wcond_timedwait(&d->wake_cond, &d->lock, next - now);
+            continue;
+        }
+        flush_locked(d);
+        next = wtime_now_us() + d->interval_us;
+    }
+
+    /* Final sync so disabling (or closing) leaves nothing behind */
+    flush_locked(d);
+    wmutex_unlock(&d->lock);
+    return NULL;
+}
+
+/* Wait until ticket is on disk (d->lock held) */
+static int wait_ticket_locked(wtree3_durability_t *d, uint64_t ticket, gerror_t *error) {
+    /* No nudge: tickets ride the next scheduled sync, that is the point */
+    uint64_t start = d->syncs;
+    while (d->synced_txnid < ticket) {
+        if (d->syncs != start && d->sync_rc != 0) return translate_mdb_error(d->sync_rc, error);
+        wcond_wait(&d->synced_cond, &d->lock);
+    }
+    return WTREE3_OK;
+}
+
+/* Without a flusher: durable unless the env was opened with MDB_NOSYNC */
+static int sync_now(wtree3_db_t *db, gerror_t *error) {
+    unsigned int env_flags = 0;
+    mdb_env_get_flags(db->env, &env_flags);
+    if (!(env_flags & (MDB_NOSYNC | MDB_NOMETASYNC | MDB_MAPASYNC))) return WTREE3_OK;
+    return wtree3_db_sync(db, true, error);
+}
+
+/* ============================================================
+ * Internal Hooks
+ * ============================================================ */
+
+WTREE_COLD
+void durability_note_write(wtree3_durability_t *d, size_t bytes) {
+    watomic_add_u64(&d->pending_bytes, bytes);
+}
+
+WTREE_COLD
+void durability_note_commit(wtree3_durability_t *d) {
+    watomic_add_u64(&d->pending_commits, 1);
+    if (threshold_hit(d)) {
+        wmutex_lock(&d->lock);
+        wcond_signal(&d->wake_cond);
+        wmutex_unlock(&d->lock);
+    }
+}
+
+WTREE_COLD
+void durability_destroy(wtree3_durability_t *d) {
+    if (!d) return;
+
+    wmutex_lock(&d->lock);
+    d->stop = true;
+    wcond_signal(&d->wake_cond);
+    wmutex_unlock(&d->lock);
+    wthread_join(d->thread, NULL);
+
+    if (d->restore_sync) mdb_env_set_flags(d->db->env, MDB_NOSYNC, 0);
+
+    wcond_destroy(&d->synced_cond);
+    wcond_destroy(&d->wake_cond);
+    wmutex_destroy(&d->lock);
+    free(d);
+}
+
+/* ============================================================
+ * Configuration
+ * ============================================================ */
+
+WTREE_COLD WTREE_WARN_UNUSED
+int wtree3_db_enable_deferred_sync(wtree3_db_t *db,
+                                   const wtree3_durability_config_t *config,
+                                   gerror_t *error) {
+    if (WTREE_UNLIKELY(!db)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Database cannot be NULL");
+        return WTREE3_EINVAL;
+    }
+    if (WTREE_UNLIKELY(db->flags & MDB_RDONLY)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Deferred sync requires a writable environment");
+        return WTREE3_EINVAL;
+    }
+
+    uint32_t interval_us = config && config->interval_us ? config->interval_us
+                                                         : DURABILITY_DEFAULT_INTERVAL_US;
+    uint64_t max_bytes = config ? config->max_bytes : 0;
+    uint64_t max_commits = config ? config->max_commits : 0;
+
+    /* Already enabled: just retune */
+    if (db->durability) {
+        wtree3_durability_t *d = db->durability;
+        wmutex_lock(&d->lock);
+        d->interval_us = interval_us;
+        d->max_bytes = max_bytes;
+        d->max_commits = max_commits;
+        wcond_signal(&d->wake_cond);
+        wmutex_unlock(&d->lock);
+        return WTREE3_OK;
+    }
+
+    wtree3_durability_t *d = calloc(1, sizeof(wtree3_durability_t));
+    if (WTREE_UNLIKELY(!d)) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate deferred-sync state");
+        return WTREE3_ENOMEM;
+    }
+
+    if (WTREE_UNLIKELY(wmutex_init(&d->lock) != 0)) {
+        free(d);
+        set_error(error, WTREE3_LIB, WTREE3_ERROR, "Failed to initialize deferred-sync lock");
+        return WTREE3_ERROR;
+    }
+    if (WTREE_UNLIKELY(wcond_init(&d->wake_cond) != 0)) {
+        wmutex_destroy(&d->lock);
+        free(d);
+        set_error(error, WTREE3_LIB, WTREE3_ERROR, "Failed to initialize deferred-sync condition");
+        return WTREE3_ERROR;
+    }
+    if (WTREE_UNLIKELY(wcond_init(&d->synced_cond) != 0)) {
+        wcond_destroy(&d->wake_cond);
+        wmutex_destroy(&d->lock);
+        free(d);
+        set_error(error, WTREE3_LIB, WTREE3_ERROR, "Failed to initialize deferred-sync condition");
+        return WTREE3_ERROR;
+    }
+
+    d->db = db;
+    d->interval_us = interval_us;
+    d->max_bytes = max_bytes;
+    d->max_commits = max_commits;
+
+    /* Everything committed before now was synced by its own commit */
+    unsigned int env_flags = 0;
+    mdb_env_get_flags(db->env, &env_flags);
+    d->restore_sync = !(env_flags & MDB_NOSYNC);
+    d->synced_txnid = d->restore_sync ? last_txnid(db) : 0;
+
+    int rc = d->restore_sync ? mdb_env_set_flags(db->env, MDB_NOSYNC, 1) : 0;
+    if (WTREE_UNLIKELY(rc != 0)) {
+        wcond_destroy(&d->synced_cond);
+        wcond_destroy(&d->wake_cond);
+        wmutex_destroy(&d->lock);
+        free(d);
+        return translate_mdb_error(rc, error);
+    }
+
+    if (WTREE_UNLIKELY(wthread_create(&d->thread, flusher_main, d) != 0)) {
+        if (d->restore_sync) mdb_env_set_flags(db->env, MDB_NOSYNC, 0);
+        wcond_destroy(&d->synced_cond);
+        wcond_destroy(&d->wake_cond);
+        wmutex_destroy(&d->lock);
+        free(d);
+        set_error(error, WTREE3_LIB, WTREE3_ERROR, "Failed to start flusher thread");
+        return WTREE3_ERROR;
+    }
+
+    db->durability = d;
+    return WTREE3_OK;
+}
+
+WTREE_COLD
+void wtree3_db_disable_deferred_sync(wtree3_db_t *db) {
+    if (!db || !db->durability) return;
+
+    wtree3_durability_t *d = db->durability;
+    db->durability = NULL;
+    durability_destroy(d);
+}
+
+/* ============================================================
+ * Durability Points
+ * ============================================================ */
+
+WTREE_WARN_UNUSED
+int wtree3_txn_commit_durable(wtree3_txn_t *txn, gerror_t *error) {
+    if (WTREE_UNLIKELY(!txn)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Transaction cannot be NULL");
+        return WTREE3_EINVAL;
+    }
+
+    wtree3_db_t *db = txn->db;
+    uint64_t ticket = txn->is_write ? (uint64_t)mdb_txn_id(txn->txn) : 0;
+    int rc = wtree3_txn_commit(txn, error);
+    if (rc != WTREE3_OK || ticket == 0) return rc;
+
+    wtree3_durability_t *d = db->durability;
+    if (!d) return sync_now(db, error);
+
+    wmutex_lock(&d->lock);
+    rc = wait_ticket_locked(d, ticket, error);
+    wmutex_unlock(&d->lock);
+    return rc;
+}
+
+WTREE_WARN_UNUSED
+int wtree3_db_wait_durable(wtree3_db_t *db, gerror_t *error) {
+    if (WTREE_UNLIKELY(!db)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Database cannot be NULL");
+        return WTREE3_EINVAL;
+    }
+
+    wtree3_durability_t *d = db->durability;
+    if (!d) return sync_now(db, error);
+
+    wmutex_lock(&d->lock);
+    int rc = wait_ticket_locked(d, last_txnid(db), error);
+    wmutex_unlock(&d->lock);
+    return rc;
+}
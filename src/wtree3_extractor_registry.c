@@ -1,9 +1,11 @@
 /*
  * wtree3_extractor_registry.c - Key extractor function registry implementation
+ *
+ * Entries live in a hash table keyed by extractor ID.
  */
 
 #include "wtree3_extractor_registry.h"
-#include "wvector.h"
+#include "whash.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -13,11 +15,12 @@
 
 typedef struct {
     uint64_t extractor_id;
-    wtree3_index_key_fn key_fn;
+    wtree3_index_key_fn key_fn;             /* Allocating extractor (or NULL) */
+    wtree3_index_key_into_fn key_into_fn;   /* Scratch-buffer extractor (or NULL) */
 } extractor_entry_t;
 
 struct wtree3_extractor_registry {
-    wvector_t *entries;  /* Vector of extractor_entry_t* */
+    whash_t *entries;  /* extractor_entry_t* by extractor_id */
 };
 
 /* ============================================================
@@ -28,12 +31,14 @@ static void cleanup_entry(void *element) {
     free(element);
 }
 
-static int compare_entry_by_id(const void *entry_ptr, const void *id_ptr) {
+static bool entry_has_id(const void *entry_ptr, const void *id_ptr) {
     const extractor_entry_t *entry = (const extractor_entry_t *)entry_ptr;
-    const uint64_t *id = (const uint64_t *)id_ptr;
+    return entry->extractor_id == *(const uint64_t *)id_ptr;
+}
 
-    if (entry->extractor_id == *id) return 0;
-    return (entry->extractor_id < *id) ? -1 : 1;
+static extractor_entry_t *find_entry(const wtree3_extractor_registry_t *registry,
+                                     uint64_t extractor_id) {
+    return whash_get(registry->entries, whash_u64(extractor_id), &extractor_id, entry_has_id);
 }
 
 /* ============================================================
@@ -44,7 +49,7 @@ wtree3_extractor_registry_t* wtree3_extractor_registry_create(void) {
     wtree3_extractor_registry_t *registry = malloc(sizeof(wtree3_extractor_registry_t));
     if (!registry) return NULL;
 
-    registry->entries = wvector_create(8, cleanup_entry);
+    registry->entries = whash_create(8, cleanup_entry);
     if (!registry->entries) {
         free(registry);
         return NULL;
@@ -56,7 +61,7 @@ wtree3_extractor_registry_t* wtree3_extractor_registry_create(void) {
 void wtree3_extractor_registry_destroy(wtree3_extractor_registry_t *registry) {
     if (!registry) return;
 
-    wvector_destroy(registry->entries);
+    whash_destroy(registry->entries);
     free(registry);
 }
 
@@ -64,12 +69,9 @@ void wtree3_extractor_registry_destroy(wtree3_extractor_registry_t *registry) {
  * Operations
  * ============================================================ */
 
-bool wtree3_extractor_registry_set(wtree3_extractor_registry_t *registry,
-                                     uint64_t extractor_id,
-                                     wtree3_index_key_fn key_fn) {
-    if (!registry || !key_fn) return false;
-
-    /* Check if already registered */
+static bool registry_add(wtree3_extractor_registry_t *registry, uint64_t extractor_id,
+                         wtree3_index_key_fn key_fn, wtree3_index_key_into_fn key_into_fn) {
+    /* Check if already registered (either kind) */
     if (wtree3_extractor_registry_has(registry, extractor_id)) {
         return false;  /* Don't allow overwriting */
     }
@@ -80,9 +82,10 @@ bool wtree3_extractor_registry_set(wtree3_extractor_registry_t *registry,
 
     entry->extractor_id = extractor_id;
     entry->key_fn = key_fn;
+    entry->key_into_fn = key_into_fn;
 
-    /* Add to vector */
-    if (!wvector_push(registry->entries, entry)) {
+    /* Add to table */
+    if (!whash_put(registry->entries, whash_u64(extractor_id), entry)) {
         free(entry);
         return false;
     }
@@ -90,23 +93,47 @@ bool wtree3_extractor_registry_set(wtree3_extractor_registry_t *registry,
     return true;
 }
 
+bool wtree3_extractor_registry_set(wtree3_extractor_registry_t *registry,
+                                     uint64_t extractor_id,
+                                     wtree3_index_key_fn key_fn) {
+    if (!registry || !key_fn) return false;
+
+    return registry_add(registry, extractor_id, key_fn, NULL);
+}
+
+bool wtree3_extractor_registry_set_into(wtree3_extractor_registry_t *registry,
+                                          uint64_t extractor_id,
+                                          wtree3_index_key_into_fn key_fn) {
+    if (!registry || !key_fn) return false;
+
+    return registry_add(registry, extractor_id, NULL, key_fn);
+}
+
 wtree3_index_key_fn wtree3_extractor_registry_get(const wtree3_extractor_registry_t *registry,
                                                     uint64_t extractor_id) {
     if (!registry) return NULL;
 
-    extractor_entry_t *entry = wvector_find(registry->entries, &extractor_id, compare_entry_by_id);
+    extractor_entry_t *entry = find_entry(registry, extractor_id);
     return entry ? entry->key_fn : NULL;
 }
 
+wtree3_index_key_into_fn wtree3_extractor_registry_get_into(const wtree3_extractor_registry_t *registry,
+                                                              uint64_t extractor_id) {
+    if (!registry) return NULL;
+
+    extractor_entry_t *entry = find_entry(registry, extractor_id);
+    return entry ? entry->key_into_fn : NULL;
+}
+
 bool wtree3_extractor_registry_has(const wtree3_extractor_registry_t *registry,
                                      uint64_t extractor_id) {
     if (!registry) return false;
 
-    return wvector_find(registry->entries, &extractor_id, compare_entry_by_id) != NULL;
+    return find_entry(registry, extractor_id) != NULL;
 }
 
 size_t wtree3_extractor_registry_count(const wtree3_extractor_registry_t *registry) {
     if (!registry) return 0;
 
-    return wvector_size(registry->entries);
+    return whash_size(registry->entries);
 }
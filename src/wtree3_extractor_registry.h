@@ -56,16 +56,42 @@ bool wtree3_extractor_registry_set(wtree3_extractor_registry_t *registry,
                                      uint64_t extractor_id,
                                      wtree3_index_key_fn key_fn);
 
+/**
+ * Register an allocation-free key extractor function for a given ID
+ *
+ * Shares the ID space with wtree3_extractor_registry_set().
+ *
+ * @param registry Registry
+ * @param extractor_id Extractor ID (version + flags combination)
+ * @param key_fn Scratch-buffer key extraction function
+ * @return true on success, false on allocation failure or if ID already registered
+ */
+bool wtree3_extractor_registry_set_into(wtree3_extractor_registry_t *registry,
+                                          uint64_t extractor_id,
+                                          wtree3_index_key_into_fn key_fn);
+
 /**
  * Lookup key extractor function by ID
  *
  * @param registry Registry
  * @param extractor_id Extractor ID to look up
- * @return Key extraction function or NULL if not found
+ * @return Key extraction function or NULL if not found (or registered as
+ *         an allocation-free extractor)
  */
 wtree3_index_key_fn wtree3_extractor_registry_get(const wtree3_extractor_registry_t *registry,
                                                     uint64_t extractor_id);
 
+/**
+ * Lookup allocation-free key extractor function by ID
+ *
+ * @param registry Registry
+ * @param extractor_id Extractor ID to look up
+ * @return Scratch-buffer extraction function or NULL if not found (or
+ *         registered as an allocating extractor)
+ */
+wtree3_index_key_into_fn wtree3_extractor_registry_get_into(const wtree3_extractor_registry_t *registry,
+                                                              uint64_t extractor_id);
+
 /**
  * Check if an extractor ID is registered
  *
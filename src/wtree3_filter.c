@@ -0,0 +1,540 @@
+/*
+ * wtree3_filter.c - In-Memory Membership Filters
+ *
+ * Optional blocked Bloom filters over the main tree's keys or a unique
+ * index's keys. When a filter rules a key out, a negative lookup (get or
+ * exists of a missing key, the existence check of update/delete, a
+ * unique-index probe) is answered without descending the B-tree. Each
+ * key maps to one 512-bit block, i.e. one cache line, and sets `probes`
+ * bits inside it.
+ *
+ * Writers add keys before they commit and never clear bits, so a filter
+ * can only go stale towards "maybe": aborted inserts and deleted keys
+ * cost false positives, never false negatives. This is also why deletes
+ * are not subtracted. A counting filter decremented by a txn that later
+ * aborts would drop a live key. Deletes are counted instead, and
+ * wtree3_tree_rebuild_filter() starts over from the live keys once the
+ * stats advise it.
+ *
+ * A filter is built inside a write txn, so no writer can commit a key it
+ * misses. It only answers txns whose snapshot is at least as new as the
+ * build txn, because older readers may still see keys deleted before it.
+ *
+ * Only the configuration is persisted, under "\x01filter:<tree>:<index>"
+ * (empty index name for the main tree). wtree3_tree_open() rebuilds the
+ * bits from the data.
+ *
+ * This module provides:
+ * - wtree3_tree_enable_filter, wtree3_tree_rebuild_filter,
+ *   wtree3_tree_disable_filter, wtree3_tree_filter_stats
+ * - filter_may_contain, filter_add, filters_auto_load, filter_delete_txn
+ */
+
+#include "wtree3_internal.h"
+#include "macros.h"
+
+/* ============================================================
+ * Constants
+ * ============================================================ */
+
+#define FILTER_FORMAT           1
+#define FILTER_RECORD_SIZE      16      /* [format:4][bits_per_key:4][expected_keys:8] */
+#define FILTER_BLOCK_BITS       512
+#define FILTER_BLOCK_WORDS      (FILTER_BLOCK_BITS / 64)
+#define FILTER_DEFAULT_BITS     10
+#define FILTER_MAX_BITS         64
+#define FILTER_MIN_CAPACITY     1024
+#define FILTER_MAX_PROBES       16
+
+/* ============================================================
+ * Bit Array
+ * ============================================================ */
+
+static unsigned int popcount64(uint64_t v) {
+#if WTREE_GCC_LIKE
+    return (unsigned int)__builtin_popcountll(v);
+#else
+    v = v - ((v >> 1) & 0x5555555555555555ULL);
+    v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+    v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (unsigned int)((v * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+static uint64_t filter_hash(const void *key, size_t len) {
+    const uint8_t *p = (const uint8_t *)key;
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ ((uint64_t)len * 0xff51afd7ed558ccdULL);
+
+    while (len >= 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        h = (h ^ w) * 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 29;
+        p += 8;
+        len -= 8;
+    }
+    if (len) {
+        uint64_t w = 0;
+        memcpy(&w, p, len);
+        h = (h ^ w) * 0xc4ceb9fe1a85ec53ULL;
+    }
+
+    h ^= h >> 32;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 29;
+    return h;
+}
+
+/* High hash bits pick the block; each probe re-mixes for a 9-bit position */
+static inline uint64_t *filter_block(const wtree3_filter_t *f, uint64_t h) {
+    return f->words + (((h >> 32) * f->blocks) >> 32) * FILTER_BLOCK_WORDS;
+}
+
+static inline uint64_t filter_next_probe(uint64_t x) {
+    return x * 0x9e3779b97f4a7c15ULL + 0x632be59bd9b4e019ULL;
+}
+
+WTREE_HOT
+bool filter_may_contain(const wtree3_filter_t *f, const void *key, size_t key_len) {
+    uint64_t h = filter_hash(key, key_len);
+    const uint64_t *block = filter_block(f, h);
+
+    uint64_t x = h;
+    for (uint32_t i = 0; i < f->probes; i++) {
+        x = filter_next_probe(x);
+        unsigned int bit = (unsigned int)(x >> 55);
+        if (!(watomic_load_u64(&block[bit >> 6]) & ((uint64_t)1 << (bit & 63)))) return false;
+    }
+    return true;
+}
+
+/* Set a key's bits; readers may be probing the same words */
+static void filter_set(wtree3_filter_t *f, const void *key, size_t key_len) {
+    uint64_t h = filter_hash(key, key_len);
+    uint64_t *block = filter_block(f, h);
+
+    uint64_t x = h;
+    for (uint32_t i = 0; i < f->probes; i++) {
+        x = filter_next_probe(x);
+        unsigned int bit = (unsigned int)(x >> 55);
+        watomic_or_u64(&block[bit >> 6], (uint64_t)1 << (bit & 63));
+    }
+}
+
+WTREE_HOT
+void filter_add(wtree3_filter_t *f, const void *key, size_t key_len) {
+    filter_set(f, key, key_len);
+    watomic_add_u64(&f->added, 1);
+}
+
+void filter_free(wtree3_filter_t *f) {
+    if (!f) return;
+    free(f->words);
+    free(f);
+}
+
+/* Size for `keys` plus 50% headroom (at least expected_keys) */
+static wtree3_filter_t *filter_create(uint64_t keys, uint32_t bits_per_key, uint64_t expected_keys) {
+    wtree3_filter_t *f = calloc(1, sizeof(wtree3_filter_t));
+    if (WTREE_UNLIKELY(!f)) return NULL;
+
+    uint64_t capacity = keys + keys / 2;
+    if (capacity < expected_keys) capacity = expected_keys;
+    if (capacity < FILTER_MIN_CAPACITY) capacity = FILTER_MIN_CAPACITY;
+
+    /* k = bits_per_key * ln 2 minimizes false positives */
+    uint32_t probes = (bits_per_key * 69 + 50) / 100;
+    if (probes < 1) probes = 1;
+    if (probes > FILTER_MAX_PROBES) probes = FILTER_MAX_PROBES;
+
+    f->blocks = (capacity * bits_per_key + FILTER_BLOCK_BITS - 1) / FILTER_BLOCK_BITS;
+    f->words = calloc(f->blocks * FILTER_BLOCK_WORDS, sizeof(uint64_t));
+    if (WTREE_UNLIKELY(!f->words)) {
+        free(f);
+        return NULL;
+    }
+    f->probes = probes;
+    f->bits_per_key = bits_per_key;
+    f->expected_keys = expected_keys;
+    f->capacity = capacity;
+    return f;
+}
+
+/* ============================================================
+ * Config Records
+ * ============================================================ */
+
+/* Metadata "tree name" owning a tree's filter configs */
+static char *filter_owner(const char *tree_name) {
+    size_t len = strlen(WTREE3_FILTER_PREFIX) + strlen(tree_name) + 1;
+    char *owner = malloc(len);
+    if (WTREE_LIKELY(owner)) snprintf(owner, len, "%s%s", WTREE3_FILTER_PREFIX, tree_name);
+    return owner;
+}
+
+static int filter_store_txn(MDB_txn *txn, wtree3_tree_t *tree, const char *index_name,
+                            const wtree3_filter_t *f, gerror_t *error) {
+    char *owner = filter_owner(tree->name);
+    if (WTREE_UNLIKELY(!owner)) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to build filter key");
+        return WTREE3_ENOMEM;
+    }
+
+    uint8_t record[FILTER_RECORD_SIZE];
+    uint32_t format = FILTER_FORMAT;
+    memcpy(record, &format, 4);
+    memcpy(record + 4, &f->bits_per_key, 4);
+    memcpy(record + 8, &f->expected_keys, 8);
+
+    int rc = metadata_put_txn(txn, tree->db, owner, index_name ? index_name : "",
+                              record, sizeof(record), error);
+    free(owner);
+    return rc;
+}
+
+int filter_delete_txn(MDB_txn *txn, wtree3_db_t *db, const char *tree_name,
+                      const char *index_name) {
+    char *owner = filter_owner(tree_name);
+    if (WTREE_UNLIKELY(!owner)) return WTREE3_OK;  /* A stale config only costs a rebuild */
+    int rc = metadata_delete_txn(txn, db, owner, index_name ? index_name : "", NULL);
+    free(owner);
+    return rc;
+}
+
+/* ============================================================
+ * Build
+ * ============================================================ */
+
+typedef struct {
+    wtree3_tree_t *tree;
+    wtree3_index_t *idx;            /* NULL = main tree */
+    uint32_t bits_per_key;
+    uint64_t expected_keys;
+    bool persist;                   /* Also store the config record */
+    wtree3_filter_t *built;         /* Installed by filter_build_txn */
+    wtree3_filter_t *replaced;      /* Previous filter, freed after commit */
+    gerror_t *error;
+} filter_build_ctx_t;
+
+static wtree3_filter_t **filter_slot(wtree3_tree_t *tree, wtree3_index_t *idx) {
+    return idx ? &idx->filter : &tree->filter;
+}
+
+/*
+ * Fill and install under the writer lock: a writer committing between the
+ * scan and the install would otherwise add a key the filter never saw.
+ */
+static int filter_build_txn(MDB_txn *txn, void *user_data) {
+    filter_build_ctx_t *ctx = (filter_build_ctx_t *)user_data;
+    MDB_dbi dbi = ctx->idx ? ctx->idx->dbi : ctx->tree->dbi;
+
+    MDB_stat st;
+    int rc = mdb_stat(txn, dbi, &st);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, ctx->error);
+
+    wtree3_filter_t *f = filter_create(st.ms_entries, ctx->bits_per_key, ctx->expected_keys);
+    if (WTREE_UNLIKELY(!f)) {
+        set_error(ctx->error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate filter");
+        return WTREE3_ENOMEM;
+    }
+
+    MDB_cursor *cursor;
+    rc = mdb_cursor_open(txn, dbi, &cursor);
+    if (WTREE_UNLIKELY(rc != 0)) {
+        filter_free(f);
+        return translate_mdb_error(rc, ctx->error);
+    }
+
+    MDB_val key, val;
+    rc = mdb_cursor_get(cursor, &key, &val, MDB_FIRST);
+    while (rc == 0) {
+        filter_set(f, key.mv_data, key.mv_size);
+        f->built_keys++;
+        rc = mdb_cursor_get(cursor, &key, &val, MDB_NEXT_NODUP);
+    }
+    mdb_cursor_close(cursor);
+    if (WTREE_UNLIKELY(rc != MDB_NOTFOUND)) {
+        filter_free(f);
+        return translate_mdb_error(rc, ctx->error);
+    }
+
+    if (ctx->persist) {
+        rc = filter_store_txn(txn, ctx->tree, ctx->idx ? ctx->idx->name : NULL, f, ctx->error);
+        if (WTREE_UNLIKELY(rc != WTREE3_OK)) {
+            filter_free(f);
+            return rc;
+        }
+    }
+
+    f->since = mdb_txn_id(txn);
+    wtree3_filter_t **slot = filter_slot(ctx->tree, ctx->idx);
+    ctx->replaced = *slot;
+    ctx->built = f;
+    *slot = f;
+    return WTREE3_OK;
+}
+
+static int filter_build(wtree3_tree_t *tree, wtree3_index_t *idx,
+                        uint32_t bits_per_key, uint64_t expected_keys, bool persist,
+                        gerror_t *error) {
+    filter_build_ctx_t ctx = {
+        .tree = tree, .idx = idx,
+        .bits_per_key = bits_per_key, .expected_keys = expected_keys,
+        .persist = persist, .error = error
+    };
+
+    int rc = with_write_txn(tree->db, filter_build_txn, &ctx, error);
+    if (rc != WTREE3_OK) {
+        /* Commit failed after the install: put the old filter back */
+        if (ctx.built) {
+            *filter_slot(tree, idx) = ctx.replaced;
+            filter_free(ctx.built);
+        }
+        return rc;
+    }
+
+    filter_free(ctx.replaced);
+    return WTREE3_OK;
+}
+
+/*
+ * Resolve index_name (NULL = main tree) to an index allowed to carry a
+ * filter, found in a set the caller keeps pinned while it uses the index
+ */
+static int filter_target(const index_set_t *set, const char *index_name,
+                         wtree3_index_t **out, gerror_t *error) {
+    *out = NULL;
+    if (!index_name) return WTREE3_OK;
+
+    wtree3_index_t *idx = index_set_find(set, index_name);
+    if (!idx) {
+        set_error(error, WTREE3_LIB, WTREE3_NOT_FOUND, "Index '%s' not found", index_name);
+        return WTREE3_NOT_FOUND;
+    }
+    if (idx->building) {
+        set_error(error, WTREE3_LIB, WTREE3_NOT_FOUND,
+                 "Index '%s' is still being built", index_name);
+        return WTREE3_NOT_FOUND;
+    }
+    if (!idx->unique) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                 "Filters apply to unique indexes only ('%s' is not unique)", index_name);
+        return WTREE3_EINVAL;
+    }
+    *out = idx;
+    return WTREE3_OK;
+}
+
+/* Like filter_target, but the filter must already exist */
+static int filter_existing(wtree3_tree_t *tree, const index_set_t *set, const char *index_name,
+                           wtree3_index_t **idx, wtree3_filter_t **out, gerror_t *error) {
+    int rc = filter_target(set, index_name, idx, error);
+    if (rc != WTREE3_OK) return rc;
+
+    *out = *filter_slot(tree, *idx);
+    if (!*out) {
+        set_error(error, WTREE3_LIB, WTREE3_NOT_FOUND, "No filter enabled on '%s'",
+                 index_name ? index_name : tree->name);
+        return WTREE3_NOT_FOUND;
+    }
+    return WTREE3_OK;
+}
+
+/* ============================================================
+ * Auto-Load
+ * ============================================================ */
+
+typedef struct {
+    char *index_name;               /* "" = main tree */
+    uint32_t bits_per_key;
+    uint64_t expected_keys;
+} filter_config_t;
+
+/* Read the tree's filter configs; no metadata DB means none */
+static size_t filter_read_configs(wtree3_tree_t *tree, filter_config_t **out) {
+    *out = NULL;
+    char *owner = filter_owner(tree->name);
+    char *prefix = owner ? build_metadata_key(owner, "") : NULL;
+    free(owner);
+    if (!prefix) return 0;
+
+    gerror_t error = {.flags = GERROR_LAZY};   /* Discarded: never formatted */
+    wtree3_txn_t *txn = read_pool_acquire(tree->db, &error);
+    if (!txn) {
+        free(prefix);
+        return 0;
+    }
+
+    size_t prefix_len = strlen(prefix), count = 0;
+    MDB_dbi meta_dbi;
+    MDB_cursor *cursor;
+    if (mdb_dbi_open(txn->txn, WTREE3_META_DB, 0, &meta_dbi) == 0 &&
+        mdb_cursor_open(txn->txn, meta_dbi, &cursor) == 0) {
+        MDB_val key = {.mv_size = prefix_len, .mv_data = prefix}, val;
+        int rc = mdb_cursor_get(cursor, &key, &val, MDB_SET_RANGE);
+        while (rc == 0 && key.mv_size >= prefix_len && memcmp(key.mv_data, prefix, prefix_len) == 0) {
+            uint32_t format = 0;
+            if (val.mv_size >= FILTER_RECORD_SIZE) memcpy(&format, val.mv_data, 4);
+
+            filter_config_t *grown = format == FILTER_FORMAT
+                                   ? realloc(*out, (count + 1) * sizeof(filter_config_t)) : NULL;
+            if (grown) {
+                *out = grown;
+                filter_config_t *c = &grown[count];
+                c->index_name = malloc(key.mv_size - prefix_len + 1);
+                if (c->index_name) {
+                    memcpy(c->index_name, (char *)key.mv_data + prefix_len, key.mv_size - prefix_len);
+                    c->index_name[key.mv_size - prefix_len] = '\0';
+                    memcpy(&c->bits_per_key, (uint8_t *)val.mv_data + 4, 4);
+                    memcpy(&c->expected_keys, (uint8_t *)val.mv_data + 8, 8);
+                    count++;
+                }
+            }
+            rc = mdb_cursor_get(cursor, &key, &val, MDB_NEXT);
+        }
+        mdb_cursor_close(cursor);
+    }
+
+    read_pool_release(txn);
+    free(prefix);
+    return count;
+}
+
+WTREE_COLD
+void filters_auto_load(wtree3_tree_t *tree) {
+    filter_config_t *configs;
+    size_t count = filter_read_configs(tree, &configs);
+
+    for (size_t i = 0; i < count; i++) {
+        gerror_t error = {.flags = GERROR_LAZY};   /* Discarded: never formatted */
+        wtree3_index_t *idx = NULL;
+        const char *name = configs[i].index_name[0] ? configs[i].index_name : NULL;
+
+        /* Indexes whose extractor is missing were not loaded, skip their filter */
+        index_pin_t pin;
+        if (filter_target(index_set_pin(tree, &pin), name, &idx, &error) == WTREE3_OK) {
+            int rc = filter_build(tree, idx, configs[i].bits_per_key,
+                                  configs[i].expected_keys, false, &error);
+            (void)rc;  /* No filter just means no shortcut */
+        }
+        index_set_unpin(&pin);
+        free(configs[i].index_name);
+    }
+    free(configs);
+}
+
+/* ============================================================
+ * Public API
+ * ============================================================ */
+
+WTREE_COLD WTREE_WARN_UNUSED
+int wtree3_tree_enable_filter(wtree3_tree_t *tree, const char *index_name,
+                              const wtree3_filter_opts_t *opts, gerror_t *error) {
+    if (WTREE_UNLIKELY(!tree)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Tree cannot be NULL");
+        return WTREE3_EINVAL;
+    }
+
+    uint32_t bits_per_key = opts && opts->bits_per_key ? opts->bits_per_key : FILTER_DEFAULT_BITS;
+    if (bits_per_key > FILTER_MAX_BITS) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                 "bits_per_key must be at most %d", FILTER_MAX_BITS);
+        return WTREE3_EINVAL;
+    }
+
+    /* Pinned until the filter is installed: the index may not be dropped under it */
+    index_pin_t pin;
+    wtree3_index_t *idx;
+    int rc = filter_target(index_set_pin(tree, &pin), index_name, &idx, error);
+    if (rc == WTREE3_OK) {
+        rc = filter_build(tree, idx, bits_per_key, opts ? opts->expected_keys : 0, true, error);
+    }
+    index_set_unpin(&pin);
+    return rc;
+}
+
+WTREE_COLD WTREE_WARN_UNUSED
+int wtree3_tree_rebuild_filter(wtree3_tree_t *tree, const char *index_name, gerror_t *error) {
+    if (WTREE_UNLIKELY(!tree)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Tree cannot be NULL");
+        return WTREE3_EINVAL;
+    }
+
+    index_pin_t pin;
+    wtree3_index_t *idx;
+    wtree3_filter_t *f;
+    int rc = filter_existing(tree, index_set_pin(tree, &pin), index_name, &idx, &f, error);
+    if (rc == WTREE3_OK) rc = filter_build(tree, idx, f->bits_per_key, f->expected_keys, false, error);
+    index_set_unpin(&pin);
+    return rc;
+}
+
+typedef struct {
+    wtree3_tree_t *tree;
+    const char *index_name;
+} filter_drop_ctx_t;
+
+static int filter_drop_txn(MDB_txn *txn, void *user_data) {
+    filter_drop_ctx_t *ctx = (filter_drop_ctx_t *)user_data;
+    return filter_delete_txn(txn, ctx->tree->db, ctx->tree->name, ctx->index_name);
+}
+
+WTREE_COLD WTREE_WARN_UNUSED
+int wtree3_tree_disable_filter(wtree3_tree_t *tree, const char *index_name, gerror_t *error) {
+    if (WTREE_UNLIKELY(!tree)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Tree cannot be NULL");
+        return WTREE3_EINVAL;
+    }
+
+    index_pin_t pin;
+    wtree3_index_t *idx;
+    wtree3_filter_t *f;
+    int rc = filter_existing(tree, index_set_pin(tree, &pin), index_name, &idx, &f, error);
+    if (rc == WTREE3_OK) {
+        filter_drop_ctx_t ctx = {.tree = tree, .index_name = index_name};
+        rc = with_write_txn(tree->db, filter_drop_txn, &ctx, error);
+    }
+    if (rc == WTREE3_OK) {
+        *filter_slot(tree, idx) = NULL;
+        filter_free(f);
+    }
+    index_set_unpin(&pin);
+    return rc;
+}
+
+WTREE_WARN_UNUSED
+int wtree3_tree_filter_stats(wtree3_tree_t *tree, const char *index_name,
+                             wtree3_filter_stats_t *out, gerror_t *error) {
+    if (WTREE_UNLIKELY(!tree || !out)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+
+    index_pin_t pin;
+    wtree3_index_t *idx;
+    wtree3_filter_t *f;
+    int rc = filter_existing(tree, index_set_pin(tree, &pin), index_name, &idx, &f, error);
+    if (rc != WTREE3_OK) {
+        index_set_unpin(&pin);
+        return rc;
+    }
+
+    uint64_t words = f->blocks * FILTER_BLOCK_WORDS;
+    uint64_t set = 0;
+    for (uint64_t i = 0; i < words; i++) set += popcount64(watomic_load_u64(&f->words[i]));
+
+    /* A miss passes only if all of its probes hit set bits */
+    double fill = (double)set / (double)(words * 64);
+    double fpr = 1.0;
+    for (uint32_t i = 0; i < f->probes; i++) fpr *= fill;
+
+    memset(out, 0, sizeof(*out));
+    out->capacity = f->capacity;
+    out->keys = f->built_keys + watomic_load_u64(&f->added);
+    out->removed = watomic_load_u64(&f->removed);
+    out->memory_bytes = (size_t)(words * sizeof(uint64_t));
+    out->false_positive_rate = fpr;
+    out->rebuild_advised = out->keys > out->capacity || out->removed * 4 > out->keys;
+    index_set_unpin(&pin);
+    return WTREE3_OK;
+}
@@ -0,0 +1,318 @@
+/*
+ * wtree3_group_commit.c - Group-Commit Write Batcher
+ *
+ * When enabled on a database, the auto-transaction write wrappers
+ * (insert_one, update, upsert, delete_one) no longer open one write
+ * transaction per call. Callers queue their write and block; one of them
+ * becomes the leader, drains the queue and applies the whole batch inside
+ * a single MDB_txn, paying for one commit (and one fsync) per batch.
+ *
+ * Each queued write runs in its own nested transaction, so a failing write
+ * (duplicate key, unique index violation, ...) is rolled back on its own
+ * and reported to its caller without affecting the rest of the batch.
+ *
+ * This module provides:
+ * - Configuration: enable_group_commit, disable_group_commit
+ * - Internal entry point: group_commit_submit, group_commit_destroy
+ */
+
+#include "wtree3_internal.h"
+#include "macros.h"
+
+/* ============================================================
+ * Constants
+ * ============================================================ */
+
+#define GROUP_COMMIT_DEFAULT_MAX_BATCH 128
+
+/* ============================================================
+ * Internal Structures
+ * ============================================================ */
+
+/* One queued write (lives on the submitting caller's stack) */
+typedef struct group_commit_req {
+    group_commit_op_t op;
+    wtree3_tree_t *tree;
+    const void *key;
+    size_t key_len;
+    const void *value;
+    size_t value_len;
+    bool *deleted;
+    gerror_t *error;
+    int rc;
+    bool done;
+    struct group_commit_req *next;
+} group_commit_req_t;
+
+struct wtree3_group_commit {
+    wtree3_db_t *db;
+    wmutex_t lock;
+    wcond_t done_cond;              /* Followers wait here for completion/leadership */
+    wcond_t fill_cond;              /* Leader waits here for the batch to fill */
+    size_t max_batch;
+    uint32_t max_wait_us;
+
+    group_commit_req_t *head;
+    group_commit_req_t *tail;
+    size_t pending;
+    bool leader_active;
+};
+
+/* ============================================================
+ * Batch Application
+ * ============================================================ */
+
+static int apply_request(wtree3_txn_t *txn, group_commit_req_t *req) {
+    switch (req->op) {
+        case GROUP_COMMIT_INSERT:
+            return wtree3_insert_one_txn(txn, req->tree, req->key, req->key_len,
+                                         req->value, req->value_len, req->error);
+        case GROUP_COMMIT_UPDATE:
+            return wtree3_update_txn(txn, req->tree, req->key, req->key_len,
+                                     req->value, req->value_len, req->error);
+        case GROUP_COMMIT_UPSERT:
+            return wtree3_upsert_txn(txn, req->tree, req->key, req->key_len,
+                                     req->value, req->value_len, req->error);
+        case GROUP_COMMIT_DELETE:
+            return wtree3_delete_one_txn(txn, req->tree, req->key, req->key_len,
+                                         req->deleted, req->error);
+    }
+    set_error(req->error, WTREE3_LIB, WTREE3_EINVAL, "Unknown group-commit operation");
+    return WTREE3_EINVAL;
+}
+
+/* Run every request of the batch in one write transaction (lock NOT held) */
+static void apply_batch(wtree3_db_t *db, group_commit_req_t *batch) {
+    MDB_txn *parent;
+    int rc = mdb_txn_begin(db->env, NULL, 0, &parent);
+    if (WTREE_UNLIKELY(rc != 0)) {
+        for (group_commit_req_t *req = batch; req; req = req->next) {
+            req->rc = translate_mdb_error(rc, req->error);
+        }
+        return;
+    }
+
+    wtree3_txn_t child_txn = {.txn = NULL, .db = db, .is_write = true};
+    size_t succeeded = 0;
+
+    for (group_commit_req_t *req = batch; req; req = req->next) {
+        /* Nested txn: a failing write rolls back alone */
+        rc = mdb_txn_begin(db->env, parent, 0, &child_txn.txn);
+        if (WTREE_UNLIKELY(rc != 0)) {
+            req->rc = translate_mdb_error(rc, req->error);
+            continue;
+        }
+
+        rc = apply_request(&child_txn, req);
+        if (WTREE_LIKELY(rc == 0)) {
+            rc = mdb_txn_commit(child_txn.txn);
+            if (WTREE_UNLIKELY(rc != 0)) rc = translate_mdb_error(rc, req->error);
+        } else {
+            mdb_txn_abort(child_txn.txn);
+        }
+
+        if (WTREE_LIKELY(rc == 0)) {
+            succeeded++;
+        } else if (req->deleted) {
+            *req->deleted = false;
+        }
+        req->rc = rc;
+    }
+
+    if (succeeded == 0) {
+        if (METRICS_ON(db)) metrics_txn_end(db, 0, false);
+        mdb_txn_abort(parent);
+        return;
+    }
+
+    uint64_t t0 = metrics_begin(db);
+    rc = mdb_txn_commit(parent);
+    if (WTREE_UNLIKELY(t0 != 0)) metrics_txn_end(db, t0, rc == 0);
+    if (WTREE_LIKELY(rc == 0)) {
+        durability_commit(db);
+    } else {
+        /* Nothing was made durable - undo in-memory effects of the batch */
+        for (group_commit_req_t *req = batch; req; req = req->next) {
+            if (req->rc != 0) continue;
+            if (req->deleted) *req->deleted = false;
+            req->rc = translate_mdb_error(rc, req->error);
+        }
+    }
+}
+
+/*
+ * Leader duty: optionally wait for the batch to fill, detach up to
+ * max_batch requests and apply them. Called and returns with gc->lock held.
+ */
+static void lead_batch(wtree3_group_commit_t *gc) {
+    if (gc->max_wait_us > 0 && gc->pending < gc->max_batch) {
+        uint64_t deadline = wtime_now_us() + gc->max_wait_us;
+        while (gc->pending < gc->max_batch) {
+            uint64_t now = wtime_now_us();
+            if (now >= deadline) break;
+            wcond_timedwait(&gc->fill_cond, &gc->lock, deadline - now);
+        }
+    }
+
+    group_commit_req_t *batch = gc->head;
+    group_commit_req_t *last = batch;
+    size_t n = 1;
+    while (n < gc->max_batch && last->next) {
+        last = last->next;
+        n++;
+    }
+    gc->head = last->next;
+    if (!gc->head) gc->tail = NULL;
+    gc->pending -= n;
+    last->next = NULL;
+
+    wmutex_unlock(&gc->lock);
+    apply_batch(gc->db, batch);
+    wmutex_lock(&gc->lock);
+
+    for (group_commit_req_t *req = batch; req; req = req->next) {
+        req->done = true;
+    }
+}
+
+/* ============================================================
+ * Internal Entry Points
+ * ============================================================ */
+
+WTREE_HOT WTREE_WARN_UNUSED
+int group_commit_submit(wtree3_group_commit_t *gc, group_commit_op_t op,
+                        wtree3_tree_t *tree,
+                        const void *key, size_t key_len,
+                        const void *value, size_t value_len,
+                        bool *deleted,
+                        gerror_t *error) {
+    group_commit_req_t req = {
+        .op = op,
+        .tree = tree,
+        .key = key,
+        .key_len = key_len,
+        .value = value,
+        .value_len = value_len,
+        .deleted = deleted,
+        .error = error,
+        .rc = WTREE3_OK,
+        .done = false,
+        .next = NULL
+    };
+
+    wmutex_lock(&gc->lock);
+
+    if (gc->tail) gc->tail->next = &req;
+    else gc->head = &req;
+    gc->tail = &req;
+    gc->pending++;
+
+    if (gc->leader_active && gc->pending >= gc->max_batch) {
+        wcond_signal(&gc->fill_cond);
+    }
+
+    while (!req.done) {
+        if (!gc->leader_active) {
+            gc->leader_active = true;
+            lead_batch(gc);
+            gc->leader_active = false;
+            wcond_broadcast(&gc->done_cond);
+            continue;
+        }
+        wcond_wait(&gc->done_cond, &gc->lock);
+    }
+
+    wmutex_unlock(&gc->lock);
+    return req.rc;
+}
+
+WTREE_COLD
+void group_commit_destroy(wtree3_group_commit_t *gc) {
+    if (!gc) return;
+    wcond_destroy(&gc->fill_cond);
+    wcond_destroy(&gc->done_cond);
+    wmutex_destroy(&gc->lock);
+    free(gc);
+}
+
+/* ============================================================
+ * Configuration
+ * ============================================================ */
+
+WTREE_COLD WTREE_WARN_UNUSED
+int wtree3_db_enable_group_commit(wtree3_db_t *db,
+                                  const wtree3_group_commit_config_t *config,
+                                  gerror_t *error) {
+    if (WTREE_UNLIKELY(!db)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Database cannot be NULL");
+        return WTREE3_EINVAL;
+    }
+
+    if (WTREE_UNLIKELY(db->flags & (MDB_RDONLY | MDB_WRITEMAP))) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                 "Group commit requires a writable environment without MDB_WRITEMAP");
+        return WTREE3_EINVAL;
+    }
+
+    size_t max_batch = config && config->max_batch ? config->max_batch
+                                                   : GROUP_COMMIT_DEFAULT_MAX_BATCH;
+    uint32_t max_wait_us = config ? config->max_wait_us : 0;
+
+    /* Already enabled: just retune */
+    if (db->group_commit) {
+        wmutex_lock(&db->group_commit->lock);
+        db->group_commit->max_batch = max_batch;
+        db->group_commit->max_wait_us = max_wait_us;
+        wcond_signal(&db->group_commit->fill_cond);
+        wmutex_unlock(&db->group_commit->lock);
+        return WTREE3_OK;
+    }
+
+    wtree3_group_commit_t *gc = calloc(1, sizeof(wtree3_group_commit_t));
+    if (WTREE_UNLIKELY(!gc)) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate group-commit state");
+        return WTREE3_ENOMEM;
+    }
+
+    if (WTREE_UNLIKELY(wmutex_init(&gc->lock) != 0)) {
+        free(gc);
+        set_error(error, WTREE3_LIB, WTREE3_ERROR, "Failed to initialize group-commit lock");
+        return WTREE3_ERROR;
+    }
+    if (WTREE_UNLIKELY(wcond_init(&gc->done_cond) != 0)) {
+        wmutex_destroy(&gc->lock);
+        free(gc);
+        set_error(error, WTREE3_LIB, WTREE3_ERROR, "Failed to initialize group-commit condition");
+        return WTREE3_ERROR;
+    }
+    if (WTREE_UNLIKELY(wcond_init(&gc->fill_cond) != 0)) {
+        wcond_destroy(&gc->done_cond);
+        wmutex_destroy(&gc->lock);
+        free(gc);
+        set_error(error, WTREE3_LIB, WTREE3_ERROR, "Failed to initialize group-commit condition");
+        return WTREE3_ERROR;
+    }
+
+    gc->db = db;
+    gc->max_batch = max_batch;
+    gc->max_wait_us = max_wait_us;
+    db->group_commit = gc;
+    return WTREE3_OK;
+}
+
+WTREE_COLD
+void wtree3_db_disable_group_commit(wtree3_db_t *db) {
+    if (!db || !db->group_commit) return;
+
+    wtree3_group_commit_t *gc = db->group_commit;
+
+    /* Let queued writes drain before tearing down */
+    wmutex_lock(&gc->lock);
+    while (gc->pending > 0 || gc->leader_active) {
+        wcond_wait(&gc->done_cond, &gc->lock);
+    }
+    db->group_commit = NULL;
+    wmutex_unlock(&gc->lock);
+
+    group_commit_destroy(gc);
+}
@@ -4,7 +4,6 @@
  * This module provides secondary index management:
  * - Index creation and deletion (add_index, drop_index, populate_index)
  * - Index querying (has_index, index_count)
- * - Index verification (verify_indexes)
  * - Helper functions for index operations
  */
 
@@ -12,7 +11,7 @@
 #include "macros.h"
 
 /* Forward declarations from wtree3_index_persist.c */
-extern int save_index_metadata(wtree3_tree_t *tree, const char *index_name, gerror_t *error);
+extern int save_index_metadata(wtree3_tree_t *tree, wtree3_index_t *idx, gerror_t *error);
 
 /* ============================================================
  * Helper Functions
@@ -29,21 +28,6 @@ char* build_index_tree_name(const char *tree_name, const char *index_name) {
     return name;
 }
 
-/* Comparison function for finding index by name */
-WTREE_PURE
-static int compare_index_by_name(const void *idx_ptr, const void *name_ptr) {
-    const wtree3_index_t *idx = (const wtree3_index_t *)idx_ptr;
-    const char *name = (const char *)name_ptr;
-    return strcmp(idx->name, name);
-}
-
-/* Find index by name */
-WTREE_HOT WTREE_PURE
-wtree3_index_t* find_index(wtree3_tree_t *tree, const char *name) {
-    if (WTREE_UNLIKELY(!tree || !name)) return NULL;
-    return (wtree3_index_t *)wvector_find(tree->indexes, name, compare_index_by_name);
-}
-
 /* Get or create metadata DBI */
 int get_metadata_dbi(wtree3_db_t *db, MDB_txn *txn, MDB_dbi *out_dbi, gerror_t *error) {
     int rc = mdb_dbi_open(txn, WTREE3_META_DB, MDB_CREATE, out_dbi);
@@ -165,13 +149,14 @@ int metadata_delete_txn(MDB_txn *txn, wtree3_db_t *db,
 typedef struct {
     const char *tree_name;
     MDB_dbi *out_dbi;
+    unsigned int flags;             /* index_dbi_flags */
     MDB_cmp_func *compare;
     MDB_cmp_func *dupsort_compare;
 } create_index_ctx_t;
 
 static int create_index_txn(MDB_txn *txn, void *user_data) {
     create_index_ctx_t *ctx = (create_index_ctx_t *)user_data;
-    int rc = mdb_dbi_open(txn, ctx->tree_name, MDB_CREATE | MDB_DUPSORT, ctx->out_dbi);
+    int rc = mdb_dbi_open(txn, ctx->tree_name, MDB_CREATE | ctx->flags, ctx->out_dbi);
     if (rc != 0) return rc;
 
     /* Set custom key comparator if provided */
@@ -193,29 +178,66 @@ static int create_index_txn(MDB_txn *txn, void *user_data) {
  * Index Management
  * ============================================================ */
 
-WTREE_WARN_UNUSED
-int wtree3_tree_add_index(wtree3_tree_t *tree,
-                           const wtree3_index_config_t *config,
-                           gerror_t *error) {
-    if (WTREE_UNLIKELY(!tree || !config || !config->name || config->name[0] == '\0')) {
-        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
-        return WTREE3_EINVAL;
-    }
+/* Body of add_index (publisher lock held, so tree->index_set is stable) */
+static int add_index_locked(wtree3_tree_t *tree,
+                            const wtree3_index_config_t *config,
+                            gerror_t *error) {
+    const index_set_t *set = tree->index_set;
 
     /* Check if index already exists */
-    if (WTREE_UNLIKELY(find_index(tree, config->name))) {
+    if (WTREE_UNLIKELY(index_set_find(set, config->name))) {
         set_error(error, WTREE3_LIB, WTREE3_KEY_EXISTS,
                  "Index '%s' already exists", config->name);
         return WTREE3_KEY_EXISTS;
     }
 
+    /* Covering entries are ordered by their main key part */
+    if (WTREE_UNLIKELY(config->project && config->dupsort_compare)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                 "Covering index '%s' cannot use a custom dupsort comparator", config->name);
+        return WTREE3_EINVAL;
+    }
+
+    /* Packed duplicates: plain entries of one width, in an order LMDB knows */
+    bool integer_dups = false;
+    if (config->main_key_size) {
+        size_t size = config->main_key_size;
+        integer_dups = (tree->flags & MDB_INTEGERKEY) != 0;
+        if (WTREE_UNLIKELY(config->project || config->dupsort_compare)) {
+            set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                     "Index '%s': main_key_size cannot be combined with a projection or dupsort comparator",
+                     config->name);
+            return WTREE3_EINVAL;
+        }
+        if (WTREE_UNLIKELY(integer_dups && size != sizeof(unsigned int) && size != sizeof(size_t))) {
+            set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                     "Index '%s': integer keys are %zu or %zu bytes, not %zu",
+                     config->name, sizeof(unsigned int), sizeof(size_t), size);
+            return WTREE3_EINVAL;
+        }
+        if (WTREE_UNLIKELY(set->key_size && set->key_size != size)) {
+            set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                     "Index '%s': main keys are already fixed at %u bytes",
+                     config->name, set->key_size);
+            return WTREE3_EINVAL;
+        }
+    }
+
     /* Build extractor ID from db version and config flags */
     uint32_t flags = extract_index_flags(config);
     uint64_t extractor_id = build_extractor_id(tree->db->version, flags);
 
-    /* Look up extractor function from registry */
-    wtree3_index_key_fn key_fn = find_extractor(tree->db, extractor_id);
-    if (WTREE_UNLIKELY(!key_fn)) {
+    /* Look up extractor function from registry (either ABI) unless the key is declarative */
+    wtree3_index_key_fn key_fn = NULL;
+    wtree3_index_key_into_fn key_into_fn = NULL;
+    if (config->key_spec) {
+        int spec_rc = key_spec_validate(config->key_spec, error);
+        if (WTREE_UNLIKELY(spec_rc != WTREE3_OK)) return spec_rc;
+    } else {
+        key_fn = find_extractor(tree->db, extractor_id);
+        key_into_fn = key_fn ? NULL : find_extractor_into(tree->db, extractor_id);
+    }
+    if (WTREE_UNLIKELY(!config->key_spec && !key_fn && !key_into_fn)) {
         set_error(error, WTREE3_LIB, WTREE3_EINVAL,
                  "No extractor registered for version=%u flags=0x%02x",
                  tree->db->version, flags);
@@ -234,8 +256,9 @@ int wtree3_tree_add_index(wtree3_tree_t *tree,
     create_index_ctx_t ctx = {
         .tree_name = idx_tree_name,
         .out_dbi = &idx_dbi,
+        .flags = index_dbi_flags(config->main_key_size, integer_dups),
         .compare = config->compare,
-        .dupsort_compare = config->dupsort_compare
+        .dupsort_compare = config->project ? index_covering_dcmp : config->dupsort_compare
     };
 
     int rc = with_write_txn(tree->db, create_index_txn, &ctx, error);
@@ -263,10 +286,14 @@ int wtree3_tree_add_index(wtree3_tree_t *tree,
     idx->dbi = idx_dbi;
     idx->extractor_id = extractor_id;
     idx->key_fn = key_fn;
+    idx->key_into_fn = key_into_fn;
     idx->unique = config->unique;
     idx->sparse = config->sparse;
     idx->compare = config->compare;
     idx->dupsort_compare = config->dupsort_compare;
+    idx->project_fn = config->project;
+    idx->main_key_size = config->main_key_size;
+    idx->integer_dups = integer_dups;
 
     /* Copy user_data if provided */
     if (config->user_data && config->user_data_len > 0) {
@@ -280,35 +307,50 @@ int wtree3_tree_add_index(wtree3_tree_t *tree,
         idx->user_data_len = config->user_data_len;
     }
 
-    /* Add to vector */
-    if (!wvector_push(tree->indexes, idx)) {
-        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to add index to vector");
-        rc = WTREE3_ENOMEM;
-        goto cleanup_user_data;
+    /* Copy the key spec if provided */
+    if (config->key_spec) {
+        idx->key_spec = malloc(sizeof(wtree3_key_spec_t));
+        if (!idx->key_spec) {
+            set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate key spec");
+            rc = WTREE3_ENOMEM;
+            goto cleanup_user_data;
+        }
+        *idx->key_spec = *config->key_spec;
+    }
+
+    /* Make it visible to readers and writers */
+    rc = index_set_publish(tree, idx, NULL, NULL, error);
+    if (rc != 0) {
+        goto cleanup_key_spec;
     }
 
     /* Save metadata (always persisted) */
-    rc = save_index_metadata(tree, config->name, error);
+    rc = save_index_metadata(tree, idx, error);
     if (rc != 0) {
-        goto rollback_vector;
+        goto rollback_set;
     }
 
     return WTREE3_OK;
 
     /* Cleanup paths in reverse order of allocation */
-rollback_vector:
-    /* Roll back by removing from vector (calls cleanup_index via wvector) */
-    wvector_pop(tree->indexes);
-    /* Drop the index tree */
+rollback_set:
+    /* Unpublish; the index is freed once no reader can still see it */
     {
+        bool reclaimed;
+        if (index_set_publish(tree, NULL, idx, &reclaimed, NULL) != 0) {
+            return rc;  /* Out of memory: it stays, without metadata, until close */
+        }
+        /* Drop the index tree (only empty it while a reader may still use the handle) */
         MDB_txn *drop_txn;
         if (mdb_txn_begin(tree->db->env, NULL, 0, &drop_txn) == 0) {
-            mdb_drop(drop_txn, idx_dbi, 1);
+            mdb_drop(drop_txn, idx_dbi, reclaimed ? 1 : 0);
             mdb_txn_commit(drop_txn);
         }
     }
     return rc;
 
+cleanup_key_spec:
+    free(idx->key_spec);
 cleanup_user_data:
     free(idx->user_data);
 cleanup_idx_name:
@@ -323,102 +365,42 @@ cleanup_tree_name:
     return rc;
 }
 
-WTREE_COLD WTREE_WARN_UNUSED
-int wtree3_tree_populate_index(wtree3_tree_t *tree,
-                                const char *index_name,
-                                gerror_t *error) {
-    if (WTREE_UNLIKELY(!tree || !index_name)) {
+WTREE_WARN_UNUSED
+int wtree3_tree_add_index(wtree3_tree_t *tree,
+                           const wtree3_index_config_t *config,
+                           gerror_t *error) {
+    if (WTREE_UNLIKELY(!tree || !config || !config->name || config->name[0] == '\0')) {
         set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
         return WTREE3_EINVAL;
     }
 
-    wtree3_index_t *idx = find_index(tree, index_name);
-    if (!idx) {
-        set_error(error, WTREE3_LIB, WTREE3_NOT_FOUND,
-                 "Index '%s' not found", index_name);
-        return WTREE3_NOT_FOUND;
-    }
-
-    /* Begin write transaction */
-    MDB_txn *txn;
-    int rc = mdb_txn_begin(tree->db->env, NULL, 0, &txn);
-    if (rc != 0) return translate_mdb_error(rc, error);
-
-    /* Create cursor for main tree */
-    MDB_cursor *cursor;
-    rc = mdb_cursor_open(txn, tree->dbi, &cursor);
-    if (rc != 0) {
-        mdb_txn_abort(txn);
-        return translate_mdb_error(rc, error);
-    }
-
-    MDB_val mkey, mval;
-    rc = mdb_cursor_get(cursor, &mkey, &mval, MDB_FIRST);
-
-    while (rc == 0) {
-        /* Extract index key */
-        void *idx_key = NULL;
-        size_t idx_key_size = 0;
-        bool should_index = idx->key_fn(mval.mv_data, mval.mv_size, idx->user_data,
-                                        &idx_key, &idx_key_size);
-
-        if (should_index && idx_key) {
-            /* Check unique constraint */
-            if (idx->unique) {
-                MDB_val check_key = {.mv_size = idx_key_size, .mv_data = idx_key};
-                MDB_val check_val;
-                int get_rc = mdb_get(txn, idx->dbi, &check_key, &check_val);
-                if (get_rc == 0) {
-                    free(idx_key);
-                    mdb_cursor_close(cursor);
-                    mdb_txn_abort(txn);
-                    set_error(error, WTREE3_LIB, WTREE3_INDEX_ERROR,
-                             "Duplicate key for unique index '%s'", index_name);
-                    return WTREE3_INDEX_ERROR;
-                }
-            }
-
-            /* Insert: index_key -> main_key */
-            MDB_val idx_k = {.mv_size = idx_key_size, .mv_data = idx_key};
-            MDB_val idx_v = {.mv_size = mkey.mv_size, .mv_data = mkey.mv_data};
-            rc = mdb_put(txn, idx->dbi, &idx_k, &idx_v, MDB_NODUPDATA);
-            free(idx_key);
-
-            if (rc != 0 && rc != MDB_KEYEXIST) {
-                mdb_cursor_close(cursor);
-                mdb_txn_abort(txn);
-                return translate_mdb_error(rc, error);
-            }
-        }
-
-        rc = mdb_cursor_get(cursor, &mkey, &mval, MDB_NEXT);
-    }
-
-    mdb_cursor_close(cursor);
-
-    if (rc != MDB_NOTFOUND) {
-        mdb_txn_abort(txn);
-        return translate_mdb_error(rc, error);
-    }
-
-    rc = mdb_txn_commit(txn);
-    if (rc != 0) return translate_mdb_error(rc, error);
+    index_set_lock(tree);
+    int rc = add_index_locked(tree, config, error);
+    index_set_unlock(tree);
+    return rc;
+}
 
-    return WTREE3_OK;
+WTREE_COLD WTREE_WARN_UNUSED
+int wtree3_tree_populate_index(wtree3_tree_t *tree,
+                                const char *index_name,
+                                gerror_t *error) {
+    /* Sort-based build with default options (see wtree3_index_build.c) */
+    return wtree3_tree_build_index(tree, index_name, NULL, error);
 }
 
-/* Helper context for drop_index transaction */
+/* Helper context for drop_index transactions */
 typedef struct {
     wtree3_tree_t *tree;
     const char *index_name;
     MDB_dbi idx_dbi;
+    int del;                        /* mdb_drop: 0 = empty, 1 = delete and close */
 } drop_index_ctx_t;
 
 static int drop_index_txn(MDB_txn *txn, void *user_data) {
     drop_index_ctx_t *ctx = (drop_index_ctx_t *)user_data;
 
     /* Drop the index tree */
-    int rc = mdb_drop(txn, ctx->idx_dbi, 1);
+    int rc = mdb_drop(txn, ctx->idx_dbi, ctx->del);
     if (rc != 0 && rc != MDB_NOTFOUND) {
         return rc;
     }
@@ -428,35 +410,36 @@ static int drop_index_txn(MDB_txn *txn, void *user_data) {
 
 static int drop_index_metadata_txn(MDB_txn *txn, void *user_data) {
     drop_index_ctx_t *ctx = (drop_index_ctx_t *)user_data;
+    int rc = stats_delete_txn(txn, ctx->tree->db, ctx->tree->name, ctx->index_name);
+    if (rc == 0) rc = filter_delete_txn(txn, ctx->tree->db, ctx->tree->name, ctx->index_name);
+    if (rc != 0) return rc;
     return metadata_delete_txn(txn, ctx->tree->db, ctx->tree->name,
                                ctx->index_name, NULL);
 }
 
-WTREE_COLD WTREE_WARN_UNUSED
-int wtree3_tree_drop_index(wtree3_tree_t *tree,
-                            const char *index_name,
-                            gerror_t *error) {
-    if (WTREE_UNLIKELY(!tree || !index_name)) {
-        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
-        return WTREE3_EINVAL;
-    }
-
+/*
+ * Readers may still be using the index until it is unpublished and they
+ * unpin, so its DBI is emptied first and deleted (which closes the
+ * handle) only after the grace period.
+ */
+static int drop_index_locked(wtree3_tree_t *tree, const char *index_name, gerror_t *error) {
     /* Find index */
-    wtree3_index_t *idx = find_index(tree, index_name);
+    wtree3_index_t *idx = index_set_find(tree->index_set, index_name);
     if (!idx) {
         set_error(error, WTREE3_LIB, WTREE3_NOT_FOUND,
                  "Index '%s' not found", index_name);
         return WTREE3_NOT_FOUND;
     }
 
-    /* Save context before removing from vector */
+    /* Save context: idx is freed by the publish */
     drop_index_ctx_t ctx = {
         .tree = tree,
         .index_name = index_name,
-        .idx_dbi = idx->dbi
+        .idx_dbi = idx->dbi,
+        .del = 0
     };
 
-    /* Delete the index tree */
+    /* Empty the index tree */
     int rc = with_write_txn(tree->db, drop_index_txn, &ctx, error);
     if (rc != 0) return rc;
 
@@ -464,213 +447,45 @@ int wtree3_tree_drop_index(wtree3_tree_t *tree,
     rc = with_write_txn(tree->db, drop_index_metadata_txn, &ctx, NULL);
     (void)rc;
 
-    /* Remove from vector (this will call cleanup_index automatically) */
-    if (!wvector_remove(tree->indexes, index_name, compare_index_by_name)) {
-        set_error(error, WTREE3_LIB, WTREE3_ERROR, "Failed to remove index from vector");
-        return WTREE3_ERROR;
-    }
-
-    return WTREE3_OK;
-}
-
-WTREE_PURE
-bool wtree3_tree_has_index(wtree3_tree_t *tree, const char *index_name) {
-    return tree && index_name && find_index(tree, index_name) != NULL;
-}
+    bool reclaimed;
+    rc = index_set_publish(tree, NULL, idx, &reclaimed, error);
+    if (rc != 0) return rc;
 
-WTREE_PURE
-size_t wtree3_tree_index_count(wtree3_tree_t *tree) {
-    return tree ? wvector_size(tree->indexes) : 0;
+    /* Delete the emptied tree once nobody can hold its handle */
+    if (reclaimed) {
+        ctx.del = 1;
+        rc = with_write_txn(tree->db, drop_index_txn, &ctx, error);
+    }
+    return rc;
 }
 
 WTREE_COLD WTREE_WARN_UNUSED
-int wtree3_verify_indexes(wtree3_tree_t *tree, gerror_t *error) {
-    if (WTREE_UNLIKELY(!tree)) {
-        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Tree cannot be NULL");
+int wtree3_tree_drop_index(wtree3_tree_t *tree,
+                            const char *index_name,
+                            gerror_t *error) {
+    if (WTREE_UNLIKELY(!tree || !index_name)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
         return WTREE3_EINVAL;
     }
 
-    size_t index_count = wvector_size(tree->indexes);
-    if (index_count == 0) {
-        return WTREE3_OK;  // No indexes to verify
-    }
-
-    // Create read transaction
-    MDB_txn *txn;
-    int rc = mdb_txn_begin(tree->db->env, NULL, MDB_RDONLY, &txn);
-    if (rc != 0) return translate_mdb_error(rc, error);
-
-    // Phase 1: Verify all main tree entries appear in their indexes
-    MDB_cursor *main_cursor;
-    rc = mdb_cursor_open(txn, tree->dbi, &main_cursor);
-    if (rc != 0) {
-        mdb_txn_abort(txn);
-        return translate_mdb_error(rc, error);
-    }
-
-    MDB_val key, val;
-    rc = mdb_cursor_get(main_cursor, &key, &val, MDB_FIRST);
-
-    while (rc == 0) {
-        // For each main entry, check it appears in all applicable indexes
-        for (size_t i = 0; i < index_count; i++) {
-            wtree3_index_t *idx = (wtree3_index_t *)wvector_get(tree->indexes, i);
-
-            // Extract index key
-            void *idx_key = NULL;
-            size_t idx_key_len = 0;
-            bool should_index = idx->key_fn(val.mv_data, val.mv_size, idx->user_data,
-                                           &idx_key, &idx_key_len);
-
-            if (!should_index) continue;  // Sparse index - this entry not indexed
-
-            if (!idx_key) {
-                mdb_cursor_close(main_cursor);
-                mdb_txn_abort(txn);
-                set_error(error, WTREE3_LIB, WTREE3_INDEX_ERROR,
-                         "Index '%s': key extraction failed during verification", idx->name);
-                return WTREE3_INDEX_ERROR;
-            }
-
-            // Check if this entry exists in the index
-            MDB_val idx_search_key = {.mv_size = idx_key_len, .mv_data = idx_key};
-            MDB_val idx_val;
-
-            MDB_cursor *idx_cursor;
-            int idx_rc = mdb_cursor_open(txn, idx->dbi, &idx_cursor);
-            if (idx_rc != 0) {
-                free(idx_key);
-                mdb_cursor_close(main_cursor);
-                mdb_txn_abort(txn);
-                return translate_mdb_error(idx_rc, error);
-            }
-
-            // For unique indexes, there should be exactly one entry
-            // For non-unique, search for our primary key in duplicates
-            idx_rc = mdb_cursor_get(idx_cursor, &idx_search_key, &idx_val, MDB_SET);
-
-            if (idx_rc == MDB_NOTFOUND) {
-                // Missing index entry!
-                mdb_cursor_close(idx_cursor);
-                free(idx_key);
-                mdb_cursor_close(main_cursor);
-                mdb_txn_abort(txn);
-                set_error(error, WTREE3_LIB, WTREE3_INDEX_ERROR,
-                         "Index '%s': missing entry for main tree key (index inconsistency)",
-                         idx->name);
-                return WTREE3_INDEX_ERROR;
-            }
-
-            if (idx_rc != 0) {
-                mdb_cursor_close(idx_cursor);
-                free(idx_key);
-                mdb_cursor_close(main_cursor);
-                mdb_txn_abort(txn);
-                return translate_mdb_error(idx_rc, error);
-            }
-
-            // For non-unique indexes with DUPSORT, verify our PK is in the duplicates
-            if (!idx->unique) {
-                bool found_pk = false;
-                do {
-                    if (idx_val.mv_size == key.mv_size &&
-                        memcmp(idx_val.mv_data, key.mv_data, key.mv_size) == 0) {
-                        found_pk = true;
-                        break;
-                    }
-                    idx_rc = mdb_cursor_get(idx_cursor, &idx_search_key, &idx_val, MDB_NEXT_DUP);
-                } while (idx_rc == 0);
-
-                if (!found_pk) {
-                    mdb_cursor_close(idx_cursor);
-                    free(idx_key);
-                    mdb_cursor_close(main_cursor);
-                    mdb_txn_abort(txn);
-                    set_error(error, WTREE3_LIB, WTREE3_INDEX_ERROR,
-                             "Index '%s': primary key not found in index duplicates (index inconsistency)",
-                             idx->name);
-                    return WTREE3_INDEX_ERROR;
-                }
-            }
-
-            mdb_cursor_close(idx_cursor);
-            free(idx_key);
-        }
-
-        rc = mdb_cursor_get(main_cursor, &key, &val, MDB_NEXT);
-    }
-
-    if (rc != MDB_NOTFOUND) {
-        mdb_cursor_close(main_cursor);
-        mdb_txn_abort(txn);
-        return translate_mdb_error(rc, error);
-    }
-
-    mdb_cursor_close(main_cursor);
-
-    // Phase 2: Verify all index entries point to valid main tree entries
-    for (size_t i = 0; i < index_count; i++) {
-        wtree3_index_t *idx = (wtree3_index_t *)wvector_get(tree->indexes, i);
-
-        MDB_cursor *idx_cursor;
-        rc = mdb_cursor_open(txn, idx->dbi, &idx_cursor);
-        if (rc != 0) {
-            mdb_txn_abort(txn);
-            return translate_mdb_error(rc, error);
-        }
-
-        MDB_val idx_key, idx_val;
-        rc = mdb_cursor_get(idx_cursor, &idx_key, &idx_val, MDB_FIRST);
-
-        while (rc == 0) {
-            // idx_val contains the primary key - verify it exists in main tree
-            MDB_val main_val;
-            int lookup_rc = mdb_get(txn, tree->dbi, &idx_val, &main_val);
-
-            if (lookup_rc == MDB_NOTFOUND) {
-                // Orphaned index entry!
-                mdb_cursor_close(idx_cursor);
-                mdb_txn_abort(txn);
-                set_error(error, WTREE3_LIB, WTREE3_INDEX_ERROR,
-                         "Index '%s': orphaned entry pointing to non-existent main tree key",
-                         idx->name);
-                return WTREE3_INDEX_ERROR;
-            }
-
-            if (lookup_rc != 0) {
-                mdb_cursor_close(idx_cursor);
-                mdb_txn_abort(txn);
-                return translate_mdb_error(lookup_rc, error);
-            }
-
-            // For unique indexes, verify no duplicates exist
-            if (idx->unique) {
-                MDB_val dup_check_key = idx_key;
-                MDB_val dup_val;
-                int dup_rc = mdb_cursor_get(idx_cursor, &dup_check_key, &dup_val, MDB_NEXT_DUP);
-                if (dup_rc == 0) {
-                    // Unique constraint violated!
-                    mdb_cursor_close(idx_cursor);
-                    mdb_txn_abort(txn);
-                    set_error(error, WTREE3_LIB, WTREE3_INDEX_ERROR,
-                             "Index '%s': unique constraint violated - duplicate keys found",
-                             idx->name);
-                    return WTREE3_INDEX_ERROR;
-                }
-            }
-
-            rc = mdb_cursor_get(idx_cursor, &idx_key, &idx_val, MDB_NEXT);
-        }
-
-        if (rc != MDB_NOTFOUND) {
-            mdb_cursor_close(idx_cursor);
-            mdb_txn_abort(txn);
-            return translate_mdb_error(rc, error);
-        }
+    index_set_lock(tree);
+    int rc = drop_index_locked(tree, index_name, error);
+    index_set_unlock(tree);
+    return rc;
+}
 
-        mdb_cursor_close(idx_cursor);
-    }
+bool wtree3_tree_has_index(wtree3_tree_t *tree, const char *index_name) {
+    if (!tree || !index_name) return false;
+    index_pin_t pin;
+    bool found = index_set_find(index_set_pin(tree, &pin), index_name) != NULL;
+    index_set_unpin(&pin);
+    return found;
+}
 
-    mdb_txn_abort(txn);  // Read-only transaction
-    return WTREE3_OK;
+size_t wtree3_tree_index_count(wtree3_tree_t *tree) {
+    if (!tree) return 0;
+    index_pin_t pin;
+    size_t count = index_set_pin(tree, &pin)->count;
+    index_set_unpin(&pin);
+    return count;
 }
@@ -0,0 +1,913 @@
+/*
+ * wtree3_index_build.c - Sort-Based Secondary Index Build
+ *
+ * Builds an index over existing data in three stages:
+ *
+ * 1. Extract: the main tree is split into disjoint key ranges and each
+ *    worker walks its range under its own read transaction, running the
+ *    extractor and buffering (index key, main key) pairs. The build's write
+ *    transaction is begun first, so no writer can commit in between and
+ *    every worker sees the same snapshot.
+ * 2. Sort: each worker sorts its buffer; when the buffer outgrows the
+ *    worker's share of the memory budget the sorted run is spilled to a
+ *    temporary file and the buffer restarts.
+ * 3. Merge: all runs (spilled and in-memory) are k-way merged and streamed
+ *    into the index in order through index_writer_t, which appends when the
+ *    index starts empty and reports unique violations as adjacent
+ *    duplicates.
+ *
+ * The online build is the alternative for live trees: it indexes the tree
+ * in bounded chunks, one write transaction each, and persists a progress
+ * cursor (the last main key indexed) with the index metadata. Between
+ * chunks other writers proceed; they keep the index in sync only for keys
+ * at or below the cursor, since the build reaches the rest by itself.
+ * The index stays hidden from seeks until the build completes, and an
+ * interrupted build resumes from its cursor after reopening the tree.
+ *
+ * This module provides:
+ * - wtree3_tree_build_index (wtree3_tree_populate_index delegates here)
+ * - Online build: build_index_step, build_index_online, index_is_building
+ */
+
+#include "wtree3_internal.h"
+#include "macros.h"
+
+#include <stdio.h>
+
+/* ============================================================
+ * Constants
+ * ============================================================ */
+
+#define BUILD_DEFAULT_MEMORY_BUDGET (64 * 1024 * 1024)
+#define BUILD_MIN_CHUNK_SIZE        4096
+#define BUILD_MIN_ROWS_PER_WORKER   4096
+#define BUILD_MAX_THREADS           64
+#define BUILD_CHUNK_SIZE            (1024 * 1024)
+
+#define ONLINE_DEFAULT_CHUNK_ROWS   10000
+#define ONLINE_DEFAULT_CHUNK_BYTES  (16 * 1024 * 1024)
+
+/* ============================================================
+ * Internal Structures
+ * ============================================================ */
+
+/* Arena chunk backing buffered key bytes */
+typedef struct build_chunk {
+    struct build_chunk *next;
+    size_t used;
+    size_t cap;
+    unsigned char data[];
+} build_chunk_t;
+
+/* One sorted run: in-memory (entries + chunks) or spilled (file) */
+typedef struct build_run {
+    index_entry_t *entries;
+    size_t count;
+    size_t pos;
+    build_chunk_t *chunks;
+
+    FILE *file;
+    char *path;                     /* Only set where the file outlives its name */
+    unsigned char *buf;
+    size_t buf_cap;
+
+    MDB_val key;                    /* Current head of the run */
+    MDB_val main_key;
+} build_run_t;
+
+typedef struct build_worker {
+    wtree3_tree_t *tree;
+    wtree3_index_t *idx;
+    MDB_txn *txn;                   /* Own read txn, or the build txn when inline */
+    const MDB_val *lo;              /* Range [lo, hi), NULL = open */
+    const MDB_val *hi;
+    size_t budget;
+    size_t chunk_size;              /* Arena chunk size (bounded by budget) */
+    const char *tmp_dir;
+
+    /* Current buffer */
+    build_chunk_t *chunks;
+    index_entry_t *entries;
+    size_t count;
+    size_t cap;
+    size_t bytes;
+
+    /* Finished runs */
+    build_run_t **runs;
+    size_t run_count;
+    size_t run_cap;
+
+    int rc;
+    gerror_t error;
+} build_worker_t;
+
+/* Saved in-memory build state of an index (for rollback) */
+typedef struct {
+    bool building;
+    void *cursor;
+    size_t cursor_len;
+} build_state_t;
+
+/* ============================================================
+ * Build State
+ * ============================================================ */
+
+/* Install a new build state (takes ownership of cursor), returning the old one */
+static build_state_t swap_build_state(wtree3_index_t *idx, bool building,
+                                      void *cursor, size_t cursor_len) {
+    build_state_t prev = {
+        .building = idx->building,
+        .cursor = idx->build_cursor.mv_data,
+        .cursor_len = idx->build_cursor.mv_size
+    };
+    idx->building = building;
+    idx->build_cursor.mv_data = cursor;
+    idx->build_cursor.mv_size = cursor ? cursor_len : 0;
+    return prev;
+}
+
+/* Roll back to a saved state, freeing the state being replaced */
+static void restore_build_state(wtree3_index_t *idx, build_state_t prev) {
+    build_state_t cur = swap_build_state(idx, prev.building, prev.cursor, prev.cursor_len);
+    free(cur.cursor);
+}
+
+/* ============================================================
+ * Runs
+ * ============================================================ */
+
+static void free_chunks(build_chunk_t *chunk) {
+    while (chunk) {
+        build_chunk_t *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+}
+
+static void run_destroy(build_run_t *run) {
+    if (!run) return;
+    free(run->entries);
+    free_chunks(run->chunks);
+    if (run->file) fclose(run->file);
+    if (run->path) {
+        remove(run->path);
+        free(run->path);
+    }
+    free(run->buf);
+    free(run);
+}
+
+/* Advance to the next entry: 1 = positioned, 0 = exhausted, <0 = error */
+static int run_next(build_run_t *run, gerror_t *error) {
+    if (!run->file) {
+        if (run->pos >= run->count) return 0;
+        run->key = run->entries[run->pos].key;
+        run->main_key = run->entries[run->pos].main_key;
+        run->pos++;
+        return 1;
+    }
+
+    uint32_t hdr[2];
+    size_t n = fread(hdr, sizeof(uint32_t), 2, run->file);
+    if (n == 0 && feof(run->file)) return 0;
+    if (WTREE_UNLIKELY(n != 2)) goto io_error;
+
+    size_t need = (size_t)hdr[0] + hdr[1];
+    if (need > run->buf_cap) {
+        size_t cap = run->buf_cap ? run->buf_cap : 256;
+        while (cap < need) cap *= 2;
+        unsigned char *buf = realloc(run->buf, cap);
+        if (WTREE_UNLIKELY(!buf)) {
+            set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate merge buffer");
+            return WTREE3_ENOMEM;
+        }
+        run->buf = buf;
+        run->buf_cap = cap;
+    }
+    if (WTREE_UNLIKELY(need > 0 && fread(run->buf, 1, need, run->file) != need)) goto io_error;
+
+    run->key.mv_data = run->buf;
+    run->key.mv_size = hdr[0];
+    run->main_key.mv_data = run->buf + hdr[0];
+    run->main_key.mv_size = hdr[1];
+    return 1;
+
+io_error:
+    set_error(error, WTREE3_LIB, WTREE3_ERROR, "Failed to read index build spill file");
+    return WTREE3_ERROR;
+}
+
+static FILE *open_spill_file(build_worker_t *w, char **out_path) {
+    *out_path = NULL;
+    if (!w->tmp_dir) return tmpfile();
+
+    size_t len = strlen(w->tmp_dir) + 64;
+    char *path = malloc(len);
+    if (!path) return NULL;
+    snprintf(path, len, "%s/wtree3-build-%llu-%p-%zu.run", w->tmp_dir,
+             (unsigned long long)wtime_now_us(), (void *)w, w->run_count);
+
+    FILE *file = fopen(path, "w+b");
+    if (!file) {
+        free(path);
+        return NULL;
+    }
+#if WTREE_OS_WINDOWS
+    *out_path = path;               /* Open files cannot be unlinked - remove on close */
+#else
+    remove(path);
+    free(path);
+#endif
+    return file;
+}
+
+/* ============================================================
+ * Stage 1/2: Extract and Sort (per worker)
+ * ============================================================ */
+
+static int worker_push_run(build_worker_t *w, build_run_t *run) {
+    if (w->run_count == w->run_cap) {
+        size_t cap = w->run_cap ? w->run_cap * 2 : 4;
+        build_run_t **runs = realloc(w->runs, cap * sizeof(build_run_t *));
+        if (WTREE_UNLIKELY(!runs)) return WTREE3_ENOMEM;
+        w->runs = runs;
+        w->run_cap = cap;
+    }
+    w->runs[w->run_count++] = run;
+    return WTREE3_OK;
+}
+
+static int worker_sort(build_worker_t *w) {
+    if (WTREE_UNLIKELY(!index_entries_sort(w->txn, w->idx, w->entries, w->count))) {
+        set_error(&w->error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to sort index entries");
+        return WTREE3_ENOMEM;
+    }
+    return WTREE3_OK;
+}
+
+/* Sort the buffer and write it out as a spilled run */
+static int worker_spill(build_worker_t *w) {
+    int rc = worker_sort(w);
+    if (WTREE_UNLIKELY(rc != 0)) return rc;
+
+    build_run_t *run = calloc(1, sizeof(build_run_t));
+    if (WTREE_UNLIKELY(!run)) goto nomem;
+
+    run->file = open_spill_file(w, &run->path);
+    if (WTREE_UNLIKELY(!run->file)) {
+        run_destroy(run);
+        set_error(&w->error, WTREE3_LIB, WTREE3_ERROR, "Failed to create index build spill file");
+        return WTREE3_ERROR;
+    }
+
+    for (size_t i = 0; i < w->count; i++) {
+        uint32_t hdr[2] = {(uint32_t)w->entries[i].key.mv_size,
+                           (uint32_t)w->entries[i].main_key.mv_size};
+        if (WTREE_UNLIKELY(fwrite(hdr, sizeof(uint32_t), 2, run->file) != 2 ||
+                           fwrite(w->entries[i].key.mv_data, 1, hdr[0], run->file) != hdr[0] ||
+                           fwrite(w->entries[i].main_key.mv_data, 1, hdr[1], run->file) != hdr[1])) {
+            run_destroy(run);
+            set_error(&w->error, WTREE3_LIB, WTREE3_ERROR, "Failed to write index build spill file");
+            return WTREE3_ERROR;
+        }
+    }
+    if (WTREE_UNLIKELY(fflush(run->file) != 0 || fseek(run->file, 0, SEEK_SET) != 0)) {
+        run_destroy(run);
+        set_error(&w->error, WTREE3_LIB, WTREE3_ERROR, "Failed to write index build spill file");
+        return WTREE3_ERROR;
+    }
+
+    if (WTREE_UNLIKELY(worker_push_run(w, run) != 0)) {
+        run_destroy(run);
+        goto nomem;
+    }
+
+    free_chunks(w->chunks);
+    w->chunks = NULL;
+    w->count = 0;
+    w->bytes = w->cap * sizeof(index_entry_t);
+    return WTREE3_OK;
+
+nomem:
+    set_error(&w->error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate index build run");
+    return WTREE3_ENOMEM;
+}
+
+static void *worker_alloc(build_worker_t *w, size_t size) {
+    build_chunk_t *chunk = w->chunks;
+    if (!chunk || chunk->cap - chunk->used < size) {
+        size_t cap = size > w->chunk_size ? size : w->chunk_size;
+        chunk = malloc(sizeof(build_chunk_t) + cap);
+        if (WTREE_UNLIKELY(!chunk)) return NULL;
+        chunk->next = w->chunks;
+        chunk->used = 0;
+        chunk->cap = cap;
+        w->chunks = chunk;
+        w->bytes += sizeof(build_chunk_t) + cap;
+    }
+    void *p = chunk->data + chunk->used;
+    chunk->used += size;
+    return p;
+}
+
+/* Buffer one (index key, main key) pair, spilling first if over budget */
+static int worker_add(build_worker_t *w, const void *idx_key, size_t idx_key_len,
+                      const MDB_val *main_key) {
+    if (w->bytes >= w->budget && w->count > 0) {
+        int rc = worker_spill(w);
+        if (WTREE_UNLIKELY(rc != 0)) return rc;
+    }
+
+    if (w->count == w->cap) {
+        size_t cap = w->cap ? w->cap * 2 : 1024;
+        index_entry_t *entries = realloc(w->entries, cap * sizeof(index_entry_t));
+        if (WTREE_UNLIKELY(!entries)) goto nomem;
+        w->bytes += (cap - w->cap) * sizeof(index_entry_t);
+        w->entries = entries;
+        w->cap = cap;
+    }
+
+    unsigned char *p = worker_alloc(w, idx_key_len + main_key->mv_size);
+    if (WTREE_UNLIKELY(!p)) goto nomem;
+    memcpy(p, idx_key, idx_key_len);
+    memcpy(p + idx_key_len, main_key->mv_data, main_key->mv_size);
+
+    index_entry_t *e = &w->entries[w->count++];
+    e->key.mv_data = p;
+    e->key.mv_size = idx_key_len;
+    e->main_key.mv_data = p + idx_key_len;
+    e->main_key.mv_size = main_key->mv_size;
+    return WTREE3_OK;
+
+nomem:
+    set_error(&w->error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate index build buffer");
+    return WTREE3_ENOMEM;
+}
+
+/* Fixed-width indexes can only pack main keys of that width */
+static int check_main_key(const wtree3_index_t *idx, const MDB_val *mkey, gerror_t *error) {
+    if (WTREE_LIKELY(!idx->main_key_size || mkey->mv_size == idx->main_key_size)) return WTREE3_OK;
+    set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+             "Index '%s': main key of %zu bytes, index packs %u-byte keys",
+             idx->name, mkey->mv_size, idx->main_key_size);
+    return WTREE3_EINVAL;
+}
+
+/* Walk [lo, hi) of the main tree and produce sorted runs */
+static int worker_run(build_worker_t *w) {
+    wtree3_index_t *idx = w->idx;
+    MDB_dbi dbi = w->tree->dbi;
+
+    MDB_cursor *cursor;
+    int rc = mdb_cursor_open(w->txn, dbi, &cursor);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, &w->error);
+
+    MDB_val mkey, mval;
+    codec_buf_t buf = {0};
+    if (w->lo) {
+        mkey = *w->lo;
+        rc = mdb_cursor_get(cursor, &mkey, &mval, MDB_SET_RANGE);
+    } else {
+        rc = mdb_cursor_get(cursor, &mkey, &mval, MDB_FIRST);
+    }
+
+    while (rc == 0) {
+        if (w->hi && mdb_cmp(w->txn, dbi, &mkey, w->hi) >= 0) break;
+        rc = check_main_key(idx, &mkey, &w->error);
+        if (WTREE_UNLIKELY(rc != 0)) {
+            mdb_cursor_close(cursor);
+            codec_buf_release(&buf);
+            return rc;
+        }
+        rc = tree_value_decode(w->tree, &mval, &buf);
+        if (WTREE_UNLIKELY(rc != 0)) break;
+
+        index_key_t idx_key;
+        bool should_index = index_key_extract(idx, mval.mv_data, mval.mv_size, &idx_key);
+        if (should_index && idx_key.data) {
+            index_dup_t dup;
+            rc = index_dup_build(idx, mkey.mv_data, mkey.mv_size,
+                                 mval.mv_data, mval.mv_size, &dup, &w->error);
+            if (rc == 0) {
+                rc = worker_add(w, idx_key.data, idx_key.len, &dup.val);
+                index_dup_release(&dup);
+            }
+            index_key_release(&idx_key);
+            if (WTREE_UNLIKELY(rc != 0)) {
+                mdb_cursor_close(cursor);
+                codec_buf_release(&buf);
+                return rc;
+            }
+        }
+
+        rc = mdb_cursor_get(cursor, &mkey, &mval, MDB_NEXT);
+    }
+    mdb_cursor_close(cursor);
+    codec_buf_release(&buf);
+
+    if (WTREE_UNLIKELY(rc != 0 && rc != MDB_NOTFOUND)) {
+        return translate_mdb_error(rc, &w->error);
+    }
+
+    /* Keep the final buffer in memory as the last run */
+    if (w->count == 0) return WTREE3_OK;
+
+    rc = worker_sort(w);
+    if (WTREE_UNLIKELY(rc != 0)) return rc;
+
+    build_run_t *run = calloc(1, sizeof(build_run_t));
+    if (WTREE_UNLIKELY(!run) || WTREE_UNLIKELY(worker_push_run(w, run) != 0)) {
+        free(run);
+        set_error(&w->error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate index build run");
+        return WTREE3_ENOMEM;
+    }
+    run->entries = w->entries;
+    run->count = w->count;
+    run->chunks = w->chunks;
+    w->entries = NULL;
+    w->chunks = NULL;
+    w->count = w->cap = 0;
+    return WTREE3_OK;
+}
+
+static void *worker_thread(void *arg) {
+    build_worker_t *w = (build_worker_t *)arg;
+
+    int rc = mdb_txn_begin(w->tree->db->env, NULL, MDB_RDONLY, &w->txn);
+    if (WTREE_UNLIKELY(rc != 0)) {
+        w->txn = NULL;
+        w->rc = translate_mdb_error(rc, &w->error);
+        return NULL;
+    }
+
+    w->rc = worker_run(w);
+
+    /* Everything buffered was copied out of the map */
+    mdb_txn_abort(w->txn);
+    w->txn = NULL;
+    return NULL;
+}
+
+static void worker_cleanup(build_worker_t *w) {
+    free_chunks(w->chunks);
+    free(w->entries);
+    for (size_t i = 0; i < w->run_count; i++) {
+        run_destroy(w->runs[i]);
+    }
+    free(w->runs);
+}
+
+/* ============================================================
+ * Stage 3: Merge
+ * ============================================================ */
+
+typedef struct {
+    MDB_txn *txn;
+    MDB_dbi dbi;
+    build_run_t **heap;
+    size_t size;
+} build_heap_t;
+
+static bool run_less(build_heap_t *h, const build_run_t *a, const build_run_t *b) {
+    int c = mdb_cmp(h->txn, h->dbi, &a->key, &b->key);
+    if (c != 0) return c < 0;
+    return mdb_dcmp(h->txn, h->dbi, &a->main_key, &b->main_key) < 0;
+}
+
+static void heap_sift_down(build_heap_t *h, size_t i) {
+    for (;;) {
+        size_t l = 2 * i + 1, r = l + 1, m = i;
+        if (l < h->size && run_less(h, h->heap[l], h->heap[m])) m = l;
+        if (r < h->size && run_less(h, h->heap[r], h->heap[m])) m = r;
+        if (m == i) return;
+        build_run_t *tmp = h->heap[i];
+        h->heap[i] = h->heap[m];
+        h->heap[m] = tmp;
+        i = m;
+    }
+}
+
+static int merge_runs(MDB_txn *txn, wtree3_index_t *idx,
+                      build_worker_t *workers, size_t worker_count,
+                      gerror_t *error) {
+    size_t total = 0;
+    for (size_t i = 0; i < worker_count; i++) total += workers[i].run_count;
+    if (total == 0) return WTREE3_OK;
+
+    build_heap_t h = {.txn = txn, .dbi = idx->dbi, .size = 0};
+    h.heap = malloc(total * sizeof(build_run_t *));
+    if (WTREE_UNLIKELY(!h.heap)) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate merge heap");
+        return WTREE3_ENOMEM;
+    }
+
+    int rc = WTREE3_OK;
+    for (size_t i = 0; i < worker_count && rc == 0; i++) {
+        for (size_t j = 0; j < workers[i].run_count; j++) {
+            rc = run_next(workers[i].runs[j], error);
+            if (rc < 0) break;
+            if (rc == 1) h.heap[h.size++] = workers[i].runs[j];
+            rc = WTREE3_OK;
+        }
+    }
+    if (WTREE_UNLIKELY(rc != 0)) goto cleanup;
+
+    for (size_t i = h.size / 2; i-- > 0;) heap_sift_down(&h, i);
+
+    index_writer_t writer;
+    rc = index_writer_begin(&writer, txn, idx, error);
+    if (WTREE_UNLIKELY(rc != 0)) goto cleanup;
+
+    while (h.size > 0) {
+        build_run_t *top = h.heap[0];
+        rc = index_writer_put(&writer, &top->key, &top->main_key, error);
+        if (WTREE_UNLIKELY(rc != 0)) break;
+
+        rc = run_next(top, error);
+        if (WTREE_UNLIKELY(rc < 0)) break;
+        if (rc == 0) h.heap[0] = h.heap[--h.size];
+        rc = WTREE3_OK;
+        if (h.size > 0) heap_sift_down(&h, 0);
+    }
+    index_writer_end(&writer);
+
+cleanup:
+    free(h.heap);
+    return rc;
+}
+
+/* ============================================================
+ * Build Entry Point
+ * ============================================================ */
+
+/* Run extraction on every worker; fall back inline if a thread can't start */
+static int run_workers(MDB_txn *txn, build_worker_t *workers, size_t count,
+                       gerror_t *error) {
+    if (count == 1) {
+        workers[0].txn = txn;
+        workers[0].rc = worker_run(&workers[0]);
+    } else {
+        wthread_t *threads = malloc(count * sizeof(wthread_t));
+        bool *started = calloc(count, sizeof(bool));
+        if (WTREE_UNLIKELY(!threads || !started)) {
+            free(threads);
+            free(started);
+            set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate build threads");
+            return WTREE3_ENOMEM;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            started[i] = wthread_create(&threads[i], worker_thread, &workers[i]) == 0;
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (started[i]) continue;
+            workers[i].txn = txn;
+            workers[i].rc = worker_run(&workers[i]);
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (started[i]) wthread_join(threads[i], NULL);
+        }
+        free(threads);
+        free(started);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (workers[i].rc != 0) {
+            error_copy(error, &workers[i].error);
+            return workers[i].rc;
+        }
+    }
+    return WTREE3_OK;
+}
+
+/* Full build of an index the caller keeps pinned */
+static int build_index(wtree3_tree_t *tree, wtree3_index_t *idx,
+                       const wtree3_index_build_opts_t *opts, gerror_t *error) {
+    size_t threads = opts && opts->threads ? opts->threads : 1;
+    if (threads > BUILD_MAX_THREADS) threads = BUILD_MAX_THREADS;
+    size_t budget = opts && opts->memory_budget ? opts->memory_budget : BUILD_DEFAULT_MEMORY_BUDGET;
+
+    /* The write txn pins the snapshot every worker reads */
+    MDB_txn *txn;
+    int rc = mdb_txn_begin(tree->db->env, NULL, 0, &txn);
+    if (rc != 0) return translate_mdb_error(rc, error);
+
+    MDB_val *splits = NULL;
+    size_t split_count = 0;
+    if (threads > 1) {
+        MDB_stat st;
+        rc = mdb_stat(txn, tree->dbi, &st);
+        if (WTREE_UNLIKELY(rc != 0)) {
+            mdb_txn_abort(txn);
+            return translate_mdb_error(rc, error);
+        }
+        size_t useful = st.ms_entries / BUILD_MIN_ROWS_PER_WORKER;
+        if (useful < threads) threads = useful ? useful : 1;
+    }
+    if (threads > 1) {
+        rc = partition_split_keys(txn, tree->dbi, NULL, NULL, threads,
+                                  &splits, &split_count, error);
+        if (WTREE_UNLIKELY(rc != 0)) {
+            mdb_txn_abort(txn);
+            return rc;
+        }
+    }
+
+    size_t worker_count = split_count + 1;
+    build_worker_t *workers = calloc(worker_count, sizeof(build_worker_t));
+    if (WTREE_UNLIKELY(!workers)) {
+        partition_free_splits(splits, split_count);
+        mdb_txn_abort(txn);
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate build workers");
+        return WTREE3_ENOMEM;
+    }
+
+    size_t worker_budget = budget / worker_count;
+    size_t chunk_size = worker_budget / 4;
+    if (chunk_size > BUILD_CHUNK_SIZE) chunk_size = BUILD_CHUNK_SIZE;
+    if (chunk_size < BUILD_MIN_CHUNK_SIZE) chunk_size = BUILD_MIN_CHUNK_SIZE;
+    for (size_t i = 0; i < worker_count; i++) {
+        workers[i].tree = tree;
+        workers[i].idx = idx;
+        workers[i].lo = i > 0 ? &splits[i - 1] : NULL;
+        workers[i].hi = i < split_count ? &splits[i] : NULL;
+        workers[i].budget = worker_budget;
+        workers[i].chunk_size = chunk_size;
+        workers[i].tmp_dir = opts ? opts->tmp_dir : NULL;
+    }
+
+    rc = run_workers(txn, workers, worker_count, error);
+    if (rc == 0) {
+        rc = merge_runs(txn, idx, workers, worker_count, error);
+    }
+
+    for (size_t i = 0; i < worker_count; i++) {
+        worker_cleanup(&workers[i]);
+    }
+    free(workers);
+    partition_free_splits(splits, split_count);
+
+    /* A full build also completes an interrupted online build */
+    build_state_t prev = {.building = false};
+    bool was_building = idx->building;
+    if (rc == 0 && was_building) {
+        prev = swap_build_state(idx, false, NULL, 0);
+        rc = save_index_metadata_txn(txn, tree, idx, error);
+    }
+
+    if (WTREE_UNLIKELY(rc != 0)) {
+        mdb_txn_abort(txn);
+        if (was_building) restore_build_state(idx, prev);
+        return rc;
+    }
+
+    rc = mdb_txn_commit(txn);
+    if (rc != 0) {
+        if (was_building) restore_build_state(idx, prev);
+        return translate_mdb_error(rc, error);
+    }
+
+    if (was_building) free(prev.cursor);
+    return WTREE3_OK;
+}
+
+WTREE_COLD WTREE_WARN_UNUSED
+int wtree3_tree_build_index(wtree3_tree_t *tree,
+                            const char *index_name,
+                            const wtree3_index_build_opts_t *opts,
+                            gerror_t *error) {
+    if (WTREE_UNLIKELY(!tree || !index_name)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+
+    /* Pinned for the whole build: a concurrent drop_index waits for it */
+    index_pin_t pin;
+    wtree3_index_t *idx = index_set_find(index_set_pin(tree, &pin), index_name);
+    if (!idx) {
+        index_set_unpin(&pin);
+        set_error(error, WTREE3_LIB, WTREE3_NOT_FOUND,
+                 "Index '%s' not found", index_name);
+        return WTREE3_NOT_FOUND;
+    }
+
+    int rc = build_index(tree, idx, opts, error);
+    index_set_unpin(&pin);
+    return rc;
+}
+
+/* ============================================================
+ * Online Build
+ * ============================================================ */
+
+typedef struct {
+    wtree3_tree_t *tree;
+    wtree3_index_t *idx;
+    size_t chunk_rows;
+    size_t chunk_bytes;
+    bool finished;
+    void *new_cursor;               /* Copy of the last main key of this chunk */
+    size_t new_cursor_len;
+    gerror_t *error;
+} online_step_ctx_t;
+
+/* Index one chunk of rows past the build cursor */
+static int online_step_txn(MDB_txn *txn, online_step_ctx_t *ctx) {
+    wtree3_tree_t *tree = ctx->tree;
+    wtree3_index_t *idx = ctx->idx;
+    gerror_t *error = ctx->error;
+
+    /* Starting: discard whatever writers put into the index so far */
+    if (!idx->building) {
+        int rc = mdb_drop(txn, idx->dbi, 0);
+        if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+    }
+
+    MDB_cursor *cursor;
+    int rc = mdb_cursor_open(txn, tree->dbi, &cursor);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+
+    MDB_val mkey, mval;
+    codec_buf_t buf = {0};
+    if (idx->building && idx->build_cursor.mv_data) {
+        mkey = idx->build_cursor;
+        rc = mdb_cursor_get(cursor, &mkey, &mval, MDB_SET_RANGE);
+        if (rc == 0 && mdb_cmp(txn, tree->dbi, &mkey, &idx->build_cursor) == 0) {
+            rc = mdb_cursor_get(cursor, &mkey, &mval, MDB_NEXT);
+        }
+    } else {
+        rc = mdb_cursor_get(cursor, &mkey, &mval, MDB_FIRST);
+    }
+
+    index_entry_t *entries = NULL;
+    size_t count = 0, cap = 0;
+    size_t rows = 0, bytes = 0;
+    MDB_val last = {0, NULL};
+
+    while (rc == 0 && rows < ctx->chunk_rows && bytes < ctx->chunk_bytes) {
+        bytes += mkey.mv_size + mval.mv_size;
+        rc = check_main_key(idx, &mkey, error);
+        if (WTREE_UNLIKELY(rc != 0)) goto cleanup;
+        rc = tree_value_decode(tree, &mval, &buf);
+        if (WTREE_UNLIKELY(rc != 0)) break;
+
+        index_key_t idx_key;
+        bool should_index = index_key_extract(idx, mval.mv_data, mval.mv_size, &idx_key);
+        if (should_index && idx_key.data) {
+            if (count == cap) {
+                size_t new_cap = cap ? cap * 2 : 256;
+                index_entry_t *grown = realloc(entries, new_cap * sizeof(index_entry_t));
+                if (WTREE_UNLIKELY(!grown)) {
+                    index_key_release(&idx_key);
+                    set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate index buffer");
+                    rc = WTREE3_ENOMEM;
+                    goto cleanup;
+                }
+                entries = grown;
+                cap = new_cap;
+            }
+            /* Main keys point into the map - the main tree is not written here */
+            rc = index_entry_fill(idx, &idx_key, &mkey, mval.mv_data, mval.mv_size,
+                                  &entries[count], error);
+            if (WTREE_UNLIKELY(rc != 0)) goto cleanup;
+            count++;
+        }
+
+        last = mkey;
+        rows++;
+        rc = mdb_cursor_get(cursor, &mkey, &mval, MDB_NEXT);
+    }
+
+    if (WTREE_UNLIKELY(rc != 0 && rc != MDB_NOTFOUND)) {
+        rc = translate_mdb_error(rc, error);
+        goto cleanup;
+    }
+    ctx->finished = (rc == MDB_NOTFOUND);
+
+    if (!ctx->finished) {
+        ctx->new_cursor = malloc(last.mv_size ? last.mv_size : 1);
+        if (WTREE_UNLIKELY(!ctx->new_cursor)) {
+            set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate build cursor");
+            rc = WTREE3_ENOMEM;
+            goto cleanup;
+        }
+        memcpy(ctx->new_cursor, last.mv_data, last.mv_size);
+        ctx->new_cursor_len = last.mv_size;
+    }
+
+    if (WTREE_UNLIKELY(!index_entries_sort(txn, idx, entries, count))) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to sort index entries");
+        rc = WTREE3_ENOMEM;
+        goto cleanup;
+    }
+    rc = index_write_sorted(txn, idx, entries, count, error);
+
+cleanup:
+    mdb_cursor_close(cursor);
+    codec_buf_release(&buf);
+    for (size_t i = 0; i < count; i++) {
+        free(entries[i].key.mv_data);
+    }
+    free(entries);
+    return rc;
+}
+
+/* One online build chunk of an index the caller keeps pinned */
+static int build_index_step(wtree3_tree_t *tree, wtree3_index_t *idx,
+                            const wtree3_online_build_opts_t *opts, bool *done,
+                            gerror_t *error) {
+    online_step_ctx_t ctx = {
+        .tree = tree,
+        .idx = idx,
+        .chunk_rows = opts && opts->chunk_rows ? opts->chunk_rows : ONLINE_DEFAULT_CHUNK_ROWS,
+        .chunk_bytes = opts && opts->chunk_bytes ? opts->chunk_bytes : ONLINE_DEFAULT_CHUNK_BYTES,
+        .finished = false,
+        .new_cursor = NULL,
+        .new_cursor_len = 0,
+        .error = error
+    };
+
+    MDB_txn *txn;
+    int rc = mdb_txn_begin(tree->db->env, NULL, 0, &txn);
+    if (rc != 0) return translate_mdb_error(rc, error);
+
+    rc = online_step_txn(txn, &ctx);
+    if (WTREE_UNLIKELY(rc != 0)) {
+        mdb_txn_abort(txn);
+        free(ctx.new_cursor);
+        return rc;
+    }
+
+    /*
+     * Publish the new cursor before commit, while this txn still holds the
+     * writer lock: the next writer must already maintain the keys this
+     * chunk indexed. A cursor ahead of what is committed only costs
+     * redundant index writes, which the build repeats idempotently.
+     */
+    build_state_t prev = swap_build_state(idx, !ctx.finished, ctx.new_cursor, ctx.new_cursor_len);
+
+    rc = save_index_metadata_txn(txn, tree, idx, error);
+    if (WTREE_UNLIKELY(rc != 0)) {
+        mdb_txn_abort(txn);
+        restore_build_state(idx, prev);
+        return rc;
+    }
+
+    rc = mdb_txn_commit(txn);
+    if (WTREE_UNLIKELY(rc != 0)) {
+        restore_build_state(idx, prev);
+        return translate_mdb_error(rc, error);
+    }
+
+    free(prev.cursor);
+    if (done) *done = ctx.finished;
+    return WTREE3_OK;
+}
+
+WTREE_COLD WTREE_WARN_UNUSED
+int wtree3_tree_build_index_step(wtree3_tree_t *tree,
+                                 const char *index_name,
+                                 const wtree3_online_build_opts_t *opts,
+                                 bool *done,
+                                 gerror_t *error) {
+    if (done) *done = false;
+    if (WTREE_UNLIKELY(!tree || !index_name)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+
+    /* Pinned for the whole chunk: a concurrent drop_index waits for it */
+    index_pin_t pin;
+    wtree3_index_t *idx = index_set_find(index_set_pin(tree, &pin), index_name);
+    if (!idx) {
+        index_set_unpin(&pin);
+        set_error(error, WTREE3_LIB, WTREE3_NOT_FOUND,
+                 "Index '%s' not found", index_name);
+        return WTREE3_NOT_FOUND;
+    }
+
+    int rc = build_index_step(tree, idx, opts, done, error);
+    index_set_unpin(&pin);
+    return rc;
+}
+
+WTREE_COLD WTREE_WARN_UNUSED
+int wtree3_tree_build_index_online(wtree3_tree_t *tree,
+                                   const char *index_name,
+                                   const wtree3_online_build_opts_t *opts,
+                                   gerror_t *error) {
+    bool done = false;
+    while (!done) {
+        int rc = wtree3_tree_build_index_step(tree, index_name, opts, &done, error);
+        if (WTREE_UNLIKELY(rc != 0)) return rc;
+    }
+    return WTREE3_OK;
+}
+
+bool wtree3_index_is_building(wtree3_tree_t *tree, const char *index_name) {
+    index_pin_t pin;
+    wtree3_index_t *idx = index_set_find(index_set_pin(tree, &pin), index_name);
+    bool building = idx && idx->building;
+    index_set_unpin(&pin);
+    return building;
+}
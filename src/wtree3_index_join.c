@@ -0,0 +1,289 @@
+/*
+ * wtree3_index_join.c - Index Lookups Resolved to Main-Tree Values
+ *
+ * Reading records through a secondary index used to take an index
+ * iterator (its own read txn), then one wtree3_get_txn per hit on a
+ * second txn, each descending the main tree from the root. The join
+ * walks the index cursor and a main-tree cursor side by side inside one
+ * transaction and hands (index key, main key, value) straight to the
+ * callback, zero-copy.
+ *
+ * With WTREE3_JOIN_SORTED, hits are gathered in batches and resolved in
+ * main-key order, so consecutive fetches stay on the same or adjacent
+ * main-tree leaves; this helps when index order and main-key order are
+ * uncorrelated (e.g. all orders of one customer).
+ *
+ * This module provides:
+ * - wtree3_index_scan_join_txn, wtree3_index_scan_join
+ * - wtree3_index_get_many_txn, wtree3_index_get_many
+ */
+
+#include "wtree3_internal.h"
+#include "macros.h"
+
+/* ============================================================
+ * Constants
+ * ============================================================ */
+
+#define JOIN_BATCH_SIZE 256     /* Hits resolved per sorted batch */
+
+/* ============================================================
+ * Internal Structures
+ * ============================================================ */
+
+typedef struct {
+    MDB_val index_key;
+    MDB_val main_key;
+} join_hit_t;
+
+typedef struct {
+    MDB_txn *txn;
+    wtree3_tree_t *tree;
+    wtree3_index_t *idx;
+    MDB_cursor *main_cursor;
+    codec_buf_t decoded;            /* Current value when the tree has a codec */
+    wtree3_join_fn join_fn;
+    void *user_data;
+    gerror_t *error;
+} join_ctx_t;
+
+/* ============================================================
+ * Helpers
+ * ============================================================ */
+
+static int join_cmp_main_key(const void *a, const void *b, void *ctx) {
+    const join_ctx_t *j = (const join_ctx_t *)ctx;
+    return mdb_cmp(j->txn, j->tree->dbi,
+                   &((const join_hit_t *)a)->main_key,
+                   &((const join_hit_t *)b)->main_key);
+}
+
+/* Fetch one hit from the main tree and deliver it; 1 means stop */
+static int join_deliver(join_ctx_t *j, const MDB_val *index_key, const MDB_val *main_key) {
+    MDB_val key = *main_key, val;
+    int rc = mdb_cursor_get(j->main_cursor, &key, &val, MDB_SET_KEY);
+    if (WTREE_UNLIKELY(rc == MDB_NOTFOUND)) {
+        set_error(j->error, WTREE3_LIB, WTREE3_INDEX_ERROR,
+                 "Index '%s': entry references a missing main tree key (index inconsistency)",
+                 j->idx->name);
+        return WTREE3_INDEX_ERROR;
+    }
+    if (WTREE_LIKELY(rc == 0)) rc = tree_value_decode(j->tree, &val, &j->decoded);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, j->error);
+
+    bool more = j->join_fn(index_key->mv_data, index_key->mv_size,
+                           key.mv_data, key.mv_size,
+                           val.mv_data, val.mv_size,
+                           j->user_data);
+    return more ? WTREE3_OK : 1;
+}
+
+/* Resolve a batch of hits in main-key order; 1 means stop */
+static int join_flush(join_ctx_t *j, join_hit_t *hits, size_t count) {
+    if (count > 1) {
+        /* On allocation failure the batch is simply resolved in index order */
+        (void)wsort(hits, count, sizeof(join_hit_t), join_cmp_main_key, j);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        int rc = join_deliver(j, &hits[i].index_key, &hits[i].main_key);
+        if (rc != WTREE3_OK) return rc;
+    }
+    return WTREE3_OK;
+}
+
+/* Find index_name in a pinned set, ready to scan */
+static wtree3_index_t *join_find_index(const index_set_t *set, const char *index_name,
+                                       gerror_t *error) {
+    wtree3_index_t *idx = index_set_find(set, index_name);
+    if (!idx) {
+        set_error(error, WTREE3_LIB, WTREE3_NOT_FOUND,
+                 "Index '%s' not found", index_name);
+        return NULL;
+    }
+
+    /* Partially built indexes would return incomplete results */
+    if (idx->building) {
+        set_error(error, WTREE3_LIB, WTREE3_NOT_FOUND,
+                 "Index '%s' is still being built", index_name);
+        return NULL;
+    }
+    return idx;
+}
+
+/* ============================================================
+ * Join Engine
+ * ============================================================ */
+
+static int join_run(MDB_txn *txn, wtree3_tree_t *tree, wtree3_index_t *idx,
+                    const MDB_val *start, const MDB_val *end,
+                    unsigned int flags,
+                    wtree3_join_fn join_fn, void *user_data,
+                    gerror_t *error) {
+    join_hit_t *hits = NULL;
+    if (flags & WTREE3_JOIN_SORTED) {
+        hits = malloc(JOIN_BATCH_SIZE * sizeof(join_hit_t));
+        if (WTREE_UNLIKELY(!hits)) {
+            set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate join batch");
+            return WTREE3_ENOMEM;
+        }
+    }
+
+    MDB_cursor *idx_cursor = NULL;
+    join_ctx_t j = {.txn = txn, .tree = tree, .idx = idx,
+                    .join_fn = join_fn, .user_data = user_data, .error = error};
+
+    int rc = mdb_cursor_open(txn, idx->dbi, &idx_cursor);
+    if (rc == 0) rc = mdb_cursor_open(txn, tree->dbi, &j.main_cursor);
+    if (WTREE_UNLIKELY(rc != 0)) {
+        if (idx_cursor) mdb_cursor_close(idx_cursor);
+        free(hits);
+        return translate_mdb_error(rc, error);
+    }
+
+    MDB_val ikey, mkey;
+    if (start) {
+        ikey = *start;
+        rc = mdb_cursor_get(idx_cursor, &ikey, &mkey, MDB_SET_RANGE);
+    } else {
+        rc = mdb_cursor_get(idx_cursor, &ikey, &mkey, MDB_FIRST);
+    }
+
+    size_t pending = 0;
+    int result = WTREE3_OK;
+    while (rc == 0) {
+        if (end && mdb_cmp(txn, idx->dbi, &ikey, end) > 0) break;
+
+        /* Covering entries carry a payload after the main key */
+        if (WTREE_UNLIKELY(idx->project_fn) && !index_dup_split(true, &mkey, &mkey, NULL)) {
+            set_error(error, WTREE3_LIB, WTREE3_INDEX_ERROR,
+                     "Index '%s': malformed covering entry", idx->name);
+            result = WTREE3_INDEX_ERROR;
+            break;
+        }
+
+        if (hits) {
+            hits[pending].index_key = ikey;
+            hits[pending].main_key = mkey;
+            if (++pending == JOIN_BATCH_SIZE) {
+                result = join_flush(&j, hits, pending);
+                pending = 0;
+            }
+        } else {
+            result = join_deliver(&j, &ikey, &mkey);
+        }
+        if (result != WTREE3_OK) break;
+
+        rc = mdb_cursor_get(idx_cursor, &ikey, &mkey, MDB_NEXT);
+    }
+
+    if (result == WTREE3_OK && rc != 0 && rc != MDB_NOTFOUND) {
+        result = translate_mdb_error(rc, error);
+    }
+    if (result == WTREE3_OK && pending > 0) {
+        result = join_flush(&j, hits, pending);
+    }
+
+    mdb_cursor_close(j.main_cursor);
+    mdb_cursor_close(idx_cursor);
+    codec_buf_release(&j.decoded);
+    free(hits);
+
+    /* Early termination by the callback is not an error */
+    return result == 1 ? WTREE3_OK : result;
+}
+
+/* ============================================================
+ * Public API
+ * ============================================================ */
+
+WTREE_WARN_UNUSED
+int wtree3_index_scan_join_txn(wtree3_txn_t *txn,
+                               wtree3_tree_t *tree,
+                               const char *index_name,
+                               const void *start_key, size_t start_len,
+                               const void *end_key, size_t end_len,
+                               unsigned int flags,
+                               wtree3_join_fn join_fn,
+                               void *user_data,
+                               gerror_t *error) {
+    if (WTREE_UNLIKELY(!txn || !tree || !index_name || !join_fn)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+
+    /* Pinned for the whole scan: a concurrent drop_index waits for it */
+    index_pin_t pin;
+    wtree3_index_t *idx = join_find_index(index_set_pin(tree, &pin), index_name, error);
+    if (!idx) {
+        index_set_unpin(&pin);
+        return WTREE3_NOT_FOUND;
+    }
+
+    MDB_val start = {.mv_size = start_len, .mv_data = (void *)start_key};
+    MDB_val end = {.mv_size = end_len, .mv_data = (void *)end_key};
+    int rc = join_run(txn->txn, tree, idx,
+                      start_key ? &start : NULL, end_key ? &end : NULL,
+                      flags, join_fn, user_data, error);
+    index_set_unpin(&pin);
+    return rc;
+}
+
+WTREE_WARN_UNUSED
+int wtree3_index_get_many_txn(wtree3_txn_t *txn,
+                              wtree3_tree_t *tree,
+                              const char *index_name,
+                              const void *key, size_t key_len,
+                              unsigned int flags,
+                              wtree3_join_fn join_fn,
+                              void *user_data,
+                              gerror_t *error) {
+    if (WTREE_UNLIKELY(!key)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+    return wtree3_index_scan_join_txn(txn, tree, index_name,
+                                      key, key_len, key, key_len,
+                                      flags, join_fn, user_data, error);
+}
+
+WTREE_WARN_UNUSED
+int wtree3_index_scan_join(wtree3_tree_t *tree,
+                           const char *index_name,
+                           const void *start_key, size_t start_len,
+                           const void *end_key, size_t end_len,
+                           unsigned int flags,
+                           wtree3_join_fn join_fn,
+                           void *user_data,
+                           gerror_t *error) {
+    if (WTREE_UNLIKELY(!tree || !index_name || !join_fn)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+
+    wtree3_txn_t *txn = read_pool_acquire(tree->db, error);
+    if (WTREE_UNLIKELY(!txn)) return WTREE3_ERROR;
+
+    int rc = wtree3_index_scan_join_txn(txn, tree, index_name,
+                                        start_key, start_len, end_key, end_len,
+                                        flags, join_fn, user_data, error);
+    read_pool_release(txn);
+    return rc;
+}
+
+WTREE_WARN_UNUSED
+int wtree3_index_get_many(wtree3_tree_t *tree,
+                          const char *index_name,
+                          const void *key, size_t key_len,
+                          unsigned int flags,
+                          wtree3_join_fn join_fn,
+                          void *user_data,
+                          gerror_t *error) {
+    if (WTREE_UNLIKELY(!key)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+    return wtree3_index_scan_join(tree, index_name,
+                                  key, key_len, key, key_len,
+                                  flags, join_fn, user_data, error);
+}
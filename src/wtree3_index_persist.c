@@ -8,6 +8,22 @@
  *
  * Metadata format (16 bytes + user_data):
  *   [extractor_id:8][flags:4][user_data_len:4][user_data:N]
+ *
+ * While an online build is in progress (META_FLAG_BUILDING) the progress
+ * cursor follows user_data:
+ *   [cursor_len:4][cursor:M]   (cursor_len 0 = nothing built yet)
+ *
+ * Covering indexes (META_FLAG_COVERING) store no extra fields: their
+ * projection is resolved from the registry at load time, like extractors.
+ *
+ * Indexes with a declarative key (META_FLAG_KEY_SPEC) append the spec
+ * last, so no extractor has to be registered to load them:
+ *   [spec_len:4][spec:S]       (see key_spec_serialize)
+ *
+ * Indexes over fixed-width main keys (META_FLAG_DUPFIXED, plus
+ * META_FLAG_INTEGERDUP on MDB_INTEGERKEY trees) end with the width, so
+ * the DBI is reopened with the same packing:
+ *   [main_key_size:4]
  */
 
 #include "wtree3_internal.h"
@@ -34,6 +50,11 @@
 /* Flag bits */
 #define META_FLAG_UNIQUE            0x01
 #define META_FLAG_SPARSE            0x02
+#define META_FLAG_BUILDING          0x04
+#define META_FLAG_COVERING          0x08
+#define META_FLAG_KEY_SPEC          0x10
+#define META_FLAG_DUPFIXED          0x20
+#define META_FLAG_INTEGERDUP        0x40
 
 /*
  * In-memory representation of index metadata
@@ -45,6 +66,13 @@ typedef struct {
     bool sparse;
     void *user_data;
     size_t user_data_len;
+    bool building;
+    void *build_cursor;
+    size_t build_cursor_len;
+    bool covering;
+    wtree3_key_spec_t *key_spec;    /* NULL = registered extractor */
+    uint32_t main_key_size;         /* 0 = variable-width main keys */
+    bool integer_dups;
 } index_metadata_t;
 
 /* ============================================================
@@ -63,6 +91,10 @@ static uint8_t* serialize_index_metadata(const index_metadata_t *meta, size_t *o
     }
 
     size_t total_len = META_HEADER_SIZE + meta->user_data_len;
+    if (meta->building) total_len += META_USERDATA_LEN_SIZE + meta->build_cursor_len;
+    size_t spec_len = meta->key_spec ? key_spec_serialized_size(meta->key_spec) : 0;
+    if (meta->key_spec) total_len += META_USERDATA_LEN_SIZE + spec_len;
+    if (meta->main_key_size) total_len += META_USERDATA_LEN_SIZE;
     uint8_t *buffer = malloc(total_len);
     if (WTREE_UNLIKELY(!buffer)) {
         return NULL;
@@ -75,6 +107,11 @@ static uint8_t* serialize_index_metadata(const index_metadata_t *meta, size_t *o
     uint32_t flags = 0;
     if (meta->unique) flags |= META_FLAG_UNIQUE;
     if (meta->sparse) flags |= META_FLAG_SPARSE;
+    if (meta->building) flags |= META_FLAG_BUILDING;
+    if (meta->covering) flags |= META_FLAG_COVERING;
+    if (meta->key_spec) flags |= META_FLAG_KEY_SPEC;
+    if (meta->main_key_size) flags |= META_FLAG_DUPFIXED;
+    if (meta->integer_dups) flags |= META_FLAG_INTEGERDUP;
     memcpy(buffer + META_FLAGS_OFFSET, &flags, META_FLAGS_SIZE);
 
     /* Write user_data length at offset 12 */
@@ -86,6 +123,30 @@ static uint8_t* serialize_index_metadata(const index_metadata_t *meta, size_t *o
         memcpy(buffer + META_USERDATA_OFFSET, meta->user_data, meta->user_data_len);
     }
 
+    /* Write build cursor after user_data */
+    uint8_t *p = buffer + META_USERDATA_OFFSET + meta->user_data_len;
+    if (meta->building) {
+        uint32_t cursor_len = (uint32_t)meta->build_cursor_len;
+        memcpy(p, &cursor_len, META_USERDATA_LEN_SIZE);
+        if (cursor_len > 0) {
+            memcpy(p + META_USERDATA_LEN_SIZE, meta->build_cursor, cursor_len);
+        }
+        p += META_USERDATA_LEN_SIZE + cursor_len;
+    }
+
+    /* Write key spec */
+    if (meta->key_spec) {
+        uint32_t len32 = (uint32_t)spec_len;
+        memcpy(p, &len32, META_USERDATA_LEN_SIZE);
+        key_spec_serialize(meta->key_spec, p + META_USERDATA_LEN_SIZE);
+        p += META_USERDATA_LEN_SIZE + spec_len;
+    }
+
+    /* Write main key width last */
+    if (meta->main_key_size) {
+        memcpy(p, &meta->main_key_size, META_USERDATA_LEN_SIZE);
+    }
+
     *out_len = total_len;
     return buffer;
 }
@@ -117,6 +178,13 @@ static int deserialize_index_metadata(const void *data, size_t data_len,
     memcpy(&flags, buffer + META_FLAGS_OFFSET, META_FLAGS_SIZE);
     out_meta->unique = (flags & META_FLAG_UNIQUE) != 0;
     out_meta->sparse = (flags & META_FLAG_SPARSE) != 0;
+    out_meta->building = (flags & META_FLAG_BUILDING) != 0;
+    out_meta->covering = (flags & META_FLAG_COVERING) != 0;
+    out_meta->build_cursor = NULL;
+    out_meta->build_cursor_len = 0;
+    out_meta->key_spec = NULL;
+    out_meta->main_key_size = 0;
+    out_meta->integer_dups = (flags & META_FLAG_INTEGERDUP) != 0;
 
     /* Read user_data length */
     uint32_t ud_len;
@@ -142,51 +210,98 @@ static int deserialize_index_metadata(const void *data, size_t data_len,
         out_meta->user_data_len = 0;
     }
 
+    /* Read build cursor if an online build is in progress */
+    size_t off = META_USERDATA_OFFSET + ud_len;
+    if (out_meta->building) {
+        uint32_t cursor_len = 0;
+        if (WTREE_UNLIKELY(data_len < off + META_USERDATA_LEN_SIZE)) goto truncated;
+        memcpy(&cursor_len, buffer + off, META_USERDATA_LEN_SIZE);
+        off += META_USERDATA_LEN_SIZE;
+        if (WTREE_UNLIKELY(data_len < off + cursor_len)) goto truncated;
+
+        if (cursor_len > 0) {
+            out_meta->build_cursor = malloc(cursor_len);
+            if (WTREE_UNLIKELY(!out_meta->build_cursor)) {
+                free(out_meta->user_data);
+                set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate build cursor");
+                return WTREE3_ENOMEM;
+            }
+            memcpy(out_meta->build_cursor, buffer + off, cursor_len);
+            out_meta->build_cursor_len = cursor_len;
+        }
+        off += cursor_len;
+    }
+
+    /* Read key spec */
+    if (flags & META_FLAG_KEY_SPEC) {
+        uint32_t spec_len = 0;
+        if (WTREE_UNLIKELY(data_len < off + META_USERDATA_LEN_SIZE)) goto bad_spec;
+        memcpy(&spec_len, buffer + off, META_USERDATA_LEN_SIZE);
+        off += META_USERDATA_LEN_SIZE;
+        if (WTREE_UNLIKELY(data_len < off + spec_len)) goto bad_spec;
+
+        out_meta->key_spec = malloc(sizeof(wtree3_key_spec_t));
+        if (WTREE_UNLIKELY(!out_meta->key_spec)) {
+            free(out_meta->user_data);
+            free(out_meta->build_cursor);
+            set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate key spec");
+            return WTREE3_ENOMEM;
+        }
+        if (WTREE_UNLIKELY(!key_spec_deserialize(buffer + off, spec_len, out_meta->key_spec))) {
+            free(out_meta->key_spec);
+            out_meta->key_spec = NULL;
+            goto bad_spec;
+        }
+        off += spec_len;
+    }
+
+    /* Read main key width */
+    if (flags & META_FLAG_DUPFIXED) {
+        if (WTREE_UNLIKELY(data_len < off + META_USERDATA_LEN_SIZE)) {
+            free(out_meta->user_data);
+            free(out_meta->build_cursor);
+            free(out_meta->key_spec);
+            set_error(error, WTREE3_LIB, WTREE3_ERROR, "Invalid metadata format: main key size truncated");
+            return WTREE3_ERROR;
+        }
+        memcpy(&out_meta->main_key_size, buffer + off, META_USERDATA_LEN_SIZE);
+    }
+
     return WTREE3_OK;
+
+truncated:
+    free(out_meta->user_data);
+    set_error(error, WTREE3_LIB, WTREE3_ERROR, "Invalid metadata format: build cursor truncated");
+    return WTREE3_ERROR;
+
+bad_spec:
+    free(out_meta->user_data);
+    free(out_meta->build_cursor);
+    set_error(error, WTREE3_LIB, WTREE3_ERROR, "Invalid metadata format: bad key spec");
+    return WTREE3_ERROR;
 }
 
 /* ============================================================
  * Metadata Save/Load Operations
  * ============================================================ */
 
-/* Helper context for save_index_metadata transaction */
-typedef struct {
-    wtree3_tree_t *tree;
-    const char *index_name;
-    uint8_t *meta_value;
-    size_t meta_len;
-    gerror_t *error;
-} save_metadata_ctx_t;
-
-static int save_metadata_txn(MDB_txn *txn, void *user_data) {
-    save_metadata_ctx_t *ctx = (save_metadata_ctx_t *)user_data;
-    return metadata_put_txn(txn, ctx->tree->db, ctx->tree->name, ctx->index_name,
-                           ctx->meta_value, ctx->meta_len, ctx->error);
-}
-
-WTREE_COLD
-int save_index_metadata(wtree3_tree_t *tree,
-                         const char *index_name,
-                         gerror_t *error) {
-    if (WTREE_UNLIKELY(!tree || !index_name)) {
-        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
-        return WTREE3_EINVAL;
-    }
-
-    wtree3_index_t *idx = find_index(tree, index_name);
-    if (WTREE_UNLIKELY(!idx)) {
-        set_error(error, WTREE3_LIB, WTREE3_NOT_FOUND,
-                 "Index '%s' not found", index_name);
-        return WTREE3_NOT_FOUND;
-    }
-
+WTREE_COLD WTREE_WARN_UNUSED
+int save_index_metadata_txn(MDB_txn *txn, wtree3_tree_t *tree, wtree3_index_t *idx,
+                            gerror_t *error) {
     /* Build metadata struct from index */
     index_metadata_t meta = {
         .extractor_id = idx->extractor_id,
         .unique = idx->unique,
         .sparse = idx->sparse,
         .user_data = idx->user_data,
-        .user_data_len = idx->user_data_len
+        .user_data_len = idx->user_data_len,
+        .building = idx->building,
+        .build_cursor = idx->build_cursor.mv_data,
+        .build_cursor_len = idx->build_cursor.mv_data ? idx->build_cursor.mv_size : 0,
+        .covering = idx->project_fn != NULL,
+        .key_spec = idx->key_spec,
+        .main_key_size = idx->main_key_size,
+        .integer_dups = idx->integer_dups
     };
 
     /* Serialize to binary format */
@@ -198,18 +313,40 @@ int save_index_metadata(wtree3_tree_t *tree,
     }
 
     /* Store in metadata DBI */
+    int rc = metadata_put_txn(txn, tree->db, tree->name, idx->name,
+                              meta_value, meta_len, error);
+    free(meta_value);
+    return rc;
+}
+
+/* Helper context for save_index_metadata transaction */
+typedef struct {
+    wtree3_tree_t *tree;
+    wtree3_index_t *idx;
+    gerror_t *error;
+} save_metadata_ctx_t;
+
+static int save_metadata_txn(MDB_txn *txn, void *user_data) {
+    save_metadata_ctx_t *ctx = (save_metadata_ctx_t *)user_data;
+    return save_index_metadata_txn(txn, ctx->tree, ctx->idx, ctx->error);
+}
+
+WTREE_COLD
+int save_index_metadata(wtree3_tree_t *tree,
+                         wtree3_index_t *idx,
+                         gerror_t *error) {
+    if (WTREE_UNLIKELY(!tree || !idx)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+
     save_metadata_ctx_t ctx = {
         .tree = tree,
-        .index_name = index_name,
-        .meta_value = meta_value,
-        .meta_len = meta_len,
+        .idx = idx,
         .error = error
     };
 
-    int rc = with_write_txn(tree->db, save_metadata_txn, &ctx, error);
-    free(meta_value);
-
-    return rc;
+    return with_write_txn(tree->db, save_metadata_txn, &ctx, error);
 }
 
 /* Helper context for reading metadata */
@@ -221,6 +358,13 @@ typedef struct {
     bool sparse;
     void *user_data;
     size_t user_data_len;
+    bool building;
+    void *build_cursor;
+    size_t build_cursor_len;
+    bool covering;
+    wtree3_key_spec_t *key_spec;
+    uint32_t main_key_size;
+    bool integer_dups;
     gerror_t *error;
 } read_metadata_ctx_t;
 
@@ -247,6 +391,13 @@ static int read_metadata_txn(MDB_txn *txn, void *user_data_param) {
     ctx->sparse = meta.sparse;
     ctx->user_data = meta.user_data;
     ctx->user_data_len = meta.user_data_len;
+    ctx->building = meta.building;
+    ctx->build_cursor = meta.build_cursor;
+    ctx->build_cursor_len = meta.build_cursor_len;
+    ctx->covering = meta.covering;
+    ctx->key_spec = meta.key_spec;
+    ctx->main_key_size = meta.main_key_size;
+    ctx->integer_dups = meta.integer_dups;
 
     return WTREE3_OK;
 }
@@ -255,11 +406,14 @@ static int read_metadata_txn(MDB_txn *txn, void *user_data_param) {
 typedef struct {
     const char *idx_tree_name;
     MDB_dbi *out_dbi;
+    unsigned int flags;             /* index_dbi_flags */
+    bool covering;
 } open_index_dbi_ctx_t;
 
 static int open_index_dbi_txn(MDB_txn *txn, void *user_data_param) {
     open_index_dbi_ctx_t *ctx = (open_index_dbi_ctx_t *)user_data_param;
-    int rc = mdb_dbi_open(txn, ctx->idx_tree_name, MDB_DUPSORT, ctx->out_dbi);
+    int rc = mdb_dbi_open(txn, ctx->idx_tree_name, ctx->flags, ctx->out_dbi);
+    if (rc == 0 && ctx->covering) rc = mdb_set_dupsort(txn, *ctx->out_dbi, index_covering_dcmp);
     return rc != 0 ? rc : WTREE3_OK;
 }
 
@@ -275,7 +429,7 @@ int load_index_metadata(wtree3_tree_t *tree, const char *index_name, gerror_t *e
     }
 
     /* Check if index already loaded */
-    if (WTREE_UNLIKELY(find_index(tree, index_name))) {
+    if (WTREE_UNLIKELY(index_set_find(tree->index_set, index_name))) {
         /* Already loaded, skip */
         return WTREE3_OK;
     }
@@ -286,6 +440,7 @@ int load_index_metadata(wtree3_tree_t *tree, const char *index_name, gerror_t *e
         .index_name = index_name,
         .user_data = NULL,
         .user_data_len = 0,
+        .build_cursor = NULL,
         .error = error
     };
 
@@ -294,16 +449,37 @@ int load_index_metadata(wtree3_tree_t *tree, const char *index_name, gerror_t *e
         return rc;
     }
 
-    /* Look up extractor function */
-    wtree3_index_key_fn key_fn = find_extractor(tree->db, meta_ctx.extractor_id);
-    if (WTREE_UNLIKELY(!key_fn)) {
+    /* Look up extractor function (declarative keys need none) */
+    wtree3_index_key_fn key_fn = NULL;
+    wtree3_index_key_into_fn key_into_fn = NULL;
+    if (!meta_ctx.key_spec) {
+        key_fn = find_extractor(tree->db, meta_ctx.extractor_id);
+        key_into_fn = key_fn ? NULL : find_extractor_into(tree->db, meta_ctx.extractor_id);
+    }
+    if (WTREE_UNLIKELY(!meta_ctx.key_spec && !key_fn && !key_into_fn)) {
         free(meta_ctx.user_data);
+        free(meta_ctx.build_cursor);
         /* Extractor not registered - log warning and skip */
         fprintf(stderr, "Warning: Skipping index '%s' - extractor 0x%016llx not registered\n",
                 index_name, (unsigned long long)meta_ctx.extractor_id);
         return WTREE3_OK;  /* Not an error - just skip */
     }
 
+    /* Covering indexes also need their projection */
+    wtree3_index_key_fn project_fn = NULL;
+    if (meta_ctx.covering) {
+        uint64_t projection_id = meta_ctx.extractor_id | INDEX_PROJECTION_ID_FLAG;
+        project_fn = find_extractor(tree->db, projection_id);
+        if (WTREE_UNLIKELY(!project_fn)) {
+            free(meta_ctx.user_data);
+            free(meta_ctx.build_cursor);
+            free(meta_ctx.key_spec);
+            fprintf(stderr, "Warning: Skipping index '%s' - projection 0x%016llx not registered\n",
+                    index_name, (unsigned long long)projection_id);
+            return WTREE3_OK;
+        }
+    }
+
     /* Open existing index DBI */
     char *idx_tree_name = build_index_tree_name(tree->name, index_name);
     if (!idx_tree_name) {
@@ -315,7 +491,9 @@ int load_index_metadata(wtree3_tree_t *tree, const char *index_name, gerror_t *e
     MDB_dbi idx_dbi;
     open_index_dbi_ctx_t open_ctx = {
         .idx_tree_name = idx_tree_name,
-        .out_dbi = &idx_dbi
+        .out_dbi = &idx_dbi,
+        .flags = index_dbi_flags(meta_ctx.main_key_size, meta_ctx.integer_dups),
+        .covering = meta_ctx.covering
     };
 
     rc = with_write_txn(tree->db, open_index_dbi_txn, &open_ctx, error);
@@ -342,17 +520,24 @@ int load_index_metadata(wtree3_tree_t *tree, const char *index_name, gerror_t *e
     idx->dbi = idx_dbi;
     idx->extractor_id = meta_ctx.extractor_id;
     idx->key_fn = key_fn;
+    idx->key_into_fn = key_into_fn;
+    idx->key_spec = meta_ctx.key_spec;
     idx->user_data = meta_ctx.user_data;
     idx->user_data_len = meta_ctx.user_data_len;
     idx->unique = meta_ctx.unique;
     idx->sparse = meta_ctx.sparse;
     idx->compare = NULL;  /* Not persisted */
     idx->dupsort_compare = NULL;  /* Not persisted */
-
-    /* Add to vector */
-    if (!wvector_push(tree->indexes, idx)) {
-        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to add index to vector");
-        rc = WTREE3_ENOMEM;
+    idx->project_fn = project_fn;
+    idx->main_key_size = meta_ctx.main_key_size;
+    idx->integer_dups = meta_ctx.integer_dups;
+    idx->building = meta_ctx.building;  /* Resume point of an interrupted online build */
+    idx->build_cursor.mv_data = meta_ctx.build_cursor;
+    idx->build_cursor.mv_size = meta_ctx.build_cursor_len;
+
+    /* Add to the tree's index set */
+    rc = index_set_publish(tree, idx, NULL, NULL, error);
+    if (rc != 0) {
         goto cleanup_idx_name;
     }
 
@@ -370,6 +555,8 @@ cleanup_tree_name:
     free(idx_tree_name);
 cleanup_user_data:
     free(meta_ctx.user_data);
+    free(meta_ctx.build_cursor);
+    free(meta_ctx.key_spec);
     return rc;
 }
 
@@ -406,6 +593,8 @@ static int get_extractor_id_txn(MDB_txn *txn, void *user_data) {
 
     /* Free user_data since we don't need it */
     free(meta.user_data);
+    free(meta.build_cursor);
+    free(meta.key_spec);
 
     return WTREE3_OK;
 }
@@ -421,11 +610,14 @@ int wtree3_index_get_extractor_id(wtree3_tree_t *tree,
     }
 
     /* Check if index is loaded */
-    wtree3_index_t *idx = find_index(tree, index_name);
+    index_pin_t pin;
+    wtree3_index_t *idx = index_set_find(index_set_pin(tree, &pin), index_name);
     if (WTREE_LIKELY(idx)) {
         *out_extractor_id = idx->extractor_id;
+        index_set_unpin(&pin);
         return WTREE3_OK;
     }
+    index_set_unpin(&pin);
 
     /* Read from metadata */
     get_extractor_id_ctx_t ctx = {
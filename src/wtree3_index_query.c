@@ -0,0 +1,543 @@
+/*
+ * wtree3_index_query.c - Multi-Index Intersection and Union Queries
+ *
+ * Combines N index predicates into one stream of main keys without
+ * materializing whole posting lists. Inside one index key, DUPSORT
+ * duplicates are already sorted by main key, so every exact-key
+ * predicate is a sorted main-key stream positioned on its own cursor:
+ *
+ * - AND: leapfrog intersection. Each stream seeks to the largest main key
+ *   seen so far with MDB_GET_BOTH_RANGE, so the larger posting lists are
+ *   skipped page-wise instead of being read entry by entry.
+ * - OR: k-way merge of the streams, emitting each main key once.
+ *
+ * Range predicates span several index keys whose duplicates are not in
+ * one global main-key order; those (and indexes with a custom dupsort
+ * comparator or MDB_INTEGERDUP duplicates) are gathered into a sorted
+ * array first. Everything else is streamed.
+ *
+ * Main keys are merged in LMDB's default dup order (memcmp, then length).
+ *
+ * Posting lists of one index key are handed out a page at a time; on
+ * fixed-width (MDB_DUPFIXED) indexes a page is one MDB_GET_MULTIPLE /
+ * MDB_NEXT_MULTIPLE result, a contiguous array of main keys.
+ *
+ * This module provides:
+ * - wtree3_index_query_txn, wtree3_index_query
+ * - wtree3_index_get_all_txn, wtree3_index_get_all
+ * - Internal: index_cursor_page (also behind wtree3_index_handle_next_page)
+ */
+
+#include "wtree3_internal.h"
+#include "macros.h"
+
+/* ============================================================
+ * Internal Structures
+ * ============================================================ */
+
+typedef struct {
+    wtree3_index_t *idx;
+    MDB_cursor *cursor;             /* Streamed: cursor on the index key */
+    MDB_val ikey;                   /* Streamed: the index key */
+    MDB_val *keys;                  /* Gathered: sorted main keys */
+    size_t count;
+    size_t pos;
+    MDB_val cur;                    /* Current main key */
+    bool done;
+} query_stream_t;
+
+/* ============================================================
+ * Helpers
+ * ============================================================ */
+
+WTREE_PURE
+static int main_key_cmp(const MDB_val *a, const MDB_val *b) {
+    size_t len = a->mv_size < b->mv_size ? a->mv_size : b->mv_size;
+    int c = len ? memcmp(a->mv_data, b->mv_data, len) : 0;
+    if (c != 0) return c;
+    return a->mv_size < b->mv_size ? -1 : (a->mv_size > b->mv_size ? 1 : 0);
+}
+
+static int main_key_sort_cmp(const void *a, const void *b, void *ctx) {
+    (void)ctx;
+    return main_key_cmp((const MDB_val *)a, (const MDB_val *)b);
+}
+
+/* Find index_name in a pinned set, ready to scan */
+static wtree3_index_t *query_find_index(const index_set_t *set, const char *index_name,
+                                        gerror_t *error) {
+    wtree3_index_t *idx = index_set_find(set, index_name);
+    if (!idx) {
+        set_error(error, WTREE3_LIB, WTREE3_NOT_FOUND,
+                 "Index '%s' not found", index_name);
+        return NULL;
+    }
+
+    /* Partially built indexes would return incomplete results */
+    if (idx->building) {
+        set_error(error, WTREE3_LIB, WTREE3_NOT_FOUND,
+                 "Index '%s' is still being built", index_name);
+        return NULL;
+    }
+    return idx;
+}
+
+/* Main key part of a dup value; false for a malformed covering entry */
+static inline bool stream_main_key(const query_stream_t *s, const MDB_val *dup, MDB_val *out) {
+    return index_dup_split(s->idx->project_fn != NULL, dup, out, NULL);
+}
+
+static int malformed_entry(const query_stream_t *s, gerror_t *error) {
+    set_error(error, WTREE3_LIB, WTREE3_INDEX_ERROR,
+             "Index '%s': malformed covering entry", s->idx->name);
+    return WTREE3_INDEX_ERROR;
+}
+
+/* ============================================================
+ * Posting-List Pages
+ * ============================================================ */
+
+WTREE_HOT
+int index_cursor_page(MDB_cursor *cursor, const wtree3_index_t *idx, const MDB_val *cur,
+                      wtree3_index_page_t *page, gerror_t *error) {
+    MDB_val key, dup = {0, NULL};
+    int rc;
+
+    /* Variable-width dups: one main key per page */
+    if (!idx->main_key_size) {
+        if (cur) {
+            dup = *cur;
+        } else {
+            rc = mdb_cursor_get(cursor, &key, &dup, MDB_NEXT_DUP);
+            if (rc == MDB_NOTFOUND) return WTREE3_NOT_FOUND;
+            if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+        }
+
+        MDB_val main_key;
+        if (WTREE_UNLIKELY(!index_dup_split(idx->project_fn != NULL, &dup, &main_key, NULL))) {
+            set_error(error, WTREE3_LIB, WTREE3_INDEX_ERROR,
+                     "Index '%s': malformed covering entry", idx->name);
+            return WTREE3_INDEX_ERROR;
+        }
+        page->main_keys = main_key.mv_data;
+        page->count = 1;
+        page->key_size = main_key.mv_size;
+        return WTREE3_OK;
+    }
+
+    rc = mdb_cursor_get(cursor, &key, &dup, cur ? MDB_GET_MULTIPLE : MDB_NEXT_MULTIPLE);
+    if (rc == MDB_NOTFOUND) return WTREE3_NOT_FOUND;
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+
+    const unsigned char *start = (const unsigned char *)dup.mv_data;
+    const unsigned char *end = start + dup.mv_size;
+    if (cur) {
+        const unsigned char *at = (const unsigned char *)cur->mv_data;
+        if (!start) {
+            /* A lone dup has no sub-page, and LMDB leaves dup unset */
+            start = at;
+            end = at + cur->mv_size;
+        } else if (at >= start && at < end) {
+            /* The page starts at its first dup, not where the cursor was */
+            start = at;
+        }
+    }
+
+    page->main_keys = start;
+    page->key_size = idx->main_key_size;
+    page->count = (size_t)(end - start) / page->key_size;
+    return page->count ? WTREE3_OK : WTREE3_NOT_FOUND;
+}
+
+/* ============================================================
+ * Streams
+ * ============================================================ */
+
+/* Take the cursor's current dup as the stream position */
+static int stream_take(query_stream_t *s, int rc, const MDB_val *dup, gerror_t *error) {
+    if (rc == MDB_NOTFOUND) {
+        s->done = true;
+        return WTREE3_OK;
+    }
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+    if (WTREE_UNLIKELY(!stream_main_key(s, dup, &s->cur))) return malformed_entry(s, error);
+    return WTREE3_OK;
+}
+
+/* Gather the main keys of [start, end] and sort them */
+static int stream_gather(query_stream_t *s, MDB_txn *txn,
+                         const MDB_val *start, const MDB_val *end, gerror_t *error) {
+    MDB_cursor *cursor;
+    int rc = mdb_cursor_open(txn, s->idx->dbi, &cursor);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+
+    size_t cap = 0;
+    MDB_val ikey, dup;
+    if (start) {
+        ikey = *start;
+        rc = mdb_cursor_get(cursor, &ikey, &dup, MDB_SET_RANGE);
+    } else {
+        rc = mdb_cursor_get(cursor, &ikey, &dup, MDB_FIRST);
+    }
+
+    int result = WTREE3_OK;
+    while (rc == 0) {
+        if (end && mdb_cmp(txn, s->idx->dbi, &ikey, end) > 0) break;
+
+        if (s->count == cap) {
+            size_t new_cap = cap ? cap * 2 : 64;
+            MDB_val *grown = realloc(s->keys, new_cap * sizeof(MDB_val));
+            if (WTREE_UNLIKELY(!grown)) {
+                set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate query buffer");
+                result = WTREE3_ENOMEM;
+                break;
+            }
+            s->keys = grown;
+            cap = new_cap;
+        }
+        if (WTREE_UNLIKELY(!stream_main_key(s, &dup, &s->keys[s->count]))) {
+            result = malformed_entry(s, error);
+            break;
+        }
+        s->count++;
+
+        rc = mdb_cursor_get(cursor, &ikey, &dup, MDB_NEXT);
+    }
+    mdb_cursor_close(cursor);
+
+    if (result != WTREE3_OK) return result;
+    if (WTREE_UNLIKELY(rc != 0 && rc != MDB_NOTFOUND)) return translate_mdb_error(rc, error);
+
+    if (s->count > 1 &&
+        WTREE_UNLIKELY(!wsort(s->keys, s->count, sizeof(MDB_val), main_key_sort_cmp, NULL))) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to sort query buffer");
+        return WTREE3_ENOMEM;
+    }
+
+    s->done = (s->count == 0);
+    if (!s->done) s->cur = s->keys[0];
+    return WTREE3_OK;
+}
+
+static int stream_open(query_stream_t *s, MDB_txn *txn,
+                       const wtree3_index_pred_t *pred, gerror_t *error) {
+    MDB_val start = {.mv_size = pred->key_len, .mv_data = (void *)pred->key};
+    MDB_val end = {.mv_size = pred->end_len, .mv_data = (void *)pred->end_key};
+
+    /* Only one index key's dups are in main-key order */
+    if (pred->range || s->idx->dupsort_compare || s->idx->integer_dups) {
+        bool exact = !pred->range;
+        return stream_gather(s, txn, pred->key ? &start : NULL,
+                             exact ? &start : (pred->end_key ? &end : NULL), error);
+    }
+
+    int rc = mdb_cursor_open(txn, s->idx->dbi, &s->cursor);
+    if (WTREE_UNLIKELY(rc != 0)) {
+        s->cursor = NULL;
+        return translate_mdb_error(rc, error);
+    }
+
+    s->ikey = start;
+    MDB_val key = start, dup;
+    rc = mdb_cursor_get(s->cursor, &key, &dup, MDB_SET_KEY);
+    return stream_take(s, rc, &dup, error);
+}
+
+static int stream_next(query_stream_t *s, gerror_t *error) {
+    if (s->keys) {
+        if (++s->pos >= s->count) s->done = true;
+        else s->cur = s->keys[s->pos];
+        return WTREE3_OK;
+    }
+
+    MDB_val key, dup;
+    int rc = mdb_cursor_get(s->cursor, &key, &dup, MDB_NEXT_DUP);
+    return stream_take(s, rc, &dup, error);
+}
+
+/* Advance to the first main key >= target */
+static int stream_seek(query_stream_t *s, const MDB_val *target, gerror_t *error) {
+    if (main_key_cmp(&s->cur, target) >= 0) return WTREE3_OK;
+
+    if (s->keys) {
+        /* Gallop, then binary search the bracket */
+        size_t lo = s->pos + 1, step = 1;
+        size_t hi = lo;
+        while (hi < s->count && main_key_cmp(&s->keys[hi], target) < 0) {
+            lo = hi + 1;
+            hi += step;
+            step *= 2;
+        }
+        if (hi > s->count) hi = s->count;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (main_key_cmp(&s->keys[mid], target) < 0) lo = mid + 1;
+            else hi = mid;
+        }
+        s->pos = lo;
+        if (lo >= s->count) s->done = true;
+        else s->cur = s->keys[lo];
+        return WTREE3_OK;
+    }
+
+    /* Covering dups compare by main key, so a probe with no payload works */
+    index_dup_t probe;
+    int rc = index_dup_build(s->idx, target->mv_data, target->mv_size, NULL, 0, &probe, error);
+    if (WTREE_UNLIKELY(rc != 0)) return rc;
+
+    MDB_val key = s->ikey, dup = probe.val;
+    rc = mdb_cursor_get(s->cursor, &key, &dup, MDB_GET_BOTH_RANGE);
+    index_dup_release(&probe);
+    return stream_take(s, rc, &dup, error);
+}
+
+static void stream_close(query_stream_t *s) {
+    if (s->cursor) mdb_cursor_close(s->cursor);
+    free(s->keys);
+}
+
+/* ============================================================
+ * Query Engine
+ * ============================================================ */
+
+typedef struct {
+    wtree3_tree_t *tree;
+    MDB_cursor *main_cursor;        /* Set when values are requested */
+    codec_buf_t decoded;            /* Current value when the tree has a codec */
+    wtree3_scan_fn fn;
+    void *user_data;
+    gerror_t *error;
+} query_out_t;
+
+/* Deliver one main key; 1 means stop */
+static int query_emit(query_out_t *out, const MDB_val *main_key) {
+    MDB_val key = *main_key, val = {0};
+    if (out->main_cursor) {
+        int rc = mdb_cursor_get(out->main_cursor, &key, &val, MDB_SET_KEY);
+        if (WTREE_UNLIKELY(rc == MDB_NOTFOUND)) {
+            set_error(out->error, WTREE3_LIB, WTREE3_INDEX_ERROR,
+                     "Index entry references a missing main tree key (index inconsistency)");
+            return WTREE3_INDEX_ERROR;
+        }
+        if (WTREE_LIKELY(rc == 0)) rc = tree_value_decode(out->tree, &val, &out->decoded);
+        if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, out->error);
+    }
+
+    return out->fn(key.mv_data, key.mv_size, val.mv_data, val.mv_size, out->user_data)
+           ? WTREE3_OK : 1;
+}
+
+/* Leapfrog: seek every stream to the largest key until all agree */
+static int query_intersect(query_stream_t *s, size_t n, query_out_t *out, gerror_t *error) {
+    for (size_t i = 0; i < n; i++) {
+        if (s[i].done) return WTREE3_OK;
+    }
+
+    MDB_val target = s[0].cur;
+    size_t agree = 1, i = 0;
+    for (;;) {
+        if (agree == n) {
+            int rc = query_emit(out, &target);
+            if (rc != WTREE3_OK) return rc;
+
+            rc = stream_next(&s[i], error);
+            if (rc != WTREE3_OK || s[i].done) return rc;
+            target = s[i].cur;
+            agree = 1;
+        }
+
+        i = (i + 1) % n;
+        int rc = stream_seek(&s[i], &target, error);
+        if (rc != WTREE3_OK || s[i].done) return rc;
+
+        if (main_key_cmp(&s[i].cur, &target) == 0) {
+            agree++;
+        } else {
+            target = s[i].cur;
+            agree = 1;
+        }
+    }
+}
+
+/* K-way merge: emit the smallest key, advance every stream holding it */
+static int query_union(query_stream_t *s, size_t n, query_out_t *out, gerror_t *error) {
+    for (;;) {
+        const MDB_val *min = NULL;
+        for (size_t i = 0; i < n; i++) {
+            if (!s[i].done && (!min || main_key_cmp(&s[i].cur, min) < 0)) min = &s[i].cur;
+        }
+        if (!min) return WTREE3_OK;
+
+        MDB_val key = *min;
+        int rc = query_emit(out, &key);
+        if (rc != WTREE3_OK) return rc;
+
+        for (size_t i = 0; i < n; i++) {
+            if (s[i].done || main_key_cmp(&s[i].cur, &key) != 0) continue;
+            rc = stream_next(&s[i], error);
+            if (rc != WTREE3_OK) return rc;
+        }
+    }
+}
+
+/* ============================================================
+ * Public API
+ * ============================================================ */
+
+WTREE_WARN_UNUSED
+int wtree3_index_query_txn(wtree3_txn_t *txn,
+                           wtree3_tree_t *tree,
+                           const wtree3_index_pred_t *preds, size_t pred_count,
+                           unsigned int flags,
+                           wtree3_scan_fn fn,
+                           void *user_data,
+                           gerror_t *error) {
+    if (WTREE_UNLIKELY(!txn || !tree || !preds || pred_count == 0 || !fn)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+
+    for (size_t i = 0; i < pred_count; i++) {
+        if (WTREE_UNLIKELY(!preds[i].index_name || (!preds[i].range && !preds[i].key))) {
+            set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                     "Invalid predicate at position %zu", i);
+            return WTREE3_EINVAL;
+        }
+    }
+
+    query_stream_t *streams = calloc(pred_count, sizeof(query_stream_t));
+    if (WTREE_UNLIKELY(!streams)) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate query streams");
+        return WTREE3_ENOMEM;
+    }
+
+    /* Pinned for the whole query: a concurrent drop_index waits for it */
+    index_pin_t pin;
+    const index_set_t *set = index_set_pin(tree, &pin);
+
+    int rc = WTREE3_OK;
+    for (size_t i = 0; i < pred_count && rc == WTREE3_OK; i++) {
+        streams[i].idx = query_find_index(set, preds[i].index_name, error);
+        if (!streams[i].idx) {
+            rc = WTREE3_NOT_FOUND;
+            break;
+        }
+        rc = stream_open(&streams[i], txn->txn, &preds[i], error);
+    }
+
+    query_out_t out = {.tree = tree, .fn = fn, .user_data = user_data, .error = error};
+    if (rc == WTREE3_OK && (flags & WTREE3_QUERY_VALUES)) {
+        int mrc = mdb_cursor_open(txn->txn, tree->dbi, &out.main_cursor);
+        if (WTREE_UNLIKELY(mrc != 0)) {
+            out.main_cursor = NULL;
+            rc = translate_mdb_error(mrc, error);
+        }
+    }
+
+    if (rc == WTREE3_OK) {
+        rc = (flags & WTREE3_QUERY_OR)
+             ? query_union(streams, pred_count, &out, error)
+             : query_intersect(streams, pred_count, &out, error);
+    }
+
+    if (out.main_cursor) mdb_cursor_close(out.main_cursor);
+    codec_buf_release(&out.decoded);
+    for (size_t i = 0; i < pred_count; i++) {
+        stream_close(&streams[i]);
+    }
+    free(streams);
+    index_set_unpin(&pin);
+
+    /* Early termination by the callback is not an error */
+    return rc == 1 ? WTREE3_OK : rc;
+}
+
+WTREE_WARN_UNUSED
+int wtree3_index_query(wtree3_tree_t *tree,
+                       const wtree3_index_pred_t *preds, size_t pred_count,
+                       unsigned int flags,
+                       wtree3_scan_fn fn,
+                       void *user_data,
+                       gerror_t *error) {
+    if (WTREE_UNLIKELY(!tree)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+
+    wtree3_txn_t *txn = read_pool_acquire(tree->db, error);
+    if (WTREE_UNLIKELY(!txn)) return WTREE3_ERROR;
+
+    int rc = wtree3_index_query_txn(txn, tree, preds, pred_count, flags,
+                                    fn, user_data, error);
+    read_pool_release(txn);
+    return rc;
+}
+
+WTREE_WARN_UNUSED
+int wtree3_index_get_all_txn(wtree3_txn_t *txn,
+                             wtree3_tree_t *tree,
+                             const char *index_name,
+                             const void *key, size_t key_len,
+                             wtree3_posting_fn fn,
+                             void *user_data,
+                             gerror_t *error) {
+    if (WTREE_UNLIKELY(!txn || !tree || !index_name || !key || !fn)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+
+    /* Pinned for the whole walk: a concurrent drop_index waits for it */
+    index_pin_t pin;
+    wtree3_index_t *idx = query_find_index(index_set_pin(tree, &pin), index_name, error);
+    if (!idx) {
+        index_set_unpin(&pin);
+        return WTREE3_NOT_FOUND;
+    }
+
+    MDB_cursor *cursor;
+    int rc = mdb_cursor_open(txn->txn, idx->dbi, &cursor);
+    if (WTREE_UNLIKELY(rc != 0)) {
+        index_set_unpin(&pin);
+        return translate_mdb_error(rc, error);
+    }
+
+    MDB_val ikey = {.mv_size = key_len, .mv_data = (void *)key};
+    MDB_val dup;
+    rc = mdb_cursor_get(cursor, &ikey, &dup, MDB_SET_KEY);
+    if (rc != 0) {
+        mdb_cursor_close(cursor);
+        index_set_unpin(&pin);
+        return rc == MDB_NOTFOUND ? WTREE3_OK : translate_mdb_error(rc, error);
+    }
+
+    wtree3_index_page_t page;
+    rc = index_cursor_page(cursor, idx, &dup, &page, error);
+    while (rc == WTREE3_OK && fn(&page, user_data)) {
+        rc = index_cursor_page(cursor, idx, NULL, &page, error);
+    }
+    mdb_cursor_close(cursor);
+    index_set_unpin(&pin);
+
+    return rc == WTREE3_NOT_FOUND ? WTREE3_OK : rc;
+}
+
+WTREE_WARN_UNUSED
+int wtree3_index_get_all(wtree3_tree_t *tree,
+                         const char *index_name,
+                         const void *key, size_t key_len,
+                         wtree3_posting_fn fn,
+                         void *user_data,
+                         gerror_t *error) {
+    if (WTREE_UNLIKELY(!tree)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+
+    wtree3_txn_t *txn = read_pool_acquire(tree->db, error);
+    if (WTREE_UNLIKELY(!txn)) return WTREE3_ERROR;
+
+    int rc = wtree3_index_get_all_txn(txn, tree, index_name, key, key_len,
+                                      fn, user_data, error);
+    read_pool_release(txn);
+    return rc;
+}
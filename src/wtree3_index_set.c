@@ -0,0 +1,273 @@
+/*
+ * wtree3_index_set.c - Concurrent-Safe Index Sets
+ *
+ * A tree's indexes live in an immutable index_set_t. add_index and
+ * drop_index never change a published set: they build a new one and swap
+ * tree->index_set, so readers take a consistent list with one acquire
+ * load and are never blocked by schema changes.
+ *
+ * Old sets are reclaimed by epoch, RCU-style. A reader pins the set by
+ * counting itself in the current epoch's parity on its thread's stripe
+ * (picked once, round-robin, as metrics shards are); the publisher swaps
+ * the pointer, flips the epoch and waits until the old parity's counters
+ * on every stripe drain. Readers that pinned after the flip can only have
+ * seen the new set, so the old one - and an index dropped with it - can
+ * then be freed. Only publishers wait, and only for pins already taken.
+ *
+ * A publisher that holds a pin itself (add/drop from inside a callback on
+ * the same thread) would wait for itself; it retires the old set instead
+ * without flipping, and the next publish or the tree close frees it.
+ *
+ * This module provides:
+ * - index_set_init, index_set_destroy
+ * - index_set_pin, index_set_unpin, index_set_find
+ * - index_set_lock, index_set_unlock, index_set_publish
+ * - index_free
+ */
+
+#include "wtree3_internal.h"
+#include "macros.h"
+
+/* ============================================================
+ * Constants
+ * ============================================================ */
+
+#define INDEX_EPOCH_STRIPES     16
+#define INDEX_GRACE_SPIN        64      /* Polls before the publisher starts sleeping */
+#define INDEX_GRACE_SLEEP_MAX   1000    /* Longest sleep between polls (us) */
+
+/* ============================================================
+ * Internal Structures
+ * ============================================================ */
+
+/* Pins per epoch parity; one cache line so stripes don't share */
+typedef struct {
+    uint32_t readers[2];
+    unsigned char pad[64 - 2 * sizeof(uint32_t)];
+} index_stripe_t;
+
+struct index_epoch {
+    index_stripe_t stripes[INDEX_EPOCH_STRIPES];
+    uint32_t epoch;                 /* Parity new pins count in */
+    wmutex_t lock;                  /* Serializes publishers */
+    index_set_t *retired;           /* Replaced sets not yet past a grace period */
+};
+
+static uint32_t index_next_stripe = 0;
+static WTREE_THREAD_LOCAL uint32_t index_stripe;        /* Stripe + 1, 0 = unassigned */
+static WTREE_THREAD_LOCAL uint32_t index_pins_held;     /* Pins this thread holds, any tree */
+
+/* ============================================================
+ * Sets
+ * ============================================================ */
+
+static bool index_has_name(const void *idx_ptr, const void *name_ptr) {
+    return strcmp(((const wtree3_index_t *)idx_ptr)->name, (const char *)name_ptr) == 0;
+}
+
+WTREE_COLD
+void index_free(wtree3_index_t *idx) {
+    if (WTREE_UNLIKELY(!idx)) return;
+    free(idx->user_data);
+    free(idx->key_spec);
+    free(idx->name);
+    free(idx->tree_name);
+    free(idx->build_cursor.mv_data);
+    filter_free(idx->filter);
+    free(idx);
+}
+
+/* The set does not own its indexes: they outlive it in the next set */
+static void set_free(index_set_t *set) {
+    if (!set) return;
+    whash_destroy(set->map);
+    index_free(set->dropped);
+    free(set);
+}
+
+/* items copied from base, minus drop, plus add */
+static index_set_t *set_build(const index_set_t *base, wtree3_index_t *add, wtree3_index_t *drop) {
+    size_t cap = (base ? base->count : 0) + (add ? 1 : 0);
+    index_set_t *set = calloc(1, sizeof(index_set_t) + cap * sizeof(wtree3_index_t *));
+    if (WTREE_UNLIKELY(!set)) return NULL;
+
+    for (size_t i = 0; base && i < base->count; i++) {
+        if (base->items[i] != drop) set->items[set->count++] = base->items[i];
+    }
+    if (add) set->items[set->count++] = add;
+
+    /* Fixed-width indexes agree on the width (checked by add_index) */
+    for (size_t i = 0; i < set->count; i++) {
+        if (set->items[i]->main_key_size) set->key_size = set->items[i]->main_key_size;
+    }
+
+    set->map = whash_create(set->count, NULL);
+    for (size_t i = 0; set->map && i < set->count; i++) {
+        wtree3_index_t *idx = set->items[i];
+        if (!whash_put(set->map, whash_string(idx->name), idx)) {
+            /* Out of memory: lookups scan the items instead */
+            whash_destroy(set->map);
+            set->map = NULL;
+        }
+    }
+    return set;
+}
+
+WTREE_HOT WTREE_PURE
+wtree3_index_t *index_set_find(const index_set_t *set, const char *name) {
+    if (WTREE_UNLIKELY(!set || !name)) return NULL;
+    if (WTREE_LIKELY(set->map)) {
+        return (wtree3_index_t *)whash_get(set->map, whash_string(name), name, index_has_name);
+    }
+    for (size_t i = 0; i < set->count; i++) {
+        if (strcmp(set->items[i]->name, name) == 0) return set->items[i];
+    }
+    return NULL;
+}
+
+/* ============================================================
+ * Lifecycle
+ * ============================================================ */
+
+WTREE_COLD WTREE_WARN_UNUSED
+int index_set_init(wtree3_tree_t *tree) {
+    index_epoch_t *ep = calloc(1, sizeof(index_epoch_t));
+    index_set_t *set = set_build(NULL, NULL, NULL);
+    if (WTREE_UNLIKELY(!ep || !set || wmutex_init(&ep->lock) != 0)) {
+        free(ep);
+        set_free(set);
+        return WTREE3_ENOMEM;
+    }
+    tree->index_epoch = ep;
+    tree->index_set = set;
+    return WTREE3_OK;
+}
+
+WTREE_COLD
+void index_set_destroy(wtree3_tree_t *tree) {
+    index_epoch_t *ep = tree->index_epoch;
+    index_set_t *set = tree->index_set;
+
+    if (set) {
+        for (size_t i = 0; i < set->count; i++) index_free(set->items[i]);
+        set_free(set);
+    }
+    if (ep) {
+        while (ep->retired) {
+            index_set_t *next = ep->retired->retired_next;
+            set_free(ep->retired);
+            ep->retired = next;
+        }
+        wmutex_destroy(&ep->lock);
+        free(ep);
+    }
+    tree->index_set = NULL;
+    tree->index_epoch = NULL;
+}
+
+/* ============================================================
+ * Readers
+ * ============================================================ */
+
+WTREE_HOT
+const index_set_t *index_set_pin(wtree3_tree_t *tree, index_pin_t *pin) {
+    index_epoch_t *ep = tree->index_epoch;
+
+    uint32_t slot = index_stripe;
+    if (WTREE_UNLIKELY(slot == 0)) {
+        slot = watomic_add_u32(&index_next_stripe, 1) % INDEX_EPOCH_STRIPES + 1;
+        index_stripe = slot;
+    }
+    index_stripe_t *stripe = &ep->stripes[slot - 1];
+
+    /*
+     * Count in the current parity, then confirm the epoch did not move
+     * meanwhile: if it did, the publisher may have checked this parity
+     * before our count landed, so count again in the new one.
+     */
+    for (;;) {
+        uint32_t e = watomic_sc_load_u32(&ep->epoch);
+        uint32_t *readers = &stripe->readers[e & 1];
+        watomic_sc_add_u32(readers, 1);
+        if (WTREE_LIKELY(watomic_sc_load_u32(&ep->epoch) == e)) {
+            pin->readers = readers;
+            break;
+        }
+        watomic_sc_add_u32(readers, -1);
+    }
+    index_pins_held++;
+    return (const index_set_t *)watomic_load_ptr((void *const *)&tree->index_set);
+}
+
+WTREE_HOT
+void index_set_unpin(index_pin_t *pin) {
+    if (WTREE_UNLIKELY(!pin->readers)) return;
+    watomic_sc_add_u32(pin->readers, -1);
+    pin->readers = NULL;
+    index_pins_held--;
+}
+
+/* ============================================================
+ * Publishers
+ * ============================================================ */
+
+void index_set_lock(wtree3_tree_t *tree) {
+    wmutex_lock(&tree->index_epoch->lock);
+}
+
+void index_set_unlock(wtree3_tree_t *tree) {
+    wmutex_unlock(&tree->index_epoch->lock);
+}
+
+/* Flip the epoch and wait until nobody is pinned in the old parity */
+static void grace_period(index_epoch_t *ep) {
+    uint32_t e = watomic_sc_load_u32(&ep->epoch);
+    watomic_sc_store_u32(&ep->epoch, e + 1);
+
+    uint64_t sleep_us = 1;
+    for (unsigned int polls = 0;; polls++) {
+        uint64_t pinned = 0;
+        for (size_t s = 0; s < INDEX_EPOCH_STRIPES; s++) {
+            pinned += watomic_sc_load_u32(&ep->stripes[s].readers[e & 1]);
+        }
+        if (pinned == 0) return;
+
+        if (polls >= INDEX_GRACE_SPIN) {
+            wtime_sleep_us(sleep_us);
+            if (sleep_us < INDEX_GRACE_SLEEP_MAX) sleep_us *= 2;
+        }
+    }
+}
+
+WTREE_COLD WTREE_WARN_UNUSED
+int index_set_publish(wtree3_tree_t *tree, wtree3_index_t *add, wtree3_index_t *drop,
+                      bool *reclaimed, gerror_t *error) {
+    index_epoch_t *ep = tree->index_epoch;
+    index_set_t *old = tree->index_set;
+
+    index_set_t *set = set_build(old, add, drop);
+    if (WTREE_UNLIKELY(!set)) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate index set");
+        return WTREE3_ENOMEM;
+    }
+    old->dropped = drop;
+    watomic_store_ptr((void **)&tree->index_set, set);
+
+    old->retired_next = ep->retired;
+    ep->retired = old;
+    if (index_pins_held > 0) {
+        /* Our own pin would never drain; a later publish frees the old set */
+        if (reclaimed) *reclaimed = false;
+        return WTREE3_OK;
+    }
+
+    /* Everything retired so far was replaced before the flip */
+    grace_period(ep);
+    while (ep->retired) {
+        index_set_t *next = ep->retired->retired_next;
+        set_free(ep->retired);
+        ep->retired = next;
+    }
+    if (reclaimed) *reclaimed = true;
+    return WTREE3_OK;
+}
@@ -10,6 +10,9 @@
 
 #include "wtree3.h"
 #include "wvector.h"
+#include "whash.h"
+#include "wthread.h"
+#include "wsort.h"
 #include "macros.h"
 #include <stdlib.h>
 #include <string.h>
@@ -28,6 +31,12 @@
 #define WTREE3_LIB "wtree3"
 #define WTREE3_INDEX_PREFIX "idx:"
 #define WTREE3_META_DB "__wtree3_index_meta__"
+#define WTREE3_STATS_PREFIX "\x01stats:"  /* Metadata key prefix of stats records */
+#define WTREE3_FILTER_PREFIX "\x01filter:" /* Metadata key prefix of filter configs */
+#define WTREE3_CODEC_PREFIX "\x01codec:"   /* Metadata key prefix of value codec records */
+#define WTREE3_CHANGELOG_PREFIX "\x01changes:" /* Change-log DBI names and their metadata records */
+#define READ_POOL_DEFAULT_SIZE 16   /* Idle read txns kept per database */
+#define READ_POOL_CURSORS 4         /* Cursors cached per pooled read txn */
 
 /* ============================================================
  * Internal Structure Definitions
@@ -36,6 +45,45 @@
 /* Forward declare registry */
 typedef struct wtree3_extractor_registry wtree3_extractor_registry_t;
 
+/* Forward declare group-commit batcher */
+typedef struct wtree3_group_commit wtree3_group_commit_t;
+
+/* Forward declare per-tree write combining buffer */
+typedef struct wtree3_combine wtree3_combine_t;
+
+/* Forward declare deferred-sync flusher */
+typedef struct wtree3_durability wtree3_durability_t;
+
+/* Forward declare read transaction pool */
+typedef struct wtree3_read_pool wtree3_read_pool_t;
+
+/* Forward declare metrics shards */
+typedef struct wtree3_metrics_state wtree3_metrics_state_t;
+
+/* Forward declare value codec and its decode arena blocks */
+typedef struct wtree3_codec wtree3_codec_t;
+typedef struct codec_block codec_block_t;
+
+/* Membership filter over tree or unique-index keys (see wtree3_filter.c) */
+typedef struct wtree3_filter {
+    uint64_t *words;                /* FILTER_BLOCK_WORDS per block */
+    uint64_t blocks;
+    uint32_t probes;                /* Bits set per key */
+    uint32_t bits_per_key;
+    uint64_t expected_keys;         /* Configured minimum capacity */
+    uint64_t capacity;              /* Keys the filter was sized for */
+    uint64_t built_keys;            /* Keys present at the (re)build */
+    uint64_t added;                 /* New keys since (relaxed) */
+    uint64_t removed;               /* Deletes since; their bits stay set (relaxed) */
+    size_t since;                   /* Oldest snapshot (txn id) the filter covers */
+} wtree3_filter_t;
+
+/* Change log of a tree (see wtree3_changelog.c) */
+typedef struct wtree3_changelog {
+    MDB_dbi dbi;                    /* Log DBI: big-endian sequence -> record */
+    bool values;                    /* Records carry the new value */
+} wtree3_changelog_t;
+
 /* Database handle */
 struct wtree3_db_t {
     MDB_env *env;
@@ -47,6 +95,19 @@ struct wtree3_db_t {
 
     /* Extractor registry (version+flags → key_fn) */
     wtree3_extractor_registry_t *extractor_registry;
+
+    /* Group-commit write batcher (NULL when disabled) */
+    wtree3_group_commit_t *group_commit;
+
+    /* Deferred-sync flusher (NULL = every commit syncs as configured) */
+    wtree3_durability_t *durability;
+
+    /* Recycled read-only txns for the auto-transaction read APIs */
+    wtree3_read_pool_t *read_pool;
+
+    /* Instrumentation (allocated on first enable, kept until close) */
+    wtree3_metrics_state_t *metrics;
+    uint32_t metrics_on;            /* Relaxed flag checked by METRICS_ON */
 };
 
 /* Transaction handle */
@@ -54,6 +115,24 @@ struct wtree3_txn_t {
     MDB_txn *txn;
     wtree3_db_t *db;
     bool is_write;
+    bool pooled;                    /* Read txn owned by db->read_pool */
+
+    /* Cursors kept open across reuse (pooled txns only) */
+    size_t cursor_count;
+    struct {
+        MDB_dbi dbi;
+        unsigned int flags;         /* DBI flags when cached */
+        MDB_cursor *cursor;
+    } cursors[READ_POOL_CURSORS];
+
+    /* Values decompressed for this txn (see codec_decode_txn) */
+    codec_block_t *decoded;
+
+    /* Pending wtree3_reserve_txn entry, until wtree3_commit_reserved */
+    struct {
+        wtree3_tree_t *tree;
+        MDB_cursor *cursor;         /* On the entry (its page stack is never spilled) */
+    } reserved;
 };
 
 /* Single index entry */
@@ -63,32 +142,96 @@ typedef struct wtree3_index {
     MDB_dbi dbi;                    /* Index DBI handle */
     uint64_t extractor_id;          /* Extractor ID */
     wtree3_index_key_fn key_fn;     /* Key extraction callback (looked up from registry) */
+    wtree3_index_key_into_fn key_into_fn;  /* Allocation-free variant (used when key_fn is NULL) */
+    wtree3_key_spec_t *key_spec;    /* Declarative key (owned; used instead of both callbacks) */
     void *user_data;                /* Callback user data (owned by index, copied from config) */
     size_t user_data_len;           /* Length of user_data */
     bool unique;                    /* Unique constraint */
     bool sparse;                    /* Sparse index */
     MDB_cmp_func *compare;          /* Custom key comparator */
     MDB_cmp_func *dupsort_compare;  /* Custom duplicate value comparator */
+    wtree3_index_key_fn project_fn; /* Covering projection (NULL = plain index) */
+    bool building;                  /* Online build in progress (hidden from seeks) */
+    MDB_val build_cursor;           /* Last main key covered by the build (mv_data NULL = none) */
+    uint32_t main_key_size;         /* Fixed main key width: dups packed (MDB_DUPFIXED), 0 = variable */
+    bool integer_dups;              /* MDB_INTEGERDUP: dups in numeric, not memcmp, order */
+    uint64_t metric_ops[WTREE3_METRIC_COUNT];  /* See wtree3_tree_metrics */
+    wtree3_filter_t *filter;        /* Unique-probe filter (NULL = none) */
 } wtree3_index_t;
 
+/*
+ * Immutable snapshot of a tree's indexes (see wtree3_index_set.c)
+ *
+ * add_index and drop_index publish a new set instead of changing this
+ * one, so a reader that pinned it sees the same indexes throughout.
+ */
+typedef struct index_set {
+    size_t count;
+    uint32_t key_size;              /* Main key width required by fixed-width indexes (0 = any) */
+    whash_t *map;                   /* The same indexes by name (NULL = scan items) */
+    struct index_set *retired_next; /* Next set waiting for its grace period */
+    wtree3_index_t *dropped;        /* Index freed along with this set once retired (or NULL) */
+    wtree3_index_t *items[];        /* In add order */
+} index_set_t;
+
+/* Reader pins, publisher lock and retired sets of a tree (see wtree3_index_set.c) */
+typedef struct index_epoch index_epoch_t;
+
+/* A reader's hold on the index set it pinned (release with index_set_unpin) */
+typedef struct {
+    uint32_t *readers;              /* Counter the pin holds */
+} index_pin_t;
+
 /* Tree handle with index support */
 struct wtree3_tree_t {
     char *name;
     MDB_dbi dbi;                    /* Main tree DBI */
     wtree3_db_t *db;
-    unsigned int flags;
-
-    /* Indexes (vector of wtree3_index_t*) */
-    wvector_t *indexes;
+    unsigned int flags;             /* Persistent DBI flags, as LMDB reports them */
+    bool custom_compare;            /* Key order set by wtree3_tree_set_compare */
 
-    /* Entry tracking */
-    int64_t entry_count;
+    /* Indexes: replaced as a whole on add/drop, read under a pin */
+    index_set_t *index_set;         /* Current set (never NULL once the tree is open) */
+    index_epoch_t *index_epoch;
 
-    /* Upsert merge callback */
+    /* Upsert merge callback (at most one of the two is set) */
     wtree3_merge_fn merge_fn;
+    wtree3_merge_into_fn merge_into_fn;
     void *merge_user_data;
+
+    uint64_t metric_ops[WTREE3_METRIC_COUNT];  /* See wtree3_tree_metrics */
+
+    /* Negative-lookup filter over main keys (NULL = none) */
+    wtree3_filter_t *filter;
+
+    /* Value compression (NULL = values stored as given) */
+    wtree3_codec_t *codec;
+
+    /* Change-data-capture log (NULL = writes are not logged) */
+    wtree3_changelog_t *changelog;
+
+    /* Upsert combining buffer (NULL = wtree3_upsert writes directly) */
+    wtree3_combine_t *combine;
+};
+
+/* Prepared index handle */
+struct wtree3_index_handle_t {
+    wtree3_tree_t *tree;
+    wtree3_index_t *idx;
+    MDB_cursor *cursor;             /* Cached cursor (NULL = none yet) */
+    MDB_txn *cursor_txn;            /* Txn the cursor is bound to */
+    size_t cursor_txn_id;           /* Its id: tells a reused MDB_txn* apart */
+    bool cursor_write;              /* Bound to a write txn, which frees it at txn end */
+    bool positioned;
+    bool exact;                     /* Last seek was exact: next stays on its key */
 };
 
+/* Growable output buffer of the value codec (release with codec_buf_release) */
+typedef struct codec_buf {
+    unsigned char *data;
+    size_t cap;
+} codec_buf_t;
+
 /* Iterator handle */
 struct wtree3_iterator_t {
     MDB_cursor *cursor;
@@ -99,6 +242,8 @@ struct wtree3_iterator_t {
     bool valid;
     bool owns_txn;
     bool is_index;
+    bool covering;                  /* Index iterator over a covering index */
+    codec_buf_t decoded;            /* Current value of a compressed tree */
 };
 
 /* ============================================================
@@ -113,6 +258,9 @@ int translate_mdb_error(int mdb_rc, gerror_t *error);
 WTREE_PURE
 wtree3_index_key_fn find_extractor(wtree3_db_t *db, uint64_t extractor_id);
 
+WTREE_PURE
+wtree3_index_key_into_fn find_extractor_into(wtree3_db_t *db, uint64_t extractor_id);
+
 /* Transaction wrapper helpers */
 WTREE_HOT WTREE_WARN_UNUSED
 int with_write_txn(wtree3_db_t *db,
@@ -131,6 +279,13 @@ static inline uint64_t build_extractor_id(uint32_t version, uint32_t flags) {
     return ((uint64_t)version << 32) | flags;
 }
 
+/* Registry ID space of covering index projections (see wtree3_db_register_projection) */
+#define INDEX_PROJECTION_ID_FLAG 0x80000000u
+
+static inline uint64_t build_projection_id(uint32_t version, uint32_t flags) {
+    return build_extractor_id(version, flags | INDEX_PROJECTION_ID_FLAG);
+}
+
 /* Extract flags from index config */
 static inline uint32_t extract_index_flags(const wtree3_index_config_t *config) {
     uint32_t flags = 0;
@@ -140,12 +295,74 @@ static inline uint32_t extract_index_flags(const wtree3_index_config_t *config)
 }
 
 /* ============================================================
- * Index Helper Functions (implemented in wtree3_index.c)
+ * Index Set (implemented in wtree3_index_set.c)
  * ============================================================ */
 
-/* Find index by name in tree's index array */
+/* Give a newly opened tree its empty index set */
+WTREE_COLD WTREE_WARN_UNUSED
+int index_set_init(wtree3_tree_t *tree);
+
+/* Free the sets and indexes of a closing tree (no pins may be left) */
+WTREE_COLD
+void index_set_destroy(wtree3_tree_t *tree);
+
+/*
+ * Pin the tree's current index set: its indexes stay allocated, and their
+ * DBIs open, until index_set_unpin(). Pins nest and cost two atomic adds
+ * on a per-thread stripe; hold one for the length of a single call.
+ */
+WTREE_HOT
+const index_set_t *index_set_pin(wtree3_tree_t *tree, index_pin_t *pin);
+
+WTREE_HOT
+void index_set_unpin(index_pin_t *pin);
+
+/*
+ * Find index by name in a pinned (or locked) set. Keep the pin for as
+ * long as the call uses the index. Iterators and handles that outlive the
+ * call must be closed before drop_index, as they always had to be.
+ */
 WTREE_HOT WTREE_PURE
-wtree3_index_t* find_index(wtree3_tree_t *tree, const char *name);
+wtree3_index_t *index_set_find(const index_set_t *set, const char *name);
+
+/* Serialize add/drop on a tree; the holder may read tree->index_set without a pin */
+void index_set_lock(wtree3_tree_t *tree);
+void index_set_unlock(wtree3_tree_t *tree);
+
+/*
+ * Replace the current set (lock held) by one with add appended and/or
+ * drop removed, then wait for the readers of the old set to unpin and
+ * free it along with drop. A thread that holds a pin itself cannot wait:
+ * the old set is then retired until a later publish, and *reclaimed
+ * (optional) is false. Never call this inside a write txn - a pinned
+ * reader may be waiting for the writer lock.
+ */
+WTREE_COLD WTREE_WARN_UNUSED
+int index_set_publish(wtree3_tree_t *tree, wtree3_index_t *add, wtree3_index_t *drop,
+                      bool *reclaimed, gerror_t *error);
+
+/* Free an index that belongs to no set */
+WTREE_COLD
+void index_free(wtree3_index_t *idx);
+
+/* ============================================================
+ * Index Helper Functions (implemented in wtree3_index.c)
+ * ============================================================ */
+
+/* Whether a main key may be written: fixed-width indexes and MDB_INTEGERKEY pin its length */
+static inline bool tree_key_len_ok(const wtree3_tree_t *tree, const index_set_t *set,
+                                   size_t key_len) {
+    if (WTREE_UNLIKELY(set->key_size != 0)) return key_len == set->key_size;
+    if (WTREE_UNLIKELY(tree->flags & MDB_INTEGERKEY)) {
+        return key_len == sizeof(unsigned int) || key_len == sizeof(size_t);
+    }
+    return true;
+}
+
+/* DBI flags of an index: always DUPSORT, packed when its main keys are fixed-width */
+static inline unsigned int index_dbi_flags(uint32_t main_key_size, bool integer_dups) {
+    return MDB_DUPSORT | (main_key_size ? MDB_DUPFIXED : 0) | (integer_dups ? MDB_INTEGERDUP : 0);
+}
 
 /* Build index tree name: idx:<tree_name>:<index_name> */
 WTREE_MALLOC
@@ -175,26 +392,649 @@ int metadata_delete_txn(MDB_txn *txn, wtree3_db_t *db,
                         const char *tree_name, const char *index_name,
                         gerror_t *error);
 
-/* Load index metadata (from wtree3_index_persist.c) */
+/* Load index metadata (from wtree3_index_persist.c; index set lock held) */
 WTREE_COLD WTREE_WARN_UNUSED
 int load_index_metadata(wtree3_tree_t *tree, const char *index_name, gerror_t *error);
 
+/* Persist an index's metadata (incl. build state) within a write transaction */
+WTREE_COLD WTREE_WARN_UNUSED
+int save_index_metadata_txn(MDB_txn *txn, wtree3_tree_t *tree, wtree3_index_t *idx,
+                            gerror_t *error);
+
 /* ============================================================
  * Index Maintenance Functions (implemented in wtree3_crud.c)
  * ============================================================ */
 
-/* Insert entry into all indexes (called during insert/update) */
+/* Inline scratch space for allocation-free extractors */
+#define INDEX_KEY_INLINE 256
+
+/*
+ * An extracted index key. data points at buf, at heap (owned), or into the
+ * value itself for zero-copy extractors. Release with index_key_release.
+ */
+typedef struct index_key {
+    const void *data;               /* Key bytes (NULL on extraction failure) */
+    size_t len;                     /* Key length */
+    void *heap;                     /* Owned allocation, if any */
+    unsigned char buf[INDEX_KEY_INLINE];
+} index_key_t;
+
+/*
+ * Run an index's extractor on a value. Returns false if the entry is not
+ * indexed (sparse skip); returns true with key->data == NULL if extraction
+ * failed.
+ */
+WTREE_HOT
+bool index_key_extract(const wtree3_index_t *idx, const void *value, size_t value_len,
+                       index_key_t *key);
+
+/* Free any allocation held by an extracted key */
+static inline void index_key_release(index_key_t *key) {
+    free(key->heap);
+    key->heap = NULL;
+}
+
+/* Take ownership of the key bytes as a malloc'd buffer (NULL on ENOMEM) */
+void *index_key_detach(index_key_t *key);
+
+/* ============================================================
+ * Declarative Keys (implemented in wtree3_key_spec.c)
+ * ============================================================ */
+
+/* Check a spec and that its keys fit INDEX_KEY_INLINE */
+WTREE_COLD WTREE_WARN_UNUSED
+int key_spec_validate(const wtree3_key_spec_t *spec, gerror_t *error);
+
+/* index_key_extract for spec indexes: always into key->buf, never allocates */
 WTREE_HOT
-int indexes_insert(wtree3_tree_t *tree, MDB_txn *txn,
+bool key_spec_extract(const wtree3_key_spec_t *spec, bool sparse,
+                      const void *value, size_t value_len, index_key_t *key);
+
+/* Metadata encoding: [part_count:4] then [offset:4][length:4][type:1][sparse:1][pad:2] per part */
+size_t key_spec_serialized_size(const wtree3_key_spec_t *spec);
+void key_spec_serialize(const wtree3_key_spec_t *spec, uint8_t *out);
+
+/* Decode and validate; false if malformed */
+WTREE_WARN_UNUSED
+bool key_spec_deserialize(const void *data, size_t data_len, wtree3_key_spec_t *out);
+
+/*
+ * Dup value of an index entry. Plain indexes store the main key itself;
+ * covering indexes store [main_key][payload][mk_len:2 LE], where payload
+ * is the projection of the main value. Covering index DBs compare dups by
+ * the main key part only (index_covering_dcmp), so dups stay in main-key
+ * order and an entry can be found or deleted from its main key alone.
+ */
+#define INDEX_COVERING_TRAILER 2
+
+typedef struct index_dup {
+    MDB_val val;                    /* Dup value to store or look up */
+    void *heap;                     /* Owned allocation, if any */
+    unsigned char buf[INDEX_KEY_INLINE];
+} index_dup_t;
+
+/*
+ * Build the dup value for main_key. With value == NULL no projection is
+ * run (covering dups get an empty payload) - enough for lookups and
+ * deletes. Plain indexes never copy.
+ */
+WTREE_HOT WTREE_WARN_UNUSED
+int index_dup_build(const wtree3_index_t *idx,
+                    const void *main_key, size_t main_key_len,
+                    const void *value, size_t value_len,
+                    index_dup_t *dup, gerror_t *error);
+
+static inline void index_dup_release(index_dup_t *dup) {
+    free(dup->heap);
+    dup->heap = NULL;
+}
+
+/* Split a stored dup value into main key and payload (false if malformed) */
+static inline bool index_dup_split(bool covering, const MDB_val *dup,
+                                   MDB_val *main_key, MDB_val *payload) {
+    if (WTREE_LIKELY(!covering)) {
+        *main_key = *dup;
+        if (payload) {
+            payload->mv_size = 0;
+            payload->mv_data = NULL;
+        }
+        return true;
+    }
+
+    const unsigned char *p = (const unsigned char *)dup->mv_data;
+    if (WTREE_UNLIKELY(dup->mv_size < INDEX_COVERING_TRAILER)) return false;
+    size_t body = dup->mv_size - INDEX_COVERING_TRAILER;
+    size_t mk_len = (size_t)p[body] | ((size_t)p[body + 1] << 8);
+    if (WTREE_UNLIKELY(mk_len > body)) return false;
+
+    main_key->mv_data = dup->mv_data;
+    main_key->mv_size = mk_len;
+    if (payload) {
+        payload->mv_data = (void *)(p + mk_len);
+        payload->mv_size = body - mk_len;
+    }
+    return true;
+}
+
+/* Dup comparator installed on covering index DBs */
+int index_covering_dcmp(const MDB_val *a, const MDB_val *b);
+
+/*
+ * Read a posting-list page from an index cursor. With cur (the dup the
+ * cursor was just positioned on) the page starts at cur; with cur NULL
+ * the cursor moves on to the next page of the same index key.
+ * Returns: 0, WTREE3_NOT_FOUND past the last dup (error left untouched),
+ *          or an error code
+ */
+WTREE_HOT
+int index_cursor_page(MDB_cursor *cursor, const wtree3_index_t *idx, const MDB_val *cur,
+                      wtree3_index_page_t *page, gerror_t *error);
+
+/* Insert entry into all indexes of a pinned set (called during insert/update) */
+WTREE_HOT
+int indexes_insert(wtree3_tree_t *tree, const index_set_t *set, MDB_txn *txn,
                    const void *key, size_t key_len,
                    const void *value, size_t value_len,
                    gerror_t *error);
 
+/*
+ * Move a main key's index entries from old_value to new_value (called
+ * during update/modify). Indexes whose extracted key is byte-for-byte
+ * unchanged are left untouched.
+ */
+WTREE_HOT
+int indexes_update(wtree3_tree_t *tree, const index_set_t *set, MDB_txn *txn,
+                   const void *key, size_t key_len,
+                   const void *old_value, size_t old_len,
+                   const void *new_value, size_t new_len,
+                   gerror_t *error);
+
+/*
+ * True if an index must be maintained for this main key. Indexes under an
+ * online build only track keys the build has already passed.
+ */
+WTREE_HOT
+bool index_covers_key(MDB_txn *txn, wtree3_tree_t *tree, wtree3_index_t *idx,
+                      const void *key, size_t key_len);
+
 /* Delete entry from all indexes (called during delete/update) */
 WTREE_HOT
-int indexes_delete(wtree3_tree_t *tree, MDB_txn *txn,
+int indexes_delete(wtree3_tree_t *tree, const index_set_t *set, MDB_txn *txn,
                    const void *key, size_t key_len,
                    const void *value, size_t value_len,
                    gerror_t *error);
 
+/* ============================================================
+ * Positioned Writes (implemented in wtree3_crud.c)
+ *
+ * One cursor serves the lookup and the write of upsert, update, delete
+ * and modify. crud_seek positions it; the *_at writers then maintain the
+ * indexes of a pinned set, write through the cursor and log the change.
+ * key must not point into the tree's pages (the write may move them).
+ * ============================================================ */
+
+/*
+ * Position a main-tree cursor for key. *found tells whether key exists;
+ * old is then its stored (still encoded) value. Otherwise the cursor rests
+ * on the following key, so an insert finds its leaf without a descent.
+ * Returns an MDB code.
+ */
+WTREE_HOT WTREE_WARN_UNUSED
+int crud_seek(MDB_txn *txn, wtree3_tree_t *tree, MDB_cursor *cursor,
+              const MDB_val *key, MDB_val *old, bool *found);
+
+/* Insert an absent key (cursor NULL = plain mdb_put) */
+WTREE_HOT WTREE_WARN_UNUSED
+int crud_insert_at(wtree3_txn_t *txn, wtree3_tree_t *tree, const index_set_t *set,
+                   MDB_cursor *cursor,
+                   const void *key, size_t key_len,
+                   const void *value, size_t value_len,
+                   gerror_t *error);
+
+/* Replace the entry crud_seek found; old_value is its decoded value (used by indexes only) */
+WTREE_HOT WTREE_WARN_UNUSED
+int crud_replace_at(wtree3_txn_t *txn, wtree3_tree_t *tree, const index_set_t *set,
+                    MDB_cursor *cursor,
+                    const void *key, size_t key_len,
+                    const void *old_value, size_t old_len,
+                    const void *value, size_t value_len,
+                    gerror_t *error);
+
+/* Delete the entry crud_seek found; old_value is its decoded value (used by indexes only) */
+WTREE_HOT WTREE_WARN_UNUSED
+int crud_delete_at(wtree3_txn_t *txn, wtree3_tree_t *tree, const index_set_t *set,
+                   MDB_cursor *cursor,
+                   const void *key, size_t key_len,
+                   const void *old_value, size_t old_len,
+                   gerror_t *error);
+
+/* ============================================================
+ * Sorted Index Writes (implemented in wtree3_bulk.c)
+ * ============================================================ */
+
+/* One buffered secondary index entry: index_key -> main_key */
+typedef struct index_entry {
+    MDB_val key;                    /* Index key */
+    MDB_val main_key;               /* Main tree key (index dup value, see index_dup_t) */
+} index_entry_t;
+
+/*
+ * Fill an entry from an extracted index key, consuming idx_key. The index
+ * key is detached into key.mv_data (free it when done); main_key is
+ * referenced in place, or for covering indexes encoded into the same
+ * allocation.
+ */
+WTREE_WARN_UNUSED
+int index_entry_fill(const wtree3_index_t *idx, index_key_t *idx_key,
+                     const MDB_val *main_key, const void *value, size_t value_len,
+                     index_entry_t *entry, gerror_t *error);
+
+/* Sort entries by (index key, main key) with the index DBI comparators */
+WTREE_WARN_UNUSED
+bool index_entries_sort(MDB_txn *txn, wtree3_index_t *idx,
+                        index_entry_t *entries, size_t count);
+
+/*
+ * Streaming writer for entries arriving in (index key, main key) order.
+ * Uses MDB_APPEND/MDB_APPENDDUP when the index starts empty, ordinary puts
+ * (with unique probes) otherwise. Unique violations inside the stream are
+ * detected as adjacent duplicates.
+ */
+typedef struct index_writer {
+    MDB_txn *txn;
+    wtree3_index_t *idx;
+    bool append;
+    bool have_prev;
+    MDB_val prev_key;               /* Copy of last written entry */
+    MDB_val prev_main;
+    void *prev_buf;
+    size_t prev_cap;
+} index_writer_t;
+
+WTREE_WARN_UNUSED
+int index_writer_begin(index_writer_t *w, MDB_txn *txn, wtree3_index_t *idx,
+                       gerror_t *error);
+
+WTREE_HOT WTREE_WARN_UNUSED
+int index_writer_put(index_writer_t *w, const MDB_val *key, const MDB_val *main_key,
+                     gerror_t *error);
+
+void index_writer_end(index_writer_t *w);
+
+/* Write a sorted entry array through an index_writer_t */
+WTREE_HOT WTREE_WARN_UNUSED
+int index_write_sorted(MDB_txn *txn, wtree3_index_t *idx,
+                       const index_entry_t *entries, size_t count,
+                       gerror_t *error);
+
+/* ============================================================
+ * Key-Range Partitioning (implemented in wtree3_partition.c)
+ * ============================================================ */
+
+/*
+ * Compute up to parts-1 split keys cutting [start, end] (NULL = open) into
+ * roughly equal key-space slices. Splits are real keys, strictly ascending,
+ * and returned as malloc'd copies; free with partition_free_splits().
+ * Fewer splits (possibly none) are returned for small or narrow ranges.
+ */
+WTREE_WARN_UNUSED
+int partition_split_keys(MDB_txn *txn, MDB_dbi dbi,
+                         const MDB_val *start, const MDB_val *end,
+                         size_t parts,
+                         MDB_val **out_splits, size_t *out_count,
+                         gerror_t *error);
+
+void partition_free_splits(MDB_val *splits, size_t count);
+
+/*
+ * Position cursor at the real key nearest a point of [first, last] (both
+ * real keys of the cursor's DB) spread like partition_split_keys()
+ * spreads its candidates; frac picks the point, as a fraction of 2^64.
+ * On success key/data are the cursor's entry (the key lies in
+ * [first, last]). Returns 0 or an MDB error code.
+ */
+WTREE_WARN_UNUSED
+int partition_key_at(MDB_cursor *cursor, const MDB_val *first, const MDB_val *last,
+                     uint64_t frac, MDB_val *key, MDB_val *data);
+
+/* ============================================================
+ * Statistics (implemented in wtree3_stats.c)
+ * ============================================================ */
+
+/*
+ * Like partition_split_keys() but cut at the analyzed equi-depth
+ * histogram of the main tree, so slices hold similar entry counts even
+ * for skewed keys. Returns WTREE3_NOT_FOUND if the tree was never
+ * analyzed; free splits with partition_free_splits().
+ */
+WTREE_WARN_UNUSED
+int stats_split_keys(MDB_txn *txn, wtree3_tree_t *tree,
+                     const MDB_val *start, const MDB_val *end,
+                     size_t parts,
+                     MDB_val **out_splits, size_t *out_count,
+                     gerror_t *error);
+
+/* Delete the stats record of an index (NULL = main tree); NOTFOUND is fine */
+int stats_delete_txn(MDB_txn *txn, wtree3_db_t *db, const char *tree_name,
+                     const char *index_name);
+
+/* ============================================================
+ * Membership Filters (implemented in wtree3_filter.c)
+ * ============================================================ */
+
+WTREE_HOT
+bool filter_may_contain(const wtree3_filter_t *filter, const void *key, size_t key_len);
+
+WTREE_HOT
+void filter_add(wtree3_filter_t *filter, const void *key, size_t key_len);
+
+/*
+ * True if the filter proves the key absent from txn's snapshot. Snapshots
+ * older than the filter's build may hold keys deleted before it, so they
+ * always get false.
+ */
+static inline bool filter_rules_out(const wtree3_filter_t *filter, MDB_txn *txn,
+                                    const void *key, size_t key_len) {
+    return WTREE_UNLIKELY(filter != NULL) && mdb_txn_id(txn) >= filter->since &&
+           !filter_may_contain(filter, key, key_len);
+}
+
+/* Write-path hooks: a key was stored / a key was deleted */
+static inline void filter_note_add(wtree3_filter_t *filter, const void *key, size_t key_len) {
+    if (WTREE_UNLIKELY(filter != NULL)) filter_add(filter, key, key_len);
+}
+
+static inline void filter_note_remove(wtree3_filter_t *filter) {
+    if (WTREE_UNLIKELY(filter != NULL)) watomic_add_u64(&filter->removed, 1);
+}
+
+static inline void filter_note_remove_many(wtree3_filter_t *filter, uint64_t count) {
+    if (WTREE_UNLIKELY(filter != NULL) && count) watomic_add_u64(&filter->removed, count);
+}
+
+void filter_free(wtree3_filter_t *filter);
+
+/* Rebuild the persisted filters of a freshly opened tree (errors are skipped) */
+WTREE_COLD
+void filters_auto_load(wtree3_tree_t *tree);
+
+/* Delete the filter config of an index (NULL = main tree); NOTFOUND is fine */
+int filter_delete_txn(MDB_txn *txn, wtree3_db_t *db, const char *tree_name,
+                      const char *index_name);
+
+/* ============================================================
+ * Value Codec (implemented in wtree3_codec.c)
+ * ============================================================ */
+
+/*
+ * Frame a value for storage in a tree with a codec: compressed, or raw
+ * behind a tag byte. out points into buf. Returns an MDB code (ENOMEM).
+ */
+WTREE_HOT WTREE_WARN_UNUSED
+int codec_encode(const wtree3_codec_t *codec, const void *value, size_t value_len,
+                 codec_buf_t *buf, MDB_val *out);
+
+/*
+ * Unwrap a stored frame in place: raw frames stay zero-copy, compressed
+ * ones are expanded into buf (valid until its next use). Returns an MDB
+ * code (MDB_CORRUPTED for a bad frame, ENOMEM).
+ */
+WTREE_HOT WTREE_WARN_UNUSED
+int codec_decode(const wtree3_codec_t *codec, MDB_val *val, codec_buf_t *buf);
+
+/* Same, expanding into txn's decode arena: valid until the txn ends */
+WTREE_HOT WTREE_WARN_UNUSED
+int codec_decode_txn(const wtree3_codec_t *codec, wtree3_txn_t *txn, MDB_val *val);
+
+/* Drop decoded values but keep one arena block (pooled read txns) */
+void codec_arena_reset(wtree3_txn_t *txn);
+
+void codec_arena_free(wtree3_txn_t *txn);
+
+static inline void codec_buf_release(codec_buf_t *buf) {
+    free(buf->data);
+    buf->data = NULL;
+    buf->cap = 0;
+}
+
+/* Load the persisted codec of a freshly opened tree (none is fine) */
+WTREE_COLD WTREE_WARN_UNUSED
+int codec_auto_load(wtree3_tree_t *tree, gerror_t *error);
+
+/* Codec with an optional dictionary (snapshots compress blocks with a plain one) */
+wtree3_codec_t *codec_create(uint32_t min_size, const void *dict, size_t dict_len);
+void codec_free(wtree3_codec_t *codec);
+
+/* Read and write paths: no-ops for trees without a codec */
+static inline int tree_value_encode(const wtree3_tree_t *tree, MDB_val *val, codec_buf_t *buf) {
+    if (WTREE_LIKELY(tree->codec == NULL)) return 0;
+    return codec_encode(tree->codec, val->mv_data, val->mv_size, buf, val);
+}
+
+static inline int tree_value_decode(const wtree3_tree_t *tree, MDB_val *val, codec_buf_t *buf) {
+    if (WTREE_LIKELY(tree->codec == NULL)) return 0;
+    return codec_decode(tree->codec, val, buf);
+}
+
+static inline int tree_value_decode_txn(const wtree3_tree_t *tree, wtree3_txn_t *txn,
+                                        MDB_val *val) {
+    if (WTREE_LIKELY(tree->codec == NULL)) return 0;
+    return codec_decode_txn(tree->codec, txn, val);
+}
+
+/* A txn ends or is reset: its decoded values go with it */
+static inline void txn_decoded_free(wtree3_txn_t *txn) {
+    if (WTREE_UNLIKELY(txn->decoded != NULL)) codec_arena_free(txn);
+}
+
+/* ============================================================
+ * Change Log (implemented in wtree3_changelog.c)
+ * ============================================================ */
+
+/* Append one record to the tree's log in txn (key NULL for CLEAR) */
+WTREE_WARN_UNUSED
+int changelog_append(wtree3_tree_t *tree, MDB_txn *txn, wtree3_change_op_t op,
+                     const void *key, size_t key_len,
+                     const void *value, size_t value_len,
+                     gerror_t *error);
+
+/*
+ * Write-path hook: a no-op for trees without a log. Keys and values must
+ * stay valid across the call, so cursor deletes log before mdb_cursor_del.
+ */
+static inline int changelog_note(wtree3_tree_t *tree, MDB_txn *txn, wtree3_change_op_t op,
+                                 const void *key, size_t key_len,
+                                 const void *value, size_t value_len,
+                                 gerror_t *error) {
+    if (WTREE_LIKELY(tree->changelog == NULL)) return WTREE3_OK;
+    return changelog_append(tree, txn, op, key, key_len, value, value_len, error);
+}
+
+/* Open the persisted log of a freshly opened tree (none is fine) */
+WTREE_COLD WTREE_WARN_UNUSED
+int changelog_auto_load(wtree3_tree_t *tree, gerror_t *error);
+
+/* Drop a tree's log DBI and its record (tree delete); missing is fine */
+int changelog_delete_txn(MDB_txn *txn, const char *tree_name);
+
+/* ============================================================
+ * Group Commit (implemented in wtree3_group_commit.c)
+ * ============================================================ */
+
+/* Write operations that can be routed through the batcher */
+typedef enum {
+    GROUP_COMMIT_INSERT,
+    GROUP_COMMIT_UPDATE,
+    GROUP_COMMIT_UPSERT,
+    GROUP_COMMIT_DELETE
+} group_commit_op_t;
+
+/* Queue a write and block until its batch has been committed */
+WTREE_HOT WTREE_WARN_UNUSED
+int group_commit_submit(wtree3_group_commit_t *gc, group_commit_op_t op,
+                        wtree3_tree_t *tree,
+                        const void *key, size_t key_len,
+                        const void *value, size_t value_len,
+                        bool *deleted,
+                        gerror_t *error);
+
+/* Free batcher state (no writes may be in flight) */
+WTREE_COLD
+void group_commit_destroy(wtree3_group_commit_t *gc);
+
+/* ============================================================
+ * Write Combining (implemented in wtree3_combine.c)
+ * ============================================================ */
+
+/* Fold an auto-transaction upsert into the tree's buffer (flushes if full) */
+WTREE_HOT WTREE_WARN_UNUSED
+int combine_add(wtree3_tree_t *tree, const void *key, size_t key_len,
+                const void *operand, size_t operand_len, gerror_t *error);
+
+/* Best-effort flush and free (tree close; no other users of the handle) */
+WTREE_COLD
+void combine_destroy(wtree3_tree_t *tree);
+
+/* ============================================================
+ * Deferred Durability (implemented in wtree3_durability.c)
+ * ============================================================ */
+
+#define DURABILITY_ON(db) WTREE_UNLIKELY((db)->durability != NULL)
+
+WTREE_COLD
+void durability_note_write(wtree3_durability_t *d, size_t bytes);
+
+/* Count a commit; wakes the flusher once a threshold is reached */
+WTREE_COLD
+void durability_note_commit(wtree3_durability_t *d);
+
+/* Stop the flusher after a final sync and free its state */
+WTREE_COLD
+void durability_destroy(wtree3_durability_t *d);
+
+/* Called by the CRUD write paths and after every write commit */
+static inline void durability_write(wtree3_db_t *db, size_t bytes) {
+    if (DURABILITY_ON(db)) durability_note_write(db->durability, bytes);
+}
+
+static inline void durability_commit(wtree3_db_t *db) {
+    if (DURABILITY_ON(db)) durability_note_commit(db->durability);
+}
+
+/* ============================================================
+ * Read Transaction Pool (implemented in wtree3_read_pool.c)
+ * ============================================================ */
+
+/* Create a pool keeping up to max idle txns (NULL on allocation failure) */
+WTREE_COLD
+wtree3_read_pool_t *read_pool_create(size_t max);
+
+/* End every idle txn (call before resizing or closing the environment) */
+WTREE_COLD
+void read_pool_drain(wtree3_read_pool_t *pool);
+
+WTREE_COLD
+void read_pool_destroy(wtree3_read_pool_t *pool);
+
+/* Get an active read txn, renewing an idle one when available */
+WTREE_HOT WTREE_WARN_UNUSED
+wtree3_txn_t *read_pool_acquire(wtree3_db_t *db, gerror_t *error);
+
+/* Reset a txn from read_pool_acquire and return it to the pool */
+WTREE_HOT
+void read_pool_release(wtree3_txn_t *txn);
+
+/* Open a cursor on txn, reusing one cached for dbi (returns MDB code) */
+WTREE_HOT WTREE_WARN_UNUSED
+int read_pool_cursor_open(wtree3_txn_t *txn, MDB_dbi dbi, MDB_cursor **out);
+
+/* Close a cursor from read_pool_cursor_open, caching it on pooled txns */
+WTREE_HOT
+void read_pool_cursor_close(wtree3_txn_t *txn, MDB_cursor *cursor);
+
+/* ============================================================
+ * Metrics (implemented in wtree3_metrics.c)
+ * ============================================================ */
+
+/*
+ * Instrumented code brackets an operation with
+ *     uint64_t t0 = metrics_begin(db);
+ *     ...
+ *     metrics_end(db, tree, WTREE3_METRIC_..., t0, bytes);
+ * t0 is 0 while metrics are off, so the disabled cost is the branch in
+ * METRICS_ON plus the one in metrics_end.
+ */
+#ifndef WTREE3_NO_METRICS
+#define METRICS_ON(db) WTREE_UNLIKELY(watomic_load_u32(&(db)->metrics_on) != 0)
+#else
+#define METRICS_ON(db) 0
+#endif
+
+static inline uint64_t metrics_begin(wtree3_db_t *db) {
+    return METRICS_ON(db) ? wtime_now_ns() : 0;
+}
+
+/* Record a finished operation; bytes feed the thread's pending commit size */
+WTREE_COLD
+void metrics_record(wtree3_db_t *db, uint64_t *counters, int op,
+                    uint64_t t0, size_t bytes);
+
+static inline void metrics_end(wtree3_db_t *db, wtree3_tree_t *tree, int op,
+                               uint64_t t0, size_t bytes) {
+    if (WTREE_UNLIKELY(t0 != 0)) metrics_record(db, tree ? tree->metric_ops : NULL, op, t0, bytes);
+}
+
+/* Bump a per-index count (metrics on only) */
+static inline void metrics_count(wtree3_db_t *db, wtree3_index_t *idx, int op) {
+    if (METRICS_ON(db)) watomic_add_u64(&idx->metric_ops[op], 1);
+}
+
+/* A write txn of this thread ended: record commit time and size, or drop them */
+WTREE_COLD
+void metrics_txn_end(wtree3_db_t *db, uint64_t t0, bool committed);
+
+/* Databases with metrics on; translate_mdb_error counts errors while > 0 */
+extern uint32_t metrics_error_watchers;
+
+WTREE_COLD
+void metrics_note_error(int code);
+
+/* Free metrics state (from wtree3_db_close) */
+WTREE_COLD
+void metrics_destroy(wtree3_db_t *db);
+
+/* ============================================================
+ * Memory Hints (implemented in wtree3_memopt.c)
+ * ============================================================ */
+
+/*
+ * Best-effort MADV_WILLNEED for [addr, addr+len); addr is rounded down to
+ * page_size (a power of two). Errors are ignored - it is only a hint.
+ */
+WTREE_HOT
+void memopt_willneed(const void *addr, size_t len, size_t page_size);
+
+/*
+ * Best-effort MADV_DONTNEED for [addr, addr+len): drops the pages from
+ * this mapping once they are no longer needed. The map is a shared file
+ * mapping, so nothing is lost - the next access faults the page back in.
+ */
+WTREE_COLD
+void memopt_dontneed(const void *addr, size_t len, size_t page_size);
+
+/* memopt_probe_key results */
+#define MEMOPT_PROBE_RESIDENT   1   /* Every page the lookup reads is in memory */
+#define MEMOPT_PROBE_MISSING    0   /* A page is not (advised if asked) */
+#define MEMOPT_PROBE_UNKNOWN   -1   /* Platform or page layout did not allow a check */
+
+/*
+ * Would looking up key in the named DB (dbi, its tree name) fault?
+ * Walks the root-to-leaf path in txn's snapshot with mincore before each
+ * page, plus the overflow pages of a large value. With advise, the first
+ * missing page (or overflow run) gets MADV_WILLNEED. Read txns only.
+ */
+WTREE_HOT
+int memopt_probe_key(MDB_txn *txn, MDB_dbi dbi, const char *name, const MDB_val *key,
+                     bool advise);
+
 #endif /* WTREE3_INTERNAL_H */
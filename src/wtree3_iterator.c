@@ -6,7 +6,10 @@
  * - Navigation: first, last, next, prev, seek, seek_range
  * - Data access: key, value, key_copy, value_copy
  * - Operations: delete, valid, get_txn
- * - Index queries: index_seek, index_seek_range, index_iterator_main_key
+ * - Index queries: index_seek, index_seek_range, index_iterator_main_key,
+ *   index_iterator_payload
+ * - Prepared index handles: index_handle_open/close/seek/next/next_page
+ *   (cached cursor reused across caller-owned txns)
  */
 
 #include "wtree3_internal.h"
@@ -21,20 +24,20 @@ wtree3_iterator_t* wtree3_iterator_create(wtree3_tree_t *tree, gerror_t *error)
         return NULL;
     }
 
-    wtree3_txn_t *txn = wtree3_txn_begin(tree->db, false, error);
+    wtree3_txn_t *txn = read_pool_acquire(tree->db, error);
     if (!txn) return NULL;
 
     wtree3_iterator_t *iter = calloc(1, sizeof(wtree3_iterator_t));
     if (!iter) {
-        wtree3_txn_abort(txn);
+        read_pool_release(txn);
         set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate iterator");
         return NULL;
     }
 
-    int rc = mdb_cursor_open(txn->txn, tree->dbi, &iter->cursor);
+    int rc = read_pool_cursor_open(txn, tree->dbi, &iter->cursor);
     if (rc != 0) {
         translate_mdb_error(rc, error);
-        wtree3_txn_abort(txn);
+        read_pool_release(txn);
         free(iter);
         return NULL;
     }
@@ -159,10 +162,25 @@ bool wtree3_iterator_key(wtree3_iterator_t *iter, const void **key, size_t *key_
     return true;
 }
 
+/* Current value; for covering index iterators the main key part of the dup,
+ * for main tree iterators the decoded value */
+static inline bool iterator_value_view(wtree3_iterator_t *iter, MDB_val *v) {
+    *v = iter->current_val;
+    if (WTREE_UNLIKELY(iter->covering)) {
+        MDB_val main_key;
+        if (index_dup_split(true, &iter->current_val, &main_key, NULL)) *v = main_key;
+        return true;
+    }
+    if (iter->is_index || !iter->tree) return true;
+    return tree_value_decode(iter->tree, v, &iter->decoded) == 0;
+}
+
 bool wtree3_iterator_value(wtree3_iterator_t *iter, const void **value, size_t *value_len) {
     if (!iter || !iter->valid || !value || !value_len) return false;
-    *value = iter->current_val.mv_data;
-    *value_len = iter->current_val.mv_size;
+    MDB_val v;
+    if (!iterator_value_view(iter, &v)) return false;
+    *value = v.mv_data;
+    *value_len = v.mv_size;
     return true;
 }
 
@@ -180,11 +198,13 @@ bool wtree3_iterator_key_copy(wtree3_iterator_t *iter, void **key, size_t *key_l
 bool wtree3_iterator_value_copy(wtree3_iterator_t *iter, void **value, size_t *value_len) {
     if (!iter || !iter->valid || !value || !value_len) return false;
 
-    *value_len = iter->current_val.mv_size;
+    MDB_val v;
+    if (!iterator_value_view(iter, &v)) return false;
+    *value_len = v.mv_size;
     *value = malloc(*value_len);
     if (!*value) return false;
 
-    memcpy(*value, iter->current_val.mv_data, *value_len);
+    memcpy(*value, v.mv_data, *value_len);
     return true;
 }
 
@@ -214,6 +234,7 @@ static int wtree3_iterator_delete_raw(wtree3_iterator_t *iter, gerror_t *error)
 
     int rc = mdb_cursor_del(iter->cursor, 0);
     if (rc != 0) return translate_mdb_error(rc, error);
+    if (!iter->is_index && iter->tree) filter_note_remove(iter->tree->filter);
 
     iter->valid = false;
     rc = mdb_cursor_get(iter->cursor, &iter->current_key, &iter->current_val, MDB_GET_CURRENT);
@@ -263,24 +284,38 @@ int wtree3_iterator_delete(wtree3_iterator_t *iter, gerror_t *error) {
     /* Get current key and value before deletion */
     const void *key = iter->current_key.mv_data;
     size_t key_len = iter->current_key.mv_size;
-    const void *value = iter->current_val.mv_data;
-    size_t value_len = iter->current_val.mv_size;
+    MDB_val val = iter->current_val;
 
-    if (!key || !value) {
+    if (!key || !val.mv_data) {
         set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Iterator has invalid key/value");
         return WTREE3_EINVAL;
     }
 
+    index_pin_t pin;
+    const index_set_t *set = index_set_pin(tree, &pin);
+    int rc = set->count > 0 ? tree_value_decode(tree, &val, &iter->decoded) : 0;
+    if (rc != 0) {
+        index_set_unpin(&pin);
+        return translate_mdb_error(rc, error);
+    }
+    const void *value = val.mv_data;
+    size_t value_len = val.mv_size;
+
     /* Delete from secondary indexes first */
-    int rc = indexes_delete(tree, iter->txn->txn, key, key_len, value, value_len, error);
+    rc = indexes_delete(tree, set, iter->txn->txn, key, key_len, value, value_len, error);
+    index_set_unpin(&pin);
+    if (rc != 0) return rc;
+
+    /* Logged first: the key lives in the cursor's page */
+    rc = changelog_note(tree, iter->txn->txn, WTREE3_CHANGE_DELETE, key, key_len, NULL, 0, error);
     if (rc != 0) return rc;
 
     /* Delete from main tree via cursor */
     rc = mdb_cursor_del(iter->cursor, 0);
     if (rc != 0) return translate_mdb_error(rc, error);
+    filter_note_remove(tree->filter);
 
     /* Update iterator state */
-    tree->entry_count--;
     iter->valid = false;
 
     /* Try to position on next entry */
@@ -296,14 +331,15 @@ int wtree3_iterator_delete(wtree3_iterator_t *iter, gerror_t *error) {
 void wtree3_iterator_close(wtree3_iterator_t *iter) {
     if (!iter) return;
 
-    if (iter->cursor) {
-        mdb_cursor_close(iter->cursor);
-    }
-
     if (iter->owns_txn && iter->txn) {
-        wtree3_txn_abort(iter->txn);
+        /* Auto txns come from the read pool - keep their cursor for reuse */
+        read_pool_cursor_close(iter->txn, iter->cursor);
+        read_pool_release(iter->txn);
+    } else if (iter->cursor) {
+        mdb_cursor_close(iter->cursor);
     }
 
+    codec_buf_release(&iter->decoded);
     free(iter);
 }
 
@@ -325,27 +361,50 @@ static wtree3_iterator_t* index_seek_internal(wtree3_tree_t *tree,
         return NULL;
     }
 
-    wtree3_index_t *idx = find_index(tree, index_name);
+    /*
+     * Pinned until the cursor is positioned: a concurrent drop_index may
+     * not free the index (or close its DBI) under the seek. The iterator
+     * keeps its own copy of what it needs, and is closed before drop_index
+     * like any caller-held iterator.
+     */
+    index_pin_t pin;
+    wtree3_index_t *idx = index_set_find(index_set_pin(tree, &pin), index_name);
     if (!idx) {
+        index_set_unpin(&pin);
         set_error(error, WTREE3_LIB, WTREE3_NOT_FOUND,
                  "Index '%s' not found", index_name);
         return NULL;
     }
 
-    wtree3_txn_t *txn = wtree3_txn_begin(tree->db, false, error);
-    if (!txn) return NULL;
+    /* Partially built indexes would return incomplete results */
+    if (idx->building) {
+        index_set_unpin(&pin);
+        set_error(error, WTREE3_LIB, WTREE3_NOT_FOUND,
+                 "Index '%s' is still being built", index_name);
+        return NULL;
+    }
+    MDB_dbi dbi = idx->dbi;
+    bool covering = idx->project_fn != NULL;
+
+    wtree3_txn_t *txn = read_pool_acquire(tree->db, error);
+    if (!txn) {
+        index_set_unpin(&pin);
+        return NULL;
+    }
 
     wtree3_iterator_t *iter = calloc(1, sizeof(wtree3_iterator_t));
     if (!iter) {
-        wtree3_txn_abort(txn);
+        index_set_unpin(&pin);
+        read_pool_release(txn);
         set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate iterator");
         return NULL;
     }
 
-    int rc = mdb_cursor_open(txn->txn, idx->dbi, &iter->cursor);
+    int rc = read_pool_cursor_open(txn, dbi, &iter->cursor);
     if (rc != 0) {
+        index_set_unpin(&pin);
         translate_mdb_error(rc, error);
-        wtree3_txn_abort(txn);
+        read_pool_release(txn);
         free(iter);
         return NULL;
     }
@@ -354,6 +413,7 @@ static wtree3_iterator_t* index_seek_internal(wtree3_tree_t *tree,
     iter->tree = tree;
     iter->owns_txn = true;
     iter->is_index = true;
+    iter->covering = covering;
     iter->valid = false;
 
     /* Seek to key */
@@ -374,6 +434,7 @@ static wtree3_iterator_t* index_seek_internal(wtree3_tree_t *tree,
         }
     }
 
+    index_set_unpin(&pin);
     return iter;
 }
 
@@ -399,3 +460,203 @@ bool wtree3_index_iterator_main_key(wtree3_iterator_t *iter,
            wtree3_iterator_value(iter, main_key, main_key_len);
 }
 
+bool wtree3_index_iterator_payload(wtree3_iterator_t *iter,
+                                   const void **payload,
+                                   size_t *payload_len) {
+    if (!iter || !iter->valid || !iter->covering || !payload || !payload_len) return false;
+
+    MDB_val main_key, p;
+    if (WTREE_UNLIKELY(!index_dup_split(true, &iter->current_val, &main_key, &p))) return false;
+    *payload = p.mv_data;
+    *payload_len = p.mv_size;
+    return true;
+}
+
+
+/* ============================================================
+ * Prepared Index Handles
+ * ============================================================ */
+
+WTREE_COLD
+wtree3_index_handle_t* wtree3_index_handle_open(wtree3_tree_t *tree,
+                                                const char *index_name,
+                                                gerror_t *error) {
+    if (!tree || !index_name) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return NULL;
+    }
+
+    /* The handle keeps idx: like an iterator, it is closed before drop_index */
+    index_pin_t pin;
+    wtree3_index_t *idx = index_set_find(index_set_pin(tree, &pin), index_name);
+    bool building = idx && idx->building;
+    index_set_unpin(&pin);
+    if (!idx) {
+        set_error(error, WTREE3_LIB, WTREE3_NOT_FOUND,
+                 "Index '%s' not found", index_name);
+        return NULL;
+    }
+    if (building) {
+        set_error(error, WTREE3_LIB, WTREE3_NOT_FOUND,
+                 "Index '%s' is still being built", index_name);
+        return NULL;
+    }
+
+    wtree3_index_handle_t *handle = calloc(1, sizeof(wtree3_index_handle_t));
+    if (!handle) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate index handle");
+        return NULL;
+    }
+    handle->tree = tree;
+    handle->idx = idx;
+    return handle;
+}
+
+void wtree3_index_handle_close(wtree3_index_handle_t *handle) {
+    if (!handle) return;
+
+    /* Write-txn cursors belong to their txn, which frees them at its end */
+    if (handle->cursor && !handle->cursor_write) mdb_cursor_close(handle->cursor);
+    free(handle);
+}
+
+/* Bind the cached cursor to txn, opening or renewing it as needed */
+static int handle_bind(wtree3_index_handle_t *h, wtree3_txn_t *txn) {
+    MDB_txn *mtxn = txn->txn;
+    size_t id = mdb_txn_id(mtxn);
+
+    if (txn->is_write) {
+        if (h->cursor && h->cursor_write && h->cursor_txn == mtxn && h->cursor_txn_id == id) {
+            return 0;
+        }
+        if (h->cursor && !h->cursor_write) mdb_cursor_close(h->cursor);
+        h->cursor = NULL;  /* An old write cursor went away with its txn */
+    } else if (h->cursor && !h->cursor_write) {
+        /* Cheap, and always valid for read txns - even the same one */
+        int rc = mdb_cursor_renew(mtxn, h->cursor);
+        if (rc == 0) {
+            h->cursor_txn = mtxn;
+            h->cursor_txn_id = id;
+            return 0;
+        }
+        mdb_cursor_close(h->cursor);
+        h->cursor = NULL;
+    } else {
+        h->cursor = NULL;
+    }
+
+    int rc = mdb_cursor_open(mtxn, h->idx->dbi, &h->cursor);
+    if (rc != 0) {
+        h->cursor = NULL;
+        return rc;
+    }
+    h->cursor_txn = mtxn;
+    h->cursor_txn_id = id;
+    h->cursor_write = txn->is_write;
+    return 0;
+}
+
+static int handle_hit(wtree3_index_handle_t *h, const MDB_val *key, const MDB_val *val,
+                      wtree3_index_hit_t *hit, gerror_t *error) {
+    MDB_val main_key, payload;
+    if (WTREE_UNLIKELY(!index_dup_split(h->idx->project_fn != NULL, val, &main_key, &payload))) {
+        h->positioned = false;
+        set_error(error, WTREE3_LIB, WTREE3_INDEX_ERROR,
+                 "Malformed entry in covering index '%s'", h->idx->name);
+        return WTREE3_INDEX_ERROR;
+    }
+
+    hit->index_key = key->mv_data;
+    hit->index_key_len = key->mv_size;
+    hit->main_key = main_key.mv_data;
+    hit->main_key_len = main_key.mv_size;
+    hit->payload = payload.mv_data;
+    hit->payload_len = payload.mv_size;
+    return WTREE3_OK;
+}
+
+WTREE_HOT WTREE_WARN_UNUSED
+int wtree3_index_handle_seek(wtree3_index_handle_t *handle, wtree3_txn_t *txn,
+                             const void *key, size_t key_len, unsigned int flags,
+                             wtree3_index_hit_t *hit, gerror_t *error) {
+    if (WTREE_UNLIKELY(!handle || !txn || !key || key_len == 0 || !hit)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+
+    handle->positioned = false;
+    if (WTREE_UNLIKELY(handle->idx->building)) {
+        set_error(error, WTREE3_LIB, WTREE3_NOT_FOUND,
+                 "Index '%s' is still being built", handle->idx->name);
+        return WTREE3_NOT_FOUND;
+    }
+
+    int rc = handle_bind(handle, txn);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+
+    bool range = (flags & WTREE3_SEEK_RANGE) != 0;
+    MDB_val mkey = {.mv_size = key_len, .mv_data = (void *)key};
+    MDB_val mval;
+    rc = mdb_cursor_get(handle->cursor, &mkey, &mval, range ? MDB_SET_RANGE : MDB_SET_KEY);
+    if (rc != 0) return translate_mdb_error(rc, error);
+
+    handle->positioned = true;
+    handle->exact = !range;
+    return handle_hit(handle, &mkey, &mval, hit, error);
+}
+
+WTREE_HOT WTREE_WARN_UNUSED
+int wtree3_index_handle_next(wtree3_index_handle_t *handle, wtree3_index_hit_t *hit,
+                             gerror_t *error) {
+    if (WTREE_UNLIKELY(!handle || !hit)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+    if (WTREE_UNLIKELY(!handle->positioned)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Index handle is not positioned");
+        return WTREE3_EINVAL;
+    }
+
+    MDB_val mkey, mval;
+    int rc = mdb_cursor_get(handle->cursor, &mkey, &mval, handle->exact ? MDB_NEXT_DUP : MDB_NEXT);
+    if (rc != 0) {
+        handle->positioned = false;
+        return translate_mdb_error(rc, error);
+    }
+    return handle_hit(handle, &mkey, &mval, hit, error);
+}
+
+WTREE_HOT WTREE_WARN_UNUSED
+int wtree3_index_handle_next_page(wtree3_index_handle_t *handle, wtree3_index_page_t *page,
+                                  gerror_t *error) {
+    if (WTREE_UNLIKELY(!handle || !page)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+    if (WTREE_UNLIKELY(!handle->positioned || !handle->exact)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Index handle is not on an exact seek");
+        return WTREE3_EINVAL;
+    }
+
+    /* The cursor is on the last entry handed out: page from there, minus it */
+    MDB_val mkey, mval;
+    int rc = mdb_cursor_get(handle->cursor, &mkey, &mval, MDB_GET_CURRENT);
+    if (WTREE_UNLIKELY(rc != 0)) {
+        handle->positioned = false;
+        return translate_mdb_error(rc, error);
+    }
+
+    rc = index_cursor_page(handle->cursor, handle->idx, &mval, page, error);
+    if (rc == WTREE3_OK && page->count > 1) {
+        page->main_keys = (const unsigned char *)page->main_keys + page->key_size;
+        page->count--;
+        return WTREE3_OK;
+    }
+    if (rc == WTREE3_OK) rc = index_cursor_page(handle->cursor, handle->idx, NULL, page, error);
+
+    if (rc != WTREE3_OK) {
+        handle->positioned = false;
+        if (rc == WTREE3_NOT_FOUND) return translate_mdb_error(MDB_NOTFOUND, error);
+    }
+    return rc;
+}
@@ -0,0 +1,265 @@
+/*
+ * wtree3_key_spec.c - Declarative Index Keys
+ *
+ * A key spec lists fixed-offset fields of a packed value; the index key
+ * is their order-preserving encodings concatenated. Extraction is a loop
+ * over at most WTREE3_KEY_PARTS_MAX parts writing into the caller's
+ * inline key buffer: no indirect call, no allocation, no shared state,
+ * so CRUD, bulk loads and (parallel) index builds all run it inline.
+ *
+ * Encodings:
+ *   U32/U64      big-endian
+ *   I64          big-endian with the sign bit flipped
+ *   BYTES        the field as-is
+ *   STRING       bytes up to the NUL or the field end, plus a 0x00
+ *                terminator unless it is the last part
+ *
+ * This module provides:
+ * - wtree3_key_spec_encode
+ * - key_spec_validate, key_spec_extract
+ * - key_spec_serialized_size, key_spec_serialize, key_spec_deserialize
+ */
+
+#include "wtree3_internal.h"
+#include "macros.h"
+
+/* ============================================================
+ * Constants
+ * ============================================================ */
+
+#define SPEC_HEADER_SIZE    4       /* part_count:4 */
+#define SPEC_PART_SIZE      12      /* [offset:4][length:4][type:1][sparse:1][pad:2] */
+
+typedef enum {
+    SPEC_OK,
+    SPEC_SKIP,                      /* A sparse_if_zero field is zero */
+    SPEC_SHORT,                     /* Value ends before a field */
+    SPEC_NOSPACE                    /* Output buffer too small */
+} spec_status_t;
+
+/* ============================================================
+ * Encoding
+ * ============================================================ */
+
+static size_t part_field_size(const wtree3_key_part_t *part) {
+    switch (part->type) {
+        case WTREE3_KEY_U32: return 4;
+        case WTREE3_KEY_U64:
+        case WTREE3_KEY_I64: return 8;
+        default:             return part->length;
+    }
+}
+
+static inline void store_be(unsigned char *out, uint64_t v, size_t width) {
+    for (size_t i = width; i-- > 0; ) {
+        out[i] = (unsigned char)v;
+        v >>= 8;
+    }
+}
+
+static bool all_zero(const unsigned char *p, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (p[i]) return false;
+    }
+    return true;
+}
+
+WTREE_HOT
+static spec_status_t spec_encode(const wtree3_key_spec_t *spec,
+                                 const void *value, size_t value_len,
+                                 unsigned char *out, size_t cap, size_t *out_len) {
+    const unsigned char *v = (const unsigned char *)value;
+    size_t n = 0;
+
+    for (size_t i = 0; i < spec->part_count; i++) {
+        const wtree3_key_part_t *part = &spec->parts[i];
+        size_t size = part_field_size(part);
+        if (WTREE_UNLIKELY(part->offset > value_len || size > value_len - part->offset)) {
+            return SPEC_SHORT;
+        }
+        const unsigned char *field = v + part->offset;
+
+        switch (part->type) {
+            case WTREE3_KEY_U32: {
+                uint32_t x;
+                memcpy(&x, field, 4);
+                if (part->sparse_if_zero && x == 0) return SPEC_SKIP;
+                if (WTREE_UNLIKELY(cap - n < 4)) return SPEC_NOSPACE;
+                store_be(out + n, x, 4);
+                n += 4;
+                break;
+            }
+            case WTREE3_KEY_U64:
+            case WTREE3_KEY_I64: {
+                uint64_t x;
+                memcpy(&x, field, 8);
+                if (part->sparse_if_zero && x == 0) return SPEC_SKIP;
+                if (part->type == WTREE3_KEY_I64) x ^= (uint64_t)1 << 63;
+                if (WTREE_UNLIKELY(cap - n < 8)) return SPEC_NOSPACE;
+                store_be(out + n, x, 8);
+                n += 8;
+                break;
+            }
+            case WTREE3_KEY_BYTES:
+                if (part->sparse_if_zero && all_zero(field, size)) return SPEC_SKIP;
+                if (WTREE_UNLIKELY(cap - n < size)) return SPEC_NOSPACE;
+                memcpy(out + n, field, size);
+                n += size;
+                break;
+            default: {  /* WTREE3_KEY_STRING */
+                const unsigned char *nul = memchr(field, 0, size);
+                size_t len = nul ? (size_t)(nul - field) : size;
+                if (part->sparse_if_zero && len == 0) return SPEC_SKIP;
+                bool terminate = i + 1 < spec->part_count;
+                if (WTREE_UNLIKELY(cap - n < len + terminate)) return SPEC_NOSPACE;
+                memcpy(out + n, field, len);
+                n += len;
+                if (terminate) out[n++] = 0;
+                break;
+            }
+        }
+    }
+
+    *out_len = n;
+    return SPEC_OK;
+}
+
+/* ============================================================
+ * Internal API
+ * ============================================================ */
+
+WTREE_COLD WTREE_WARN_UNUSED
+int key_spec_validate(const wtree3_key_spec_t *spec, gerror_t *error) {
+    if (WTREE_UNLIKELY(spec->part_count == 0 || spec->part_count > WTREE3_KEY_PARTS_MAX)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                 "Key spec needs 1 to %d parts", WTREE3_KEY_PARTS_MAX);
+        return WTREE3_EINVAL;
+    }
+
+    size_t max_len = 0;
+    for (size_t i = 0; i < spec->part_count; i++) {
+        const wtree3_key_part_t *part = &spec->parts[i];
+        switch (part->type) {
+            case WTREE3_KEY_U32:
+            case WTREE3_KEY_U64:
+            case WTREE3_KEY_I64:
+                break;
+            case WTREE3_KEY_BYTES:
+            case WTREE3_KEY_STRING:
+                if (part->length == 0) {
+                    set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                             "Key spec part %zu needs a length", i);
+                    return WTREE3_EINVAL;
+                }
+                break;
+            default:
+                set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                         "Key spec part %zu has unknown type %d", i, (int)part->type);
+                return WTREE3_EINVAL;
+        }
+
+        size_t size = part_field_size(part);
+        if ((uint64_t)part->offset + size > UINT32_MAX) {
+            set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                     "Key spec part %zu ends past 4 GiB", i);
+            return WTREE3_EINVAL;
+        }
+        max_len += size + (part->type == WTREE3_KEY_STRING && i + 1 < spec->part_count);
+    }
+
+    if (max_len > INDEX_KEY_INLINE) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                 "Key spec yields keys of up to %zu bytes (max %d)", max_len, INDEX_KEY_INLINE);
+        return WTREE3_EINVAL;
+    }
+    return WTREE3_OK;
+}
+
+WTREE_HOT
+bool key_spec_extract(const wtree3_key_spec_t *spec, bool sparse,
+                      const void *value, size_t value_len, index_key_t *key) {
+    size_t len = 0;
+    switch (spec_encode(spec, value, value_len, key->buf, sizeof(key->buf), &len)) {
+        case SPEC_OK:
+            key->data = key->buf;
+            key->len = len;
+            return true;
+        case SPEC_SKIP:
+            return false;
+        default:
+            /* Too short for the spec: not indexed if sparse, a failure otherwise */
+            return !sparse;
+    }
+}
+
+size_t key_spec_serialized_size(const wtree3_key_spec_t *spec) {
+    return SPEC_HEADER_SIZE + spec->part_count * SPEC_PART_SIZE;
+}
+
+void key_spec_serialize(const wtree3_key_spec_t *spec, uint8_t *out) {
+    uint32_t count = (uint32_t)spec->part_count;
+    memcpy(out, &count, 4);
+    out += SPEC_HEADER_SIZE;
+
+    for (size_t i = 0; i < spec->part_count; i++, out += SPEC_PART_SIZE) {
+        const wtree3_key_part_t *part = &spec->parts[i];
+        memcpy(out, &part->offset, 4);
+        memcpy(out + 4, &part->length, 4);
+        out[8] = (uint8_t)part->type;
+        out[9] = part->sparse_if_zero ? 1 : 0;
+        out[10] = 0;
+        out[11] = 0;
+    }
+}
+
+bool key_spec_deserialize(const void *data, size_t data_len, wtree3_key_spec_t *out) {
+    const uint8_t *p = (const uint8_t *)data;
+    uint32_t count;
+    if (data_len < SPEC_HEADER_SIZE) return false;
+    memcpy(&count, p, 4);
+    if (count == 0 || count > WTREE3_KEY_PARTS_MAX ||
+        data_len != SPEC_HEADER_SIZE + (size_t)count * SPEC_PART_SIZE) {
+        return false;
+    }
+
+    memset(out, 0, sizeof(*out));
+    out->part_count = count;
+    p += SPEC_HEADER_SIZE;
+    for (uint32_t i = 0; i < count; i++, p += SPEC_PART_SIZE) {
+        wtree3_key_part_t *part = &out->parts[i];
+        memcpy(&part->offset, p, 4);
+        memcpy(&part->length, p + 4, 4);
+        part->type = (wtree3_key_type_t)p[8];
+        part->sparse_if_zero = p[9] != 0;
+    }
+    return key_spec_validate(out, NULL) == WTREE3_OK;
+}
+
+/* ============================================================
+ * Public API
+ * ============================================================ */
+
+WTREE_WARN_UNUSED
+int wtree3_key_spec_encode(const wtree3_key_spec_t *spec,
+                           const void *value, size_t value_len,
+                           void *buf, size_t buf_cap,
+                           size_t *out_len, gerror_t *error) {
+    if (WTREE_UNLIKELY(!spec || (!value && value_len) || !buf || !out_len)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+
+    int rc = key_spec_validate(spec, error);
+    if (rc != WTREE3_OK) return rc;
+
+    switch (spec_encode(spec, value, value_len, buf, buf_cap, out_len)) {
+        case SPEC_OK:
+            return WTREE3_OK;
+        case SPEC_NOSPACE:
+            set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Key buffer too small");
+            return WTREE3_EINVAL;
+        default:
+            set_error(error, WTREE3_LIB, WTREE3_NOT_FOUND, "Value yields no index key");
+            return WTREE3_NOT_FOUND;
+    }
+}
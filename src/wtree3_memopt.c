@@ -6,6 +6,8 @@
  * - Memory locking (mlock/munlock)
  * - Page prefetching
  * - Memory map introspection
+ * - Tree warmup (branch levels, then leaves, of a tree and its indexes)
+ * - Residency probes (would a lookup of this key fault?)
  *
  * Platform support:
  * - POSIX (Linux, BSD, macOS): Full support
@@ -18,6 +20,7 @@
 
 #if WTREE_OS_POSIX
     #include <sys/mman.h>
+    #include <unistd.h>
     #include <errno.h>
     #include <string.h>
 #elif WTREE_OS_WINDOWS
@@ -322,3 +325,493 @@ int wtree3_db_prefetch(wtree3_db_t *db, size_t offset, size_t length, gerror_t *
 
     return WTREE3_OK;
 }
+
+/* ============================================================
+ * Internal Hints
+ * ============================================================ */
+
+WTREE_HOT
+void memopt_willneed(const void *addr, size_t len, size_t page_size) {
+    uintptr_t start = (uintptr_t)addr & ~(uintptr_t)(page_size - 1);
+    len += (uintptr_t)addr - start;
+
+#if WTREE_OS_POSIX
+    (void)madvise((void *)start, len, MADV_WILLNEED);
+#elif WTREE_OS_WINDOWS && defined(PrefetchVirtualMemory)
+    WIN32_MEMORY_RANGE_ENTRY range = {(void *)start, len};
+    (void)PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+    (void)start;
+    (void)len;
+#endif
+}
+
+WTREE_COLD
+void memopt_dontneed(const void *addr, size_t len, size_t page_size) {
+    uintptr_t start = (uintptr_t)addr & ~(uintptr_t)(page_size - 1);
+    len += (uintptr_t)addr - start;
+
+#if WTREE_OS_POSIX
+    (void)madvise((void *)start, len, MADV_DONTNEED);
+#else
+    (void)start;    /* File views have no per-range equivalent */
+    (void)len;
+#endif
+}
+
+/* ============================================================
+ * Tree Warmup
+ *
+ * LMDB keeps a named DB's root page, depth and page counts in an MDB_db
+ * record stored as the DB's value in the main DB, and its page layout
+ * has been fixed since the 0.9 file format. Warmup reads that record and
+ * walks the branch levels straight from the map: every level is
+ * prefetched in one batch before it is parsed, so branch pages arrive in
+ * depth-many waits rather than one fault each. The bottom branch level
+ * names the leaf pages, which are sorted, coalesced into runs and handed
+ * to MADV_WILLNEED without being touched.
+ *
+ * Anything that does not parse as expected stops the walk of that tree;
+ * warmup is only a hint. Overflow pages (large values) and the subtrees
+ * of index keys with many duplicates are not reached; they fault in on
+ * first access as before.
+ * ============================================================ */
+
+#define LMDB_P_BRANCH   0x01        /* mp_flags: branch page */
+#define LMDB_P_INVALID  (~(size_t)0)
+#define LMDB_PAGEHDRSZ  (sizeof(size_t) + 8)    /* mp_p, mp_pad, mp_flags, mp_lower, mp_upper */
+
+/* Leading fields of LMDB's MDB_db (the value of a named DB in the main DB) */
+typedef struct {
+    uint32_t md_pad;
+    uint16_t md_flags;
+    uint16_t md_depth;
+    size_t md_branch_pages;
+    size_t md_leaf_pages;
+    size_t md_overflow_pages;
+    size_t md_entries;
+    size_t md_root;
+} lmdb_db_record_t;
+
+typedef struct {
+    size_t *pages;
+    size_t count;
+    size_t cap;
+} pgno_list_t;
+
+typedef struct {
+    const unsigned char *map;
+    size_t psize;
+    size_t last_pgno;
+    unsigned int flags;
+    uint64_t budget;                /* Pages left (UINT64_MAX = no limit) */
+    pgno_list_t bottom;             /* Lowest branch level of every tree */
+    pgno_list_t leaf_roots;         /* Depth-1 trees: the root is the only leaf */
+    wtree3_warmup_stats_t stats;
+    int rc;                         /* First mlock failure (errno) */
+} warmup_ctx_t;
+
+static bool pgno_push(pgno_list_t *list, size_t pgno) {
+    if (list->count == list->cap) {
+        size_t cap = list->cap ? list->cap * 2 : 64;
+        size_t *pages = realloc(list->pages, cap * sizeof(size_t));
+        if (!pages) return false;
+        list->pages = pages;
+        list->cap = cap;
+    }
+    list->pages[list->count++] = pgno;
+    return true;
+}
+
+static int pgno_cmp(const void *a, const void *b, void *ctx) {
+    (void)ctx;
+    size_t x = *(const size_t *)a, y = *(const size_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static inline uint16_t load_u16(const unsigned char *p) {
+    uint16_t v;
+    memcpy(&v, p, 2);
+    return v;
+}
+
+/* Branch page header check; returns the key count or 0 if pgno is not a branch */
+static size_t branch_keys(const warmup_ctx_t *w, size_t pgno, const unsigned char **out) {
+    if (pgno > w->last_pgno) return 0;
+    const unsigned char *page = w->map + pgno * w->psize;
+
+    size_t stored;
+    memcpy(&stored, page, sizeof(size_t));
+    uint16_t flags = load_u16(page + sizeof(size_t) + 2);
+    uint16_t lower = load_u16(page + sizeof(size_t) + 4);
+    uint16_t upper = load_u16(page + sizeof(size_t) + 6);
+    if (stored != pgno || !(flags & LMDB_P_BRANCH) ||
+        lower < LMDB_PAGEHDRSZ || lower > upper || upper > w->psize) {
+        return 0;
+    }
+    *out = page;
+    return (lower - LMDB_PAGEHDRSZ) >> 1;
+}
+
+/* Child page number of node i of a branch page (NODEPGNO) */
+static size_t branch_child(const warmup_ctx_t *w, const unsigned char *page, size_t i) {
+    uint16_t off = load_u16(page + LMDB_PAGEHDRSZ + 2 * i);
+    if (off + 8u > w->psize) return LMDB_P_INVALID;
+
+    const unsigned char *node = page + off;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    size_t pgno = (size_t)load_u16(node + 2) | ((size_t)load_u16(node) << 16);
+#else
+    size_t pgno = (size_t)load_u16(node) | ((size_t)load_u16(node + 2) << 16);
+#endif
+    if (sizeof(size_t) > 4) pgno |= (size_t)load_u16(node + 4) << 16 << 16;
+    return pgno;
+}
+
+static int lock_range(const void *addr, size_t len) {
+#if WTREE_OS_POSIX
+    return mlock(addr, len) == 0 ? 0 : errno;
+#elif WTREE_OS_WINDOWS
+    return VirtualLock((void *)addr, len) ? 0 : (int)GetLastError();
+#else
+    (void)addr;
+    (void)len;
+    return ENOTSUP;
+#endif
+}
+
+/*
+ * Sort pages, charge them to the budget (dropping what does not fit) and
+ * prefetch them as coalesced runs; with lock, mlock the runs too.
+ * Returns: how many of the (now sorted) pages were taken
+ */
+static size_t advise_pages(warmup_ctx_t *w, size_t *pages, size_t count, bool lock,
+                           uint64_t *counter) {
+    if (count == 0 || w->budget == 0) return 0;
+    (void)wsort(pages, count, sizeof(size_t), pgno_cmp, NULL);
+    if (count > w->budget) count = (size_t)w->budget;
+    w->budget -= count;
+    *counter += count;
+    w->stats.bytes += (uint64_t)count * w->psize;
+
+    for (size_t i = 0; i < count; ) {
+        size_t j = i + 1;
+        while (j < count && pages[j] <= pages[j - 1] + 1) j++;
+
+        const unsigned char *addr = w->map + pages[i] * w->psize;
+        size_t len = (pages[j - 1] - pages[i] + 1) * w->psize;
+        memopt_willneed(addr, len, w->psize);
+        if (lock && w->rc == 0) w->rc = lock_range(addr, len);
+        i = j;
+    }
+    return count;
+}
+
+/* Walk the branch levels of one named DB, top down (false on ENOMEM only) */
+static bool warmup_collect(warmup_ctx_t *w, MDB_txn *txn, MDB_dbi main_dbi, const char *name) {
+    MDB_val key = {.mv_size = strlen(name), .mv_data = (void *)name};
+    MDB_val val;
+    lmdb_db_record_t rec;
+    if (mdb_get(txn, main_dbi, &key, &val) != 0 || val.mv_size != sizeof(rec)) return true;
+    memcpy(&rec, val.mv_data, sizeof(rec));
+    if (rec.md_root == LMDB_P_INVALID || rec.md_depth == 0) return true;
+
+    if (rec.md_depth == 1) return pgno_push(&w->leaf_roots, rec.md_root);
+
+    pgno_list_t level = {0}, next = {0};
+    if (!pgno_push(&level, rec.md_root)) return false;
+
+    bool ok = true;
+    bool lock = (w->flags & WTREE3_WARMUP_LOCK_BRANCHES) != 0;
+    for (unsigned int depth = 1; depth < rec.md_depth && level.count > 0; depth++) {
+        /* Fetch the whole level in one go, then read what fit the budget */
+        size_t taken = advise_pages(w, level.pages, level.count, lock, &w->stats.branch_pages);
+
+        bool bottom = depth + 1 == rec.md_depth;
+        for (size_t i = 0; i < taken && ok; i++) {
+            const unsigned char *page;
+            size_t keys = branch_keys(w, level.pages[i], &page);
+            if (keys == 0) continue;
+            if (bottom) {
+                ok = pgno_push(&w->bottom, level.pages[i]);
+                continue;
+            }
+            for (size_t k = 0; k < keys && ok; k++) {
+                size_t child = branch_child(w, page, k);
+                if (child != LMDB_P_INVALID) ok = pgno_push(&next, child);
+            }
+        }
+        if (!ok || bottom || taken < level.count) break;
+
+        pgno_list_t tmp = level;
+        level = next;
+        next = tmp;
+        next.count = 0;
+    }
+
+    free(level.pages);
+    free(next.pages);
+    return ok;
+}
+
+WTREE_WARN_UNUSED
+int wtree3_tree_warmup(wtree3_tree_t *tree, unsigned int flags, size_t budget_bytes,
+                       wtree3_warmup_stats_t *out, gerror_t *error) {
+    if (WTREE_UNLIKELY(!tree)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Tree cannot be NULL");
+        return WTREE3_EINVAL;
+    }
+    if (out) memset(out, 0, sizeof(*out));
+
+    wtree3_db_t *db = tree->db;
+    MDB_envinfo info;
+    MDB_stat st;
+    int rc = mdb_env_info(db->env, &info);
+    if (rc == 0) rc = mdb_env_stat(db->env, &st);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+    if (WTREE_UNLIKELY(!info.me_mapaddr)) return WTREE3_OK;  /* Not mapped yet */
+
+    warmup_ctx_t w = {
+        .map = (const unsigned char *)info.me_mapaddr,
+        .psize = st.ms_psize,
+        .last_pgno = info.me_last_pgno,
+        .flags = flags,
+        .budget = budget_bytes ? budget_bytes / st.ms_psize : UINT64_MAX,
+    };
+
+    wtree3_txn_t *txn = read_pool_acquire(db, error);
+    if (WTREE_UNLIKELY(!txn)) return WTREE3_ERROR;
+
+    MDB_dbi main_dbi;
+    rc = mdb_dbi_open(txn->txn, NULL, 0, &main_dbi);
+    if (WTREE_UNLIKELY(rc != 0)) {
+        read_pool_release(txn);
+        return translate_mdb_error(rc, error);
+    }
+
+    /* Branch levels of every tree first (they serve every lookup), then leaves */
+    bool ok = warmup_collect(&w, txn->txn, main_dbi, tree->name);
+    if (flags & WTREE3_WARMUP_INDEXES) {
+        index_pin_t pin;
+        const index_set_t *set = index_set_pin(tree, &pin);
+        for (size_t i = 0; i < set->count && ok; i++) {
+            ok = warmup_collect(&w, txn->txn, main_dbi, set->items[i]->tree_name);
+        }
+        index_set_unpin(&pin);
+    }
+
+    if (ok && !(flags & WTREE3_WARMUP_BRANCHES_ONLY)) {
+        advise_pages(&w, w.leaf_roots.pages, w.leaf_roots.count, false, &w.stats.leaf_pages);
+
+        pgno_list_t leaves = {0};
+        for (size_t i = 0; i < w.bottom.count && ok && w.budget > 0; i++) {
+            const unsigned char *page;
+            size_t keys = branch_keys(&w, w.bottom.pages[i], &page);
+            leaves.count = 0;
+            for (size_t k = 0; k < keys && ok; k++) {
+                size_t child = branch_child(&w, page, k);
+                if (child != LMDB_P_INVALID) ok = pgno_push(&leaves, child);
+            }
+            advise_pages(&w, leaves.pages, leaves.count, false, &w.stats.leaf_pages);
+        }
+        free(leaves.pages);
+    }
+
+    read_pool_release(txn);
+    free(w.bottom.pages);
+    free(w.leaf_roots.pages);
+    if (out) *out = w.stats;
+
+    if (WTREE_UNLIKELY(!ok)) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate warmup page list");
+        return WTREE3_ENOMEM;
+    }
+    if (WTREE_UNLIKELY(w.rc != 0)) {
+        set_error(error, WTREE3_LIB, WTREE3_ERROR,
+                 "Locking branch pages failed (error %d, may need CAP_IPC_LOCK)", w.rc);
+        return WTREE3_ERROR;
+    }
+    return WTREE3_OK;
+}
+
+/* ============================================================
+ * Residency Probes
+ *
+ * The page walk of a point lookup, minus the faults: starting at the
+ * named DB's root (from the same MDB_db record warmup reads), every page
+ * is checked with mincore before it is read. A lookup whose whole path -
+ * and overflow pages, for a large value - is resident cannot block on
+ * disk. The first page that is not resident ends the walk and can be
+ * advised with MADV_WILLNEED, so a caller probing several keys starts
+ * their reads in parallel. Dup subtrees (DUPSORT keys with many values)
+ * are not followed.
+ * ============================================================ */
+
+#define LMDB_P_LEAF     0x02        /* mp_flags: leaf page */
+#define LMDB_F_BIGDATA  0x01        /* mn_flags: value on overflow pages */
+#define LMDB_F_SUBDATA  0x02        /* mn_flags: value is a sub-DB */
+#define LMDB_NODESZ     8           /* mn_lo, mn_hi, mn_flags, mn_ksize */
+#define PROBE_VEC       64          /* OS pages checked per mincore call */
+
+#if WTREE_OS_POSIX
+/* Every OS page of [addr, addr+len) in memory? */
+static bool range_resident(const void *addr, size_t len) {
+    size_t os_page = (size_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)addr & ~(uintptr_t)(os_page - 1);
+    size_t pages = ((uintptr_t)addr + len - start + os_page - 1) / os_page;
+
+    unsigned char vec[PROBE_VEC];
+    while (pages > 0) {
+        size_t n = pages < PROBE_VEC ? pages : PROBE_VEC;
+        if (mincore((void *)start, n * os_page, (void *)vec) != 0) return false;
+        for (size_t i = 0; i < n; i++) {
+            if (!(vec[i] & 1)) return false;
+        }
+        start += n * os_page;
+        pages -= n;
+    }
+    return true;
+}
+
+/* Key of node i (false if it does not fit the page) */
+static bool node_key(const warmup_ctx_t *w, const unsigned char *page, size_t i,
+                     MDB_val *key, const unsigned char **node_out) {
+    uint16_t off = load_u16(page + LMDB_PAGEHDRSZ + 2 * i);
+    if (off + (size_t)LMDB_NODESZ > w->psize) return false;
+    const unsigned char *node = page + off;
+    size_t ksize = load_u16(node + 6);
+    if (off + LMDB_NODESZ + ksize > w->psize) return false;
+
+    key->mv_data = (void *)(node + LMDB_NODESZ);
+    key->mv_size = ksize;
+    if (node_out) *node_out = node;
+    return true;
+}
+
+/* Leaf page header check; returns the node count or 0 if pgno is not a leaf */
+static size_t leaf_nodes(const warmup_ctx_t *w, size_t pgno, const unsigned char **out) {
+    if (pgno > w->last_pgno) return 0;
+    const unsigned char *page = w->map + pgno * w->psize;
+
+    size_t stored;
+    memcpy(&stored, page, sizeof(size_t));
+    uint16_t flags = load_u16(page + sizeof(size_t) + 2);
+    uint16_t lower = load_u16(page + sizeof(size_t) + 4);
+    uint16_t upper = load_u16(page + sizeof(size_t) + 6);
+    if (stored != pgno || (flags & (LMDB_P_LEAF | LMDB_P_BRANCH)) != LMDB_P_LEAF ||
+        lower < LMDB_PAGEHDRSZ || lower > upper || upper > w->psize) {
+        return 0;
+    }
+    *out = page;
+    return (lower - LMDB_PAGEHDRSZ) >> 1;
+}
+
+/* Overflow run of a F_BIGDATA node; false if it does not parse or is not resident */
+static int probe_overflow(const warmup_ctx_t *w, const unsigned char *node, bool advise) {
+    size_t ksize = load_u16(node + 6);
+    size_t pgno;
+    memcpy(&pgno, node + LMDB_NODESZ + ksize, sizeof(size_t));
+    if (pgno > w->last_pgno) return MEMOPT_PROBE_UNKNOWN;
+
+    const unsigned char *first = w->map + pgno * w->psize;
+    if (!range_resident(first, w->psize)) {
+        if (advise) memopt_willneed(first, w->psize, w->psize);
+        return MEMOPT_PROBE_MISSING;
+    }
+
+    uint32_t pages;
+    memcpy(&pages, first + sizeof(size_t) + 4, sizeof(pages));
+    if (pages == 0 || pgno + pages - 1 > w->last_pgno) return MEMOPT_PROBE_UNKNOWN;
+    if (!range_resident(first, (size_t)pages * w->psize)) {
+        if (advise) memopt_willneed(first, (size_t)pages * w->psize, w->psize);
+        return MEMOPT_PROBE_MISSING;
+    }
+    return MEMOPT_PROBE_RESIDENT;
+}
+#endif
+
+WTREE_HOT
+int memopt_probe_key(MDB_txn *txn, MDB_dbi dbi, const char *name, const MDB_val *key,
+                     bool advise) {
+#if WTREE_OS_POSIX
+    MDB_env *env = mdb_txn_env(txn);
+    MDB_envinfo info;
+    MDB_stat st;
+    MDB_dbi main_dbi;
+    if (mdb_env_info(env, &info) != 0 || mdb_env_stat(env, &st) != 0 ||
+        !info.me_mapaddr || mdb_dbi_open(txn, NULL, 0, &main_dbi) != 0) {
+        return MEMOPT_PROBE_UNKNOWN;
+    }
+
+    MDB_val rkey = {.mv_size = strlen(name), .mv_data = (void *)name};
+    MDB_val rval;
+    lmdb_db_record_t rec;
+    if (mdb_get(txn, main_dbi, &rkey, &rval) != 0 || rval.mv_size != sizeof(rec)) {
+        return MEMOPT_PROBE_UNKNOWN;
+    }
+    memcpy(&rec, rval.mv_data, sizeof(rec));
+    if (rec.md_root == LMDB_P_INVALID || rec.md_depth == 0) return MEMOPT_PROBE_RESIDENT;
+
+    warmup_ctx_t w = {
+        .map = (const unsigned char *)info.me_mapaddr,
+        .psize = st.ms_psize,
+        .last_pgno = info.me_last_pgno,
+    };
+
+    size_t pgno = rec.md_root;
+    for (unsigned int level = 1; ; level++) {
+        if (pgno > w.last_pgno) return MEMOPT_PROBE_UNKNOWN;
+        const unsigned char *addr = w.map + pgno * w.psize;
+        if (!range_resident(addr, w.psize)) {
+            if (advise) memopt_willneed(addr, w.psize, w.psize);
+            return MEMOPT_PROBE_MISSING;
+        }
+
+        const unsigned char *page;
+        MDB_val nkey;
+        if (level < rec.md_depth) {
+            /* Last node whose key is <= key (node 0's key is implicit) */
+            size_t keys = branch_keys(&w, pgno, &page);
+            if (keys == 0) return MEMOPT_PROBE_UNKNOWN;
+            size_t lo = 1, hi = keys;
+            while (lo < hi) {
+                size_t mid = lo + (hi - lo) / 2;
+                if (!node_key(&w, page, mid, &nkey, NULL)) return MEMOPT_PROBE_UNKNOWN;
+                if (mdb_cmp(txn, dbi, key, &nkey) < 0) hi = mid;
+                else lo = mid + 1;
+            }
+            pgno = branch_child(&w, page, lo - 1);
+            if (pgno == LMDB_P_INVALID) return MEMOPT_PROBE_UNKNOWN;
+            continue;
+        }
+
+        size_t nodes = leaf_nodes(&w, pgno, &page);
+        if (nodes == 0) return MEMOPT_PROBE_UNKNOWN;
+        size_t lo = 0, hi = nodes;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            const unsigned char *node;
+            if (!node_key(&w, page, mid, &nkey, &node)) return MEMOPT_PROBE_UNKNOWN;
+            int c = mdb_cmp(txn, dbi, key, &nkey);
+            if (c < 0) {
+                hi = mid;
+            } else if (c > 0) {
+                lo = mid + 1;
+            } else {
+                uint16_t nflags = load_u16(node + 4);
+                if (nflags & LMDB_F_SUBDATA) return MEMOPT_PROBE_UNKNOWN;
+                if (nflags & LMDB_F_BIGDATA) return probe_overflow(&w, node, advise);
+                return MEMOPT_PROBE_RESIDENT;
+            }
+        }
+        return MEMOPT_PROBE_RESIDENT;      /* Absent: the leaf was all a miss reads */
+    }
+#else
+    (void)txn;
+    (void)dbi;
+    (void)name;
+    (void)key;
+    (void)advise;
+    return MEMOPT_PROBE_UNKNOWN;
+#endif
+}
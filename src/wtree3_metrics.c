@@ -0,0 +1,285 @@
+/*
+ * wtree3_metrics.c - Operation Counters and Latency Histograms
+ *
+ * Each database with metrics enabled owns METRICS_SHARDS shards of
+ * log-linear histograms (4 buckets per power of two, HdrHistogram-style).
+ * A thread picks its shard once, round-robin, which keeps up to
+ * METRICS_SHARDS threads off each other's counters; beyond that shards
+ * are shared and updates stay correct through relaxed atomic adds.
+ * Snapshots sum the shards without stopping writers.
+ *
+ * Commit sizes are accumulated per thread: LMDB binds a write txn to its
+ * thread, so the bytes recorded by this thread since its last commit or
+ * abort belong to the txn being committed.
+ *
+ * This module provides:
+ * - wtree3_db_enable_metrics, wtree3_db_metrics, wtree3_db_metrics_reset
+ * - wtree3_tree_metrics
+ * - metrics_record, metrics_txn_end, metrics_note_error (internal hooks)
+ */
+
+#include "wtree3_internal.h"
+#include "macros.h"
+
+/* ============================================================
+ * Constants
+ * ============================================================ */
+
+#define METRICS_SHARDS      16
+#define METRICS_SUB_BITS    2                           /* 4 buckets per power of two */
+#define METRICS_SUB         (1u << METRICS_SUB_BITS)
+#define METRICS_MAX_EXP     47                          /* ~39 hours in ns */
+#define METRICS_BUCKETS     (METRICS_SUB * METRICS_MAX_EXP)
+
+/* ============================================================
+ * Internal Structures
+ * ============================================================ */
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t buckets[METRICS_BUCKETS];
+} metrics_hist_t;
+
+typedef struct {
+    metrics_hist_t ops[WTREE3_METRIC_COUNT];
+    metrics_hist_t commit_bytes;
+} metrics_shard_t;
+
+struct wtree3_metrics_state {
+    metrics_shard_t shards[METRICS_SHARDS];
+};
+
+uint32_t metrics_error_watchers = 0;
+static uint64_t metrics_errors[WTREE3_METRIC_ERR_COUNT];
+
+static uint32_t metrics_next_slot = 0;
+static WTREE_THREAD_LOCAL uint32_t metrics_slot;           /* Shard + 1, 0 = unassigned */
+static WTREE_THREAD_LOCAL uint64_t metrics_pending_bytes;  /* Written since last txn end */
+
+/* ============================================================
+ * Histogram
+ * ============================================================ */
+
+static unsigned int highest_bit(uint64_t v) {
+#if WTREE_GCC_LIKE
+    return 63u - (unsigned int)__builtin_clzll(v);
+#else
+    unsigned int b = 0;
+    while (v >>= 1) b++;
+    return b;
+#endif
+}
+
+/* Values below METRICS_SUB get exact buckets; above, 4 per power of two */
+static size_t bucket_of(uint64_t v) {
+    if (v < METRICS_SUB) return (size_t)v;
+    unsigned int e = highest_bit(v);
+    if (e >= METRICS_MAX_EXP + METRICS_SUB_BITS - 1) return METRICS_BUCKETS - 1;
+    size_t sub = (size_t)(v >> (e - METRICS_SUB_BITS)) & (METRICS_SUB - 1);
+    return (size_t)(e - METRICS_SUB_BITS + 1) * METRICS_SUB + sub;
+}
+
+/* Largest value that falls into bucket b */
+static uint64_t bucket_upper(size_t b) {
+    if (b < METRICS_SUB) return b;
+    unsigned int e = (unsigned int)(b / METRICS_SUB) + METRICS_SUB_BITS - 1;
+    uint64_t sub = b % METRICS_SUB;
+    uint64_t lower = (METRICS_SUB + sub) << (e - METRICS_SUB_BITS);
+    return lower + ((uint64_t)1 << (e - METRICS_SUB_BITS)) - 1;
+}
+
+static void hist_add(metrics_hist_t *h, uint64_t v) {
+    watomic_add_u64(&h->count, 1);
+    watomic_add_u64(&h->sum, v);
+    watomic_max_u64(&h->max, v);
+    watomic_add_u64(&h->buckets[bucket_of(v)], 1);
+}
+
+/* Sum a histogram across shards and summarize it */
+static void hist_summarize(const wtree3_metrics_state_t *st, int op, wtree3_histogram_t *out) {
+    static const double quantiles[3] = {0.50, 0.99, 0.999};
+    uint64_t *targets[3] = {&out->p50, &out->p99, &out->p999};
+    uint64_t buckets[METRICS_BUCKETS] = {0};
+
+    memset(out, 0, sizeof(*out));
+    for (size_t s = 0; s < METRICS_SHARDS; s++) {
+        const metrics_hist_t *h = op < WTREE3_METRIC_COUNT ? &st->shards[s].ops[op]
+                                                           : &st->shards[s].commit_bytes;
+        out->sum += watomic_load_u64(&h->sum);
+        uint64_t max = watomic_load_u64(&h->max);
+        if (max > out->max) out->max = max;
+        for (size_t b = 0; b < METRICS_BUCKETS; b++) {
+            buckets[b] += watomic_load_u64(&h->buckets[b]);
+        }
+    }
+
+    /* Count from the buckets so percentiles agree with it */
+    for (size_t b = 0; b < METRICS_BUCKETS; b++) out->count += buckets[b];
+    if (out->count == 0) return;
+
+    uint64_t seen = 0;
+    size_t q = 0;
+    for (size_t b = 0; b < METRICS_BUCKETS && q < 3; b++) {
+        seen += buckets[b];
+        while (q < 3 && (double)seen >= quantiles[q] * (double)out->count) {
+            uint64_t upper = bucket_upper(b);
+            *targets[q++] = upper < out->max ? upper : out->max;
+        }
+    }
+}
+
+static metrics_shard_t *current_shard(wtree3_metrics_state_t *st) {
+    if (WTREE_UNLIKELY(metrics_slot == 0)) {
+        metrics_slot = watomic_add_u32(&metrics_next_slot, 1) % METRICS_SHARDS + 1;
+    }
+    return &st->shards[metrics_slot - 1];
+}
+
+/* ============================================================
+ * Internal Hooks
+ * ============================================================ */
+
+WTREE_COLD
+void metrics_record(wtree3_db_t *db, uint64_t *counters, int op,
+                    uint64_t t0, size_t bytes) {
+    wtree3_metrics_state_t *st = db->metrics;
+    if (WTREE_UNLIKELY(!st)) return;
+
+    uint64_t now = wtime_now_ns();
+    hist_add(&current_shard(st)->ops[op], now > t0 ? now - t0 : 0);
+    if (counters) watomic_add_u64(&counters[op], 1);
+    metrics_pending_bytes += bytes;
+}
+
+WTREE_COLD
+void metrics_txn_end(wtree3_db_t *db, uint64_t t0, bool committed) {
+    uint64_t bytes = metrics_pending_bytes;
+    metrics_pending_bytes = 0;
+
+    wtree3_metrics_state_t *st = db->metrics;
+    if (!committed || !t0 || WTREE_UNLIKELY(!st)) return;
+
+    uint64_t now = wtime_now_ns();
+    metrics_shard_t *shard = current_shard(st);
+    hist_add(&shard->ops[WTREE3_METRIC_COMMIT], now > t0 ? now - t0 : 0);
+    hist_add(&shard->commit_bytes, bytes);
+}
+
+WTREE_COLD
+void metrics_note_error(int code) {
+    int kind;
+    switch (code) {
+        case WTREE3_NOT_FOUND:  kind = WTREE3_METRIC_ERR_NOT_FOUND; break;
+        case WTREE3_KEY_EXISTS: kind = WTREE3_METRIC_ERR_KEY_EXISTS; break;
+        case WTREE3_MAP_FULL:   kind = WTREE3_METRIC_ERR_MAP_FULL; break;
+        case WTREE3_TXN_FULL:   kind = WTREE3_METRIC_ERR_TXN_FULL; break;
+        default:                kind = WTREE3_METRIC_ERR_OTHER; break;
+    }
+    watomic_add_u64(&metrics_errors[kind], 1);
+}
+
+WTREE_COLD
+void metrics_destroy(wtree3_db_t *db) {
+    if (watomic_load_u32(&db->metrics_on)) (void)watomic_add_u32(&metrics_error_watchers, -1);
+    db->metrics_on = 0;
+    free(db->metrics);
+    db->metrics = NULL;
+}
+
+/* ============================================================
+ * Public API
+ * ============================================================ */
+
+WTREE_COLD WTREE_WARN_UNUSED
+int wtree3_db_enable_metrics(wtree3_db_t *db, bool enable, gerror_t *error) {
+    if (WTREE_UNLIKELY(!db)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Database cannot be NULL");
+        return WTREE3_EINVAL;
+    }
+
+#ifdef WTREE3_NO_METRICS
+    if (enable) {
+        set_error(error, WTREE3_LIB, WTREE3_ERROR, "Metrics support was compiled out");
+        return WTREE3_ERROR;
+    }
+    return WTREE3_OK;
+#else
+    bool on = watomic_load_u32(&db->metrics_on) != 0;
+    if (enable == on) return WTREE3_OK;
+
+    if (enable && !db->metrics) {
+        db->metrics = calloc(1, sizeof(wtree3_metrics_state_t));
+        if (WTREE_UNLIKELY(!db->metrics)) {
+            set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate metrics");
+            return WTREE3_ENOMEM;
+        }
+    }
+
+    watomic_store_u32(&db->metrics_on, enable ? 1 : 0);
+    (void)watomic_add_u32(&metrics_error_watchers, enable ? 1 : -1);
+    return WTREE3_OK;
+#endif
+}
+
+WTREE_COLD WTREE_WARN_UNUSED
+int wtree3_db_metrics(wtree3_db_t *db, wtree3_metrics_t *out, gerror_t *error) {
+    if (WTREE_UNLIKELY(!db || !out)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+
+    memset(out, 0, sizeof(*out));
+    if (!db->metrics) return WTREE3_OK;
+
+    for (int op = 0; op < WTREE3_METRIC_COUNT; op++) {
+        hist_summarize(db->metrics, op, &out->ops[op]);
+    }
+    hist_summarize(db->metrics, WTREE3_METRIC_COUNT, &out->commit_bytes);
+    for (int k = 0; k < WTREE3_METRIC_ERR_COUNT; k++) {
+        out->errors[k] = watomic_load_u64(&metrics_errors[k]);
+    }
+    return WTREE3_OK;
+}
+
+WTREE_COLD
+void wtree3_db_metrics_reset(wtree3_db_t *db) {
+    if (!db || !db->metrics) return;
+
+    /* Concurrent recorders may land a few updates mid-reset; that is fine */
+    uint64_t *words = (uint64_t *)db->metrics;
+    size_t count = sizeof(wtree3_metrics_state_t) / sizeof(uint64_t);
+    for (size_t i = 0; i < count; i++) watomic_store_u64(&words[i], 0);
+    for (int k = 0; k < WTREE3_METRIC_ERR_COUNT; k++) {
+        watomic_store_u64(&metrics_errors[k], 0);
+    }
+}
+
+WTREE_WARN_UNUSED
+int wtree3_tree_metrics(wtree3_tree_t *tree, const char *index_name,
+                        wtree3_counters_t *out, gerror_t *error) {
+    if (WTREE_UNLIKELY(!tree || !out)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+
+    /* Pinned while the counters are read: they go away with the index */
+    index_pin_t pin;
+    const uint64_t *counters = tree->metric_ops;
+    if (index_name) {
+        wtree3_index_t *idx = index_set_find(index_set_pin(tree, &pin), index_name);
+        if (!idx) {
+            index_set_unpin(&pin);
+            set_error(error, WTREE3_LIB, WTREE3_NOT_FOUND, "Index '%s' not found", index_name);
+            return WTREE3_NOT_FOUND;
+        }
+        counters = idx->metric_ops;
+    }
+
+    for (int op = 0; op < WTREE3_METRIC_COUNT; op++) {
+        out->ops[op] = watomic_load_u64(&counters[op]);
+    }
+    if (index_name) index_set_unpin(&pin);
+    return WTREE3_OK;
+}
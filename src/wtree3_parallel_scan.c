@@ -0,0 +1,338 @@
+/*
+ * wtree3_parallel_scan.c - Parallel Partitioned Range Scan
+ *
+ * Splits [start_key, end_key] into disjoint sub-ranges - at the analyzed
+ * histogram (stats_split_keys) when the tree has statistics, otherwise
+ * with partition_split_keys() - and scans each one on its own thread under its
+ * own read transaction. Every worker accumulates into a private partial
+ * state; the partials are merged on the calling thread through the
+ * user's reduce callback, in key order.
+ *
+ * Consistent snapshot: separate read txns only see the same snapshot if
+ * no writer commits while they are being started. The coordinator holds
+ * a write txn (the writer lock) just long enough for every worker to
+ * begin its read txn, then aborts it - writers are blocked only for the
+ * thread start-up, not the scan. On a read-only environment there are no
+ * writers in this process and a plain read txn is used instead.
+ *
+ * This module provides:
+ * - wtree3_scan_parallel
+ */
+
+#include "wtree3_internal.h"
+#include "macros.h"
+
+/* ============================================================
+ * Constants
+ * ============================================================ */
+
+#define PSCAN_MAX_THREADS           64
+#define PSCAN_MIN_ROWS_PER_WORKER   1024
+
+/* ============================================================
+ * Internal Structures
+ * ============================================================ */
+
+/* Start-up barrier shared by all workers */
+typedef struct {
+    wmutex_t lock;
+    wcond_t cond;
+    size_t ready;                   /* Workers that have begun their read txn */
+} pscan_barrier_t;
+
+typedef struct {
+    wtree3_tree_t *tree;
+    MDB_txn *txn;                   /* Worker read txn (or the shared inline txn) */
+    const MDB_val *lo;              /* Inclusive lower bound (NULL = first key) */
+    const MDB_val *hi;              /* Upper bound (NULL = last key) */
+    bool hi_inclusive;              /* Last partition includes end_key itself */
+    wtree3_scan_fn scan_fn;
+    void *partial;                  /* Worker state passed to scan_fn */
+    pscan_barrier_t *barrier;
+    int rc;
+    gerror_t error;
+} pscan_worker_t;
+
+/* ============================================================
+ * Workers
+ * ============================================================ */
+
+static int worker_scan(pscan_worker_t *w) {
+    MDB_dbi dbi = w->tree->dbi;
+
+    MDB_cursor *cursor;
+    int rc = mdb_cursor_open(w->txn, dbi, &cursor);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, &w->error);
+
+    MDB_val key, val;
+    codec_buf_t buf = {0};
+    if (w->lo) {
+        key = *w->lo;
+        rc = mdb_cursor_get(cursor, &key, &val, MDB_SET_RANGE);
+    } else {
+        rc = mdb_cursor_get(cursor, &key, &val, MDB_FIRST);
+    }
+
+    while (rc == 0) {
+        if (w->hi) {
+            int c = mdb_cmp(w->txn, dbi, &key, w->hi);
+            if (c > 0 || (c == 0 && !w->hi_inclusive)) break;
+        }
+        rc = tree_value_decode(w->tree, &val, &buf);
+        if (WTREE_UNLIKELY(rc != 0)) break;
+
+        if (!w->scan_fn(key.mv_data, key.mv_size, val.mv_data, val.mv_size, w->partial)) {
+            break;
+        }
+
+        rc = mdb_cursor_get(cursor, &key, &val, MDB_NEXT);
+    }
+    mdb_cursor_close(cursor);
+    codec_buf_release(&buf);
+
+    if (WTREE_UNLIKELY(rc != 0 && rc != MDB_NOTFOUND)) {
+        return translate_mdb_error(rc, &w->error);
+    }
+    return WTREE3_OK;
+}
+
+static void *worker_thread(void *arg) {
+    pscan_worker_t *w = (pscan_worker_t *)arg;
+
+    int rc = mdb_txn_begin(w->tree->db->env, NULL, MDB_RDONLY, &w->txn);
+    if (WTREE_UNLIKELY(rc != 0)) {
+        w->txn = NULL;
+        w->rc = translate_mdb_error(rc, &w->error);
+    }
+
+    wmutex_lock(&w->barrier->lock);
+    w->barrier->ready++;
+    wcond_signal(&w->barrier->cond);
+    wmutex_unlock(&w->barrier->lock);
+
+    if (!w->txn) return NULL;
+
+    w->rc = worker_scan(w);
+    mdb_txn_abort(w->txn);
+    w->txn = NULL;
+    return NULL;
+}
+
+/* ============================================================
+ * Coordinator
+ * ============================================================ */
+
+/*
+ * Start the workers, wait until each has its snapshot, then release the
+ * writer lock. Partitions whose thread could not start run inline on a
+ * read txn begun before the lock is released.
+ */
+static int run_workers(wtree3_db_t *db, MDB_txn *barrier_txn, bool barrier_is_write,
+                       pscan_worker_t *workers, size_t count, gerror_t *error) {
+    pscan_barrier_t barrier = {.ready = 0};
+    if (WTREE_UNLIKELY(wmutex_init(&barrier.lock) != 0)) {
+        mdb_txn_abort(barrier_txn);
+        set_error(error, WTREE3_LIB, WTREE3_ERROR, "Failed to initialize scan barrier");
+        return WTREE3_ERROR;
+    }
+    if (WTREE_UNLIKELY(wcond_init(&barrier.cond) != 0)) {
+        wmutex_destroy(&barrier.lock);
+        mdb_txn_abort(barrier_txn);
+        set_error(error, WTREE3_LIB, WTREE3_ERROR, "Failed to initialize scan barrier");
+        return WTREE3_ERROR;
+    }
+
+    wthread_t *threads = malloc(count * sizeof(wthread_t));
+    bool *started = calloc(count, sizeof(bool));
+    if (WTREE_UNLIKELY(!threads || !started)) {
+        free(threads);
+        free(started);
+        wcond_destroy(&barrier.cond);
+        wmutex_destroy(&barrier.lock);
+        mdb_txn_abort(barrier_txn);
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate scan threads");
+        return WTREE3_ENOMEM;
+    }
+
+    size_t started_count = 0;
+    bool need_inline = false;
+    for (size_t i = 0; i < count; i++) {
+        workers[i].barrier = &barrier;
+        started[i] = wthread_create(&threads[i], worker_thread, &workers[i]) == 0;
+        if (started[i]) {
+            started_count++;
+        } else {
+            need_inline = true;
+        }
+    }
+
+    wmutex_lock(&barrier.lock);
+    while (barrier.ready < started_count) {
+        wcond_wait(&barrier.cond, &barrier.lock);
+    }
+    wmutex_unlock(&barrier.lock);
+
+    /* Every started worker has its snapshot now */
+    int rc = WTREE3_OK;
+    MDB_txn *inline_txn = NULL;
+    if (need_inline) {
+        if (barrier_is_write) {
+            rc = mdb_txn_begin(db->env, NULL, MDB_RDONLY, &inline_txn);
+            if (WTREE_UNLIKELY(rc != 0)) {
+                inline_txn = NULL;
+                rc = translate_mdb_error(rc, error);
+            }
+        } else {
+            inline_txn = barrier_txn;
+            barrier_txn = NULL;
+        }
+    }
+    if (barrier_txn) mdb_txn_abort(barrier_txn);
+
+    for (size_t i = 0; i < count; i++) {
+        if (started[i]) continue;
+        if (inline_txn) {
+            workers[i].txn = inline_txn;
+            workers[i].rc = worker_scan(&workers[i]);
+            workers[i].txn = NULL;
+        } else {
+            workers[i].rc = rc;
+        }
+    }
+    if (inline_txn) mdb_txn_abort(inline_txn);
+
+    for (size_t i = 0; i < count; i++) {
+        if (started[i]) wthread_join(threads[i], NULL);
+    }
+    free(threads);
+    free(started);
+    wcond_destroy(&barrier.cond);
+    wmutex_destroy(&barrier.lock);
+
+    if (rc != 0) return rc;
+    for (size_t i = 0; i < count; i++) {
+        if (workers[i].rc != 0) {
+            error_copy(error, &workers[i].error);
+            return workers[i].rc;
+        }
+    }
+    return WTREE3_OK;
+}
+
+/* ============================================================
+ * Entry Point
+ * ============================================================ */
+
+WTREE_WARN_UNUSED
+int wtree3_scan_parallel(wtree3_tree_t *tree,
+                         const void *start_key, size_t start_len,
+                         const void *end_key, size_t end_len,
+                         const wtree3_parallel_scan_opts_t *opts,
+                         wtree3_scan_fn scan_fn,
+                         wtree3_reduce_fn reduce_fn,
+                         void *user_data,
+                         gerror_t *error) {
+    if (WTREE_UNLIKELY(!tree || !scan_fn)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+
+    size_t threads = opts && opts->threads ? opts->threads : wthread_cpu_count();
+    if (threads == 0) threads = 1;
+    if (threads > PSCAN_MAX_THREADS) threads = PSCAN_MAX_THREADS;
+    size_t partial_size = opts ? opts->partial_size : 0;
+
+    wtree3_db_t *db = tree->db;
+    bool barrier_is_write = !(db->flags & MDB_RDONLY);
+
+    /* Pins the snapshot: no commit can land while workers start */
+    MDB_txn *txn;
+    int rc = mdb_txn_begin(db->env, NULL, barrier_is_write ? 0 : MDB_RDONLY, &txn);
+    if (rc != 0) return translate_mdb_error(rc, error);
+
+    MDB_val start = {.mv_size = start_len, .mv_data = (void *)start_key};
+    MDB_val end = {.mv_size = end_len, .mv_data = (void *)end_key};
+    MDB_val *splits = NULL;
+    size_t split_count = 0;
+
+    if (threads > 1) {
+        MDB_stat st;
+        rc = mdb_stat(txn, tree->dbi, &st);
+        if (WTREE_UNLIKELY(rc != 0)) {
+            mdb_txn_abort(txn);
+            return translate_mdb_error(rc, error);
+        }
+        size_t useful = st.ms_entries / PSCAN_MIN_ROWS_PER_WORKER;
+        if (useful < threads) threads = useful ? useful : 1;
+    }
+    if (threads > 1) {
+        /* Equi-depth splits when analyzed, key-space bisection otherwise */
+        rc = stats_split_keys(txn, tree,
+                              start_key ? &start : NULL, end_key ? &end : NULL,
+                              threads, &splits, &split_count, NULL);
+        if (rc != 0 || split_count == 0) {
+            partition_free_splits(splits, split_count);
+            rc = partition_split_keys(txn, tree->dbi,
+                                      start_key ? &start : NULL, end_key ? &end : NULL,
+                                      threads, &splits, &split_count, error);
+        }
+        if (WTREE_UNLIKELY(rc != 0)) {
+            mdb_txn_abort(txn);
+            return rc;
+        }
+    }
+
+    size_t count = split_count + 1;
+    pscan_worker_t *workers = calloc(count, sizeof(pscan_worker_t));
+    unsigned char *partials = NULL;
+    if (partial_size > 0) partials = calloc(count, partial_size);
+    if (WTREE_UNLIKELY(!workers || (partial_size > 0 && !partials))) {
+        free(workers);
+        free(partials);
+        partition_free_splits(splits, split_count);
+        mdb_txn_abort(txn);
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate scan workers");
+        return WTREE3_ENOMEM;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        pscan_worker_t *w = &workers[i];
+        w->tree = tree;
+        w->lo = i == 0 ? (start_key ? &start : NULL) : &splits[i - 1];
+        w->hi = i < split_count ? &splits[i] : (end_key ? &end : NULL);
+        w->hi_inclusive = (i == split_count);
+        w->scan_fn = scan_fn;
+        w->partial = partials ? partials + i * partial_size : user_data;
+    }
+
+    if (count == 1) {
+        /* Nothing to split - scan on the calling thread without the writer lock */
+        if (barrier_is_write) {
+            mdb_txn_abort(txn);
+            rc = mdb_txn_begin(db->env, NULL, MDB_RDONLY, &txn);
+            if (WTREE_UNLIKELY(rc != 0)) {
+                rc = translate_mdb_error(rc, error);
+                txn = NULL;
+            }
+        }
+        if (txn) {
+            workers[0].txn = txn;
+            rc = worker_scan(&workers[0]);
+            if (rc != 0) error_copy(error, &workers[0].error);
+            mdb_txn_abort(txn);
+        }
+    } else {
+        rc = run_workers(db, txn, barrier_is_write, workers, count, error);
+    }
+
+    if (rc == 0 && reduce_fn && partials) {
+        for (size_t i = 0; i < count; i++) {
+            reduce_fn(workers[i].partial, user_data);
+        }
+    }
+
+    free(partials);
+    free(workers);
+    partition_free_splits(splits, split_count);
+    return rc;
+}
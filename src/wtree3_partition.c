@@ -0,0 +1,237 @@
+/*
+ * wtree3_partition.c - Key-Range Partitioning
+ *
+ * Splits the key range of a tree into roughly equal parts so independent
+ * workers can each walk a disjoint slice. Splits are found by bisecting
+ * the key space: the bytes following the common prefix of the first and
+ * last key are treated as a big-endian number, evenly spaced candidates
+ * are generated between them, and each candidate is snapped to a real key
+ * with MDB_SET_RANGE. No full scan is needed.
+ *
+ * This module provides:
+ * - partition_split_keys: compute split keys for [start, end]
+ * - partition_free_splits: release the split key array
+ * - partition_key_at: snap a random point of a key range to a real key
+ */
+
+#include "wtree3_internal.h"
+#include "macros.h"
+
+/* ============================================================
+ * Helpers
+ * ============================================================ */
+
+/* Load up to 8 bytes starting at data[off] as a big-endian number */
+static uint64_t load_be64(const MDB_val *v, size_t off) {
+    uint64_t x = 0;
+    const unsigned char *p = (const unsigned char *)v->mv_data;
+    for (size_t i = 0; i < 8; i++) {
+        x <<= 8;
+        if (off + i < v->mv_size) x |= p[off + i];
+    }
+    return x;
+}
+
+static void store_be64(unsigned char *p, uint64_t x) {
+    for (int i = 7; i >= 0; i--) {
+        p[i] = (unsigned char)(x & 0xFF);
+        x >>= 8;
+    }
+}
+
+static int copy_val(MDB_val *dst, const MDB_val *src) {
+    dst->mv_size = src->mv_size;
+    dst->mv_data = malloc(src->mv_size ? src->mv_size : 1);
+    if (WTREE_UNLIKELY(!dst->mv_data)) return WTREE3_ENOMEM;
+    memcpy(dst->mv_data, src->mv_data, src->mv_size);
+    return WTREE3_OK;
+}
+
+/* ============================================================
+ * Split Computation
+ * ============================================================ */
+
+WTREE_WARN_UNUSED
+int partition_split_keys(MDB_txn *txn, MDB_dbi dbi,
+                         const MDB_val *start, const MDB_val *end,
+                         size_t parts,
+                         MDB_val **out_splits, size_t *out_count,
+                         gerror_t *error) {
+    *out_splits = NULL;
+    *out_count = 0;
+    if (parts < 2) return WTREE3_OK;
+
+    MDB_cursor *cursor;
+    int rc = mdb_cursor_open(txn, dbi, &cursor);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+
+    MDB_val first, last, data;
+    MDB_val first_copy = {0, NULL};
+    MDB_val *splits = NULL;
+    size_t count = 0;
+
+    /* Resolve the first and last real keys of the range */
+    if (start) {
+        first = *start;
+        rc = mdb_cursor_get(cursor, &first, &data, MDB_SET_RANGE);
+    } else {
+        rc = mdb_cursor_get(cursor, &first, &data, MDB_FIRST);
+    }
+    if (rc == MDB_NOTFOUND) {
+        rc = WTREE3_OK;
+        goto cleanup;
+    }
+    if (WTREE_UNLIKELY(rc != 0)) {
+        rc = translate_mdb_error(rc, error);
+        goto cleanup;
+    }
+    if (WTREE_UNLIKELY(copy_val(&first_copy, &first) != 0)) {
+        rc = WTREE3_ENOMEM;
+        goto nomem;
+    }
+
+    if (end) {
+        last = *end;
+        rc = mdb_cursor_get(cursor, &last, &data, MDB_SET_RANGE);
+        if (rc == 0 && mdb_cmp(txn, dbi, &last, end) > 0) {
+            rc = mdb_cursor_get(cursor, &last, &data, MDB_PREV);
+        } else if (rc == MDB_NOTFOUND) {
+            rc = mdb_cursor_get(cursor, &last, &data, MDB_LAST);
+        }
+    } else {
+        rc = mdb_cursor_get(cursor, &last, &data, MDB_LAST);
+    }
+    if (rc == MDB_NOTFOUND) {
+        rc = WTREE3_OK;
+        goto cleanup;
+    }
+    if (WTREE_UNLIKELY(rc != 0)) {
+        rc = translate_mdb_error(rc, error);
+        goto cleanup;
+    }
+    if (mdb_cmp(txn, dbi, &first_copy, &last) >= 0) {
+        rc = WTREE3_OK;
+        goto cleanup;
+    }
+
+    /* Bisect the bytes after the common prefix */
+    size_t prefix = 0;
+    size_t min_len = first_copy.mv_size < last.mv_size ? first_copy.mv_size : last.mv_size;
+    while (prefix < min_len &&
+           ((unsigned char *)first_copy.mv_data)[prefix] == ((unsigned char *)last.mv_data)[prefix]) {
+        prefix++;
+    }
+
+    uint64_t lo = load_be64(&first_copy, prefix);
+    uint64_t hi = load_be64(&last, prefix);
+    if (hi <= lo) {
+        rc = WTREE3_OK;
+        goto cleanup;
+    }
+
+    unsigned char *cand = malloc(prefix + 8);
+    splits = malloc((parts - 1) * sizeof(MDB_val));
+    if (WTREE_UNLIKELY(!cand || !splits)) {
+        free(cand);
+        rc = WTREE3_ENOMEM;
+        goto nomem;
+    }
+    memcpy(cand, first_copy.mv_data, prefix);
+
+    uint64_t span = hi - lo;
+    for (size_t j = 1; j < parts; j++) {
+        /* lo + span * j / parts without overflowing */
+        uint64_t step = (span / parts) * j + ((span % parts) * j) / parts;
+        store_be64(cand + prefix, lo + step);
+
+        MDB_val key = {.mv_size = prefix + 8, .mv_data = cand};
+        rc = mdb_cursor_get(cursor, &key, &data, MDB_SET_RANGE);
+        if (rc == MDB_NOTFOUND) break;
+        if (WTREE_UNLIKELY(rc != 0)) {
+            free(cand);
+            rc = translate_mdb_error(rc, error);
+            goto cleanup;
+        }
+
+        /* Keep strictly increasing splits inside (first, last] */
+        const MDB_val *prev = count ? &splits[count - 1] : &first_copy;
+        if (mdb_cmp(txn, dbi, &key, prev) <= 0) continue;
+        if (mdb_cmp(txn, dbi, &key, &last) > 0) break;
+
+        if (WTREE_UNLIKELY(copy_val(&splits[count], &key) != 0)) {
+            free(cand);
+            rc = WTREE3_ENOMEM;
+            goto nomem;
+        }
+        count++;
+    }
+    free(cand);
+    rc = WTREE3_OK;
+
+cleanup:
+    mdb_cursor_close(cursor);
+    free(first_copy.mv_data);
+    if (rc == WTREE3_OK && count > 0) {
+        *out_splits = splits;
+        *out_count = count;
+    } else {
+        partition_free_splits(splits, count);
+    }
+    return rc;
+
+nomem:
+    set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate partition split keys");
+    goto cleanup;
+}
+
+void partition_free_splits(MDB_val *splits, size_t count) {
+    if (!splits) return;
+    for (size_t i = 0; i < count; i++) {
+        free(splits[i].mv_data);
+    }
+    free(splits);
+}
+
+/* ============================================================
+ * Point Lookup
+ * ============================================================ */
+
+#define PARTITION_PREFIX_MAX 512    /* Above any LMDB key size */
+
+WTREE_WARN_UNUSED
+int partition_key_at(MDB_cursor *cursor, const MDB_val *first, const MDB_val *last,
+                     uint64_t frac, MDB_val *key, MDB_val *data) {
+    MDB_txn *txn = mdb_cursor_txn(cursor);
+    MDB_dbi dbi = mdb_cursor_dbi(cursor);
+
+    size_t prefix = 0;
+    size_t min_len = first->mv_size < last->mv_size ? first->mv_size : last->mv_size;
+    if (min_len > PARTITION_PREFIX_MAX) min_len = PARTITION_PREFIX_MAX;
+    while (prefix < min_len &&
+           ((unsigned char *)first->mv_data)[prefix] == ((unsigned char *)last->mv_data)[prefix]) {
+        prefix++;
+    }
+
+    uint64_t lo = load_be64(first, prefix);
+    uint64_t hi = load_be64(last, prefix);
+    uint64_t point = lo;
+    if (hi > lo) {
+        /* lo + (hi - lo) * frac / 2^64; double precision is plenty for sampling */
+        double step = (double)(hi - lo) * ((double)frac / 18446744073709551616.0);
+        point = lo + (uint64_t)step;
+        if (point > hi || point < lo) point = hi;
+    }
+
+    unsigned char cand[PARTITION_PREFIX_MAX + 8];
+    memcpy(cand, first->mv_data, prefix);
+    store_be64(cand + prefix, point);
+
+    *key = (MDB_val){.mv_size = prefix + 8, .mv_data = cand};
+    int rc = mdb_cursor_get(cursor, key, data, MDB_SET_RANGE);
+    if (rc == 0 && mdb_cmp(txn, dbi, key, last) <= 0) return 0;
+    if (rc != 0 && rc != MDB_NOTFOUND) return rc;
+
+    /* Past the range: the zero padding of the last key can overshoot it */
+    *key = *last;
+    return mdb_cursor_get(cursor, key, data, MDB_SET_KEY);
+}
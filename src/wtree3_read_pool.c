@@ -0,0 +1,265 @@
+/*
+ * wtree3_read_pool.c - Read Transaction Pool
+ *
+ * The auto-transaction read APIs (get, exists, iterators, index seeks and
+ * with_read_txn) used to begin and abort a fresh read-only MDB_txn - plus
+ * a malloc'd wtree3_txn_t - on every call. The pool keeps idle read txns
+ * in the reset state (mdb_txn_reset) and hands them out again with
+ * mdb_txn_renew, which skips the allocation and the reader-table setup.
+ *
+ * A reset txn holds no snapshot, so idle pool entries never pin old pages.
+ * Without MDB_NOTLS a reset txn does not own a reader slot either and can
+ * be renewed from any thread; with MDB_NOTLS each idle entry keeps its
+ * slot, which is why the pool is bounded.
+ *
+ * Pooled txns also keep a few cursors open across reuse, keyed by DBI.
+ * Read-only cursors survive reset and are rebound with mdb_cursor_renew.
+ *
+ * This module provides:
+ * - Configuration: wtree3_db_set_read_pool_size
+ * - Internal entry points: read_pool_acquire, read_pool_release,
+ *   read_pool_cursor_open, read_pool_cursor_close, read_pool_drain
+ */
+
+#include "wtree3_internal.h"
+#include "macros.h"
+
+/* ============================================================
+ * Internal Structures
+ * ============================================================ */
+
+struct wtree3_read_pool {
+    wmutex_t lock;
+    size_t max;                     /* Idle txns kept (0 = pooling disabled) */
+    size_t count;                   /* Idle txns currently in the pool */
+    wtree3_txn_t **idle;            /* Stack of reset txns (capacity max) */
+};
+
+/* ============================================================
+ * Helpers
+ * ============================================================ */
+
+static void close_cached_cursors(wtree3_txn_t *txn) {
+    for (size_t i = 0; i < txn->cursor_count; i++) {
+        mdb_cursor_close(txn->cursors[i].cursor);
+    }
+    txn->cursor_count = 0;
+}
+
+/* Really end a pooled txn (mdb_txn_abort works on reset txns too) */
+static void discard_txn(wtree3_txn_t *txn) {
+    close_cached_cursors(txn);
+    mdb_txn_abort(txn->txn);
+    txn_decoded_free(txn);
+    free(txn);
+}
+
+/* Pop up to n idle txns into out[] (lock held by caller) */
+static size_t take_idle_locked(wtree3_read_pool_t *pool, wtree3_txn_t **out, size_t n) {
+    size_t taken = 0;
+    while (pool->count > 0 && taken < n) {
+        out[taken++] = pool->idle[--pool->count];
+    }
+    return taken;
+}
+
+/* ============================================================
+ * Lifecycle
+ * ============================================================ */
+
+WTREE_COLD
+wtree3_read_pool_t *read_pool_create(size_t max) {
+    wtree3_read_pool_t *pool = calloc(1, sizeof(wtree3_read_pool_t));
+    if (WTREE_UNLIKELY(!pool)) return NULL;
+
+    if (WTREE_UNLIKELY(wmutex_init(&pool->lock) != 0)) {
+        free(pool);
+        return NULL;
+    }
+
+    if (max > 0) {
+        pool->idle = calloc(max, sizeof(wtree3_txn_t *));
+        if (WTREE_UNLIKELY(!pool->idle)) {
+            wmutex_destroy(&pool->lock);
+            free(pool);
+            return NULL;
+        }
+    }
+    pool->max = max;
+    return pool;
+}
+
+WTREE_COLD
+void read_pool_drain(wtree3_read_pool_t *pool) {
+    if (!pool) return;
+
+    for (;;) {
+        wtree3_txn_t *batch[16];
+        wmutex_lock(&pool->lock);
+        size_t n = take_idle_locked(pool, batch, 16);
+        wmutex_unlock(&pool->lock);
+        if (n == 0) break;
+
+        for (size_t i = 0; i < n; i++) discard_txn(batch[i]);
+    }
+}
+
+WTREE_COLD
+void read_pool_destroy(wtree3_read_pool_t *pool) {
+    if (!pool) return;
+
+    read_pool_drain(pool);
+    wmutex_destroy(&pool->lock);
+    free(pool->idle);
+    free(pool);
+}
+
+/* ============================================================
+ * Transactions
+ * ============================================================ */
+
+WTREE_HOT WTREE_WARN_UNUSED
+wtree3_txn_t *read_pool_acquire(wtree3_db_t *db, gerror_t *error) {
+    wtree3_read_pool_t *pool = db->read_pool;
+    wtree3_txn_t *txn = NULL;
+
+    if (WTREE_LIKELY(pool != NULL)) {
+        wmutex_lock(&pool->lock);
+        if (pool->count > 0) txn = pool->idle[--pool->count];
+        wmutex_unlock(&pool->lock);
+    }
+
+    if (txn) {
+        int rc = mdb_txn_renew(txn->txn);
+        if (WTREE_LIKELY(rc == 0)) return txn;
+
+        /* The txn may be unusable now (e.g. MDB_BAD_RSLOT) - don't recycle it */
+        discard_txn(txn);
+        translate_mdb_error(rc, error);
+        return NULL;
+    }
+
+    txn = wtree3_txn_begin(db, false, error);
+    if (WTREE_UNLIKELY(!txn)) return NULL;
+    txn->pooled = true;
+    return txn;
+}
+
+WTREE_HOT
+void read_pool_release(wtree3_txn_t *txn) {
+    if (!txn) return;
+
+    if (WTREE_UNLIKELY(!txn->pooled)) {
+        wtree3_txn_abort(txn);
+        return;
+    }
+
+    wtree3_read_pool_t *pool = txn->db->read_pool;
+    mdb_txn_reset(txn->txn);
+    if (WTREE_UNLIKELY(txn->decoded != NULL)) codec_arena_reset(txn);
+
+    if (WTREE_LIKELY(pool != NULL)) {
+        wmutex_lock(&pool->lock);
+        if (pool->count < pool->max) {
+            pool->idle[pool->count++] = txn;
+            txn = NULL;
+        }
+        wmutex_unlock(&pool->lock);
+    }
+
+    if (txn) discard_txn(txn);
+}
+
+/* ============================================================
+ * Cursors
+ * ============================================================ */
+
+WTREE_HOT WTREE_WARN_UNUSED
+int read_pool_cursor_open(wtree3_txn_t *txn, MDB_dbi dbi, MDB_cursor **out) {
+    if (txn->pooled) {
+        for (size_t i = 0; i < txn->cursor_count; i++) {
+            if (txn->cursors[i].dbi != dbi) continue;
+
+            MDB_cursor *cursor = txn->cursors[i].cursor;
+            unsigned int cached_flags = txn->cursors[i].flags;
+            txn->cursor_count--;
+            memmove(&txn->cursors[i], &txn->cursors[i + 1],
+                    (txn->cursor_count - i) * sizeof(txn->cursors[0]));
+
+            /* The DBI slot may have been dropped and reused since - only
+             * rebind a cursor that was opened on a DB of the same shape */
+            unsigned int flags;
+            if (mdb_dbi_flags(txn->txn, dbi, &flags) == 0 && flags == cached_flags &&
+                mdb_cursor_renew(txn->txn, cursor) == 0) {
+                *out = cursor;
+                return 0;
+            }
+            mdb_cursor_close(cursor);
+            break;
+        }
+    }
+
+    return mdb_cursor_open(txn->txn, dbi, out);
+}
+
+WTREE_HOT
+void read_pool_cursor_close(wtree3_txn_t *txn, MDB_cursor *cursor) {
+    if (!cursor) return;
+
+    unsigned int flags;
+    MDB_dbi dbi = mdb_cursor_dbi(cursor);
+    if (!txn || !txn->pooled || mdb_dbi_flags(txn->txn, dbi, &flags) != 0) {
+        mdb_cursor_close(cursor);
+        return;
+    }
+
+    /* Full: evict the oldest entry */
+    if (txn->cursor_count == READ_POOL_CURSORS) {
+        mdb_cursor_close(txn->cursors[0].cursor);
+        memmove(&txn->cursors[0], &txn->cursors[1],
+                (READ_POOL_CURSORS - 1) * sizeof(txn->cursors[0]));
+        txn->cursor_count--;
+    }
+
+    txn->cursors[txn->cursor_count].dbi = dbi;
+    txn->cursors[txn->cursor_count].flags = flags;
+    txn->cursors[txn->cursor_count].cursor = cursor;
+    txn->cursor_count++;
+}
+
+/* ============================================================
+ * Configuration
+ * ============================================================ */
+
+WTREE_COLD WTREE_WARN_UNUSED
+int wtree3_db_set_read_pool_size(wtree3_db_t *db, size_t max_txns, gerror_t *error) {
+    if (WTREE_UNLIKELY(!db)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Database cannot be NULL");
+        return WTREE3_EINVAL;
+    }
+
+    wtree3_read_pool_t *pool = db->read_pool;
+    wtree3_txn_t **grown = NULL;
+    if (max_txns > 0) {
+        grown = calloc(max_txns, sizeof(wtree3_txn_t *));
+        if (WTREE_UNLIKELY(!grown)) {
+            set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate read pool");
+            return WTREE3_ENOMEM;
+        }
+    }
+
+    /* Swap in the new stack; idle txns that no longer fit are discarded */
+    wmutex_lock(&pool->lock);
+    size_t keep = pool->count < max_txns ? pool->count : max_txns;
+    size_t excess = pool->count - keep;
+    wtree3_txn_t **old = pool->idle;
+    if (keep > 0) memcpy(grown, old + excess, keep * sizeof(wtree3_txn_t *));
+    pool->idle = grown;
+    pool->count = keep;
+    pool->max = max_txns;
+    wmutex_unlock(&pool->lock);
+
+    for (size_t i = 0; i < excess; i++) discard_txn(old[i]);
+    free(old);
+    return WTREE3_OK;
+}
@@ -3,11 +3,59 @@
  *
  * This module provides bulk scanning and advanced operations:
  * - Tier 1 primitives: scan_range_txn, scan_reverse_txn, scan_prefix_txn, modify_txn, get_many_txn
- * - Tier 2 bulk ops: delete_if_txn, collect_range_txn, exists_many_txn
+ * - Batch scans: scan_range_batch_txn, scan_reverse_batch_txn, scan_prefix_batch_txn
+ * - Tier 2 bulk ops: delete_if_txn, delete_range_txn, collect_range_txn, exists_many_txn
+ * - Result sets: collect_range_result_txn, result_count/entries/free
  */
 
 #include "wtree3_internal.h"
 
+#include <stdint.h>
+
+/* ============================================================
+ * Constants
+ * ============================================================ */
+
+#define RESULT_DEFAULT_ENTRIES  64
+#define RESULT_MIN_ARENA        4096
+#define RESULT_MAX_PRESIZE      (64u * 1024 * 1024)   /* Arena reserved from max_count */
+#define RANGE_DELETE_BATCH      1024                  /* Index entries per sorted flush */
+
+/* ============================================================
+ * Internal Structures
+ * ============================================================ */
+
+struct wtree3_result_t {
+    wtree3_batch_entry_t *entries;  /* Arena-held fields store offsets until the scan ends */
+    size_t count;
+    size_t cap;
+    unsigned char *arena;
+    size_t used;
+    size_t arena_cap;
+    bool keys_in_arena;
+    bool values_in_arena;
+};
+
+/* Pending deletes of one index */
+typedef struct {
+    index_entry_t *entries;
+    size_t count;
+    size_t cap;
+} range_list_t;
+
+/* Index deletes of a range delete, flushed sorted per index */
+typedef struct {
+    wtree3_tree_t *tree;
+    const index_set_t *set;         /* Pinned for the whole delete */
+    MDB_txn *txn;
+    range_list_t *lists;            /* One per index, in set order */
+    size_t list_count;
+    size_t pending;                 /* Entries queued over all lists */
+    unsigned char *arena;           /* Index keys and dups of the queued entries */
+    size_t used;
+    size_t arena_cap;
+} range_batch_t;
+
 /* ============================================================
  * Tier 1 Operations - Generic Low-Level Primitives
  * ============================================================ */
@@ -26,11 +74,13 @@ int wtree3_scan_range_txn(
         return WTREE3_EINVAL;
     }
 
+    uint64_t t0 = metrics_begin(tree->db);
     MDB_cursor *cursor;
     int rc = mdb_cursor_open(txn->txn, tree->dbi, &cursor);
     if (rc != 0) return translate_mdb_error(rc, error);
 
     MDB_val key, val;
+    codec_buf_t buf = {0};
     MDB_cursor_op op;
 
     /* Position cursor at start */
@@ -54,6 +104,9 @@ int wtree3_scan_range_txn(
             }
         }
 
+        rc = tree_value_decode(tree, &val, &buf);
+        if (WTREE_UNLIKELY(rc != 0)) break;
+
         /* Call user callback */
         bool continue_scan = scan_fn(key.mv_data, key.mv_size,
                                       val.mv_data, val.mv_size,
@@ -67,6 +120,8 @@ int wtree3_scan_range_txn(
     }
 
     mdb_cursor_close(cursor);
+    codec_buf_release(&buf);
+    metrics_end(tree->db, tree, WTREE3_METRIC_SCAN, t0, 0);
 
     if (rc != 0 && rc != MDB_NOTFOUND) {
         return translate_mdb_error(rc, error);
@@ -89,11 +144,13 @@ int wtree3_scan_reverse_txn(
         return WTREE3_EINVAL;
     }
 
+    uint64_t t0 = metrics_begin(tree->db);
     MDB_cursor *cursor;
     int rc = mdb_cursor_open(txn->txn, tree->dbi, &cursor);
     if (rc != 0) return translate_mdb_error(rc, error);
 
     MDB_val key, val;
+    codec_buf_t buf = {0};
     MDB_cursor_op op;
 
     /* Position cursor at start (for reverse, start means "high bound") */
@@ -129,6 +186,9 @@ int wtree3_scan_reverse_txn(
             }
         }
 
+        rc = tree_value_decode(tree, &val, &buf);
+        if (WTREE_UNLIKELY(rc != 0)) break;
+
         /* Call user callback */
         bool continue_scan = scan_fn(key.mv_data, key.mv_size,
                                       val.mv_data, val.mv_size,
@@ -142,6 +202,8 @@ int wtree3_scan_reverse_txn(
     }
 
     mdb_cursor_close(cursor);
+    codec_buf_release(&buf);
+    metrics_end(tree->db, tree, WTREE3_METRIC_SCAN, t0, 0);
 
     if (rc != 0 && rc != MDB_NOTFOUND) {
         return translate_mdb_error(rc, error);
@@ -163,11 +225,13 @@ int wtree3_scan_prefix_txn(
         return WTREE3_EINVAL;
     }
 
+    uint64_t t0 = metrics_begin(tree->db);
     MDB_cursor *cursor;
     int rc = mdb_cursor_open(txn->txn, tree->dbi, &cursor);
     if (rc != 0) return translate_mdb_error(rc, error);
 
     MDB_val key, val;
+    codec_buf_t buf = {0};
 
     /* Position at prefix or next greater */
     key.mv_size = prefix_len;
@@ -182,6 +246,9 @@ int wtree3_scan_prefix_txn(
             break;  /* No longer matches prefix */
         }
 
+        rc = tree_value_decode(tree, &val, &buf);
+        if (WTREE_UNLIKELY(rc != 0)) break;
+
         /* Call user callback */
         bool continue_scan = scan_fn(key.mv_data, key.mv_size,
                                       val.mv_data, val.mv_size,
@@ -195,6 +262,8 @@ int wtree3_scan_prefix_txn(
     }
 
     mdb_cursor_close(cursor);
+    codec_buf_release(&buf);
+    metrics_end(tree->db, tree, WTREE3_METRIC_SCAN, t0, 0);
 
     if (rc != 0 && rc != MDB_NOTFOUND) {
         return translate_mdb_error(rc, error);
@@ -203,84 +272,454 @@ int wtree3_scan_prefix_txn(
     return WTREE3_OK;
 }
 
-int wtree3_modify_txn(
+/* ============================================================
+ * Batch Scans
+ *
+ * Same ranges as the scans above, but entries are gathered into a
+ * caller-provided array and handed out one page per callback. A page is
+ * filled without any per-row bound check: the scan order is monotonic,
+ * so only the last entry of a page is tested against the bound, and the
+ * cut point is binary-searched only for the page that crosses it.
+ * ============================================================ */
+
+typedef enum {
+    BATCH_BOUND_NONE,
+    BATCH_BOUND_UPPER,      /* key <= bound (forward scans) */
+    BATCH_BOUND_LOWER,      /* key >= bound (reverse scans) */
+    BATCH_BOUND_PREFIX      /* key starts with bound */
+} batch_bound_kind_t;
+
+typedef struct {
+    MDB_txn *txn;
+    MDB_dbi dbi;
+    batch_bound_kind_t kind;
+    MDB_val bound;
+} batch_bound_t;
+
+static inline bool batch_in_bounds(const batch_bound_t *b, const MDB_val *key) {
+    switch (b->kind) {
+        case BATCH_BOUND_UPPER:
+            return mdb_cmp(b->txn, b->dbi, key, &b->bound) <= 0;
+        case BATCH_BOUND_LOWER:
+            return mdb_cmp(b->txn, b->dbi, key, &b->bound) >= 0;
+        case BATCH_BOUND_PREFIX:
+            return key->mv_size >= b->bound.mv_size &&
+                   memcmp(key->mv_data, b->bound.mv_data, b->bound.mv_size) == 0;
+        default:
+            return true;
+    }
+}
+
+/* Index of the first out-of-bounds entry; entries[count-1] is known to be out */
+static size_t batch_cut(const batch_bound_t *b, const wtree3_batch_entry_t *entries,
+                        size_t count) {
+    size_t lo = 0, hi = count - 1;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (batch_in_bounds(b, &entries[mid].key)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/*
+ * Drain the cursor into pages. rc/key/val hold the result of the initial
+ * positioning; step is MDB_NEXT or MDB_PREV. Values of compressed trees
+ * are expanded into the txn's decode arena once a page is cut. Returns
+ * the last cursor rc (MDB_NOTFOUND or 0 when the scan ended normally).
+ */
+static int batch_scan_run(wtree3_txn_t *txn, const wtree3_tree_t *tree,
+                          MDB_cursor *cursor, int rc, MDB_val key, MDB_val val,
+                          MDB_cursor_op step, const batch_bound_t *bound,
+                          wtree3_batch_entry_t *entries, size_t capacity,
+                          wtree3_scan_batch_fn batch_fn, void *user_data) {
+    while (rc == 0) {
+        size_t count = 0;
+        do {
+            entries[count].key = key;
+            entries[count].value = val;
+            count++;
+            if (count == capacity) break;
+            rc = mdb_cursor_get(cursor, &key, &val, step);
+        } while (rc == 0);
+
+        bool last_page = (rc != 0);
+        if (bound->kind != BATCH_BOUND_NONE &&
+            !batch_in_bounds(bound, &entries[count - 1].key)) {
+            count = batch_cut(bound, entries, count);
+            last_page = true;
+        }
+
+        for (size_t i = 0; tree->codec && i < count; i++) {
+            int drc = tree_value_decode_txn(tree, txn, &entries[i].value);
+            if (WTREE_UNLIKELY(drc != 0)) return drc;
+        }
+
+        if (count > 0 && !batch_fn(entries, count, user_data)) return 0;
+        if (last_page) return rc;
+
+        rc = mdb_cursor_get(cursor, &key, &val, step);
+    }
+    return rc;
+}
+
+/* Position for a reverse scan: at start_key or the previous key, else the last key */
+static int reverse_seek(MDB_txn *txn, MDB_dbi dbi, MDB_cursor *cursor,
+                        const void *start_key, size_t start_len,
+                        MDB_val *key, MDB_val *val) {
+    if (!start_key) return mdb_cursor_get(cursor, key, val, MDB_LAST);
+
+    key->mv_size = start_len;
+    key->mv_data = (void*)start_key;
+    int rc = mdb_cursor_get(cursor, key, val, MDB_SET_RANGE);
+    if (rc == 0) {
+        MDB_val start = {.mv_size = start_len, .mv_data = (void*)start_key};
+        if (mdb_cmp(txn, dbi, key, &start) > 0) {
+            rc = mdb_cursor_get(cursor, key, val, MDB_PREV);
+        }
+    } else if (rc == MDB_NOTFOUND) {
+        rc = mdb_cursor_get(cursor, key, val, MDB_LAST);
+    }
+    return rc;
+}
+
+int wtree3_scan_range_batch_txn(
     wtree3_txn_t *txn,
     wtree3_tree_t *tree,
-    const void *key, size_t key_len,
-    wtree3_modify_fn modify_fn,
+    const void *start_key, size_t start_len,
+    const void *end_key, size_t end_len,
+    wtree3_batch_entry_t *entries, size_t capacity,
+    wtree3_scan_batch_fn batch_fn,
     void *user_data,
     gerror_t *error
 ) {
-    if (!txn || !tree || !key || !modify_fn) {
+    if (!txn || !tree || !entries || capacity == 0 || !batch_fn) {
         set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
         return WTREE3_EINVAL;
     }
 
-    if (!txn->is_write) {
-        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Write operation requires write transaction");
+    uint64_t t0 = metrics_begin(tree->db);
+    MDB_cursor *cursor;
+    int rc = mdb_cursor_open(txn->txn, tree->dbi, &cursor);
+    if (rc != 0) return translate_mdb_error(rc, error);
+
+    batch_bound_t bound = {
+        .txn = txn->txn, .dbi = tree->dbi,
+        .kind = end_key ? BATCH_BOUND_UPPER : BATCH_BOUND_NONE,
+        .bound = {.mv_size = end_len, .mv_data = (void*)end_key}
+    };
+
+    MDB_val key = {.mv_size = start_len, .mv_data = (void*)start_key}, val = {0};
+    rc = mdb_cursor_get(cursor, &key, &val, start_key ? MDB_SET_RANGE : MDB_FIRST);
+    rc = batch_scan_run(txn, tree, cursor, rc, key, val, MDB_NEXT, &bound,
+                        entries, capacity, batch_fn, user_data);
+
+    mdb_cursor_close(cursor);
+    metrics_end(tree->db, tree, WTREE3_METRIC_SCAN, t0, 0);
+
+    if (rc != 0 && rc != MDB_NOTFOUND) {
+        return translate_mdb_error(rc, error);
+    }
+
+    return WTREE3_OK;
+}
+
+int wtree3_scan_reverse_batch_txn(
+    wtree3_txn_t *txn,
+    wtree3_tree_t *tree,
+    const void *start_key, size_t start_len,
+    const void *end_key, size_t end_len,
+    wtree3_batch_entry_t *entries, size_t capacity,
+    wtree3_scan_batch_fn batch_fn,
+    void *user_data,
+    gerror_t *error
+) {
+    if (!txn || !tree || !entries || capacity == 0 || !batch_fn) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+
+    uint64_t t0 = metrics_begin(tree->db);
+    MDB_cursor *cursor;
+    int rc = mdb_cursor_open(txn->txn, tree->dbi, &cursor);
+    if (rc != 0) return translate_mdb_error(rc, error);
+
+    batch_bound_t bound = {
+        .txn = txn->txn, .dbi = tree->dbi,
+        .kind = end_key ? BATCH_BOUND_LOWER : BATCH_BOUND_NONE,
+        .bound = {.mv_size = end_len, .mv_data = (void*)end_key}
+    };
+
+    MDB_val key = {0}, val = {0};
+    rc = reverse_seek(txn->txn, tree->dbi, cursor, start_key, start_len, &key, &val);
+    rc = batch_scan_run(txn, tree, cursor, rc, key, val, MDB_PREV, &bound,
+                        entries, capacity, batch_fn, user_data);
+
+    mdb_cursor_close(cursor);
+    metrics_end(tree->db, tree, WTREE3_METRIC_SCAN, t0, 0);
+
+    if (rc != 0 && rc != MDB_NOTFOUND) {
+        return translate_mdb_error(rc, error);
+    }
+
+    return WTREE3_OK;
+}
+
+int wtree3_scan_prefix_batch_txn(
+    wtree3_txn_t *txn,
+    wtree3_tree_t *tree,
+    const void *prefix, size_t prefix_len,
+    wtree3_batch_entry_t *entries, size_t capacity,
+    wtree3_scan_batch_fn batch_fn,
+    void *user_data,
+    gerror_t *error
+) {
+    if (!txn || !tree || !prefix || !entries || capacity == 0 || !batch_fn) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
         return WTREE3_EINVAL;
     }
 
+    uint64_t t0 = metrics_begin(tree->db);
+    MDB_cursor *cursor;
+    int rc = mdb_cursor_open(txn->txn, tree->dbi, &cursor);
+    if (rc != 0) return translate_mdb_error(rc, error);
+
+    batch_bound_t bound = {
+        .txn = txn->txn, .dbi = tree->dbi,
+        .kind = BATCH_BOUND_PREFIX,
+        .bound = {.mv_size = prefix_len, .mv_data = (void*)prefix}
+    };
+
+    MDB_val key = {.mv_size = prefix_len, .mv_data = (void*)prefix}, val = {0};
+    rc = mdb_cursor_get(cursor, &key, &val, MDB_SET_RANGE);
+    rc = batch_scan_run(txn, tree, cursor, rc, key, val, MDB_NEXT, &bound,
+                        entries, capacity, batch_fn, user_data);
+
+    mdb_cursor_close(cursor);
+    metrics_end(tree->db, tree, WTREE3_METRIC_SCAN, t0, 0);
+
+    if (rc != 0 && rc != MDB_NOTFOUND) {
+        return translate_mdb_error(rc, error);
+    }
+
+    return WTREE3_OK;
+}
+
+/* Body of modify: cursor already open on the main tree, index set pinned */
+static int modify_run(wtree3_txn_t *txn, wtree3_tree_t *tree, const index_set_t *set,
+                      MDB_cursor *cursor,
+                      const void *key, size_t key_len,
+                      wtree3_modify_fn modify_fn, void *user_data,
+                      gerror_t *error) {
     /* Get existing value */
     MDB_val mkey = {.mv_size = key_len, .mv_data = (void*)key};
     MDB_val old_val;
-    int rc = mdb_get(txn->txn, tree->dbi, &mkey, &old_val);
-
-    const void *existing_value = NULL;
-    size_t existing_len = 0;
-    bool key_exists = false;
-
-    if (rc == 0) {
-        existing_value = old_val.mv_data;
-        existing_len = old_val.mv_size;
-        key_exists = true;
-    } else if (rc != MDB_NOTFOUND) {
+    codec_buf_t old_buf = {0};
+    bool key_exists;
+    int rc = crud_seek(txn->txn, tree, cursor, &mkey, &old_val, &key_exists);
+    if (rc == 0 && key_exists) rc = tree_value_decode(tree, &old_val, &old_buf);
+    if (rc != 0) {
+        codec_buf_release(&old_buf);
         return translate_mdb_error(rc, error);
     }
 
     /* Call modify callback */
     size_t new_len;
-    void *new_value = modify_fn(existing_value, existing_len, user_data, &new_len);
+    void *new_value = modify_fn(key_exists ? old_val.mv_data : NULL,
+                                key_exists ? old_val.mv_size : 0, user_data, &new_len);
 
     /* Handle different cases based on modify_fn result */
     if (!new_value) {
         if (key_exists) {
             /* Delete the key */
-            bool deleted;
-            return wtree3_delete_one_txn(txn, tree, key, key_len, &deleted, error);
-        } else {
-            /* Abort operation (key doesn't exist and callback returned NULL) */
-            return WTREE3_OK;
+            uint64_t t0 = metrics_begin(tree->db);
+            rc = crud_delete_at(txn, tree, set, cursor, key, key_len,
+                                old_val.mv_data, old_val.mv_size, error);
+            metrics_end(tree->db, tree, WTREE3_METRIC_DELETE, t0, key_len);
+            durability_write(tree->db, key_len);
         }
+        /* Else abort operation (key doesn't exist and callback returned NULL) */
+        codec_buf_release(&old_buf);
+        return rc;
     }
 
     /* We have a new value to write */
     if (key_exists) {
-        /* Update existing key */
-        rc = indexes_delete(tree, txn->txn, key, key_len, old_val.mv_data, old_val.mv_size, error);
-        if (rc != 0) {
-            free(new_value);
-            return rc;
-        }
+        /* Update existing key (only changed index keys are rewritten) */
+        rc = crud_replace_at(txn, tree, set, cursor, key, key_len,
+                             old_val.mv_data, old_val.mv_size, new_value, new_len, error);
+    } else {
+        /* Insert new key */
+        uint64_t t0 = metrics_begin(tree->db);
+        rc = crud_insert_at(txn, tree, set, cursor, key, key_len, new_value, new_len, error);
+        metrics_end(tree->db, tree, WTREE3_METRIC_INSERT, t0, key_len + new_len);
+        durability_write(tree->db, key_len + new_len);
+    }
+    free(new_value);
+    codec_buf_release(&old_buf);
+    return rc;
+}
 
-        rc = indexes_insert(tree, txn->txn, key, key_len, new_value, new_len, error);
-        if (rc != 0) {
-            free(new_value);
-            return rc;
+int wtree3_modify_txn(
+    wtree3_txn_t *txn,
+    wtree3_tree_t *tree,
+    const void *key, size_t key_len,
+    wtree3_modify_fn modify_fn,
+    void *user_data,
+    gerror_t *error
+) {
+    if (!txn || !tree || !key || !modify_fn) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+
+    if (!txn->is_write) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Write operation requires write transaction");
+        return WTREE3_EINVAL;
+    }
+
+    /* One cursor finds the key and writes the result */
+    MDB_cursor *cursor;
+    int rc = mdb_cursor_open(txn->txn, tree->dbi, &cursor);
+    if (rc != 0) return translate_mdb_error(rc, error);
+
+    index_pin_t pin;
+    const index_set_t *set = index_set_pin(tree, &pin);
+    rc = modify_run(txn, tree, set, cursor, key, key_len, modify_fn, user_data, error);
+    index_set_unpin(&pin);
+    mdb_cursor_close(cursor);
+    return rc;
+}
+
+/* ============================================================
+ * Multi-Key Lookup
+ *
+ * get_many and exists_many resolve keys in key order on one cursor
+ * rather than one root-to-leaf descent per key in input order:
+ * MDB_SET_KEY on a positioned cursor stays on the current leaf when the
+ * next key lives there, and neighbouring keys share pages. Input that is
+ * already sorted is detected and walked as-is; otherwise a permutation
+ * is sorted and results are still written at each key's input position.
+ *
+ * Each time the walk lands on a new leaf page, the following pages are
+ * hinted with MADV_WILLNEED (leaves of sequentially loaded trees are laid
+ * out in key order), and overflow values are hinted as a whole before
+ * they are handed to the caller.
+ * ============================================================ */
+
+#define MANY_SORT_MIN         8     /* Below this, input order is used as-is */
+#define MANY_PREFETCH_PAGES   8     /* Pages hinted past each new leaf */
+
+typedef struct {
+    MDB_txn *txn;
+    MDB_dbi dbi;
+    const wtree3_kv_t *keys;
+} many_sort_ctx_t;
+
+static int many_cmp_kv(const void *a, const void *b, void *ctx) {
+    const many_sort_ctx_t *c = (const many_sort_ctx_t *)ctx;
+    const wtree3_kv_t *ka = (const wtree3_kv_t *)a;
+    const wtree3_kv_t *kb = (const wtree3_kv_t *)b;
+    MDB_val va = {.mv_size = ka->key_len, .mv_data = (void *)ka->key};
+    MDB_val vb = {.mv_size = kb->key_len, .mv_data = (void *)kb->key};
+    return mdb_cmp(c->txn, c->dbi, &va, &vb);
+}
+
+static int many_cmp_index(const void *a, const void *b, void *ctx) {
+    const many_sort_ctx_t *c = (const many_sort_ctx_t *)ctx;
+    return many_cmp_kv(&c->keys[*(const size_t *)a], &c->keys[*(const size_t *)b], ctx);
+}
+
+/*
+ * Resolve keys[] into values/value_lens (get_many) or results (exists_many).
+ * Falls back to input order if the permutation can't be allocated.
+ */
+static int many_lookup(wtree3_txn_t *txn, wtree3_tree_t *tree,
+                       const wtree3_kv_t *keys, size_t key_count,
+                       const void **values, size_t *value_lens, bool *results,
+                       gerror_t *error) {
+    many_sort_ctx_t ctx = {.txn = txn->txn, .dbi = tree->dbi, .keys = keys};
+
+    size_t *order = NULL;
+    if (key_count >= MANY_SORT_MIN &&
+        !wsort_is_sorted(keys, key_count, sizeof(wtree3_kv_t), many_cmp_kv, &ctx)) {
+        order = malloc(key_count * sizeof(size_t));
+        if (order) {
+            for (size_t i = 0; i < key_count; i++) order[i] = i;
+            if (!wsort(order, key_count, sizeof(size_t), many_cmp_index, &ctx)) {
+                free(order);
+                order = NULL;
+            }
         }
+    }
 
-        MDB_val mval = {.mv_size = new_len, .mv_data = new_value};
-        rc = mdb_put(txn->txn, tree->dbi, &mkey, &mval, 0);
-        free(new_value);
+    MDB_cursor *cursor;
+    int rc = mdb_cursor_open(txn->txn, tree->dbi, &cursor);
+    if (rc != 0) {
+        free(order);
+        return translate_mdb_error(rc, error);
+    }
 
-        if (rc != 0) return translate_mdb_error(rc, error);
-    } else {
-        /* Insert new key */
-        rc = wtree3_insert_one_txn(txn, tree, key, key_len, new_value, new_len, error);
-        free(new_value);
-        if (rc != 0) return rc;
+    /* Dirty pages of a write txn live outside the map - only hint reads */
+    MDB_stat st;
+    size_t psize = 0;
+    if (!txn->is_write && mdb_env_stat(tree->db->env, &st) == 0) psize = st.ms_psize;
+    uintptr_t last_page = 0;
+
+    size_t prev = SIZE_MAX;
+    MDB_val mval = {0};
+    bool found = false;
+
+    for (size_t n = 0; n < key_count; n++) {
+        size_t i = order ? order[n] : n;
+
+        /* Repeated keys are adjacent after sorting - reuse the result */
+        if (prev == SIZE_MAX || many_cmp_kv(&keys[prev], &keys[i], &ctx) != 0) {
+            MDB_val mkey = {.mv_size = keys[i].key_len, .mv_data = (void *)keys[i].key};
+            rc = filter_rules_out(tree->filter, txn->txn, mkey.mv_data, mkey.mv_size)
+                     ? MDB_NOTFOUND : mdb_cursor_get(cursor, &mkey, &mval, MDB_SET_KEY);
+            if (rc == MDB_NOTFOUND) {
+                found = false;
+            } else if (rc != 0) {
+                mdb_cursor_close(cursor);
+                free(order);
+                return translate_mdb_error(rc, error);
+            } else {
+                found = true;
+                if (psize && mval.mv_size > psize) {
+                    memopt_willneed(mval.mv_data, mval.mv_size, psize);
+                } else if (psize) {
+                    uintptr_t page = (uintptr_t)mval.mv_data & ~(uintptr_t)(psize - 1);
+                    if (page != last_page) {
+                        memopt_willneed((const void *)(page + psize),
+                                        MANY_PREFETCH_PAGES * psize, psize);
+                        last_page = page;
+                    }
+                }
+
+                rc = results ? 0 : tree_value_decode_txn(tree, txn, &mval);
+                if (WTREE_UNLIKELY(rc != 0)) {
+                    mdb_cursor_close(cursor);
+                    free(order);
+                    return translate_mdb_error(rc, error);
+                }
+            }
+        }
+        prev = i;
+
+        if (results) {
+            results[i] = found;
+        } else {
+            values[i] = found ? mval.mv_data : NULL;
+            value_lens[i] = found ? mval.mv_size : 0;
+        }
     }
 
+    mdb_cursor_close(cursor);
+    free(order);
     return WTREE3_OK;
 }
 
@@ -296,23 +735,218 @@ int wtree3_get_many_txn(
         return WTREE3_EINVAL;
     }
 
-    for (size_t i = 0; i < key_count; i++) {
-        MDB_val mkey = {.mv_size = keys[i].key_len, .mv_data = (void*)keys[i].key};
-        MDB_val mval;
+    return many_lookup(txn, tree, keys, key_count, values, value_lens, NULL, error);
+}
 
-        int rc = mdb_get(txn->txn, tree->dbi, &mkey, &mval);
+/* ============================================================
+ * Range Deletes
+ * ============================================================ */
 
-        if (rc == 0) {
-            values[i] = mval.mv_data;
-            value_lens[i] = mval.mv_size;
-        } else if (rc == MDB_NOTFOUND) {
-            values[i] = NULL;
-            value_lens[i] = 0;
-        } else {
-            return translate_mdb_error(rc, error);
+/*
+ * Rows are deleted through one cursor as the scan reaches them. Their index
+ * entries are extracted first, while key and value still point into the
+ * page, and copied (index key and dup only) into a batch arena; every
+ * RANGE_DELETE_BATCH entries the batch is sorted per index and deleted in
+ * index order. Deferring is safe: index deletes never depend on the main
+ * row, and nothing but this txn sees the gap.
+ */
+
+/* Make room for bytes more in the batch arena */
+static bool range_reserve(range_batch_t *b, size_t bytes) {
+    if (b->arena && b->arena_cap - b->used >= bytes) return true;
+
+    size_t cap = b->arena_cap ? b->arena_cap : RESULT_MIN_ARENA;
+    while (cap - b->used < bytes) cap *= 2;
+    unsigned char *grown = realloc(b->arena, cap);
+    if (WTREE_UNLIKELY(!grown)) return false;
+    b->arena = grown;
+    b->arena_cap = cap;
+    return true;
+}
+
+/* Queue one index entry; both fields carry arena offsets until the flush */
+static bool range_push(range_batch_t *b, range_list_t *l,
+                       const void *key, size_t key_len, const MDB_val *dup) {
+    if (l->count == l->cap) {
+        size_t cap = l->cap ? l->cap * 2 : RESULT_DEFAULT_ENTRIES;
+        index_entry_t *grown = realloc(l->entries, cap * sizeof(index_entry_t));
+        if (WTREE_UNLIKELY(!grown)) return false;
+        l->entries = grown;
+        l->cap = cap;
+    }
+    if (WTREE_UNLIKELY(!range_reserve(b, key_len + dup->mv_size))) return false;
+
+    index_entry_t *e = &l->entries[l->count++];
+    e->key.mv_size = key_len;
+    e->key.mv_data = (void *)(uintptr_t)b->used;
+    memcpy(b->arena + b->used, key, key_len);
+    b->used += key_len;
+    e->main_key.mv_size = dup->mv_size;
+    e->main_key.mv_data = (void *)(uintptr_t)b->used;
+    if (dup->mv_size) memcpy(b->arena + b->used, dup->mv_data, dup->mv_size);
+    b->used += dup->mv_size;
+    b->pending++;
+    return true;
+}
+
+/* Queue the index entries of one row (key and value still on their page) */
+static int range_batch_add(range_batch_t *b, const MDB_val *key, const MDB_val *val,
+                           gerror_t *error) {
+    for (size_t i = 0; i < b->list_count; i++) {
+        wtree3_index_t *idx = b->set->items[i];
+        if (WTREE_UNLIKELY(!index_covers_key(b->txn, b->tree, idx, key->mv_data, key->mv_size))) {
+            continue;
+        }
+
+        index_key_t idx_key;
+        bool indexed = index_key_extract(idx, val->mv_data, val->mv_size, &idx_key);
+        if (!indexed || !idx_key.data) {
+            index_key_release(&idx_key);
+            continue;
+        }
+
+        index_dup_t dup;
+        int rc = index_dup_build(idx, key->mv_data, key->mv_size, NULL, 0, &dup, error);
+        if (WTREE_UNLIKELY(rc != 0)) {
+            index_key_release(&idx_key);
+            return rc;
+        }
+        bool queued = range_push(b, &b->lists[i], idx_key.data, idx_key.len, &dup.val);
+        index_dup_release(&dup);
+        index_key_release(&idx_key);
+
+        if (WTREE_UNLIKELY(!queued)) {
+            set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to queue index deletes");
+            return WTREE3_ENOMEM;
         }
     }
+    return WTREE3_OK;
+}
+
+/* Delete the queued entries, each index in (index key, main key) order */
+static int range_batch_flush(range_batch_t *b, gerror_t *error) {
+    if (b->pending == 0) return WTREE3_OK;
 
+    uint64_t t0 = metrics_begin(b->tree->db);
+    int status = WTREE3_OK;
+    for (size_t i = 0; i < b->list_count && status == WTREE3_OK; i++) {
+        range_list_t *l = &b->lists[i];
+        if (l->count == 0) continue;
+        wtree3_index_t *idx = b->set->items[i];
+
+        for (size_t j = 0; j < l->count; j++) {
+            l->entries[j].key.mv_data = b->arena + (uintptr_t)l->entries[j].key.mv_data;
+            l->entries[j].main_key.mv_data = b->arena + (uintptr_t)l->entries[j].main_key.mv_data;
+        }
+        if (WTREE_UNLIKELY(!index_entries_sort(b->txn, idx, l->entries, l->count))) {
+            set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to sort index entries");
+            status = WTREE3_ENOMEM;
+            break;
+        }
+
+        for (size_t j = 0; j < l->count; j++) {
+            int rc = mdb_del(b->txn, idx->dbi, &l->entries[j].key, &l->entries[j].main_key);
+            if (WTREE_UNLIKELY(rc != 0 && rc != MDB_NOTFOUND)) {
+                status = translate_mdb_error(rc, error);
+                break;
+            }
+            if (rc == 0) {
+                metrics_count(b->tree->db, idx, WTREE3_METRIC_DELETE);
+                filter_note_remove(idx->filter);
+            }
+        }
+    }
+    metrics_end(b->tree->db, b->tree, WTREE3_METRIC_INDEX_MAINT, t0, 0);
+
+    for (size_t i = 0; i < b->list_count; i++) b->lists[i].count = 0;
+    b->pending = 0;
+    b->used = 0;
+    return status;
+}
+
+static void range_batch_release(range_batch_t *b) {
+    for (size_t i = 0; i < b->list_count; i++) free(b->lists[i].entries);
+    free(b->lists);
+    free(b->arena);
+}
+
+static int range_delete_run(wtree3_txn_t *txn, wtree3_tree_t *tree, const index_set_t *set,
+                            const void *start_key, size_t start_len,
+                            const void *end_key, size_t end_len,
+                            wtree3_predicate_fn predicate, void *user_data,
+                            size_t *deleted_out, gerror_t *error) {
+    size_t index_count = set->count;
+    range_batch_t batch = {.tree = tree, .set = set, .txn = txn->txn, .list_count = index_count};
+    if (index_count) {
+        batch.lists = calloc(index_count, sizeof(range_list_t));
+        if (WTREE_UNLIKELY(!batch.lists)) {
+            set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate index delete batch");
+            return WTREE3_ENOMEM;
+        }
+    }
+
+    uint64_t t0 = metrics_begin(tree->db);
+    MDB_cursor *cursor;
+    int rc = mdb_cursor_open(txn->txn, tree->dbi, &cursor);
+    if (rc != 0) {
+        range_batch_release(&batch);
+        return translate_mdb_error(rc, error);
+    }
+
+    MDB_val key = {.mv_size = start_len, .mv_data = (void*)start_key};
+    MDB_val val;
+    MDB_val end = {.mv_size = end_len, .mv_data = (void*)end_key};
+    codec_buf_t buf = {0};
+    bool need_value = predicate || index_count;
+    size_t deleted_count = 0;
+    int status = WTREE3_OK;         /* Library error, already reported */
+
+    rc = mdb_cursor_get(cursor, &key, &val, start_key ? MDB_SET_RANGE : MDB_FIRST);
+    while (rc == 0) {
+        if (end_key && mdb_cmp(txn->txn, tree->dbi, &key, &end) > 0) break;
+
+        if (need_value) {
+            rc = tree_value_decode(tree, &val, &buf);
+            if (WTREE_UNLIKELY(rc != 0)) break;
+        }
+        if (predicate && !predicate(key.mv_data, key.mv_size, val.mv_data, val.mv_size, user_data)) {
+            rc = mdb_cursor_get(cursor, &key, &val, MDB_NEXT);
+            continue;
+        }
+
+        /* Before the delete: afterwards key and val may point at freed space */
+        if (index_count) {
+            status = range_batch_add(&batch, &key, &val, error);
+            if (WTREE_UNLIKELY(status != WTREE3_OK)) break;
+        }
+        status = changelog_note(tree, txn->txn, WTREE3_CHANGE_DELETE, key.mv_data, key.mv_size,
+                                NULL, 0, error);
+        if (WTREE_UNLIKELY(status != WTREE3_OK)) break;
+
+        rc = mdb_cursor_del(cursor, 0);
+        if (WTREE_UNLIKELY(rc != 0)) break;
+        deleted_count++;
+        filter_note_remove(tree->filter);
+
+        if (batch.pending >= RANGE_DELETE_BATCH) {
+            status = range_batch_flush(&batch, error);
+            if (WTREE_UNLIKELY(status != WTREE3_OK)) break;
+        }
+
+        /* The cursor was left on the following entry; MDB_NEXT returns it */
+        rc = mdb_cursor_get(cursor, &key, &val, MDB_NEXT);
+    }
+
+    mdb_cursor_close(cursor);
+    codec_buf_release(&buf);
+
+    if (status == WTREE3_OK && rc != 0 && rc != MDB_NOTFOUND) status = translate_mdb_error(rc, error);
+    if (status == WTREE3_OK) status = range_batch_flush(&batch, error);
+    range_batch_release(&batch);
+    metrics_end(tree->db, tree, WTREE3_METRIC_SCAN, t0, 0);
+    if (status != WTREE3_OK) return status;
+
+    if (deleted_out) *deleted_out = deleted_count;
     return WTREE3_OK;
 }
 
@@ -340,102 +974,41 @@ int wtree3_delete_if_txn(
         return WTREE3_EINVAL;
     }
 
-    MDB_cursor *cursor;
-    int rc = mdb_cursor_open(txn->txn, tree->dbi, &cursor);
-    if (rc != 0) return translate_mdb_error(rc, error);
-
-    MDB_val key, val;
-    MDB_cursor_op op;
-
-    /* Position cursor at start */
-    if (start_key) {
-        key.mv_size = start_len;
-        key.mv_data = (void*)start_key;
-        op = MDB_SET_RANGE;
-    } else {
-        op = MDB_FIRST;
-    }
-
-    rc = mdb_cursor_get(cursor, &key, &val, op);
-
-    size_t deleted_count = 0;
-
-    /* Iterate and delete matching entries */
-    while (rc == 0) {
-        /* Check if we've passed end_key */
-        if (end_key) {
-            MDB_val end = {.mv_size = end_len, .mv_data = (void*)end_key};
-            if (mdb_cmp(txn->txn, tree->dbi, &key, &end) > 0) {
-                break;
-            }
-        }
-
-        /* Test predicate */
-        bool should_delete = predicate(key.mv_data, key.mv_size,
-                                       val.mv_data, val.mv_size,
-                                       user_data);
-
-        if (should_delete) {
-            /* Need to save key for index deletion since cursor delete invalidates it */
-            void *key_copy = malloc(key.mv_size);
-            void *val_copy = malloc(val.mv_size);
-            if (!key_copy || !val_copy) {
-                free(key_copy);
-                free(val_copy);
-                mdb_cursor_close(cursor);
-                set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Out of memory");
-                return WTREE3_ENOMEM;
-            }
-
-            memcpy(key_copy, key.mv_data, key.mv_size);
-            size_t key_copy_len = key.mv_size;
-            memcpy(val_copy, val.mv_data, val.mv_size);
-            size_t val_copy_len = val.mv_size;
-
-            /* Delete from indexes first */
-            int del_rc = indexes_delete(tree, txn->txn, key_copy, key_copy_len,
-                                       val_copy, val_copy_len, error);
-            if (del_rc != 0) {
-                free(key_copy);
-                free(val_copy);
-                mdb_cursor_close(cursor);
-                return del_rc;
-            }
-
-            /* Delete from main tree using cursor */
-            rc = mdb_cursor_del(cursor, 0);
-            free(key_copy);
-            free(val_copy);
-
-            if (rc != 0) {
-                mdb_cursor_close(cursor);
-                return translate_mdb_error(rc, error);
-            }
-
-            tree->entry_count--;
-            deleted_count++;
+    index_pin_t pin;
+    const index_set_t *set = index_set_pin(tree, &pin);
+    int rc = range_delete_run(txn, tree, set, start_key, start_len, end_key, end_len,
+                              predicate, user_data, deleted_out, error);
+    index_set_unpin(&pin);
+    return rc;
+}
 
-            /* After mdb_cursor_del, we need to reposition the cursor
-             * Try to get current position (next entry after delete) */
-            rc = mdb_cursor_get(cursor, &key, &val, MDB_NEXT);
-            /* If NOTFOUND, we deleted the last entry - continue to exit loop */
-        } else {
-            /* Move to next entry */
-            rc = mdb_cursor_get(cursor, &key, &val, MDB_NEXT);
-        }
+int wtree3_delete_range_txn(
+    wtree3_txn_t *txn,
+    wtree3_tree_t *tree,
+    const void *start_key, size_t start_len,
+    const void *end_key, size_t end_len,
+    size_t *deleted_out,
+    gerror_t *error
+) {
+    if (!txn || !tree) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
     }
 
-    mdb_cursor_close(cursor);
-
-    if (rc != 0 && rc != MDB_NOTFOUND) {
-        return translate_mdb_error(rc, error);
+    if (!txn->is_write) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Write operation requires write transaction");
+        return WTREE3_EINVAL;
     }
 
-    if (deleted_out) {
-        *deleted_out = deleted_count;
-    }
+    /* Whole tree: drop the pages instead of visiting the rows */
+    if (!start_key && !end_key) return wtree3_tree_clear_txn(txn, tree, deleted_out, error);
 
-    return WTREE3_OK;
+    index_pin_t pin;
+    const index_set_t *set = index_set_pin(tree, &pin);
+    int rc = range_delete_run(txn, tree, set, start_key, start_len, end_key, end_len,
+                              NULL, NULL, deleted_out, error);
+    index_set_unpin(&pin);
+    return rc;
 }
 
 int wtree3_collect_range_txn(
@@ -492,6 +1065,7 @@ int wtree3_collect_range_txn(
     }
 
     MDB_val key, val;
+    codec_buf_t buf = {0};
     MDB_cursor_op op;
 
     /* Position cursor at start */
@@ -521,6 +1095,9 @@ int wtree3_collect_range_txn(
             break;
         }
 
+        rc = tree_value_decode(tree, &val, &buf);
+        if (WTREE_UNLIKELY(rc != 0)) break;
+
         /* Test predicate (if provided) */
         bool should_collect = true;
         if (predicate) {
@@ -549,6 +1126,7 @@ int wtree3_collect_range_txn(
                     free(values);
                     free(v_lens);
                     mdb_cursor_close(cursor);
+                    codec_buf_release(&buf);
                     set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Out of memory");
                     return WTREE3_ENOMEM;
                 }
@@ -577,6 +1155,7 @@ int wtree3_collect_range_txn(
                 free(values);
                 free(v_lens);
                 mdb_cursor_close(cursor);
+                codec_buf_release(&buf);
                 set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Out of memory");
                 return WTREE3_ENOMEM;
             }
@@ -594,6 +1173,7 @@ int wtree3_collect_range_txn(
     }
 
     mdb_cursor_close(cursor);
+    codec_buf_release(&buf);
 
     if (rc != 0 && rc != MDB_NOTFOUND) {
         /* Cleanup on error */
@@ -618,32 +1198,179 @@ int wtree3_collect_range_txn(
     return WTREE3_OK;
 }
 
-int wtree3_exists_many_txn(
+/* ============================================================
+ * Result Sets
+ * ============================================================ */
+
+/* Make room for bytes more in the arena */
+static bool result_reserve(wtree3_result_t *r, size_t bytes) {
+    if (r->arena && r->arena_cap - r->used >= bytes) return true;
+
+    size_t cap = r->arena_cap ? r->arena_cap : RESULT_MIN_ARENA;
+    while (cap - r->used < bytes) cap *= 2;
+    unsigned char *grown = realloc(r->arena, cap);
+    if (WTREE_UNLIKELY(!grown)) return false;
+    r->arena = grown;
+    r->arena_cap = cap;
+    return true;
+}
+
+/* Copy v into the arena (room reserved); the offset rides in mv_data */
+static MDB_val result_copy(wtree3_result_t *r, const MDB_val *v) {
+    MDB_val out = {.mv_size = v->mv_size, .mv_data = (void *)(uintptr_t)r->used};
+    if (v->mv_size) memcpy(r->arena + r->used, v->mv_data, v->mv_size);
+    r->used += v->mv_size;
+    return out;
+}
+
+static int result_add(wtree3_result_t *r, const MDB_val *key, const MDB_val *val,
+                      size_t max_count) {
+    if (r->count == r->cap) {
+        size_t cap = r->cap * 2;
+        wtree3_batch_entry_t *grown = realloc(r->entries, cap * sizeof(wtree3_batch_entry_t));
+        if (WTREE_UNLIKELY(!grown)) return WTREE3_ENOMEM;
+        r->entries = grown;
+        r->cap = cap;
+    }
+
+    size_t bytes = (r->keys_in_arena ? key->mv_size : 0) + (r->values_in_arena ? val->mv_size : 0);
+    if (r->keys_in_arena || r->values_in_arena) {
+        /* Bounded result: guess the arena from the first entry */
+        if (r->count == 0 && max_count > 1) {
+            size_t presize = bytes < RESULT_MAX_PRESIZE / max_count ? bytes * max_count
+                                                                   : RESULT_MAX_PRESIZE;
+            if (presize > bytes) (void)result_reserve(r, presize);
+        }
+        if (WTREE_UNLIKELY(!result_reserve(r, bytes))) return WTREE3_ENOMEM;
+    }
+
+    wtree3_batch_entry_t *e = &r->entries[r->count++];
+    e->key = r->keys_in_arena ? result_copy(r, key) : *key;
+    e->value = r->values_in_arena ? result_copy(r, val) : *val;
+    return WTREE3_OK;
+}
+
+WTREE_WARN_UNUSED
+int wtree3_collect_range_result_txn(
     wtree3_txn_t *txn,
     wtree3_tree_t *tree,
-    const wtree3_kv_t *keys, size_t key_count,
-    bool *results,
+    const void *start_key, size_t start_len,
+    const void *end_key, size_t end_len,
+    wtree3_predicate_fn predicate,
+    void *user_data,
+    size_t max_count,
+    unsigned int flags,
+    wtree3_result_t **result_out,
     gerror_t *error
 ) {
-    if (!txn || !tree || !keys || !results || key_count == 0) {
+    if (WTREE_UNLIKELY(!txn || !tree || !result_out)) {
         set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
         return WTREE3_EINVAL;
     }
+    *result_out = NULL;
 
-    for (size_t i = 0; i < key_count; i++) {
-        MDB_val mkey = {.mv_size = keys[i].key_len, .mv_data = (void*)keys[i].key};
-        MDB_val mval;
+    wtree3_result_t *r = calloc(1, sizeof(wtree3_result_t));
+    if (WTREE_UNLIKELY(!r)) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate result set");
+        return WTREE3_ENOMEM;
+    }
+    /* Decoded values live in a scratch buffer, so they are always copied */
+    r->keys_in_arena = !(flags & WTREE3_COLLECT_ZERO_COPY);
+    r->values_in_arena = r->keys_in_arena || tree->codec != NULL;
+    r->cap = max_count ? max_count : RESULT_DEFAULT_ENTRIES;
+    r->entries = malloc(r->cap * sizeof(wtree3_batch_entry_t));
+    if (WTREE_UNLIKELY(!r->entries)) {
+        free(r);
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate result set");
+        return WTREE3_ENOMEM;
+    }
 
-        int rc = mdb_get(txn->txn, tree->dbi, &mkey, &mval);
+    uint64_t t0 = metrics_begin(tree->db);
+    MDB_cursor *cursor;
+    int rc = mdb_cursor_open(txn->txn, tree->dbi, &cursor);
+    if (WTREE_UNLIKELY(rc != 0)) {
+        wtree3_result_free(r);
+        return translate_mdb_error(rc, error);
+    }
 
-        if (rc == 0) {
-            results[i] = true;
-        } else if (rc == MDB_NOTFOUND) {
-            results[i] = false;
-        } else {
-            return translate_mdb_error(rc, error);
+    MDB_val key, val;
+    MDB_val end = {.mv_size = end_len, .mv_data = (void *)end_key};
+    codec_buf_t buf = {0};
+    if (start_key) {
+        key.mv_size = start_len;
+        key.mv_data = (void *)start_key;
+        rc = mdb_cursor_get(cursor, &key, &val, MDB_SET_RANGE);
+    } else {
+        rc = mdb_cursor_get(cursor, &key, &val, MDB_FIRST);
+    }
+
+    int result = WTREE3_OK;
+    while (rc == 0) {
+        if (end_key && mdb_cmp(txn->txn, tree->dbi, &key, &end) > 0) break;
+        if (max_count > 0 && r->count >= max_count) break;
+
+        rc = tree_value_decode(tree, &val, &buf);
+        if (WTREE_UNLIKELY(rc != 0)) break;
+
+        if (!predicate || predicate(key.mv_data, key.mv_size, val.mv_data, val.mv_size, user_data)) {
+            result = result_add(r, &key, &val, max_count);
+            if (WTREE_UNLIKELY(result != WTREE3_OK)) break;
         }
+
+        rc = mdb_cursor_get(cursor, &key, &val, MDB_NEXT);
+    }
+    mdb_cursor_close(cursor);
+    codec_buf_release(&buf);
+
+    if (result == WTREE3_OK && rc != 0 && rc != MDB_NOTFOUND) {
+        result = translate_mdb_error(rc, error);
+    } else if (result == WTREE3_ENOMEM) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to grow result set");
+    }
+    if (WTREE_UNLIKELY(result != WTREE3_OK)) {
+        wtree3_result_free(r);
+        return result;
+    }
+
+    /* The arena is final: turn offsets into pointers */
+    for (size_t i = 0; i < r->count; i++) {
+        wtree3_batch_entry_t *e = &r->entries[i];
+        if (r->keys_in_arena) e->key.mv_data = r->arena + (uintptr_t)e->key.mv_data;
+        if (r->values_in_arena) e->value.mv_data = r->arena + (uintptr_t)e->value.mv_data;
     }
 
+    metrics_end(tree->db, tree, WTREE3_METRIC_SCAN, t0, 0);
+    *result_out = r;
     return WTREE3_OK;
 }
+
+size_t wtree3_result_count(const wtree3_result_t *result) {
+    return result ? result->count : 0;
+}
+
+const wtree3_batch_entry_t* wtree3_result_entries(const wtree3_result_t *result) {
+    return result ? result->entries : NULL;
+}
+
+void wtree3_result_free(wtree3_result_t *result) {
+    if (!result) return;
+
+    free(result->arena);
+    free(result->entries);
+    free(result);
+}
+
+int wtree3_exists_many_txn(
+    wtree3_txn_t *txn,
+    wtree3_tree_t *tree,
+    const wtree3_kv_t *keys, size_t key_count,
+    bool *results,
+    gerror_t *error
+) {
+    if (!txn || !tree || !keys || !results || key_count == 0) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+
+    return many_lookup(txn, tree, keys, key_count, NULL, NULL, results, error);
+}
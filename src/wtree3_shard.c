@@ -0,0 +1,939 @@
+/*
+ * wtree3_shard.c - Sharded Databases
+ *
+ * LMDB allows one writer per environment, so a single wtree3_db_t tops
+ * out at one core's worth of write transactions. A sharded database is
+ * N ordinary databases in dir/shard-000 .. dir/shard-NNN; every key is
+ * routed to exactly one of them, by hash or by key range, and writes to
+ * different shards commit concurrently.
+ *
+ * Each shard is self-contained: its own metadata, its own copy of each
+ * sharded tree and local indexes over that shard's rows only. Point
+ * operations touch one shard. Ordered scans open a read txn per shard and
+ * merge the per-shard cursors with a k-way heap; range-partitioned layouts
+ * only visit the shards overlapping the range. Index scans fan out the
+ * same way, merged by (index key, main key).
+ *
+ * The layout (shard count, mode, split points) is stored in shard 0 and
+ * checked on reopen. There are no cross-shard transactions: an operation
+ * is atomic within its shard only, and unique indexes are unique per
+ * shard.
+ *
+ * This module provides:
+ * - Lifecycle: sharded_db_open, sharded_db_close, sharded_tree_open/close
+ * - Routing: sharded_shard_of
+ * - Schema: sharded_tree_add_index, populate_index, drop_index
+ * - Point operations: sharded_get, insert_one, update, upsert, delete_one, exists
+ * - Scans: sharded_scan_range (merged), sharded_scan_parallel, sharded_index_scan
+ */
+
+#include "wtree3_internal.h"
+#include "whash.h"
+#include "wthread.h"
+#include "macros.h"
+
+#if WTREE_OS_WINDOWS
+    #include <direct.h>
+    #define shard_mkdir(path) _mkdir(path)
+#else
+    #include <sys/stat.h>
+    #define shard_mkdir(path) mkdir(path, 0755)
+#endif
+
+/* ============================================================
+ * Constants
+ * ============================================================ */
+
+#define SHARD_LAYOUT_TREE   "__wtree3_shards__"
+#define SHARD_LAYOUT_KEY    "layout"
+#define SHARD_LAYOUT_MAGIC  0x31485357u     /* "WSH1" */
+#define SHARD_PATH_MAX      4096
+
+/* ============================================================
+ * Internal Structures
+ * ============================================================ */
+
+struct wtree3_sharded_db_t {
+    char *path;
+    size_t count;
+    wtree3_shard_mode_t mode;
+    MDB_val *splits;                /* count - 1 ascending boundaries (RANGE mode) */
+    wtree3_db_t **shards;
+};
+
+struct wtree3_sharded_tree_t {
+    wtree3_sharded_db_t *sdb;
+    char *name;
+    wtree3_tree_t **trees;          /* One per shard */
+};
+
+/* One shard's position in a merged scan */
+typedef struct {
+    wtree3_tree_t *tree;
+    wtree3_txn_t *txn;
+    MDB_cursor *cursor;
+    MDB_val key;                    /* Main key, or index key for index scans */
+    MDB_val val;                    /* Value, or dup value for index scans */
+    MDB_val main_key;               /* Index scans: main key split from val */
+    index_pin_t pin;
+    wtree3_index_t *idx;            /* Index scans only */
+} shard_cursor_t;
+
+typedef struct {
+    shard_cursor_t *cur;
+    size_t *heap;                   /* Indexes into cur, smallest entry first */
+    size_t heap_len;
+    MDB_val end;                    /* Inclusive upper bound (mv_data NULL = none) */
+    bool index;
+} shard_merge_t;
+
+/* ============================================================
+ * Layout
+ * ============================================================ */
+
+/* LMDB's default order: memcmp over the common length, shorter first */
+static int shard_key_cmp(const void *a, size_t a_len, const void *b, size_t b_len) {
+    size_t len = a_len < b_len ? a_len : b_len;
+    int c = len ? memcmp(a, b, len) : 0;
+    if (c != 0) return c;
+    return a_len < b_len ? -1 : (a_len > b_len ? 1 : 0);
+}
+
+/* Shard whose range holds key: the number of splits <= key */
+static size_t shard_range_route(const wtree3_sharded_db_t *sdb, const void *key, size_t key_len) {
+    size_t lo = 0, hi = sdb->count - 1;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const MDB_val *s = &sdb->splits[mid];
+        if (shard_key_cmp(key, key_len, s->mv_data, s->mv_size) < 0) hi = mid;
+        else lo = mid + 1;
+    }
+    return lo;
+}
+
+static void put_u32(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Serialize the layout: magic, count, mode, then (len, bytes) per split */
+static unsigned char *layout_encode(const wtree3_sharded_db_t *sdb, size_t *out_len) {
+    size_t len = 12;
+    for (size_t i = 0; i + 1 < sdb->count && sdb->splits; i++) len += 4 + sdb->splits[i].mv_size;
+
+    unsigned char *buf = malloc(len);
+    if (!buf) return NULL;
+    put_u32(buf, SHARD_LAYOUT_MAGIC);
+    put_u32(buf + 4, (uint32_t)sdb->count);
+    put_u32(buf + 8, (uint32_t)sdb->mode);
+
+    unsigned char *p = buf + 12;
+    for (size_t i = 0; i + 1 < sdb->count && sdb->splits; i++) {
+        put_u32(p, (uint32_t)sdb->splits[i].mv_size);
+        memcpy(p + 4, sdb->splits[i].mv_data, sdb->splits[i].mv_size);
+        p += 4 + sdb->splits[i].mv_size;
+    }
+    *out_len = len;
+    return buf;
+}
+
+static void splits_free(MDB_val *splits, size_t n) {
+    if (!splits) return;
+    for (size_t i = 0; i < n; i++) free(splits[i].mv_data);
+    free(splits);
+}
+
+/* Copy n split points, checking they ascend strictly */
+static int splits_copy(const MDB_val *src, size_t n, MDB_val **out, gerror_t *error) {
+    MDB_val *splits = calloc(n ? n : 1, sizeof(MDB_val));
+    if (!splits) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate shard splits");
+        return WTREE3_ENOMEM;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (src[i].mv_size == 0 ||
+            (i > 0 && shard_key_cmp(src[i - 1].mv_data, src[i - 1].mv_size,
+                                    src[i].mv_data, src[i].mv_size) >= 0)) {
+            splits_free(splits, i);
+            set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                     "Shard split %zu is empty or not above the previous one", i);
+            return WTREE3_EINVAL;
+        }
+        splits[i].mv_data = malloc(src[i].mv_size);
+        if (!splits[i].mv_data) {
+            splits_free(splits, i);
+            set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate shard splits");
+            return WTREE3_ENOMEM;
+        }
+        memcpy(splits[i].mv_data, src[i].mv_data, src[i].mv_size);
+        splits[i].mv_size = src[i].mv_size;
+    }
+    *out = splits;
+    return WTREE3_OK;
+}
+
+/* Parse a stored layout into count/mode/splits */
+static int layout_decode(const unsigned char *buf, size_t len, size_t *count,
+                         wtree3_shard_mode_t *mode, MDB_val **splits, gerror_t *error) {
+    if (len < 12 || get_u32(buf) != SHARD_LAYOUT_MAGIC) goto corrupt;
+    *count = get_u32(buf + 4);
+    *mode = (wtree3_shard_mode_t)get_u32(buf + 8);
+    if (*count == 0 || *count > WTREE3_SHARDS_MAX ||
+        (*mode != WTREE3_SHARD_HASH && *mode != WTREE3_SHARD_RANGE)) goto corrupt;
+
+    *splits = NULL;
+    if (*mode != WTREE3_SHARD_RANGE) {
+        if (len != 12) goto corrupt;
+        return WTREE3_OK;
+    }
+
+    size_t n = *count - 1;
+    MDB_val *tmp = calloc(n ? n : 1, sizeof(MDB_val));
+    if (!tmp) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate shard splits");
+        return WTREE3_ENOMEM;
+    }
+    size_t off = 12;
+    for (size_t i = 0; i < n; i++) {
+        if (len - off < 4) { splits_free(tmp, i); goto corrupt; }
+        size_t sl = get_u32(buf + off);
+        off += 4;
+        if (len - off < sl) { splits_free(tmp, i); goto corrupt; }
+        tmp[i].mv_data = malloc(sl ? sl : 1);
+        if (!tmp[i].mv_data) {
+            splits_free(tmp, i);
+            set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate shard splits");
+            return WTREE3_ENOMEM;
+        }
+        memcpy(tmp[i].mv_data, buf + off, sl);
+        tmp[i].mv_size = sl;
+        off += sl;
+    }
+    *splits = tmp;
+    return WTREE3_OK;
+
+corrupt:
+    set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Shard layout record is corrupt");
+    return WTREE3_EINVAL;
+}
+
+/* Check the stored layout against the configured one, or store it */
+static int layout_sync(wtree3_sharded_db_t *sdb, bool from_store, gerror_t *error) {
+    wtree3_tree_t *meta = wtree3_tree_open(sdb->shards[0], SHARD_LAYOUT_TREE, 0, 0, error);
+    if (!meta) return error ? error->code : WTREE3_ERROR;
+
+    void *stored = NULL;
+    size_t stored_len = 0;
+    int rc = wtree3_get(meta, SHARD_LAYOUT_KEY, strlen(SHARD_LAYOUT_KEY), &stored, &stored_len, error);
+    if (rc == WTREE3_NOT_FOUND) {
+        if (from_store) {
+            set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                     "No shard layout stored in %s; give the shard count", sdb->path);
+            rc = WTREE3_EINVAL;
+        } else {
+            size_t len;
+            unsigned char *buf = layout_encode(sdb, &len);
+            if (!buf) {
+                set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to encode shard layout");
+                rc = WTREE3_ENOMEM;
+            } else {
+                rc = wtree3_insert_one(meta, SHARD_LAYOUT_KEY, strlen(SHARD_LAYOUT_KEY),
+                                       buf, len, error);
+                free(buf);
+            }
+        }
+        wtree3_tree_close(meta);
+        return rc;
+    }
+    wtree3_tree_close(meta);
+    if (rc != WTREE3_OK) return rc;
+
+    if (from_store) {
+        /* Shard 0 only so far: take the stored layout as it is */
+        size_t count;
+        wtree3_shard_mode_t mode;
+        MDB_val *splits;
+        rc = layout_decode(stored, stored_len, &count, &mode, &splits, error);
+        free(stored);
+        if (rc == WTREE3_OK) {
+            sdb->count = count;
+            sdb->mode = mode;
+            sdb->splits = splits;
+        }
+        return rc;
+    }
+
+    size_t len;
+    unsigned char *expect = layout_encode(sdb, &len);
+    if (!expect) {
+        free(stored);
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to encode shard layout");
+        return WTREE3_ENOMEM;
+    }
+    bool same = (len == stored_len && memcmp(expect, stored, len) == 0);
+    free(expect);
+    free(stored);
+    if (!same) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                 "Shard layout of %s differs from the stored one", sdb->path);
+        return WTREE3_EINVAL;
+    }
+    return WTREE3_OK;
+}
+
+/* ============================================================
+ * Database Lifecycle
+ * ============================================================ */
+
+/* Create (if needed) and open dir/shard-NNN */
+static wtree3_db_t *shard_open(const char *path, size_t i, const wtree3_shard_config_t *config,
+                               unsigned int max_dbs, gerror_t *error) {
+    char sub[SHARD_PATH_MAX];
+    int n = snprintf(sub, sizeof(sub), "%s/shard-%03zu", path, i);
+    if (n < 0 || (size_t)n >= sizeof(sub)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Shard path too long: %s", path);
+        return NULL;
+    }
+    (void)shard_mkdir(sub);
+    return wtree3_db_open(sub, config->mapsize, max_dbs, config->version, config->flags, error);
+}
+
+WTREE_COLD WTREE_WARN_UNUSED
+wtree3_sharded_db_t *wtree3_sharded_db_open(const char *path, const wtree3_shard_config_t *config,
+                                            gerror_t *error) {
+    if (WTREE_UNLIKELY(!path || !config)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Path and config cannot be NULL");
+        return NULL;
+    }
+    if (WTREE_UNLIKELY(config->shards > WTREE3_SHARDS_MAX ||
+                       (config->mode != WTREE3_SHARD_HASH && config->mode != WTREE3_SHARD_RANGE))) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                 "Shard count must be 1..%d and mode HASH or RANGE", WTREE3_SHARDS_MAX);
+        return NULL;
+    }
+    if (WTREE_UNLIKELY(config->shards > 1 && config->mode == WTREE3_SHARD_RANGE && !config->splits)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Range sharding needs shards - 1 split points");
+        return NULL;
+    }
+
+    wtree3_sharded_db_t *sdb = calloc(1, sizeof(*sdb));
+    if (WTREE_UNLIKELY(!sdb)) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate sharded database");
+        return NULL;
+    }
+    sdb->path = strdup(path);
+    if (WTREE_UNLIKELY(!sdb->path)) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate sharded database");
+        free(sdb);
+        return NULL;
+    }
+    (void)shard_mkdir(path);
+
+    /* Shard 0 first: it holds the layout (one extra named DB for it) */
+    bool from_store = (config->shards == 0);
+    wtree3_db_t *first = shard_open(path, 0, config, config->max_dbs + 1, error);
+    if (!first) goto fail;
+    sdb->count = from_store ? 1 : config->shards;
+    sdb->mode = config->mode;
+    sdb->shards = calloc(from_store ? 1 : sdb->count, sizeof(wtree3_db_t *));
+    if (!sdb->shards) {
+        wtree3_db_close(first);
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate shard table");
+        goto fail;
+    }
+    sdb->shards[0] = first;
+
+    if (!from_store && sdb->mode == WTREE3_SHARD_RANGE && sdb->count > 1) {
+        if (splits_copy(config->splits, sdb->count - 1, &sdb->splits, error) != WTREE3_OK) goto fail;
+    }
+    if (layout_sync(sdb, from_store, error) != WTREE3_OK) goto fail;
+
+    if (from_store && sdb->count > 1) {
+        wtree3_db_t **shards = realloc(sdb->shards, sdb->count * sizeof(wtree3_db_t *));
+        if (!shards) {
+            set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate shard table");
+            splits_free(sdb->splits, sdb->count - 1);
+            sdb->splits = NULL;
+            sdb->count = 1;
+            goto fail;
+        }
+        memset(shards + 1, 0, (sdb->count - 1) * sizeof(wtree3_db_t *));
+        sdb->shards = shards;
+    }
+
+    for (size_t i = 1; i < sdb->count; i++) {
+        sdb->shards[i] = shard_open(path, i, config, config->max_dbs, error);
+        if (!sdb->shards[i]) goto fail;
+    }
+    return sdb;
+
+fail:
+    wtree3_sharded_db_close(sdb);
+    return NULL;
+}
+
+WTREE_COLD
+void wtree3_sharded_db_close(wtree3_sharded_db_t *sdb) {
+    if (!sdb) return;
+    for (size_t i = 0; sdb->shards && i < sdb->count; i++) {
+        if (sdb->shards[i]) wtree3_db_close(sdb->shards[i]);
+    }
+    splits_free(sdb->splits, sdb->count ? sdb->count - 1 : 0);
+    free(sdb->shards);
+    free(sdb->path);
+    free(sdb);
+}
+
+size_t wtree3_sharded_db_count(const wtree3_sharded_db_t *sdb) {
+    return sdb ? sdb->count : 0;
+}
+
+wtree3_db_t *wtree3_sharded_db_shard(wtree3_sharded_db_t *sdb, size_t shard) {
+    if (!sdb || shard >= sdb->count) return NULL;
+    return sdb->shards[shard];
+}
+
+int wtree3_sharded_db_register_key_extractor(wtree3_sharded_db_t *sdb, uint32_t version,
+                                             uint32_t flags, wtree3_index_key_fn key_fn,
+                                             gerror_t *error) {
+    if (WTREE_UNLIKELY(!sdb)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Sharded database cannot be NULL");
+        return WTREE3_EINVAL;
+    }
+    for (size_t i = 0; i < sdb->count; i++) {
+        int rc = wtree3_db_register_key_extractor(sdb->shards[i], version, flags, key_fn, error);
+        if (rc != WTREE3_OK) return rc;
+    }
+    return WTREE3_OK;
+}
+
+/* ============================================================
+ * Routing
+ * ============================================================ */
+
+WTREE_HOT
+size_t wtree3_sharded_shard_of(const wtree3_sharded_db_t *sdb, const void *key, size_t key_len) {
+    if (WTREE_UNLIKELY(!sdb || sdb->count <= 1)) return 0;
+    if (sdb->mode == WTREE3_SHARD_RANGE) return shard_range_route(sdb, key, key_len);
+    return (size_t)(whash_u64(whash_bytes(key, key_len)) % sdb->count);
+}
+
+/* ============================================================
+ * Tree Lifecycle
+ * ============================================================ */
+
+WTREE_COLD WTREE_WARN_UNUSED
+wtree3_sharded_tree_t *wtree3_sharded_tree_open(wtree3_sharded_db_t *sdb, const char *name,
+                                                unsigned int flags, gerror_t *error) {
+    if (WTREE_UNLIKELY(!sdb || !name)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Sharded database and name cannot be NULL");
+        return NULL;
+    }
+    if (WTREE_UNLIKELY(strcmp(name, SHARD_LAYOUT_TREE) == 0)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Tree name '%s' is reserved", name);
+        return NULL;
+    }
+
+    wtree3_sharded_tree_t *st = calloc(1, sizeof(*st));
+    if (WTREE_UNLIKELY(!st)) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate sharded tree");
+        return NULL;
+    }
+    st->sdb = sdb;
+    st->name = strdup(name);
+    st->trees = calloc(sdb->count, sizeof(wtree3_tree_t *));
+    if (!st->name || !st->trees) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate sharded tree");
+        wtree3_sharded_tree_close(st);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < sdb->count; i++) {
+        st->trees[i] = wtree3_tree_open(sdb->shards[i], name, flags, 0, error);
+        if (!st->trees[i]) {
+            wtree3_sharded_tree_close(st);
+            return NULL;
+        }
+    }
+    return st;
+}
+
+WTREE_COLD
+void wtree3_sharded_tree_close(wtree3_sharded_tree_t *st) {
+    if (!st) return;
+    for (size_t i = 0; st->trees && i < st->sdb->count; i++) {
+        if (st->trees[i]) wtree3_tree_close(st->trees[i]);
+    }
+    free(st->trees);
+    free(st->name);
+    free(st);
+}
+
+wtree3_tree_t *wtree3_sharded_tree_shard(wtree3_sharded_tree_t *st, size_t shard) {
+    if (!st || shard >= st->sdb->count) return NULL;
+    return st->trees[shard];
+}
+
+int64_t wtree3_sharded_tree_count(wtree3_sharded_tree_t *st) {
+    if (!st) return 0;
+    int64_t total = 0;
+    for (size_t i = 0; i < st->sdb->count; i++) {
+        int64_t n = wtree3_tree_count(st->trees[i]);
+        if (WTREE_UNLIKELY(n < 0)) return -1;
+        total += n;
+    }
+    return total;
+}
+
+/* ============================================================
+ * Schema
+ * ============================================================ */
+
+int wtree3_sharded_tree_add_index(wtree3_sharded_tree_t *st, const wtree3_index_config_t *config,
+                                  gerror_t *error) {
+    if (WTREE_UNLIKELY(!st || !config)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Sharded tree and config cannot be NULL");
+        return WTREE3_EINVAL;
+    }
+    for (size_t i = 0; i < st->sdb->count; i++) {
+        int rc = wtree3_tree_add_index(st->trees[i], config, error);
+        if (rc != WTREE3_OK) {
+            /* Undo the shards that already have it */
+            gerror_t ignored = {.flags = GERROR_LAZY};
+            while (i-- > 0) (void)wtree3_tree_drop_index(st->trees[i], config->name, &ignored);
+            return rc;
+        }
+    }
+    return WTREE3_OK;
+}
+
+int wtree3_sharded_tree_populate_index(wtree3_sharded_tree_t *st, const char *index_name,
+                                       gerror_t *error) {
+    if (WTREE_UNLIKELY(!st || !index_name)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Sharded tree and index name cannot be NULL");
+        return WTREE3_EINVAL;
+    }
+    for (size_t i = 0; i < st->sdb->count; i++) {
+        int rc = wtree3_tree_populate_index(st->trees[i], index_name, error);
+        if (rc != WTREE3_OK) return rc;
+    }
+    return WTREE3_OK;
+}
+
+int wtree3_sharded_tree_drop_index(wtree3_sharded_tree_t *st, const char *index_name,
+                                   gerror_t *error) {
+    if (WTREE_UNLIKELY(!st || !index_name)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Sharded tree and index name cannot be NULL");
+        return WTREE3_EINVAL;
+    }
+    int first_rc = WTREE3_OK;
+    for (size_t i = 0; i < st->sdb->count; i++) {
+        int rc = wtree3_tree_drop_index(st->trees[i], index_name, error);
+        if (rc != WTREE3_OK && first_rc == WTREE3_OK) first_rc = rc;
+    }
+    return first_rc;
+}
+
+/* ============================================================
+ * Point Operations
+ * ============================================================ */
+
+#define SHARD_TREE(st, key, key_len) \
+    ((st)->trees[wtree3_sharded_shard_of((st)->sdb, (key), (key_len))])
+
+#define SHARD_CHECK(st, key, error) \
+    do { \
+        if (WTREE_UNLIKELY(!(st) || !(key))) { \
+            set_error((error), WTREE3_LIB, WTREE3_EINVAL, "Sharded tree and key cannot be NULL"); \
+            return WTREE3_EINVAL; \
+        } \
+    } while (0)
+
+WTREE_HOT
+int wtree3_sharded_get(wtree3_sharded_tree_t *st, const void *key, size_t key_len,
+                       void **value, size_t *value_len, gerror_t *error) {
+    SHARD_CHECK(st, key, error);
+    return wtree3_get(SHARD_TREE(st, key, key_len), key, key_len, value, value_len, error);
+}
+
+WTREE_HOT
+int wtree3_sharded_insert_one(wtree3_sharded_tree_t *st, const void *key, size_t key_len,
+                              const void *value, size_t value_len, gerror_t *error) {
+    SHARD_CHECK(st, key, error);
+    return wtree3_insert_one(SHARD_TREE(st, key, key_len), key, key_len, value, value_len, error);
+}
+
+WTREE_HOT
+int wtree3_sharded_update(wtree3_sharded_tree_t *st, const void *key, size_t key_len,
+                          const void *value, size_t value_len, gerror_t *error) {
+    SHARD_CHECK(st, key, error);
+    return wtree3_update(SHARD_TREE(st, key, key_len), key, key_len, value, value_len, error);
+}
+
+WTREE_HOT
+int wtree3_sharded_upsert(wtree3_sharded_tree_t *st, const void *key, size_t key_len,
+                          const void *value, size_t value_len, gerror_t *error) {
+    SHARD_CHECK(st, key, error);
+    return wtree3_upsert(SHARD_TREE(st, key, key_len), key, key_len, value, value_len, error);
+}
+
+WTREE_HOT
+int wtree3_sharded_delete_one(wtree3_sharded_tree_t *st, const void *key, size_t key_len,
+                              bool *deleted, gerror_t *error) {
+    SHARD_CHECK(st, key, error);
+    return wtree3_delete_one(SHARD_TREE(st, key, key_len), key, key_len, deleted, error);
+}
+
+WTREE_HOT
+bool wtree3_sharded_exists(wtree3_sharded_tree_t *st, const void *key, size_t key_len,
+                           gerror_t *error) {
+    if (WTREE_UNLIKELY(!st || !key)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Sharded tree and key cannot be NULL");
+        return false;
+    }
+    return wtree3_exists(SHARD_TREE(st, key, key_len), key, key_len, error);
+}
+
+/* ============================================================
+ * K-Way Merge
+ * ============================================================ */
+
+/* Order of two shard positions (a < b is negative) */
+static int merge_cmp(const shard_merge_t *m, size_t a, size_t b) {
+    const shard_cursor_t *x = &m->cur[a];
+    const shard_cursor_t *y = &m->cur[b];
+    if (!m->index) return mdb_cmp(x->txn->txn, x->tree->dbi, &x->key, &y->key);
+
+    int c = mdb_cmp(x->txn->txn, x->idx->dbi, &x->key, &y->key);
+    if (c != 0) return c;
+    c = mdb_cmp(x->txn->txn, x->tree->dbi, &x->main_key, &y->main_key);
+    return c != 0 ? c : (a < b ? -1 : (a > b ? 1 : 0));
+}
+
+static void heap_sift_down(shard_merge_t *m, size_t i) {
+    for (;;) {
+        size_t l = 2 * i + 1, r = l + 1, min = i;
+        if (l < m->heap_len && merge_cmp(m, m->heap[l], m->heap[min]) < 0) min = l;
+        if (r < m->heap_len && merge_cmp(m, m->heap[r], m->heap[min]) < 0) min = r;
+        if (min == i) return;
+        size_t t = m->heap[i];
+        m->heap[i] = m->heap[min];
+        m->heap[min] = t;
+        i = min;
+    }
+}
+
+/* Check a freshly positioned cursor: 1 entry in range, 0 done, < 0 error */
+static int merge_accept(shard_merge_t *m, shard_cursor_t *c, int mrc, gerror_t *error) {
+    if (mrc == MDB_NOTFOUND) return 0;
+    if (mrc != 0) return translate_mdb_error(mrc, error);
+
+    if (m->end.mv_data) {
+        MDB_dbi dbi = m->index ? c->idx->dbi : c->tree->dbi;
+        if (mdb_cmp(c->txn->txn, dbi, &c->key, &m->end) > 0) return 0;
+    }
+    if (m->index && !index_dup_split(c->idx->project_fn != NULL, &c->val, &c->main_key, NULL)) {
+        set_error(error, WTREE3_LIB, WTREE3_INDEX_ERROR,
+                 "Index '%s': malformed covering entry", c->idx->name);
+        return WTREE3_INDEX_ERROR;
+    }
+    return 1;
+}
+
+static void merge_close(shard_merge_t *m, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        shard_cursor_t *c = &m->cur[i];
+        if (c->cursor) mdb_cursor_close(c->cursor);
+        if (c->idx) index_set_unpin(&c->pin);
+        if (c->txn) wtree3_txn_abort(c->txn);
+    }
+    free(m->cur);
+    free(m->heap);
+}
+
+/*
+ * Open a read txn and cursor on shards [lo, hi] of st, position each at
+ * start and heap the ones with an entry in range
+ */
+static int merge_open(shard_merge_t *m, wtree3_sharded_tree_t *st, size_t lo, size_t hi,
+                      const char *index_name, const void *start_key, size_t start_len,
+                      const void *end_key, size_t end_len, gerror_t *error) {
+    size_t n = hi - lo + 1;
+    memset(m, 0, sizeof(*m));
+    m->index = (index_name != NULL);
+    m->end.mv_data = (void *)end_key;
+    m->end.mv_size = end_key ? end_len : 0;
+    m->cur = calloc(n, sizeof(shard_cursor_t));
+    m->heap = calloc(n, sizeof(size_t));
+    if (!m->cur || !m->heap) {
+        free(m->cur);
+        free(m->heap);
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate shard merge");
+        return WTREE3_ENOMEM;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        shard_cursor_t *c = &m->cur[i];
+        c->tree = st->trees[lo + i];
+        c->txn = wtree3_txn_begin(c->tree->db, false, error);
+        if (!c->txn) {
+            merge_close(m, i + 1);
+            return error ? error->code : WTREE3_ERROR;
+        }
+
+        MDB_dbi dbi = c->tree->dbi;
+        if (m->index) {
+            const index_set_t *set = index_set_pin(c->tree, &c->pin);
+            c->idx = index_set_find(set, index_name);
+            if (!c->idx || c->idx->building) {
+                index_set_unpin(&c->pin);
+                bool missing = (c->idx == NULL);
+                c->idx = NULL;
+                merge_close(m, i + 1);
+                set_error(error, WTREE3_LIB, WTREE3_NOT_FOUND,
+                         missing ? "Index '%s' not found on a shard"
+                                 : "Index '%s' is still being built on a shard", index_name);
+                return WTREE3_NOT_FOUND;
+            }
+            dbi = c->idx->dbi;
+        }
+
+        int mrc = mdb_cursor_open(c->txn->txn, dbi, &c->cursor);
+        if (mrc != 0) {
+            merge_close(m, i + 1);
+            return translate_mdb_error(mrc, error);
+        }
+        if (start_key) {
+            c->key.mv_data = (void *)start_key;
+            c->key.mv_size = start_len;
+            mrc = mdb_cursor_get(c->cursor, &c->key, &c->val, MDB_SET_RANGE);
+        } else {
+            mrc = mdb_cursor_get(c->cursor, &c->key, &c->val, MDB_FIRST);
+        }
+        int rc = merge_accept(m, c, mrc, error);
+        if (rc < 0) {
+            merge_close(m, n);
+            return rc;
+        }
+        if (rc > 0) m->heap[m->heap_len++] = i;
+    }
+
+    for (size_t i = m->heap_len / 2; i-- > 0; ) heap_sift_down(m, i);
+    return WTREE3_OK;
+}
+
+/* Step the head shard's cursor and restore the heap */
+static int merge_advance(shard_merge_t *m, gerror_t *error) {
+    shard_cursor_t *c = &m->cur[m->heap[0]];
+    int rc = merge_accept(m, c, mdb_cursor_get(c->cursor, &c->key, &c->val, MDB_NEXT), error);
+    if (rc < 0) return rc;
+    if (rc == 0) m->heap[0] = m->heap[--m->heap_len];
+    if (m->heap_len > 0) heap_sift_down(m, 0);
+    return WTREE3_OK;
+}
+
+/* Whether a shard's tree orders keys the way the splits do (bytewise) */
+static bool shard_tree_bytewise(const wtree3_tree_t *tree) {
+    return !(tree->flags & (MDB_INTEGERKEY | MDB_REVERSEKEY)) && !tree->custom_compare;
+}
+
+/*
+ * Shards a [start, end] scan has to visit. Splits are bytewise, so a
+ * tree with any other key order (integer or reverse keys, a custom
+ * comparator) does not keep its shards' ranges contiguous: every shard
+ * takes part, and the merge restores the tree's order.
+ */
+static void shard_span(const wtree3_sharded_tree_t *st, const void *start_key, size_t start_len,
+                       const void *end_key, size_t end_len, size_t *lo, size_t *hi) {
+    const wtree3_sharded_db_t *sdb = st->sdb;
+    *lo = 0;
+    *hi = sdb->count - 1;
+    if (sdb->mode != WTREE3_SHARD_RANGE) return;
+    for (size_t i = 0; i < sdb->count; i++) {
+        if (!shard_tree_bytewise(st->trees[i])) return;
+    }
+    if (start_key) *lo = shard_range_route(sdb, start_key, start_len);
+    if (end_key) *hi = shard_range_route(sdb, end_key, end_len);
+}
+
+/* ============================================================
+ * Scans
+ * ============================================================ */
+
+int wtree3_sharded_scan_range(wtree3_sharded_tree_t *st,
+                              const void *start_key, size_t start_len,
+                              const void *end_key, size_t end_len,
+                              wtree3_scan_fn scan_fn, void *user_data,
+                              gerror_t *error) {
+    if (WTREE_UNLIKELY(!st || !scan_fn)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Sharded tree and callback cannot be NULL");
+        return WTREE3_EINVAL;
+    }
+
+    size_t lo, hi;
+    shard_span(st, start_key, start_len, end_key, end_len, &lo, &hi);
+    if (lo > hi) return WTREE3_OK;
+
+    shard_merge_t m;
+    int rc = merge_open(&m, st, lo, hi, NULL, start_key, start_len, end_key, end_len, error);
+    if (rc != WTREE3_OK) return rc;
+
+    while (m.heap_len > 0) {
+        shard_cursor_t *c = &m.cur[m.heap[0]];
+        MDB_val val = c->val;
+        rc = tree_value_decode_txn(c->tree, c->txn, &val);
+        if (rc != 0) {
+            set_error(error, WTREE3_LIB, rc, "Failed to decode value");
+            break;
+        }
+        if (!scan_fn(c->key.mv_data, c->key.mv_size, val.mv_data, val.mv_size, user_data)) break;
+        rc = merge_advance(&m, error);
+        if (rc != WTREE3_OK) break;
+    }
+
+    merge_close(&m, hi - lo + 1);
+    return rc;
+}
+
+int wtree3_sharded_index_scan(wtree3_sharded_tree_t *st, const char *index_name,
+                              const void *start_key, size_t start_len,
+                              const void *end_key, size_t end_len,
+                              wtree3_scan_fn scan_fn, void *user_data,
+                              gerror_t *error) {
+    if (WTREE_UNLIKELY(!st || !index_name || !scan_fn)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL,
+                 "Sharded tree, index name and callback cannot be NULL");
+        return WTREE3_EINVAL;
+    }
+
+    /* Index keys say nothing about placement: every shard takes part */
+    shard_merge_t m;
+    int rc = merge_open(&m, st, 0, st->sdb->count - 1, index_name,
+                        start_key, start_len, end_key, end_len, error);
+    if (rc != WTREE3_OK) return rc;
+
+    while (m.heap_len > 0) {
+        shard_cursor_t *c = &m.cur[m.heap[0]];
+        MDB_val mk = c->main_key;
+        MDB_val val;
+        int mrc = mdb_get(c->txn->txn, c->tree->dbi, &mk, &val);
+        if (mrc == 0) {
+            rc = tree_value_decode_txn(c->tree, c->txn, &val);
+            if (rc != 0) {
+                set_error(error, WTREE3_LIB, rc, "Failed to decode value");
+                break;
+            }
+            if (!scan_fn(mk.mv_data, mk.mv_size, val.mv_data, val.mv_size, user_data)) break;
+        } else if (mrc != MDB_NOTFOUND) {
+            rc = translate_mdb_error(mrc, error);
+            break;
+        }
+        rc = merge_advance(&m, error);
+        if (rc != WTREE3_OK) break;
+    }
+
+    merge_close(&m, st->sdb->count);
+    return rc;
+}
+
+/* ============================================================
+ * Parallel Scan
+ * ============================================================ */
+
+typedef struct {
+    wtree3_tree_t *tree;
+    const void *start_key;
+    size_t start_len;
+    const void *end_key;
+    size_t end_len;
+    wtree3_scan_fn scan_fn;
+    void *user_data;
+    uint32_t *stop;                 /* Shared: set once any callback returns false */
+    int rc;
+    gerror_t error;
+} shard_scan_job_t;
+
+static bool shard_scan_entry(const void *key, size_t key_len, const void *value,
+                             size_t value_len, void *user_data) {
+    shard_scan_job_t *job = (shard_scan_job_t *)user_data;
+    if (watomic_load_u32(job->stop)) return false;
+    if (!job->scan_fn(key, key_len, value, value_len, job->user_data)) {
+        watomic_store_u32(job->stop, 1);
+        return false;
+    }
+    return true;
+}
+
+static void *shard_scan_thread(void *arg) {
+    shard_scan_job_t *job = (shard_scan_job_t *)arg;
+    wtree3_txn_t *txn = wtree3_txn_begin(job->tree->db, false, &job->error);
+    if (!txn) {
+        job->rc = job->error.code ? job->error.code : WTREE3_ERROR;
+        return NULL;
+    }
+    job->rc = wtree3_scan_range_txn(txn, job->tree, job->start_key, job->start_len,
+                                    job->end_key, job->end_len,
+                                    shard_scan_entry, job, &job->error);
+    wtree3_txn_abort(txn);
+    return NULL;
+}
+
+int wtree3_sharded_scan_parallel(wtree3_sharded_tree_t *st,
+                                 const void *start_key, size_t start_len,
+                                 const void *end_key, size_t end_len,
+                                 wtree3_scan_fn scan_fn, void *user_data,
+                                 gerror_t *error) {
+    if (WTREE_UNLIKELY(!st || !scan_fn)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Sharded tree and callback cannot be NULL");
+        return WTREE3_EINVAL;
+    }
+
+    size_t lo, hi;
+    shard_span(st, start_key, start_len, end_key, end_len, &lo, &hi);
+    if (lo > hi) return WTREE3_OK;
+    size_t n = hi - lo + 1;
+
+    shard_scan_job_t *jobs = calloc(n, sizeof(shard_scan_job_t));
+    wthread_t *threads = calloc(n, sizeof(wthread_t));
+    bool *started = calloc(n, sizeof(bool));
+    if (!jobs || !threads || !started) {
+        free(jobs);
+        free(threads);
+        free(started);
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate shard scan");
+        return WTREE3_ENOMEM;
+    }
+
+    uint32_t stop = 0;
+    for (size_t i = 0; i < n; i++) {
+        jobs[i] = (shard_scan_job_t){
+            .tree = st->trees[lo + i],
+            .start_key = start_key, .start_len = start_len,
+            .end_key = end_key, .end_len = end_len,
+            .scan_fn = scan_fn, .user_data = user_data,
+            .stop = &stop,
+        };
+        started[i] = (wthread_create(&threads[i], shard_scan_thread, &jobs[i]) == 0);
+        if (!started[i]) shard_scan_thread(&jobs[i]);     /* Run it here instead */
+    }
+
+    int rc = WTREE3_OK;
+    for (size_t i = 0; i < n; i++) {
+        if (started[i]) wthread_join(threads[i], NULL);
+        if (jobs[i].rc != WTREE3_OK && rc == WTREE3_OK) {
+            rc = jobs[i].rc;
+            error_copy(error, &jobs[i].error);
+        }
+    }
+
+    free(jobs);
+    free(threads);
+    free(started);
+    return rc;
+}
@@ -0,0 +1,758 @@
+/*
+ * wtree3_snapshot.c - Streaming Tree Snapshots
+ *
+ * A snapshot is a self-describing stream of one tree: its records in the
+ * metadata DBI (index definitions, codec, filter and stats records), its
+ * rows and the entries of its index DBIs, all in key order. Export reads a
+ * single MVCC snapshot, so writers keep going; import appends into a new
+ * tree with MDB_APPEND and loads index DBIs as they were instead of
+ * running the extractors again.
+ *
+ * Stream layout (integers little-endian):
+ *   header  [magic:8][format:4][flags:4][tree_flags:4][txn_id:8]
+ *           [name_len:4][name]
+ *   then sections, each [type:1] ...
+ *     'M'   metadata records, as blocks
+ *     'D'   main tree rows, as blocks
+ *     'I'   [name_len:4][name][dbi_flags:4][covering:1][has_data:1],
+ *           then blocks when has_data
+ *     'E'   [records:8]   end of stream: records in all blocks
+ *   block   [raw_len:4][stored_len:4][checksum:8][payload]
+ *           raw_len 0 ends a section. The payload is a run of records
+ *           [key_len:4][val_len:4][key][val], framed by a dictionary-less
+ *           codec when the stream is compressed. The checksum (whash_bytes)
+ *           covers the payload as stored.
+ *
+ * Metadata keys travel without the tree name (owner prefix, then the part
+ * from the ':' on), so a snapshot can be imported under another name.
+ * Values are exported as stored: a compressed tree stays compressed and
+ * brings its codec record along.
+ *
+ * This module provides:
+ * - Export: tree_export_txn, tree_export
+ * - Import: tree_import
+ */
+
+#include "wtree3_internal.h"
+#include "macros.h"
+
+/* ============================================================
+ * Constants
+ * ============================================================ */
+
+#define SNAPSHOT_MAGIC          "WT3SNAP"       /* 8 bytes with the NUL */
+#define SNAPSHOT_MAGIC_SIZE     8
+#define SNAPSHOT_FORMAT         1
+#define SNAPSHOT_HEADER_SIZE    32              /* Up to and including name_len */
+#define SNAPSHOT_BLOCK_SIZE     (64 * 1024)     /* Raw bytes per block (one record may exceed it) */
+#define SNAPSHOT_MAX_BLOCK      (1u << 30)
+#define SNAPSHOT_BLOCK_HDR      16
+#define SNAPSHOT_RECORD_HDR     8
+#define SNAPSHOT_MAX_NAME       4096
+#define SNAPSHOT_STREAM_FLAGS   (WTREE3_SNAPSHOT_COMPRESS | WTREE3_SNAPSHOT_NO_INDEXES)
+
+/* DBI flags a snapshot recreates */
+#define SNAPSHOT_DBI_FLAGS      (MDB_REVERSEKEY | MDB_DUPSORT | MDB_INTEGERKEY | \
+                                 MDB_DUPFIXED | MDB_INTEGERDUP | MDB_REVERSEDUP)
+
+#define SECTION_META            'M'
+#define SECTION_DATA            'D'
+#define SECTION_INDEX           'I'
+#define SECTION_END             'E'
+
+/* Owner prefixes of a tree's metadata records ("" = index definitions) */
+static const char *const snapshot_meta_prefixes[] = {
+    "", WTREE3_STATS_PREFIX, WTREE3_FILTER_PREFIX, WTREE3_CODEC_PREFIX
+};
+
+/* ============================================================
+ * Internal Structures
+ * ============================================================ */
+
+typedef struct {
+    wtree3_snapshot_write_fn write_fn;
+    void *user_data;
+    wtree3_codec_t *codec;          /* NULL = blocks stored raw */
+    unsigned char *block;           /* Records of the open block */
+    size_t used;
+    size_t cap;
+    codec_buf_t frame;
+    uint64_t records;
+    gerror_t *error;
+} snap_writer_t;
+
+typedef struct {
+    wtree3_snapshot_read_fn read_fn;
+    void *user_data;
+    wtree3_codec_t *codec;          /* NULL = blocks stored raw */
+    unsigned char *stored;          /* Payload as read */
+    size_t stored_cap;
+    codec_buf_t raw;
+    const unsigned char *p;         /* Records left in the current block */
+    const unsigned char *end;
+    uint64_t records;
+    gerror_t *error;
+} snap_reader_t;
+
+/* ============================================================
+ * Encoding Helpers
+ * ============================================================ */
+
+static inline void put_u32(unsigned char *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static inline void put_u64(unsigned char *p, uint64_t v) {
+    for (int i = 0; i < 8; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static inline uint32_t get_u32(const unsigned char *p) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++) v |= (uint32_t)p[i] << (8 * i);
+    return v;
+}
+
+static inline uint64_t get_u64(const unsigned char *p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) v |= (uint64_t)p[i] << (8 * i);
+    return v;
+}
+
+/* Owner prefix length if key is prefix + tree_name + ":" + rest */
+static bool meta_key_owned(const MDB_val *key, const char *tree_name, size_t *prefix_len) {
+    size_t name_len = strlen(tree_name);
+    const char *k = (const char *)key->mv_data;
+    for (size_t i = 0; i < sizeof(snapshot_meta_prefixes) / sizeof(snapshot_meta_prefixes[0]); i++) {
+        size_t plen = strlen(snapshot_meta_prefixes[i]);
+        if (key->mv_size > plen + name_len &&
+            memcmp(k, snapshot_meta_prefixes[i], plen) == 0 &&
+            memcmp(k + plen, tree_name, name_len) == 0 &&
+            k[plen + name_len] == ':') {
+            *prefix_len = plen;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Whether the handle loaded an index of this name (not NUL-terminated) */
+static bool tree_has_index(wtree3_tree_t *tree, const char *name, size_t len) {
+    index_pin_t pin;
+    const index_set_t *set = index_set_pin(tree, &pin);
+    bool found = false;
+    for (size_t i = 0; i < set->count && !found; i++) {
+        const wtree3_index_t *idx = set->items[i];
+        found = strlen(idx->name) == len && memcmp(idx->name, name, len) == 0;
+    }
+    index_set_unpin(&pin);
+    return found;
+}
+
+/* ============================================================
+ * Writer
+ * ============================================================ */
+
+static int snap_emit(snap_writer_t *w, const void *data, size_t len) {
+    if (len && WTREE_UNLIKELY(w->write_fn(data, len, w->user_data) != 0)) {
+        set_error(w->error, WTREE3_LIB, WTREE3_ERROR, "Snapshot write failed");
+        return WTREE3_ERROR;
+    }
+    return WTREE3_OK;
+}
+
+/* Write out the open block, if it holds anything */
+static int snap_flush(snap_writer_t *w) {
+    if (w->used == 0) return WTREE3_OK;
+
+    MDB_val payload = {.mv_size = w->used, .mv_data = w->block};
+    if (w->codec && WTREE_UNLIKELY(codec_encode(w->codec, w->block, w->used, &w->frame, &payload) != 0)) {
+        set_error(w->error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to compress snapshot block");
+        return WTREE3_ENOMEM;
+    }
+
+    unsigned char hdr[SNAPSHOT_BLOCK_HDR];
+    put_u32(hdr, (uint32_t)w->used);
+    put_u32(hdr + 4, (uint32_t)payload.mv_size);
+    put_u64(hdr + 8, whash_bytes(payload.mv_data, payload.mv_size));
+    w->used = 0;
+
+    int rc = snap_emit(w, hdr, sizeof(hdr));
+    return rc != WTREE3_OK ? rc : snap_emit(w, payload.mv_data, payload.mv_size);
+}
+
+/* Append a record of key (split in two parts) and val to the open block */
+static int snap_record(snap_writer_t *w, const void *k1, size_t k1_len,
+                       const void *k2, size_t k2_len, const MDB_val *val) {
+    size_t key_len = k1_len + k2_len;
+    size_t need = SNAPSHOT_RECORD_HDR + key_len + val->mv_size;
+    if (WTREE_UNLIKELY(need > SNAPSHOT_MAX_BLOCK)) {
+        set_error(w->error, WTREE3_LIB, WTREE3_EINVAL, "Entry too large for a snapshot block");
+        return WTREE3_EINVAL;
+    }
+
+    if (w->used && w->used + need > SNAPSHOT_BLOCK_SIZE) {
+        int rc = snap_flush(w);
+        if (WTREE_UNLIKELY(rc != WTREE3_OK)) return rc;
+    }
+    if (w->cap - w->used < need) {
+        size_t cap = w->used + need > SNAPSHOT_BLOCK_SIZE ? w->used + need : SNAPSHOT_BLOCK_SIZE;
+        unsigned char *grown = realloc(w->block, cap);
+        if (WTREE_UNLIKELY(!grown)) {
+            set_error(w->error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate snapshot block");
+            return WTREE3_ENOMEM;
+        }
+        w->block = grown;
+        w->cap = cap;
+    }
+
+    unsigned char *p = w->block + w->used;
+    put_u32(p, (uint32_t)key_len);
+    put_u32(p + 4, (uint32_t)val->mv_size);
+    p += SNAPSHOT_RECORD_HDR;
+    if (k1_len) memcpy(p, k1, k1_len);
+    if (k2_len) memcpy(p + k1_len, k2, k2_len);
+    if (val->mv_size) memcpy(p + key_len, val->mv_data, val->mv_size);
+    w->used += need;
+    w->records++;
+    return WTREE3_OK;
+}
+
+/* Flush and close the current section */
+static int snap_end_section(snap_writer_t *w) {
+    int rc = snap_flush(w);
+    if (WTREE_UNLIKELY(rc != WTREE3_OK)) return rc;
+    unsigned char hdr[SNAPSHOT_BLOCK_HDR] = {0};
+    return snap_emit(w, hdr, sizeof(hdr));
+}
+
+/* Every entry of dbi (dups included), in order */
+static int export_dbi(snap_writer_t *w, MDB_txn *txn, MDB_dbi dbi) {
+    MDB_cursor *cursor;
+    int rc = mdb_cursor_open(txn, dbi, &cursor);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, w->error);
+
+    MDB_val key, val;
+    int status = WTREE3_OK;
+    rc = mdb_cursor_get(cursor, &key, &val, MDB_FIRST);
+    while (rc == 0) {
+        status = snap_record(w, key.mv_data, key.mv_size, NULL, 0, &val);
+        if (WTREE_UNLIKELY(status != WTREE3_OK)) break;
+        rc = mdb_cursor_get(cursor, &key, &val, MDB_NEXT);
+    }
+    mdb_cursor_close(cursor);
+
+    if (status != WTREE3_OK) return status;
+    if (WTREE_UNLIKELY(rc != MDB_NOTFOUND)) return translate_mdb_error(rc, w->error);
+    return snap_end_section(w);
+}
+
+/* The tree's metadata records, tree name cut out of the keys */
+static int export_metadata(snap_writer_t *w, MDB_txn *txn, wtree3_tree_t *tree) {
+    unsigned char type = SECTION_META;
+    int rc = snap_emit(w, &type, 1);
+    if (WTREE_UNLIKELY(rc != WTREE3_OK)) return rc;
+
+    MDB_dbi meta_dbi;
+    rc = mdb_dbi_open(txn, WTREE3_META_DB, 0, &meta_dbi);
+    if (rc == MDB_NOTFOUND) return snap_end_section(w);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, w->error);
+
+    MDB_cursor *cursor;
+    rc = mdb_cursor_open(txn, meta_dbi, &cursor);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, w->error);
+
+    size_t name_len = strlen(tree->name);
+    MDB_val key, val;
+    int status = WTREE3_OK;
+    rc = mdb_cursor_get(cursor, &key, &val, MDB_FIRST);
+    while (rc == 0) {
+        size_t plen;
+        if (meta_key_owned(&key, tree->name, &plen)) {
+            const char *k = (const char *)key.mv_data;
+            const char *rest = k + plen + name_len;     /* From the ':' on */
+            size_t rest_len = key.mv_size - plen - name_len;
+
+            /* Index definitions only for indexes that travel with their DBI */
+            if (plen != 0 || tree_has_index(tree, rest + 1, rest_len - 1)) {
+                status = snap_record(w, k, plen, rest, rest_len, &val);
+                if (WTREE_UNLIKELY(status != WTREE3_OK)) break;
+            }
+        }
+        rc = mdb_cursor_get(cursor, &key, &val, MDB_NEXT);
+    }
+    mdb_cursor_close(cursor);
+
+    if (status != WTREE3_OK) return status;
+    if (WTREE_UNLIKELY(rc != MDB_NOTFOUND)) return translate_mdb_error(rc, w->error);
+    return snap_end_section(w);
+}
+
+static int export_index(snap_writer_t *w, MDB_txn *txn, wtree3_index_t *idx, bool with_data) {
+    unsigned int dbi_flags = 0;
+    int rc = mdb_dbi_flags(txn, idx->dbi, &dbi_flags);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, w->error);
+
+    size_t name_len = strlen(idx->name);
+    unsigned char hdr[1 + 4 + 4 + 1 + 1];
+    hdr[0] = SECTION_INDEX;
+    put_u32(hdr + 1, (uint32_t)name_len);
+    rc = snap_emit(w, hdr, 5);
+    if (rc == WTREE3_OK) rc = snap_emit(w, idx->name, name_len);
+    if (WTREE_UNLIKELY(rc != WTREE3_OK)) return rc;
+
+    put_u32(hdr, dbi_flags & SNAPSHOT_DBI_FLAGS);
+    hdr[4] = idx->project_fn != NULL;
+    hdr[5] = with_data;
+    rc = snap_emit(w, hdr, 6);
+    if (WTREE_UNLIKELY(rc != WTREE3_OK)) return rc;
+
+    return with_data ? export_dbi(w, txn, idx->dbi) : WTREE3_OK;
+}
+
+/* ============================================================
+ * Reader
+ * ============================================================ */
+
+static int snap_corrupt(snap_reader_t *r, const char *what) {
+    set_error(r->error, WTREE3_LIB, WTREE3_ERROR, "Corrupt snapshot: %s", what);
+    return WTREE3_ERROR;
+}
+
+static int snap_read(snap_reader_t *r, void *buf, size_t len) {
+    if (len && WTREE_UNLIKELY(r->read_fn(buf, len, r->user_data) != 0)) {
+        return snap_corrupt(r, "truncated stream");
+    }
+    return WTREE3_OK;
+}
+
+/* Read, check and decode the next block; *raw_len 0 = end of section */
+static int snap_block(snap_reader_t *r, size_t *raw_len) {
+    unsigned char hdr[SNAPSHOT_BLOCK_HDR];
+    int rc = snap_read(r, hdr, sizeof(hdr));
+    if (WTREE_UNLIKELY(rc != WTREE3_OK)) return rc;
+
+    size_t raw = get_u32(hdr);
+    size_t stored = get_u32(hdr + 4);
+    *raw_len = raw;
+    if (raw == 0) return WTREE3_OK;
+    if (WTREE_UNLIKELY(raw > SNAPSHOT_MAX_BLOCK || stored > SNAPSHOT_MAX_BLOCK + 16)) {
+        return snap_corrupt(r, "oversized block");
+    }
+
+    if (r->stored_cap < stored) {
+        unsigned char *grown = realloc(r->stored, stored);
+        if (WTREE_UNLIKELY(!grown)) {
+            set_error(r->error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate snapshot block");
+            return WTREE3_ENOMEM;
+        }
+        r->stored = grown;
+        r->stored_cap = stored;
+    }
+    rc = snap_read(r, r->stored, stored);
+    if (WTREE_UNLIKELY(rc != WTREE3_OK)) return rc;
+    if (WTREE_UNLIKELY(whash_bytes(r->stored, stored) != get_u64(hdr + 8))) {
+        return snap_corrupt(r, "block checksum mismatch");
+    }
+
+    MDB_val payload = {.mv_size = stored, .mv_data = r->stored};
+    if (r->codec && WTREE_UNLIKELY(codec_decode(r->codec, &payload, &r->raw) != 0)) {
+        return snap_corrupt(r, "bad compressed block");
+    }
+    if (WTREE_UNLIKELY(payload.mv_size != raw)) return snap_corrupt(r, "block length mismatch");
+
+    r->p = (const unsigned char *)payload.mv_data;
+    r->end = r->p + raw;
+    return WTREE3_OK;
+}
+
+/* Next record of the current section; WTREE3_NOT_FOUND once it ends */
+static int snap_next(snap_reader_t *r, MDB_val *key, MDB_val *val) {
+    if (r->p == r->end) {
+        size_t raw_len;
+        int rc = snap_block(r, &raw_len);
+        if (WTREE_UNLIKELY(rc != WTREE3_OK)) return rc;
+        if (raw_len == 0) return WTREE3_NOT_FOUND;
+    }
+
+    size_t left = (size_t)(r->end - r->p);
+    if (WTREE_UNLIKELY(left < SNAPSHOT_RECORD_HDR)) return snap_corrupt(r, "short record");
+    size_t key_len = get_u32(r->p);
+    size_t val_len = get_u32(r->p + 4);
+    if (WTREE_UNLIKELY(key_len + val_len > left - SNAPSHOT_RECORD_HDR)) {
+        return snap_corrupt(r, "record overruns its block");
+    }
+
+    key->mv_size = key_len;
+    key->mv_data = (void *)(r->p + SNAPSHOT_RECORD_HDR);
+    val->mv_size = val_len;
+    val->mv_data = (void *)(r->p + SNAPSHOT_RECORD_HDR + key_len);
+    r->p += SNAPSHOT_RECORD_HDR + key_len + val_len;
+    r->records++;
+    return WTREE3_OK;
+}
+
+/* Read a [len:4][bytes] name into a fresh string */
+static int snap_name(snap_reader_t *r, char **out) {
+    unsigned char len_buf[4];
+    int rc = snap_read(r, len_buf, sizeof(len_buf));
+    if (WTREE_UNLIKELY(rc != WTREE3_OK)) return rc;
+
+    size_t len = get_u32(len_buf);
+    if (WTREE_UNLIKELY(len == 0 || len > SNAPSHOT_MAX_NAME)) return snap_corrupt(r, "bad name");
+    char *name = malloc(len + 1);
+    if (WTREE_UNLIKELY(!name)) {
+        set_error(r->error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate name");
+        return WTREE3_ENOMEM;
+    }
+    rc = snap_read(r, name, len);
+    if (WTREE_UNLIKELY(rc != WTREE3_OK)) {
+        free(name);
+        return rc;
+    }
+    name[len] = '\0';
+    *out = name;
+    return WTREE3_OK;
+}
+
+/* ============================================================
+ * Import
+ * ============================================================ */
+
+/* Indexes to rebuild once the tree is open */
+typedef struct {
+    char **names;
+    size_t count;
+} rebuild_list_t;
+
+/*
+ * Append in stream order. MDB_APPEND needs that order to match the target
+ * comparator; when it does not (comparators are not persisted), fall back
+ * to an ordinary insert.
+ */
+static int import_dbi(snap_reader_t *r, MDB_txn *txn, MDB_dbi dbi, bool dups, bool apply) {
+    MDB_cursor *cursor = NULL;
+    if (apply) {
+        int rc = mdb_cursor_open(txn, dbi, &cursor);
+        if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, r->error);
+    }
+
+    unsigned int append = dups ? MDB_APPENDDUP : MDB_APPEND;
+    unsigned int plain = dups ? MDB_NODUPDATA : MDB_NOOVERWRITE;
+    MDB_val key, val;
+    int status;
+    while ((status = snap_next(r, &key, &val)) == WTREE3_OK) {
+        if (!cursor) continue;      /* Skipping the section */
+
+        int rc = mdb_cursor_put(cursor, &key, &val, append);
+        if (rc == MDB_KEYEXIST) rc = mdb_cursor_put(cursor, &key, &val, plain);
+        if (WTREE_UNLIKELY(rc == MDB_KEYEXIST)) {
+            status = snap_corrupt(r, "duplicate entry");
+            break;
+        }
+        if (WTREE_UNLIKELY(rc != 0)) {
+            status = translate_mdb_error(rc, r->error);
+            break;
+        }
+    }
+    if (cursor) mdb_cursor_close(cursor);
+    return status == WTREE3_NOT_FOUND ? WTREE3_OK : status;
+}
+
+static int import_metadata(snap_reader_t *r, MDB_txn *txn, wtree3_db_t *db, const char *name) {
+    MDB_dbi meta_dbi;
+    int rc = get_metadata_dbi(db, txn, &meta_dbi, r->error);
+    if (WTREE_UNLIKELY(rc != WTREE3_OK)) return rc;
+
+    size_t name_len = strlen(name);
+    unsigned char *full = NULL;
+    size_t full_cap = 0;
+    MDB_val key, val;
+    int status;
+    while ((status = snap_next(r, &key, &val)) == WTREE3_OK) {
+        /* Owner prefixes start with \x01 and end at their first ':' */
+        const char *k = (const char *)key.mv_data;
+        size_t plen = 0;
+        if (key.mv_size && k[0] == '\x01') {
+            const char *colon = memchr(k, ':', key.mv_size);
+            plen = colon ? (size_t)(colon - k) + 1 : key.mv_size;
+        }
+        if (WTREE_UNLIKELY(plen >= key.mv_size || k[plen] != ':')) {
+            status = snap_corrupt(r, "bad metadata key");
+            break;
+        }
+
+        size_t full_len = key.mv_size + name_len;
+        if (full_cap < full_len) {
+            unsigned char *grown = realloc(full, full_len);
+            if (WTREE_UNLIKELY(!grown)) {
+                set_error(r->error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to build metadata key");
+                status = WTREE3_ENOMEM;
+                break;
+            }
+            full = grown;
+            full_cap = full_len;
+        }
+        memcpy(full, k, plen);
+        memcpy(full + plen, name, name_len);
+        memcpy(full + plen + name_len, k + plen, key.mv_size - plen);
+
+        MDB_val full_key = {.mv_size = full_len, .mv_data = full};
+        rc = mdb_put(txn, meta_dbi, &full_key, &val, 0);
+        if (WTREE_UNLIKELY(rc != 0)) {
+            status = translate_mdb_error(rc, r->error);
+            break;
+        }
+    }
+    free(full);
+    return status == WTREE3_NOT_FOUND ? WTREE3_OK : status;
+}
+
+static int import_index(snap_reader_t *r, MDB_txn *txn, const char *tree_name,
+                        unsigned int flags, rebuild_list_t *rebuild) {
+    char *index_name = NULL;
+    int rc = snap_name(r, &index_name);
+    if (WTREE_UNLIKELY(rc != WTREE3_OK)) return rc;
+
+    unsigned char hdr[6];
+    rc = snap_read(r, hdr, sizeof(hdr));
+    if (WTREE_UNLIKELY(rc != WTREE3_OK)) {
+        free(index_name);
+        return rc;
+    }
+    unsigned int dbi_flags = get_u32(hdr) & SNAPSHOT_DBI_FLAGS;
+    bool covering = hdr[4] != 0;
+    bool has_data = hdr[5] != 0;
+
+    char *idx_tree_name = build_index_tree_name(tree_name, index_name);
+    if (WTREE_UNLIKELY(!idx_tree_name)) {
+        free(index_name);
+        set_error(r->error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate tree name");
+        return WTREE3_ENOMEM;
+    }
+    MDB_dbi dbi;
+    int mrc = mdb_dbi_open(txn, idx_tree_name, MDB_CREATE | dbi_flags, &dbi);
+    free(idx_tree_name);
+    if (mrc == 0 && covering) mrc = mdb_set_dupsort(txn, dbi, index_covering_dcmp);
+    if (WTREE_UNLIKELY(mrc != 0)) {
+        free(index_name);
+        return translate_mdb_error(mrc, r->error);
+    }
+
+    bool load = has_data && !(flags & WTREE3_SNAPSHOT_REBUILD_INDEXES);
+    if (has_data) {
+        rc = import_dbi(r, txn, dbi, (dbi_flags & MDB_DUPSORT) != 0, load);
+        if (WTREE_UNLIKELY(rc != WTREE3_OK)) {
+            free(index_name);
+            return rc;
+        }
+    }
+    if (load) {
+        free(index_name);
+        return WTREE3_OK;
+    }
+
+    char **grown = realloc(rebuild->names, (rebuild->count + 1) * sizeof(char *));
+    if (WTREE_UNLIKELY(!grown)) {
+        free(index_name);
+        set_error(r->error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate rebuild list");
+        return WTREE3_ENOMEM;
+    }
+    rebuild->names = grown;
+    rebuild->names[rebuild->count++] = index_name;
+    return WTREE3_OK;
+}
+
+/* Everything up to the commit: tree, metadata, rows and index DBIs */
+static int import_txn(snap_reader_t *r, wtree3_txn_t *txn, const char *name,
+                      unsigned int tree_flags, unsigned int flags, rebuild_list_t *rebuild) {
+    MDB_dbi dbi;
+    int rc = mdb_dbi_open(txn->txn, name, 0, &dbi);
+    if (WTREE_UNLIKELY(rc == 0)) {
+        set_error(r->error, WTREE3_LIB, WTREE3_EINVAL, "Tree '%s' already exists", name);
+        return WTREE3_EINVAL;
+    }
+    if (WTREE_UNLIKELY(rc != MDB_NOTFOUND)) return translate_mdb_error(rc, r->error);
+    rc = mdb_dbi_open(txn->txn, name, MDB_CREATE | (tree_flags & SNAPSHOT_DBI_FLAGS), &dbi);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, r->error);
+
+    for (;;) {
+        unsigned char type;
+        int status = snap_read(r, &type, 1);
+        if (WTREE_UNLIKELY(status != WTREE3_OK)) return status;
+
+        switch (type) {
+            case SECTION_META:
+                status = import_metadata(r, txn->txn, txn->db, name);
+                break;
+            case SECTION_DATA:
+                status = import_dbi(r, txn->txn, dbi, (tree_flags & MDB_DUPSORT) != 0, true);
+                break;
+            case SECTION_INDEX:
+                status = import_index(r, txn->txn, name, flags, rebuild);
+                break;
+            case SECTION_END: {
+                unsigned char count[8];
+                status = snap_read(r, count, sizeof(count));
+                if (status == WTREE3_OK && get_u64(count) != r->records) {
+                    status = snap_corrupt(r, "record count mismatch");
+                }
+                return status;
+            }
+            default:
+                return snap_corrupt(r, "unknown section");
+        }
+        if (WTREE_UNLIKELY(status != WTREE3_OK)) return status;
+    }
+}
+
+WTREE_COLD
+wtree3_tree_t* wtree3_tree_import(wtree3_db_t *db, const char *name, unsigned int flags,
+                                  wtree3_snapshot_read_fn read_fn, void *user_data,
+                                  gerror_t *error) {
+    if (WTREE_UNLIKELY(!db || !read_fn)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return NULL;
+    }
+
+    snap_reader_t r = {.read_fn = read_fn, .user_data = user_data, .error = error};
+    unsigned char hdr[SNAPSHOT_HEADER_SIZE];
+    if (snap_read(&r, hdr, SNAPSHOT_MAGIC_SIZE) != WTREE3_OK) return NULL;
+    if (WTREE_UNLIKELY(memcmp(hdr, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_SIZE) != 0)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Not a wtree3 snapshot");
+        return NULL;
+    }
+    if (snap_read(&r, hdr + SNAPSHOT_MAGIC_SIZE, SNAPSHOT_HEADER_SIZE - SNAPSHOT_MAGIC_SIZE - 4) != WTREE3_OK) {
+        return NULL;
+    }
+    uint32_t format = get_u32(hdr + 8);
+    if (WTREE_UNLIKELY(format == 0 || format > SNAPSHOT_FORMAT)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Unsupported snapshot format %u", format);
+        return NULL;
+    }
+    uint32_t stream_flags = get_u32(hdr + 12);
+    uint32_t tree_flags = get_u32(hdr + 16);
+
+    char *stored_name = NULL;
+    if (snap_name(&r, &stored_name) != WTREE3_OK) return NULL;
+    const char *target = name ? name : stored_name;
+
+    rebuild_list_t rebuild = {0};
+    wtree3_tree_t *tree = NULL;
+    int rc = WTREE3_OK;
+    if (stream_flags & WTREE3_SNAPSHOT_COMPRESS) {
+        r.codec = codec_create(0, NULL, 0);
+        if (WTREE_UNLIKELY(!r.codec)) {
+            set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate snapshot codec");
+            rc = WTREE3_ENOMEM;
+        }
+    }
+
+    if (rc == WTREE3_OK) {
+        wtree3_txn_t *txn = wtree3_txn_begin(db, true, error);
+        rc = txn ? import_txn(&r, txn, target, tree_flags, flags, &rebuild) : WTREE3_ERROR;
+        if (rc == WTREE3_OK) {
+            rc = wtree3_txn_commit(txn, error);
+        } else if (txn) {
+            wtree3_txn_abort(txn);
+        }
+    }
+
+    if (rc == WTREE3_OK) tree = wtree3_tree_open(db, target, 0, 0, error);
+
+    /* Indexes that came without entries (or were asked to be rebuilt) */
+    for (size_t i = 0; tree && i < rebuild.count; i++) {
+        if (!wtree3_tree_has_index(tree, rebuild.names[i])) continue;
+        if (wtree3_tree_build_index(tree, rebuild.names[i], NULL, error) != WTREE3_OK) {
+            wtree3_tree_close(tree);
+            tree = NULL;
+        }
+    }
+
+    for (size_t i = 0; i < rebuild.count; i++) free(rebuild.names[i]);
+    free(rebuild.names);
+    free(stored_name);
+    codec_free(r.codec);
+    free(r.stored);
+    codec_buf_release(&r.raw);
+    return tree;
+}
+
+/* ============================================================
+ * Export
+ * ============================================================ */
+
+WTREE_COLD WTREE_WARN_UNUSED
+int wtree3_tree_export_txn(wtree3_txn_t *txn, wtree3_tree_t *tree, unsigned int flags,
+                           wtree3_snapshot_write_fn write_fn, void *user_data,
+                           gerror_t *error) {
+    if (WTREE_UNLIKELY(!txn || !tree || !write_fn)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+
+    snap_writer_t w = {.write_fn = write_fn, .user_data = user_data, .error = error};
+    if (flags & WTREE3_SNAPSHOT_COMPRESS) {
+        w.codec = codec_create(0, NULL, 0);
+        if (WTREE_UNLIKELY(!w.codec)) {
+            set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate snapshot codec");
+            return WTREE3_ENOMEM;
+        }
+    }
+
+    size_t name_len = strlen(tree->name);
+    unsigned char hdr[SNAPSHOT_HEADER_SIZE];
+    memcpy(hdr, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_SIZE);
+    put_u32(hdr + 8, SNAPSHOT_FORMAT);
+    put_u32(hdr + 12, flags & SNAPSHOT_STREAM_FLAGS);
+    put_u32(hdr + 16, tree->flags & SNAPSHOT_DBI_FLAGS);
+    put_u64(hdr + 20, (uint64_t)mdb_txn_id(txn->txn));
+    put_u32(hdr + 28, (uint32_t)name_len);
+
+    int rc = snap_emit(&w, hdr, sizeof(hdr));
+    if (rc == WTREE3_OK) rc = snap_emit(&w, tree->name, name_len);
+    if (rc == WTREE3_OK) rc = export_metadata(&w, txn->txn, tree);
+
+    if (rc == WTREE3_OK) {
+        unsigned char type = SECTION_DATA;
+        rc = snap_emit(&w, &type, 1);
+        if (rc == WTREE3_OK) rc = export_dbi(&w, txn->txn, tree->dbi);
+    }
+
+    bool with_data = !(flags & WTREE3_SNAPSHOT_NO_INDEXES);
+    index_pin_t pin;
+    const index_set_t *set = index_set_pin(tree, &pin);
+    for (size_t i = 0; i < set->count && rc == WTREE3_OK; i++) {
+        rc = export_index(&w, txn->txn, set->items[i], with_data);
+    }
+    index_set_unpin(&pin);
+
+    if (rc == WTREE3_OK) {
+        unsigned char end[1 + 8];
+        end[0] = SECTION_END;
+        put_u64(end + 1, w.records);
+        rc = snap_emit(&w, end, sizeof(end));
+    }
+
+    free(w.block);
+    codec_buf_release(&w.frame);
+    codec_free(w.codec);
+    return rc;
+}
+
+WTREE_COLD WTREE_WARN_UNUSED
+int wtree3_tree_export(wtree3_tree_t *tree, unsigned int flags,
+                       wtree3_snapshot_write_fn write_fn, void *user_data,
+                       gerror_t *error) {
+    if (WTREE_UNLIKELY(!tree)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Tree cannot be NULL");
+        return WTREE3_EINVAL;
+    }
+
+    /* Not a pooled txn: an export can hold its snapshot for a long time */
+    wtree3_txn_t *txn = wtree3_txn_begin(tree->db, false, error);
+    if (WTREE_UNLIKELY(!txn)) return WTREE3_ERROR;
+
+    int rc = wtree3_tree_export_txn(txn, tree, flags, write_fn, user_data, error);
+    wtree3_txn_abort(txn);
+    return rc;
+}
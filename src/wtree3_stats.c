@@ -0,0 +1,681 @@
+/*
+ * wtree3_stats.c - Tree/Index Statistics and Range Cardinality Estimates
+ *
+ * wtree3_tree_analyze() walks a tree (or index) once under a read
+ * snapshot and stores a small statistics record in the metadata DB:
+ * entry and distinct key counts, the largest duplicate count, and an
+ * equi-depth histogram - up to STATS_MAX_SAMPLES keys spaced roughly
+ * entries/STATS_MAX_SAMPLES entries apart, each with its rank (entries
+ * before it) and duplicate count.
+ *
+ * Estimates binary-search the histogram inside the caller's txn
+ * (zero-copy, no cache to invalidate) and interpolate within a bucket.
+ * The record is not rewritten on every insert/delete - that would add a
+ * metadata write to each change. Instead the estimate is scaled by the
+ * live entry count LMDB maintains for free, so uniform growth and
+ * shrinkage stay accounted for; re-analyze after skewed changes.
+ * Point lookups (start == end) are answered exactly: mdb_cursor_count
+ * for an index key, a lookup for a main-tree key.
+ *
+ * Stats records live under "\x01stats:<tree>:<index>" (empty index name
+ * for the main tree); the leading byte keeps them out of the
+ * "<tree>:<index>" namespace the index loader enumerates.
+ *
+ * This module provides:
+ * - wtree3_tree_analyze, wtree3_index_analyze
+ * - wtree3_stats_get_txn
+ * - wtree3_estimate_range_txn, wtree3_estimate_range
+ * - stats_split_keys: equi-depth split keys for parallel scans
+ */
+
+#include "wtree3_internal.h"
+#include "macros.h"
+
+/* ============================================================
+ * Constants
+ * ============================================================ */
+
+#define STATS_MAX_SAMPLES   64      /* Histogram buckets per record */
+#define STATS_FORMAT        1       /* Record format version */
+
+/*
+ * Record layout (native byte order, like index metadata):
+ *   [format:4][sample_count:4][entries:8][distinct:8][max_dups:8]
+ *   [offset:4] * sample_count
+ *   samples: [rank:8][dups:8][key_len:4][key]
+ */
+#define STATS_HEADER_SIZE   32
+#define STATS_SAMPLE_HDR    20
+
+/* ============================================================
+ * Internal Structures
+ * ============================================================ */
+
+/* Record under construction */
+typedef struct {
+    uint64_t entries;
+    uint64_t distinct;
+    uint64_t max_dups;
+    uint32_t count;
+    uint32_t offsets[STATS_MAX_SAMPLES];
+    unsigned char *buf;             /* Sample area (grows) */
+    size_t len;
+    size_t cap;
+} stats_builder_t;
+
+/* Decoded view of a stored record (points into the map) */
+typedef struct {
+    const unsigned char *data;
+    size_t len;
+    uint32_t count;
+    uint64_t entries;
+    uint64_t distinct;
+    uint64_t max_dups;
+} stats_view_t;
+
+typedef struct {
+    uint64_t rank;
+    uint64_t dups;
+    MDB_val key;
+} stats_sample_t;
+
+/* ============================================================
+ * Record Encoding
+ * ============================================================ */
+
+static int builder_add(stats_builder_t *b, const MDB_val *key, uint64_t rank, uint64_t dups) {
+    size_t need = STATS_SAMPLE_HDR + key->mv_size;
+    if (b->len + need > b->cap) {
+        size_t cap = b->cap ? b->cap * 2 : 1024;
+        while (cap < b->len + need) cap *= 2;
+        unsigned char *nb = realloc(b->buf, cap);
+        if (WTREE_UNLIKELY(!nb)) return WTREE3_ENOMEM;
+        b->buf = nb;
+        b->cap = cap;
+    }
+
+    unsigned char *p = b->buf + b->len;
+    uint32_t klen = (uint32_t)key->mv_size;
+    memcpy(p, &rank, 8);
+    memcpy(p + 8, &dups, 8);
+    memcpy(p + 16, &klen, 4);
+    if (klen) memcpy(p + STATS_SAMPLE_HDR, key->mv_data, klen);
+
+    b->offsets[b->count++] = (uint32_t)b->len;
+    b->len += need;
+    return WTREE3_OK;
+}
+
+/* Serialize a finished builder (NULL on ENOMEM) */
+static void *builder_encode(const stats_builder_t *b, size_t *out_len) {
+    size_t table = (size_t)b->count * 4;
+    size_t total = STATS_HEADER_SIZE + table + b->len;
+    unsigned char *out = malloc(total);
+    if (WTREE_UNLIKELY(!out)) return NULL;
+
+    uint32_t format = STATS_FORMAT;
+    memcpy(out, &format, 4);
+    memcpy(out + 4, &b->count, 4);
+    memcpy(out + 8, &b->entries, 8);
+    memcpy(out + 16, &b->distinct, 8);
+    memcpy(out + 24, &b->max_dups, 8);
+
+    /* Offsets become absolute within the record */
+    for (uint32_t i = 0; i < b->count; i++) {
+        uint32_t off = (uint32_t)(STATS_HEADER_SIZE + table) + b->offsets[i];
+        memcpy(out + STATS_HEADER_SIZE + (size_t)i * 4, &off, 4);
+    }
+    if (b->len) memcpy(out + STATS_HEADER_SIZE + table, b->buf, b->len);
+
+    *out_len = total;
+    return out;
+}
+
+static bool view_decode(const MDB_val *val, stats_view_t *v) {
+    const unsigned char *p = (const unsigned char *)val->mv_data;
+    if (val->mv_size < STATS_HEADER_SIZE) return false;
+
+    uint32_t format;
+    memcpy(&format, p, 4);
+    if (format != STATS_FORMAT) return false;
+
+    v->data = p;
+    v->len = val->mv_size;
+    memcpy(&v->count, p + 4, 4);
+    memcpy(&v->entries, p + 8, 8);
+    memcpy(&v->distinct, p + 16, 8);
+    memcpy(&v->max_dups, p + 24, 8);
+    return v->count <= STATS_MAX_SAMPLES &&
+           STATS_HEADER_SIZE + (size_t)v->count * 4 <= v->len;
+}
+
+static bool view_sample(const stats_view_t *v, uint32_t i, stats_sample_t *s) {
+    uint32_t off;
+    memcpy(&off, v->data + STATS_HEADER_SIZE + (size_t)i * 4, 4);
+    if ((size_t)off + STATS_SAMPLE_HDR > v->len) return false;
+
+    const unsigned char *p = v->data + off;
+    uint32_t klen;
+    memcpy(&s->rank, p, 8);
+    memcpy(&s->dups, p + 8, 8);
+    memcpy(&klen, p + 16, 4);
+    if ((size_t)off + STATS_SAMPLE_HDR + klen > v->len) return false;
+
+    s->key.mv_size = klen;
+    s->key.mv_data = (void *)(p + STATS_SAMPLE_HDR);
+    return true;
+}
+
+/* ============================================================
+ * Record Storage
+ * ============================================================ */
+
+/* Metadata "tree name" owning a tree's stats records */
+static char *stats_owner(const char *tree_name) {
+    size_t len = strlen(WTREE3_STATS_PREFIX) + strlen(tree_name) + 1;
+    char *owner = malloc(len);
+    if (WTREE_LIKELY(owner)) snprintf(owner, len, "%s%s", WTREE3_STATS_PREFIX, tree_name);
+    return owner;
+}
+
+/* Fetch and decode a record; WTREE3_NOT_FOUND if never analyzed */
+static int stats_load(MDB_txn *txn, wtree3_tree_t *tree, const char *index_name,
+                      stats_view_t *out, gerror_t *error) {
+    char *owner = stats_owner(tree->name);
+    char *meta_key = owner ? build_metadata_key(owner, index_name ? index_name : "") : NULL;
+    free(owner);
+    if (WTREE_UNLIKELY(!meta_key)) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to build stats key");
+        return WTREE3_ENOMEM;
+    }
+
+    /* Not created here: read txns cannot, and no DB means no stats */
+    MDB_dbi meta_dbi;
+    MDB_val key = {.mv_size = strlen(meta_key), .mv_data = meta_key};
+    MDB_val val;
+    int rc = mdb_dbi_open(txn, WTREE3_META_DB, 0, &meta_dbi);
+    if (rc == 0) rc = mdb_get(txn, meta_dbi, &key, &val);
+    free(meta_key);
+
+    if (rc == MDB_NOTFOUND) {
+        set_error(error, WTREE3_LIB, WTREE3_NOT_FOUND,
+                 "No statistics for '%s' (run wtree3_tree_analyze)",
+                 index_name ? index_name : tree->name);
+        return WTREE3_NOT_FOUND;
+    }
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+
+    if (WTREE_UNLIKELY(!view_decode(&val, out))) {
+        set_error(error, WTREE3_LIB, WTREE3_ERROR,
+                 "Invalid statistics record for '%s'",
+                 index_name ? index_name : tree->name);
+        return WTREE3_ERROR;
+    }
+    return WTREE3_OK;
+}
+
+int stats_delete_txn(MDB_txn *txn, wtree3_db_t *db, const char *tree_name,
+                     const char *index_name) {
+    char *owner = stats_owner(tree_name);
+    if (WTREE_UNLIKELY(!owner)) return WTREE3_OK;  /* Stale stats are harmless */
+    int rc = metadata_delete_txn(txn, db, owner, index_name ? index_name : "", NULL);
+    free(owner);
+    return rc;
+}
+
+/* ============================================================
+ * Analyze
+ * ============================================================ */
+
+/* One pass over a DBI filling the builder; dupsort DBIs are walked per key */
+static int stats_collect(MDB_txn *txn, MDB_dbi dbi, bool dupsort,
+                         stats_builder_t *b, gerror_t *error) {
+    MDB_stat st;
+    int rc = mdb_stat(txn, dbi, &st);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+
+    uint64_t total = st.ms_entries;
+    uint64_t step = total / STATS_MAX_SAMPLES + 1;
+
+    MDB_cursor *cursor;
+    rc = mdb_cursor_open(txn, dbi, &cursor);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+
+    MDB_val key, val;
+    uint64_t rank = 0;
+    uint64_t next_sample = 0;
+    int result = WTREE3_OK;
+
+    rc = mdb_cursor_get(cursor, &key, &val, MDB_FIRST);
+    while (rc == 0) {
+        size_t dups = 1;
+        if (dupsort) {
+            rc = mdb_cursor_count(cursor, &dups);
+            if (WTREE_UNLIKELY(rc != 0)) break;
+        }
+
+        /* A key starts a bucket once the previous one is full */
+        if (rank >= next_sample && b->count < STATS_MAX_SAMPLES) {
+            result = builder_add(b, &key, rank, dups);
+            if (WTREE_UNLIKELY(result != WTREE3_OK)) {
+                set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate statistics");
+                break;
+            }
+            next_sample = rank + step;
+        }
+
+        rank += dups;
+        b->distinct++;
+        if (dups > b->max_dups) b->max_dups = dups;
+
+        rc = mdb_cursor_get(cursor, &key, &val, dupsort ? MDB_NEXT_NODUP : MDB_NEXT);
+    }
+    mdb_cursor_close(cursor);
+
+    if (result != WTREE3_OK) return result;
+    if (rc != MDB_NOTFOUND) return translate_mdb_error(rc, error);
+
+    b->entries = rank;
+    return WTREE3_OK;
+}
+
+/* A record ready to be stored */
+typedef struct {
+    const char *index_name;         /* NULL = main tree */
+    void *data;
+    size_t len;
+} stats_record_t;
+
+static int stats_build_record(MDB_txn *txn, wtree3_tree_t *tree, wtree3_index_t *idx,
+                              stats_record_t *out, gerror_t *error) {
+    stats_builder_t b = {0};
+    int rc = idx ? stats_collect(txn, idx->dbi, true, &b, error)
+                 : stats_collect(txn, tree->dbi, false, &b, error);
+    if (rc == WTREE3_OK) {
+        out->index_name = idx ? idx->name : NULL;
+        out->data = builder_encode(&b, &out->len);
+        if (WTREE_UNLIKELY(!out->data)) {
+            set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate statistics");
+            rc = WTREE3_ENOMEM;
+        }
+    }
+    free(b.buf);
+    return rc;
+}
+
+typedef struct {
+    wtree3_tree_t *tree;
+    stats_record_t *records;
+    size_t count;
+    gerror_t *error;
+} stats_store_ctx_t;
+
+static int stats_store_txn(MDB_txn *txn, void *user_data) {
+    stats_store_ctx_t *ctx = (stats_store_ctx_t *)user_data;
+
+    char *owner = stats_owner(ctx->tree->name);
+    if (WTREE_UNLIKELY(!owner)) {
+        set_error(ctx->error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to build stats key");
+        return WTREE3_ENOMEM;
+    }
+
+    int rc = WTREE3_OK;
+    for (size_t i = 0; i < ctx->count && rc == WTREE3_OK; i++) {
+        const stats_record_t *r = &ctx->records[i];
+        rc = metadata_put_txn(txn, ctx->tree->db, owner, r->index_name ? r->index_name : "",
+                              r->data, r->len, ctx->error);
+    }
+    free(owner);
+    return rc;
+}
+
+/*
+ * Collect under one read snapshot, then store in a short write txn so the
+ * scan never holds the writer lock. index_name NULL = main tree and all
+ * indexes.
+ */
+static int stats_analyze_run(wtree3_tree_t *tree, const index_set_t *set,
+                             const char *index_name, gerror_t *error) {
+    wtree3_index_t *only = NULL;
+    if (index_name) {
+        only = index_set_find(set, index_name);
+        if (!only) {
+            set_error(error, WTREE3_LIB, WTREE3_NOT_FOUND,
+                     "Index '%s' not found", index_name);
+            return WTREE3_NOT_FOUND;
+        }
+        if (only->building) {
+            set_error(error, WTREE3_LIB, WTREE3_NOT_FOUND,
+                     "Index '%s' is still being built", index_name);
+            return WTREE3_NOT_FOUND;
+        }
+    }
+
+    size_t index_count = set->count;
+    size_t max = only ? 1 : index_count + 1;
+    stats_record_t *records = calloc(max, sizeof(stats_record_t));
+    if (WTREE_UNLIKELY(!records)) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate statistics");
+        return WTREE3_ENOMEM;
+    }
+
+    wtree3_txn_t *txn = read_pool_acquire(tree->db, error);
+    if (WTREE_UNLIKELY(!txn)) {
+        free(records);
+        return WTREE3_ERROR;
+    }
+
+    size_t count = 0;
+    int rc;
+    if (only) {
+        rc = stats_build_record(txn->txn, tree, only, &records[count++], error);
+    } else {
+        rc = stats_build_record(txn->txn, tree, NULL, &records[count++], error);
+        for (size_t i = 0; i < index_count && rc == WTREE3_OK; i++) {
+            wtree3_index_t *idx = set->items[i];
+            if (idx->building) continue;
+            rc = stats_build_record(txn->txn, tree, idx, &records[count++], error);
+        }
+    }
+    read_pool_release(txn);
+
+    if (rc == WTREE3_OK) {
+        stats_store_ctx_t ctx = {.tree = tree, .records = records, .count = count, .error = error};
+        rc = with_write_txn(tree->db, stats_store_txn, &ctx, error);
+    }
+
+    for (size_t i = 0; i < count; i++) free(records[i].data);
+    free(records);
+    return rc;
+}
+
+/* Records name their index, so the set stays pinned until they are stored */
+static int stats_analyze(wtree3_tree_t *tree, const char *index_name, gerror_t *error) {
+    index_pin_t pin;
+    int rc = stats_analyze_run(tree, index_set_pin(tree, &pin), index_name, error);
+    index_set_unpin(&pin);
+    return rc;
+}
+
+/* ============================================================
+ * Estimation
+ * ============================================================ */
+
+/*
+ * Entries strictly below x (inclusive = false) or at most x (inclusive =
+ * true) according to the histogram. Inside a bucket the remainder is
+ * split in half: keys in a bucket are assumed evenly spread.
+ */
+static uint64_t stats_rank(MDB_txn *txn, MDB_dbi dbi, const stats_view_t *v,
+                           const MDB_val *x, bool inclusive) {
+    /* Largest sample <= x */
+    uint32_t lo = 0, hi = v->count;
+    stats_sample_t s;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (!view_sample(v, mid, &s)) return 0;
+        if (mdb_cmp(txn, dbi, &s.key, x) <= 0) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == 0) return 0;
+
+    if (!view_sample(v, lo - 1, &s)) return 0;
+    uint64_t next_rank = v->entries;
+    stats_sample_t n;
+    if (lo < v->count && view_sample(v, lo, &n)) next_rank = n.rank;
+
+    uint64_t after = s.rank + s.dups;
+    if (mdb_cmp(txn, dbi, &s.key, x) == 0) {
+        return inclusive ? after : s.rank;
+    }
+    return after + (next_rank > after ? (next_rank - after) / 2 : 0);
+}
+
+/* Exact answer for a single key */
+static int estimate_point(MDB_txn *txn, MDB_dbi dbi, bool dupsort, const MDB_val *key,
+                          uint64_t *out, gerror_t *error) {
+    MDB_cursor *cursor;
+    int rc = mdb_cursor_open(txn, dbi, &cursor);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+
+    MDB_val k = *key, v;
+    rc = mdb_cursor_get(cursor, &k, &v, MDB_SET);
+    size_t count = 0;
+    if (rc == 0) {
+        count = 1;
+        if (dupsort) rc = mdb_cursor_count(cursor, &count);
+    } else if (rc == MDB_NOTFOUND) {
+        rc = 0;
+    }
+    mdb_cursor_close(cursor);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+
+    *out = count;
+    return WTREE3_OK;
+}
+
+/* Resolve index_name (NULL = main tree) to a DBI of a pinned set */
+static int stats_target(wtree3_tree_t *tree, const index_set_t *set, const char *index_name,
+                        MDB_dbi *dbi, bool *dupsort, gerror_t *error) {
+    if (!index_name) {
+        *dbi = tree->dbi;
+        *dupsort = false;
+        return WTREE3_OK;
+    }
+
+    wtree3_index_t *idx = index_set_find(set, index_name);
+    if (!idx) {
+        set_error(error, WTREE3_LIB, WTREE3_NOT_FOUND, "Index '%s' not found", index_name);
+        return WTREE3_NOT_FOUND;
+    }
+    if (idx->building) {
+        set_error(error, WTREE3_LIB, WTREE3_NOT_FOUND,
+                 "Index '%s' is still being built", index_name);
+        return WTREE3_NOT_FOUND;
+    }
+    *dbi = idx->dbi;
+    *dupsort = true;
+    return WTREE3_OK;
+}
+
+/* ============================================================
+ * Parallel Scan Support
+ * ============================================================ */
+
+WTREE_WARN_UNUSED
+int stats_split_keys(MDB_txn *txn, wtree3_tree_t *tree,
+                     const MDB_val *start, const MDB_val *end,
+                     size_t parts,
+                     MDB_val **out_splits, size_t *out_count,
+                     gerror_t *error) {
+    *out_splits = NULL;
+    *out_count = 0;
+
+    stats_view_t v;
+    int rc = stats_load(txn, tree, NULL, &v, error);
+    if (rc != WTREE3_OK) return rc;
+    if (parts < 2) return WTREE3_OK;
+
+    /* Histogram keys strictly inside (start, end] */
+    uint32_t first = 0, last = v.count;
+    stats_sample_t s;
+    while (first < last) {
+        if (!view_sample(&v, first, &s)) return WTREE3_NOT_FOUND;
+        if (!start || mdb_cmp(txn, tree->dbi, &s.key, start) > 0) break;
+        first++;
+    }
+    while (last > first) {
+        if (!view_sample(&v, last - 1, &s)) return WTREE3_NOT_FOUND;
+        if (!end || mdb_cmp(txn, tree->dbi, &s.key, end) <= 0) break;
+        last--;
+    }
+
+    size_t avail = last - first;
+    size_t want = parts - 1 < avail ? parts - 1 : avail;
+    if (want == 0) return WTREE3_OK;
+
+    MDB_val *splits = calloc(want, sizeof(MDB_val));
+    if (WTREE_UNLIKELY(!splits)) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate split keys");
+        return WTREE3_ENOMEM;
+    }
+
+    /* Spread evenly over the samples in range; samples are equi-depth */
+    size_t count = 0;
+    for (size_t i = 1; i <= want; i++) {
+        uint32_t pick = first + (uint32_t)(i * avail / (want + 1));
+        if (!view_sample(&v, pick, &s)) break;
+        if (count > 0 && mdb_cmp(txn, tree->dbi, &splits[count - 1], &s.key) >= 0) continue;
+
+        splits[count].mv_size = s.key.mv_size;
+        splits[count].mv_data = malloc(s.key.mv_size ? s.key.mv_size : 1);
+        if (WTREE_UNLIKELY(!splits[count].mv_data)) {
+            partition_free_splits(splits, count);
+            set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate split keys");
+            return WTREE3_ENOMEM;
+        }
+        memcpy(splits[count].mv_data, s.key.mv_data, s.key.mv_size);
+        count++;
+    }
+
+    *out_splits = splits;
+    *out_count = count;
+    return WTREE3_OK;
+}
+
+/* ============================================================
+ * Public API
+ * ============================================================ */
+
+WTREE_COLD WTREE_WARN_UNUSED
+int wtree3_tree_analyze(wtree3_tree_t *tree, gerror_t *error) {
+    if (WTREE_UNLIKELY(!tree)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+    return stats_analyze(tree, NULL, error);
+}
+
+WTREE_COLD WTREE_WARN_UNUSED
+int wtree3_index_analyze(wtree3_tree_t *tree, const char *index_name, gerror_t *error) {
+    if (WTREE_UNLIKELY(!tree || !index_name)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+    return stats_analyze(tree, index_name, error);
+}
+
+WTREE_WARN_UNUSED
+int wtree3_stats_get_txn(wtree3_txn_t *txn, wtree3_tree_t *tree,
+                         const char *index_name,
+                         wtree3_stats_t *out,
+                         gerror_t *error) {
+    if (WTREE_UNLIKELY(!txn || !tree || !out)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+
+    stats_view_t v;
+    int rc = stats_load(txn->txn, tree, index_name, &v, error);
+    if (rc != WTREE3_OK) return rc;
+
+    out->entries = v.entries;
+    out->distinct_keys = v.distinct;
+    out->max_dups = v.max_dups;
+    out->samples = v.count;
+    return WTREE3_OK;
+}
+
+static int estimate_range_run(wtree3_txn_t *txn, wtree3_tree_t *tree, const index_set_t *set,
+                              const char *index_name,
+                              const void *start_key, size_t start_len,
+                              const void *end_key, size_t end_len,
+                              uint64_t *out_estimate,
+                              gerror_t *error) {
+    MDB_dbi dbi;
+    bool dupsort;
+    int rc = stats_target(tree, set, index_name, &dbi, &dupsort, error);
+    if (rc != WTREE3_OK) return rc;
+
+    MDB_val start = {.mv_size = start_len, .mv_data = (void *)start_key};
+    MDB_val end = {.mv_size = end_len, .mv_data = (void *)end_key};
+
+    if (start_key && end_key) {
+        int order = mdb_cmp(txn->txn, dbi, &start, &end);
+        if (order > 0) return WTREE3_OK;
+        if (order == 0) return estimate_point(txn->txn, dbi, dupsort, &start, out_estimate, error);
+    }
+
+    MDB_stat st;
+    rc = mdb_stat(txn->txn, dbi, &st);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+    uint64_t live = st.ms_entries;
+
+    /* Never analyzed (or analyzed empty): the whole tree is the bound */
+    stats_view_t v;
+    rc = stats_load(txn->txn, tree, index_name, &v, NULL);
+    if (rc == WTREE3_NOT_FOUND || (rc == WTREE3_OK && v.entries == 0)) {
+        *out_estimate = live;
+        return WTREE3_OK;
+    }
+    if (WTREE_UNLIKELY(rc != WTREE3_OK)) {
+        set_error(error, WTREE3_LIB, rc, "Failed to read statistics for '%s'",
+                 index_name ? index_name : tree->name);
+        return rc;
+    }
+
+    uint64_t lo = start_key ? stats_rank(txn->txn, dbi, &v, &start, false) : 0;
+    uint64_t hi = end_key ? stats_rank(txn->txn, dbi, &v, &end, true) : v.entries;
+    uint64_t est = hi > lo ? hi - lo : 0;
+
+    /* Scale to the live entry count */
+    if (live != v.entries) {
+        est = (uint64_t)((double)est * (double)live / (double)v.entries + 0.5);
+    }
+    *out_estimate = est < live ? est : live;
+    return WTREE3_OK;
+}
+
+WTREE_WARN_UNUSED
+int wtree3_estimate_range_txn(wtree3_txn_t *txn, wtree3_tree_t *tree,
+                              const char *index_name,
+                              const void *start_key, size_t start_len,
+                              const void *end_key, size_t end_len,
+                              uint64_t *out_estimate,
+                              gerror_t *error) {
+    if (WTREE_UNLIKELY(!txn || !tree || !out_estimate)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+    *out_estimate = 0;
+
+    /* Pinned so the index DBI stays open for the whole estimate */
+    index_pin_t pin;
+    const index_set_t *set = index_set_pin(tree, &pin);
+    int rc = estimate_range_run(txn, tree, set, index_name, start_key, start_len,
+                                end_key, end_len, out_estimate, error);
+    index_set_unpin(&pin);
+    return rc;
+}
+
+WTREE_WARN_UNUSED
+int wtree3_estimate_range(wtree3_tree_t *tree,
+                          const char *index_name,
+                          const void *start_key, size_t start_len,
+                          const void *end_key, size_t end_len,
+                          uint64_t *out_estimate,
+                          gerror_t *error) {
+    if (WTREE_UNLIKELY(!tree || !out_estimate)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+
+    wtree3_txn_t *txn = read_pool_acquire(tree->db, error);
+    if (WTREE_UNLIKELY(!txn)) return WTREE3_ERROR;
+
+    int rc = wtree3_estimate_range_txn(txn, tree, index_name,
+                                       start_key, start_len, end_key, end_len,
+                                       out_estimate, error);
+    read_pool_release(txn);
+    return rc;
+}
@@ -2,8 +2,8 @@
  * wtree3_tree.c - Tree Lifecycle and Configuration Management
  *
  * This module provides tree/collection management:
- * - Tree lifecycle (open, close, delete, exists)
- * - Tree configuration (set_compare, set_merge_fn)
+ * - Tree lifecycle (open, close, delete, clear, exists)
+ * - Tree configuration (set_compare, set_merge_fn, set_merge_into_fn)
  * - Index loader support for restoring persisted indexes
  */
 
@@ -18,19 +18,6 @@ extern void wtree3_index_list_free(char **list, size_t count);
  * Internal Helpers
  * ============================================================ */
 
-/*
- * Cleanup function for index vector elements
- */
-WTREE_COLD
-static void cleanup_index(void *element) {
-    wtree3_index_t *idx = (wtree3_index_t *)element;
-    if (WTREE_UNLIKELY(!idx)) return;
-    free(idx->user_data);
-    free(idx->name);
-    free(idx->tree_name);
-    free(idx);
-}
-
 /*
  * Auto-load all persisted indexes for a tree
  * Uses registered extractors from db->extractors registry
@@ -39,7 +26,7 @@ WTREE_COLD
 static void auto_load_indexes(wtree3_tree_t *tree) {
     if (WTREE_UNLIKELY(!tree)) return;
 
-    gerror_t error = {0};
+    gerror_t error = {.flags = GERROR_LAZY};   /* Discarded: never formatted */
     size_t index_count = 0;
     char **index_names = wtree3_tree_list_persisted_indexes(tree, &index_count, &error);
 
@@ -48,11 +35,13 @@ static void auto_load_indexes(wtree3_tree_t *tree) {
     }
 
     // Load each index
+    index_set_lock(tree);
     for (size_t i = 0; i < index_count; i++) {
         int rc = load_index_metadata(tree, index_names[i], &error);
         /* load_index_metadata handles missing extractors gracefully (prints warning), ignore errors */
         (void)rc;
     }
+    index_set_unlock(tree);
 
     wtree3_index_list_free(index_names, index_count);
 }
@@ -66,6 +55,7 @@ typedef struct {
     const char *name;
     unsigned int flags;
     MDB_dbi *out_dbi;
+    unsigned int out_flags;         /* Persistent flags of the (possibly existing) DBI */
 } tree_open_ctx_t;
 
 static int tree_open_txn(MDB_txn *txn, void *user_data) {
@@ -74,6 +64,11 @@ static int tree_open_txn(MDB_txn *txn, void *user_data) {
     if (WTREE_UNLIKELY(rc != 0)) {
         return rc;  /* Will be translated by with_write_txn */
     }
+    /* An existing tree keeps the flags it was created with (MDB_INTEGERKEY...) */
+    rc = mdb_dbi_flags(txn, *ctx->out_dbi, &ctx->out_flags);
+    if (WTREE_UNLIKELY(rc != 0)) {
+        return rc;
+    }
     return WTREE3_OK;
 }
 
@@ -85,6 +80,7 @@ wtree3_tree_t* wtree3_tree_open(wtree3_db_t *db, const char *name,
         set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Database and name are required");
         return NULL;
     }
+    (void)entry_count;  /* Counts come from LMDB now, see wtree3_tree_count_txn */
 
     wtree3_tree_t *tree = calloc(1, sizeof(wtree3_tree_t));
     if (WTREE_UNLIKELY(!tree)) {
@@ -107,20 +103,36 @@ wtree3_tree_t* wtree3_tree_open(wtree3_db_t *db, const char *name,
 
     tree->name = strdup(name);
     tree->db = db;
-    tree->flags = flags;
-    tree->entry_count = entry_count;
-    tree->indexes = wvector_create(4, cleanup_index);
+    tree->flags = ctx.out_flags;
 
-    if (WTREE_UNLIKELY(!tree->name || !tree->indexes)) {
+    if (WTREE_UNLIKELY(!tree->name || index_set_init(tree) != WTREE3_OK)) {
         free(tree->name);
-        wvector_destroy(tree->indexes);
+        index_set_destroy(tree);
         free(tree);
         set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate tree resources");
         return NULL;
     }
 
-    /* Auto-load persisted indexes */
+    /* Values of a compressed tree are unreadable without its codec */
+    if (WTREE_UNLIKELY(codec_auto_load(tree, error) != 0)) {
+        free(tree->name);
+        index_set_destroy(tree);
+        free(tree);
+        return NULL;
+    }
+
+    /* Writes must not bypass an enabled change log */
+    if (WTREE_UNLIKELY(changelog_auto_load(tree, error) != 0)) {
+        codec_free(tree->codec);
+        free(tree->name);
+        index_set_destroy(tree);
+        free(tree);
+        return NULL;
+    }
+
+    /* Auto-load persisted indexes, then rebuild their filters */
     auto_load_indexes(tree);
+    filters_auto_load(tree);
 
     return tree;
 }
@@ -129,8 +141,14 @@ WTREE_COLD
 void wtree3_tree_close(wtree3_tree_t *tree) {
     if (WTREE_UNLIKELY(!tree)) return;
 
-    /* Free all indexes (wvector cleanup function handles individual index cleanup) */
-    wvector_destroy(tree->indexes);
+    /* Buffered upserts go out while the indexes are still there */
+    combine_destroy(tree);
+
+    /* Free the index set and every index, including dropped ones awaiting reclaim */
+    index_set_destroy(tree);
+    filter_free(tree->filter);
+    codec_free(tree->codec);
+    free(tree->changelog);
     free(tree->name);
     free(tree);
 }
@@ -242,28 +260,32 @@ static int delete_tree_metadata(MDB_txn *txn, wtree3_db_t *db, const char *tree_
     rc = mdb_cursor_open(txn, metadata_dbi, &cursor);
     if (WTREE_UNLIKELY(rc != 0)) return rc;
 
-    /* Collect metadata keys matching "tree_name:" */
+    /* Collect metadata keys matching "tree_name:", then its stats, filter and codec records */
+    static const char *const owner_prefixes[] = {"", WTREE3_STATS_PREFIX, WTREE3_FILTER_PREFIX,
+                                                 WTREE3_CODEC_PREFIX};
     char meta_prefix[256];
-    snprintf(meta_prefix, sizeof(meta_prefix), "%s:", tree_name);
+    for (size_t pass = 0; pass < sizeof(owner_prefixes) / sizeof(owner_prefixes[0]); pass++) {
+        snprintf(meta_prefix, sizeof(meta_prefix), "%s%s:", owner_prefixes[pass], tree_name);
 
-    char **keys = NULL;
-    size_t key_count = 0;
+        char **keys = NULL;
+        size_t key_count = 0;
 
-    if (WTREE_UNLIKELY(collect_keys_by_prefix(cursor, meta_prefix, &keys, &key_count) != 0)) {
-        mdb_cursor_close(cursor);
-        return ENOMEM;
-    }
+        if (WTREE_UNLIKELY(collect_keys_by_prefix(cursor, meta_prefix, &keys, &key_count) != 0)) {
+            mdb_cursor_close(cursor);
+            return ENOMEM;
+        }
 
-    /* Delete collected keys */
-    for (size_t i = 0; i < key_count; i++) {
-        MDB_val del_key = {.mv_data = keys[i], .mv_size = strlen(keys[i])};
-        MDB_val val;
-        if (WTREE_LIKELY(mdb_cursor_get(cursor, &del_key, &val, MDB_SET) == 0)) {
-            mdb_cursor_del(cursor, 0);
+        /* Delete collected keys */
+        for (size_t i = 0; i < key_count; i++) {
+            MDB_val del_key = {.mv_data = keys[i], .mv_size = strlen(keys[i])};
+            MDB_val val;
+            if (WTREE_LIKELY(mdb_cursor_get(cursor, &del_key, &val, MDB_SET) == 0)) {
+                mdb_cursor_del(cursor, 0);
+            }
+            free(keys[i]);
         }
-        free(keys[i]);
+        free(keys);
     }
-    free(keys);
 
     mdb_cursor_close(cursor);
     return 0;
@@ -302,6 +324,13 @@ int wtree3_tree_delete(wtree3_db_t *db, const char *name, gerror_t *error) {
         return translate_mdb_error(rc, error);
     }
 
+    /* Delete the change log and its record */
+    rc = changelog_delete_txn(txn, name);
+    if (WTREE_UNLIKELY(rc != 0)) {
+        mdb_txn_abort(txn);
+        return translate_mdb_error(rc, error);
+    }
+
     /* Delete all metadata entries */
     rc = delete_tree_metadata(txn, db, name);
     if (WTREE_UNLIKELY(rc != 0)) {
@@ -325,14 +354,100 @@ int wtree3_tree_delete(wtree3_db_t *db, const char *name, gerror_t *error) {
     return WTREE3_OK;
 }
 
+/*
+ * mdb_drop(dbi, 0) empties a DBI in place and resets its persisted entry
+ * count. A failed drop marks the txn broken, so a partial clear can only
+ * be aborted, never committed.
+ */
+WTREE_WARN_UNUSED
+int wtree3_tree_clear_txn(wtree3_txn_t *txn, wtree3_tree_t *tree,
+                          size_t *deleted_out, gerror_t *error) {
+    if (WTREE_UNLIKELY(!txn || !tree)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid parameters");
+        return WTREE3_EINVAL;
+    }
+    if (WTREE_UNLIKELY(!txn->is_write)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Write operation requires write transaction");
+        return WTREE3_EINVAL;
+    }
+
+    MDB_stat st;
+    int rc = mdb_stat(txn->txn, tree->dbi, &st);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+
+    index_pin_t pin;
+    const index_set_t *set = index_set_pin(tree, &pin);
+    for (size_t i = 0; i < set->count; i++) {
+        wtree3_index_t *idx = set->items[i];
+        MDB_stat idx_st;
+        rc = mdb_stat(txn->txn, idx->dbi, &idx_st);
+        if (WTREE_LIKELY(rc == 0)) rc = mdb_drop(txn->txn, idx->dbi, 0);
+        if (WTREE_UNLIKELY(rc != 0)) {
+            index_set_unpin(&pin);
+            return translate_mdb_error(rc, error);
+        }
+        filter_note_remove_many(idx->filter, idx_st.ms_entries);
+    }
+    index_set_unpin(&pin);
+
+    rc = mdb_drop(txn->txn, tree->dbi, 0);
+    if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, error);
+    filter_note_remove_many(tree->filter, st.ms_entries);
+
+    rc = changelog_note(tree, txn->txn, WTREE3_CHANGE_CLEAR, NULL, 0, NULL, 0, error);
+    if (WTREE_UNLIKELY(rc != WTREE3_OK)) return rc;
+
+    if (deleted_out) *deleted_out = (size_t)st.ms_entries;
+    return WTREE3_OK;
+}
+
+WTREE_WARN_UNUSED
+int wtree3_tree_clear(wtree3_tree_t *tree, size_t *deleted_out, gerror_t *error) {
+    if (WTREE_UNLIKELY(!tree)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Tree cannot be NULL");
+        return WTREE3_EINVAL;
+    }
+
+    wtree3_txn_t *txn = wtree3_txn_begin(tree->db, true, error);
+    if (WTREE_UNLIKELY(!txn)) return WTREE3_ERROR;
+
+    int rc = wtree3_tree_clear_txn(txn, tree, deleted_out, error);
+    if (rc == 0) {
+        rc = wtree3_txn_commit(txn, error);
+    } else {
+        wtree3_txn_abort(txn);
+    }
+    return rc;
+}
+
 WTREE_PURE
 const char* wtree3_tree_name(wtree3_tree_t *tree) {
     return tree ? tree->name : NULL;
 }
 
-WTREE_PURE
+/*
+ * LMDB keeps a per-DB entry count in the DB record itself, updated and
+ * persisted with every commit, so the count is O(1), survives reopen and
+ * aborts, and includes other processes' commits.
+ */
+WTREE_HOT
+int64_t wtree3_tree_count_txn(wtree3_txn_t *txn, wtree3_tree_t *tree) {
+    if (WTREE_UNLIKELY(!txn || !tree)) return 0;
+
+    MDB_stat st;
+    if (WTREE_UNLIKELY(mdb_stat(txn->txn, tree->dbi, &st) != 0)) return -1;
+    return (int64_t)st.ms_entries;
+}
+
 int64_t wtree3_tree_count(wtree3_tree_t *tree) {
-    return tree ? tree->entry_count : 0;
+    if (WTREE_UNLIKELY(!tree)) return 0;
+
+    wtree3_txn_t *txn = read_pool_acquire(tree->db, NULL);
+    if (WTREE_UNLIKELY(!txn)) return -1;
+
+    int64_t count = wtree3_tree_count_txn(txn, tree);
+    read_pool_release(txn);
+    return count;
 }
 
 WTREE_PURE
@@ -360,12 +475,24 @@ int wtree3_tree_set_compare(wtree3_tree_t *tree, MDB_cmp_func *cmp, gerror_t *er
     }
 
     set_compare_ctx_t ctx = { .tree = tree, .cmp = cmp };
-    return with_write_txn(tree->db, set_compare_txn, &ctx, error);
+    int rc = with_write_txn(tree->db, set_compare_txn, &ctx, error);
+    if (rc == WTREE3_OK) tree->custom_compare = true;
+    return rc;
 }
 
+/* A tree has one merge policy: setting either callback clears the other */
 void wtree3_tree_set_merge_fn(wtree3_tree_t *tree, wtree3_merge_fn merge_fn, void *user_data) {
     if (WTREE_UNLIKELY(!tree)) return;
     tree->merge_fn = merge_fn;
+    tree->merge_into_fn = NULL;
+    tree->merge_user_data = user_data;
+}
+
+void wtree3_tree_set_merge_into_fn(wtree3_tree_t *tree, wtree3_merge_into_fn merge_fn,
+                                   void *user_data) {
+    if (WTREE_UNLIKELY(!tree)) return;
+    tree->merge_fn = NULL;
+    tree->merge_into_fn = merge_fn;
     tree->merge_user_data = user_data;
 }
 
@@ -0,0 +1,1029 @@
+/*
+ * wtree3_verify.c - Index Verification
+ *
+ * Checks that the secondary indexes of a tree agree with its rows, in two
+ * passes. The row pass looks every main-tree row up in each index: the
+ * index key must exist, carry the row's primary key among its dups and,
+ * for covering indexes, the row's current projection. The entry pass
+ * walks each index for entries whose row is gone and for unique keys
+ * with several entries. Indexes with an online build in progress are
+ * skipped.
+ *
+ * wtree3_verify_indexes() runs both passes in full and stops at the first
+ * mismatch. wtree3_tree_verify() reports every mismatch through a
+ * callback and adds the modes needed for routine checks of large trees:
+ *
+ * - Sampling: random rows and entries, found with partition_key_at()
+ *   inside a random bucket of the analyzed histogram when there is one,
+ *   with the mismatch count scaled up to the whole tree
+ * - Parallel walks: each pass is cut with stats_split_keys() or
+ *   partition_split_keys() into slices walked by their own thread and
+ *   read txn. Every check reads consistent data within one snapshot, so
+ *   the slices, unlike a parallel scan, need no common one
+ * - Chunks: a walk can end its read txn every chunk_rows entries, so a
+ *   slow walk never pins pages that writers want to reuse. Between chunks
+ *   the walker sleeps to stay under its row and byte rates and, when
+ *   asked, drops the pages it touched from the mapping
+ * - Checkpoints: a stopped walk reports the key (and dup) it would check
+ *   next, and continues from there when given it back
+ *
+ * This module provides:
+ * - wtree3_verify_indexes
+ * - wtree3_tree_verify
+ */
+
+#include "wtree3_internal.h"
+#include "macros.h"
+
+/* ============================================================
+ * Constants
+ * ============================================================ */
+
+#define VERIFY_MAX_THREADS          64
+#define VERIFY_MIN_ROWS_PER_WORKER  1024
+#define VERIFY_THROTTLED_CHUNK      1024    /* Default chunk_rows when throttled */
+#define VERIFY_SAMPLE_BUCKETS       64      /* Histogram buckets to sample from */
+#define VERIFY_READAHEAD_PAGES      16      /* Pages hinted ahead of a sequential walk */
+
+/* ============================================================
+ * Internal Structures
+ * ============================================================ */
+
+/* An owned cursor position: key bytes, then dup bytes */
+typedef struct {
+    unsigned char *buf;
+    size_t cap;
+    size_t key_len;                 /* 0 = the first entry */
+    size_t data_len;                /* 0 = the first dup of the key */
+} verify_pos_t;
+
+/* Address range of map pages touched by a chunk */
+typedef struct {
+    uintptr_t lo;
+    uintptr_t hi;
+} verify_span_t;
+
+/* State shared by all workers of one call */
+typedef struct {
+    wtree3_tree_t *tree;
+    const wtree3_verify_opts_t *opts;
+    wtree3_index_t **indexes;       /* Indexes to check (online builds excluded) */
+    size_t index_count;
+    size_t psize;
+    uintptr_t map_lo;               /* Readahead stays inside the map */
+    uintptr_t map_hi;
+    size_t chunk_rows;              /* Entries per read txn (0 = no limit) */
+    bool track_pages;               /* Byte budget or drop_pages in use */
+    uint32_t stop;                  /* Set once the callback asks to stop */
+    bool threaded;
+    wmutex_t lock;                  /* Serializes the callback and the fields below */
+    uint64_t mismatches;
+    bool have_first;
+    gerror_t first;                 /* Description of the first mismatch */
+} verify_run_t;
+
+typedef struct {
+    verify_run_t *run;
+    wtree3_index_t *idx;            /* Index of the entry pass (NULL = row pass) */
+    MDB_dbi dbi;                    /* Main tree or idx->dbi */
+    bool dupsort;                   /* dbi keeps dups: positions need them */
+    verify_pos_t pos;               /* Next entry to check */
+    const MDB_val *hi;              /* Exclusive end (NULL = last entry) */
+    uint64_t limit;                 /* Max entries (0 = no limit) */
+    uint64_t rows_per_sec;
+    uint64_t bytes_per_sec;
+    bool done;                      /* Reached hi or the last entry */
+
+    MDB_txn *txn;
+    MDB_cursor *cursor;             /* Walks dbi */
+    MDB_cursor **idx_cursors;       /* Row pass lookups, one per index */
+    codec_buf_t buf;
+
+    verify_span_t *spans;
+    size_t span_count;
+    size_t span_cap;
+    uintptr_t walk_page;            /* Page of the last walked entry */
+
+    uint64_t t0;
+    uint64_t checked;
+    uint64_t bytes;
+    uint64_t mismatches;
+    uint64_t total;                 /* Entries in dbi (sampling only) */
+    int rc;
+    gerror_t error;
+} verify_worker_t;
+
+/* Outcome of one pass */
+typedef struct {
+    uint64_t checked;
+    uint64_t mismatches;
+    uint64_t total;
+    bool done;
+    verify_pos_t stop_pos;          /* Where the first unfinished slice stopped */
+} verify_pass_t;
+
+/* ============================================================
+ * Helpers
+ * ============================================================ */
+
+static uint64_t splitmix64(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static uint64_t index_id(const wtree3_index_t *idx) {
+    return whash_bytes(idx->name, strlen(idx->name));
+}
+
+static int pos_set(verify_pos_t *p, const MDB_val *key, const MDB_val *data) {
+    size_t data_len = data ? data->mv_size : 0;
+    size_t need = key->mv_size + data_len;
+    if (need > p->cap) {
+        unsigned char *grown = realloc(p->buf, need);
+        if (WTREE_UNLIKELY(!grown)) return WTREE3_ENOMEM;
+        p->buf = grown;
+        p->cap = need;
+    }
+    memmove(p->buf, key->mv_data, key->mv_size);
+    if (data_len) memmove(p->buf + key->mv_size, data->mv_data, data_len);
+    p->key_len = key->mv_size;
+    p->data_len = data_len;
+    return WTREE3_OK;
+}
+
+static void pos_free(verify_pos_t *p) {
+    free(p->buf);
+    *p = (verify_pos_t){0};
+}
+
+static bool verify_stopped(const verify_worker_t *w) {
+    return watomic_load_u32(&w->run->stop) != 0 ||
+           (w->limit && w->checked >= w->limit);
+}
+
+/* ============================================================
+ * Page Tracking and Pacing
+ * ============================================================ */
+
+static void note_span(verify_worker_t *w, const void *addr, size_t len) {
+    if (!w->run->track_pages || !addr) return;
+    uintptr_t mask = ~(uintptr_t)(w->run->psize - 1);
+    uintptr_t lo = (uintptr_t)addr & mask;
+    uintptr_t hi = ((uintptr_t)addr + (len ? len : 1) + w->run->psize - 1) & mask;
+    if (lo < w->run->map_lo || hi > w->run->map_hi) return;  /* Decoded copy, not the map */
+
+    if (w->span_count > 0) {
+        verify_span_t *last = &w->spans[w->span_count - 1];
+        if (lo <= last->hi && hi >= last->lo) {
+            if (lo < last->lo) last->lo = lo;
+            if (hi > last->hi) last->hi = hi;
+            return;
+        }
+    }
+    if (w->span_count == w->span_cap) {
+        size_t cap = w->span_cap ? w->span_cap * 2 : 256;
+        verify_span_t *grown = realloc(w->spans, cap * sizeof(verify_span_t));
+        if (WTREE_UNLIKELY(!grown)) return;  /* Only pacing and hints are lost */
+        w->spans = grown;
+        w->span_cap = cap;
+    }
+    w->spans[w->span_count++] = (verify_span_t){lo, hi};
+}
+
+/* Read ahead when the walk moves on to the next page of the map */
+static void note_walk(verify_worker_t *w, const MDB_val *key) {
+    verify_run_t *run = w->run;
+    note_span(w, key->mv_data, key->mv_size);
+    if (!run->opts->drop_pages) return;
+
+    uintptr_t page = (uintptr_t)key->mv_data & ~(uintptr_t)(run->psize - 1);
+    if (page == w->walk_page) return;
+    bool sequential = page == w->walk_page + run->psize;
+    w->walk_page = page;
+    if (!sequential) return;
+
+    uintptr_t ahead = page + run->psize;
+    size_t len = VERIFY_READAHEAD_PAGES * run->psize;
+    if (ahead >= run->map_hi) return;
+    if (len > run->map_hi - ahead) len = run->map_hi - ahead;
+    memopt_willneed((const void *)ahead, len, run->psize);
+}
+
+static int span_cmp(const void *a, const void *b, void *ctx) {
+    (void)ctx;
+    uintptr_t x = ((const verify_span_t *)a)->lo;
+    uintptr_t y = ((const verify_span_t *)b)->lo;
+    return (x > y) - (x < y);
+}
+
+/* Count (and optionally drop) the pages touched since the last chunk */
+static void release_pages(verify_worker_t *w) {
+    if (w->span_count == 0) return;
+    (void)wsort(w->spans, w->span_count, sizeof(verify_span_t), span_cmp, NULL);
+
+    size_t i = 0;
+    while (i < w->span_count) {
+        uintptr_t lo = w->spans[i].lo;
+        uintptr_t hi = w->spans[i].hi;
+        for (i++; i < w->span_count && w->spans[i].lo <= hi; i++) {
+            if (w->spans[i].hi > hi) hi = w->spans[i].hi;
+        }
+        w->bytes += hi - lo;
+        if (w->run->opts->drop_pages) {
+            memopt_dontneed((const void *)lo, hi - lo, w->run->psize);
+        }
+    }
+    w->span_count = 0;
+    w->walk_page = 0;
+}
+
+/* Sleep until the entries and bytes so far fit the worker's rates */
+static void throttle(verify_worker_t *w) {
+    uint64_t want_us = 0;
+    if (w->rows_per_sec) {
+        want_us = w->checked * 1000000 / w->rows_per_sec;
+    }
+    if (w->bytes_per_sec) {
+        uint64_t us = w->bytes * 1000000 / w->bytes_per_sec;
+        if (us > want_us) want_us = us;
+    }
+    uint64_t elapsed = wtime_now_us() - w->t0;
+    if (want_us > elapsed) wtime_sleep_us(want_us - elapsed);
+}
+
+/* ============================================================
+ * Checks
+ * ============================================================ */
+
+static const char *mismatch_format(wtree3_verify_kind_t kind) {
+    switch (kind) {
+        case WTREE3_VERIFY_MISSING:
+            return "Index '%s': missing entry for main tree key (index inconsistency)";
+        case WTREE3_VERIFY_MISSING_PK:
+            return "Index '%s': primary key not found in index duplicates (index inconsistency)";
+        case WTREE3_VERIFY_STALE_PAYLOAD:
+            return "Index '%s': stale covering payload (index inconsistency)";
+        case WTREE3_VERIFY_ORPHAN:
+            return "Index '%s': orphaned entry pointing to non-existent main tree key";
+        case WTREE3_VERIFY_DUPLICATE:
+            return "Index '%s': unique constraint violated - duplicate keys found";
+    }
+    return "Index '%s': inconsistent";
+}
+
+static void report_mismatch(verify_worker_t *w, wtree3_verify_kind_t kind,
+                            const wtree3_index_t *idx,
+                            const MDB_val *key, const MDB_val *pk) {
+    verify_run_t *run = w->run;
+    wtree3_verify_mismatch_t m = {
+        .kind = kind,
+        .index_name = idx->name,
+        .key = key->mv_data,
+        .key_len = key->mv_size,
+        .pk = pk ? pk->mv_data : NULL,
+        .pk_len = pk ? pk->mv_size : 0,
+    };
+
+    w->mismatches++;
+    if (run->threaded) wmutex_lock(&run->lock);
+    run->mismatches++;
+    if (!run->have_first) {
+        set_error(&run->first, WTREE3_LIB, WTREE3_INDEX_ERROR, mismatch_format(kind), idx->name);
+        run->have_first = true;
+    }
+    bool go_on = watomic_load_u32(&run->stop) == 0;
+    if (go_on && run->opts->on_mismatch) go_on = run->opts->on_mismatch(&m, run->opts->user_data);
+    if (run->threaded) wmutex_unlock(&run->lock);
+
+    if (!go_on) watomic_store_u32(&run->stop, 1);
+}
+
+/* Look one main-tree row (value decoded) up in every index */
+static int check_row(verify_worker_t *w, const MDB_val *key, const MDB_val *val) {
+    verify_run_t *run = w->run;
+
+    for (size_t i = 0; i < run->index_count && watomic_load_u32(&run->stop) == 0; i++) {
+        wtree3_index_t *idx = run->indexes[i];
+
+        index_key_t idx_key;
+        if (!index_key_extract(idx, val->mv_data, val->mv_size, &idx_key)) continue;
+        if (WTREE_UNLIKELY(!idx_key.data)) {
+            set_error(&w->error, WTREE3_LIB, WTREE3_INDEX_ERROR,
+                      "Index '%s': key extraction failed during verification", idx->name);
+            return WTREE3_INDEX_ERROR;
+        }
+
+        if (!w->idx_cursors[i]) {
+            int rc = mdb_cursor_open(w->txn, idx->dbi, &w->idx_cursors[i]);
+            if (WTREE_UNLIKELY(rc != 0)) {
+                w->idx_cursors[i] = NULL;
+                index_key_release(&idx_key);
+                return translate_mdb_error(rc, &w->error);
+            }
+        }
+        MDB_cursor *cursor = w->idx_cursors[i];
+
+        MDB_val search = {.mv_size = idx_key.len, .mv_data = (void *)idx_key.data};
+        MDB_val idx_val;
+        int rc = mdb_cursor_get(cursor, &search, &idx_val, MDB_SET);
+        if (rc == MDB_NOTFOUND) {
+            index_key_release(&idx_key);
+            report_mismatch(w, WTREE3_VERIFY_MISSING, idx, key, NULL);
+            continue;
+        }
+        if (WTREE_UNLIKELY(rc != 0)) {
+            index_key_release(&idx_key);
+            return translate_mdb_error(rc, &w->error);
+        }
+
+        /* Unique keys hold one dup; otherwise look for the row's own */
+        if (!idx->unique) {
+            bool found_pk = false;
+            do {
+                MDB_val entry_pk;
+                if (index_dup_split(idx->project_fn != NULL, &idx_val, &entry_pk, NULL) &&
+                    entry_pk.mv_size == key->mv_size &&
+                    memcmp(entry_pk.mv_data, key->mv_data, key->mv_size) == 0) {
+                    found_pk = true;
+                    break;
+                }
+                rc = mdb_cursor_get(cursor, &search, &idx_val, MDB_NEXT_DUP);
+            } while (rc == 0);
+
+            if (WTREE_UNLIKELY(rc != 0 && rc != MDB_NOTFOUND)) {
+                index_key_release(&idx_key);
+                return translate_mdb_error(rc, &w->error);
+            }
+            if (!found_pk) {
+                index_key_release(&idx_key);
+                report_mismatch(w, WTREE3_VERIFY_MISSING_PK, idx, key, NULL);
+                continue;
+            }
+        }
+        note_span(w, idx_val.mv_data, idx_val.mv_size);
+
+        if (idx->project_fn) {
+            index_dup_t expected;
+            rc = index_dup_build(idx, key->mv_data, key->mv_size,
+                                 val->mv_data, val->mv_size, &expected, &w->error);
+            if (WTREE_UNLIKELY(rc != 0)) {
+                index_key_release(&idx_key);
+                return rc;
+            }
+            bool stale = expected.val.mv_size != idx_val.mv_size ||
+                         memcmp(expected.val.mv_data, idx_val.mv_data, idx_val.mv_size) != 0;
+            index_dup_release(&expected);
+            if (stale) report_mismatch(w, WTREE3_VERIFY_STALE_PAYLOAD, idx, key, NULL);
+        }
+        index_key_release(&idx_key);
+    }
+    return WTREE3_OK;
+}
+
+/*
+ * Check the index entry under the walk cursor: its row must exist and,
+ * for unique indexes, first_of_key entries must be the only dup.
+ */
+static int check_entry(verify_worker_t *w, const MDB_val *key, const MDB_val *data,
+                       bool first_of_key) {
+    wtree3_index_t *idx = w->idx;
+
+    MDB_val pk, row;
+    int rc = MDB_NOTFOUND;
+    bool split = index_dup_split(idx->project_fn != NULL, data, &pk, NULL);
+    if (split) rc = mdb_get(w->txn, w->run->tree->dbi, &pk, &row);
+    if (rc == 0) {
+        note_span(w, row.mv_data, row.mv_size);
+    } else if (rc == MDB_NOTFOUND) {
+        report_mismatch(w, WTREE3_VERIFY_ORPHAN, idx, key, split ? &pk : data);
+    } else {
+        return translate_mdb_error(rc, &w->error);
+    }
+
+    if (idx->unique && first_of_key) {
+        size_t dups;
+        rc = mdb_cursor_count(w->cursor, &dups);
+        if (WTREE_UNLIKELY(rc != 0)) return translate_mdb_error(rc, &w->error);
+        if (dups > 1) report_mismatch(w, WTREE3_VERIFY_DUPLICATE, idx, key, NULL);
+    }
+    return WTREE3_OK;
+}
+
+/* Check the entry under the walk cursor, whichever pass this is */
+static int check_current(verify_worker_t *w, const MDB_val *key, MDB_val *data,
+                         bool first_of_key) {
+    if (w->idx) return check_entry(w, key, data, first_of_key);
+
+    note_span(w, data->mv_data, data->mv_size);
+    int rc = tree_value_decode(w->run->tree, data, &w->buf);
+    if (WTREE_UNLIKELY(rc != 0)) {
+        set_error(&w->error, WTREE3_LIB, rc, "Failed to decode value during verification");
+        return rc;
+    }
+    return check_row(w, key, data);
+}
+
+/* ============================================================
+ * Walks
+ * ============================================================ */
+
+static void close_cursors(verify_worker_t *w) {
+    if (w->cursor) mdb_cursor_close(w->cursor);
+    w->cursor = NULL;
+    if (!w->idx_cursors) return;
+    for (size_t i = 0; i < w->run->index_count; i++) {
+        if (w->idx_cursors[i]) mdb_cursor_close(w->idx_cursors[i]);
+        w->idx_cursors[i] = NULL;
+    }
+}
+
+/* Position the walk cursor at w->pos; returns an MDB code */
+static int seek_pos(verify_worker_t *w, MDB_val *key, MDB_val *data) {
+    if (w->pos.key_len == 0) return mdb_cursor_get(w->cursor, key, data, MDB_FIRST);
+
+    MDB_val want = {.mv_size = w->pos.key_len, .mv_data = w->pos.buf};
+    *key = want;
+    if (w->pos.data_len == 0) return mdb_cursor_get(w->cursor, key, data, MDB_SET_RANGE);
+
+    *data = (MDB_val){.mv_size = w->pos.data_len, .mv_data = w->pos.buf + w->pos.key_len};
+    int rc = mdb_cursor_get(w->cursor, key, data, MDB_GET_BOTH_RANGE);
+    if (rc == 0) return mdb_cursor_get(w->cursor, key, data, MDB_GET_CURRENT);
+    if (rc != MDB_NOTFOUND) return rc;
+
+    /* Every dup at or after the position is gone: on to the next key */
+    *key = want;
+    rc = mdb_cursor_get(w->cursor, key, data, MDB_SET_RANGE);
+    if (rc == 0 && mdb_cmp(w->txn, w->dbi, key, &want) == 0) {
+        rc = mdb_cursor_get(w->cursor, key, data, MDB_NEXT_NODUP);
+    }
+    return rc;
+}
+
+/*
+ * Walk from w->pos on the current txn until the end, the chunk size or
+ * a stop; a walk that has not reached its end leaves the next entry in
+ * w->pos (with its dup unless it is the first of its key).
+ */
+static int walk_chunk(verify_worker_t *w) {
+    verify_run_t *run = w->run;
+    int mrc = mdb_cursor_open(w->txn, w->dbi, &w->cursor);
+    if (WTREE_UNLIKELY(mrc != 0)) {
+        w->cursor = NULL;
+        return translate_mdb_error(mrc, &w->error);
+    }
+
+    MDB_val key, data;
+    bool first_of_key = w->pos.data_len == 0;
+    size_t rows = 0;
+    mrc = seek_pos(w, &key, &data);
+
+    while (mrc == 0) {
+        if (w->hi && mdb_cmp(w->txn, w->dbi, &key, w->hi) >= 0) break;
+        if ((run->chunk_rows && rows >= run->chunk_rows) || verify_stopped(w)) {
+            if (WTREE_UNLIKELY(pos_set(&w->pos, &key, first_of_key ? NULL : &data) != 0)) {
+                set_error(&w->error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to save verify position");
+                return WTREE3_ENOMEM;
+            }
+            return WTREE3_OK;
+        }
+
+        note_walk(w, &key);
+        MDB_val value = data;
+        int rc = check_current(w, &key, &value, first_of_key);
+        if (WTREE_UNLIKELY(rc != 0)) return rc;
+        rows++;
+        w->checked++;
+
+        if (w->dupsort) {
+            mrc = mdb_cursor_get(w->cursor, &key, &data, MDB_NEXT_DUP);
+            first_of_key = mrc == MDB_NOTFOUND;
+            if (first_of_key) mrc = mdb_cursor_get(w->cursor, &key, &data, MDB_NEXT_NODUP);
+        } else {
+            mrc = mdb_cursor_get(w->cursor, &key, &data, MDB_NEXT);
+        }
+    }
+    if (WTREE_UNLIKELY(mrc != 0 && mrc != MDB_NOTFOUND)) {
+        return translate_mdb_error(mrc, &w->error);
+    }
+    w->done = true;
+    return WTREE3_OK;
+}
+
+/* Walk a slice in chunks, each on a fresh snapshot of the same read txn */
+static int walk(verify_worker_t *w) {
+    int rc = mdb_txn_begin(w->run->tree->db->env, NULL, MDB_RDONLY, &w->txn);
+    if (WTREE_UNLIKELY(rc != 0)) {
+        w->txn = NULL;
+        return translate_mdb_error(rc, &w->error);
+    }
+
+    w->t0 = wtime_now_us();
+    for (;;) {
+        rc = walk_chunk(w);
+        close_cursors(w);
+        release_pages(w);
+        if (rc != 0 || w->done || verify_stopped(w)) break;
+
+        mdb_txn_reset(w->txn);
+        throttle(w);
+        int mrc = mdb_txn_renew(w->txn);
+        if (WTREE_UNLIKELY(mrc != 0)) {
+            rc = translate_mdb_error(mrc, &w->error);
+            break;
+        }
+    }
+    codec_buf_release(&w->buf);
+    mdb_txn_abort(w->txn);
+    w->txn = NULL;
+    return rc;
+}
+
+static void *walk_thread(void *arg) {
+    verify_worker_t *w = (verify_worker_t *)arg;
+    w->rc = walk(w);
+    return NULL;
+}
+
+/* Check `samples` random entries of w->dbi on the calling thread */
+static int sample(verify_worker_t *w, size_t samples, uint64_t *rng) {
+    verify_run_t *run = w->run;
+    int rc = mdb_txn_begin(run->tree->db->env, NULL, MDB_RDONLY, &w->txn);
+    if (WTREE_UNLIKELY(rc != 0)) {
+        w->txn = NULL;
+        return translate_mdb_error(rc, &w->error);
+    }
+    w->t0 = wtime_now_us();
+
+    verify_pos_t first = {0}, last = {0};
+    MDB_val *splits = NULL;
+    size_t split_count = 0;
+    MDB_val key, data;
+
+    rc = mdb_cursor_open(w->txn, w->dbi, &w->cursor);
+    if (WTREE_UNLIKELY(rc != 0)) {
+        w->cursor = NULL;
+        rc = translate_mdb_error(rc, &w->error);
+        goto out;
+    }
+    MDB_stat st;
+    rc = mdb_stat(w->txn, w->dbi, &st);
+    if (WTREE_UNLIKELY(rc != 0)) {
+        rc = translate_mdb_error(rc, &w->error);
+        goto out;
+    }
+    w->total = st.ms_entries;
+
+    rc = mdb_cursor_get(w->cursor, &key, &data, MDB_FIRST);
+    if (rc == 0 && (rc = pos_set(&first, &key, NULL)) == 0) {
+        rc = mdb_cursor_get(w->cursor, &key, &data, MDB_LAST);
+        if (rc == 0) rc = pos_set(&last, &key, NULL);
+    }
+    if (rc == MDB_NOTFOUND) {
+        rc = WTREE3_OK;     /* Nothing to sample */
+        goto out;
+    }
+    if (WTREE_UNLIKELY(rc != 0)) {
+        if (rc == WTREE3_ENOMEM) {
+            set_error(&w->error, WTREE3_LIB, rc, "Failed to allocate sample bounds");
+        } else {
+            rc = translate_mdb_error(rc, &w->error);
+        }
+        goto out;
+    }
+
+    /* Equi-depth buckets when analyzed; a failure just means no buckets */
+    if (!w->idx &&
+        stats_split_keys(w->txn, run->tree, NULL, NULL, VERIFY_SAMPLE_BUCKETS,
+                         &splits, &split_count, NULL) != 0) {
+        splits = NULL;
+        split_count = 0;
+    }
+    MDB_val lo_key = {.mv_size = first.key_len, .mv_data = first.buf};
+    MDB_val hi_key = {.mv_size = last.key_len, .mv_data = last.buf};
+
+    for (size_t i = 0; i < samples && !verify_stopped(w); i++) {
+        if (run->chunk_rows && i > 0 && i % run->chunk_rows == 0) {
+            close_cursors(w);
+            release_pages(w);
+            mdb_txn_reset(w->txn);
+            throttle(w);
+            rc = mdb_txn_renew(w->txn);
+            if (rc == 0) rc = mdb_cursor_open(w->txn, w->dbi, &w->cursor);
+            if (WTREE_UNLIKELY(rc != 0)) {
+                w->cursor = NULL;
+                rc = translate_mdb_error(rc, &w->error);
+                goto out;
+            }
+        }
+
+        size_t b = (size_t)(splitmix64(rng) % (split_count + 1));
+        const MDB_val *lo = b > 0 ? &splits[b - 1] : &lo_key;
+        const MDB_val *hi = b < split_count ? &splits[b] : &hi_key;
+        if (mdb_cmp(w->txn, w->dbi, lo, hi) > 0) continue;
+
+        rc = partition_key_at(w->cursor, lo, hi, splitmix64(rng), &key, &data);
+        if (rc == MDB_NOTFOUND) continue;   /* Bound deleted since; draw again next turn */
+        if (WTREE_UNLIKELY(rc != 0)) {
+            rc = translate_mdb_error(rc, &w->error);
+            goto out;
+        }
+
+        if (w->idx) {
+            /* Cursors land on the first dup of their key */
+            rc = check_entry(w, &key, &data, true);
+        } else {
+            rc = check_current(w, &key, &data, true);
+        }
+        if (WTREE_UNLIKELY(rc != 0)) goto out;
+        w->checked++;
+    }
+    w->done = true;
+    rc = WTREE3_OK;
+
+out:
+    close_cursors(w);
+    release_pages(w);
+    codec_buf_release(&w->buf);
+    partition_free_splits(splits, split_count);
+    pos_free(&first);
+    pos_free(&last);
+    mdb_txn_abort(w->txn);
+    w->txn = NULL;
+    return rc;
+}
+
+/* ============================================================
+ * Passes
+ * ============================================================ */
+
+static void init_worker(verify_worker_t *w, verify_run_t *run, wtree3_index_t *idx,
+                        MDB_cursor **idx_cursors, size_t share) {
+    const wtree3_verify_opts_t *opts = run->opts;
+    w->run = run;
+    w->idx = idx;
+    w->dbi = idx ? idx->dbi : run->tree->dbi;
+    w->dupsort = idx || (run->tree->flags & MDB_DUPSORT);
+    w->idx_cursors = idx_cursors;
+    w->rows_per_sec = opts->rows_per_sec ? (opts->rows_per_sec / share ? opts->rows_per_sec / share : 1) : 0;
+    w->bytes_per_sec = opts->bytes_per_sec ? (opts->bytes_per_sec / share ? opts->bytes_per_sec / share : 1) : 0;
+}
+
+static void free_worker(verify_worker_t *w) {
+    pos_free(&w->pos);
+    free(w->spans);
+    w->spans = NULL;
+}
+
+/* Check `limit` (0 = sample_rows) random entries of one pass */
+static int sample_pass(verify_run_t *run, wtree3_index_t *idx, uint64_t limit, uint64_t *rng,
+                       verify_pass_t *out, gerror_t *error) {
+    MDB_cursor **idx_cursors = NULL;
+    if (!idx) {
+        idx_cursors = calloc(run->index_count, sizeof(MDB_cursor *));
+        if (WTREE_UNLIKELY(!idx_cursors)) {
+            set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate verify cursors");
+            return WTREE3_ENOMEM;
+        }
+    }
+
+    verify_worker_t w = {0};
+    init_worker(&w, run, idx, idx_cursors, 1);
+    w.limit = limit;
+
+    int rc = sample(&w, run->opts->sample_rows, rng);
+    if (rc != 0) error_copy(error, &w.error);
+    out->checked = w.checked;
+    out->mismatches = w.mismatches;
+    out->total = w.total;
+    out->done = w.done;
+
+    free_worker(&w);
+    free(idx_cursors);
+    return rc;
+}
+
+/* Walk one pass from resume (NULL = its start), split across threads */
+static int walk_pass(verify_run_t *run, wtree3_index_t *idx, const verify_pos_t *resume,
+                     uint64_t limit, verify_pass_t *out, gerror_t *error) {
+    const wtree3_verify_opts_t *opts = run->opts;
+    MDB_dbi dbi = idx ? idx->dbi : run->tree->dbi;
+    size_t threads = opts->threads ? opts->threads : 1;
+    if (threads > VERIFY_MAX_THREADS) threads = VERIFY_MAX_THREADS;
+
+    MDB_val *splits = NULL;
+    size_t split_count = 0;
+    int rc = WTREE3_OK;
+
+    if (threads > 1) {
+        MDB_txn *txn;
+        int mrc = mdb_txn_begin(run->tree->db->env, NULL, MDB_RDONLY, &txn);
+        if (WTREE_UNLIKELY(mrc != 0)) return translate_mdb_error(mrc, error);
+
+        MDB_stat st;
+        mrc = mdb_stat(txn, dbi, &st);
+        if (WTREE_UNLIKELY(mrc != 0)) {
+            mdb_txn_abort(txn);
+            return translate_mdb_error(mrc, error);
+        }
+        size_t useful = st.ms_entries / VERIFY_MIN_ROWS_PER_WORKER;
+        if (useful < threads) threads = useful ? useful : 1;
+
+        if (threads > 1) {
+            MDB_val start = {.mv_size = resume ? resume->key_len : 0,
+                             .mv_data = resume ? resume->buf : NULL};
+            const MDB_val *from = start.mv_size ? &start : NULL;
+
+            /* Equi-depth splits for analyzed trees, key-space bisection otherwise */
+            rc = idx ? WTREE3_NOT_FOUND
+                     : stats_split_keys(txn, run->tree, from, NULL, threads,
+                                        &splits, &split_count, NULL);
+            if (rc != 0 || split_count == 0) {
+                partition_free_splits(splits, split_count);
+                rc = partition_split_keys(txn, dbi, from, NULL, threads,
+                                          &splits, &split_count, error);
+            }
+        }
+        mdb_txn_abort(txn);
+        if (WTREE_UNLIKELY(rc != 0)) return rc;
+    }
+
+    size_t count = split_count + 1;
+    verify_worker_t *workers = calloc(count, sizeof(verify_worker_t));
+    MDB_cursor **idx_cursors = idx ? NULL : calloc(count * run->index_count, sizeof(MDB_cursor *));
+    wthread_t *handles = count > 1 ? malloc(count * sizeof(wthread_t)) : NULL;
+    bool *started = count > 1 ? calloc(count, sizeof(bool)) : NULL;
+    bool ok = workers && (idx || idx_cursors) && (count == 1 || (handles && started));
+
+    for (size_t i = 0; ok && i < count; i++) {
+        verify_worker_t *w = &workers[i];
+        init_worker(w, run, idx, idx_cursors ? idx_cursors + i * run->index_count : NULL, count);
+        w->hi = i < split_count ? &splits[i] : NULL;
+        w->limit = limit ? (limit + count - 1) / count : 0;
+        if (i > 0) {
+            ok = pos_set(&w->pos, &splits[i - 1], NULL) == 0;
+        } else if (resume && resume->key_len) {
+            MDB_val key = {.mv_size = resume->key_len, .mv_data = resume->buf};
+            MDB_val data = {.mv_size = resume->data_len, .mv_data = resume->buf + resume->key_len};
+            ok = pos_set(&w->pos, &key, resume->data_len ? &data : NULL) == 0;
+        }
+    }
+    if (WTREE_UNLIKELY(!ok)) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate verify workers");
+        rc = WTREE3_ENOMEM;
+        goto cleanup;
+    }
+
+    if (count == 1) {
+        workers[0].rc = walk(&workers[0]);
+    } else {
+        run->threaded = true;
+        for (size_t i = 0; i < count; i++) {
+            started[i] = wthread_create(&handles[i], walk_thread, &workers[i]) == 0;
+        }
+        /* Slices whose thread could not start are walked here */
+        for (size_t i = 0; i < count; i++) {
+            if (!started[i]) workers[i].rc = walk(&workers[i]);
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (started[i]) wthread_join(handles[i], NULL);
+        }
+        run->threaded = false;
+    }
+
+    out->done = true;
+    for (size_t i = 0; i < count; i++) {
+        verify_worker_t *w = &workers[i];
+        out->checked += w->checked;
+        out->mismatches += w->mismatches;
+        if (w->rc != 0 && rc == 0) {
+            rc = w->rc;
+            error_copy(error, &w->error);
+        }
+        if (!w->done && out->done) {
+            out->done = false;
+            out->stop_pos = w->pos;
+            w->pos = (verify_pos_t){0};
+        }
+    }
+
+cleanup:
+    if (workers) {
+        for (size_t i = 0; i < count; i++) free_worker(&workers[i]);
+    }
+    free(workers);
+    free(idx_cursors);
+    free(handles);
+    free(started);
+    partition_free_splits(splits, split_count);
+    return rc;
+}
+
+/* ============================================================
+ * Checkpoints
+ * ============================================================ */
+
+static void checkpoint_save(wtree3_verify_checkpoint_t *cp, uint32_t pass,
+                            const wtree3_index_t *idx, const verify_pos_t *pos) {
+    cp->active = true;
+    cp->pass = pass;
+    cp->index_id = idx ? index_id(idx) : 0;
+    cp->key_len = 0;
+    cp->data_len = 0;
+    if (!pos || pos->key_len > WTREE3_VERIFY_POS_MAX) return;  /* Restart the pass */
+
+    cp->key_len = (uint32_t)pos->key_len;
+    if (pos->key_len + pos->data_len <= WTREE3_VERIFY_POS_MAX) {
+        cp->data_len = (uint32_t)pos->data_len;     /* Else: the first dup of the key */
+    }
+    memcpy(cp->pos, pos->buf, cp->key_len + cp->data_len);
+}
+
+/* ============================================================
+ * Entry Points
+ * ============================================================ */
+
+static int verify_tree_run(wtree3_tree_t *tree, const index_set_t *set,
+                           const wtree3_verify_opts_t *opts,
+                           wtree3_verify_report_t *report,
+                           gerror_t *error) {
+    static const wtree3_verify_opts_t defaults = {0};
+    wtree3_verify_report_t local;
+
+    if (!opts) opts = &defaults;
+    if (!report) report = &local;
+    *report = (wtree3_verify_report_t){0};
+
+    bool sampling = opts->sample_rows > 0;
+    const wtree3_verify_checkpoint_t *cp = opts->resume;
+    if (sampling || (cp && !cp->active)) cp = NULL;
+    if (WTREE_UNLIKELY(cp && ((size_t)cp->key_len + cp->data_len > WTREE3_VERIFY_POS_MAX ||
+                              cp->pass > 1))) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Invalid verify checkpoint");
+        return WTREE3_EINVAL;
+    }
+
+    verify_run_t run = {.tree = tree, .opts = opts};
+    verify_pos_t resume = {0};
+    size_t first_pass = 0;
+    int rc = WTREE3_OK;
+
+    /* Indexes still being built have no entries to check yet */
+    size_t index_total = set->count;
+    run.indexes = malloc((index_total ? index_total : 1) * sizeof(wtree3_index_t *));
+    if (WTREE_UNLIKELY(!run.indexes)) {
+        set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate verify state");
+        return WTREE3_ENOMEM;
+    }
+    for (size_t i = 0; i < index_total; i++) {
+        wtree3_index_t *idx = set->items[i];
+        if (!idx->building) run.indexes[run.index_count++] = idx;
+    }
+
+    /* Read the resume point before the checkpoint (maybe the same struct) is reset */
+    if (cp) {
+        MDB_val key = {.mv_size = cp->key_len, .mv_data = (void *)cp->pos};
+        MDB_val data = {.mv_size = cp->data_len, .mv_data = (void *)(cp->pos + cp->key_len)};
+        bool here = cp->pass == 0;
+        first_pass = cp->pass == 0 ? 0 : 1;
+        for (size_t i = 0; cp->pass == 1 && i < run.index_count; i++) {
+            if (index_id(run.indexes[i]) == cp->index_id) {
+                first_pass = 1 + i;
+                here = true;
+                break;
+            }
+        }
+        /* The index was dropped since: redo the entry pass from its first index */
+        if (here && cp->key_len && pos_set(&resume, &key, cp->data_len ? &data : NULL) != 0) {
+            free(run.indexes);
+            set_error(error, WTREE3_LIB, WTREE3_ENOMEM, "Failed to allocate verify state");
+            return WTREE3_ENOMEM;
+        }
+    }
+    if (opts->checkpoint) opts->checkpoint->active = false;
+
+    MDB_envinfo info;
+    MDB_stat st;
+    MDB_txn *txn = NULL;
+    int mrc = mdb_env_info(tree->db->env, &info);
+    if (mrc == 0) mrc = mdb_env_stat(tree->db->env, &st);
+    if (mrc == 0) mrc = mdb_txn_begin(tree->db->env, NULL, MDB_RDONLY, &txn);
+    if (mrc == 0) {
+        MDB_stat tree_st;
+        mrc = mdb_stat(txn, tree->dbi, &tree_st);
+        if (mrc == 0) report->total_rows = tree_st.ms_entries;
+        mdb_txn_abort(txn);
+    }
+    if (WTREE_UNLIKELY(mrc != 0)) {
+        pos_free(&resume);
+        free(run.indexes);
+        return translate_mdb_error(mrc, error);
+    }
+    run.psize = st.ms_psize;
+    run.map_lo = (uintptr_t)info.me_mapaddr;
+    run.map_hi = run.map_lo + info.me_mapsize;
+
+    bool throttled = opts->rows_per_sec || opts->bytes_per_sec || opts->drop_pages;
+    run.chunk_rows = opts->chunk_rows ? opts->chunk_rows : (throttled ? VERIFY_THROTTLED_CHUNK : 0);
+    run.track_pages = opts->bytes_per_sec || opts->drop_pages;
+
+    bool locked = !sampling && opts->threads > 1;
+    if (locked && WTREE_UNLIKELY(wmutex_init(&run.lock) != 0)) {
+        pos_free(&resume);
+        free(run.indexes);
+        set_error(error, WTREE3_LIB, WTREE3_ERROR, "Failed to initialize verify lock");
+        return WTREE3_ERROR;
+    }
+
+    uint64_t rng = opts->seed ? opts->seed : wtime_now_ns() ^ (uint64_t)(uintptr_t)tree;
+    double est = 0;
+    size_t pass_count = run.index_count == 0 ? 0 : 1 + (opts->check_orphans ? run.index_count : 0);
+    bool complete = true;
+
+    for (size_t p = first_pass; p < pass_count; p++) {
+        wtree3_index_t *idx = p == 0 ? NULL : run.indexes[p - 1];
+        uint64_t used = report->rows_checked + report->entries_checked;
+        verify_pass_t out = {0};
+
+        if (watomic_load_u32(&run.stop) != 0 || (opts->max_rows && used >= opts->max_rows)) {
+            if (opts->checkpoint && !sampling) checkpoint_save(opts->checkpoint, p > 0, idx, NULL);
+            complete = false;
+            break;
+        }
+
+        uint64_t limit = opts->max_rows ? opts->max_rows - used : 0;
+        if (sampling) {
+            rc = sample_pass(&run, idx, limit, &rng, &out, error);
+            if (out.checked > 0) {
+                est += (double)out.mismatches * (double)out.total / (double)out.checked;
+            }
+        } else {
+            rc = walk_pass(&run, idx, p == first_pass ? &resume : NULL, limit, &out, error);
+        }
+
+        if (idx) {
+            report->entries_checked += out.checked;
+        } else {
+            report->rows_checked += out.checked;
+        }
+        if (!out.done) {
+            if (opts->checkpoint && !sampling) {
+                checkpoint_save(opts->checkpoint, p > 0, idx, &out.stop_pos);
+            }
+            pos_free(&out.stop_pos);
+            complete = false;
+            break;
+        }
+        pos_free(&out.stop_pos);
+        if (rc != 0) break;
+    }
+
+    report->mismatches = run.mismatches;
+    report->est_mismatches = sampling ? (uint64_t)(est + 0.5) : run.mismatches;
+    if (sampling && report->est_mismatches < run.mismatches) report->est_mismatches = run.mismatches;
+    report->complete = complete && rc == 0;
+
+    if (rc == 0 && run.mismatches > 0) {
+        error_copy(error, &run.first);
+        rc = WTREE3_INDEX_ERROR;
+    }
+
+    if (locked) wmutex_destroy(&run.lock);
+    pos_free(&resume);
+    free(run.indexes);
+    return rc;
+}
+
+/* Pinned for the whole check: the indexes being compared cannot be dropped meanwhile */
+WTREE_COLD WTREE_WARN_UNUSED
+int wtree3_tree_verify(wtree3_tree_t *tree,
+                       const wtree3_verify_opts_t *opts,
+                       wtree3_verify_report_t *report,
+                       gerror_t *error) {
+    if (WTREE_UNLIKELY(!tree)) {
+        set_error(error, WTREE3_LIB, WTREE3_EINVAL, "Tree cannot be NULL");
+        return WTREE3_EINVAL;
+    }
+
+    index_pin_t pin;
+    const index_set_t *set = index_set_pin(tree, &pin);
+    int rc = verify_tree_run(tree, set, opts, report, error);
+    index_set_unpin(&pin);
+    return rc;
+}
+
+static bool stop_at_first(const wtree3_verify_mismatch_t *mismatch, void *user_data) {
+    (void)mismatch;
+    (void)user_data;
+    return false;
+}
+
+WTREE_COLD WTREE_WARN_UNUSED
+int wtree3_verify_indexes(wtree3_tree_t *tree, gerror_t *error) {
+    wtree3_verify_opts_t opts = {
+        .check_orphans = true,
+        .on_mismatch = stop_at_first,
+    };
+    return wtree3_tree_verify(tree, &opts, NULL, error);
+}
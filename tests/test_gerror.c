@@ -185,6 +185,67 @@ static void test_error_long_message(void **state) {
     assert_true(strlen(error.message) < 256);
 }
 
+static void test_lazy_plain_message(void **state) {
+    (void)state;
+    gerror_t error = {.flags = GERROR_LAZY};
+
+    set_error(&error, "mylib", 7, "Key not found");
+
+    /* Code at once, message untouched until read */
+    assert_int_equal(7, error.code);
+    assert_string_equal("", error.message);
+    assert_string_equal("Key not found", error_message(&error));
+    assert_string_equal("mylib", error.lib);
+}
+
+static void test_lazy_formatted_message(void **state) {
+    (void)state;
+    gerror_t error = {.flags = GERROR_LAZY};
+    char name[16];
+    char buffer[256];
+
+    strcpy(name, "email_idx");
+    set_error(&error, "mylib", 3, "Index '%s' not found (%zu, %llu, 100%%, %02x)",
+              name, (size_t)42, 1ULL << 40, 10);
+    assert_string_equal("", error.message);
+
+    /* String arguments are copied when recorded */
+    strcpy(name, "changed");
+    assert_string_equal("mylib: Index 'email_idx' not found (42, 1099511627776, 100%, 0a)",
+                        error_message_ex(&error, buffer, sizeof(buffer)));
+}
+
+static void test_lazy_fallback_and_copy(void **state) {
+    (void)state;
+    gerror_t error = {.flags = GERROR_LAZY};
+
+    /* '*' widths cannot be recorded: formatted at once */
+    set_error(&error, "lib", 1, "%*d", 4, 5);
+    assert_string_equal("   5", error.message);
+
+    /* Too many arguments for the record: formatted at once too */
+    set_error(&error, "lib", 1, "%d %d %d %d %d", 1, 2, 3, 4, 5);
+    assert_string_equal("1 2 3 4 5", error.message);
+
+    /* A copy keeps the destination's mode and formats on read */
+    set_error(&error, "lib", 2, "Value %d", 9);
+    gerror_t eager = {0};
+    error_copy(&eager, &error);
+    assert_int_equal(0, eager.flags);
+    assert_int_equal(2, eager.code);
+    assert_string_equal("Value 9", error_message(&eager));
+
+    /* Clearing keeps the mode; switching it off materializes */
+    error_clear(&error);
+    assert_true(error.flags & GERROR_LAZY);
+    assert_string_equal("No error", error_message(&error));
+    set_error(&error, "lib", 3, "Pending");
+    error_set_lazy(&error, 0);
+    assert_string_equal("Pending", error.message);
+    set_error(&error, "lib", 4, "Eager %d", 1);
+    assert_string_equal("Eager 1", error.message);
+}
+
 int main(void) {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(test_error_initialization),
@@ -204,6 +265,9 @@ int main(void) {
         cmocka_unit_test(test_error_clear_null),
         cmocka_unit_test(test_error_overwrite),
         cmocka_unit_test(test_error_long_message),
+        cmocka_unit_test(test_lazy_plain_message),
+        cmocka_unit_test(test_lazy_formatted_message),
+        cmocka_unit_test(test_lazy_fallback_and_copy),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
@@ -0,0 +1,219 @@
+/*
+ * test_whash.c - Tests for whash (generic hash table)
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "whash.h"
+
+/* ============================================================
+ * Test Data Structures
+ * ============================================================ */
+
+typedef struct {
+    int id;
+    char name[32];
+} test_item_t;
+
+static int cleanup_count = 0;
+
+static void test_cleanup(void *element) {
+    free(element);
+    cleanup_count++;
+}
+
+static bool item_has_id(const void *element, const void *key) {
+    return ((const test_item_t *)element)->id == *(const int *)key;
+}
+
+static bool item_has_name(const void *element, const void *key) {
+    return strcmp(((const test_item_t *)element)->name, (const char *)key) == 0;
+}
+
+static test_item_t *make_item(int id) {
+    test_item_t *item = malloc(sizeof(test_item_t));
+    assert_non_null(item);
+    item->id = id;
+    snprintf(item->name, sizeof(item->name), "item_%d", id);
+    return item;
+}
+
+/* Constant hash: every element lands in one probe run */
+#define SAME_HASH 42
+
+/* ============================================================
+ * Tests
+ * ============================================================ */
+
+static void test_create_destroy(void **state) {
+    (void)state;
+
+    whash_t *map = whash_create(0, NULL);
+    assert_non_null(map);
+    assert_int_equal(whash_size(map), 0);
+    whash_destroy(map);
+
+    map = whash_create(1000, NULL);
+    assert_non_null(map);
+    whash_destroy(map);
+
+    whash_destroy(NULL);
+    assert_int_equal(whash_size(NULL), 0);
+}
+
+static void test_put_get_grow(void **state) {
+    (void)state;
+    cleanup_count = 0;
+
+    whash_t *map = whash_create(0, test_cleanup);
+    assert_non_null(map);
+
+    for (int i = 0; i < 1000; i++) {
+        assert_true(whash_put(map, whash_u64((uint64_t)i), make_item(i)));
+    }
+    assert_int_equal(whash_size(map), 1000);
+
+    for (int i = 0; i < 1000; i++) {
+        test_item_t *item = whash_get(map, whash_u64((uint64_t)i), &i, item_has_id);
+        assert_non_null(item);
+        assert_int_equal(item->id, i);
+    }
+    int missing = 1000;
+    assert_null(whash_get(map, whash_u64(1000), &missing, item_has_id));
+
+    whash_destroy(map);
+    assert_int_equal(cleanup_count, 1000);
+}
+
+static void test_string_keys(void **state) {
+    (void)state;
+
+    whash_t *map = whash_create(4, test_cleanup);
+    for (int i = 0; i < 50; i++) {
+        test_item_t *item = make_item(i);
+        assert_true(whash_put(map, whash_string(item->name), item));
+    }
+
+    test_item_t *item = whash_get(map, whash_string("item_17"), "item_17", item_has_name);
+    assert_non_null(item);
+    assert_int_equal(item->id, 17);
+    assert_null(whash_get(map, whash_string("item_50"), "item_50", item_has_name));
+
+    assert_true(whash_bytes("item_17", 7) == whash_string("item_17"));
+    whash_destroy(map);
+}
+
+static void test_remove_collisions(void **state) {
+    (void)state;
+
+    /* All in one run: removal must keep later entries reachable */
+    whash_t *map = whash_create(0, test_cleanup);
+    for (int i = 0; i < 20; i++) {
+        assert_true(whash_put(map, SAME_HASH, make_item(i)));
+    }
+
+    for (int i = 0; i < 20; i += 2) {
+        test_item_t *item = whash_remove(map, SAME_HASH, &i, item_has_id);
+        assert_non_null(item);
+        assert_int_equal(item->id, i);
+        free(item);  /* Cleanup function is not called on remove */
+    }
+    assert_int_equal(whash_size(map), 10);
+
+    for (int i = 0; i < 20; i++) {
+        test_item_t *item = whash_get(map, SAME_HASH, &i, item_has_id);
+        if (i % 2) {
+            assert_non_null(item);
+            assert_int_equal(item->id, i);
+        } else {
+            assert_null(item);
+        }
+    }
+
+    int missing = 100;
+    assert_null(whash_remove(map, SAME_HASH, &missing, item_has_id));
+    whash_destroy(map);
+}
+
+static void test_remove_wraparound(void **state) {
+    (void)state;
+
+    /* Hashes near the end of the slot array wrap their probe runs to slot 0 */
+    whash_t *map = whash_create(0, test_cleanup);
+    for (int i = 0; i < 5; i++) {
+        assert_true(whash_put(map, (uint64_t)(6 + (i % 2)), make_item(i)));
+    }
+
+    for (int i = 0; i < 5; i++) {
+        test_item_t *item = whash_remove(map, (uint64_t)(6 + (i % 2)), &i, item_has_id);
+        assert_non_null(item);
+        free(item);
+        for (int j = i + 1; j < 5; j++) {
+            assert_non_null(whash_get(map, (uint64_t)(6 + (j % 2)), &j, item_has_id));
+        }
+    }
+    assert_int_equal(whash_size(map), 0);
+    whash_destroy(map);
+}
+
+static void test_clear(void **state) {
+    (void)state;
+    cleanup_count = 0;
+
+    whash_t *map = whash_create(0, test_cleanup);
+    for (int i = 0; i < 10; i++) {
+        assert_true(whash_put(map, whash_u64((uint64_t)i), make_item(i)));
+    }
+    whash_clear(map);
+    assert_int_equal(cleanup_count, 10);
+    assert_int_equal(whash_size(map), 0);
+
+    int key = 3;
+    assert_null(whash_get(map, whash_u64(3), &key, item_has_id));
+
+    /* Reusable after clear */
+    assert_true(whash_put(map, whash_u64(3), make_item(3)));
+    assert_non_null(whash_get(map, whash_u64(3), &key, item_has_id));
+    whash_destroy(map);
+    assert_int_equal(cleanup_count, 11);
+}
+
+static void test_null_params(void **state) {
+    (void)state;
+
+    int key = 1;
+    assert_false(whash_put(NULL, 1, &key));
+    assert_null(whash_get(NULL, 1, &key, item_has_id));
+    assert_null(whash_remove(NULL, 1, &key, item_has_id));
+    whash_clear(NULL);
+
+    whash_t *map = whash_create(0, NULL);
+    assert_false(whash_put(map, 1, NULL));
+    assert_null(whash_get(map, 1, &key, NULL));
+    whash_destroy(map);
+}
+
+/* ============================================================
+ * Main
+ * ============================================================ */
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_create_destroy),
+        cmocka_unit_test(test_put_get_grow),
+        cmocka_unit_test(test_string_keys),
+        cmocka_unit_test(test_remove_collisions),
+        cmocka_unit_test(test_remove_wraparound),
+        cmocka_unit_test(test_clear),
+        cmocka_unit_test(test_null_params),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,128 @@
+/*
+ * test_wsort.c - Tests for wsort (stable sort with comparator context)
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wsort.h"
+
+/* ============================================================
+ * Test Data Structures
+ * ============================================================ */
+
+typedef struct {
+    int key;
+    int seq;    /* Original position, to check stability */
+} pair_t;
+
+static int compare_ints(const void *a, const void *b, void *ctx) {
+    int *calls = (int *)ctx;
+    if (calls) (*calls)++;
+    int ia = *(const int *)a;
+    int ib = *(const int *)b;
+    return ia == ib ? 0 : (ia < ib ? -1 : 1);
+}
+
+static int compare_ints_desc(const void *a, const void *b, void *ctx) {
+    return compare_ints(b, a, ctx);
+}
+
+static int compare_pairs(const void *a, const void *b, void *ctx) {
+    (void)ctx;
+    const pair_t *pa = (const pair_t *)a;
+    const pair_t *pb = (const pair_t *)b;
+    return pa->key == pb->key ? 0 : (pa->key < pb->key ? -1 : 1);
+}
+
+/* ============================================================
+ * Tests
+ * ============================================================ */
+
+static void test_sort_empty_and_single(void **state) {
+    (void)state;
+    int one = 42;
+    assert_true(wsort(NULL, 0, sizeof(int), compare_ints, NULL));
+    assert_true(wsort(&one, 1, sizeof(int), compare_ints, NULL));
+    assert_int_equal(42, one);
+    assert_true(wsort_is_sorted(&one, 1, sizeof(int), compare_ints, NULL));
+}
+
+static void test_sort_random_ints(void **state) {
+    (void)state;
+    const size_t n = 5000;
+    int *values = malloc(n * sizeof(int));
+    assert_non_null(values);
+
+    srand(12345);
+    for (size_t i = 0; i < n; i++) values[i] = rand() % 1000;
+
+    assert_false(wsort_is_sorted(values, n, sizeof(int), compare_ints, NULL));
+    assert_true(wsort(values, n, sizeof(int), compare_ints, NULL));
+    assert_true(wsort_is_sorted(values, n, sizeof(int), compare_ints, NULL));
+
+    free(values);
+}
+
+static void test_sort_context_passed(void **state) {
+    (void)state;
+    int values[] = {5, 3, 9, 1, 7, 2, 8};
+    int calls = 0;
+
+    assert_true(wsort(values, 7, sizeof(int), compare_ints_desc, &calls));
+    assert_true(calls > 0);
+    assert_int_equal(9, values[0]);
+    assert_int_equal(1, values[6]);
+}
+
+static void test_sort_is_stable(void **state) {
+    (void)state;
+    const size_t n = 300;
+    pair_t pairs[300];
+    for (size_t i = 0; i < n; i++) {
+        pairs[i].key = (int)((i * 7) % 10);
+        pairs[i].seq = (int)i;
+    }
+
+    assert_true(wsort(pairs, n, sizeof(pair_t), compare_pairs, NULL));
+
+    for (size_t i = 1; i < n; i++) {
+        assert_true(pairs[i - 1].key <= pairs[i].key);
+        if (pairs[i - 1].key == pairs[i].key) {
+            assert_true(pairs[i - 1].seq < pairs[i].seq);
+        }
+    }
+}
+
+static void test_sort_already_sorted(void **state) {
+    (void)state;
+    int values[64];
+    for (int i = 0; i < 64; i++) values[i] = i;
+    int calls = 0;
+
+    assert_true(wsort(values, 64, sizeof(int), compare_ints, &calls));
+    /* Pre-sorted input is detected with a single linear pass */
+    assert_int_equal(63, calls);
+}
+
+/* ============================================================
+ * Main
+ * ============================================================ */
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_sort_empty_and_single),
+        cmocka_unit_test(test_sort_random_ints),
+        cmocka_unit_test(test_sort_context_passed),
+        cmocka_unit_test(test_sort_is_stable),
+        cmocka_unit_test(test_sort_already_sorted),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,397 @@
+/*
+ * test_wtree3_async.c - Tests for asynchronous reads
+ *
+ * Tests that:
+ * - Lookups whose pages are resident complete inline, before the submit
+ *   call returns (where mincore is available)
+ * - Worker completions report values, misses and get_many positions
+ * - Polled completions wait for wtree3_async_poll() and signal the fd
+ * - Index gets deliver every match, then a final completion
+ * - A full queue makes the submitter run its own request, and destroy
+ *   completes everything still pending
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+    #include <process.h>
+    #define mkdir(path, mode) _mkdir(path)
+    #define getpid() _getpid()
+#else
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #include <poll.h>
+#endif
+
+#include "wtree3.h"
+#include "wthread.h"
+
+#define ROWS 200
+
+/* Test database path */
+static char test_db_path[256];
+static wtree3_db_t *test_db = NULL;
+static wtree3_tree_t *test_tree = NULL;
+
+static bool prefix_extractor(const void *value, size_t value_len,
+                             void *user_data,
+                             void **out_key, size_t *out_len);
+
+/* ============================================================
+ * Test Fixtures
+ * ============================================================ */
+
+static int setup_db(void **state) {
+    (void)state;
+
+#ifdef _WIN32
+    snprintf(test_db_path, sizeof(test_db_path), "%s\\test_wtree3_async_%d",
+             getenv("TEMP"), getpid());
+#else
+    snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_wtree3_async_%d", getpid());
+#endif
+    mkdir(test_db_path, 0755);
+
+    gerror_t error = {0};
+    test_db = wtree3_db_open(test_db_path, 64 * 1024 * 1024, 32, WTREE3_VERSION(1, 0), 0, &error);
+    if (!test_db) {
+        fprintf(stderr, "Failed to create test database: %s\n", error.message);
+        return -1;
+    }
+    if (wtree3_db_register_key_extractor(test_db, WTREE3_VERSION(1, 0), 0x00,
+                                         prefix_extractor, &error) != WTREE3_OK) {
+        fprintf(stderr, "Failed to register extractor: %s\n", error.message);
+        return -1;
+    }
+
+    test_tree = wtree3_tree_open(test_db, "items", 0, 0, &error);
+    if (!test_tree) return -1;
+    wtree3_index_config_t group = {.name = "group_idx"};
+    if (wtree3_tree_add_index(test_tree, &group, &error) != WTREE3_OK) return -1;
+
+    for (int i = 0; i < ROWS; i++) {
+        char key[16], value[32];
+        snprintf(key, sizeof(key), "k%04d", i);
+        int len = snprintf(value, sizeof(value), "g%02d|row-%d", i % 10, i);
+        if (wtree3_insert_one(test_tree, key, strlen(key), value, (size_t)len, &error) != WTREE3_OK) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int teardown_db(void **state) {
+    (void)state;
+
+    if (test_tree) wtree3_tree_close(test_tree);
+    test_tree = NULL;
+    if (test_db) wtree3_db_close(test_db);
+    test_db = NULL;
+
+    char cmd[512];
+#ifdef _WIN32
+    snprintf(cmd, sizeof(cmd), "rd /s /q \"%s\"", test_db_path);
+#else
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", test_db_path);
+#endif
+    (void)system(cmd);
+    return 0;
+}
+
+/* Index the value up to its first '|' */
+static bool prefix_extractor(const void *value, size_t value_len,
+                             void *user_data,
+                             void **out_key, size_t *out_len) {
+    (void)user_data;
+    const char *bar = memchr(value, '|', value_len);
+    size_t len = bar ? (size_t)(bar - (const char *)value) : value_len;
+    if (len == 0) return false;
+
+    char *key = malloc(len);
+    if (!key) return false;
+    memcpy(key, value, len);
+    *out_key = key;
+    *out_len = len;
+    return true;
+}
+
+/* Completion counters (callbacks may run on workers) */
+typedef struct {
+    uint64_t found;
+    uint64_t missing;
+    uint64_t errors;
+    uint64_t bad_value;
+    uint64_t lasts;
+    uint64_t bad_index;
+} done_ctx_t;
+
+/* Checks that a found value belongs to its key: k0042 -> "g02|row-42" */
+static void on_done(const wtree3_async_result_t *r, void *user_data) {
+    done_ctx_t *ctx = (done_ctx_t *)user_data;
+    if (r->last) watomic_add_u64(&ctx->lasts, 1);
+
+    if (r->rc == WTREE3_NOT_FOUND) {
+        watomic_add_u64(&ctx->missing, 1);
+        return;
+    }
+    if (r->rc != WTREE3_OK) {
+        watomic_add_u64(&ctx->errors, 1);
+        return;
+    }
+    watomic_add_u64(&ctx->found, 1);
+
+    int n = atoi((const char *)r->key + 1);
+    char expect[32];
+    int len = snprintf(expect, sizeof(expect), "g%02d|row-%d", n % 10, n);
+    if (r->value_len != (size_t)len || memcmp(r->value, expect, (size_t)len) != 0) {
+        watomic_add_u64(&ctx->bad_value, 1);
+    }
+}
+
+/* ============================================================
+ * Inline Completion
+ * ============================================================ */
+
+static void test_inline_hit(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_async_t *as = wtree3_async_create(test_db, NULL, &error);
+    assert_non_null(as);
+
+    /* Warm the path, then the same lookup is all resident */
+    void *value = NULL;
+    size_t value_len = 0;
+    assert_int_equal(WTREE3_OK, wtree3_get(test_tree, "k0042", 5, &value, &value_len, &error));
+    free(value);
+
+    done_ctx_t ctx = {0};
+    assert_int_equal(WTREE3_OK, wtree3_async_get(as, test_tree, "k0042", 5, on_done, &ctx, &error));
+
+    wtree3_async_stats_t stats;
+    wtree3_async_stats(as, &stats);
+#if defined(__linux__)
+    assert_int_equal(1, stats.inline_hits);
+    assert_int_equal(1, ctx.found);        /* Already called back */
+#endif
+    wtree3_async_destroy(as);
+
+    assert_int_equal(1, ctx.found);
+    assert_int_equal(0, ctx.bad_value);
+    assert_int_equal(1, ctx.lasts);
+}
+
+/* ============================================================
+ * Worker Completion
+ * ============================================================ */
+
+static void test_worker_gets(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_async_config_t config = {.workers = 3, .flags = WTREE3_ASYNC_NO_INLINE};
+    wtree3_async_t *as = wtree3_async_create(test_db, &config, &error);
+    assert_non_null(as);
+
+    done_ctx_t ctx = {0};
+    for (int i = 0; i < ROWS + 20; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "k%04d", i);
+        assert_int_equal(WTREE3_OK, wtree3_async_get(as, test_tree, key, strlen(key),
+                                                     on_done, &ctx, &error));
+    }
+    wtree3_async_destroy(as);      /* Completes everything pending */
+
+    assert_int_equal(ROWS, ctx.found);
+    assert_int_equal(20, ctx.missing);
+    assert_int_equal(0, ctx.errors);
+    assert_int_equal(0, ctx.bad_value);
+    assert_int_equal(ROWS + 20, ctx.lasts);
+}
+
+typedef struct {
+    size_t next_index;
+    int out_of_order;
+    int lasts;
+    int found;
+} many_ctx_t;
+
+static void on_many(const wtree3_async_result_t *r, void *user_data) {
+    many_ctx_t *ctx = (many_ctx_t *)user_data;
+    if (r->index != ctx->next_index++) ctx->out_of_order++;
+    if (r->last) ctx->lasts++;
+    if (r->rc == WTREE3_OK) ctx->found++;
+}
+
+static void test_get_many(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    for (int mode = 0; mode < 2; mode++) {
+        wtree3_async_config_t config = {.flags = mode ? WTREE3_ASYNC_NO_INLINE : 0};
+        wtree3_async_t *as = wtree3_async_create(test_db, &config, &error);
+        assert_non_null(as);
+
+        MDB_val keys[4] = {
+            {.mv_size = 5, .mv_data = "k0150"},
+            {.mv_size = 5, .mv_data = "k0003"},
+            {.mv_size = 5, .mv_data = "nope!"},
+            {.mv_size = 5, .mv_data = "k0077"},
+        };
+        many_ctx_t ctx = {0};
+        assert_int_equal(WTREE3_OK, wtree3_async_get_many(as, test_tree, keys, 4, on_many, &ctx, &error));
+        wtree3_async_destroy(as);
+
+        assert_int_equal(4, ctx.next_index);
+        assert_int_equal(0, ctx.out_of_order);
+        assert_int_equal(1, ctx.lasts);
+        assert_int_equal(3, ctx.found);
+    }
+}
+
+/* ============================================================
+ * Polled Completion
+ * ============================================================ */
+
+static void test_poll_mode(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_async_config_t config = {.flags = WTREE3_ASYNC_POLL | WTREE3_ASYNC_NO_INLINE};
+    wtree3_async_t *as = wtree3_async_create(test_db, &config, &error);
+    assert_non_null(as);
+
+    done_ctx_t ctx = {0};
+    for (int i = 0; i < 50; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "k%04d", i * 3);
+        assert_int_equal(WTREE3_OK, wtree3_async_get(as, test_tree, key, strlen(key),
+                                                     on_done, &ctx, &error));
+    }
+
+    /* Nothing runs until polled; the fd says when there is something */
+    size_t ran = 0;
+    for (int spin = 0; spin < 1000 && ran < 50; spin++) {
+#ifndef _WIN32
+        int fd = wtree3_async_fd(as);
+        assert_true(fd >= 0);
+        struct pollfd pfd = {.fd = fd, .events = POLLIN};
+        (void)poll(&pfd, 1, 10);
+#endif
+        ran += wtree3_async_poll(as, 0);
+    }
+    assert_int_equal(50, ran);
+    assert_int_equal(50, ctx.found);
+    assert_int_equal(0, ctx.bad_value);
+    assert_int_equal(0, wtree3_async_poll(as, 0));
+
+    wtree3_async_destroy(as);
+}
+
+/* ============================================================
+ * Index Gets
+ * ============================================================ */
+
+typedef struct {
+    uint64_t matches;
+    uint64_t bad_group;
+    uint64_t finals;
+    uint64_t final_count;
+    int final_rc;
+} index_ctx_t;
+
+static void on_index(const wtree3_async_result_t *r, void *user_data) {
+    index_ctx_t *ctx = (index_ctx_t *)user_data;
+    if (r->last) {
+        ctx->finals++;
+        ctx->final_count = r->index;
+        ctx->final_rc = r->rc;
+        return;
+    }
+    ctx->matches++;
+    if (r->value_len < 3 || memcmp(r->value, "g07", 3) != 0) ctx->bad_group++;
+}
+
+static void test_index_get(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_async_t *as = wtree3_async_create(test_db, NULL, &error);
+    assert_non_null(as);
+
+    index_ctx_t ctx = {0};
+    assert_int_equal(WTREE3_OK, wtree3_async_index_get(as, test_tree, "group_idx", "g07", 3,
+                                                       on_index, &ctx, &error));
+    index_ctx_t missing = {0};
+    assert_int_equal(WTREE3_OK, wtree3_async_index_get(as, test_tree, "nope_idx", "g07", 3,
+                                                       on_index, &missing, &error));
+    wtree3_async_destroy(as);
+
+    assert_int_equal(ROWS / 10, ctx.matches);
+    assert_int_equal(0, ctx.bad_group);
+    assert_int_equal(1, ctx.finals);
+    assert_int_equal(ROWS / 10, ctx.final_count);
+    assert_int_equal(WTREE3_OK, ctx.final_rc);
+
+    assert_int_equal(0, missing.matches);
+    assert_int_equal(1, missing.finals);
+    assert_int_equal(WTREE3_NOT_FOUND, missing.final_rc);
+}
+
+/* ============================================================
+ * Backpressure
+ * ============================================================ */
+
+static void test_full_queue(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_async_config_t config = {.workers = 1, .max_pending = 2, .flags = WTREE3_ASYNC_NO_INLINE};
+    wtree3_async_t *as = wtree3_async_create(test_db, &config, &error);
+    assert_non_null(as);
+
+    done_ctx_t ctx = {0};
+    for (int i = 0; i < ROWS; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "k%04d", i);
+        assert_int_equal(WTREE3_OK, wtree3_async_get(as, test_tree, key, strlen(key),
+                                                     on_done, &ctx, &error));
+    }
+
+    wtree3_async_stats_t stats;
+    wtree3_async_stats(as, &stats);
+    assert_int_equal(ROWS, stats.queued + stats.caller_runs);
+    assert_int_equal(0, stats.inline_hits);
+
+    wtree3_async_destroy(as);
+    assert_int_equal(ROWS, ctx.found);
+    assert_int_equal(0, ctx.bad_value);
+
+    /* Bad arguments are refused outright */
+    assert_int_equal(WTREE3_EINVAL, wtree3_async_get(NULL, test_tree, "k", 1, on_done, &ctx, &error));
+}
+
+/* ============================================================
+ * Main
+ * ============================================================ */
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_inline_hit),
+        cmocka_unit_test(test_worker_gets),
+        cmocka_unit_test(test_get_many),
+        cmocka_unit_test(test_poll_mode),
+        cmocka_unit_test(test_index_get),
+        cmocka_unit_test(test_full_queue),
+    };
+
+    return cmocka_run_group_tests(tests, setup_db, teardown_db);
+}
@@ -0,0 +1,444 @@
+/*
+ * test_wtree3_batch.c - Tests for cross-tree write batches
+ *
+ * Tests that:
+ * - One batch writes several trees and their indexes, whatever order
+ *   the ops were added in
+ * - Ops on one key fold in order: insert + update is the update,
+ *   insert + delete leaves nothing, upserts merge
+ * - Any failing op (existing key, missing key, unique violation) leaves
+ *   the database untouched after wtree3_batch_commit
+ * - A unique index key can move from one row to another in one batch
+ * - Index entries follow the net change of each row
+ * - apply_txn composes with other writes in the caller's transaction
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+    #include <process.h>
+    #define mkdir(path, mode) _mkdir(path)
+    #define getpid() _getpid()
+#else
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "wtree3.h"
+
+#define ROWS 500
+
+/* Test database path */
+static char test_db_path[256];
+static wtree3_db_t *test_db = NULL;
+
+/* ============================================================
+ * Test Fixtures
+ * ============================================================ */
+
+/* Index the value up to its first '|' */
+static bool prefix_extractor(const void *value, size_t value_len,
+                             void *user_data,
+                             void **out_key, size_t *out_len) {
+    (void)user_data;
+    const char *bar = memchr(value, '|', value_len);
+    size_t len = bar ? (size_t)(bar - (const char *)value) : value_len;
+    if (len == 0) return false;
+
+    char *key = malloc(len);
+    if (!key) return false;
+    memcpy(key, value, len);
+    *out_key = key;
+    *out_len = len;
+    return true;
+}
+
+static int setup_db(void **state) {
+    (void)state;
+
+#ifdef _WIN32
+    snprintf(test_db_path, sizeof(test_db_path), "%s\\test_wtree3_batch_%d",
+             getenv("TEMP"), getpid());
+#else
+    snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_wtree3_batch_%d", getpid());
+#endif
+    mkdir(test_db_path, 0755);
+
+    gerror_t error = {0};
+    test_db = wtree3_db_open(test_db_path, 64 * 1024 * 1024, 64, WTREE3_VERSION(1, 0), 0, &error);
+    if (!test_db) {
+        fprintf(stderr, "Failed to create test database: %s\n", error.message);
+        return -1;
+    }
+
+    for (uint32_t flags = 0; flags <= 0x03; flags++) {
+        if (wtree3_db_register_key_extractor(test_db, WTREE3_VERSION(1, 0), flags,
+                                             prefix_extractor, &error) != WTREE3_OK) {
+            fprintf(stderr, "Failed to register extractor: %s\n", error.message);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int teardown_db(void **state) {
+    (void)state;
+
+    if (test_db) wtree3_db_close(test_db);
+    test_db = NULL;
+
+    char cmd[512];
+#ifdef _WIN32
+    snprintf(cmd, sizeof(cmd), "rd /s /q \"%s\"", test_db_path);
+#else
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", test_db_path);
+#endif
+    (void)system(cmd);
+    return 0;
+}
+
+/* Tree with one index on the value prefix */
+static wtree3_tree_t *open_indexed(const char *name, const char *index_name, bool unique) {
+    gerror_t error = {0};
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, name, 0, 0, &error);
+    assert_non_null(tree);
+    wtree3_index_config_t config = {.name = index_name, .unique = unique};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &config, &error));
+    return tree;
+}
+
+/* ============================================================
+ * Helpers
+ * ============================================================ */
+
+typedef struct {
+    size_t count;
+    char last_key[32];
+} match_t;
+
+static bool collect_match(const void *index_key, size_t index_key_len,
+                          const void *main_key, size_t main_key_len,
+                          const void *value, size_t value_len,
+                          void *user_data) {
+    (void)index_key; (void)index_key_len; (void)value; (void)value_len;
+    match_t *m = (match_t *)user_data;
+    m->count++;
+    size_t n = main_key_len < sizeof(m->last_key) - 1 ? main_key_len : sizeof(m->last_key) - 1;
+    memcpy(m->last_key, main_key, n);
+    m->last_key[n] = '\0';
+    return true;
+}
+
+/* Rows whose index key is key; *last gets the main key of the last one */
+static match_t index_matches(wtree3_tree_t *tree, const char *index_name, const char *key) {
+    gerror_t error = {0};
+    match_t m = {0};
+    assert_int_equal(WTREE3_OK, wtree3_index_get_many(tree, index_name, key, strlen(key), 0,
+                                                      collect_match, &m, &error));
+    return m;
+}
+
+/* Stored value of key as a string ("" if missing) */
+static void value_of(wtree3_tree_t *tree, const char *key, char *out, size_t out_len) {
+    gerror_t error = {0};
+    void *value;
+    size_t value_len;
+    out[0] = '\0';
+    if (wtree3_get(tree, key, strlen(key), &value, &value_len, &error) != WTREE3_OK) return;
+    size_t n = value_len < out_len - 1 ? value_len : out_len - 1;
+    memcpy(out, value, n);
+    out[n] = '\0';
+    free(value);
+}
+
+static void add_str(int (*add)(wtree3_batch_t *, wtree3_tree_t *, const void *, size_t,
+                               const void *, size_t, gerror_t *),
+                    wtree3_batch_t *batch, wtree3_tree_t *tree,
+                    const char *key, const char *value) {
+    gerror_t error = {0};
+    assert_int_equal(WTREE3_OK, add(batch, tree, key, strlen(key), value, strlen(value), &error));
+}
+
+static void *add_i64(const void *existing, size_t existing_len,
+                     const void *operand, size_t operand_len,
+                     void *user_data, size_t *out_len) {
+    (void)user_data;
+    if (existing_len != sizeof(int64_t) || operand_len != sizeof(int64_t)) return NULL;
+    int64_t a, b;
+    memcpy(&a, existing, sizeof(a));
+    memcpy(&b, operand, sizeof(b));
+    a += b;
+    void *out = malloc(sizeof(a));
+    if (!out) return NULL;
+    memcpy(out, &a, sizeof(a));
+    *out_len = sizeof(a);
+    return out;
+}
+
+/* ============================================================
+ * Tests
+ * ============================================================ */
+
+static void test_cross_tree_commit(void **state) {
+    (void)state;
+    gerror_t error = {0};
+    wtree3_tree_t *users = open_indexed("users", "email_idx", true);
+    wtree3_tree_t *orders = open_indexed("orders", "customer_idx", false);
+
+    wtree3_batch_t *batch = wtree3_batch_create(test_db, &error);
+    assert_non_null(batch);
+
+    /* Descending keys, trees interleaved: the batch sorts them itself */
+    for (int i = ROWS - 1; i >= 0; i--) {
+        char key[16], value[48];
+        snprintf(key, sizeof(key), "u%04d", i);
+        snprintf(value, sizeof(value), "user%d@example.com|name-%d", i, i);
+        add_str(wtree3_batch_insert, batch, users, key, value);
+
+        snprintf(key, sizeof(key), "o%04d", i);
+        snprintf(value, sizeof(value), "u%04d|item-%d", i % 50, i);
+        add_str(wtree3_batch_insert, batch, orders, key, value);
+    }
+    assert_int_equal(2 * ROWS, wtree3_batch_count(batch));
+
+    /* Nothing is written before the batch is applied */
+    assert_int_equal(0, wtree3_tree_count(users));
+
+    assert_int_equal(WTREE3_OK, wtree3_batch_commit(batch, &error));
+    assert_int_equal(ROWS, wtree3_tree_count(users));
+    assert_int_equal(ROWS, wtree3_tree_count(orders));
+
+    char value[64];
+    value_of(users, "u0123", value, sizeof(value));
+    assert_string_equal("user123@example.com|name-123", value);
+
+    match_t m = index_matches(users, "email_idx", "user77@example.com");
+    assert_int_equal(1, m.count);
+    assert_string_equal("u0077", m.last_key);
+
+    m = index_matches(orders, "customer_idx", "u0007");
+    assert_int_equal(ROWS / 50, m.count);
+
+    wtree3_batch_clear(batch);
+    assert_int_equal(0, wtree3_batch_count(batch));
+    assert_int_equal(WTREE3_OK, wtree3_batch_commit(batch, &error));
+
+    wtree3_batch_free(batch);
+    wtree3_tree_close(users);
+    wtree3_tree_close(orders);
+}
+
+static void test_ops_fold_per_key(void **state) {
+    (void)state;
+    gerror_t error = {0};
+    wtree3_tree_t *tree = open_indexed("fold", "tag_idx", false);
+    wtree3_tree_t *counters = wtree3_tree_open(test_db, "fold_counters", 0, 0, &error);
+    assert_non_null(counters);
+    wtree3_tree_set_merge_fn(counters, add_i64, NULL);
+
+    assert_int_equal(WTREE3_OK, wtree3_insert_one(tree, "kept", 4, "a|old", 5, &error));
+    assert_int_equal(WTREE3_OK, wtree3_insert_one(tree, "gone", 4, "a|old", 5, &error));
+    int64_t one = 1;
+    assert_int_equal(WTREE3_OK, wtree3_insert_one(counters, "hits", 4, &one, sizeof(one), &error));
+
+    wtree3_batch_t *batch = wtree3_batch_create(test_db, &error);
+    assert_non_null(batch);
+
+    add_str(wtree3_batch_insert, batch, tree, "new", "b|first");
+    add_str(wtree3_batch_update, batch, tree, "new", "c|second");
+    add_str(wtree3_batch_insert, batch, tree, "temp", "b|temp");
+    assert_int_equal(WTREE3_OK, wtree3_batch_delete(batch, tree, "temp", 4, &error));
+    add_str(wtree3_batch_update, batch, tree, "kept", "b|mid");
+    add_str(wtree3_batch_upsert, batch, tree, "kept", "a|new");
+    assert_int_equal(WTREE3_OK, wtree3_batch_delete(batch, tree, "gone", 4, &error));
+    add_str(wtree3_batch_insert, batch, tree, "gone", "c|again");
+    assert_int_equal(WTREE3_OK, wtree3_batch_delete(batch, tree, "never", 5, &error));
+
+    for (int64_t i = 0; i < 10; i++) {
+        assert_int_equal(WTREE3_OK, wtree3_batch_upsert(batch, counters, "hits", 4,
+                                                        &i, sizeof(i), &error));
+    }
+    int64_t seed = 100;
+    assert_int_equal(WTREE3_OK, wtree3_batch_upsert(batch, counters, "fresh", 5,
+                                                    &seed, sizeof(seed), &error));
+    assert_int_equal(WTREE3_OK, wtree3_batch_upsert(batch, counters, "fresh", 5,
+                                                    &one, sizeof(one), &error));
+
+    assert_int_equal(WTREE3_OK, wtree3_batch_commit(batch, &error));
+
+    char value[64];
+    value_of(tree, "new", value, sizeof(value));
+    assert_string_equal("c|second", value);
+    value_of(tree, "temp", value, sizeof(value));
+    assert_string_equal("", value);
+    value_of(tree, "kept", value, sizeof(value));
+    assert_string_equal("a|new", value);
+    value_of(tree, "gone", value, sizeof(value));
+    assert_string_equal("c|again", value);
+    assert_int_equal(3, wtree3_tree_count(tree));
+
+    /* Index entries follow the net change of each row */
+    assert_int_equal(1, index_matches(tree, "tag_idx", "a").count);
+    assert_int_equal(0, index_matches(tree, "tag_idx", "b").count);
+    assert_int_equal(2, index_matches(tree, "tag_idx", "c").count);
+
+    void *raw;
+    size_t raw_len;
+    int64_t total;
+    assert_int_equal(WTREE3_OK, wtree3_get(counters, "hits", 4, &raw, &raw_len, &error));
+    memcpy(&total, raw, sizeof(total));
+    free(raw);
+    assert_int_equal(1 + 45, total);
+    assert_int_equal(WTREE3_OK, wtree3_get(counters, "fresh", 5, &raw, &raw_len, &error));
+    memcpy(&total, raw, sizeof(total));
+    free(raw);
+    assert_int_equal(101, total);
+
+    wtree3_batch_free(batch);
+    wtree3_tree_close(tree);
+    wtree3_tree_close(counters);
+}
+
+static void test_failure_writes_nothing(void **state) {
+    (void)state;
+    gerror_t error = {0};
+    wtree3_tree_t *users = open_indexed("fail_users", "email_idx", true);
+    wtree3_tree_t *log = wtree3_tree_open(test_db, "fail_log", 0, 0, &error);
+    assert_non_null(log);
+    assert_int_equal(WTREE3_OK, wtree3_insert_one(users, "u1", 2, "a@x|one", 7, &error));
+
+    wtree3_batch_t *batch = wtree3_batch_create(test_db, &error);
+    assert_non_null(batch);
+
+    /* Insert of an existing key */
+    add_str(wtree3_batch_insert, batch, log, "entry", "ok");
+    add_str(wtree3_batch_insert, batch, users, "u2", "b@x|two");
+    add_str(wtree3_batch_insert, batch, users, "u1", "c@x|dup");
+    assert_int_equal(WTREE3_KEY_EXISTS, wtree3_batch_commit(batch, &error));
+
+    /* Update of a missing key */
+    wtree3_batch_clear(batch);
+    add_str(wtree3_batch_insert, batch, log, "entry", "ok");
+    add_str(wtree3_batch_update, batch, users, "u9", "d@x|nine");
+    assert_int_equal(WTREE3_NOT_FOUND, wtree3_batch_commit(batch, &error));
+
+    /* Unique violation against a stored row, then within the batch */
+    wtree3_batch_clear(batch);
+    add_str(wtree3_batch_insert, batch, log, "entry", "ok");
+    add_str(wtree3_batch_insert, batch, users, "u3", "a@x|three");
+    assert_int_equal(WTREE3_INDEX_ERROR, wtree3_batch_commit(batch, &error));
+
+    wtree3_batch_clear(batch);
+    add_str(wtree3_batch_insert, batch, users, "u4", "e@x|four");
+    add_str(wtree3_batch_insert, batch, users, "u5", "e@x|five");
+    assert_int_equal(WTREE3_INDEX_ERROR, wtree3_batch_commit(batch, &error));
+
+    assert_int_equal(0, wtree3_tree_count(log));
+    assert_int_equal(1, wtree3_tree_count(users));
+    assert_int_equal(1, index_matches(users, "email_idx", "a@x").count);
+    assert_int_equal(0, index_matches(users, "email_idx", "b@x").count);
+    assert_int_equal(0, index_matches(users, "email_idx", "e@x").count);
+
+    wtree3_batch_free(batch);
+    wtree3_tree_close(users);
+    wtree3_tree_close(log);
+}
+
+static void test_unique_key_moves(void **state) {
+    (void)state;
+    gerror_t error = {0};
+    wtree3_tree_t *users = open_indexed("move_users", "email_idx", true);
+    assert_int_equal(WTREE3_OK, wtree3_insert_one(users, "u1", 2, "a@x|one", 7, &error));
+
+    /* u2 takes u1's address while u1 moves on; "u2" sorts after "u1" */
+    wtree3_batch_t *batch = wtree3_batch_create(test_db, &error);
+    assert_non_null(batch);
+    add_str(wtree3_batch_insert, batch, users, "u2", "a@x|two");
+    add_str(wtree3_batch_update, batch, users, "u1", "b@x|one");
+    assert_int_equal(WTREE3_OK, wtree3_batch_commit(batch, &error));
+
+    match_t m = index_matches(users, "email_idx", "a@x");
+    assert_int_equal(1, m.count);
+    assert_string_equal("u2", m.last_key);
+    m = index_matches(users, "email_idx", "b@x");
+    assert_int_equal(1, m.count);
+    assert_string_equal("u1", m.last_key);
+
+    /* Swap the two addresses */
+    wtree3_batch_clear(batch);
+    add_str(wtree3_batch_update, batch, users, "u1", "a@x|one");
+    add_str(wtree3_batch_update, batch, users, "u2", "b@x|two");
+    assert_int_equal(WTREE3_OK, wtree3_batch_commit(batch, &error));
+    assert_string_equal("u1", index_matches(users, "email_idx", "a@x").last_key);
+    assert_string_equal("u2", index_matches(users, "email_idx", "b@x").last_key);
+
+    wtree3_batch_free(batch);
+    wtree3_tree_close(users);
+}
+
+static void test_apply_in_caller_txn(void **state) {
+    (void)state;
+    gerror_t error = {0};
+    wtree3_tree_t *tree = open_indexed("txn_rows", "tag_idx", false);
+
+    wtree3_batch_t *batch = wtree3_batch_create(test_db, &error);
+    assert_non_null(batch);
+    add_str(wtree3_batch_insert, batch, tree, "b", "x|batch");
+
+    /* Read transactions are refused */
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+    assert_int_equal(WTREE3_EINVAL, wtree3_batch_apply_txn(txn, batch, &error));
+    wtree3_txn_abort(txn);
+
+    txn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(txn);
+    assert_int_equal(WTREE3_OK, wtree3_insert_one_txn(txn, tree, "a", 1, "x|direct", 8, &error));
+    assert_int_equal(WTREE3_OK, wtree3_batch_apply_txn(txn, batch, &error));
+    assert_int_equal(WTREE3_OK, wtree3_txn_commit(txn, &error));
+
+    assert_int_equal(2, wtree3_tree_count(tree));
+    assert_int_equal(2, index_matches(tree, "tag_idx", "x").count);
+
+    /* Aborting the caller's txn drops the batch with it */
+    wtree3_batch_clear(batch);
+    assert_int_equal(WTREE3_OK, wtree3_batch_delete(batch, tree, "a", 1, &error));
+    txn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(txn);
+    assert_int_equal(WTREE3_OK, wtree3_batch_apply_txn(txn, batch, &error));
+    wtree3_txn_abort(txn);
+    assert_int_equal(2, index_matches(tree, "tag_idx", "x").count);
+
+    /* Bad arguments */
+    assert_null(wtree3_batch_create(NULL, &error));
+    assert_int_equal(WTREE3_EINVAL, wtree3_batch_insert(batch, tree, "k", 1, NULL, 0, &error));
+    assert_int_equal(WTREE3_EINVAL, wtree3_batch_delete(batch, NULL, "k", 1, &error));
+    assert_int_equal(WTREE3_EINVAL, wtree3_batch_commit(NULL, &error));
+
+    wtree3_batch_free(batch);
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Main
+ * ============================================================ */
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_cross_tree_commit),
+        cmocka_unit_test(test_ops_fold_per_key),
+        cmocka_unit_test(test_failure_writes_nothing),
+        cmocka_unit_test(test_unique_key_moves),
+        cmocka_unit_test(test_apply_in_caller_txn),
+    };
+
+    return cmocka_run_group_tests(tests, setup_db, teardown_db);
+}
@@ -0,0 +1,331 @@
+/*
+ * test_wtree3_bulk.c - Tests for sorted bulk loading
+ *
+ * Tests wtree3_bulk_load_txn():
+ * - Loads into empty trees with unique and non-unique indexes
+ * - Appending a second sorted batch after existing data
+ * - Rejects unsorted/duplicate input and keys before existing entries
+ * - Unique index violations inside the batch
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+    #include <process.h>
+    #include <io.h>
+    #define mkdir(path, mode) _mkdir(path)
+    #define getpid() _getpid()
+    #define unlink _unlink
+    #define rmdir _rmdir
+#else
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "wtree3.h"
+
+#define BULK_COUNT 1000
+
+/* Test database path */
+static char test_db_path[256];
+static wtree3_db_t *test_db = NULL;
+
+static bool prefix_key_extractor(const void *value, size_t value_len,
+                                 void *user_data,
+                                 void **out_key, size_t *out_len);
+
+/* ============================================================
+ * Test Fixtures
+ * ============================================================ */
+
+static int setup_db(void **state) {
+    (void)state;
+
+#ifdef _WIN32
+    snprintf(test_db_path, sizeof(test_db_path), "%s\\test_wtree3_bulk_%d",
+             getenv("TEMP"), getpid());
+#else
+    snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_wtree3_bulk_%d", getpid());
+#endif
+    mkdir(test_db_path, 0755);
+
+    gerror_t error = {0};
+    test_db = wtree3_db_open(test_db_path, 64 * 1024 * 1024, 128, WTREE3_VERSION(1, 0), 0, &error);
+    if (!test_db) {
+        fprintf(stderr, "Failed to create test database: %s\n", error.message);
+        return -1;
+    }
+
+    for (uint32_t flags = 0; flags <= 0x03; flags++) {
+        int rc = wtree3_db_register_key_extractor(test_db, WTREE3_VERSION(1, 0), flags,
+                                                  prefix_key_extractor, &error);
+        if (rc != WTREE3_OK) {
+            fprintf(stderr, "Failed to register extractor for flags=0x%02x: %s\n", flags, error.message);
+            wtree3_db_close(test_db);
+            test_db = NULL;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int teardown_db(void **state) {
+    (void)state;
+
+    if (test_db) {
+        wtree3_db_close(test_db);
+        test_db = NULL;
+    }
+
+    char cmd[512];
+#ifdef _WIN32
+    snprintf(cmd, sizeof(cmd), "rd /s /q \"%s\"", test_db_path);
+#else
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", test_db_path);
+#endif
+    (void)system(cmd);
+
+    return 0;
+}
+
+/* Extract first 3 chars as index key */
+static bool prefix_key_extractor(const void *value, size_t value_len,
+                                 void *user_data,
+                                 void **out_key, size_t *out_len) {
+    (void)user_data;
+
+    size_t key_len = (value_len < 3) ? value_len : 3;
+    char *key = malloc(key_len);
+    if (!key) return false;
+
+    memcpy(key, value, key_len);
+    *out_key = key;
+    *out_len = key_len;
+    return true;
+}
+
+/* ============================================================
+ * Helpers
+ * ============================================================ */
+
+typedef struct {
+    char keys[BULK_COUNT][16];
+    char values[BULK_COUNT][16];
+    wtree3_kv_t kvs[BULK_COUNT];
+} bulk_data_t;
+
+/* Keys "k%06d" (ascending), values "%03d-v" so the 3-char prefix is unique per i < 1000 */
+static bulk_data_t *make_bulk_data(int key_offset, size_t count) {
+    bulk_data_t *d = calloc(1, sizeof(bulk_data_t));
+    assert_non_null(d);
+    for (size_t i = 0; i < count; i++) {
+        snprintf(d->keys[i], sizeof(d->keys[i]), "k%06d", key_offset + (int)i);
+        snprintf(d->values[i], sizeof(d->values[i]), "%03d-v", (int)((key_offset + i) % 1000));
+        d->kvs[i].key = d->keys[i];
+        d->kvs[i].key_len = strlen(d->keys[i]);
+        d->kvs[i].value = d->values[i];
+        d->kvs[i].value_len = strlen(d->values[i]);
+    }
+    return d;
+}
+
+static int bulk_load(wtree3_tree_t *tree, const wtree3_kv_t *kvs, size_t count, gerror_t *error) {
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, true, error);
+    assert_non_null(txn);
+    int rc = wtree3_bulk_load_txn(txn, tree, kvs, count, error);
+    if (rc == WTREE3_OK) {
+        rc = wtree3_txn_commit(txn, error);
+    } else {
+        wtree3_txn_abort(txn);
+    }
+    return rc;
+}
+
+/* ============================================================
+ * Tests
+ * ============================================================ */
+
+static void test_bulk_load_empty_tree_with_indexes(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "bulk_basic", 0, 0, &error);
+    assert_non_null(tree);
+
+    wtree3_index_config_t uniq = {.name = "uniq_idx", .unique = true};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &uniq, &error));
+
+    bulk_data_t *d = make_bulk_data(0, BULK_COUNT);
+    assert_int_equal(WTREE3_OK, bulk_load(tree, d->kvs, BULK_COUNT, &error));
+    assert_int_equal(BULK_COUNT, wtree3_tree_count(tree));
+
+    void *value;
+    size_t value_len;
+    assert_int_equal(WTREE3_OK, wtree3_get(tree, "k000500", 7, &value, &value_len, &error));
+    assert_memory_equal("500-v", value, 5);
+    free(value);
+
+    wtree3_iterator_t *iter = wtree3_index_seek(tree, "uniq_idx", "123", 3, &error);
+    assert_non_null(iter);
+    assert_true(wtree3_iterator_valid(iter));
+    const void *main_key;
+    size_t main_key_len;
+    assert_true(wtree3_index_iterator_main_key(iter, &main_key, &main_key_len));
+    assert_memory_equal("k000123", main_key, 7);
+    wtree3_iterator_close(iter);
+
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+
+    free(d);
+    wtree3_tree_close(tree);
+}
+
+static void test_bulk_load_appends_after_existing(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "bulk_append", 0, 0, &error);
+    assert_non_null(tree);
+
+    /* Non-unique index: second batch repeats every prefix of the first */
+    wtree3_index_config_t idx = {.name = "prefix_idx"};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &idx, &error));
+
+    bulk_data_t *first = make_bulk_data(0, BULK_COUNT);
+    bulk_data_t *second = make_bulk_data(BULK_COUNT, BULK_COUNT);
+    assert_int_equal(WTREE3_OK, bulk_load(tree, first->kvs, BULK_COUNT, &error));
+    assert_int_equal(WTREE3_OK, bulk_load(tree, second->kvs, BULK_COUNT, &error));
+    assert_int_equal(2 * BULK_COUNT, wtree3_tree_count(tree));
+
+    /* Regular writes keep working on bulk-loaded pages */
+    assert_int_equal(WTREE3_OK, wtree3_insert_one(tree, "a-first", 7, "777-x", 5, &error));
+    assert_int_equal(2 * BULK_COUNT + 1, wtree3_tree_count(tree));
+
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+
+    free(first);
+    free(second);
+    wtree3_tree_close(tree);
+}
+
+static void test_bulk_load_rejects_unsorted_input(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "bulk_unsorted", 0, 0, &error);
+    assert_non_null(tree);
+
+    wtree3_kv_t unsorted[] = {
+        {"b", 1, "v1", 2},
+        {"a", 1, "v2", 2},
+    };
+    assert_int_equal(WTREE3_EINVAL, bulk_load(tree, unsorted, 2, &error));
+
+    wtree3_kv_t duplicate[] = {
+        {"a", 1, "v1", 2},
+        {"a", 1, "v2", 2},
+    };
+    assert_int_equal(WTREE3_EINVAL, bulk_load(tree, duplicate, 2, &error));
+
+    assert_int_equal(0, wtree3_tree_count(tree));
+    assert_false(wtree3_exists(tree, "a", 1, &error));
+
+    wtree3_tree_close(tree);
+}
+
+static void test_bulk_load_rejects_keys_before_existing(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "bulk_overlap", 0, 0, &error);
+    assert_non_null(tree);
+
+    assert_int_equal(WTREE3_OK, wtree3_insert_one(tree, "m", 1, "v", 1, &error));
+
+    wtree3_kv_t before[] = {
+        {"a", 1, "v1", 2},
+        {"z", 1, "v2", 2},
+    };
+    assert_int_equal(WTREE3_KEY_EXISTS, bulk_load(tree, before, 2, &error));
+    assert_int_equal(1, wtree3_tree_count(tree));
+    assert_false(wtree3_exists(tree, "a", 1, &error));
+
+    wtree3_tree_close(tree);
+}
+
+static void test_bulk_load_unique_violation(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "bulk_unique", 0, 0, &error);
+    assert_non_null(tree);
+
+    wtree3_index_config_t uniq = {.name = "uniq_idx", .unique = true};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &uniq, &error));
+
+    /* Same 3-char prefix twice within the batch */
+    wtree3_kv_t kvs[] = {
+        {"k1", 2, "abc-1", 5},
+        {"k2", 2, "xyz-2", 5},
+        {"k3", 2, "abc-3", 5},
+    };
+    assert_int_equal(WTREE3_INDEX_ERROR, bulk_load(tree, kvs, 3, &error));
+    assert_int_equal(0, wtree3_tree_count(tree));
+
+    /* Existing index entry conflicts with a later batch */
+    assert_int_equal(WTREE3_OK, bulk_load(tree, kvs, 2, &error));
+    wtree3_kv_t later[] = {
+        {"k9", 2, "xyz-9", 5},
+    };
+    assert_int_equal(WTREE3_INDEX_ERROR, bulk_load(tree, later, 1, &error));
+    assert_int_equal(2, wtree3_tree_count(tree));
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+
+    wtree3_tree_close(tree);
+}
+
+static void test_bulk_load_invalid_params(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "bulk_params", 0, 0, &error);
+    assert_non_null(tree);
+
+    wtree3_kv_t kvs[] = {{"a", 1, "v", 1}};
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+    assert_int_equal(WTREE3_EINVAL, wtree3_bulk_load_txn(txn, tree, kvs, 1, &error));
+    assert_int_equal(WTREE3_EINVAL, wtree3_bulk_load_txn(txn, tree, NULL, 1, &error));
+    assert_int_equal(WTREE3_EINVAL, wtree3_bulk_load_txn(txn, tree, kvs, 0, &error));
+    assert_int_equal(WTREE3_EINVAL, wtree3_bulk_load_txn(NULL, tree, kvs, 1, &error));
+    wtree3_txn_abort(txn);
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Main
+ * ============================================================ */
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_bulk_load_empty_tree_with_indexes),
+        cmocka_unit_test(test_bulk_load_appends_after_existing),
+        cmocka_unit_test(test_bulk_load_rejects_unsorted_input),
+        cmocka_unit_test(test_bulk_load_rejects_keys_before_existing),
+        cmocka_unit_test(test_bulk_load_unique_violation),
+        cmocka_unit_test(test_bulk_load_invalid_params),
+    };
+
+    return cmocka_run_group_tests(tests, setup_db, teardown_db);
+}
@@ -0,0 +1,529 @@
+/*
+ * test_wtree3_changelog.c - Tests for the change-data-capture log
+ *
+ * Tests that:
+ * - Every write path (insert, update, upsert, delete, modify, insert_many,
+ *   bulk load, delete_if, delete_range, iterator delete, clear) appends
+ *   one record with the right op, key and value
+ * - Records commit and abort with their txn, and sequences have no gaps
+ * - Keys-only logs carry no values
+ * - The consumer cursor reads in batches and sees later commits
+ * - Truncation keeps sequences monotonic and reports consumers that fell
+ *   behind
+ * - The log survives a reopen, and disable or tree delete drop it
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+    #include <process.h>
+    #define mkdir(path, mode) _mkdir(path)
+    #define getpid() _getpid()
+#else
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "wtree3.h"
+
+/* Test database path */
+static char test_db_path[256];
+static wtree3_db_t *test_db = NULL;
+
+static bool prefix_extractor(const void *value, size_t value_len,
+                             void *user_data,
+                             void **out_key, size_t *out_len);
+
+/* ============================================================
+ * Test Fixtures
+ * ============================================================ */
+
+static int setup_db(void **state) {
+    (void)state;
+
+#ifdef _WIN32
+    snprintf(test_db_path, sizeof(test_db_path), "%s\\test_wtree3_changelog_%d",
+             getenv("TEMP"), getpid());
+#else
+    snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_wtree3_changelog_%d", getpid());
+#endif
+    mkdir(test_db_path, 0755);
+
+    gerror_t error = {0};
+    test_db = wtree3_db_open(test_db_path, 64 * 1024 * 1024, 128, WTREE3_VERSION(1, 0), 0, &error);
+    if (!test_db) {
+        fprintf(stderr, "Failed to create test database: %s\n", error.message);
+        return -1;
+    }
+
+    for (uint32_t flags = 0; flags <= 0x03; flags++) {
+        int rc = wtree3_db_register_key_extractor(test_db, WTREE3_VERSION(1, 0), flags,
+                                                  prefix_extractor, &error);
+        if (rc != WTREE3_OK) {
+            fprintf(stderr, "Failed to register extractor for flags=0x%02x: %s\n", flags, error.message);
+            wtree3_db_close(test_db);
+            test_db = NULL;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int teardown_db(void **state) {
+    (void)state;
+
+    if (test_db) {
+        wtree3_db_close(test_db);
+        test_db = NULL;
+    }
+
+    char cmd[512];
+#ifdef _WIN32
+    snprintf(cmd, sizeof(cmd), "rd /s /q \"%s\"", test_db_path);
+#else
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", test_db_path);
+#endif
+    (void)system(cmd);
+
+    return 0;
+}
+
+/* Index the first 2 bytes of the value */
+static bool prefix_extractor(const void *value, size_t value_len,
+                             void *user_data,
+                             void **out_key, size_t *out_len) {
+    (void)user_data;
+    if (value_len < 2) return false;
+
+    char *key = malloc(2);
+    if (!key) return false;
+
+    memcpy(key, value, 2);
+    *out_key = key;
+    *out_len = 2;
+    return true;
+}
+
+/* ============================================================
+ * Helpers
+ * ============================================================ */
+
+static wtree3_tree_t *create_logged(const char *name, bool values, bool indexed) {
+    gerror_t error = {0};
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, name, 0, 0, &error);
+    assert_non_null(tree);
+
+    if (indexed) {
+        wtree3_index_config_t cfg = {.name = "group_idx"};
+        assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &cfg, &error));
+    }
+
+    wtree3_changelog_config_t cfg = {.values = values};
+    assert_int_equal(WTREE3_OK, wtree3_tree_enable_changelog(tree, &cfg, &error));
+    return tree;
+}
+
+static void put(wtree3_tree_t *tree, const char *key, const char *value) {
+    gerror_t error = {0};
+    assert_int_equal(WTREE3_OK, wtree3_insert_one(tree, key, strlen(key), value, strlen(value), &error));
+}
+
+/* Whole log in one read txn; returns the record count */
+static size_t read_all(wtree3_tree_t *tree, uint64_t from, wtree3_change_t *out, size_t max,
+                       wtree3_txn_t **txn_out) {
+    gerror_t error = {0};
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+
+    size_t count = 0;
+    assert_int_equal(WTREE3_OK, wtree3_changelog_read_txn(txn, tree, from, out, max, &count, &error));
+    *txn_out = txn;
+    return count;
+}
+
+static void assert_change(const wtree3_change_t *c, uint64_t seq, wtree3_change_op_t op,
+                          const char *key, const char *value) {
+    assert_int_equal(c->seq, seq);
+    assert_int_equal(c->op, op);
+    if (key) {
+        assert_int_equal(c->key_len, strlen(key));
+        assert_memory_equal(c->key, key, strlen(key));
+    } else {
+        assert_null(c->key);
+        assert_int_equal(c->key_len, 0);
+    }
+    if (value) {
+        assert_int_equal(c->value_len, strlen(value));
+        assert_memory_equal(c->value, value, strlen(value));
+    } else {
+        assert_null(c->value);
+        assert_int_equal(c->value_len, 0);
+    }
+}
+
+static void *append_x(const void *existing, size_t existing_len, void *user_data, size_t *out_len) {
+    (void)user_data;
+    char *value = malloc(existing_len + 1);
+    if (!value) return NULL;
+    if (existing_len) memcpy(value, existing, existing_len);
+    value[existing_len] = 'x';
+    *out_len = existing_len + 1;
+    return value;
+}
+
+static bool key_is_even(const void *key, size_t key_len, const void *value, size_t value_len,
+                        void *user_data) {
+    (void)key_len;
+    (void)value;
+    (void)value_len;
+    (void)user_data;
+    return (((const char *)key)[1] - '0') % 2 == 0;
+}
+
+/* ============================================================
+ * Write Paths
+ * ============================================================ */
+
+static void test_changelog_point_writes(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = create_logged("cl_point", true, true);
+
+    put(tree, "a", "g1-one");
+    assert_int_equal(WTREE3_OK, wtree3_update(tree, "a", 1, "g2-two", 6, &error));
+    assert_int_equal(WTREE3_OK, wtree3_upsert(tree, "b", 1, "g1-new", 6, &error));
+    assert_int_equal(WTREE3_OK, wtree3_upsert(tree, "b", 1, "g1-old", 6, &error));
+    assert_int_equal(WTREE3_OK, wtree3_delete_one(tree, "a", 1, NULL, &error));
+    assert_int_equal(WTREE3_OK, wtree3_delete_one(tree, "zz", 2, NULL, &error));  /* Missing: no record */
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(txn);
+    assert_int_equal(WTREE3_OK, wtree3_modify_txn(txn, tree, "b", 1, append_x, NULL, &error));
+    assert_int_equal(WTREE3_OK, wtree3_modify_txn(txn, tree, "c", 1, append_x, NULL, &error));
+    wtree3_kv_t kvs[2] = {
+        {.key = "d", .key_len = 1, .value = "g3-d", .value_len = 4},
+        {.key = "e", .key_len = 1, .value = "g3-e", .value_len = 4},
+    };
+    assert_int_equal(WTREE3_OK, wtree3_insert_many_txn(txn, tree, kvs, 2, &error));
+    assert_int_equal(WTREE3_OK, wtree3_txn_commit(txn, &error));
+
+    wtree3_change_t changes[16];
+    size_t n = read_all(tree, 0, changes, 16, &txn);
+    assert_int_equal(n, 9);
+    assert_change(&changes[0], 1, WTREE3_CHANGE_INSERT, "a", "g1-one");
+    assert_change(&changes[1], 2, WTREE3_CHANGE_UPDATE, "a", "g2-two");
+    assert_change(&changes[2], 3, WTREE3_CHANGE_INSERT, "b", "g1-new");
+    assert_change(&changes[3], 4, WTREE3_CHANGE_UPDATE, "b", "g1-old");
+    assert_change(&changes[4], 5, WTREE3_CHANGE_DELETE, "a", NULL);
+    assert_change(&changes[5], 6, WTREE3_CHANGE_UPDATE, "b", "g1-oldx");
+    assert_change(&changes[6], 7, WTREE3_CHANGE_INSERT, "c", "x");
+    assert_change(&changes[7], 8, WTREE3_CHANGE_INSERT, "d", "g3-d");
+    assert_change(&changes[8], 9, WTREE3_CHANGE_INSERT, "e", "g3-e");
+
+    /* From the middle */
+    size_t count = 0;
+    assert_int_equal(WTREE3_OK, wtree3_changelog_read_txn(txn, tree, 8, changes, 16, &count, &error));
+    assert_int_equal(count, 2);
+    assert_int_equal(changes[0].seq, 8);
+
+    uint64_t first = 0, last = 0;
+    assert_int_equal(WTREE3_OK, wtree3_changelog_bounds_txn(txn, tree, &first, &last, &error));
+    assert_int_equal(first, 1);
+    assert_int_equal(last, 9);
+    wtree3_txn_abort(txn);
+
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+    wtree3_tree_close(tree);
+}
+
+static void test_changelog_bulk_writes(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = create_logged("cl_bulk", false, true);
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(txn);
+    char keys[10][3];
+    wtree3_kv_t kvs[10];
+    for (int i = 0; i < 10; i++) {
+        snprintf(keys[i], sizeof(keys[i]), "k%d", i);
+        kvs[i] = (wtree3_kv_t){.key = keys[i], .key_len = 2, .value = "g1", .value_len = 2};
+    }
+    assert_int_equal(WTREE3_OK, wtree3_bulk_load_txn(txn, tree, kvs, 10, &error));
+
+    /* Even keys, then k1..k3, then k9 through an iterator */
+    size_t deleted = 0;
+    assert_int_equal(WTREE3_OK, wtree3_delete_if_txn(txn, tree, NULL, 0, NULL, 0,
+                                                     key_is_even, NULL, &deleted, &error));
+    assert_int_equal(deleted, 5);
+    assert_int_equal(WTREE3_OK, wtree3_delete_range_txn(txn, tree, "k1", 2, "k3", 2, &deleted, &error));
+    assert_int_equal(deleted, 2);
+
+    wtree3_iterator_t *iter = wtree3_iterator_create_with_txn(tree, txn, &error);
+    assert_non_null(iter);
+    assert_true(wtree3_iterator_seek(iter, "k9", 2));
+    assert_int_equal(WTREE3_OK, wtree3_iterator_delete(iter, &error));
+    wtree3_iterator_close(iter);
+
+    assert_int_equal(WTREE3_OK, wtree3_tree_clear_txn(txn, tree, &deleted, &error));
+    assert_int_equal(deleted, 2);
+    assert_int_equal(WTREE3_OK, wtree3_txn_commit(txn, &error));
+
+    wtree3_change_t changes[32];
+    size_t n = read_all(tree, 0, changes, 32, &txn);
+    assert_int_equal(n, 10 + 5 + 2 + 1 + 1);
+    for (int i = 0; i < 10; i++) assert_change(&changes[i], (uint64_t)i + 1, WTREE3_CHANGE_INSERT, keys[i], NULL);
+    assert_change(&changes[10], 11, WTREE3_CHANGE_DELETE, "k0", NULL);
+    assert_change(&changes[14], 15, WTREE3_CHANGE_DELETE, "k8", NULL);
+    assert_change(&changes[15], 16, WTREE3_CHANGE_DELETE, "k1", NULL);
+    assert_change(&changes[16], 17, WTREE3_CHANGE_DELETE, "k3", NULL);
+    assert_change(&changes[17], 18, WTREE3_CHANGE_DELETE, "k9", NULL);
+    assert_change(&changes[18], 19, WTREE3_CHANGE_CLEAR, NULL, NULL);
+    wtree3_txn_abort(txn);
+
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+    wtree3_tree_close(tree);
+}
+
+static void test_changelog_follows_txn(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = create_logged("cl_txn", true, false);
+    put(tree, "a", "1");
+
+    /* Aborted writes leave no records and no gap */
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(txn);
+    assert_int_equal(WTREE3_OK, wtree3_insert_one_txn(txn, tree, "b", 1, "2", 1, &error));
+    assert_int_equal(WTREE3_OK, wtree3_insert_one_txn(txn, tree, "c", 1, "3", 1, &error));
+    wtree3_txn_abort(txn);
+
+    /* A failed write logs nothing */
+    assert_int_equal(WTREE3_KEY_EXISTS, wtree3_insert_one(tree, "a", 1, "x", 1, &error));
+    assert_int_equal(WTREE3_NOT_FOUND, wtree3_update(tree, "q", 1, "x", 1, &error));
+
+    put(tree, "d", "4");
+
+    wtree3_change_t changes[8];
+    size_t n = read_all(tree, 0, changes, 8, &txn);
+    assert_int_equal(n, 2);
+    assert_change(&changes[0], 1, WTREE3_CHANGE_INSERT, "a", "1");
+    assert_change(&changes[1], 2, WTREE3_CHANGE_INSERT, "d", "4");
+    wtree3_txn_abort(txn);
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Consumers and Retention
+ * ============================================================ */
+
+static void test_changelog_cursor(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = create_logged("cl_cursor", false, false);
+    char key[16];
+    for (int i = 0; i < 50; i++) {
+        snprintf(key, sizeof(key), "k%03d", i);
+        put(tree, key, "v");
+    }
+
+    wtree3_changelog_cursor_t *cursor = wtree3_changelog_cursor_open(tree, 0, &error);
+    assert_non_null(cursor);
+
+    wtree3_change_t batch[7];
+    size_t count = 0, seen = 0;
+    uint64_t expect = 1;
+    do {
+        assert_int_equal(WTREE3_OK, wtree3_changelog_cursor_next(cursor, batch, 7, &count, &error));
+        assert_true(count <= 7);
+        for (size_t i = 0; i < count; i++) {
+            assert_int_equal(batch[i].seq, expect);
+            snprintf(key, sizeof(key), "k%03d", (int)(expect - 1));
+            assert_change(&batch[i], expect, WTREE3_CHANGE_INSERT, key, NULL);
+            expect++;
+        }
+        seen += count;
+    } while (count > 0);
+    assert_int_equal(seen, 50);
+    assert_int_equal(wtree3_changelog_cursor_position(cursor), 51);
+
+    /* Caught up, then later commits show up in the next batch */
+    put(tree, "late", "v");
+    assert_int_equal(WTREE3_OK, wtree3_changelog_cursor_next(cursor, batch, 7, &count, &error));
+    assert_int_equal(count, 1);
+    assert_change(&batch[0], 51, WTREE3_CHANGE_INSERT, "late", NULL);
+    assert_int_equal(WTREE3_OK, wtree3_changelog_cursor_next(cursor, batch, 7, &count, &error));
+    assert_int_equal(count, 0);
+
+    wtree3_changelog_cursor_close(cursor);
+    wtree3_tree_close(tree);
+}
+
+static void test_changelog_truncate(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = create_logged("cl_trunc", false, false);
+    char key[16];
+    for (int i = 0; i < 20; i++) {
+        snprintf(key, sizeof(key), "k%03d", i);
+        put(tree, key, "v");
+    }
+
+    size_t removed = 0;
+    assert_int_equal(WTREE3_OK, wtree3_changelog_truncate(tree, 11, &removed, &error));
+    assert_int_equal(removed, 10);
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+    uint64_t first = 0, last = 0;
+    assert_int_equal(WTREE3_OK, wtree3_changelog_bounds_txn(txn, tree, &first, &last, &error));
+    assert_int_equal(first, 11);
+    assert_int_equal(last, 20);
+
+    /* A consumer still at 5 missed records; 0 means the oldest kept */
+    wtree3_change_t changes[32];
+    size_t count = 0;
+    assert_int_equal(WTREE3_NOT_FOUND,
+                     wtree3_changelog_read_txn(txn, tree, 5, changes, 32, &count, &error));
+    assert_int_equal(WTREE3_OK, wtree3_changelog_read_txn(txn, tree, 0, changes, 32, &count, &error));
+    assert_int_equal(count, 10);
+    assert_int_equal(changes[0].seq, 11);
+    wtree3_txn_abort(txn);
+
+    /* Emptying the log does not restart the sequence */
+    assert_int_equal(WTREE3_OK, wtree3_changelog_truncate(tree, UINT64_MAX, &removed, &error));
+    assert_int_equal(removed, 10);
+
+    txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+    assert_int_equal(WTREE3_OK, wtree3_changelog_bounds_txn(txn, tree, &first, &last, &error));
+    assert_int_equal(first, 21);
+    assert_int_equal(last, 20);
+    wtree3_txn_abort(txn);
+
+    put(tree, "next", "v");
+    size_t n = read_all(tree, 21, changes, 32, &txn);
+    assert_int_equal(n, 1);
+    assert_int_equal(changes[0].seq, 21);
+    wtree3_txn_abort(txn);
+
+    /* Nothing below 1 */
+    assert_int_equal(WTREE3_OK, wtree3_changelog_truncate(tree, 1, &removed, &error));
+    assert_int_equal(removed, 0);
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Lifecycle and Errors
+ * ============================================================ */
+
+static void test_changelog_lifecycle(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = create_logged("cl_life", true, false);
+    put(tree, "a", "1");
+    wtree3_tree_close(tree);
+
+    /* Reopened handles keep logging */
+    tree = wtree3_tree_open(test_db, "cl_life", 0, 0, &error);
+    assert_non_null(tree);
+    put(tree, "b", "2");
+
+    wtree3_change_t changes[8];
+    wtree3_txn_t *txn;
+    size_t n = read_all(tree, 0, changes, 8, &txn);
+    assert_int_equal(n, 2);
+    assert_change(&changes[1], 2, WTREE3_CHANGE_INSERT, "b", "2");
+    wtree3_txn_abort(txn);
+
+    /* Reconfiguring keeps the log */
+    wtree3_changelog_config_t keys_only = {0};
+    assert_int_equal(WTREE3_OK, wtree3_tree_enable_changelog(tree, &keys_only, &error));
+    put(tree, "c", "3");
+    n = read_all(tree, 0, changes, 8, &txn);
+    assert_int_equal(n, 3);
+    assert_change(&changes[2], 3, WTREE3_CHANGE_INSERT, "c", NULL);
+    wtree3_txn_abort(txn);
+
+    /* Disabled: no log, writes go unrecorded, reopen finds none */
+    assert_int_equal(WTREE3_OK, wtree3_tree_disable_changelog(tree, &error));
+    put(tree, "d", "4");
+    txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+    size_t count = 0;
+    assert_int_equal(WTREE3_EINVAL, wtree3_changelog_read_txn(txn, tree, 0, changes, 8, &count, &error));
+    wtree3_txn_abort(txn);
+    assert_null(wtree3_changelog_cursor_open(tree, 0, &error));
+    wtree3_tree_close(tree);
+
+    tree = wtree3_tree_open(test_db, "cl_life", 0, 0, &error);
+    assert_non_null(tree);
+    assert_null(wtree3_changelog_cursor_open(tree, 0, &error));
+
+    /* Re-enabled logs start over */
+    assert_int_equal(WTREE3_OK, wtree3_tree_enable_changelog(tree, NULL, &error));
+    put(tree, "e", "5");
+    n = read_all(tree, 0, changes, 8, &txn);
+    assert_int_equal(n, 1);
+    assert_change(&changes[0], 1, WTREE3_CHANGE_INSERT, "e", NULL);
+    wtree3_txn_abort(txn);
+    wtree3_tree_close(tree);
+
+    /* Deleting the tree drops its log; a new tree of that name has none */
+    assert_int_equal(WTREE3_OK, wtree3_tree_delete(test_db, "cl_life", &error));
+    tree = wtree3_tree_open(test_db, "cl_life", 0, 0, &error);
+    assert_non_null(tree);
+    assert_null(wtree3_changelog_cursor_open(tree, 0, &error));
+    wtree3_tree_close(tree);
+
+    /* Bad parameters */
+    assert_int_equal(WTREE3_EINVAL, wtree3_tree_enable_changelog(NULL, NULL, &error));
+    assert_int_equal(WTREE3_EINVAL, wtree3_changelog_truncate(NULL, 1, NULL, &error));
+    assert_null(wtree3_changelog_cursor_open(NULL, 0, &error));
+
+    wtree3_tree_t *dups = wtree3_tree_open(test_db, "cl_dups", MDB_DUPSORT, 0, &error);
+    assert_non_null(dups);
+    assert_int_equal(WTREE3_EINVAL, wtree3_tree_enable_changelog(dups, NULL, &error));
+    wtree3_tree_close(dups);
+
+    tree = create_logged("cl_ro", false, false);
+    txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+    assert_int_equal(WTREE3_EINVAL, wtree3_changelog_truncate_txn(txn, tree, 1, NULL, &error));
+    wtree3_txn_abort(txn);
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Main
+ * ============================================================ */
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_changelog_point_writes),
+        cmocka_unit_test(test_changelog_bulk_writes),
+        cmocka_unit_test(test_changelog_follows_txn),
+        cmocka_unit_test(test_changelog_cursor),
+        cmocka_unit_test(test_changelog_truncate),
+        cmocka_unit_test(test_changelog_lifecycle),
+    };
+
+    return cmocka_run_group_tests(tests, setup_db, teardown_db);
+}
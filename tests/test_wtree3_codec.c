@@ -0,0 +1,534 @@
+/*
+ * test_wtree3_codec.c - Tests for per-tree value compression
+ *
+ * Tests that:
+ * - Compressed trees return the original bytes on every read path
+ *   (get, get_txn, get_many, callback/batch scans, iterators)
+ * - Long values shrink on disk, short ones are stored raw
+ * - A trained dictionary shrinks small structured records further
+ * - Updates, upserts, modify, delete_if and index maintenance see the
+ *   original values, and the indexes verify
+ * - The codec is reloaded by tree_open and can only change on empty trees
+ * - Bad parameters are rejected
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+    #include <process.h>
+    #define mkdir(path, mode) _mkdir(path)
+    #define getpid() _getpid()
+#else
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "wtree3.h"
+
+/* Test database path */
+static char test_db_path[256];
+static wtree3_db_t *test_db = NULL;
+
+static bool prefix_extractor(const void *value, size_t value_len,
+                             void *user_data,
+                             void **out_key, size_t *out_len);
+
+/* ============================================================
+ * Test Fixtures
+ * ============================================================ */
+
+static int setup_db(void **state) {
+    (void)state;
+
+#ifdef _WIN32
+    snprintf(test_db_path, sizeof(test_db_path), "%s\\test_wtree3_codec_%d",
+             getenv("TEMP"), getpid());
+#else
+    snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_wtree3_codec_%d", getpid());
+#endif
+    mkdir(test_db_path, 0755);
+
+    gerror_t error = {0};
+    test_db = wtree3_db_open(test_db_path, 64 * 1024 * 1024, 128, WTREE3_VERSION(1, 0), 0, &error);
+    if (!test_db) {
+        fprintf(stderr, "Failed to create test database: %s\n", error.message);
+        return -1;
+    }
+
+    for (uint32_t flags = 0; flags <= 0x03; flags++) {
+        int rc = wtree3_db_register_key_extractor(test_db, WTREE3_VERSION(1, 0), flags,
+                                                  prefix_extractor, &error);
+        if (rc != WTREE3_OK) {
+            fprintf(stderr, "Failed to register extractor for flags=0x%02x: %s\n", flags, error.message);
+            wtree3_db_close(test_db);
+            test_db = NULL;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int teardown_db(void **state) {
+    (void)state;
+
+    if (test_db) {
+        wtree3_db_close(test_db);
+        test_db = NULL;
+    }
+
+    char cmd[512];
+#ifdef _WIN32
+    snprintf(cmd, sizeof(cmd), "rd /s /q \"%s\"", test_db_path);
+#else
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", test_db_path);
+#endif
+    (void)system(cmd);
+
+    return 0;
+}
+
+/* Index the first 8 bytes of the value */
+static bool prefix_extractor(const void *value, size_t value_len,
+                             void *user_data,
+                             void **out_key, size_t *out_len) {
+    (void)user_data;
+    if (value_len < 8) return false;
+
+    char *key = malloc(8);
+    if (!key) return false;
+
+    memcpy(key, value, 8);
+    *out_key = key;
+    *out_len = 8;
+    return true;
+}
+
+/* ============================================================
+ * Helpers
+ * ============================================================ */
+
+/* Row i: key "k00000", value "g0000000" + repetitive filler (len varies) */
+static size_t make_value(int i, char *buf, size_t cap) {
+    size_t len = (size_t)(i % 5 == 0 ? 12 : 200 + (i % 7) * 150);
+    if (len > cap) len = cap;
+    snprintf(buf, cap, "g%07d", i % 10);
+    for (size_t p = 8; p < len; p++) buf[p] = "status=active;"[(p + (size_t)i) % 14];
+    return len;
+}
+
+static void put_rows(wtree3_tree_t *tree, int rows) {
+    gerror_t error = {0};
+    char key[16], value[2048];
+    for (int i = 0; i < rows; i++) {
+        snprintf(key, sizeof(key), "k%05d", i);
+        size_t len = make_value(i, value, sizeof(value));
+        assert_int_equal(WTREE3_OK, wtree3_insert_one(tree, key, strlen(key), value, len, &error));
+    }
+}
+
+static void assert_row(const void *value, size_t value_len, int i) {
+    char expect[2048];
+    size_t len = make_value(i, expect, sizeof(expect));
+    assert_int_equal(value_len, len);
+    assert_memory_equal(value, expect, len);
+}
+
+/* Bytes LMDB actually stores for a key of the tree */
+static size_t stored_len(const char *tree_name, const char *key) {
+    gerror_t error = {0};
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+
+    MDB_txn *mtxn = wtree3_txn_get_mdb(txn);
+    MDB_dbi dbi;
+    assert_int_equal(0, mdb_dbi_open(mtxn, tree_name, 0, &dbi));
+    MDB_val k = {.mv_size = strlen(key), .mv_data = (void *)key}, v;
+    assert_int_equal(0, mdb_get(mtxn, dbi, &k, &v));
+    size_t len = v.mv_size;
+
+    wtree3_txn_abort(txn);
+    return len;
+}
+
+static wtree3_tree_t *create_compressed(const char *name, const wtree3_codec_config_t *cfg) {
+    gerror_t error = {0};
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, name, 0, 0, &error);
+    assert_non_null(tree);
+
+    wtree3_codec_config_t defaults = {0};
+    assert_int_equal(WTREE3_OK, wtree3_tree_set_codec(tree, cfg ? cfg : &defaults, &error));
+    return tree;
+}
+
+typedef struct {
+    int next;
+    int seen;
+} scan_ctx_t;
+
+static bool scan_check(const void *key, size_t key_len,
+                       const void *value, size_t value_len, void *user_data) {
+    (void)key_len;
+    scan_ctx_t *ctx = (scan_ctx_t *)user_data;
+    assert_int_equal(atoi((const char *)key + 1), ctx->next);
+    assert_row(value, value_len, ctx->next);
+    ctx->next++;
+    ctx->seen++;
+    return true;
+}
+
+static bool batch_check(const wtree3_batch_entry_t *entries, size_t count, void *user_data) {
+    scan_ctx_t *ctx = (scan_ctx_t *)user_data;
+    for (size_t i = 0; i < count; i++) {
+        assert_row(entries[i].value.mv_data, entries[i].value.mv_size, ctx->next);
+        ctx->next++;
+        ctx->seen++;
+    }
+    return true;
+}
+
+/* ============================================================
+ * Reads
+ * ============================================================ */
+
+static void test_codec_read_paths(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = create_compressed("c_read", NULL);
+    put_rows(tree, 300);
+
+    /* Long repetitive values shrink, short ones pay one tag byte */
+    assert_true(stored_len("c_read", "k00001") < 200 / 2);
+    assert_int_equal(stored_len("c_read", "k00000"), 12 + 1);
+
+    void *value = NULL;
+    size_t value_len = 0;
+    assert_int_equal(WTREE3_OK, wtree3_get(tree, "k00003", 6, &value, &value_len, &error));
+    assert_row(value, value_len, 3);
+    free(value);
+
+    /* Zero-copy values stay valid until the txn ends */
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+
+    const void *views[64];
+    size_t view_lens[64];
+    char key[16];
+    for (int i = 0; i < 64; i++) {
+        snprintf(key, sizeof(key), "k%05d", i);
+        assert_int_equal(WTREE3_OK,
+                         wtree3_get_txn(txn, tree, key, 6, &views[i], &view_lens[i], &error));
+    }
+    for (int i = 0; i < 64; i++) assert_row(views[i], view_lens[i], i);
+
+    char keys[32][8];
+    wtree3_kv_t kvs[32];
+    for (int i = 0; i < 32; i++) {
+        snprintf(keys[i], sizeof(keys[i]), "k%05d", 200 - i * 3);
+        kvs[i] = (wtree3_kv_t){.key = keys[i], .key_len = 6};
+    }
+    const void *values[32];
+    size_t lens[32];
+    assert_int_equal(WTREE3_OK, wtree3_get_many_txn(txn, tree, kvs, 32, values, lens, &error));
+    for (int i = 0; i < 32; i++) assert_row(values[i], lens[i], 200 - i * 3);
+
+    scan_ctx_t ctx = {0};
+    assert_int_equal(WTREE3_OK, wtree3_scan_range_txn(txn, tree, NULL, 0, NULL, 0,
+                                                      scan_check, &ctx, &error));
+    assert_int_equal(ctx.seen, 300);
+
+    wtree3_batch_entry_t page[16];
+    ctx = (scan_ctx_t){0};
+    assert_int_equal(WTREE3_OK, wtree3_scan_range_batch_txn(txn, tree, NULL, 0, NULL, 0,
+                                                            page, 16, batch_check, &ctx, &error));
+    assert_int_equal(ctx.seen, 300);
+    wtree3_txn_abort(txn);
+
+    wtree3_iterator_t *iter = wtree3_iterator_create(tree, &error);
+    assert_non_null(iter);
+    int n = 0;
+    for (bool ok = wtree3_iterator_first(iter); ok; ok = wtree3_iterator_next(iter), n++) {
+        const void *v;
+        size_t vlen;
+        assert_true(wtree3_iterator_value(iter, &v, &vlen));
+        assert_row(v, vlen, n);
+    }
+    assert_int_equal(n, 300);
+    wtree3_iterator_close(iter);
+
+    wtree3_tree_close(tree);
+}
+
+static void test_codec_dictionary(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    /* Small JSON-like records: too short to compress well on their own */
+    enum { ROWS = 400 };
+    static const char *const names[] = {"alice", "bob", "carol", "dave"};
+    char *records[ROWS];
+    size_t record_lens[ROWS];
+    for (int i = 0; i < ROWS; i++) {
+        records[i] = malloc(192);
+        assert_non_null(records[i]);
+        record_lens[i] = (size_t)snprintf(records[i], 192,
+            "{\"id\":%d,\"name\":\"%s\",\"email\":\"%s%d@example.com\",\"status\":\"active\"}",
+            i, names[i % 4], names[i % 4], i);
+    }
+
+    unsigned char dict[4096];
+    size_t dict_len = 0;
+    assert_int_equal(WTREE3_OK, wtree3_codec_train((const void *const *)records, record_lens,
+                                                   ROWS / 2, dict, sizeof(dict), &dict_len, &error));
+    assert_true(dict_len > 0);
+    assert_true(dict_len <= sizeof(dict));
+
+    wtree3_codec_config_t plain_cfg = {.min_size = 16};
+    wtree3_codec_config_t dict_cfg = {.min_size = 16, .dict = dict, .dict_len = dict_len};
+    wtree3_tree_t *plain = create_compressed("c_plain", &plain_cfg);
+    wtree3_tree_t *trained = create_compressed("c_dict", &dict_cfg);
+
+    char key[16];
+    size_t plain_bytes = 0, dict_bytes = 0, raw_bytes = 0;
+    for (int i = 0; i < ROWS; i++) {
+        snprintf(key, sizeof(key), "k%05d", i);
+        assert_int_equal(WTREE3_OK, wtree3_insert_one(plain, key, 6, records[i], record_lens[i], &error));
+        assert_int_equal(WTREE3_OK, wtree3_insert_one(trained, key, 6, records[i], record_lens[i], &error));
+        raw_bytes += record_lens[i];
+        plain_bytes += stored_len("c_plain", key);
+        dict_bytes += stored_len("c_dict", key);
+    }
+
+    /* Rows outside the training set benefit as well */
+    assert_true(dict_bytes < raw_bytes / 2);
+    assert_true(dict_bytes < plain_bytes);
+
+    for (int i = 0; i < ROWS; i++) {
+        snprintf(key, sizeof(key), "k%05d", i);
+        void *value = NULL;
+        size_t value_len = 0;
+        assert_int_equal(WTREE3_OK, wtree3_get(trained, key, 6, &value, &value_len, &error));
+        assert_int_equal(value_len, record_lens[i]);
+        assert_memory_equal(value, records[i], value_len);
+        free(value);
+        free(records[i]);
+    }
+
+    wtree3_tree_close(plain);
+    wtree3_tree_close(trained);
+}
+
+/* ============================================================
+ * Writes and Indexes
+ * ============================================================ */
+
+static void *append_bang(const void *existing_value, size_t existing_len,
+                         void *user_data, size_t *out_len) {
+    (void)user_data;
+    char *out = malloc(existing_len + 1);
+    if (!out) return NULL;
+    memcpy(out, existing_value, existing_len);
+    out[existing_len] = '!';
+    *out_len = existing_len + 1;
+    return out;
+}
+
+static bool starts_with_g3(const void *key, size_t key_len,
+                           const void *value, size_t value_len, void *user_data) {
+    (void)key;
+    (void)key_len;
+    (void)user_data;
+    return value_len >= 8 && memcmp(value, "g0000003", 8) == 0;
+}
+
+static size_t index_hits(wtree3_tree_t *tree, const char *group) {
+    gerror_t error = {0};
+    wtree3_iterator_t *iter = wtree3_index_seek(tree, "group_idx", group, 8, &error);
+    if (!iter) return 0;
+    size_t hits = 0;
+    while (wtree3_iterator_valid(iter)) {
+        const void *k;
+        size_t klen;
+        if (!wtree3_iterator_key(iter, &k, &klen) || klen != 8 || memcmp(k, group, 8) != 0) break;
+        hits++;
+        wtree3_iterator_next(iter);
+    }
+    wtree3_iterator_close(iter);
+    return hits;
+}
+
+static void test_codec_writes_and_indexes(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = create_compressed("c_write", NULL);
+    wtree3_index_config_t cfg = {.name = "group_idx"};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &cfg, &error));
+    put_rows(tree, 200);
+
+    /* The extractor saw the original bytes */
+    assert_int_equal(index_hits(tree, "g0000003"), 20);
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+
+    /* Update moves a row between groups */
+    char value[2048];
+    size_t len = make_value(4, value, sizeof(value));
+    assert_int_equal(WTREE3_OK, wtree3_update(tree, "k00003", 6, value, len, &error));
+    assert_int_equal(index_hits(tree, "g0000003"), 19);
+    assert_int_equal(index_hits(tree, "g0000004"), 21);
+
+    len = make_value(3, value, sizeof(value));
+    assert_int_equal(WTREE3_OK, wtree3_upsert(tree, "k00003", 6, value, len, &error));
+    assert_int_equal(index_hits(tree, "g0000003"), 20);
+
+    /* Modify sees and replaces the original bytes */
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(txn);
+    assert_int_equal(WTREE3_OK, wtree3_modify_txn(txn, tree, "k00001", 6, append_bang, NULL, &error));
+    const void *view;
+    size_t view_len;
+    assert_int_equal(WTREE3_OK, wtree3_get_txn(txn, tree, "k00001", 6, &view, &view_len, &error));
+    len = make_value(1, value, sizeof(value));
+    assert_int_equal(view_len, len + 1);
+    assert_memory_equal(view, value, len);
+    assert_int_equal(((const char *)view)[len], '!');
+
+    /* delete_if tests decoded values and removes their index entries */
+    size_t deleted = 0;
+    assert_int_equal(WTREE3_OK, wtree3_delete_if_txn(txn, tree, NULL, 0, NULL, 0,
+                                                     starts_with_g3, NULL, &deleted, &error));
+    assert_int_equal(deleted, 20);
+    assert_int_equal(WTREE3_OK, wtree3_txn_commit(txn, &error));
+
+    assert_int_equal(index_hits(tree, "g0000003"), 0);
+    assert_int_equal(wtree3_tree_count(tree), 180);
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+
+    /* Online index builds decode too */
+    wtree3_index_config_t late = {.name = "late_idx"};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &late, &error));
+    assert_int_equal(WTREE3_OK, wtree3_tree_populate_index(tree, "late_idx", &error));
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Persistence and Errors
+ * ============================================================ */
+
+static void test_codec_persistence(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = create_compressed("c_persist", NULL);
+    put_rows(tree, 50);
+
+    /* Stored values are framed by the codec: it cannot change now */
+    wtree3_codec_config_t other = {.min_size = 8};
+    assert_int_equal(WTREE3_EINVAL, wtree3_tree_set_codec(tree, &other, &error));
+    assert_int_equal(WTREE3_EINVAL, wtree3_tree_set_codec(tree, NULL, &error));
+    wtree3_tree_close(tree);
+
+    tree = wtree3_tree_open(test_db, "c_persist", 0, 0, &error);
+    assert_non_null(tree);
+    for (int i = 0; i < 50; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "k%05d", i);
+        void *value = NULL;
+        size_t value_len = 0;
+        assert_int_equal(WTREE3_OK, wtree3_get(tree, key, 6, &value, &value_len, &error));
+        assert_row(value, value_len, i);
+        free(value);
+    }
+
+    /* Emptied trees may drop the codec; new values are stored as given */
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(txn);
+    for (int i = 0; i < 50; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "k%05d", i);
+        bool was_deleted = false;
+        assert_int_equal(WTREE3_OK, wtree3_delete_one_txn(txn, tree, key, 6, &was_deleted, &error));
+    }
+    assert_int_equal(WTREE3_OK, wtree3_txn_commit(txn, &error));
+
+    assert_int_equal(WTREE3_OK, wtree3_tree_set_codec(tree, NULL, &error));
+    put_rows(tree, 2);
+    char value[2048];
+    assert_int_equal(stored_len("c_persist", "k00001"), make_value(1, value, sizeof(value)));
+    wtree3_tree_close(tree);
+
+    tree = wtree3_tree_open(test_db, "c_persist", 0, 0, &error);
+    assert_non_null(tree);
+    void *copy = NULL;
+    size_t copy_len = 0;
+    assert_int_equal(WTREE3_OK, wtree3_get(tree, "k00001", 6, &copy, &copy_len, &error));
+    assert_row(copy, copy_len, 1);
+    free(copy);
+    wtree3_tree_close(tree);
+}
+
+static void test_codec_errors(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_codec_config_t cfg = {0};
+    assert_int_equal(WTREE3_EINVAL, wtree3_tree_set_codec(NULL, &cfg, &error));
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "c_errors", 0, 0, &error);
+    assert_non_null(tree);
+    static unsigned char big[WTREE3_CODEC_DICT_MAX + 1];
+    wtree3_codec_config_t too_big = {.dict = big, .dict_len = sizeof(big)};
+    assert_int_equal(WTREE3_EINVAL, wtree3_tree_set_codec(tree, &too_big, &error));
+    wtree3_codec_config_t no_dict = {.dict_len = 16};
+    assert_int_equal(WTREE3_EINVAL, wtree3_tree_set_codec(tree, &no_dict, &error));
+    wtree3_tree_close(tree);
+
+    /* Duplicate values are compared by LMDB: they must stay raw */
+    wtree3_tree_t *dups = wtree3_tree_open(test_db, "c_dups", MDB_DUPSORT, 0, &error);
+    assert_non_null(dups);
+    assert_int_equal(WTREE3_EINVAL, wtree3_tree_set_codec(dups, &cfg, &error));
+    wtree3_tree_close(dups);
+
+    const void *samples[1] = {"abc"};
+    size_t sample_lens[1] = {3};
+    unsigned char dict[64];
+    size_t dict_len;
+    assert_int_equal(WTREE3_EINVAL, wtree3_codec_train(NULL, sample_lens, 1, dict, sizeof(dict),
+                                                       &dict_len, &error));
+    assert_int_equal(WTREE3_EINVAL, wtree3_codec_train(samples, sample_lens, 1, NULL, sizeof(dict),
+                                                       &dict_len, &error));
+    assert_int_equal(WTREE3_EINVAL, wtree3_codec_train(samples, sample_lens, 1, dict, sizeof(dict),
+                                                       NULL, &error));
+
+    /* Nothing shared: an empty dictionary */
+    assert_int_equal(WTREE3_OK, wtree3_codec_train(samples, sample_lens, 1, dict, sizeof(dict),
+                                                   &dict_len, &error));
+    assert_int_equal(dict_len, 0);
+}
+
+/* ============================================================
+ * Main
+ * ============================================================ */
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_codec_read_paths),
+        cmocka_unit_test(test_codec_dictionary),
+        cmocka_unit_test(test_codec_writes_and_indexes),
+        cmocka_unit_test(test_codec_persistence),
+        cmocka_unit_test(test_codec_errors),
+    };
+
+    return cmocka_run_group_tests(tests, setup_db, teardown_db);
+}
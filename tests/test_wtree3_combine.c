@@ -0,0 +1,327 @@
+/*
+ * test_wtree3_combine.c - Tests for write combining of merge upserts
+ *
+ * Tests that:
+ * - Buffered upserts are folded per key, invisible until flushed, and
+ *   applied through the merge callback on top of stored values
+ * - The key threshold flushes from the upsert that crosses it
+ * - Closing and disabling flush what is buffered
+ * - A failing combine callback reports the error and keeps the operand
+ * - Concurrent upserts with frequent flushes lose no increments
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+    #include <process.h>
+    #define mkdir(path, mode) _mkdir(path)
+    #define getpid() _getpid()
+#else
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "wtree3.h"
+#include "wthread.h"
+
+/* Test database path */
+static char test_db_path[256];
+static wtree3_db_t *test_db = NULL;
+
+/* ============================================================
+ * Test Fixtures
+ * ============================================================ */
+
+static int setup_db(void **state) {
+    (void)state;
+
+#ifdef _WIN32
+    snprintf(test_db_path, sizeof(test_db_path), "%s\\test_wtree3_combine_%d",
+             getenv("TEMP"), getpid());
+#else
+    snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_wtree3_combine_%d", getpid());
+#endif
+    mkdir(test_db_path, 0755);
+
+    gerror_t error = {0};
+    test_db = wtree3_db_open(test_db_path, 64 * 1024 * 1024, 64, WTREE3_VERSION(1, 0), 0, &error);
+    if (!test_db) {
+        fprintf(stderr, "Failed to create test database: %s\n", error.message);
+        return -1;
+    }
+    return 0;
+}
+
+static int teardown_db(void **state) {
+    (void)state;
+
+    if (test_db) {
+        wtree3_db_close(test_db);
+        test_db = NULL;
+    }
+
+    char cmd[512];
+#ifdef _WIN32
+    snprintf(cmd, sizeof(cmd), "rd /s /q \"%s\"", test_db_path);
+#else
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", test_db_path);
+#endif
+    (void)system(cmd);
+
+    return 0;
+}
+
+/* Sum of two int64 values: both the merge and the combine callback */
+static void *add_i64(const void *a, size_t a_len, const void *b, size_t b_len,
+                     void *user_data, size_t *out_len) {
+    (void)a_len;
+    (void)b_len;
+    if (user_data) (*(int *)user_data)++;
+
+    int64_t x, y;
+    memcpy(&x, a, sizeof(x));
+    memcpy(&y, b, sizeof(y));
+    int64_t *sum = malloc(sizeof(int64_t));
+    if (!sum) return NULL;
+    *sum = x + y;
+    *out_len = sizeof(int64_t);
+    return sum;
+}
+
+static void *combine_failing(const void *a, size_t a_len, const void *b, size_t b_len,
+                             void *user_data, size_t *out_len) {
+    (void)a;
+    (void)a_len;
+    (void)b;
+    (void)b_len;
+    (void)user_data;
+    (void)out_len;
+    return NULL;
+}
+
+static int64_t read_i64(wtree3_tree_t *tree, const char *key) {
+    gerror_t error = {0};
+    void *value = NULL;
+    size_t value_len = 0;
+    if (wtree3_get(tree, key, strlen(key), &value, &value_len, &error) != WTREE3_OK) return -1;
+    int64_t v;
+    memcpy(&v, value, sizeof(v));
+    free(value);
+    return v;
+}
+
+static wtree3_tree_t *open_counter_tree(const char *name, size_t max_keys, int *combines) {
+    gerror_t error = {0};
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, name, 0, 0, &error);
+    assert_non_null(tree);
+    wtree3_tree_set_merge_fn(tree, add_i64, NULL);
+
+    wtree3_combine_config_t cfg = {
+        .combine_fn = add_i64,
+        .user_data = combines,
+        .max_keys = max_keys,
+        .max_age_us = 60ULL * 1000 * 1000,
+    };
+    assert_int_equal(WTREE3_OK, wtree3_tree_enable_combining(tree, &cfg, &error));
+    return tree;
+}
+
+/* ============================================================
+ * Buffering and Flushing
+ * ============================================================ */
+
+static void test_combine_folds_hot_keys(void **state) {
+    (void)state;
+    gerror_t error = {0};
+    int combines = 0;
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "combine_hot", 0, 0, &error);
+    assert_non_null(tree);
+    int64_t ten = 10;
+    assert_int_equal(WTREE3_OK, wtree3_insert_one(tree, "c0", 2, &ten, sizeof(ten), &error));
+    wtree3_tree_close(tree);
+
+    tree = open_counter_tree("combine_hot", 1000, &combines);
+
+    int64_t one = 1;
+    for (int i = 0; i < 300; i++) {
+        const char *key = (i % 3 == 0) ? "c0" : (i % 3 == 1) ? "c1" : "c2";
+        assert_int_equal(WTREE3_OK, wtree3_upsert(tree, key, 2, &one, sizeof(one), &error));
+    }
+
+    /* 300 upserts, 3 buffered operands, nothing written yet */
+    assert_int_equal(3, wtree3_tree_combining_pending(tree));
+    assert_int_equal(297, combines);
+    assert_int_equal(10, read_i64(tree, "c0"));
+    assert_int_equal(-1, read_i64(tree, "c1"));
+
+    size_t flushed = 0;
+    assert_int_equal(WTREE3_OK, wtree3_tree_flush_combined(tree, &flushed, &error));
+    assert_int_equal(3, flushed);
+    assert_int_equal(0, wtree3_tree_combining_pending(tree));
+
+    /* The stored 10 is merged with the combined 100 */
+    assert_int_equal(110, read_i64(tree, "c0"));
+    assert_int_equal(100, read_i64(tree, "c1"));
+    assert_int_equal(100, read_i64(tree, "c2"));
+
+    /* Nothing buffered: flushing again is a no-op */
+    assert_int_equal(WTREE3_OK, wtree3_tree_flush_combined(tree, &flushed, &error));
+    assert_int_equal(0, flushed);
+
+    wtree3_tree_close(tree);
+}
+
+static void test_combine_key_threshold(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = open_counter_tree("combine_threshold", 4, NULL);
+
+    int64_t one = 1;
+    const char *keys[] = {"k1", "k2", "k3"};
+    for (int i = 0; i < 3; i++) {
+        assert_int_equal(WTREE3_OK, wtree3_upsert(tree, keys[i], 2, &one, sizeof(one), &error));
+    }
+    assert_int_equal(3, wtree3_tree_combining_pending(tree));
+    assert_int_equal(0, wtree3_tree_count(tree));
+
+    /* The fourth key crosses max_keys and flushes everything */
+    assert_int_equal(WTREE3_OK, wtree3_upsert(tree, "k4", 2, &one, sizeof(one), &error));
+    assert_int_equal(0, wtree3_tree_combining_pending(tree));
+    assert_int_equal(4, wtree3_tree_count(tree));
+
+    wtree3_tree_close(tree);
+}
+
+static void test_combine_close_and_disable_flush(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = open_counter_tree("combine_close", 1000, NULL);
+    int64_t five = 5;
+    assert_int_equal(WTREE3_OK, wtree3_upsert(tree, "a", 1, &five, sizeof(five), &error));
+    assert_int_equal(WTREE3_OK, wtree3_upsert(tree, "a", 1, &five, sizeof(five), &error));
+    wtree3_tree_close(tree);
+
+    tree = open_counter_tree("combine_close", 1000, NULL);
+    assert_int_equal(10, read_i64(tree, "a"));
+
+    assert_int_equal(WTREE3_OK, wtree3_upsert(tree, "a", 1, &five, sizeof(five), &error));
+    assert_int_equal(WTREE3_OK, wtree3_tree_disable_combining(tree, &error));
+    assert_int_equal(15, read_i64(tree, "a"));
+
+    /* Disabled: upserts write directly again */
+    assert_int_equal(WTREE3_OK, wtree3_upsert(tree, "a", 1, &five, sizeof(five), &error));
+    assert_int_equal(0, wtree3_tree_combining_pending(tree));
+    assert_int_equal(20, read_i64(tree, "a"));
+
+    wtree3_tree_close(tree);
+}
+
+static void test_combine_callback_failure(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "combine_fail", 0, 0, &error);
+    assert_non_null(tree);
+    wtree3_tree_set_merge_fn(tree, add_i64, NULL);
+    wtree3_combine_config_t cfg = {.combine_fn = combine_failing};
+    assert_int_equal(WTREE3_OK, wtree3_tree_enable_combining(tree, &cfg, &error));
+
+    int64_t seven = 7;
+    assert_int_equal(WTREE3_OK, wtree3_upsert(tree, "x", 1, &seven, sizeof(seven), &error));
+    assert_int_equal(WTREE3_ERROR, wtree3_upsert(tree, "x", 1, &seven, sizeof(seven), &error));
+
+    /* The first operand is still buffered and flushes as is */
+    assert_int_equal(1, wtree3_tree_combining_pending(tree));
+    assert_int_equal(WTREE3_OK, wtree3_tree_flush_combined(tree, NULL, &error));
+    assert_int_equal(7, read_i64(tree, "x"));
+
+    wtree3_combine_config_t none = {0};
+    assert_int_equal(WTREE3_EINVAL, wtree3_tree_enable_combining(tree, &none, &error));
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Concurrency
+ * ============================================================ */
+
+#define WORKERS 4
+#define WORKER_OPS 1000
+#define HOT_KEYS 8
+
+typedef struct {
+    wtree3_tree_t *tree;
+    int failures;
+} worker_ctx_t;
+
+static void *worker_thread(void *arg) {
+    worker_ctx_t *ctx = (worker_ctx_t *)arg;
+    gerror_t error = {0};
+    int64_t one = 1;
+
+    for (int i = 0; i < WORKER_OPS; i++) {
+        char key[8];
+        snprintf(key, sizeof(key), "h%d", i % HOT_KEYS);
+        if (wtree3_upsert(ctx->tree, key, strlen(key), &one, sizeof(one), &error) != WTREE3_OK) {
+            ctx->failures++;
+        }
+    }
+    return NULL;
+}
+
+static void test_combine_concurrent(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    /* A small threshold: flushes race with upserts and with each other */
+    wtree3_tree_t *tree = open_counter_tree("combine_mt", HOT_KEYS / 2, NULL);
+
+    wthread_t threads[WORKERS];
+    worker_ctx_t ctx[WORKERS];
+    for (int t = 0; t < WORKERS; t++) {
+        ctx[t] = (worker_ctx_t){.tree = tree};
+        assert_int_equal(0, wthread_create(&threads[t], worker_thread, &ctx[t]));
+    }
+    for (int t = 0; t < WORKERS; t++) {
+        assert_int_equal(0, wthread_join(threads[t], NULL));
+        assert_int_equal(0, ctx[t].failures);
+    }
+    assert_int_equal(WTREE3_OK, wtree3_tree_flush_combined(tree, NULL, &error));
+
+    int64_t total = 0;
+    for (int k = 0; k < HOT_KEYS; k++) {
+        char key[8];
+        snprintf(key, sizeof(key), "h%d", k);
+        total += read_i64(tree, key);
+    }
+    assert_int_equal(WORKERS * WORKER_OPS, total);
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Main
+ * ============================================================ */
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_combine_folds_hot_keys),
+        cmocka_unit_test(test_combine_key_threshold),
+        cmocka_unit_test(test_combine_close_and_disable_flush),
+        cmocka_unit_test(test_combine_callback_failure),
+        cmocka_unit_test(test_combine_concurrent),
+    };
+
+    return cmocka_run_group_tests(tests, setup_db, teardown_db);
+}
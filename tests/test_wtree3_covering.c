@@ -0,0 +1,432 @@
+/*
+ * test_wtree3_covering.c - Tests for covering indexes
+ *
+ * Tests that an index with a projection (wtree3_index_config_t.project):
+ * - Stores the projected payload next to the main key of every entry
+ * - Refreshes the payload on updates, moves it on key changes and drops
+ *   it on deletes
+ * - Produces identical entries through populate and bulk load
+ * - Is reloaded as covering when the tree is reopened
+ * - Still resolves main keys for joins and verification
+ * - Rejects a custom dupsort comparator
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+    #include <process.h>
+    #define mkdir(path, mode) _mkdir(path)
+    #define getpid() _getpid()
+#else
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "wtree3.h"
+
+#define ROW_COUNT 100
+
+/* Test database path */
+static char test_db_path[256];
+static wtree3_db_t *test_db = NULL;
+
+static bool prefix_key_extractor(const void *value, size_t value_len,
+                                 void *user_data,
+                                 void **out_key, size_t *out_len);
+static bool suffix_projection(const void *value, size_t value_len,
+                              void *user_data,
+                              void **out_key, size_t *out_len);
+
+/* ============================================================
+ * Test Fixtures
+ * ============================================================ */
+
+static int setup_db(void **state) {
+    (void)state;
+
+#ifdef _WIN32
+    snprintf(test_db_path, sizeof(test_db_path), "%s\\test_wtree3_covering_%d",
+             getenv("TEMP"), getpid());
+#else
+    snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_wtree3_covering_%d", getpid());
+#endif
+    mkdir(test_db_path, 0755);
+
+    gerror_t error = {0};
+    test_db = wtree3_db_open(test_db_path, 64 * 1024 * 1024, 128, WTREE3_VERSION(1, 0), 0, &error);
+    if (!test_db) {
+        fprintf(stderr, "Failed to create test database: %s\n", error.message);
+        return -1;
+    }
+
+    for (uint32_t flags = 0; flags <= 0x03; flags++) {
+        int rc = wtree3_db_register_key_extractor(test_db, WTREE3_VERSION(1, 0), flags,
+                                                  prefix_key_extractor, &error);
+        if (rc == WTREE3_OK) {
+            rc = wtree3_db_register_projection(test_db, WTREE3_VERSION(1, 0), flags,
+                                               suffix_projection, &error);
+        }
+        if (rc != WTREE3_OK) {
+            fprintf(stderr, "Failed to register callbacks for flags=0x%02x: %s\n", flags, error.message);
+            wtree3_db_close(test_db);
+            test_db = NULL;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int teardown_db(void **state) {
+    (void)state;
+
+    if (test_db) {
+        wtree3_db_close(test_db);
+        test_db = NULL;
+    }
+
+    char cmd[512];
+#ifdef _WIN32
+    snprintf(cmd, sizeof(cmd), "rd /s /q \"%s\"", test_db_path);
+#else
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", test_db_path);
+#endif
+    (void)system(cmd);
+
+    return 0;
+}
+
+/* Extract first 3 chars as index key */
+static bool prefix_key_extractor(const void *value, size_t value_len,
+                                 void *user_data,
+                                 void **out_key, size_t *out_len) {
+    (void)user_data;
+
+    size_t key_len = (value_len < 3) ? value_len : 3;
+    char *key = malloc(key_len);
+    if (!key) return false;
+
+    memcpy(key, value, key_len);
+    *out_key = key;
+    *out_len = key_len;
+    return true;
+}
+
+/* Project everything after the "cNN-" prefix */
+static bool suffix_projection(const void *value, size_t value_len,
+                              void *user_data,
+                              void **out_key, size_t *out_len) {
+    (void)user_data;
+
+    size_t skip = (value_len < 4) ? value_len : 4;
+    size_t len = value_len - skip;
+    char *payload = malloc(len ? len : 1);
+    if (!payload) return false;
+
+    memcpy(payload, (const char *)value + skip, len);
+    *out_key = payload;
+    *out_len = len;
+    return true;
+}
+
+/* ============================================================
+ * Helpers
+ * ============================================================ */
+
+static wtree3_tree_t *open_covering_tree(const char *name) {
+    gerror_t error = {0};
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, name, 0, 0, &error);
+    assert_non_null(tree);
+
+    wtree3_index_config_t config = {.name = "customer_idx", .project = suffix_projection};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &config, &error));
+    return tree;
+}
+
+/* Orders "o0000".."o0099" with value "cNN-oNNNN"; customer NN = (i * 7) % 10 */
+static void fill_orders(wtree3_tree_t *tree) {
+    gerror_t error = {0};
+    char key[32], value[32];
+    for (int i = 0; i < ROW_COUNT; i++) {
+        snprintf(key, sizeof(key), "o%04d", i);
+        snprintf(value, sizeof(value), "c%02d-o%04d", (i * 7) % 10, i);
+        assert_int_equal(WTREE3_OK,
+                         wtree3_insert_one(tree, key, strlen(key), value, strlen(value), &error));
+    }
+}
+
+/*
+ * Walk all entries of one index key; every payload must be "o" followed by
+ * the main key digits (the order's own id) unless expect is given.
+ */
+static int count_customer(wtree3_tree_t *tree, const char *customer,
+                          const char *main_key, const char *expect) {
+    gerror_t error = {0};
+    wtree3_iterator_t *iter = wtree3_index_seek(tree, "customer_idx", customer,
+                                                strlen(customer), &error);
+    assert_non_null(iter);
+
+    int count = 0;
+    while (wtree3_iterator_valid(iter)) {
+        const void *ikey, *mkey, *payload;
+        size_t ikey_len, mkey_len, payload_len;
+        assert_true(wtree3_iterator_key(iter, &ikey, &ikey_len));
+        if (ikey_len != strlen(customer) || memcmp(ikey, customer, ikey_len) != 0) break;
+
+        assert_true(wtree3_index_iterator_main_key(iter, &mkey, &mkey_len));
+        assert_true(wtree3_index_iterator_payload(iter, &payload, &payload_len));
+        if (main_key && mkey_len == strlen(main_key) && memcmp(mkey, main_key, mkey_len) == 0) {
+            assert_int_equal(payload_len, strlen(expect));
+            assert_memory_equal(payload, expect, payload_len);
+        } else {
+            assert_int_equal(payload_len, mkey_len);
+            assert_memory_equal(payload, mkey, mkey_len);
+        }
+
+        count++;
+        wtree3_iterator_next(iter);
+    }
+    wtree3_iterator_close(iter);
+    return count;
+}
+
+/* ============================================================
+ * Maintenance
+ * ============================================================ */
+
+static void test_covering_insert_payload(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = open_covering_tree("cov_insert");
+    fill_orders(tree);
+
+    for (int c = 0; c < 10; c++) {
+        char customer[8];
+        snprintf(customer, sizeof(customer), "c%02d", c);
+        assert_int_equal(count_customer(tree, customer, NULL, NULL), ROW_COUNT / 10);
+    }
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+
+    wtree3_tree_close(tree);
+}
+
+static void test_covering_update_refreshes_payload(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = open_covering_tree("cov_update");
+    fill_orders(tree);
+
+    /* o0003 belongs to c01; same index key, new payload */
+    const char *same_key = "c01-shipped";
+    assert_int_equal(WTREE3_OK,
+                     wtree3_update(tree, "o0003", 5, same_key, strlen(same_key), &error));
+    assert_int_equal(count_customer(tree, "c01", "o0003", "shipped"), ROW_COUNT / 10);
+
+    /* Move it to c05 */
+    const char *moved = "c05-moved";
+    assert_int_equal(WTREE3_OK,
+                     wtree3_update(tree, "o0003", 5, moved, strlen(moved), &error));
+    assert_int_equal(count_customer(tree, "c01", NULL, NULL), ROW_COUNT / 10 - 1);
+    assert_int_equal(count_customer(tree, "c05", "o0003", "moved"), ROW_COUNT / 10 + 1);
+
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+    wtree3_tree_close(tree);
+}
+
+static void test_covering_delete(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = open_covering_tree("cov_delete");
+    fill_orders(tree);
+
+    bool deleted = false;
+    assert_int_equal(WTREE3_OK, wtree3_delete_one(tree, "o0003", 5, &deleted, &error));
+    assert_true(deleted);
+    assert_int_equal(count_customer(tree, "c01", NULL, NULL), ROW_COUNT / 10 - 1);
+
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Build Paths and Persistence
+ * ============================================================ */
+
+static void test_covering_populate_and_bulk_load(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    /* Index added after the data */
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "cov_populate", 0, 0, &error);
+    assert_non_null(tree);
+    fill_orders(tree);
+    wtree3_index_config_t config = {.name = "customer_idx", .project = suffix_projection};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &config, &error));
+    assert_int_equal(WTREE3_OK, wtree3_tree_populate_index(tree, "customer_idx", &error));
+    assert_int_equal(count_customer(tree, "c04", NULL, NULL), ROW_COUNT / 10);
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+    wtree3_tree_close(tree);
+
+    /* Bulk load into an empty covering index */
+    tree = open_covering_tree("cov_bulk");
+    char keys[ROW_COUNT][8], values[ROW_COUNT][16];
+    wtree3_kv_t kvs[ROW_COUNT];
+    for (int i = 0; i < ROW_COUNT; i++) {
+        snprintf(keys[i], sizeof(keys[i]), "o%04d", i);
+        snprintf(values[i], sizeof(values[i]), "c%02d-o%04d", (i * 7) % 10, i);
+        kvs[i] = (wtree3_kv_t){.key = keys[i], .key_len = strlen(keys[i]),
+                               .value = values[i], .value_len = strlen(values[i])};
+    }
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(txn);
+    assert_int_equal(WTREE3_OK, wtree3_bulk_load_txn(txn, tree, kvs, ROW_COUNT, &error));
+    assert_int_equal(WTREE3_OK, wtree3_txn_commit(txn, &error));
+
+    assert_int_equal(count_customer(tree, "c04", NULL, NULL), ROW_COUNT / 10);
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+    wtree3_tree_close(tree);
+}
+
+static void test_covering_reopen(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = open_covering_tree("cov_reopen");
+    fill_orders(tree);
+    wtree3_tree_close(tree);
+
+    /* The covering flag is persisted; the projection comes from the registry */
+    tree = wtree3_tree_open(test_db, "cov_reopen", 0, 0, &error);
+    assert_non_null(tree);
+    assert_int_equal(count_customer(tree, "c07", NULL, NULL), ROW_COUNT / 10);
+
+    const char *value = "c07-reopened";
+    assert_int_equal(WTREE3_OK,
+                     wtree3_update(tree, "o0001", 5, value, strlen(value), &error));
+    assert_int_equal(count_customer(tree, "c07", "o0001", "reopened"), ROW_COUNT / 10);
+
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Readers
+ * ============================================================ */
+
+typedef struct {
+    int count;
+    bool all_match;
+} join_result_t;
+
+static bool check_join(const void *index_key, size_t index_key_len,
+                       const void *main_key, size_t main_key_len,
+                       const void *value, size_t value_len,
+                       void *user_data) {
+    (void)index_key;
+    (void)index_key_len;
+
+    join_result_t *r = (join_result_t *)user_data;
+    r->count++;
+    /* "cNN-oNNNN" ends with the main key */
+    if (value_len != main_key_len + 4 ||
+        memcmp((const char *)value + 4, main_key, main_key_len) != 0) {
+        r->all_match = false;
+    }
+    return true;
+}
+
+static void test_covering_join_resolves_main_keys(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = open_covering_tree("cov_join");
+    fill_orders(tree);
+
+    join_result_t r = {.all_match = true};
+    assert_int_equal(WTREE3_OK,
+                     wtree3_index_get_many(tree, "customer_idx", "c02", 3,
+                                           WTREE3_JOIN_SORTED, check_join, &r, &error));
+    assert_int_equal(r.count, ROW_COUNT / 10);
+    assert_true(r.all_match);
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Error Cases
+ * ============================================================ */
+
+static int dup_cmp(const MDB_val *a, const MDB_val *b) {
+    size_t len = a->mv_size < b->mv_size ? a->mv_size : b->mv_size;
+    int c = memcmp(a->mv_data, b->mv_data, len);
+    return c ? c : (int)a->mv_size - (int)b->mv_size;
+}
+
+static void test_covering_invalid(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "cov_invalid", 0, 0, &error);
+    assert_non_null(tree);
+
+    wtree3_index_config_t config = {.name = "bad_idx", .project = suffix_projection,
+                                    .dupsort_compare = dup_cmp};
+    assert_int_equal(WTREE3_EINVAL, wtree3_tree_add_index(tree, &config, &error));
+
+    assert_int_equal(WTREE3_EINVAL,
+                     wtree3_db_register_projection(NULL, WTREE3_VERSION(1, 0), 0,
+                                                   suffix_projection, &error));
+    assert_int_equal(WTREE3_EINVAL,
+                     wtree3_db_register_projection(test_db, WTREE3_VERSION(1, 0), 0,
+                                                   NULL, &error));
+
+    /* Plain indexes have no payload */
+    wtree3_index_config_t plain = {.name = "plain_idx"};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &plain, &error));
+    assert_int_equal(WTREE3_OK, wtree3_insert_one(tree, "o1", 2, "c01-x", 5, &error));
+
+    wtree3_iterator_t *iter = wtree3_index_seek(tree, "plain_idx", "c01", 3, &error);
+    assert_non_null(iter);
+    assert_true(wtree3_iterator_valid(iter));
+
+    const void *payload;
+    size_t payload_len;
+    assert_false(wtree3_index_iterator_payload(iter, &payload, &payload_len));
+
+    const void *mkey;
+    size_t mkey_len;
+    assert_true(wtree3_index_iterator_main_key(iter, &mkey, &mkey_len));
+    assert_int_equal(mkey_len, 2);
+    wtree3_iterator_close(iter);
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Main
+ * ============================================================ */
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_covering_insert_payload),
+        cmocka_unit_test(test_covering_update_refreshes_payload),
+        cmocka_unit_test(test_covering_delete),
+        cmocka_unit_test(test_covering_populate_and_bulk_load),
+        cmocka_unit_test(test_covering_reopen),
+        cmocka_unit_test(test_covering_join_resolves_main_keys),
+        cmocka_unit_test(test_covering_invalid),
+    };
+
+    return cmocka_run_group_tests(tests, setup_db, teardown_db);
+}
@@ -0,0 +1,337 @@
+/*
+ * test_wtree3_durability.c - Tests for deferred durability
+ *
+ * Tests that with wtree3_db_enable_deferred_sync():
+ * - The environment runs with MDB_NOSYNC until disabled
+ * - Plain commits share the flusher's syncs
+ * - Commit-count thresholds trigger an early sync
+ * - wtree3_txn_commit_durable()/wtree3_db_wait_durable() return once synced,
+ *   also for concurrent callers
+ * - Closing the database syncs what is left
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+    #include <process.h>
+    #include <io.h>
+    #define mkdir(path, mode) _mkdir(path)
+    #define getpid() _getpid()
+    #define unlink _unlink
+    #define rmdir _rmdir
+#else
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "wtree3.h"
+#include "wthread.h"
+
+#define THREAD_COUNT 4
+#define COMMITS_PER_THREAD 20
+
+/* Test database path */
+static char test_db_path[256];
+static wtree3_db_t *test_db = NULL;
+
+static bool prefix_key_extractor(const void *value, size_t value_len,
+                                 void *user_data,
+                                 void **out_key, size_t *out_len);
+
+/* ============================================================
+ * Test Fixtures
+ * ============================================================ */
+
+static int setup_db(void **state) {
+    (void)state;
+
+#ifdef _WIN32
+    snprintf(test_db_path, sizeof(test_db_path), "%s\\test_wtree3_durability_%d",
+             getenv("TEMP"), getpid());
+#else
+    snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_wtree3_durability_%d", getpid());
+#endif
+    mkdir(test_db_path, 0755);
+
+    gerror_t error = {0};
+    test_db = wtree3_db_open(test_db_path, 64 * 1024 * 1024, 128, WTREE3_VERSION(1, 0), 0, &error);
+    if (!test_db) {
+        fprintf(stderr, "Failed to create test database: %s\n", error.message);
+        return -1;
+    }
+
+    for (uint32_t flags = 0; flags <= 0x03; flags++) {
+        int rc = wtree3_db_register_key_extractor(test_db, WTREE3_VERSION(1, 0), flags,
+                                                  prefix_key_extractor, &error);
+        if (rc != WTREE3_OK) {
+            fprintf(stderr, "Failed to register extractor for flags=0x%02x: %s\n", flags, error.message);
+            wtree3_db_close(test_db);
+            test_db = NULL;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int teardown_db(void **state) {
+    (void)state;
+
+    if (test_db) {
+        wtree3_db_close(test_db);
+        test_db = NULL;
+    }
+
+    char cmd[512];
+#ifdef _WIN32
+    snprintf(cmd, sizeof(cmd), "rd /s /q \"%s\"", test_db_path);
+#else
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", test_db_path);
+#endif
+    (void)system(cmd);
+
+    return 0;
+}
+
+/* Extract first 3 chars as index key */
+static bool prefix_key_extractor(const void *value, size_t value_len,
+                                 void *user_data,
+                                 void **out_key, size_t *out_len) {
+    (void)user_data;
+
+    size_t key_len = (value_len < 3) ? value_len : 3;
+    char *key = malloc(key_len);
+    if (!key) return false;
+
+    memcpy(key, value, key_len);
+    *out_key = key;
+    *out_len = key_len;
+    return true;
+}
+
+/* ============================================================
+ * Helpers
+ * ============================================================ */
+
+static unsigned int env_flags(void) {
+    unsigned int flags = 0;
+    mdb_env_get_flags(wtree3_db_get_env(test_db), &flags);
+    return flags;
+}
+
+static void insert_txn(wtree3_tree_t *tree, int i, bool durable) {
+    gerror_t error = {0};
+    char key[32];
+    snprintf(key, sizeof(key), "k%06d", i);
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(txn);
+    assert_int_equal(WTREE3_OK, wtree3_insert_one_txn(txn, tree, key, strlen(key), "v", 1, &error));
+    if (durable) {
+        assert_int_equal(WTREE3_OK, wtree3_txn_commit_durable(txn, &error));
+    } else {
+        assert_int_equal(WTREE3_OK, wtree3_txn_commit(txn, &error));
+    }
+}
+
+/* Syncs recorded by the metrics layer, or UINT64_MAX if it is compiled out */
+static uint64_t sync_count(void) {
+    gerror_t error = {0};
+    wtree3_metrics_t m;
+    if (wtree3_db_metrics(test_db, &m, &error) != WTREE3_OK) return UINT64_MAX;
+    return m.ops[WTREE3_METRIC_SYNC].count;
+}
+
+/* ============================================================
+ * Configuration Tests
+ * ============================================================ */
+
+static void test_deferred_sync_enable_disable(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    assert_int_equal(WTREE3_EINVAL, wtree3_db_enable_deferred_sync(NULL, NULL, &error));
+    assert_false(env_flags() & MDB_NOSYNC);
+
+    assert_int_equal(WTREE3_OK, wtree3_db_enable_deferred_sync(test_db, NULL, &error));
+    assert_true(env_flags() & MDB_NOSYNC);
+
+    /* Re-enabling just retunes */
+    wtree3_durability_config_t config = {.interval_us = 1000, .max_commits = 5};
+    assert_int_equal(WTREE3_OK, wtree3_db_enable_deferred_sync(test_db, &config, &error));
+
+    wtree3_db_disable_deferred_sync(test_db);
+    assert_false(env_flags() & MDB_NOSYNC);
+    wtree3_db_disable_deferred_sync(test_db);  /* No-op when already disabled */
+    wtree3_db_disable_deferred_sync(NULL);
+}
+
+static void test_durable_without_flusher(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "dur_plain", 0, 0, &error);
+    assert_non_null(tree);
+
+    insert_txn(tree, 1, true);
+    assert_int_equal(WTREE3_OK, wtree3_db_wait_durable(test_db, &error));
+    assert_int_equal(1, wtree3_tree_count(tree));
+
+    assert_int_equal(WTREE3_EINVAL, wtree3_txn_commit_durable(NULL, &error));
+    assert_int_equal(WTREE3_EINVAL, wtree3_db_wait_durable(NULL, &error));
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Flusher Behavior
+ * ============================================================ */
+
+static void test_commits_share_syncs(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "dur_share", 0, 0, &error);
+    assert_non_null(tree);
+
+    bool metrics = wtree3_db_enable_metrics(test_db, true, &error) == WTREE3_OK;
+    wtree3_durability_config_t config = {.interval_us = 20000};
+    assert_int_equal(WTREE3_OK, wtree3_db_enable_deferred_sync(test_db, &config, &error));
+    uint64_t before = sync_count();
+
+    for (int i = 0; i < 200; i++) insert_txn(tree, i, false);
+    assert_int_equal(WTREE3_OK, wtree3_db_wait_durable(test_db, &error));
+
+    if (metrics) {
+        uint64_t syncs = sync_count() - before;
+        assert_true(syncs >= 1);
+        assert_true(syncs < 100);
+    }
+    assert_int_equal(200, wtree3_tree_count(tree));
+
+    wtree3_db_disable_deferred_sync(test_db);
+    if (metrics) assert_int_equal(WTREE3_OK, wtree3_db_enable_metrics(test_db, false, &error));
+    wtree3_tree_close(tree);
+}
+
+static void test_commit_threshold_syncs_early(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "dur_threshold", 0, 0, &error);
+    assert_non_null(tree);
+
+    /* The interval alone would keep the waiter for a minute */
+    wtree3_durability_config_t config = {.interval_us = 60u * 1000 * 1000, .max_commits = 10};
+    assert_int_equal(WTREE3_OK, wtree3_db_enable_deferred_sync(test_db, &config, &error));
+
+    uint64_t start = wtime_now_us();
+    for (int i = 0; i < 10; i++) insert_txn(tree, i, false);
+    assert_int_equal(WTREE3_OK, wtree3_db_wait_durable(test_db, &error));
+    assert_true(wtime_now_us() - start < 10u * 1000 * 1000);
+
+    wtree3_db_disable_deferred_sync(test_db);
+    wtree3_tree_close(tree);
+}
+
+typedef struct {
+    wtree3_tree_t *tree;
+    int thread_id;
+    int failures;
+} durable_ctx_t;
+
+static void *durable_writer(void *arg) {
+    durable_ctx_t *ctx = (durable_ctx_t *)arg;
+    gerror_t error = {0};
+    char key[32];
+
+    for (int i = 0; i < COMMITS_PER_THREAD; i++) {
+        snprintf(key, sizeof(key), "t%02d:%04d", ctx->thread_id, i);
+        wtree3_txn_t *txn = wtree3_txn_begin(test_db, true, &error);
+        if (!txn) {
+            ctx->failures++;
+            continue;
+        }
+        if (wtree3_insert_one_txn(txn, ctx->tree, key, strlen(key), "v", 1, &error) != WTREE3_OK) {
+            wtree3_txn_abort(txn);
+            ctx->failures++;
+            continue;
+        }
+        if (wtree3_txn_commit_durable(txn, &error) != WTREE3_OK) ctx->failures++;
+    }
+    return NULL;
+}
+
+static void test_concurrent_durable_commits(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "dur_concurrent", 0, 0, &error);
+    assert_non_null(tree);
+
+    wtree3_durability_config_t config = {.interval_us = 2000};
+    assert_int_equal(WTREE3_OK, wtree3_db_enable_deferred_sync(test_db, &config, &error));
+
+    wthread_t threads[THREAD_COUNT];
+    durable_ctx_t ctx[THREAD_COUNT];
+    for (int t = 0; t < THREAD_COUNT; t++) {
+        ctx[t] = (durable_ctx_t){.tree = tree, .thread_id = t};
+        assert_int_equal(0, wthread_create(&threads[t], durable_writer, &ctx[t]));
+    }
+    for (int t = 0; t < THREAD_COUNT; t++) {
+        assert_int_equal(0, wthread_join(threads[t], NULL));
+        assert_int_equal(0, ctx[t].failures);
+    }
+    assert_int_equal(THREAD_COUNT * COMMITS_PER_THREAD, wtree3_tree_count(tree));
+
+    wtree3_db_disable_deferred_sync(test_db);
+    wtree3_tree_close(tree);
+}
+
+static void test_close_syncs_pending(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "dur_close", 0, 0, &error);
+    assert_non_null(tree);
+
+    wtree3_durability_config_t config = {.interval_us = 60u * 1000 * 1000};
+    assert_int_equal(WTREE3_OK, wtree3_db_enable_deferred_sync(test_db, &config, &error));
+    for (int i = 0; i < 25; i++) insert_txn(tree, i, false);
+    wtree3_tree_close(tree);
+
+    /* Close with the flusher running, then reopen */
+    wtree3_db_close(test_db);
+    test_db = wtree3_db_open(test_db_path, 64 * 1024 * 1024, 128, WTREE3_VERSION(1, 0), 0, &error);
+    assert_non_null(test_db);
+    assert_false(env_flags() & MDB_NOSYNC);
+
+    tree = wtree3_tree_open(test_db, "dur_close", 0, 0, &error);
+    assert_non_null(tree);
+    assert_int_equal(25, wtree3_tree_count(tree));
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Main
+ * ============================================================ */
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_deferred_sync_enable_disable),
+        cmocka_unit_test(test_durable_without_flusher),
+        cmocka_unit_test(test_commits_share_syncs),
+        cmocka_unit_test(test_commit_threshold_syncs_early),
+        cmocka_unit_test(test_concurrent_durable_commits),
+        cmocka_unit_test(test_close_syncs_pending),
+    };
+
+    return cmocka_run_group_tests(tests, setup_db, teardown_db);
+}
@@ -0,0 +1,374 @@
+/*
+ * test_wtree3_filter.c - Tests for membership filters
+ *
+ * Tests that:
+ * - Filtered trees answer get/exists/exists_many/get_many like unfiltered ones
+ * - Keys inserted after the build are found, missing keys stay missing
+ * - Update/delete of missing keys keep their results
+ * - Unique violations are still caught through an index filter
+ * - Deletes are counted, advise a rebuild, and the rebuild resets them
+ * - Filters come back after reopen and go away on disable/drop
+ * - Non-unique indexes, missing filters and bad parameters are rejected
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+    #include <process.h>
+    #define mkdir(path, mode) _mkdir(path)
+    #define getpid() _getpid()
+#else
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "wtree3.h"
+
+/* Test database path */
+static char test_db_path[256];
+static wtree3_db_t *test_db = NULL;
+
+static bool value_extractor(const void *value, size_t value_len,
+                            void *user_data,
+                            void **out_key, size_t *out_len);
+
+/* ============================================================
+ * Test Fixtures
+ * ============================================================ */
+
+static int setup_db(void **state) {
+    (void)state;
+
+#ifdef _WIN32
+    snprintf(test_db_path, sizeof(test_db_path), "%s\\test_wtree3_filter_%d",
+             getenv("TEMP"), getpid());
+#else
+    snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_wtree3_filter_%d", getpid());
+#endif
+    mkdir(test_db_path, 0755);
+
+    gerror_t error = {0};
+    test_db = wtree3_db_open(test_db_path, 64 * 1024 * 1024, 128, WTREE3_VERSION(1, 0), 0, &error);
+    if (!test_db) {
+        fprintf(stderr, "Failed to create test database: %s\n", error.message);
+        return -1;
+    }
+
+    for (uint32_t flags = 0; flags <= 0x03; flags++) {
+        int rc = wtree3_db_register_key_extractor(test_db, WTREE3_VERSION(1, 0), flags,
+                                                  value_extractor, &error);
+        if (rc != WTREE3_OK) {
+            fprintf(stderr, "Failed to register extractor for flags=0x%02x: %s\n", flags, error.message);
+            wtree3_db_close(test_db);
+            test_db = NULL;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int teardown_db(void **state) {
+    (void)state;
+
+    if (test_db) {
+        wtree3_db_close(test_db);
+        test_db = NULL;
+    }
+
+    char cmd[512];
+#ifdef _WIN32
+    snprintf(cmd, sizeof(cmd), "rd /s /q \"%s\"", test_db_path);
+#else
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", test_db_path);
+#endif
+    (void)system(cmd);
+
+    return 0;
+}
+
+/* Index the whole value */
+static bool value_extractor(const void *value, size_t value_len,
+                            void *user_data,
+                            void **out_key, size_t *out_len) {
+    (void)user_data;
+    if (value_len == 0) return false;
+
+    char *key = malloc(value_len);
+    if (!key) return false;
+
+    memcpy(key, value, value_len);
+    *out_key = key;
+    *out_len = value_len;
+    return true;
+}
+
+/* ============================================================
+ * Helpers
+ * ============================================================ */
+
+/* Keys "k00000".., values "v00000".. */
+static void put_row(wtree3_tree_t *tree, int i) {
+    gerror_t error = {0};
+    char key[16], value[16];
+    snprintf(key, sizeof(key), "k%05d", i);
+    snprintf(value, sizeof(value), "v%05d", i);
+    assert_int_equal(WTREE3_OK,
+                     wtree3_insert_one(tree, key, strlen(key), value, strlen(value), &error));
+}
+
+static bool has_row(wtree3_tree_t *tree, int i) {
+    gerror_t error = {0};
+    char key[16];
+    snprintf(key, sizeof(key), "k%05d", i);
+    return wtree3_exists(tree, key, strlen(key), &error);
+}
+
+static wtree3_tree_t *create_tree(const char *name, int rows) {
+    gerror_t error = {0};
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, name, 0, 0, &error);
+    assert_non_null(tree);
+
+    /* Even keys only: odd keys are the misses */
+    for (int i = 0; i < rows; i++) put_row(tree, i * 2);
+    return tree;
+}
+
+static wtree3_filter_stats_t filter_stats(wtree3_tree_t *tree, const char *index_name) {
+    gerror_t error = {0};
+    wtree3_filter_stats_t fs;
+    assert_int_equal(WTREE3_OK, wtree3_tree_filter_stats(tree, index_name, &fs, &error));
+    return fs;
+}
+
+/* ============================================================
+ * Lookups
+ * ============================================================ */
+
+static void test_filter_lookups(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = create_tree("f_lookup", 2000);
+    assert_int_equal(WTREE3_OK, wtree3_tree_enable_filter(tree, NULL, NULL, &error));
+
+    wtree3_filter_stats_t fs = filter_stats(tree, NULL);
+    assert_int_equal(fs.keys, 2000);
+    assert_true(fs.capacity >= 2000);
+    assert_true(fs.memory_bytes > 0);
+    assert_true(fs.false_positive_rate < 0.05);
+    assert_false(fs.rebuild_advised);
+
+    for (int i = 0; i < 4000; i++) {
+        assert_int_equal(has_row(tree, i), i % 2 == 0);
+    }
+
+    /* Keys written after the build are found */
+    put_row(tree, 1);
+    assert_true(has_row(tree, 1));
+    assert_int_equal(filter_stats(tree, NULL).keys, 2001);
+
+    void *value = NULL;
+    size_t value_len = 0;
+    assert_int_equal(WTREE3_OK, wtree3_get(tree, "k00001", 6, &value, &value_len, &error));
+    assert_int_equal(value_len, 6);
+    assert_memory_equal(value, "v00001", 6);
+    free(value);
+    assert_int_equal(WTREE3_NOT_FOUND, wtree3_get(tree, "k00003", 6, &value, &value_len, &error));
+
+    /* Batch lookups agree with point lookups */
+    char keys[64][8];
+    wtree3_kv_t kvs[64];
+    for (int i = 0; i < 64; i++) {
+        snprintf(keys[i], sizeof(keys[i]), "k%05d", 63 - i);
+        kvs[i] = (wtree3_kv_t){.key = keys[i], .key_len = 6};
+    }
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+    bool found[64];
+    assert_int_equal(WTREE3_OK, wtree3_exists_many_txn(txn, tree, kvs, 64, found, &error));
+    const void *values[64];
+    size_t lens[64];
+    assert_int_equal(WTREE3_OK, wtree3_get_many_txn(txn, tree, kvs, 64, values, lens, &error));
+    for (int i = 0; i < 64; i++) {
+        int row = 63 - i;
+        bool expect = row % 2 == 0 || row == 1;
+        assert_int_equal(found[i], expect);
+        assert_int_equal(values[i] != NULL, expect);
+    }
+    wtree3_txn_abort(txn);
+
+    /* Writes to missing keys keep their results */
+    assert_int_equal(WTREE3_NOT_FOUND, wtree3_update(tree, "k00005", 6, "x", 1, &error));
+    bool deleted = true;
+    assert_int_equal(WTREE3_OK, wtree3_delete_one(tree, "k00005", 6, &deleted, &error));
+    assert_false(deleted);
+
+    wtree3_tree_close(tree);
+}
+
+static void test_filter_unique_index(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = create_tree("f_unique", 500);
+    wtree3_index_config_t cfg = {.name = "value_idx", .unique = true};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &cfg, &error));
+    assert_int_equal(WTREE3_OK, wtree3_tree_populate_index(tree, "value_idx", &error));
+    assert_int_equal(WTREE3_OK, wtree3_tree_enable_filter(tree, "value_idx", NULL, &error));
+    assert_int_equal(filter_stats(tree, "value_idx").keys, 500);
+
+    /* New values pass the probe, taken values are still refused */
+    put_row(tree, 1);
+    assert_int_equal(WTREE3_INDEX_ERROR,
+                     wtree3_insert_one(tree, "other", 5, "v00000", 6, &error));
+    assert_int_equal(WTREE3_INDEX_ERROR,
+                     wtree3_insert_one(tree, "other", 5, "v00001", 6, &error));
+    assert_int_equal(WTREE3_INDEX_ERROR, wtree3_update(tree, "k00002", 6, "v00004", 6, &error));
+    assert_int_equal(WTREE3_OK, wtree3_update(tree, "k00002", 6, "v00003", 6, &error));
+    assert_int_equal(WTREE3_INDEX_ERROR,
+                     wtree3_insert_one(tree, "other", 5, "v00003", 6, &error));
+
+    /* The update removed "v00002" from the index: counted, reusable */
+    assert_int_equal(filter_stats(tree, "value_idx").removed, 1);
+    assert_int_equal(WTREE3_OK, wtree3_insert_one(tree, "other", 5, "v00002", 6, &error));
+
+    /* Filtering the main tree as well changes nothing */
+    assert_int_equal(WTREE3_OK, wtree3_tree_enable_filter(tree, NULL, NULL, &error));
+    assert_int_equal(WTREE3_KEY_EXISTS, wtree3_insert_one(tree, "k00000", 6, "v99999", 6, &error));
+    assert_int_equal(wtree3_tree_count(tree), 502);
+
+    /* Dropping the index drops its filter */
+    assert_int_equal(WTREE3_OK, wtree3_tree_drop_index(tree, "value_idx", &error));
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &cfg, &error));
+    wtree3_filter_stats_t fs;
+    assert_int_equal(WTREE3_NOT_FOUND, wtree3_tree_filter_stats(tree, "value_idx", &fs, &error));
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Maintenance
+ * ============================================================ */
+
+static void test_filter_deletes_and_rebuild(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = create_tree("f_rebuild", 400);
+    assert_int_equal(WTREE3_OK, wtree3_tree_enable_filter(tree, NULL, NULL, &error));
+
+    for (int i = 0; i < 200; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "k%05d", i * 2);
+        bool deleted = false;
+        assert_int_equal(WTREE3_OK, wtree3_delete_one(tree, key, strlen(key), &deleted, &error));
+        assert_true(deleted);
+    }
+
+    /* Deleted keys are "maybe" in the filter but gone from the tree */
+    wtree3_filter_stats_t fs = filter_stats(tree, NULL);
+    assert_int_equal(fs.removed, 200);
+    assert_true(fs.rebuild_advised);
+    assert_false(has_row(tree, 0));
+    assert_true(has_row(tree, 400));
+
+    assert_int_equal(WTREE3_OK, wtree3_tree_rebuild_filter(tree, NULL, &error));
+    fs = filter_stats(tree, NULL);
+    assert_int_equal(fs.keys, 200);
+    assert_int_equal(fs.removed, 0);
+    assert_false(fs.rebuild_advised);
+    for (int i = 0; i < 800; i++) {
+        assert_int_equal(has_row(tree, i), i % 2 == 0 && i >= 400);
+    }
+
+    wtree3_tree_close(tree);
+}
+
+static void test_filter_persistence(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = create_tree("f_persist", 300);
+    wtree3_filter_opts_t opts = {.bits_per_key = 16, .expected_keys = 5000};
+    assert_int_equal(WTREE3_OK, wtree3_tree_enable_filter(tree, NULL, &opts, &error));
+    uint64_t capacity = filter_stats(tree, NULL).capacity;
+    assert_true(capacity >= 5000);
+
+    /* Reopen rebuilds the filter from the data with the stored options */
+    wtree3_tree_close(tree);
+    tree = wtree3_tree_open(test_db, "f_persist", 0, 0, &error);
+    assert_non_null(tree);
+    wtree3_filter_stats_t fs = filter_stats(tree, NULL);
+    assert_int_equal(fs.keys, 300);
+    assert_int_equal(fs.capacity, capacity);
+    assert_true(has_row(tree, 0));
+    assert_false(has_row(tree, 1));
+
+    /* Filter records never load as indexes */
+    assert_int_equal(wtree3_tree_index_count(tree), 0);
+
+    /* Disabled filters stay off after reopen */
+    assert_int_equal(WTREE3_OK, wtree3_tree_disable_filter(tree, NULL, &error));
+    assert_int_equal(WTREE3_NOT_FOUND, wtree3_tree_filter_stats(tree, NULL, &fs, &error));
+    wtree3_tree_close(tree);
+    tree = wtree3_tree_open(test_db, "f_persist", 0, 0, &error);
+    assert_non_null(tree);
+    assert_int_equal(WTREE3_NOT_FOUND, wtree3_tree_filter_stats(tree, NULL, &fs, &error));
+    assert_true(has_row(tree, 0));
+
+    /* Deleting the tree forgets its filter */
+    assert_int_equal(WTREE3_OK, wtree3_tree_enable_filter(tree, NULL, NULL, &error));
+    wtree3_tree_close(tree);
+    assert_int_equal(WTREE3_OK, wtree3_tree_delete(test_db, "f_persist", &error));
+    tree = wtree3_tree_open(test_db, "f_persist", 0, 0, &error);
+    assert_non_null(tree);
+    assert_int_equal(WTREE3_NOT_FOUND, wtree3_tree_filter_stats(tree, NULL, &fs, &error));
+
+    wtree3_tree_close(tree);
+}
+
+static void test_filter_errors(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = create_tree("f_errors", 10);
+    wtree3_index_config_t cfg = {.name = "value_idx"};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &cfg, &error));
+
+    /* Only unique indexes take a filter */
+    assert_int_equal(WTREE3_EINVAL, wtree3_tree_enable_filter(tree, "value_idx", NULL, &error));
+    assert_int_equal(WTREE3_NOT_FOUND, wtree3_tree_enable_filter(tree, "missing", NULL, &error));
+
+    /* Nothing enabled yet */
+    wtree3_filter_stats_t fs;
+    assert_int_equal(WTREE3_NOT_FOUND, wtree3_tree_rebuild_filter(tree, NULL, &error));
+    assert_int_equal(WTREE3_NOT_FOUND, wtree3_tree_disable_filter(tree, NULL, &error));
+    assert_int_equal(WTREE3_NOT_FOUND, wtree3_tree_filter_stats(tree, NULL, &fs, &error));
+
+    assert_int_equal(WTREE3_EINVAL, wtree3_tree_enable_filter(NULL, NULL, NULL, &error));
+    assert_int_equal(WTREE3_EINVAL, wtree3_tree_filter_stats(tree, NULL, NULL, &error));
+
+    wtree3_tree_close(tree);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_filter_lookups),
+        cmocka_unit_test(test_filter_unique_index),
+        cmocka_unit_test(test_filter_deletes_and_rebuild),
+        cmocka_unit_test(test_filter_persistence),
+        cmocka_unit_test(test_filter_errors),
+    };
+
+    return cmocka_run_group_tests(tests, setup_db, teardown_db);
+}
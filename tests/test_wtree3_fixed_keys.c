@@ -0,0 +1,530 @@
+/*
+ * test_wtree3_fixed_keys.c - Tests for fixed-width key fast paths
+ *
+ * Tests that:
+ * - MDB_INTEGERKEY trees iterate in numeric order and keep the flag on reopen
+ * - Fixed-width indexes (DUPFIXED/INTEGERDUP) list main keys numerically
+ * - Their layout is persisted and reloaded with the index
+ * - Keys of the wrong width are rejected on insert, bulk load and build
+ * - Invalid combinations are rejected
+ * - Posting lists come back a page at a time (get_all, handle next_page)
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+    #include <process.h>
+    #define mkdir(path, mode) _mkdir(path)
+    #define getpid() _getpid()
+#else
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "wtree3.h"
+
+/* Test database path */
+static char test_db_path[256];
+static wtree3_db_t *test_db = NULL;
+
+/* Packed record: indexed by group */
+typedef struct {
+    uint32_t group;
+    uint32_t weight;
+} record_t;
+
+/* ============================================================
+ * Test Fixtures
+ * ============================================================ */
+
+static int setup_db(void **state) {
+    (void)state;
+
+#ifdef _WIN32
+    snprintf(test_db_path, sizeof(test_db_path), "%s\\test_wtree3_fixed_keys_%d",
+             getenv("TEMP"), getpid());
+#else
+    snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_wtree3_fixed_keys_%d", getpid());
+#endif
+    mkdir(test_db_path, 0755);
+
+    gerror_t error = {0};
+    test_db = wtree3_db_open(test_db_path, 64 * 1024 * 1024, 128, WTREE3_VERSION(1, 0), 0, &error);
+    if (!test_db) {
+        fprintf(stderr, "Failed to create test database: %s\n", error.message);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int teardown_db(void **state) {
+    (void)state;
+
+    if (test_db) {
+        wtree3_db_close(test_db);
+        test_db = NULL;
+    }
+
+    char cmd[512];
+#ifdef _WIN32
+    snprintf(cmd, sizeof(cmd), "rd /s /q \"%s\"", test_db_path);
+#else
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", test_db_path);
+#endif
+    (void)system(cmd);
+
+    return 0;
+}
+
+/* ============================================================
+ * Helpers
+ * ============================================================ */
+
+static const wtree3_key_spec_t group_spec = {
+    .part_count = 1,
+    .parts = {{.offset = offsetof(record_t, group), .type = WTREE3_KEY_U32}},
+};
+
+static void put_record(wtree3_tree_t *tree, size_t id, uint32_t group) {
+    gerror_t error = {0};
+    record_t r = {.group = group, .weight = (uint32_t)id};
+    assert_int_equal(WTREE3_OK, wtree3_insert_one(tree, &id, sizeof(id), &r, sizeof(r), &error));
+}
+
+/* Main-tree ids in iteration order */
+static size_t tree_order(wtree3_tree_t *tree, size_t *ids, size_t cap) {
+    gerror_t error = {0};
+    wtree3_iterator_t *it = wtree3_iterator_create(tree, &error);
+    assert_non_null(it);
+
+    size_t n = 0;
+    wtree3_iterator_first(it);
+    while (wtree3_iterator_valid(it) && n < cap) {
+        const void *k;
+        size_t k_len;
+        assert_true(wtree3_iterator_key(it, &k, &k_len));
+        assert_int_equal(k_len, sizeof(size_t));
+        memcpy(&ids[n++], k, sizeof(size_t));
+        wtree3_iterator_next(it);
+    }
+    wtree3_iterator_close(it);
+    return n;
+}
+
+/* Main-key ids under one group of the index, in dup order */
+static size_t group_order(wtree3_tree_t *tree, uint32_t group, size_t *ids, size_t cap) {
+    gerror_t error = {0};
+    unsigned char key[8];
+    size_t key_len = 0;
+    record_t probe = {.group = group};
+    assert_int_equal(WTREE3_OK, wtree3_key_spec_encode(&group_spec, &probe, sizeof(probe),
+                                                       key, sizeof(key), &key_len, &error));
+
+    wtree3_iterator_t *it = wtree3_index_seek(tree, "group_idx", key, key_len, &error);
+    assert_non_null(it);
+
+    size_t n = 0;
+    while (wtree3_iterator_valid(it) && n < cap) {
+        const void *ik, *mk;
+        size_t ik_len, mk_len;
+        assert_true(wtree3_iterator_key(it, &ik, &ik_len));
+        if (ik_len != key_len || memcmp(ik, key, key_len) != 0) break;
+        assert_true(wtree3_index_iterator_main_key(it, &mk, &mk_len));
+        assert_int_equal(mk_len, sizeof(size_t));
+        memcpy(&ids[n++], mk, sizeof(size_t));
+        wtree3_iterator_next(it);
+    }
+    wtree3_iterator_close(it);
+    return n;
+}
+
+static bool count_hit(const void *key, size_t key_len, const void *value, size_t value_len,
+                      void *user_data) {
+    (void)key; (void)key_len; (void)value; (void)value_len;
+    (*(size_t *)user_data)++;
+    return true;
+}
+
+/* ============================================================
+ * Integer Keys
+ * ============================================================ */
+
+static void test_integer_key_order(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "fk_int", MDB_INTEGERKEY, 0, &error);
+    assert_non_null(tree);
+
+    /* Little-endian memcmp would put 256 before 1 */
+    put_record(tree, 256, 1);
+    put_record(tree, 1, 1);
+    put_record(tree, 65536, 2);
+    put_record(tree, 2, 2);
+
+    size_t ids[8];
+    assert_int_equal(tree_order(tree, ids, 8), 4);
+    const size_t expected[] = {1, 2, 256, 65536};
+    assert_memory_equal(ids, expected, sizeof(expected));
+
+    /* Not a native integer */
+    record_t r = {0};
+    assert_int_equal(WTREE3_EINVAL, wtree3_insert_one(tree, "abc", 3, &r, sizeof(r), &error));
+    wtree3_tree_close(tree);
+
+    /* Reopening without flags keeps the numeric order */
+    tree = wtree3_tree_open(test_db, "fk_int", 0, 0, &error);
+    assert_non_null(tree);
+    put_record(tree, 3, 1);
+    assert_int_equal(tree_order(tree, ids, 8), 5);
+    const size_t reopened[] = {1, 2, 3, 256, 65536};
+    assert_memory_equal(ids, reopened, sizeof(reopened));
+    assert_int_equal(WTREE3_EINVAL, wtree3_insert_one(tree, "abc", 3, &r, sizeof(r), &error));
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Fixed-Width Indexes
+ * ============================================================ */
+
+static wtree3_tree_t *create_grouped(const char *name) {
+    gerror_t error = {0};
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, name, MDB_INTEGERKEY, 0, &error);
+    assert_non_null(tree);
+
+    wtree3_index_config_t cfg = {.name = "group_idx", .key_spec = &group_spec,
+                                 .main_key_size = sizeof(size_t)};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &cfg, &error));
+
+    put_record(tree, 300, 7);
+    put_record(tree, 5, 7);
+    put_record(tree, 70000, 7);
+    put_record(tree, 6, 8);
+    put_record(tree, 256, 7);
+    return tree;
+}
+
+static void test_dupfixed_index(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = create_grouped("fk_idx");
+
+    /* INTEGERDUP: duplicates in numeric order */
+    size_t ids[8];
+    assert_int_equal(group_order(tree, 7, ids, 8), 4);
+    const size_t expected[] = {5, 256, 300, 70000};
+    assert_memory_equal(ids, expected, sizeof(expected));
+
+    /* Queries see every hit whatever the dup order */
+    unsigned char key[8];
+    size_t key_len = 0;
+    record_t probe = {.group = 7};
+    assert_int_equal(WTREE3_OK, wtree3_key_spec_encode(&group_spec, &probe, sizeof(probe),
+                                                       key, sizeof(key), &key_len, &error));
+    wtree3_index_pred_t preds[2] = {
+        {.index_name = "group_idx", .key = key, .key_len = key_len},
+        {.index_name = "group_idx", .key = key, .key_len = key_len},
+    };
+    size_t hits = 0;
+    assert_int_equal(WTREE3_OK, wtree3_index_query(tree, preds, 2, WTREE3_QUERY_AND,
+                                                   count_hit, &hits, &error));
+    assert_int_equal(hits, 4);
+
+    /* Narrower keys would not fit the packed dups */
+    unsigned int narrow = 9;
+    record_t r = {.group = 7};
+    if (sizeof(narrow) != sizeof(size_t)) {
+        assert_int_equal(WTREE3_EINVAL,
+                         wtree3_insert_one(tree, &narrow, sizeof(narrow), &r, sizeof(r), &error));
+    }
+
+    /* Updates and deletes keep the index consistent */
+    size_t id = 300;
+    r.group = 8;
+    assert_int_equal(WTREE3_OK, wtree3_update(tree, &id, sizeof(id), &r, sizeof(r), &error));
+    id = 5;
+    assert_int_equal(WTREE3_OK, wtree3_delete_one(tree, &id, sizeof(id), NULL, &error));
+    assert_int_equal(group_order(tree, 7, ids, 8), 2);
+    assert_int_equal(group_order(tree, 8, ids, 8), 2);
+    assert_int_equal(ids[0], 6);
+    assert_int_equal(ids[1], 300);
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+
+    wtree3_tree_close(tree);
+}
+
+static void test_dupfixed_persistence(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = create_grouped("fk_persist");
+    wtree3_tree_close(tree);
+
+    tree = wtree3_tree_open(test_db, "fk_persist", 0, 0, &error);
+    assert_non_null(tree);
+    assert_int_equal(wtree3_tree_index_count(tree), 1);
+
+    put_record(tree, 1, 7);
+    size_t ids[8];
+    assert_int_equal(group_order(tree, 7, ids, 8), 5);
+    const size_t expected[] = {1, 5, 256, 300, 70000};
+    assert_memory_equal(ids, expected, sizeof(expected));
+
+    /* The width is back in force too */
+    record_t r = {.group = 7};
+    assert_int_equal(WTREE3_EINVAL, wtree3_insert_one(tree, "abc", 3, &r, sizeof(r), &error));
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+
+    wtree3_tree_close(tree);
+}
+
+static void test_dupfixed_plain_tree(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    /* No INTEGERKEY: packed dups in memcmp order, any width */
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "fk_plain", 0, 0, &error);
+    assert_non_null(tree);
+
+    wtree3_index_config_t cfg = {.name = "group_idx", .key_spec = &group_spec, .main_key_size = 3};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &cfg, &error));
+
+    record_t r = {.group = 1};
+    wtree3_kv_t kvs[] = {
+        {.key = "aaa", .key_len = 3, .value = &r, .value_len = sizeof(r)},
+        {.key = "bbb", .key_len = 3, .value = &r, .value_len = sizeof(r)},
+        {.key = "cc", .key_len = 2, .value = &r, .value_len = sizeof(r)},
+    };
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(txn);
+    assert_int_equal(WTREE3_EINVAL, wtree3_bulk_load_txn(txn, tree, kvs, 3, &error));
+    assert_int_equal(WTREE3_OK, wtree3_bulk_load_txn(txn, tree, kvs, 2, &error));
+    assert_int_equal(WTREE3_OK, wtree3_txn_commit(txn, &error));
+
+    assert_int_equal(WTREE3_EINVAL, wtree3_insert_one(tree, "dddd", 4, &r, sizeof(r), &error));
+    assert_int_equal(WTREE3_OK, wtree3_insert_one(tree, "ddd", 3, &r, sizeof(r), &error));
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+
+    /* Dropping the last fixed-width index lifts the restriction */
+    assert_int_equal(WTREE3_OK, wtree3_tree_drop_index(tree, "group_idx", &error));
+    assert_int_equal(WTREE3_OK, wtree3_insert_one(tree, "dddd", 4, &r, sizeof(r), &error));
+
+    /* Existing keys of another width fail the build */
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &cfg, &error));
+    assert_int_equal(WTREE3_EINVAL, wtree3_tree_build_index(tree, "group_idx", NULL, &error));
+
+    wtree3_tree_close(tree);
+}
+
+static int reverse_cmp(const MDB_val *a, const MDB_val *b) {
+    return -memcmp(a->mv_data, b->mv_data, a->mv_size < b->mv_size ? a->mv_size : b->mv_size);
+}
+
+static void test_fixed_key_errors(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "fk_errors", MDB_INTEGERKEY, 0, &error);
+    assert_non_null(tree);
+
+    /* Integer dups must be native integers */
+    wtree3_index_config_t cfg = {.name = "bad_idx", .key_spec = &group_spec, .main_key_size = 3};
+    assert_int_equal(WTREE3_EINVAL, wtree3_tree_add_index(tree, &cfg, &error));
+
+    /* Packed dups have no room for a comparator */
+    cfg.main_key_size = sizeof(size_t);
+    cfg.dupsort_compare = reverse_cmp;
+    assert_int_equal(WTREE3_EINVAL, wtree3_tree_add_index(tree, &cfg, &error));
+    assert_int_equal(wtree3_tree_index_count(tree), 0);
+
+    /* All fixed-width indexes agree on one width */
+    cfg.dupsort_compare = NULL;
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &cfg, &error));
+    if (sizeof(unsigned int) != sizeof(size_t)) {
+        wtree3_index_config_t other = {.name = "other_idx", .key_spec = &group_spec,
+                                       .main_key_size = sizeof(unsigned int)};
+        assert_int_equal(WTREE3_EINVAL, wtree3_tree_add_index(tree, &other, &error));
+    }
+    assert_int_equal(wtree3_tree_index_count(tree), 1);
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Posting-List Pages
+ * ============================================================ */
+
+typedef struct {
+    size_t ids[4096];
+    size_t count;
+    size_t pages;
+    size_t key_size;
+    size_t stop_after;              /* Pages (0 = all) */
+} collect_t;
+
+static bool collect_page(const wtree3_index_page_t *page, void *user_data) {
+    collect_t *c = (collect_t *)user_data;
+    assert_true(page->count >= 1);
+    c->key_size = page->key_size;
+    for (size_t i = 0; i < page->count; i++) {
+        memcpy(&c->ids[c->count++], (const unsigned char *)page->main_keys + i * page->key_size,
+               sizeof(size_t));
+    }
+    return ++c->pages != c->stop_after;
+}
+
+static unsigned char group_key[8];
+static size_t group_key_len;
+
+static void encode_group(uint32_t group) {
+    gerror_t error = {0};
+    record_t probe = {.group = group};
+    assert_int_equal(WTREE3_OK, wtree3_key_spec_encode(&group_spec, &probe, sizeof(probe),
+                                                       group_key, sizeof(group_key),
+                                                       &group_key_len, &error));
+}
+
+static void test_get_all_pages(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "fk_pages", MDB_INTEGERKEY, 0, &error);
+    assert_non_null(tree);
+    wtree3_index_config_t cfg = {.name = "group_idx", .key_spec = &group_spec,
+                                 .main_key_size = sizeof(size_t)};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &cfg, &error));
+
+    /* Enough dups for several pages, inserted out of order */
+    for (size_t i = 0; i < 3000; i++) put_record(tree, (i * 7919) % 3000 + 1, 1);
+    put_record(tree, 5000, 2);
+
+    static collect_t c;
+    memset(&c, 0, sizeof(c));
+    encode_group(1);
+    assert_int_equal(WTREE3_OK, wtree3_index_get_all(tree, "group_idx", group_key, group_key_len,
+                                                     collect_page, &c, &error));
+    assert_int_equal(c.count, 3000);
+    assert_int_equal(c.key_size, sizeof(size_t));
+    assert_true(c.pages > 1);
+    assert_true(c.pages < 100);
+    for (size_t i = 0; i < c.count; i++) assert_int_equal(c.ids[i], i + 1);
+
+    /* A lone dup, an early stop and an absent key */
+    memset(&c, 0, sizeof(c));
+    encode_group(2);
+    assert_int_equal(WTREE3_OK, wtree3_index_get_all(tree, "group_idx", group_key, group_key_len,
+                                                     collect_page, &c, &error));
+    assert_int_equal(c.count, 1);
+    assert_int_equal(c.ids[0], 5000);
+
+    memset(&c, 0, sizeof(c));
+    c.stop_after = 1;
+    encode_group(1);
+    assert_int_equal(WTREE3_OK, wtree3_index_get_all(tree, "group_idx", group_key, group_key_len,
+                                                     collect_page, &c, &error));
+    assert_int_equal(c.pages, 1);
+
+    memset(&c, 0, sizeof(c));
+    encode_group(3);
+    assert_int_equal(WTREE3_OK, wtree3_index_get_all(tree, "group_idx", group_key, group_key_len,
+                                                     collect_page, &c, &error));
+    assert_int_equal(c.count, 0);
+
+    assert_int_equal(WTREE3_NOT_FOUND, wtree3_index_get_all(tree, "nope_idx", group_key,
+                                                            group_key_len, collect_page, &c,
+                                                            &error));
+
+    /* Handle: single steps and pages mix, nothing repeated or skipped */
+    wtree3_index_handle_t *h = wtree3_index_handle_open(tree, "group_idx", &error);
+    assert_non_null(h);
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+
+    encode_group(1);
+    wtree3_index_hit_t hit;
+    wtree3_index_page_t page;
+    assert_int_equal(WTREE3_OK, wtree3_index_handle_seek(h, txn, group_key, group_key_len, 0,
+                                                         &hit, &error));
+    size_t expected = 1, id;
+    memcpy(&id, hit.main_key, sizeof(id));
+    assert_int_equal(id, expected++);
+
+    int rc;
+    bool step = false;
+    while (true) {
+        if (step) {
+            rc = wtree3_index_handle_next(h, &hit, &error);
+            if (rc != WTREE3_OK) break;
+            memcpy(&id, hit.main_key, sizeof(id));
+            assert_int_equal(id, expected++);
+        } else {
+            rc = wtree3_index_handle_next_page(h, &page, &error);
+            if (rc != WTREE3_OK) break;
+            for (size_t i = 0; i < page.count; i++) {
+                memcpy(&id, (const unsigned char *)page.main_keys + i * page.key_size, sizeof(id));
+                assert_int_equal(id, expected++);
+            }
+        }
+        step = !step;
+    }
+    assert_int_equal(rc, WTREE3_NOT_FOUND);
+    assert_int_equal(expected, 3001);
+
+    /* Range seeks have no posting list to page through */
+    assert_int_equal(WTREE3_OK, wtree3_index_handle_seek(h, txn, group_key, group_key_len,
+                                                         WTREE3_SEEK_RANGE, &hit, &error));
+    assert_int_equal(WTREE3_EINVAL, wtree3_index_handle_next_page(h, &page, &error));
+
+    wtree3_txn_abort(txn);
+    wtree3_index_handle_close(h);
+    wtree3_tree_close(tree);
+}
+
+static void test_get_all_variable_width(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    /* Other indexes page one main key at a time */
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "fk_varpages", 0, 0, &error);
+    assert_non_null(tree);
+    wtree3_index_config_t cfg = {.name = "group_idx", .key_spec = &group_spec};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &cfg, &error));
+    for (size_t i = 1; i <= 10; i++) put_record(tree, i, 4);
+
+    static collect_t c;
+    memset(&c, 0, sizeof(c));
+    encode_group(4);
+    assert_int_equal(WTREE3_OK, wtree3_index_get_all(tree, "group_idx", group_key, group_key_len,
+                                                     collect_page, &c, &error));
+    assert_int_equal(c.count, 10);
+    assert_int_equal(c.pages, 10);
+    assert_int_equal(c.key_size, sizeof(size_t));
+
+    wtree3_tree_close(tree);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_integer_key_order),
+        cmocka_unit_test(test_dupfixed_index),
+        cmocka_unit_test(test_dupfixed_persistence),
+        cmocka_unit_test(test_dupfixed_plain_tree),
+        cmocka_unit_test(test_fixed_key_errors),
+        cmocka_unit_test(test_get_all_pages),
+        cmocka_unit_test(test_get_all_variable_width),
+    };
+
+    return cmocka_run_group_tests(tests, setup_db, teardown_db);
+}
@@ -0,0 +1,303 @@
+/*
+ * test_wtree3_group_commit.c - Tests for the group-commit write batcher
+ *
+ * Tests that auto-transaction writes routed through the batcher:
+ * - Behave like their one-txn-per-call counterparts (single thread)
+ * - Report per-caller result codes (duplicates, unique violations)
+ * - Stay consistent (count, indexes) under concurrent writers
+ * - Honor max_batch / max_wait_us configuration
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+    #include <process.h>
+    #include <io.h>
+    #define mkdir(path, mode) _mkdir(path)
+    #define getpid() _getpid()
+    #define unlink _unlink
+    #define rmdir _rmdir
+#else
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "wtree3.h"
+#include "wthread.h"
+
+#define THREAD_COUNT 8
+#define OPS_PER_THREAD 200
+
+/* Test database path */
+static char test_db_path[256];
+static wtree3_db_t *test_db = NULL;
+
+static bool prefix_key_extractor(const void *value, size_t value_len,
+                                 void *user_data,
+                                 void **out_key, size_t *out_len);
+
+/* ============================================================
+ * Test Fixtures
+ * ============================================================ */
+
+static int setup_db(void **state) {
+    (void)state;
+
+#ifdef _WIN32
+    snprintf(test_db_path, sizeof(test_db_path), "%s\\test_wtree3_group_commit_%d",
+             getenv("TEMP"), getpid());
+#else
+    snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_wtree3_group_commit_%d", getpid());
+#endif
+    mkdir(test_db_path, 0755);
+
+    gerror_t error = {0};
+    test_db = wtree3_db_open(test_db_path, 64 * 1024 * 1024, 128, WTREE3_VERSION(1, 0), 0, &error);
+    if (!test_db) {
+        fprintf(stderr, "Failed to create test database: %s\n", error.message);
+        return -1;
+    }
+
+    for (uint32_t flags = 0; flags <= 0x03; flags++) {
+        int rc = wtree3_db_register_key_extractor(test_db, WTREE3_VERSION(1, 0), flags,
+                                                  prefix_key_extractor, &error);
+        if (rc != WTREE3_OK) {
+            fprintf(stderr, "Failed to register extractor for flags=0x%02x: %s\n", flags, error.message);
+            wtree3_db_close(test_db);
+            test_db = NULL;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int teardown_db(void **state) {
+    (void)state;
+
+    if (test_db) {
+        wtree3_db_close(test_db);
+        test_db = NULL;
+    }
+
+    char cmd[512];
+#ifdef _WIN32
+    snprintf(cmd, sizeof(cmd), "rd /s /q \"%s\"", test_db_path);
+#else
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", test_db_path);
+#endif
+    (void)system(cmd);
+
+    return 0;
+}
+
+/* Extract first 3 chars as index key */
+static bool prefix_key_extractor(const void *value, size_t value_len,
+                                 void *user_data,
+                                 void **out_key, size_t *out_len) {
+    (void)user_data;
+
+    size_t key_len = (value_len < 3) ? value_len : 3;
+    char *key = malloc(key_len);
+    if (!key) return false;
+
+    memcpy(key, value, key_len);
+    *out_key = key;
+    *out_len = key_len;
+    return true;
+}
+
+/* ============================================================
+ * Configuration Tests
+ * ============================================================ */
+
+static void test_group_commit_enable_disable(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    assert_int_equal(WTREE3_EINVAL, wtree3_db_enable_group_commit(NULL, NULL, &error));
+
+    assert_int_equal(WTREE3_OK, wtree3_db_enable_group_commit(test_db, NULL, &error));
+
+    /* Re-enabling just retunes */
+    wtree3_group_commit_config_t config = {.max_batch = 16, .max_wait_us = 100};
+    assert_int_equal(WTREE3_OK, wtree3_db_enable_group_commit(test_db, &config, &error));
+
+    wtree3_db_disable_group_commit(test_db);
+    wtree3_db_disable_group_commit(test_db);  /* No-op when already disabled */
+    wtree3_db_disable_group_commit(NULL);
+}
+
+/* ============================================================
+ * Single-Thread Semantics
+ * ============================================================ */
+
+static void test_group_commit_single_thread_ops(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "gc_single", 0, 0, &error);
+    assert_non_null(tree);
+    assert_int_equal(WTREE3_OK, wtree3_db_enable_group_commit(test_db, NULL, &error));
+
+    assert_int_equal(WTREE3_OK, wtree3_insert_one(tree, "k1", 2, "v1", 2, &error));
+    assert_int_equal(WTREE3_KEY_EXISTS, wtree3_insert_one(tree, "k1", 2, "v2", 2, &error));
+    assert_int_equal(1, wtree3_tree_count(tree));
+
+    assert_int_equal(WTREE3_OK, wtree3_update(tree, "k1", 2, "v3", 2, &error));
+    assert_int_equal(WTREE3_NOT_FOUND, wtree3_update(tree, "nope", 4, "v", 1, &error));
+
+    assert_int_equal(WTREE3_OK, wtree3_upsert(tree, "k2", 2, "v4", 2, &error));
+    assert_int_equal(2, wtree3_tree_count(tree));
+
+    void *value;
+    size_t value_len;
+    assert_int_equal(WTREE3_OK, wtree3_get(tree, "k1", 2, &value, &value_len, &error));
+    assert_memory_equal("v3", value, 2);
+    free(value);
+
+    bool deleted = false;
+    assert_int_equal(WTREE3_OK, wtree3_delete_one(tree, "k1", 2, &deleted, &error));
+    assert_true(deleted);
+    assert_int_equal(WTREE3_OK, wtree3_delete_one(tree, "k1", 2, &deleted, &error));
+    assert_false(deleted);
+    assert_int_equal(1, wtree3_tree_count(tree));
+
+    wtree3_db_disable_group_commit(test_db);
+    wtree3_tree_close(tree);
+}
+
+static void test_group_commit_unique_violation_isolated(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "gc_unique", 0, 0, &error);
+    assert_non_null(tree);
+
+    wtree3_index_config_t config = {.name = "prefix_idx", .unique = true};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &config, &error));
+    assert_int_equal(WTREE3_OK, wtree3_db_enable_group_commit(test_db, NULL, &error));
+
+    assert_int_equal(WTREE3_OK, wtree3_insert_one(tree, "a", 1, "abc-1", 5, &error));
+    assert_int_equal(WTREE3_INDEX_ERROR, wtree3_insert_one(tree, "b", 1, "abc-2", 5, &error));
+    assert_int_equal(WTREE3_OK, wtree3_insert_one(tree, "c", 1, "xyz-3", 5, &error));
+
+    assert_int_equal(2, wtree3_tree_count(tree));
+    assert_false(wtree3_exists(tree, "b", 1, &error));
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+
+    wtree3_db_disable_group_commit(test_db);
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Concurrent Writers
+ * ============================================================ */
+
+typedef struct {
+    wtree3_tree_t *tree;
+    int thread_id;
+    int ok_count;
+    int shared_ok;
+    int failures;
+} writer_ctx_t;
+
+static void *writer_thread(void *arg) {
+    writer_ctx_t *ctx = (writer_ctx_t *)arg;
+    gerror_t error = {0};
+    char key[32], value[32];
+
+    for (int i = 0; i < OPS_PER_THREAD; i++) {
+        snprintf(key, sizeof(key), "t%02d:%04d", ctx->thread_id, i);
+        snprintf(value, sizeof(value), "%03d-value-%04d", ctx->thread_id, i);
+        int rc = wtree3_insert_one(ctx->tree, key, strlen(key), value, strlen(value), &error);
+        if (rc == WTREE3_OK) ctx->ok_count++;
+        else ctx->failures++;
+    }
+
+    /* Every thread races for the same key - exactly one must win */
+    int rc = wtree3_insert_one(ctx->tree, "shared", 6, "shared-value", 12, &error);
+    if (rc == WTREE3_OK) ctx->shared_ok = 1;
+    else if (rc != WTREE3_KEY_EXISTS) ctx->failures++;
+
+    /* Delete every other key we wrote */
+    for (int i = 0; i < OPS_PER_THREAD; i += 2) {
+        bool deleted = false;
+        snprintf(key, sizeof(key), "t%02d:%04d", ctx->thread_id, i);
+        rc = wtree3_delete_one(ctx->tree, key, strlen(key), &deleted, &error);
+        if (rc == WTREE3_OK && deleted) ctx->ok_count--;
+        else ctx->failures++;
+    }
+
+    return NULL;
+}
+
+static void run_concurrent_writers(const char *tree_name,
+                                   const wtree3_group_commit_config_t *config) {
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, tree_name, 0, 0, &error);
+    assert_non_null(tree);
+
+    wtree3_index_config_t idx = {.name = "prefix_idx"};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &idx, &error));
+    assert_int_equal(WTREE3_OK, wtree3_db_enable_group_commit(test_db, config, &error));
+
+    wthread_t threads[THREAD_COUNT];
+    writer_ctx_t ctx[THREAD_COUNT];
+    for (int t = 0; t < THREAD_COUNT; t++) {
+        ctx[t] = (writer_ctx_t){.tree = tree, .thread_id = t};
+        assert_int_equal(0, wthread_create(&threads[t], writer_thread, &ctx[t]));
+    }
+
+    int expected = 0, shared_winners = 0;
+    for (int t = 0; t < THREAD_COUNT; t++) {
+        assert_int_equal(0, wthread_join(threads[t], NULL));
+        assert_int_equal(0, ctx[t].failures);
+        expected += ctx[t].ok_count;
+        shared_winners += ctx[t].shared_ok;
+    }
+
+    assert_int_equal(1, shared_winners);
+    assert_int_equal(THREAD_COUNT * OPS_PER_THREAD / 2, expected);
+    assert_int_equal(expected + 1, wtree3_tree_count(tree));
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+
+    wtree3_db_disable_group_commit(test_db);
+    wtree3_tree_close(tree);
+}
+
+static void test_group_commit_concurrent_default(void **state) {
+    (void)state;
+    run_concurrent_writers("gc_concurrent", NULL);
+}
+
+static void test_group_commit_concurrent_small_batches_with_wait(void **state) {
+    (void)state;
+    wtree3_group_commit_config_t config = {.max_batch = 4, .max_wait_us = 500};
+    run_concurrent_writers("gc_concurrent_wait", &config);
+}
+
+/* ============================================================
+ * Main
+ * ============================================================ */
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_group_commit_enable_disable),
+        cmocka_unit_test(test_group_commit_single_thread_ops),
+        cmocka_unit_test(test_group_commit_unique_violation_isolated),
+        cmocka_unit_test(test_group_commit_concurrent_default),
+        cmocka_unit_test(test_group_commit_concurrent_small_batches_with_wait),
+    };
+
+    return cmocka_run_group_tests(tests, setup_db, teardown_db);
+}
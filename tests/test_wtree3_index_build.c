@@ -0,0 +1,513 @@
+/*
+ * test_wtree3_index_build.c - Tests for the sort-based index build
+ *
+ * Tests wtree3_tree_build_index():
+ * - Single- and multi-threaded builds produce a consistent index
+ * - Tiny memory budgets force spill files (tmpfile() and tmp_dir)
+ * - Unique violations spanning workers are caught in the merge and roll
+ *   back the whole build
+ * - Building into a non-empty index (no append path)
+ *
+ * Tests the online build (wtree3_tree_build_index_step/_online):
+ * - Chunked progress, hidden index until done, writes around the cursor
+ * - Resume after reopening the tree
+ * - Concurrent writers while the build runs
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+    #include <process.h>
+    #include <io.h>
+    #define mkdir(path, mode) _mkdir(path)
+    #define getpid() _getpid()
+    #define unlink _unlink
+    #define rmdir _rmdir
+#else
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "wtree3.h"
+#include "wthread.h"
+
+#define ROW_COUNT 20000
+#define GROUP_COUNT 1000
+
+/* Test database path */
+static char test_db_path[256];
+static wtree3_db_t *test_db = NULL;
+
+static bool field_key_extractor(const void *value, size_t value_len,
+                                void *user_data,
+                                void **out_key, size_t *out_len);
+
+/* ============================================================
+ * Test Fixtures
+ * ============================================================ */
+
+static int setup_db(void **state) {
+    (void)state;
+
+#ifdef _WIN32
+    snprintf(test_db_path, sizeof(test_db_path), "%s\\test_wtree3_index_build_%d",
+             getenv("TEMP"), getpid());
+#else
+    snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_wtree3_index_build_%d", getpid());
+#endif
+    mkdir(test_db_path, 0755);
+
+    gerror_t error = {0};
+    test_db = wtree3_db_open(test_db_path, 256 * 1024 * 1024, 128, WTREE3_VERSION(1, 0), 0, &error);
+    if (!test_db) {
+        fprintf(stderr, "Failed to create test database: %s\n", error.message);
+        return -1;
+    }
+
+    for (uint32_t flags = 0; flags <= 0x03; flags++) {
+        int rc = wtree3_db_register_key_extractor(test_db, WTREE3_VERSION(1, 0), flags,
+                                                  field_key_extractor, &error);
+        if (rc != WTREE3_OK) {
+            fprintf(stderr, "Failed to register extractor for flags=0x%02x: %s\n", flags, error.message);
+            wtree3_db_close(test_db);
+            test_db = NULL;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int teardown_db(void **state) {
+    (void)state;
+
+    if (test_db) {
+        wtree3_db_close(test_db);
+        test_db = NULL;
+    }
+
+    char cmd[512];
+#ifdef _WIN32
+    snprintf(cmd, sizeof(cmd), "rd /s /q \"%s\"", test_db_path);
+#else
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", test_db_path);
+#endif
+    (void)system(cmd);
+
+    return 0;
+}
+
+/* Extract everything before the first '|' as index key (thread-safe) */
+static bool field_key_extractor(const void *value, size_t value_len,
+                                void *user_data,
+                                void **out_key, size_t *out_len) {
+    (void)user_data;
+
+    const char *sep = memchr(value, '|', value_len);
+    size_t key_len = sep ? (size_t)(sep - (const char *)value) : value_len;
+    char *key = malloc(key_len ? key_len : 1);
+    if (!key) return false;
+
+    memcpy(key, value, key_len);
+    *out_key = key;
+    *out_len = key_len;
+    return true;
+}
+
+/* ============================================================
+ * Helpers
+ * ============================================================ */
+
+/* Fill a tree with ROW_COUNT rows; unique_field selects "u<row>" vs "g<group>" */
+static wtree3_tree_t *create_filled_tree(const char *name, bool unique_field) {
+    gerror_t error = {0};
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, name, 0, 0, &error);
+    assert_non_null(tree);
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(txn);
+
+    char key[32], value[64];
+    for (int i = 0; i < ROW_COUNT; i++) {
+        snprintf(key, sizeof(key), "row:%08d", i);
+        if (unique_field) {
+            snprintf(value, sizeof(value), "u%08d|payload-%d", i, i);
+        } else {
+            snprintf(value, sizeof(value), "g%04d|payload-%d", (i * 7) % GROUP_COUNT, i);
+        }
+        assert_int_equal(WTREE3_OK, wtree3_insert_one_txn(txn, tree, key, strlen(key),
+                                                          value, strlen(value), &error));
+    }
+    assert_int_equal(WTREE3_OK, wtree3_txn_commit(txn, &error));
+    return tree;
+}
+
+/* Count all entries of an index by walking it from the lowest key */
+static size_t count_index_entries(wtree3_tree_t *tree, const char *index_name) {
+    gerror_t error = {0};
+    wtree3_iterator_t *iter = wtree3_index_seek_range(tree, index_name, "!", 1, &error);
+    if (!iter) return 0;
+
+    size_t n = 0;
+    while (wtree3_iterator_valid(iter)) {
+        n++;
+        wtree3_iterator_next(iter);
+    }
+    wtree3_iterator_close(iter);
+    return n;
+}
+
+static void build_and_check(const char *tree_name, const wtree3_index_build_opts_t *opts) {
+    gerror_t error = {0};
+    wtree3_tree_t *tree = create_filled_tree(tree_name, false);
+
+    wtree3_index_config_t config = {.name = "group_idx"};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &config, &error));
+    assert_int_equal(WTREE3_OK, wtree3_tree_build_index(tree, "group_idx", opts, &error));
+
+    assert_int_equal(ROW_COUNT, count_index_entries(tree, "group_idx"));
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+
+    /* Every group holds ROW_COUNT / GROUP_COUNT rows */
+    wtree3_iterator_t *iter = wtree3_index_seek(tree, "group_idx", "g0007", 5, &error);
+    assert_non_null(iter);
+    size_t in_group = 0;
+    while (wtree3_iterator_valid(iter)) {
+        const void *k;
+        size_t k_len;
+        assert_true(wtree3_iterator_key(iter, &k, &k_len));
+        if (k_len != 5 || memcmp(k, "g0007", 5) != 0) break;
+        in_group++;
+        wtree3_iterator_next(iter);
+    }
+    wtree3_iterator_close(iter);
+    assert_int_equal(ROW_COUNT / GROUP_COUNT, in_group);
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Build Tests
+ * ============================================================ */
+
+static void test_build_single_thread(void **state) {
+    (void)state;
+    build_and_check("build_single", NULL);
+}
+
+static void test_build_multi_thread(void **state) {
+    (void)state;
+    wtree3_index_build_opts_t opts = {.threads = 4};
+    build_and_check("build_multi", &opts);
+}
+
+static void test_build_spills_to_tmpfile(void **state) {
+    (void)state;
+    wtree3_index_build_opts_t opts = {.threads = 2, .memory_budget = 64 * 1024};
+    build_and_check("build_spill", &opts);
+}
+
+static void test_build_spills_to_tmp_dir(void **state) {
+    (void)state;
+    wtree3_index_build_opts_t opts = {.threads = 3, .memory_budget = 32 * 1024,
+                                      .tmp_dir = test_db_path};
+    build_and_check("build_spill_dir", &opts);
+}
+
+static void test_build_unique_multi_thread(void **state) {
+    (void)state;
+    gerror_t error = {0};
+    wtree3_tree_t *tree = create_filled_tree("build_unique", true);
+
+    wtree3_index_config_t config = {.name = "uid_idx", .unique = true};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &config, &error));
+
+    wtree3_index_build_opts_t opts = {.threads = 4, .memory_budget = 128 * 1024};
+    assert_int_equal(WTREE3_OK, wtree3_tree_build_index(tree, "uid_idx", &opts, &error));
+    assert_int_equal(ROW_COUNT, count_index_entries(tree, "uid_idx"));
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+
+    wtree3_tree_close(tree);
+}
+
+static void test_build_unique_violation_across_workers(void **state) {
+    (void)state;
+    gerror_t error = {0};
+    wtree3_tree_t *tree = create_filled_tree("build_unique_dup", true);
+
+    /* First and last row land in different workers but share a field */
+    char value[64];
+    snprintf(value, sizeof(value), "u%08d|dup", 0);
+    assert_int_equal(WTREE3_OK, wtree3_upsert(tree, "zzz-last", 8, value, strlen(value), &error));
+
+    wtree3_index_config_t config = {.name = "uid_idx", .unique = true};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &config, &error));
+
+    wtree3_index_build_opts_t opts = {.threads = 4, .memory_budget = 64 * 1024};
+    assert_int_equal(WTREE3_INDEX_ERROR, wtree3_tree_build_index(tree, "uid_idx", &opts, &error));
+
+    /* The whole build rolled back */
+    assert_int_equal(0, count_index_entries(tree, "uid_idx"));
+
+    wtree3_tree_close(tree);
+}
+
+static void test_build_into_non_empty_index(void **state) {
+    (void)state;
+    gerror_t error = {0};
+    wtree3_tree_t *tree = create_filled_tree("build_non_empty", false);
+
+    wtree3_index_config_t config = {.name = "group_idx"};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &config, &error));
+
+    /* Written after add_index: already indexed before the build runs */
+    assert_int_equal(WTREE3_OK, wtree3_insert_one(tree, "zzz", 3, "g9999|late", 10, &error));
+
+    wtree3_index_build_opts_t opts = {.threads = 2};
+    assert_int_equal(WTREE3_OK, wtree3_tree_build_index(tree, "group_idx", &opts, &error));
+    assert_int_equal(ROW_COUNT + 1, count_index_entries(tree, "group_idx"));
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+
+    /* Rebuilding is idempotent */
+    assert_int_equal(WTREE3_OK, wtree3_tree_populate_index(tree, "group_idx", &error));
+    assert_int_equal(ROW_COUNT + 1, count_index_entries(tree, "group_idx"));
+
+    wtree3_tree_close(tree);
+}
+
+static void test_build_invalid_params(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    assert_int_equal(WTREE3_EINVAL, wtree3_tree_build_index(NULL, "idx", NULL, &error));
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "build_invalid", 0, 0, &error);
+    assert_non_null(tree);
+    assert_int_equal(WTREE3_EINVAL, wtree3_tree_build_index(tree, NULL, NULL, &error));
+    assert_int_equal(WTREE3_NOT_FOUND, wtree3_tree_build_index(tree, "missing", NULL, &error));
+
+    /* Empty tree builds trivially */
+    wtree3_index_config_t config = {.name = "group_idx"};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &config, &error));
+    wtree3_index_build_opts_t opts = {.threads = 8};
+    assert_int_equal(WTREE3_OK, wtree3_tree_build_index(tree, "group_idx", &opts, &error));
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Online Build Tests
+ * ============================================================ */
+
+static void test_online_build_chunks_and_cursor(void **state) {
+    (void)state;
+    gerror_t error = {0};
+    wtree3_tree_t *tree = create_filled_tree("online_chunks", false);
+
+    wtree3_index_config_t config = {.name = "group_idx"};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &config, &error));
+
+    wtree3_online_build_opts_t opts = {.chunk_rows = 1000};
+    bool done = false;
+    assert_int_equal(WTREE3_OK, wtree3_tree_build_index_step(tree, "group_idx", &opts, &done, &error));
+    assert_false(done);
+    assert_true(wtree3_index_is_building(tree, "group_idx"));
+
+    /* Hidden from queries while building */
+    assert_null(wtree3_index_seek(tree, "group_idx", "g0007", 5, &error));
+    assert_int_equal(WTREE3_NOT_FOUND, error.code);
+
+    /* Writes behind the cursor (rows 0..999 are indexed) stay in sync */
+    assert_int_equal(WTREE3_OK, wtree3_insert_one(tree, "row:00000500x", 13, "g0001|new", 9, &error));
+    bool deleted = false;
+    assert_int_equal(WTREE3_OK, wtree3_delete_one(tree, "row:00000010", 12, &deleted, &error));
+    assert_true(deleted);
+    assert_int_equal(WTREE3_OK, wtree3_update(tree, "row:00000020", 12, "g0002|moved", 11, &error));
+
+    /* Writes ahead of the cursor are left to the build */
+    assert_int_equal(WTREE3_OK, wtree3_update(tree, "row:00015000", 12, "g0003|moved", 11, &error));
+    assert_int_equal(WTREE3_OK, wtree3_delete_one(tree, "row:00015001", 12, &deleted, &error));
+    assert_true(deleted);
+
+    int steps = 1;
+    while (!done) {
+        assert_int_equal(WTREE3_OK, wtree3_tree_build_index_step(tree, "group_idx", &opts, &done, &error));
+        steps++;
+    }
+    assert_true(steps >= ROW_COUNT / 1000);
+    assert_false(wtree3_index_is_building(tree, "group_idx"));
+
+    assert_int_equal(ROW_COUNT - 1, count_index_entries(tree, "group_idx"));
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+
+    wtree3_iterator_t *iter = wtree3_index_seek(tree, "group_idx", "g0007", 5, &error);
+    assert_non_null(iter);
+    wtree3_iterator_close(iter);
+
+    wtree3_tree_close(tree);
+}
+
+static void test_online_build_resume_after_reopen(void **state) {
+    (void)state;
+    gerror_t error = {0};
+    wtree3_tree_t *tree = create_filled_tree("online_resume", false);
+
+    wtree3_index_config_t config = {.name = "group_idx"};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &config, &error));
+
+    wtree3_online_build_opts_t opts = {.chunk_rows = 2000, .chunk_bytes = 1024 * 1024};
+    bool done = false;
+    for (int i = 0; i < 3; i++) {
+        assert_int_equal(WTREE3_OK, wtree3_tree_build_index_step(tree, "group_idx", &opts, &done, &error));
+        assert_false(done);
+    }
+    int64_t count = wtree3_tree_count(tree);
+    wtree3_tree_close(tree);
+
+    /* Reopen: the index comes back still building, cursor intact */
+    tree = wtree3_tree_open(test_db, "online_resume", 0, count, &error);
+    assert_non_null(tree);
+    assert_true(wtree3_tree_has_index(tree, "group_idx"));
+    assert_true(wtree3_index_is_building(tree, "group_idx"));
+
+    assert_int_equal(WTREE3_OK, wtree3_tree_build_index_online(tree, "group_idx", &opts, &error));
+    assert_false(wtree3_index_is_building(tree, "group_idx"));
+    assert_int_equal(ROW_COUNT, count_index_entries(tree, "group_idx"));
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+
+    wtree3_tree_close(tree);
+
+    /* Completed state is persisted too */
+    tree = wtree3_tree_open(test_db, "online_resume", 0, count, &error);
+    assert_non_null(tree);
+    assert_false(wtree3_index_is_building(tree, "group_idx"));
+    wtree3_tree_close(tree);
+}
+
+static void test_online_build_unique_violation(void **state) {
+    (void)state;
+    gerror_t error = {0};
+    wtree3_tree_t *tree = create_filled_tree("online_unique", true);
+
+    assert_int_equal(WTREE3_OK, wtree3_upsert(tree, "zzz-last", 8, "u00000000|dup", 13, &error));
+
+    wtree3_index_config_t config = {.name = "uid_idx", .unique = true};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &config, &error));
+
+    wtree3_online_build_opts_t opts = {.chunk_rows = 4096};
+    assert_int_equal(WTREE3_INDEX_ERROR,
+                     wtree3_tree_build_index_online(tree, "uid_idx", &opts, &error));
+    assert_true(wtree3_index_is_building(tree, "uid_idx"));
+
+    /* Fix the data and resume */
+    bool deleted = false;
+    assert_int_equal(WTREE3_OK, wtree3_delete_one(tree, "zzz-last", 8, &deleted, &error));
+    assert_int_equal(WTREE3_OK, wtree3_tree_build_index_online(tree, "uid_idx", &opts, &error));
+    assert_int_equal(ROW_COUNT, count_index_entries(tree, "uid_idx"));
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+
+    wtree3_tree_close(tree);
+}
+
+typedef struct {
+    wtree3_tree_t *tree;
+    int failures;
+} online_writer_ctx_t;
+
+/* Churn rows all over the key range while the build runs */
+static void *online_writer_thread(void *arg) {
+    online_writer_ctx_t *ctx = (online_writer_ctx_t *)arg;
+    gerror_t error = {0};
+    char key[32], value[64];
+
+    for (int i = 0; i < 2000; i++) {
+        int row = (i * 7919) % ROW_COUNT;
+        snprintf(key, sizeof(key), "row:%08d", row);
+        snprintf(value, sizeof(value), "g%04d|rewritten-%d", i % GROUP_COUNT, i);
+        if (wtree3_update(ctx->tree, key, strlen(key), value, strlen(value), &error) != WTREE3_OK) {
+            ctx->failures++;
+        }
+
+        snprintf(key, sizeof(key), "row:%08dw", row);
+        if (wtree3_upsert(ctx->tree, key, strlen(key), value, strlen(value), &error) != WTREE3_OK) {
+            ctx->failures++;
+        }
+    }
+    return NULL;
+}
+
+static void test_online_build_concurrent_writers(void **state) {
+    (void)state;
+    gerror_t error = {0};
+    wtree3_tree_t *tree = create_filled_tree("online_concurrent", false);
+
+    wtree3_index_config_t config = {.name = "group_idx"};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &config, &error));
+
+    online_writer_ctx_t ctx = {.tree = tree};
+    wthread_t writer;
+    assert_int_equal(0, wthread_create(&writer, online_writer_thread, &ctx));
+
+    wtree3_online_build_opts_t opts = {.chunk_rows = 500};
+    assert_int_equal(WTREE3_OK, wtree3_tree_build_index_online(tree, "group_idx", &opts, &error));
+
+    assert_int_equal(0, wthread_join(writer, NULL));
+    assert_int_equal(0, ctx.failures);
+
+    assert_int_equal((size_t)wtree3_tree_count(tree), count_index_entries(tree, "group_idx"));
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+
+    wtree3_tree_close(tree);
+}
+
+static void test_full_build_completes_online_build(void **state) {
+    (void)state;
+    gerror_t error = {0};
+    wtree3_tree_t *tree = create_filled_tree("online_then_full", false);
+
+    wtree3_index_config_t config = {.name = "group_idx"};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &config, &error));
+
+    wtree3_online_build_opts_t opts = {.chunk_rows = 5000};
+    assert_int_equal(WTREE3_OK, wtree3_tree_build_index_step(tree, "group_idx", &opts, NULL, &error));
+    assert_true(wtree3_index_is_building(tree, "group_idx"));
+
+    assert_int_equal(WTREE3_OK, wtree3_tree_populate_index(tree, "group_idx", &error));
+    assert_false(wtree3_index_is_building(tree, "group_idx"));
+    assert_int_equal(ROW_COUNT, count_index_entries(tree, "group_idx"));
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Main
+ * ============================================================ */
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_build_single_thread),
+        cmocka_unit_test(test_build_multi_thread),
+        cmocka_unit_test(test_build_spills_to_tmpfile),
+        cmocka_unit_test(test_build_spills_to_tmp_dir),
+        cmocka_unit_test(test_build_unique_multi_thread),
+        cmocka_unit_test(test_build_unique_violation_across_workers),
+        cmocka_unit_test(test_build_into_non_empty_index),
+        cmocka_unit_test(test_build_invalid_params),
+        cmocka_unit_test(test_online_build_chunks_and_cursor),
+        cmocka_unit_test(test_online_build_resume_after_reopen),
+        cmocka_unit_test(test_online_build_unique_violation),
+        cmocka_unit_test(test_online_build_concurrent_writers),
+        cmocka_unit_test(test_full_build_completes_online_build),
+    };
+
+    return cmocka_run_group_tests(tests, setup_db, teardown_db);
+}
@@ -0,0 +1,422 @@
+/*
+ * test_wtree3_index_handle.c - Tests for prepared index handles
+ *
+ * Tests that a wtree3_index_handle_t:
+ * - Walks exactly the entries of one key, or on past it with SEEK_RANGE
+ * - Reuses its cursor across many read txns and write txns
+ * - Returns covering payloads
+ * - Refuses missing indexes and indexes with a build in progress
+ * Also checks index name lookups stay right as indexes are added/dropped.
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+    #include <process.h>
+    #define mkdir(path, mode) _mkdir(path)
+    #define getpid() _getpid()
+#else
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "wtree3.h"
+
+#define ROW_COUNT 100
+
+/* Test database path */
+static char test_db_path[256];
+static wtree3_db_t *test_db = NULL;
+
+static bool prefix_key_extractor(const void *value, size_t value_len,
+                                 void *user_data,
+                                 void **out_key, size_t *out_len);
+static bool suffix_projection(const void *value, size_t value_len,
+                              void *user_data,
+                              void **out_key, size_t *out_len);
+
+/* ============================================================
+ * Test Fixtures
+ * ============================================================ */
+
+static int setup_db(void **state) {
+    (void)state;
+
+#ifdef _WIN32
+    snprintf(test_db_path, sizeof(test_db_path), "%s\\test_wtree3_index_handle_%d",
+             getenv("TEMP"), getpid());
+#else
+    snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_wtree3_index_handle_%d", getpid());
+#endif
+    mkdir(test_db_path, 0755);
+
+    gerror_t error = {0};
+    test_db = wtree3_db_open(test_db_path, 64 * 1024 * 1024, 128, WTREE3_VERSION(1, 0), 0, &error);
+    if (!test_db) {
+        fprintf(stderr, "Failed to create test database: %s\n", error.message);
+        return -1;
+    }
+
+    for (uint32_t flags = 0; flags <= 0x03; flags++) {
+        int rc = wtree3_db_register_key_extractor(test_db, WTREE3_VERSION(1, 0), flags,
+                                                  prefix_key_extractor, &error);
+        if (rc == WTREE3_OK) {
+            rc = wtree3_db_register_projection(test_db, WTREE3_VERSION(1, 0), flags,
+                                               suffix_projection, &error);
+        }
+        if (rc != WTREE3_OK) {
+            fprintf(stderr, "Failed to register callbacks for flags=0x%02x: %s\n", flags, error.message);
+            wtree3_db_close(test_db);
+            test_db = NULL;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int teardown_db(void **state) {
+    (void)state;
+
+    if (test_db) {
+        wtree3_db_close(test_db);
+        test_db = NULL;
+    }
+
+    char cmd[512];
+#ifdef _WIN32
+    snprintf(cmd, sizeof(cmd), "rd /s /q \"%s\"", test_db_path);
+#else
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", test_db_path);
+#endif
+    (void)system(cmd);
+
+    return 0;
+}
+
+/* Extract first 3 chars as index key */
+static bool prefix_key_extractor(const void *value, size_t value_len,
+                                 void *user_data,
+                                 void **out_key, size_t *out_len) {
+    (void)user_data;
+
+    size_t key_len = (value_len < 3) ? value_len : 3;
+    char *key = malloc(key_len);
+    if (!key) return false;
+
+    memcpy(key, value, key_len);
+    *out_key = key;
+    *out_len = key_len;
+    return true;
+}
+
+/* Project everything after the "cNN-" prefix */
+static bool suffix_projection(const void *value, size_t value_len,
+                              void *user_data,
+                              void **out_key, size_t *out_len) {
+    (void)user_data;
+
+    size_t skip = (value_len < 4) ? value_len : 4;
+    size_t len = value_len - skip;
+    char *payload = malloc(len ? len : 1);
+    if (!payload) return false;
+
+    memcpy(payload, (const char *)value + skip, len);
+    *out_key = payload;
+    *out_len = len;
+    return true;
+}
+
+/* ============================================================
+ * Helpers
+ * ============================================================ */
+
+/* Orders "o0000".."o0099" with value "cNN-oNNNN"; customer NN = (i * 7) % 10 */
+static wtree3_tree_t *open_orders(const char *name, bool covering) {
+    gerror_t error = {0};
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, name, 0, 0, &error);
+    assert_non_null(tree);
+
+    wtree3_index_config_t config = {.name = "customer_idx",
+                                    .project = covering ? suffix_projection : NULL};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &config, &error));
+
+    char key[32], value[32];
+    for (int i = 0; i < ROW_COUNT; i++) {
+        snprintf(key, sizeof(key), "o%04d", i);
+        snprintf(value, sizeof(value), "c%02d-o%04d", (i * 7) % 10, i);
+        assert_int_equal(WTREE3_OK,
+                         wtree3_insert_one(tree, key, strlen(key), value, strlen(value), &error));
+    }
+    return tree;
+}
+
+/* Count the entries an exact seek on customer yields, checking each hit */
+static int count_exact(wtree3_index_handle_t *h, wtree3_txn_t *txn, const char *customer) {
+    gerror_t error = {0};
+    wtree3_index_hit_t hit;
+    int count = 0;
+
+    int rc = wtree3_index_handle_seek(h, txn, customer, strlen(customer), 0, &hit, &error);
+    while (rc == WTREE3_OK) {
+        assert_int_equal(hit.index_key_len, strlen(customer));
+        assert_memory_equal(hit.index_key, customer, hit.index_key_len);
+        assert_int_equal(hit.main_key_len, 5);
+        count++;
+        rc = wtree3_index_handle_next(h, &hit, &error);
+    }
+    assert_int_equal(rc, WTREE3_NOT_FOUND);
+    return count;
+}
+
+/* ============================================================
+ * Tests
+ * ============================================================ */
+
+static void test_handle_exact_seek(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = open_orders("handle_exact", false);
+    wtree3_index_handle_t *h = wtree3_index_handle_open(tree, "customer_idx", &error);
+    assert_non_null(h);
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+    for (int c = 0; c < 10; c++) {
+        char customer[8];
+        snprintf(customer, sizeof(customer), "c%02d", c);
+        assert_int_equal(count_exact(h, txn, customer), ROW_COUNT / 10);
+    }
+
+    /* Plain index: no payload */
+    wtree3_index_hit_t hit;
+    assert_int_equal(WTREE3_OK, wtree3_index_handle_seek(h, txn, "c03", 3, 0, &hit, &error));
+    assert_null(hit.payload);
+    assert_int_equal(hit.payload_len, 0);
+
+    /* Missing key; next after a failed seek is not positioned */
+    assert_int_equal(WTREE3_NOT_FOUND, wtree3_index_handle_seek(h, txn, "c99", 3, 0, &hit, &error));
+    assert_int_equal(WTREE3_EINVAL, wtree3_index_handle_next(h, &hit, &error));
+    wtree3_txn_abort(txn);
+
+    wtree3_index_handle_close(h);
+    wtree3_tree_close(tree);
+}
+
+static void test_handle_range_seek(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = open_orders("handle_range", false);
+    wtree3_index_handle_t *h = wtree3_index_handle_open(tree, "customer_idx", &error);
+    assert_non_null(h);
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+
+    /* "c05x" sorts between c05 and c06: lands on c06, then walks to the end */
+    wtree3_index_hit_t hit;
+    int rc = wtree3_index_handle_seek(h, txn, "c05x", 4, WTREE3_SEEK_RANGE, &hit, &error);
+    assert_int_equal(rc, WTREE3_OK);
+    assert_memory_equal(hit.index_key, "c06", 3);
+
+    int count = 0;
+    while (rc == WTREE3_OK) {
+        count++;
+        rc = wtree3_index_handle_next(h, &hit, &error);
+    }
+    assert_int_equal(rc, WTREE3_NOT_FOUND);
+    assert_int_equal(count, 4 * ROW_COUNT / 10);
+
+    /* Past the last key */
+    assert_int_equal(WTREE3_NOT_FOUND,
+                     wtree3_index_handle_seek(h, txn, "d", 1, WTREE3_SEEK_RANGE, &hit, &error));
+    wtree3_txn_abort(txn);
+
+    wtree3_index_handle_close(h);
+    wtree3_tree_close(tree);
+}
+
+static void test_handle_reuse_across_txns(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = open_orders("handle_reuse", false);
+    wtree3_index_handle_t *h = wtree3_index_handle_open(tree, "customer_idx", &error);
+    assert_non_null(h);
+
+    /* Many short read txns (pooled, so the same MDB_txn may come back) */
+    for (int i = 0; i < 50; i++) {
+        wtree3_txn_t *txn = wtree3_txn_begin(test_db, false, &error);
+        assert_non_null(txn);
+        assert_int_equal(count_exact(h, txn, "c01"), ROW_COUNT / 10);
+        wtree3_txn_abort(txn);
+    }
+
+    /* A write txn sees its own uncommitted entries */
+    wtree3_txn_t *wtxn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(wtxn);
+    assert_int_equal(WTREE3_OK, wtree3_insert_one_txn(wtxn, tree, "o9000", 5, "c01-new", 7, &error));
+    assert_int_equal(count_exact(h, wtxn, "c01"), ROW_COUNT / 10 + 1);
+    assert_int_equal(count_exact(h, wtxn, "c01"), ROW_COUNT / 10 + 1);
+    assert_int_equal(WTREE3_OK, wtree3_txn_commit(wtxn, &error));
+
+    /* A second write txn, then back to reads */
+    wtxn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(wtxn);
+    assert_int_equal(WTREE3_OK, wtree3_delete_one_txn(wtxn, tree, "o9000", 5, NULL, &error));
+    assert_int_equal(count_exact(h, wtxn, "c01"), ROW_COUNT / 10);
+    wtree3_txn_abort(wtxn);
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+    assert_int_equal(count_exact(h, txn, "c01"), ROW_COUNT / 10 + 1);
+    wtree3_txn_abort(txn);
+
+    wtree3_index_handle_close(h);
+    wtree3_tree_close(tree);
+}
+
+static void test_handle_covering_payload(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = open_orders("handle_covering", true);
+    wtree3_index_handle_t *h = wtree3_index_handle_open(tree, "customer_idx", &error);
+    assert_non_null(h);
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+
+    wtree3_index_hit_t hit;
+    int count = 0;
+    int rc = wtree3_index_handle_seek(h, txn, "c07", 3, 0, &hit, &error);
+    while (rc == WTREE3_OK) {
+        /* Payload is the main key ("o" + digits) */
+        assert_int_equal(hit.payload_len, hit.main_key_len);
+        assert_memory_equal(hit.payload, hit.main_key, hit.main_key_len);
+        count++;
+        rc = wtree3_index_handle_next(h, &hit, &error);
+    }
+    assert_int_equal(count, ROW_COUNT / 10);
+    wtree3_txn_abort(txn);
+
+    wtree3_index_handle_close(h);
+    wtree3_tree_close(tree);
+}
+
+static void test_handle_missing_and_building(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = open_orders("handle_building", false);
+    assert_null(wtree3_index_handle_open(tree, "nope_idx", &error));
+    assert_int_equal(error.code, WTREE3_NOT_FOUND);
+
+    wtree3_index_handle_t *h = wtree3_index_handle_open(tree, "customer_idx", &error);
+    assert_non_null(h);
+
+    /* Start an online rebuild and leave it unfinished */
+    wtree3_online_build_opts_t opts = {.chunk_rows = 10};
+    bool done = true;
+    assert_int_equal(WTREE3_OK,
+                     wtree3_tree_build_index_step(tree, "customer_idx", &opts, &done, &error));
+    assert_false(done);
+
+    error = (gerror_t){0};
+    assert_null(wtree3_index_handle_open(tree, "customer_idx", &error));
+    assert_int_equal(error.code, WTREE3_NOT_FOUND);
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+    wtree3_index_hit_t hit;
+    assert_int_equal(WTREE3_NOT_FOUND, wtree3_index_handle_seek(h, txn, "c01", 3, 0, &hit, &error));
+    wtree3_txn_abort(txn);
+
+    assert_int_equal(WTREE3_OK, wtree3_tree_build_index_online(tree, "customer_idx", &opts, &error));
+    txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+    assert_int_equal(count_exact(h, txn, "c01"), ROW_COUNT / 10);
+    wtree3_txn_abort(txn);
+
+    wtree3_index_handle_close(h);
+    wtree3_tree_close(tree);
+}
+
+static void test_index_lookup_after_add_and_drop(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "handle_lookup", 0, 0, &error);
+    assert_non_null(tree);
+
+    /* Enough indexes to grow the name table a few times */
+    char name[32];
+    for (int i = 0; i < 40; i++) {
+        snprintf(name, sizeof(name), "idx_%02d", i);
+        wtree3_index_config_t config = {.name = name};
+        assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &config, &error));
+    }
+    for (int i = 0; i < 40; i += 3) {
+        snprintf(name, sizeof(name), "idx_%02d", i);
+        assert_int_equal(WTREE3_OK, wtree3_tree_drop_index(tree, name, &error));
+    }
+
+    for (int i = 0; i < 40; i++) {
+        snprintf(name, sizeof(name), "idx_%02d", i);
+        assert_int_equal(wtree3_tree_has_index(tree, name), i % 3 != 0);
+    }
+
+    /* Duplicate names are still rejected */
+    wtree3_index_config_t dup = {.name = "idx_01"};
+    assert_int_not_equal(WTREE3_OK, wtree3_tree_add_index(tree, &dup, &error));
+    wtree3_tree_close(tree);
+
+    /* And the reloaded set resolves the same way */
+    tree = wtree3_tree_open(test_db, "handle_lookup", 0, 0, &error);
+    assert_non_null(tree);
+    for (int i = 0; i < 40; i++) {
+        snprintf(name, sizeof(name), "idx_%02d", i);
+        assert_int_equal(wtree3_tree_has_index(tree, name), i % 3 != 0);
+    }
+    wtree3_tree_close(tree);
+}
+
+static void test_handle_invalid(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    assert_null(wtree3_index_handle_open(NULL, "customer_idx", &error));
+    wtree3_index_handle_close(NULL);
+
+    wtree3_index_hit_t hit;
+    assert_int_equal(WTREE3_EINVAL, wtree3_index_handle_seek(NULL, NULL, "c", 1, 0, &hit, &error));
+    assert_int_equal(WTREE3_EINVAL, wtree3_index_handle_next(NULL, &hit, &error));
+}
+
+/* ============================================================
+ * Main
+ * ============================================================ */
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_handle_exact_seek),
+        cmocka_unit_test(test_handle_range_seek),
+        cmocka_unit_test(test_handle_reuse_across_txns),
+        cmocka_unit_test(test_handle_covering_payload),
+        cmocka_unit_test(test_handle_missing_and_building),
+        cmocka_unit_test(test_index_lookup_after_add_and_drop),
+        cmocka_unit_test(test_handle_invalid),
+    };
+
+    return cmocka_run_group_tests(tests, setup_db, teardown_db);
+}
@@ -0,0 +1,326 @@
+/*
+ * test_wtree3_index_join.c - Tests for index lookups joined to main-tree values
+ *
+ * Tests that wtree3_index_get_many*() and wtree3_index_scan_join*():
+ * - Deliver exactly the records behind the matching index entries
+ * - Deliver in index order by default and main-key order with
+ *   WTREE3_JOIN_SORTED
+ * - Stop early when the callback returns false
+ * - See uncommitted writes of the caller's transaction
+ * - Reject missing indexes and invalid parameters
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+    #include <process.h>
+    #define mkdir(path, mode) _mkdir(path)
+    #define getpid() _getpid()
+#else
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "wtree3.h"
+
+#define ROW_COUNT 100
+
+/* Test database path */
+static char test_db_path[256];
+static wtree3_db_t *test_db = NULL;
+
+static bool prefix_key_extractor(const void *value, size_t value_len,
+                                 void *user_data,
+                                 void **out_key, size_t *out_len);
+
+/* ============================================================
+ * Test Fixtures
+ * ============================================================ */
+
+static int setup_db(void **state) {
+    (void)state;
+
+#ifdef _WIN32
+    snprintf(test_db_path, sizeof(test_db_path), "%s\\test_wtree3_index_join_%d",
+             getenv("TEMP"), getpid());
+#else
+    snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_wtree3_index_join_%d", getpid());
+#endif
+    mkdir(test_db_path, 0755);
+
+    gerror_t error = {0};
+    test_db = wtree3_db_open(test_db_path, 64 * 1024 * 1024, 128, WTREE3_VERSION(1, 0), 0, &error);
+    if (!test_db) {
+        fprintf(stderr, "Failed to create test database: %s\n", error.message);
+        return -1;
+    }
+
+    for (uint32_t flags = 0; flags <= 0x03; flags++) {
+        int rc = wtree3_db_register_key_extractor(test_db, WTREE3_VERSION(1, 0), flags,
+                                                  prefix_key_extractor, &error);
+        if (rc != WTREE3_OK) {
+            fprintf(stderr, "Failed to register extractor for flags=0x%02x: %s\n", flags, error.message);
+            wtree3_db_close(test_db);
+            test_db = NULL;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int teardown_db(void **state) {
+    (void)state;
+
+    if (test_db) {
+        wtree3_db_close(test_db);
+        test_db = NULL;
+    }
+
+    char cmd[512];
+#ifdef _WIN32
+    snprintf(cmd, sizeof(cmd), "rd /s /q \"%s\"", test_db_path);
+#else
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", test_db_path);
+#endif
+    (void)system(cmd);
+
+    return 0;
+}
+
+/* Extract first 3 chars as index key */
+static bool prefix_key_extractor(const void *value, size_t value_len,
+                                 void *user_data,
+                                 void **out_key, size_t *out_len) {
+    (void)user_data;
+
+    size_t key_len = (value_len < 3) ? value_len : 3;
+    char *key = malloc(key_len);
+    if (!key) return false;
+
+    memcpy(key, value, key_len);
+    *out_key = key;
+    *out_len = key_len;
+    return true;
+}
+
+/* ============================================================
+ * Helpers
+ * ============================================================ */
+
+/*
+ * Orders "o0000".."o0099" with value "cNN-oNNNN"; customer NN = (i * 7) % 10,
+ * so each customer's orders are spread across the main key space.
+ */
+static wtree3_tree_t *create_orders_tree(const char *name) {
+    gerror_t error = {0};
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, name, 0, 0, &error);
+    assert_non_null(tree);
+
+    wtree3_index_config_t config = {.name = "customer_idx"};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &config, &error));
+
+    char key[32], value[32];
+    for (int i = 0; i < ROW_COUNT; i++) {
+        snprintf(key, sizeof(key), "o%04d", i);
+        snprintf(value, sizeof(value), "c%02d-o%04d", (i * 7) % 10, i);
+        assert_int_equal(WTREE3_OK,
+                         wtree3_insert_one(tree, key, strlen(key), value, strlen(value), &error));
+    }
+    return tree;
+}
+
+typedef struct {
+    int count;
+    int stop_after;                 /* 0 = never stop */
+    bool values_match;              /* value ends with its own main key */
+    bool index_ordered;             /* index keys non-decreasing */
+    bool main_ordered;              /* main keys strictly increasing */
+    char last_index[8];
+    char last_main[8];
+} join_collector_t;
+
+static void collector_init(join_collector_t *c, int stop_after) {
+    memset(c, 0, sizeof(*c));
+    c->stop_after = stop_after;
+    c->values_match = c->index_ordered = c->main_ordered = true;
+}
+
+static bool collect_join(const void *index_key, size_t index_key_len,
+                         const void *main_key, size_t main_key_len,
+                         const void *value, size_t value_len,
+                         void *user_data) {
+    join_collector_t *c = (join_collector_t *)user_data;
+
+    char ikey[8] = {0}, mkey[8] = {0};
+    memcpy(ikey, index_key, index_key_len < 7 ? index_key_len : 7);
+    memcpy(mkey, main_key, main_key_len < 7 ? main_key_len : 7);
+
+    /* "cNN-oNNNN": the record must be the one the index entry points to */
+    if (value_len != 9 || memcmp((const char *)value + 4, main_key, main_key_len) != 0 ||
+        memcmp(value, index_key, index_key_len) != 0) {
+        c->values_match = false;
+    }
+    if (c->count > 0) {
+        if (strcmp(ikey, c->last_index) < 0) c->index_ordered = false;
+        if (strcmp(mkey, c->last_main) <= 0) c->main_ordered = false;
+    }
+    memcpy(c->last_index, ikey, sizeof(ikey));
+    memcpy(c->last_main, mkey, sizeof(mkey));
+
+    c->count++;
+    return c->stop_after == 0 || c->count < c->stop_after;
+}
+
+/* ============================================================
+ * Point Lookups
+ * ============================================================ */
+
+static void test_index_get_many(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = create_orders_tree("join_get");
+
+    join_collector_t c;
+    collector_init(&c, 0);
+    assert_int_equal(WTREE3_OK,
+                     wtree3_index_get_many(tree, "customer_idx", "c03", 3, 0,
+                                           collect_join, &c, &error));
+    assert_int_equal(c.count, 10);
+    assert_true(c.values_match);
+    /* Duplicates of one index key are stored in main-key order */
+    assert_true(c.main_ordered);
+
+    /* No orders for this customer */
+    collector_init(&c, 0);
+    assert_int_equal(WTREE3_OK,
+                     wtree3_index_get_many(tree, "customer_idx", "c99", 3, 0,
+                                           collect_join, &c, &error));
+    assert_int_equal(c.count, 0);
+
+    /* Early stop */
+    collector_init(&c, 4);
+    assert_int_equal(WTREE3_OK,
+                     wtree3_index_get_many(tree, "customer_idx", "c03", 3, WTREE3_JOIN_SORTED,
+                                           collect_join, &c, &error));
+    assert_int_equal(c.count, 4);
+
+    wtree3_tree_close(tree);
+}
+
+static void test_index_get_many_sees_txn_writes(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = create_orders_tree("join_txn");
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(txn);
+    assert_int_equal(WTREE3_OK,
+                     wtree3_insert_one_txn(txn, tree, "o9999", 5, "c03-o9999", 9, &error));
+
+    join_collector_t c;
+    collector_init(&c, 0);
+    assert_int_equal(WTREE3_OK,
+                     wtree3_index_get_many_txn(txn, tree, "customer_idx", "c03", 3, 0,
+                                               collect_join, &c, &error));
+    assert_int_equal(c.count, 11);
+    assert_true(c.values_match);
+    assert_string_equal(c.last_main, "o9999");
+
+    wtree3_txn_abort(txn);
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Range Joins
+ * ============================================================ */
+
+static void test_index_scan_join_order(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = create_orders_tree("join_range");
+
+    /* Index order: grouped by customer, main keys jump around */
+    join_collector_t c;
+    collector_init(&c, 0);
+    assert_int_equal(WTREE3_OK,
+                     wtree3_index_scan_join(tree, "customer_idx", "c02", 3, "c04", 3, 0,
+                                            collect_join, &c, &error));
+    assert_int_equal(c.count, 30);
+    assert_true(c.values_match);
+    assert_true(c.index_ordered);
+    assert_false(c.main_ordered);
+
+    /* Sorted: the whole range fits one batch, so main keys are ascending */
+    collector_init(&c, 0);
+    assert_int_equal(WTREE3_OK,
+                     wtree3_index_scan_join(tree, "customer_idx", "c02", 3, "c04", 3,
+                                            WTREE3_JOIN_SORTED, collect_join, &c, &error));
+    assert_int_equal(c.count, 30);
+    assert_true(c.values_match);
+    assert_true(c.main_ordered);
+
+    /* Open range covers every row */
+    collector_init(&c, 0);
+    assert_int_equal(WTREE3_OK,
+                     wtree3_index_scan_join(tree, "customer_idx", NULL, 0, NULL, 0,
+                                            WTREE3_JOIN_SORTED, collect_join, &c, &error));
+    assert_int_equal(c.count, ROW_COUNT);
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Error Cases
+ * ============================================================ */
+
+static void test_index_join_errors(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = create_orders_tree("join_errors");
+    join_collector_t c;
+    collector_init(&c, 0);
+
+    assert_int_equal(WTREE3_NOT_FOUND,
+                     wtree3_index_get_many(tree, "no_such_idx", "c03", 3, 0,
+                                           collect_join, &c, &error));
+    assert_int_equal(WTREE3_EINVAL,
+                     wtree3_index_get_many(tree, "customer_idx", NULL, 0, 0,
+                                           collect_join, &c, &error));
+    assert_int_equal(WTREE3_EINVAL,
+                     wtree3_index_scan_join(tree, "customer_idx", NULL, 0, NULL, 0, 0,
+                                            NULL, &c, &error));
+    assert_int_equal(WTREE3_EINVAL,
+                     wtree3_index_scan_join_txn(NULL, tree, "customer_idx", NULL, 0, NULL, 0, 0,
+                                                collect_join, &c, &error));
+    assert_int_equal(c.count, 0);
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Main
+ * ============================================================ */
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_index_get_many),
+        cmocka_unit_test(test_index_get_many_sees_txn_writes),
+        cmocka_unit_test(test_index_scan_join_order),
+        cmocka_unit_test(test_index_join_errors),
+    };
+
+    return cmocka_run_group_tests(tests, setup_db, teardown_db);
+}
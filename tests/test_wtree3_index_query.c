@@ -0,0 +1,380 @@
+/*
+ * test_wtree3_index_query.c - Tests for multi-index intersection/union queries
+ *
+ * Tests that wtree3_index_query*():
+ * - Intersects exact-match predicates (AND) and unions them (OR)
+ * - Delivers every main key once, in ascending main-key order
+ * - Mixes streamed exact predicates with gathered range predicates
+ * - Works on covering indexes
+ * - Fetches main-tree values with WTREE3_QUERY_VALUES
+ * - Stops early when the callback returns false
+ * - Rejects missing indexes and invalid parameters
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+    #include <process.h>
+    #define mkdir(path, mode) _mkdir(path)
+    #define getpid() _getpid()
+#else
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "wtree3.h"
+
+#define ROW_COUNT 300
+
+/* Test database path */
+static char test_db_path[256];
+static wtree3_db_t *test_db = NULL;
+
+static bool field_extractor(const void *value, size_t value_len,
+                            void *user_data,
+                            void **out_key, size_t *out_len);
+
+/* ============================================================
+ * Test Fixtures
+ * ============================================================ */
+
+static int setup_db(void **state) {
+    (void)state;
+
+#ifdef _WIN32
+    snprintf(test_db_path, sizeof(test_db_path), "%s\\test_wtree3_index_query_%d",
+             getenv("TEMP"), getpid());
+#else
+    snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_wtree3_index_query_%d", getpid());
+#endif
+    mkdir(test_db_path, 0755);
+
+    gerror_t error = {0};
+    test_db = wtree3_db_open(test_db_path, 64 * 1024 * 1024, 128, WTREE3_VERSION(1, 0), 0, &error);
+    if (!test_db) {
+        fprintf(stderr, "Failed to create test database: %s\n", error.message);
+        return -1;
+    }
+
+    for (uint32_t flags = 0; flags <= 0x03; flags++) {
+        int rc = wtree3_db_register_key_extractor(test_db, WTREE3_VERSION(1, 0), flags,
+                                                  field_extractor, &error);
+        if (rc == WTREE3_OK) {
+            rc = wtree3_db_register_projection(test_db, WTREE3_VERSION(1, 0), flags,
+                                               field_extractor, &error);
+        }
+        if (rc != WTREE3_OK) {
+            fprintf(stderr, "Failed to register callbacks for flags=0x%02x: %s\n", flags, error.message);
+            wtree3_db_close(test_db);
+            test_db = NULL;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int teardown_db(void **state) {
+    (void)state;
+
+    if (test_db) {
+        wtree3_db_close(test_db);
+        test_db = NULL;
+    }
+
+    char cmd[512];
+#ifdef _WIN32
+    snprintf(cmd, sizeof(cmd), "rd /s /q \"%s\"", test_db_path);
+#else
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", test_db_path);
+#endif
+    (void)system(cmd);
+
+    return 0;
+}
+
+/* Extract the 3-char field at the offset given by user_data[0] */
+static bool field_extractor(const void *value, size_t value_len,
+                            void *user_data,
+                            void **out_key, size_t *out_len) {
+    size_t off = user_data ? *(const unsigned char *)user_data : 0;
+    if (value_len < off + 3) return false;
+
+    char *key = malloc(3);
+    if (!key) return false;
+
+    memcpy(key, (const char *)value + off, 3);
+    *out_key = key;
+    *out_len = 3;
+    return true;
+}
+
+/* ============================================================
+ * Helpers
+ * ============================================================ */
+
+#define CUSTOMER_OF(i)  (((i) * 7) % 10)
+#define STATUS_OF(i)    ((i) % 3)
+
+static const unsigned char customer_off = 0;
+static const unsigned char status_off = 4;
+
+/*
+ * Orders "o0000".."o0299" with value "cNN-sNN-oNNNN":
+ * customer = (i * 7) % 10, status = i % 3
+ */
+static wtree3_tree_t *create_orders_tree(const char *name, bool covering_status) {
+    gerror_t error = {0};
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, name, 0, 0, &error);
+    assert_non_null(tree);
+
+    wtree3_index_config_t customer = {.name = "customer_idx",
+                                      .user_data = &customer_off, .user_data_len = 1};
+    wtree3_index_config_t status = {.name = "status_idx",
+                                    .user_data = &status_off, .user_data_len = 1,
+                                    .project = covering_status ? field_extractor : NULL};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &customer, &error));
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &status, &error));
+
+    char key[32], value[32];
+    for (int i = 0; i < ROW_COUNT; i++) {
+        snprintf(key, sizeof(key), "o%04d", i);
+        snprintf(value, sizeof(value), "c%02d-s%02d-o%04d", CUSTOMER_OF(i), STATUS_OF(i), i);
+        assert_int_equal(WTREE3_OK,
+                         wtree3_insert_one(tree, key, strlen(key), value, strlen(value), &error));
+    }
+    return tree;
+}
+
+typedef struct {
+    int rows[ROW_COUNT];
+    int count;
+    bool ordered;
+    bool values_ok;
+    int limit;                      /* Stop after this many hits (0 = all) */
+} collect_t;
+
+static bool collect_keys(const void *key, size_t key_len,
+                         const void *value, size_t value_len,
+                         void *user_data) {
+    collect_t *c = (collect_t *)user_data;
+
+    char buf[8] = {0};
+    memcpy(buf, key, key_len < sizeof(buf) - 1 ? key_len : sizeof(buf) - 1);
+    int row = atoi(buf + 1);
+    if (c->count > 0 && row <= c->rows[c->count - 1]) c->ordered = false;
+    if (c->count < ROW_COUNT) c->rows[c->count++] = row;
+
+    /* "cNN-sNN-oNNNN" ends with the main key */
+    if (value && (value_len != key_len + 8 ||
+                  memcmp((const char *)value + 8, key, key_len) != 0)) {
+        c->values_ok = false;
+    }
+    return c->limit == 0 || c->count < c->limit;
+}
+
+static collect_t run_query(wtree3_tree_t *tree, const wtree3_index_pred_t *preds,
+                           size_t count, unsigned int flags) {
+    gerror_t error = {0};
+    collect_t c = {.ordered = true, .values_ok = true};
+    assert_int_equal(WTREE3_OK,
+                     wtree3_index_query(tree, preds, count, flags, collect_keys, &c, &error));
+    assert_true(c.ordered);
+    return c;
+}
+
+static int expected_count(int customer_lo, int customer_hi, int status, bool or_status) {
+    int n = 0;
+    for (int i = 0; i < ROW_COUNT; i++) {
+        bool in_customer = CUSTOMER_OF(i) >= customer_lo && CUSTOMER_OF(i) <= customer_hi;
+        bool in_status = STATUS_OF(i) == status;
+        if (or_status ? (in_customer || in_status) : (in_customer && in_status)) n++;
+    }
+    return n;
+}
+
+/* ============================================================
+ * Intersection and Union
+ * ============================================================ */
+
+static void test_query_and(void **state) {
+    (void)state;
+
+    wtree3_tree_t *tree = create_orders_tree("q_and", false);
+
+    wtree3_index_pred_t preds[] = {
+        {.index_name = "customer_idx", .key = "c03", .key_len = 3},
+        {.index_name = "status_idx", .key = "s01", .key_len = 3},
+    };
+    collect_t c = run_query(tree, preds, 2, WTREE3_QUERY_AND);
+    assert_int_equal(c.count, expected_count(3, 3, 1, false));
+    for (int i = 0; i < c.count; i++) {
+        assert_int_equal(CUSTOMER_OF(c.rows[i]), 3);
+        assert_int_equal(STATUS_OF(c.rows[i]), 1);
+    }
+
+    /* A single predicate is just its posting list */
+    c = run_query(tree, preds, 1, WTREE3_QUERY_AND);
+    assert_int_equal(c.count, ROW_COUNT / 10);
+
+    /* No match on one side */
+    wtree3_index_pred_t none[] = {
+        {.index_name = "customer_idx", .key = "c03", .key_len = 3},
+        {.index_name = "status_idx", .key = "s09", .key_len = 3},
+    };
+    c = run_query(tree, none, 2, WTREE3_QUERY_AND);
+    assert_int_equal(c.count, 0);
+
+    wtree3_tree_close(tree);
+}
+
+static void test_query_or(void **state) {
+    (void)state;
+
+    wtree3_tree_t *tree = create_orders_tree("q_or", false);
+
+    wtree3_index_pred_t preds[] = {
+        {.index_name = "customer_idx", .key = "c03", .key_len = 3},
+        {.index_name = "status_idx", .key = "s01", .key_len = 3},
+    };
+    collect_t c = run_query(tree, preds, 2, WTREE3_QUERY_OR);
+    assert_int_equal(c.count, expected_count(3, 3, 1, true));
+
+    wtree3_tree_close(tree);
+}
+
+static void test_query_range_predicate(void **state) {
+    (void)state;
+
+    wtree3_tree_t *tree = create_orders_tree("q_range", false);
+
+    wtree3_index_pred_t preds[] = {
+        {.index_name = "customer_idx", .key = "c02", .key_len = 3,
+         .end_key = "c04", .end_len = 3, .range = true},
+        {.index_name = "status_idx", .key = "s00", .key_len = 3},
+    };
+    collect_t c = run_query(tree, preds, 2, WTREE3_QUERY_AND);
+    assert_int_equal(c.count, expected_count(2, 4, 0, false));
+
+    c = run_query(tree, preds, 2, WTREE3_QUERY_OR);
+    assert_int_equal(c.count, expected_count(2, 4, 0, true));
+
+    /* Open range: everything */
+    wtree3_index_pred_t all = {.index_name = "customer_idx", .range = true};
+    c = run_query(tree, &all, 1, WTREE3_QUERY_AND);
+    assert_int_equal(c.count, ROW_COUNT);
+
+    wtree3_tree_close(tree);
+}
+
+static void test_query_covering_index(void **state) {
+    (void)state;
+
+    wtree3_tree_t *tree = create_orders_tree("q_covering", true);
+
+    wtree3_index_pred_t preds[] = {
+        {.index_name = "status_idx", .key = "s02", .key_len = 3},
+        {.index_name = "customer_idx", .key = "c05", .key_len = 3},
+    };
+    collect_t c = run_query(tree, preds, 2, WTREE3_QUERY_AND);
+    assert_int_equal(c.count, expected_count(5, 5, 2, false));
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Delivery
+ * ============================================================ */
+
+static void test_query_values_and_early_stop(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = create_orders_tree("q_values", false);
+
+    wtree3_index_pred_t preds[] = {
+        {.index_name = "customer_idx", .key = "c01", .key_len = 3},
+        {.index_name = "status_idx", .key = "s02", .key_len = 3},
+    };
+    collect_t c = run_query(tree, preds, 2, WTREE3_QUERY_AND | WTREE3_QUERY_VALUES);
+    assert_int_equal(c.count, expected_count(1, 1, 2, false));
+    assert_true(c.values_ok);
+
+    collect_t stop = {.ordered = true, .values_ok = true, .limit = 3};
+    assert_int_equal(WTREE3_OK,
+                     wtree3_index_query(tree, preds, 2, WTREE3_QUERY_OR,
+                                        collect_keys, &stop, &error));
+    assert_int_equal(stop.count, 3);
+
+    /* Inside a write txn the query sees uncommitted rows */
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(txn);
+    const char *value = "c01-s02-o9999";
+    assert_int_equal(WTREE3_OK,
+                     wtree3_insert_one_txn(txn, tree, "o9999", 5, value, strlen(value), &error));
+    collect_t in_txn = {.ordered = true, .values_ok = true};
+    assert_int_equal(WTREE3_OK,
+                     wtree3_index_query_txn(txn, tree, preds, 2, WTREE3_QUERY_VALUES,
+                                            collect_keys, &in_txn, &error));
+    assert_int_equal(in_txn.count, c.count + 1);
+    assert_int_equal(in_txn.rows[in_txn.count - 1], 9999);
+    wtree3_txn_abort(txn);
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Error Cases
+ * ============================================================ */
+
+static void test_query_errors(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = create_orders_tree("q_errors", false);
+    collect_t c = {.ordered = true, .values_ok = true};
+
+    wtree3_index_pred_t missing[] = {
+        {.index_name = "customer_idx", .key = "c01", .key_len = 3},
+        {.index_name = "nope_idx", .key = "x", .key_len = 1},
+    };
+    assert_int_equal(WTREE3_NOT_FOUND,
+                     wtree3_index_query(tree, missing, 2, 0, collect_keys, &c, &error));
+
+    wtree3_index_pred_t no_key = {.index_name = "customer_idx"};
+    assert_int_equal(WTREE3_EINVAL,
+                     wtree3_index_query(tree, &no_key, 1, 0, collect_keys, &c, &error));
+    assert_int_equal(WTREE3_EINVAL,
+                     wtree3_index_query(tree, missing, 0, 0, collect_keys, &c, &error));
+    assert_int_equal(WTREE3_EINVAL,
+                     wtree3_index_query(tree, missing, 1, 0, NULL, &c, &error));
+    assert_int_equal(WTREE3_EINVAL,
+                     wtree3_index_query(NULL, missing, 1, 0, collect_keys, &c, &error));
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Main
+ * ============================================================ */
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_query_and),
+        cmocka_unit_test(test_query_or),
+        cmocka_unit_test(test_query_range_predicate),
+        cmocka_unit_test(test_query_covering_index),
+        cmocka_unit_test(test_query_values_and_early_stop),
+        cmocka_unit_test(test_query_errors),
+    };
+
+    return cmocka_run_group_tests(tests, setup_db, teardown_db);
+}
@@ -0,0 +1,394 @@
+/*
+ * test_wtree3_index_set.c - Tests for concurrent-safe index sets
+ *
+ * Tests that:
+ * - Indexes can be added and dropped while other threads insert, update,
+ *   delete and read, and the index that stayed put remains consistent
+ * - An index dropped from a callback of a running operation (which holds
+ *   the index set itself) disappears at once and is fully gone after
+ *   the tree is reopened
+ * - Index seeks and joins running while another thread drops and re-adds
+ *   their index either miss it or see it whole, never a freed one
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+    #include <process.h>
+    #define mkdir(path, mode) _mkdir(path)
+    #define getpid() _getpid()
+#else
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "wtree3.h"
+#include "wthread.h"
+
+/* Test database path */
+static char test_db_path[256];
+static wtree3_db_t *test_db = NULL;
+
+static bool prefix_extractor(const void *value, size_t value_len,
+                             void *user_data,
+                             void **out_key, size_t *out_len);
+
+/* ============================================================
+ * Test Fixtures
+ * ============================================================ */
+
+static int setup_db(void **state) {
+    (void)state;
+
+#ifdef _WIN32
+    snprintf(test_db_path, sizeof(test_db_path), "%s\\test_wtree3_index_set_%d",
+             getenv("TEMP"), getpid());
+#else
+    snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_wtree3_index_set_%d", getpid());
+#endif
+    mkdir(test_db_path, 0755);
+
+    gerror_t error = {0};
+    test_db = wtree3_db_open(test_db_path, 128 * 1024 * 1024, 128, WTREE3_VERSION(1, 0), 0, &error);
+    if (!test_db) {
+        fprintf(stderr, "Failed to create test database: %s\n", error.message);
+        return -1;
+    }
+
+    for (uint32_t flags = 0; flags <= 0x03; flags++) {
+        int rc = wtree3_db_register_key_extractor(test_db, WTREE3_VERSION(1, 0), flags,
+                                                  prefix_extractor, &error);
+        if (rc != WTREE3_OK) {
+            fprintf(stderr, "Failed to register extractor for flags=0x%02x: %s\n", flags, error.message);
+            wtree3_db_close(test_db);
+            test_db = NULL;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int teardown_db(void **state) {
+    (void)state;
+
+    if (test_db) {
+        wtree3_db_close(test_db);
+        test_db = NULL;
+    }
+
+    char cmd[512];
+#ifdef _WIN32
+    snprintf(cmd, sizeof(cmd), "rd /s /q \"%s\"", test_db_path);
+#else
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", test_db_path);
+#endif
+    (void)system(cmd);
+
+    return 0;
+}
+
+/* Index the value up to its first '|' (the whole value if there is none) */
+static bool prefix_extractor(const void *value, size_t value_len,
+                             void *user_data,
+                             void **out_key, size_t *out_len) {
+    (void)user_data;
+    const char *bar = memchr(value, '|', value_len);
+    size_t len = bar ? (size_t)(bar - (const char *)value) : value_len;
+    if (len == 0) return false;
+
+    char *key = malloc(len);
+    if (!key) return false;
+
+    memcpy(key, value, len);
+    *out_key = key;
+    *out_len = len;
+    return true;
+}
+
+/* ============================================================
+ * Concurrent Schema Changes
+ * ============================================================ */
+
+#define WORKERS 4
+#define WORKER_OPS 2000
+#define SCHEMA_ROUNDS 20
+
+typedef struct {
+    wtree3_tree_t *tree;
+    int id;
+    int failures;
+} worker_ctx_t;
+
+/* Upserts, deletes and reads over a private key range */
+static void *worker_thread(void *arg) {
+    worker_ctx_t *ctx = (worker_ctx_t *)arg;
+    gerror_t error = {0};
+
+    for (int i = 0; i < WORKER_OPS; i++) {
+        char key[32], value[48];
+        snprintf(key, sizeof(key), "w%d:%04d", ctx->id, i % 200);
+        int len = snprintf(value, sizeof(value), "g%02d|round-%d", (i * 7) % 23, i);
+
+        int rc;
+        if (i % 5 == 4) {
+            bool deleted;
+            rc = wtree3_delete_one(ctx->tree, key, strlen(key), &deleted, &error);
+        } else {
+            rc = wtree3_upsert(ctx->tree, key, strlen(key), value, (size_t)len, &error);
+        }
+        if (rc != WTREE3_OK) ctx->failures++;
+
+        void *read = NULL;
+        size_t read_len = 0;
+        rc = wtree3_get(ctx->tree, key, strlen(key), &read, &read_len, &error);
+        if (rc != WTREE3_OK && rc != WTREE3_NOT_FOUND) ctx->failures++;
+        free(read);
+
+        if (!wtree3_tree_has_index(ctx->tree, "group_idx")) ctx->failures++;
+        if (wtree3_tree_index_count(ctx->tree) < 1) ctx->failures++;
+    }
+    return NULL;
+}
+
+static void test_add_drop_under_load(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "load_tree", 0, 0, &error);
+    assert_non_null(tree);
+    wtree3_index_config_t group = {.name = "group_idx"};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &group, &error));
+
+    wthread_t threads[WORKERS];
+    worker_ctx_t ctx[WORKERS];
+    for (int t = 0; t < WORKERS; t++) {
+        ctx[t] = (worker_ctx_t){.tree = tree, .id = t};
+        assert_int_equal(0, wthread_create(&threads[t], worker_thread, &ctx[t]));
+    }
+
+    /* Schema churn while the workers run */
+    for (int r = 0; r < SCHEMA_ROUNDS; r++) {
+        wtree3_index_config_t extra = {.name = "extra_idx"};
+        assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &extra, &error));
+        assert_true(wtree3_tree_has_index(tree, "extra_idx"));
+        assert_int_equal(WTREE3_OK, wtree3_tree_drop_index(tree, "extra_idx", &error));
+        assert_false(wtree3_tree_has_index(tree, "extra_idx"));
+    }
+
+    for (int t = 0; t < WORKERS; t++) {
+        assert_int_equal(0, wthread_join(threads[t], NULL));
+        assert_int_equal(0, ctx[t].failures);
+    }
+
+    assert_int_equal(1, wtree3_tree_index_count(tree));
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+
+    /* A fresh index built after the churn agrees with the data too */
+    wtree3_index_config_t extra = {.name = "extra_idx"};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &extra, &error));
+    assert_int_equal(WTREE3_OK, wtree3_tree_populate_index(tree, "extra_idx", &error));
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Drop From a Callback
+ * ============================================================ */
+
+typedef struct {
+    wtree3_tree_t *tree;
+    int calls;
+    int drop_rc;
+} drop_ctx_t;
+
+/* Runs while verify holds the index set */
+static bool drop_on_mismatch(const wtree3_verify_mismatch_t *m, void *user_data) {
+    (void)m;
+    drop_ctx_t *ctx = (drop_ctx_t *)user_data;
+    if (ctx->calls++ == 0) {
+        gerror_t error = {0};
+        ctx->drop_rc = wtree3_tree_drop_index(ctx->tree, "victim_idx", &error);
+    }
+    return true;
+}
+
+static void test_drop_from_callback(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "cb_tree", 0, 0, &error);
+    assert_non_null(tree);
+    wtree3_index_config_t group = {.name = "group_idx"};
+    wtree3_index_config_t victim = {.name = "victim_idx"};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &group, &error));
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &victim, &error));
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(txn);
+    for (int i = 0; i < 100; i++) {
+        char key[16], value[32];
+        snprintf(key, sizeof(key), "k:%03d", i);
+        int len = snprintf(value, sizeof(value), "g%02d|payload", i % 9);
+        assert_int_equal(WTREE3_OK, wtree3_insert_one_txn(txn, tree, key, strlen(key),
+                                                          value, (size_t)len, &error));
+    }
+
+    /* A row behind the indexes' back, so verify calls back */
+    MDB_txn *mtxn = wtree3_txn_get_mdb(txn);
+    MDB_dbi dbi;
+    assert_int_equal(0, mdb_dbi_open(mtxn, "cb_tree", 0, &dbi));
+    MDB_val k = {.mv_size = 5, .mv_data = "x:001"};
+    MDB_val v = {.mv_size = 10, .mv_data = "zz|hidden!"};
+    assert_int_equal(0, mdb_put(mtxn, dbi, &k, &v, 0));
+    assert_int_equal(WTREE3_OK, wtree3_txn_commit(txn, &error));
+
+    drop_ctx_t ctx = {.tree = tree};
+    wtree3_verify_opts_t opts = {.on_mismatch = drop_on_mismatch, .user_data = &ctx};
+    wtree3_verify_report_t report;
+    assert_int_equal(WTREE3_INDEX_ERROR, wtree3_tree_verify(tree, &opts, &report, &error));
+    assert_true(ctx.calls >= 1);
+    assert_int_equal(WTREE3_OK, ctx.drop_rc);
+
+    /* Gone at once for new operations, which keep working */
+    assert_false(wtree3_tree_has_index(tree, "victim_idx"));
+    assert_int_equal(1, wtree3_tree_index_count(tree));
+    assert_int_equal(WTREE3_OK, wtree3_upsert(tree, "k:500", 5, "g01|later", 9, &error));
+
+    /* A later schema change frees what the callback could not */
+    wtree3_index_config_t other = {.name = "other_idx"};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &other, &error));
+    assert_int_equal(WTREE3_OK, wtree3_tree_drop_index(tree, "other_idx", &error));
+    wtree3_tree_close(tree);
+
+    tree = wtree3_tree_open(test_db, "cb_tree", 0, 0, &error);
+    assert_non_null(tree);
+    assert_false(wtree3_tree_has_index(tree, "victim_idx"));
+    assert_true(wtree3_tree_has_index(tree, "group_idx"));
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Readers Racing Drop
+ * ============================================================ */
+
+#define READERS 4
+#define READER_ROWS 500
+#define DROP_ROUNDS 50
+
+typedef struct {
+    wtree3_tree_t *tree;
+    bool join;                      /* scan_join instead of seek */
+    uint32_t *stop;
+    int failures;
+} reader_ctx_t;
+
+typedef struct {
+    int bad;
+} join_count_t;
+
+static bool count_join(const void *index_key, size_t index_key_len,
+                       const void *main_key, size_t main_key_len,
+                       const void *value, size_t value_len, void *user_data) {
+    (void)main_key;
+    (void)main_key_len;
+    join_count_t *c = (join_count_t *)user_data;
+    if (value_len < index_key_len || memcmp(value, index_key, index_key_len) != 0) c->bad++;
+    return true;
+}
+
+/* Seeks or joins on victim_idx until told to stop; a missing index is fine */
+static void *reader_thread(void *arg) {
+    reader_ctx_t *ctx = (reader_ctx_t *)arg;
+
+    while (!watomic_load_u32(ctx->stop)) {
+        gerror_t error = {0};
+        if (ctx->join) {
+            join_count_t c = {0};
+            int rc = wtree3_index_scan_join(ctx->tree, "victim_idx", "g00", 3, "g05", 3, 0,
+                                            count_join, &c, &error);
+            if (rc == WTREE3_OK ? c.bad != 0 : rc != WTREE3_NOT_FOUND) ctx->failures++;
+            continue;
+        }
+
+        wtree3_iterator_t *iter = wtree3_index_seek(ctx->tree, "victim_idx", "g03", 3, &error);
+        if (!iter) {
+            if (error.code != WTREE3_NOT_FOUND) ctx->failures++;
+            continue;
+        }
+        if (wtree3_iterator_valid(iter)) {
+            const void *k;
+            size_t k_len;
+            if (!wtree3_iterator_key(iter, &k, &k_len) || k_len != 3 || memcmp(k, "g03", 3) != 0) {
+                ctx->failures++;
+            }
+        }
+        wtree3_iterator_close(iter);
+    }
+    return NULL;
+}
+
+static void test_readers_race_drop(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "race_tree", 0, 0, &error);
+    assert_non_null(tree);
+    for (int i = 0; i < READER_ROWS; i++) {
+        char key[16], value[32];
+        snprintf(key, sizeof(key), "r:%04d", i);
+        int len = snprintf(value, sizeof(value), "g%02d|payload", i % 10);
+        assert_int_equal(WTREE3_OK, wtree3_insert_one(tree, key, strlen(key),
+                                                      value, (size_t)len, &error));
+    }
+    wtree3_index_config_t victim = {.name = "victim_idx"};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &victim, &error));
+    assert_int_equal(WTREE3_OK, wtree3_tree_populate_index(tree, "victim_idx", &error));
+
+    uint32_t stop = 0;
+    wthread_t threads[READERS];
+    reader_ctx_t ctx[READERS];
+    for (int t = 0; t < READERS; t++) {
+        ctx[t] = (reader_ctx_t){.tree = tree, .join = t % 2 == 1, .stop = &stop};
+        assert_int_equal(0, wthread_create(&threads[t], reader_thread, &ctx[t]));
+    }
+
+    /* Every drop frees the index the readers may be in the middle of */
+    for (int r = 0; r < DROP_ROUNDS; r++) {
+        assert_int_equal(WTREE3_OK, wtree3_tree_drop_index(tree, "victim_idx", &error));
+        assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &victim, &error));
+        assert_int_equal(WTREE3_OK, wtree3_tree_populate_index(tree, "victim_idx", &error));
+    }
+    watomic_store_u32(&stop, 1);
+
+    for (int t = 0; t < READERS; t++) {
+        assert_int_equal(0, wthread_join(threads[t], NULL));
+        assert_int_equal(0, ctx[t].failures);
+    }
+
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Main
+ * ============================================================ */
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_add_drop_under_load),
+        cmocka_unit_test(test_drop_from_callback),
+        cmocka_unit_test(test_readers_race_drop),
+    };
+
+    return cmocka_run_group_tests(tests, setup_db, teardown_db);
+}
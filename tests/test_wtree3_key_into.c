@@ -0,0 +1,344 @@
+/*
+ * test_wtree3_key_into.c - Tests for allocation-free key extractors
+ *
+ * Tests indexes backed by wtree3_index_key_into_fn:
+ * - Keys copied into the library scratch buffer
+ * - Zero-copy keys pointing into the stored value
+ * - Keys larger than the scratch buffer (retry with requested size)
+ * - CRUD maintenance, sorted builds and reloading after tree reopen
+ * - One extractor kind per version+flags combination
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+    #include <process.h>
+    #define mkdir(path, mode) _mkdir(path)
+    #define getpid() _getpid()
+#else
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "wtree3.h"
+
+#define ROW_COUNT 500
+#define BIG_KEY_LEN 400     /* Above the scratch size, below the LMDB key limit */
+
+/* Test database path */
+static char test_db_path[256];
+static wtree3_db_t *test_db = NULL;
+
+/* Number of times an extractor asked for a larger buffer */
+static int grow_requests = 0;
+
+static bool field_key_into(const void *value, size_t value_len, void *user_data,
+                           void *buf, size_t buf_cap,
+                           const void **out_key, size_t *out_len);
+
+/* ============================================================
+ * Test Fixtures
+ * ============================================================ */
+
+static int setup_db(void **state) {
+    (void)state;
+
+#ifdef _WIN32
+    snprintf(test_db_path, sizeof(test_db_path), "%s\\test_wtree3_key_into_%d",
+             getenv("TEMP"), getpid());
+#else
+    snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_wtree3_key_into_%d", getpid());
+#endif
+    mkdir(test_db_path, 0755);
+
+    gerror_t error = {0};
+    test_db = wtree3_db_open(test_db_path, 64 * 1024 * 1024, 128, WTREE3_VERSION(1, 0), 0, &error);
+    if (!test_db) {
+        fprintf(stderr, "Failed to create test database: %s\n", error.message);
+        return -1;
+    }
+
+    for (uint32_t flags = 0; flags <= 0x03; flags++) {
+        int rc = wtree3_db_register_key_extractor_into(test_db, WTREE3_VERSION(1, 0), flags,
+                                                       field_key_into, &error);
+        if (rc != WTREE3_OK) {
+            fprintf(stderr, "Failed to register extractor for flags=0x%02x: %s\n", flags, error.message);
+            wtree3_db_close(test_db);
+            test_db = NULL;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int teardown_db(void **state) {
+    (void)state;
+
+    if (test_db) {
+        wtree3_db_close(test_db);
+        test_db = NULL;
+    }
+
+    char cmd[512];
+#ifdef _WIN32
+    snprintf(cmd, sizeof(cmd), "rd /s /q \"%s\"", test_db_path);
+#else
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", test_db_path);
+#endif
+    (void)system(cmd);
+
+    return 0;
+}
+
+/*
+ * Index key is everything before the first '|'. user_data selects how it
+ * is handed back: "copy" (scratch buffer), "zero" (slice of value) or
+ * "big" (field padded to BIG_KEY_LEN bytes, forcing a buffer retry).
+ */
+static bool field_key_into(const void *value, size_t value_len, void *user_data,
+                           void *buf, size_t buf_cap,
+                           const void **out_key, size_t *out_len) {
+    const char *mode = (const char *)user_data;
+    const char *sep = memchr(value, '|', value_len);
+    size_t field_len = sep ? (size_t)(sep - (const char *)value) : value_len;
+    if (field_len == 0) return false;
+
+    if (strcmp(mode, "zero") == 0) {
+        *out_key = value;
+        *out_len = field_len;
+        return true;
+    }
+
+    size_t key_len = strcmp(mode, "big") == 0 ? BIG_KEY_LEN : field_len;
+    if (key_len > buf_cap) {
+        grow_requests++;
+        *out_key = NULL;
+        *out_len = key_len;
+        return true;
+    }
+
+    memset(buf, '#', key_len);
+    memcpy(buf, value, field_len);
+    *out_key = buf;
+    *out_len = key_len;
+    return true;
+}
+
+/* ============================================================
+ * Helpers
+ * ============================================================ */
+
+static void add_index(wtree3_tree_t *tree, const char *name, const char *mode, bool unique) {
+    gerror_t error = {0};
+    wtree3_index_config_t config = {
+        .name = name,
+        .user_data = mode,
+        .user_data_len = strlen(mode) + 1,
+        .unique = unique,
+    };
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &config, &error));
+}
+
+static void insert_rows(wtree3_tree_t *tree, int from, int to) {
+    gerror_t error = {0};
+    char key[32], value[64];
+    for (int i = from; i < to; i++) {
+        snprintf(key, sizeof(key), "row:%06d", i);
+        snprintf(value, sizeof(value), "u%06d|payload-%d", i, i);
+        assert_int_equal(WTREE3_OK,
+                         wtree3_insert_one(tree, key, strlen(key), value, strlen(value), &error));
+    }
+}
+
+/* Seek the index for field f; returns whether an entry exists */
+static bool index_has_field(wtree3_tree_t *tree, const char *index_name, const char *field,
+                            size_t key_len) {
+    char key[BIG_KEY_LEN];
+    memset(key, '#', key_len);
+    memcpy(key, field, strlen(field));
+
+    gerror_t error = {0};
+    wtree3_iterator_t *iter = wtree3_index_seek(tree, index_name, key, key_len, &error);
+    if (!iter) return false;
+
+    bool found = false;
+    const void *k;
+    size_t k_len;
+    if (wtree3_iterator_valid(iter) && wtree3_iterator_key(iter, &k, &k_len)) {
+        found = k_len == key_len && memcmp(k, key, key_len) == 0;
+    }
+    wtree3_iterator_close(iter);
+    return found;
+}
+
+/* ============================================================
+ * CRUD Maintenance
+ * ============================================================ */
+
+static void run_crud_roundtrip(const char *tree_name, const char *mode, size_t key_len) {
+    gerror_t error = {0};
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, tree_name, 0, 0, &error);
+    assert_non_null(tree);
+    add_index(tree, "field_idx", mode, true);
+
+    insert_rows(tree, 0, ROW_COUNT);
+    assert_int_equal(ROW_COUNT, wtree3_tree_count(tree));
+    assert_true(index_has_field(tree, "field_idx", "u000042", key_len));
+
+    /* Unique constraint works through the scratch path too */
+    assert_int_equal(WTREE3_INDEX_ERROR,
+                     wtree3_insert_one(tree, "dup", 3, "u000042|x", 9, &error));
+
+    /* Update moves the entry, unchanged field keeps it */
+    assert_int_equal(WTREE3_OK, wtree3_update(tree, "row:000042", 10, "v000042|moved", 13, &error));
+    assert_false(index_has_field(tree, "field_idx", "u000042", key_len));
+    assert_true(index_has_field(tree, "field_idx", "v000042", key_len));
+    assert_int_equal(WTREE3_OK, wtree3_update(tree, "row:000042", 10, "v000042|again", 13, &error));
+    assert_true(index_has_field(tree, "field_idx", "v000042", key_len));
+
+    /* Delete removes the entry */
+    bool deleted = false;
+    assert_int_equal(WTREE3_OK, wtree3_delete_one(tree, "row:000042", 10, &deleted, &error));
+    assert_true(deleted);
+    assert_false(index_has_field(tree, "field_idx", "v000042", key_len));
+
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+    wtree3_tree_close(tree);
+}
+
+static void test_key_into_scratch_copy(void **state) {
+    (void)state;
+    grow_requests = 0;
+    run_crud_roundtrip("into_copy", "copy", 7);
+    assert_int_equal(0, grow_requests);
+}
+
+static void test_key_into_zero_copy(void **state) {
+    (void)state;
+    run_crud_roundtrip("into_zero", "zero", 7);
+}
+
+static void test_key_into_grows_buffer(void **state) {
+    (void)state;
+    grow_requests = 0;
+    run_crud_roundtrip("into_big", "big", BIG_KEY_LEN);
+    assert_true(grow_requests > 0);
+}
+
+/* ============================================================
+ * Index Builds and Persistence
+ * ============================================================ */
+
+static void test_key_into_build_existing_data(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "into_build", 0, 0, &error);
+    assert_non_null(tree);
+    insert_rows(tree, 0, ROW_COUNT);
+
+    /* Index added after the data - populated by the sorted build */
+    add_index(tree, "zero_idx", "zero", false);
+    add_index(tree, "big_idx", "big", false);
+    assert_int_equal(WTREE3_OK, wtree3_tree_populate_index(tree, "zero_idx", &error));
+    assert_int_equal(WTREE3_OK, wtree3_tree_populate_index(tree, "big_idx", &error));
+
+    assert_true(index_has_field(tree, "zero_idx", "u000100", 7));
+    assert_true(index_has_field(tree, "big_idx", "u000100", BIG_KEY_LEN));
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+
+    wtree3_tree_close(tree);
+}
+
+static void test_key_into_reload_after_reopen(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "into_reopen", 0, 0, &error);
+    assert_non_null(tree);
+    add_index(tree, "field_idx", "copy", true);
+    insert_rows(tree, 0, ROW_COUNT / 2);
+    int64_t count = wtree3_tree_count(tree);
+    wtree3_tree_close(tree);
+
+    /* Reopen: the persisted extractor ID resolves to the into-extractor */
+    tree = wtree3_tree_open(test_db, "into_reopen", 0, count, &error);
+    assert_non_null(tree);
+    assert_true(wtree3_tree_has_index(tree, "field_idx"));
+
+    insert_rows(tree, ROW_COUNT / 2, ROW_COUNT);
+    assert_true(index_has_field(tree, "field_idx", "u000010", 7));
+    assert_true(index_has_field(tree, "field_idx", "u000400", 7));
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Registration
+ * ============================================================ */
+
+static bool alloc_key_extractor(const void *value, size_t value_len,
+                                void *user_data,
+                                void **out_key, size_t *out_len) {
+    (void)user_data;
+    void *key = malloc(value_len ? value_len : 1);
+    if (!key) return false;
+    memcpy(key, value, value_len);
+    *out_key = key;
+    *out_len = value_len;
+    return true;
+}
+
+static void test_key_into_registration(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    assert_int_equal(WTREE3_EINVAL,
+                     wtree3_db_register_key_extractor_into(NULL, WTREE3_VERSION(2, 0), 0,
+                                                           field_key_into, &error));
+    assert_int_equal(WTREE3_EINVAL,
+                     wtree3_db_register_key_extractor_into(test_db, WTREE3_VERSION(2, 0), 0,
+                                                           NULL, &error));
+
+    /* Same version+flags cannot hold both kinds */
+    assert_int_equal(WTREE3_OK,
+                     wtree3_db_register_key_extractor_into(test_db, WTREE3_VERSION(2, 0), 0,
+                                                           field_key_into, &error));
+    assert_int_equal(WTREE3_ERROR,
+                     wtree3_db_register_key_extractor(test_db, WTREE3_VERSION(2, 0), 0,
+                                                      alloc_key_extractor, &error));
+
+    assert_int_equal(WTREE3_OK,
+                     wtree3_db_register_key_extractor(test_db, WTREE3_VERSION(2, 0), 1,
+                                                      alloc_key_extractor, &error));
+    assert_int_equal(WTREE3_ERROR,
+                     wtree3_db_register_key_extractor_into(test_db, WTREE3_VERSION(2, 0), 1,
+                                                           field_key_into, &error));
+}
+
+/* ============================================================
+ * Main
+ * ============================================================ */
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_key_into_scratch_copy),
+        cmocka_unit_test(test_key_into_zero_copy),
+        cmocka_unit_test(test_key_into_grows_buffer),
+        cmocka_unit_test(test_key_into_build_existing_data),
+        cmocka_unit_test(test_key_into_reload_after_reopen),
+        cmocka_unit_test(test_key_into_registration),
+    };
+
+    return cmocka_run_group_tests(tests, setup_db, teardown_db);
+}
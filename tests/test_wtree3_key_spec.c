@@ -0,0 +1,372 @@
+/*
+ * test_wtree3_key_spec.c - Tests for declarative index keys
+ *
+ * Tests that:
+ * - Integer parts sort numerically (unsigned and signed)
+ * - Composite (string, u32) keys sort by field, strings end at their NUL
+ * - sparse_if_zero skips entries, short values are skipped or rejected
+ * - Spec indexes reopen without any registered extractor
+ * - Unique spec indexes enforce uniqueness and build from existing data
+ * - Invalid specs are rejected
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+    #include <process.h>
+    #define mkdir(path, mode) _mkdir(path)
+    #define getpid() _getpid()
+#else
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "wtree3.h"
+
+/* Test database path */
+static char test_db_path[256];
+static wtree3_db_t *test_db = NULL;
+
+/* Packed record the specs below describe */
+typedef struct {
+    uint64_t id;
+    int64_t balance;
+    char country[4];
+    uint32_t age;
+} record_t;
+
+/* ============================================================
+ * Test Fixtures
+ * ============================================================ */
+
+static int setup_db(void **state) {
+    (void)state;
+
+#ifdef _WIN32
+    snprintf(test_db_path, sizeof(test_db_path), "%s\\test_wtree3_key_spec_%d",
+             getenv("TEMP"), getpid());
+#else
+    snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_wtree3_key_spec_%d", getpid());
+#endif
+    mkdir(test_db_path, 0755);
+
+    /* No extractor is registered: spec indexes must not need one */
+    gerror_t error = {0};
+    test_db = wtree3_db_open(test_db_path, 64 * 1024 * 1024, 128, WTREE3_VERSION(1, 0), 0, &error);
+    if (!test_db) {
+        fprintf(stderr, "Failed to create test database: %s\n", error.message);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int teardown_db(void **state) {
+    (void)state;
+
+    if (test_db) {
+        wtree3_db_close(test_db);
+        test_db = NULL;
+    }
+
+    char cmd[512];
+#ifdef _WIN32
+    snprintf(cmd, sizeof(cmd), "rd /s /q \"%s\"", test_db_path);
+#else
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", test_db_path);
+#endif
+    (void)system(cmd);
+
+    return 0;
+}
+
+/* ============================================================
+ * Helpers
+ * ============================================================ */
+
+static const wtree3_key_spec_t balance_spec = {
+    .part_count = 1,
+    .parts = {{.offset = offsetof(record_t, balance), .type = WTREE3_KEY_I64}},
+};
+
+static const wtree3_key_spec_t country_age_spec = {
+    .part_count = 2,
+    .parts = {
+        {.offset = offsetof(record_t, country), .length = 4, .type = WTREE3_KEY_STRING},
+        {.offset = offsetof(record_t, age), .type = WTREE3_KEY_U32, .sparse_if_zero = true},
+    },
+};
+
+static void put_record(wtree3_tree_t *tree, uint64_t id, int64_t balance,
+                       const char *country, uint32_t age) {
+    gerror_t error = {0};
+    record_t r;
+    memset(&r, 0, sizeof(r));
+    r.id = id;
+    r.balance = balance;
+    /* Fixed-width and unterminated: copy at most the field, zero padded */
+    size_t country_len = strlen(country);
+    memcpy(r.country, country,
+           country_len < sizeof(r.country) ? country_len : sizeof(r.country));
+    r.age = age;
+    assert_int_equal(WTREE3_OK,
+                     wtree3_insert_one(tree, &r.id, sizeof(r.id), &r, sizeof(r), &error));
+}
+
+/* Main-key ids of the index in index order */
+static size_t index_order(wtree3_tree_t *tree, const char *index_name, uint64_t *ids, size_t cap) {
+    gerror_t error = {0};
+    wtree3_iterator_t *it = wtree3_index_seek_range(tree, index_name, NULL, 0, &error);
+    assert_non_null(it);
+
+    size_t n = 0;
+    wtree3_iterator_first(it);
+    while (wtree3_iterator_valid(it) && n < cap) {
+        const void *mk;
+        size_t mk_len;
+        assert_true(wtree3_index_iterator_main_key(it, &mk, &mk_len));
+        assert_int_equal(mk_len, sizeof(uint64_t));
+        memcpy(&ids[n++], mk, sizeof(uint64_t));
+        wtree3_iterator_next(it);
+    }
+    wtree3_iterator_close(it);
+    return n;
+}
+
+static wtree3_tree_t *create_people(const char *name) {
+    gerror_t error = {0};
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, name, 0, 0, &error);
+    assert_non_null(tree);
+
+    wtree3_index_config_t by_balance = {.name = "balance_idx", .key_spec = &balance_spec};
+    wtree3_index_config_t by_country = {.name = "country_age_idx", .sparse = true,
+                                        .key_spec = &country_age_spec};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &by_balance, &error));
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &by_country, &error));
+
+    put_record(tree, 1, 500, "us", 40);
+    put_record(tree, 2, -7, "de", 300);
+    put_record(tree, 3, 0, "usa", 2);
+    put_record(tree, 4, -1000000, "us", 3);
+    put_record(tree, 5, INT64_MAX, "de", 0);    /* age 0: not in country_age_idx */
+    return tree;
+}
+
+/* ============================================================
+ * Ordering
+ * ============================================================ */
+
+static void test_spec_integer_order(void **state) {
+    (void)state;
+
+    wtree3_tree_t *tree = create_people("ks_int");
+
+    uint64_t ids[8];
+    size_t n = index_order(tree, "balance_idx", ids, 8);
+    assert_int_equal(n, 5);
+    const uint64_t expected[] = {4, 2, 3, 1, 5};
+    assert_memory_equal(ids, expected, sizeof(expected));
+
+    /* Seek keys come from the same encoding */
+    gerror_t error = {0};
+    record_t probe = {.balance = -7};
+    unsigned char key[32];
+    size_t key_len = 0;
+    assert_int_equal(WTREE3_OK, wtree3_key_spec_encode(&balance_spec, &probe, sizeof(probe),
+                                                       key, sizeof(key), &key_len, &error));
+    assert_int_equal(key_len, 8);
+
+    wtree3_iterator_t *it = wtree3_index_seek(tree, "balance_idx", key, key_len, &error);
+    assert_non_null(it);
+    assert_true(wtree3_iterator_valid(it));
+    const void *mk;
+    size_t mk_len;
+    assert_true(wtree3_index_iterator_main_key(it, &mk, &mk_len));
+    assert_int_equal(*(const uint64_t *)mk, 2);
+    wtree3_iterator_close(it);
+
+    wtree3_tree_close(tree);
+}
+
+static void test_spec_composite_order(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = create_people("ks_comp");
+
+    /* "de" < "us" < "usa": the string part ends at its field, age decides within */
+    uint64_t ids[8];
+    size_t n = index_order(tree, "country_age_idx", ids, 8);
+    assert_int_equal(n, 4);
+    const uint64_t expected[] = {2, 4, 1, 3};
+    assert_memory_equal(ids, expected, sizeof(expected));
+
+    /* Updates move entries; a zero age drops them */
+    record_t r = {.id = 1, .balance = 500, .country = "de", .age = 1};
+    assert_int_equal(WTREE3_OK, wtree3_update(tree, &r.id, sizeof(r.id), &r, sizeof(r), &error));
+    r.id = 4;
+    r.age = 0;
+    assert_int_equal(WTREE3_OK, wtree3_update(tree, &r.id, sizeof(r.id), &r, sizeof(r), &error));
+    n = index_order(tree, "country_age_idx", ids, 8);
+    assert_int_equal(n, 3);
+    const uint64_t updated[] = {1, 2, 3};
+    assert_memory_equal(ids, updated, sizeof(updated));
+
+    /* Encoded composite: "de" 0x00 then age big-endian */
+    record_t probe = {.country = "de", .age = 0x01020304};
+    unsigned char key[32];
+    size_t key_len = 0;
+    assert_int_equal(WTREE3_OK, wtree3_key_spec_encode(&country_age_spec, &probe, sizeof(probe),
+                                                       key, sizeof(key), &key_len, &error));
+    const unsigned char want[] = {'d', 'e', 0, 1, 2, 3, 4};
+    assert_int_equal(key_len, sizeof(want));
+    assert_memory_equal(key, want, sizeof(want));
+
+    probe.age = 0;
+    assert_int_equal(WTREE3_NOT_FOUND,
+                     wtree3_key_spec_encode(&country_age_spec, &probe, sizeof(probe),
+                                            key, sizeof(key), &key_len, &error));
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Lifecycle
+ * ============================================================ */
+
+static void test_spec_short_values(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "ks_short", 0, 0, &error);
+    assert_non_null(tree);
+
+    wtree3_index_config_t sparse = {.name = "sparse_idx", .sparse = true,
+                                    .key_spec = &country_age_spec};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &sparse, &error));
+
+    /* Too short for the spec: skipped by a sparse index */
+    assert_int_equal(WTREE3_OK, wtree3_insert_one(tree, "a", 1, "tiny", 4, &error));
+    uint64_t ids[4];
+    assert_int_equal(index_order(tree, "sparse_idx", ids, 4), 0);
+
+    /* ...and refused by a dense one */
+    wtree3_index_config_t dense = {.name = "dense_idx", .key_spec = &balance_spec};
+    assert_int_equal(WTREE3_OK, wtree3_tree_drop_index(tree, "sparse_idx", &error));
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &dense, &error));
+    assert_int_not_equal(WTREE3_OK, wtree3_insert_one(tree, "b", 1, "tiny", 4, &error));
+    assert_false(wtree3_exists(tree, "b", 1, &error));
+
+    wtree3_tree_close(tree);
+}
+
+static void test_spec_persistence(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = create_people("ks_persist");
+    wtree3_tree_close(tree);
+
+    /* Both indexes load back with no extractor registered */
+    tree = wtree3_tree_open(test_db, "ks_persist", 0, 0, &error);
+    assert_non_null(tree);
+    assert_int_equal(wtree3_tree_index_count(tree), 2);
+
+    put_record(tree, 6, -8, "de", 299);
+    uint64_t ids[8];
+    size_t n = index_order(tree, "country_age_idx", ids, 8);
+    assert_int_equal(n, 5);
+    const uint64_t expected[] = {6, 2, 4, 1, 3};
+    assert_memory_equal(ids, expected, sizeof(expected));
+
+    n = index_order(tree, "balance_idx", ids, 8);
+    assert_int_equal(n, 6);
+    assert_int_equal(ids[0], 4);
+    assert_int_equal(ids[1], 6);
+
+    wtree3_tree_close(tree);
+}
+
+static void test_spec_unique_build(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "ks_unique", 0, 0, &error);
+    assert_non_null(tree);
+    for (uint64_t i = 1; i <= 200; i++) put_record(tree, i, (int64_t)i * 10 - 1000, "xx", 1);
+
+    /* Built over existing rows by the parallel sort-based build */
+    wtree3_index_config_t cfg = {.name = "balance_idx", .unique = true, .key_spec = &balance_spec};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &cfg, &error));
+    wtree3_index_build_opts_t opts = {.threads = 4};
+    assert_int_equal(WTREE3_OK, wtree3_tree_build_index(tree, "balance_idx", &opts, &error));
+
+    uint64_t ids[256];
+    size_t n = index_order(tree, "balance_idx", ids, 256);
+    assert_int_equal(n, 200);
+    for (size_t i = 0; i < n; i++) assert_int_equal(ids[i], i + 1);
+
+    record_t dup = {.id = 999, .balance = -990};
+    assert_int_equal(WTREE3_INDEX_ERROR,
+                     wtree3_insert_one(tree, &dup.id, sizeof(dup.id), &dup, sizeof(dup), &error));
+
+    wtree3_tree_close(tree);
+}
+
+static void test_spec_errors(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "ks_errors", 0, 0, &error);
+    assert_non_null(tree);
+
+    wtree3_key_spec_t spec = {.part_count = 0};
+    wtree3_index_config_t cfg = {.name = "bad_idx", .key_spec = &spec};
+    assert_int_equal(WTREE3_EINVAL, wtree3_tree_add_index(tree, &cfg, &error));
+
+    spec.part_count = 1;
+    spec.parts[0] = (wtree3_key_part_t){.offset = 0, .length = 0, .type = WTREE3_KEY_BYTES};
+    assert_int_equal(WTREE3_EINVAL, wtree3_tree_add_index(tree, &cfg, &error));
+
+    spec.parts[0] = (wtree3_key_part_t){.offset = 0, .length = 300, .type = WTREE3_KEY_BYTES};
+    assert_int_equal(WTREE3_EINVAL, wtree3_tree_add_index(tree, &cfg, &error));
+
+    spec.parts[0] = (wtree3_key_part_t){.offset = 0, .type = (wtree3_key_type_t)42};
+    assert_int_equal(WTREE3_EINVAL, wtree3_tree_add_index(tree, &cfg, &error));
+    assert_int_equal(wtree3_tree_index_count(tree), 0);
+
+    /* Without a spec the registry is still required */
+    wtree3_index_config_t plain = {.name = "plain_idx"};
+    assert_int_equal(WTREE3_EINVAL, wtree3_tree_add_index(tree, &plain, &error));
+
+    record_t probe = {.balance = 1};
+    unsigned char small[4];
+    size_t len;
+    assert_int_equal(WTREE3_EINVAL, wtree3_key_spec_encode(&balance_spec, &probe, sizeof(probe),
+                                                           small, sizeof(small), &len, &error));
+    assert_int_equal(WTREE3_NOT_FOUND, wtree3_key_spec_encode(&balance_spec, &probe, 4,
+                                                              small, sizeof(small), &len, &error));
+
+    wtree3_tree_close(tree);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_spec_integer_order),
+        cmocka_unit_test(test_spec_composite_order),
+        cmocka_unit_test(test_spec_short_values),
+        cmocka_unit_test(test_spec_persistence),
+        cmocka_unit_test(test_spec_unique_build),
+        cmocka_unit_test(test_spec_errors),
+    };
+
+    return cmocka_run_group_tests(tests, setup_db, teardown_db);
+}
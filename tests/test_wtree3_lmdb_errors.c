@@ -45,6 +45,9 @@ typedef struct {
 static mock_state_t mock_mdb_put = {-1, 0, 0, "mdb_put"};
 static mock_state_t mock_mdb_get = {-1, 0, 0, "mdb_get"};
 static mock_state_t mock_mdb_del = {-1, 0, 0, "mdb_del"};
+static mock_state_t mock_mdb_cursor_put = {-1, 0, 0, "mdb_cursor_put"};
+static mock_state_t mock_mdb_cursor_del = {-1, 0, 0, "mdb_cursor_del"};
+static mock_state_t mock_mdb_stat = {-1, 0, 0, "mdb_stat"};
 
 /* Reset all mocks */
 static void reset_all_mocks(void) {
@@ -54,6 +57,12 @@ static void reset_all_mocks(void) {
     mock_mdb_get.call_count = 0;
     mock_mdb_del.error_on_call = -1;
     mock_mdb_del.call_count = 0;
+    mock_mdb_cursor_put.error_on_call = -1;
+    mock_mdb_cursor_put.call_count = 0;
+    mock_mdb_cursor_del.error_on_call = -1;
+    mock_mdb_cursor_del.call_count = 0;
+    mock_mdb_stat.error_on_call = -1;
+    mock_mdb_stat.call_count = 0;
 }
 
 /* ============================================================
@@ -64,6 +73,9 @@ static void reset_all_mocks(void) {
 int __real_mdb_put(MDB_txn *txn, MDB_dbi dbi, MDB_val *key, MDB_val *data, unsigned int flags);
 int __real_mdb_get(MDB_txn *txn, MDB_dbi dbi, MDB_val *key, MDB_val *data);
 int __real_mdb_del(MDB_txn *txn, MDB_dbi dbi, MDB_val *key, MDB_val *data);
+int __real_mdb_cursor_put(MDB_cursor *cursor, MDB_val *key, MDB_val *data, unsigned int flags);
+int __real_mdb_cursor_del(MDB_cursor *cursor, unsigned int flags);
+int __real_mdb_stat(MDB_txn *txn, MDB_dbi dbi, MDB_stat *stat);
 
 /* Wrapped mdb_put - intercepts all mdb_put calls */
 int __wrap_mdb_put(MDB_txn *txn, MDB_dbi dbi, MDB_val *key, MDB_val *data, unsigned int flags) {
@@ -100,6 +112,42 @@ int __wrap_mdb_del(MDB_txn *txn, MDB_dbi dbi, MDB_val *key, MDB_val *data) {
     return __real_mdb_del(txn, dbi, key, data);
 }
 
+/*
+ * Wrapped mdb_cursor_put / mdb_cursor_del - updates, upserts and deletes
+ * find their key with a cursor and write the main tree through it
+ * (mdb_put's own cursor calls inside mdb.c are not wrapped)
+ */
+int __wrap_mdb_cursor_put(MDB_cursor *cursor, MDB_val *key, MDB_val *data, unsigned int flags) {
+    mock_mdb_cursor_put.call_count++;
+
+    if (mock_mdb_cursor_put.error_on_call == mock_mdb_cursor_put.call_count) {
+        return mock_mdb_cursor_put.error_code;
+    }
+
+    return __real_mdb_cursor_put(cursor, key, data, flags);
+}
+
+int __wrap_mdb_cursor_del(MDB_cursor *cursor, unsigned int flags) {
+    mock_mdb_cursor_del.call_count++;
+
+    if (mock_mdb_cursor_del.error_on_call == mock_mdb_cursor_del.call_count) {
+        return mock_mdb_cursor_del.error_code;
+    }
+
+    return __real_mdb_cursor_del(cursor, flags);
+}
+
+/* Wrapped mdb_stat - entry counts are read from the DB record */
+int __wrap_mdb_stat(MDB_txn *txn, MDB_dbi dbi, MDB_stat *stat) {
+    mock_mdb_stat.call_count++;
+
+    if (mock_mdb_stat.error_on_call == mock_mdb_stat.call_count) {
+        return mock_mdb_stat.error_code;
+    }
+
+    return __real_mdb_stat(txn, dbi, stat);
+}
+
 /* ============================================================
  * Test Context and Fixtures
  * ============================================================ */
@@ -471,12 +519,12 @@ static void test_insert_fails_on_main_tree_put(void **state) {
  * Priority 1.2: Update with Index Error
  *
  * Update operation sequence with 2 indexes:
- *   1st: mdb_get - fetch old value
+ *   1st: cursor seek - find the key and its old value
  *   2nd: mdb_del - delete from first index (old value)
  *   3rd: mdb_del - delete from second index (old value)
  *   4th: mdb_put - insert into first index (new value)
  *   5th: mdb_put - insert into second index (new value)
- *   6th: mdb_put - update main tree
+ *   6th: mdb_cursor_put - update main tree (MDB_CURRENT)
  *
  * Critical: If any operation fails, old value must be preserved!
  * ============================================================ */
@@ -503,7 +551,7 @@ static void test_update_fails_on_first_index_delete(void **state) {
     assert_int_equal(initial_count, 1);
 
     /* Arrange: Configure mock to fail on 2nd mdb_del (first index delete)
-     * Call sequence: 1. mdb_get, 2. mdb_del (fail here)
+     * Call sequence: 1. cursor seek, 2. mdb_del (fail here)
      */
     reset_all_mocks();
     mock_mdb_del.error_on_call = 1;
@@ -560,7 +608,7 @@ static void test_update_fails_on_new_index_insert(void **state) {
     int64_t initial_count = wtree3_tree_count(ctx->tree);
 
     /* Arrange: Configure mock to fail on 2nd mdb_put (first new index insert)
-     * Call sequence: 1. mdb_get, 2. mdb_del (idx1 old), 3. mdb_del (idx2 old),
+     * Call sequence: 1. cursor seek, 2. mdb_del (idx1 old), 3. mdb_del (idx2 old),
      *                4. mdb_put (idx1 new - FAIL HERE)
      */
     reset_all_mocks();
@@ -617,14 +665,14 @@ static void test_update_fails_on_main_tree_put(void **state) {
 
     int64_t initial_count = wtree3_tree_count(ctx->tree);
 
-    /* Arrange: Configure mock to fail on 3rd mdb_put (main tree update)
-     * Call sequence: 1. mdb_get, 2. mdb_del (idx1 old), 3. mdb_del (idx2 old),
+    /* Arrange: Configure mock to fail on the main tree put
+     * Call sequence: 1. cursor seek, 2. mdb_del (idx1 old), 3. mdb_del (idx2 old),
      *                4. mdb_put (idx1 new), 5. mdb_put (idx2 new),
-     *                6. mdb_put (main tree - FAIL HERE)
+     *                6. mdb_cursor_put (main tree - FAIL HERE)
      */
     reset_all_mocks();
-    mock_mdb_put.error_on_call = 3;  /* Third mdb_put is main tree */
-    mock_mdb_put.error_code = MDB_MAP_FULL;
+    mock_mdb_cursor_put.error_on_call = 1;  /* Only cursor put is main tree */
+    mock_mdb_cursor_put.error_code = MDB_MAP_FULL;
 
     /* Act: Attempt update */
     const char *new_value = "email:new@example.com|age:30";
@@ -664,14 +712,61 @@ static void test_update_fails_on_main_tree_put(void **state) {
     assert_entry_count_correct(ctx->tree);
 }
 
+/* Test: Update only rewrites indexes whose extracted key changed */
+static void test_update_skips_unchanged_index_keys(void **state) {
+    test_ctx_t *ctx = *state;
+    gerror_t error = {0};
+
+    const char *key = "user1";
+    insert_initial_entry(ctx, key, "email:old@example.com|age:25");
+
+    /* Act: Change only the age field
+     * Expected: 1 mdb_del (age_idx old), 1 mdb_put (age_idx new),
+     *           1 mdb_cursor_put (main tree)
+     */
+    reset_all_mocks();
+    const char *age_value = "email:old@example.com|age:30";
+    int rc = wtree3_update(ctx->tree, key, strlen(key), age_value, strlen(age_value) + 1, &error);
+    assert_int_equal(rc, WTREE3_OK);
+    assert_int_equal(mock_mdb_del.call_count, 1);
+    assert_int_equal(mock_mdb_put.call_count, 1);
+    assert_int_equal(mock_mdb_cursor_put.call_count, 1);
+
+    /* Act: Change a non-indexed field only
+     * Expected: no index writes at all, 1 mdb_cursor_put (main tree)
+     */
+    reset_all_mocks();
+    const char *note_value = "email:old@example.com|age:30|note:x";
+    rc = wtree3_update(ctx->tree, key, strlen(key), note_value, strlen(note_value) + 1, &error);
+    assert_int_equal(rc, WTREE3_OK);
+    assert_int_equal(mock_mdb_del.call_count, 0);
+    assert_int_equal(mock_mdb_put.call_count, 0);
+    assert_int_equal(mock_mdb_cursor_put.call_count, 1);
+
+    /* Assert: Index entries still point at the key */
+    reset_all_mocks();
+    wtree3_iterator_t *idx_iter = wtree3_index_seek(ctx->tree, "email_idx", "old@example.com", 16, NULL);
+    assert_non_null(idx_iter);
+    assert_true(wtree3_iterator_valid(idx_iter));
+    wtree3_iterator_close(idx_iter);
+
+    idx_iter = wtree3_index_seek(ctx->tree, "age_idx", "30", 3, NULL);
+    assert_non_null(idx_iter);
+    assert_true(wtree3_iterator_valid(idx_iter));
+    wtree3_iterator_close(idx_iter);
+
+    assert_index_consistency(ctx->tree);
+    assert_entry_count_correct(ctx->tree);
+}
+
 /* ============================================================
  * Priority 1.3: Delete with Index Error
  *
  * Delete operation sequence with 2 indexes:
- *   1st: mdb_get - fetch value for index cleanup
+ *   1st: cursor seek - find the key and its value for index cleanup
  *   2nd: mdb_del - delete from first index
  *   3rd: mdb_del - delete from second index
- *   4th: mdb_del - delete from main tree
+ *   4th: mdb_cursor_del - delete from main tree
  *
  * Critical: If any operation fails, entry must be preserved!
  * ============================================================ */
@@ -690,7 +785,7 @@ static void test_delete_fails_on_first_index_delete(void **state) {
     assert_int_equal(initial_count, 1);
 
     /* Arrange: Configure mock to fail on 1st mdb_del (first index delete)
-     * Call sequence: 1. mdb_get, 2. mdb_del (fail here)
+     * Call sequence: 1. cursor seek, 2. mdb_del (fail here)
      */
     reset_all_mocks();
     mock_mdb_del.error_on_call = 1;
@@ -744,7 +839,7 @@ static void test_delete_fails_on_second_index_delete(void **state) {
     int64_t initial_count = wtree3_tree_count(ctx->tree);
 
     /* Arrange: Configure mock to fail on 2nd mdb_del (second index delete)
-     * Call sequence: 1. mdb_get, 2. mdb_del (idx1), 3. mdb_del (idx2 - FAIL HERE)
+     * Call sequence: 1. cursor seek, 2. mdb_del (idx1), 3. mdb_del (idx2 - FAIL HERE)
      */
     reset_all_mocks();
     mock_mdb_del.error_on_call = 2;
@@ -802,13 +897,13 @@ static void test_delete_fails_on_main_tree_delete(void **state) {
 
     int64_t initial_count = wtree3_tree_count(ctx->tree);
 
-    /* Arrange: Configure mock to fail on 3rd mdb_del (main tree delete)
-     * Call sequence: 1. mdb_get, 2. mdb_del (idx1), 3. mdb_del (idx2),
-     *                4. mdb_del (main tree - FAIL HERE)
+    /* Arrange: Configure mock to fail on the main tree delete
+     * Call sequence: 1. cursor seek, 2. mdb_del (idx1), 3. mdb_del (idx2),
+     *                4. mdb_cursor_del (main tree - FAIL HERE)
      */
     reset_all_mocks();
-    mock_mdb_del.error_on_call = 3;
-    mock_mdb_del.error_code = MDB_MAP_FULL;
+    mock_mdb_cursor_del.error_on_call = 1;
+    mock_mdb_cursor_del.error_code = MDB_MAP_FULL;
 
     /* Act: Attempt delete */
     bool deleted = false;
@@ -1162,6 +1257,7 @@ static void test_populate_fails_on_commit(void **state) {
  * - Failed operations that should NOT change count
  * - Multiple operations in sequence
  * - Entry count after various rollback scenarios
+ * - Sharded counts when one shard's count fails
  *
  * The entry count is critical for application logic and must be
  * 100% accurate at all times.
@@ -1391,6 +1487,55 @@ static void test_batch_insert_partial_failure_count(void **state) {
     printf("  Batch insert with failure maintained accurate count\n");
 }
 
+/* Test: A shard whose count fails fails the sharded count */
+static void test_sharded_count_shard_failure(void **state) {
+    test_ctx_t *ctx = *state;
+    gerror_t error = {0};
+
+    char path[300];
+    snprintf(path, sizeof(path), "%s_shards", ctx->db_path);
+    wtree3_shard_config_t config = {
+        .shards = 3,
+        .mode = WTREE3_SHARD_HASH,
+        .mapsize = 16 * 1024 * 1024,
+        .max_dbs = 8,
+        .version = WTREE3_VERSION(1, 0),
+    };
+    wtree3_sharded_db_t *sdb = wtree3_sharded_db_open(path, &config, &error);
+    assert_non_null(sdb);
+    wtree3_sharded_tree_t *st = wtree3_sharded_tree_open(sdb, "items", 0, &error);
+    assert_non_null(st);
+
+    for (int i = 0; i < 30; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "k%03d", i);
+        assert_int_equal(WTREE3_OK, wtree3_sharded_insert_one(st, key, strlen(key), "v", 1, &error));
+    }
+    assert_int_equal(30, wtree3_sharded_tree_count(st));
+
+    /* Second shard's mdb_stat fails: no partial sum */
+    reset_all_mocks();
+    mock_mdb_stat.error_on_call = 2;
+    mock_mdb_stat.error_code = MDB_BAD_TXN;
+    assert_int_equal(-1, wtree3_sharded_tree_count(st));
+    assert_int_equal(2, mock_mdb_stat.call_count);
+
+    reset_all_mocks();
+    assert_int_equal(30, wtree3_sharded_tree_count(st));
+
+    wtree3_sharded_tree_close(st);
+    wtree3_sharded_db_close(sdb);
+    char cmd[512];
+#ifdef _WIN32
+    snprintf(cmd, sizeof(cmd), "rd /s /q \"%s\"", path);
+#else
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", path);
+#endif
+    (void)system(cmd);
+
+    printf("  Sharded count correctly reported a failing shard\n");
+}
+
 /* ============================================================
  * Test Suite Definition
  * ============================================================ */
@@ -1430,6 +1575,11 @@ int main(void) {
             setup_tree_with_indexes,
             teardown_tree_with_indexes
         ),
+        cmocka_unit_test_setup_teardown(
+            test_update_skips_unchanged_index_keys,
+            setup_tree_with_indexes,
+            teardown_tree_with_indexes
+        ),
 
         /* Priority 1.3: Delete with index error */
         cmocka_unit_test_setup_teardown(
@@ -1516,6 +1666,11 @@ int main(void) {
             setup_tree_with_indexes,
             teardown_tree_with_indexes
         ),
+        cmocka_unit_test_setup_teardown(
+            test_sharded_count_shard_failure,
+            setup_tree_with_indexes,
+            teardown_tree_with_indexes
+        ),
     };
 
     printf("=======================================================\n");
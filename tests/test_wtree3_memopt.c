@@ -43,7 +43,7 @@ static int setup_db(void **state) {
     mkdir(test_db_path, 0755);
 
     gerror_t error = {0};
-    test_db = wtree3_db_open(test_db_path, 1024 * 1024, 32, WTREE3_VERSION(1, 0), 0, &error);
+    test_db = wtree3_db_open(test_db_path, 4 * 1024 * 1024, 32, WTREE3_VERSION(1, 0), 0, &error);
     if (!test_db) {
         fprintf(stderr, "Failed to create test database: %s\n", error.message);
         return -1;
@@ -271,6 +271,147 @@ static void test_prefetch_null_db(void **state) {
     assert_int_equal(rc, WTREE3_EINVAL);
 }
 
+/* ============================================================
+ * Tree Warmup Tests
+ * ============================================================ */
+
+#define WARMUP_ROWS 3000
+
+/* Rows "k000000".. with value "gNN-..." indexed on the first 3 bytes */
+static wtree3_tree_t *open_warmup_tree(const char *name, int rows) {
+    gerror_t error = {0};
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, name, 0, 0, &error);
+    assert_non_null(tree);
+
+    wtree3_key_spec_t spec = {
+        .part_count = 1,
+        .parts = {{.offset = 0, .length = 3, .type = WTREE3_KEY_BYTES}},
+    };
+    wtree3_index_config_t config = {.name = "group_idx", .key_spec = &spec};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &config, &error));
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(txn);
+    char key[16], value[32];
+    for (int i = 0; i < rows; i++) {
+        snprintf(key, sizeof(key), "k%06d", i);
+        snprintf(value, sizeof(value), "g%02d-value-%06d", i % 50, i);
+        assert_int_equal(WTREE3_OK, wtree3_insert_one_txn(txn, tree, key, strlen(key),
+                                                          value, strlen(value), &error));
+    }
+    assert_int_equal(WTREE3_OK, wtree3_txn_commit(txn, &error));
+    return tree;
+}
+
+static MDB_stat named_db_stat(const char *name) {
+    MDB_env *env = wtree3_db_get_env(test_db);
+    MDB_txn *txn;
+    MDB_dbi dbi;
+    MDB_stat st;
+    assert_int_equal(0, mdb_txn_begin(env, NULL, MDB_RDONLY, &txn));
+    assert_int_equal(0, mdb_dbi_open(txn, name, 0, &dbi));
+    assert_int_equal(0, mdb_stat(txn, dbi, &st));
+    mdb_txn_abort(txn);
+    return st;
+}
+
+static void test_warmup_covers_tree_and_indexes(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = open_warmup_tree("warm", WARMUP_ROWS);
+    MDB_stat main_st = named_db_stat("warm");
+    MDB_stat idx_st = named_db_stat("idx:warm:group_idx");
+    assert_true(main_st.ms_depth >= 2);
+
+    /* Main tree alone: every branch and leaf page */
+    wtree3_warmup_stats_t ws;
+    assert_int_equal(WTREE3_OK, wtree3_tree_warmup(tree, 0, 0, &ws, &error));
+    assert_int_equal(ws.branch_pages, main_st.ms_branch_pages);
+    assert_int_equal(ws.leaf_pages, main_st.ms_leaf_pages);
+    assert_int_equal(ws.bytes, (ws.branch_pages + ws.leaf_pages) * main_st.ms_psize);
+
+    /* With indexes the index B-tree is added (its dup subtrees are not) */
+    wtree3_warmup_stats_t all;
+    assert_int_equal(WTREE3_OK, wtree3_tree_warmup(tree, WTREE3_WARMUP_INDEXES, 0, &all, &error));
+    assert_true(all.branch_pages + all.leaf_pages > ws.branch_pages + ws.leaf_pages);
+    assert_true(all.branch_pages + all.leaf_pages <=
+                ws.branch_pages + ws.leaf_pages + idx_st.ms_branch_pages + idx_st.ms_leaf_pages);
+
+    /* Branches only */
+    assert_int_equal(WTREE3_OK, wtree3_tree_warmup(tree, WTREE3_WARMUP_BRANCHES_ONLY, 0, &ws, &error));
+    assert_int_equal(ws.branch_pages, main_st.ms_branch_pages);
+    assert_int_equal(ws.leaf_pages, 0);
+
+    wtree3_tree_close(tree);
+}
+
+static void test_warmup_budget(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = open_warmup_tree("warm_budget", WARMUP_ROWS);
+    MDB_stat st = named_db_stat("warm_budget");
+
+    /* Branch pages are charged first */
+    wtree3_warmup_stats_t ws;
+    size_t budget = (st.ms_branch_pages + 3) * st.ms_psize;
+    assert_int_equal(WTREE3_OK, wtree3_tree_warmup(tree, WTREE3_WARMUP_INDEXES, budget, &ws, &error));
+    assert_true(ws.bytes <= budget);
+    assert_true(ws.branch_pages >= st.ms_branch_pages);
+
+    /* Less than a page warms nothing */
+    assert_int_equal(WTREE3_OK, wtree3_tree_warmup(tree, 0, st.ms_psize - 1, &ws, &error));
+    assert_int_equal(ws.bytes, 0);
+
+    wtree3_tree_close(tree);
+}
+
+static void test_warmup_small_and_empty(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = open_warmup_tree("warm_small", 0);
+    wtree3_warmup_stats_t ws;
+    assert_int_equal(WTREE3_OK, wtree3_tree_warmup(tree, WTREE3_WARMUP_INDEXES, 0, &ws, &error));
+    assert_int_equal(ws.branch_pages + ws.leaf_pages, 0);
+
+    /* A single leaf root */
+    assert_int_equal(WTREE3_OK, wtree3_insert_one(tree, "a", 1, "g01-a", 5, &error));
+    assert_int_equal(WTREE3_OK, wtree3_tree_warmup(tree, 0, 0, &ws, &error));
+    assert_int_equal(ws.branch_pages, 0);
+    assert_int_equal(ws.leaf_pages, 1);
+
+    wtree3_tree_close(tree);
+}
+
+static void test_warmup_lock_branches(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = open_warmup_tree("warm_lock", WARMUP_ROWS);
+    wtree3_warmup_stats_t ws;
+    int rc = wtree3_tree_warmup(tree, WTREE3_WARMUP_LOCK_BRANCHES | WTREE3_WARMUP_BRANCHES_ONLY,
+                                0, &ws, &error);
+    if (rc == WTREE3_OK) {
+        assert_true(ws.branch_pages > 0);
+        assert_int_equal(WTREE3_OK, wtree3_db_munlock(test_db, &error));
+    } else {
+        /* Expected without memlock allowance; pages are still prefetched */
+        assert_int_equal(rc, WTREE3_ERROR);
+        printf("Note: locking branch pages failed: %s\n", error.message);
+    }
+
+    wtree3_tree_close(tree);
+}
+
+static void test_warmup_null_tree(void **state) {
+    (void)state;
+
+    gerror_t error = {0};
+    assert_int_equal(WTREE3_EINVAL, wtree3_tree_warmup(NULL, 0, 0, NULL, &error));
+}
+
 /* ============================================================
  * Main Test Runner
  * ============================================================ */
@@ -298,6 +439,13 @@ int main(void) {
         cmocka_unit_test_setup_teardown(test_prefetch_range_clamp, setup_db, teardown_db),
         cmocka_unit_test_setup_teardown(test_prefetch_invalid_offset, setup_db, teardown_db),
         cmocka_unit_test(test_prefetch_null_db),
+
+        /* Tree warmup tests */
+        cmocka_unit_test_setup_teardown(test_warmup_covers_tree_and_indexes, setup_db, teardown_db),
+        cmocka_unit_test_setup_teardown(test_warmup_budget, setup_db, teardown_db),
+        cmocka_unit_test_setup_teardown(test_warmup_small_and_empty, setup_db, teardown_db),
+        cmocka_unit_test_setup_teardown(test_warmup_lock_branches, setup_db, teardown_db),
+        cmocka_unit_test(test_warmup_null_tree),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
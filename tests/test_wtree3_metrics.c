@@ -0,0 +1,371 @@
+/*
+ * test_wtree3_metrics.c - Tests for operation counters and latency histograms
+ *
+ * Tests that:
+ * - Nothing is recorded while metrics are off
+ * - Each CRUD/scan call is counted once under its own operation
+ * - Index maintenance, extraction and unique probes are counted per index
+ * - Commits record their latency and the bytes they wrote
+ * - LMDB errors are counted by kind
+ * - Reset clears the database-wide snapshot
+ * - Invalid parameters and missing indexes are rejected
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+    #include <process.h>
+    #define mkdir(path, mode) _mkdir(path)
+    #define getpid() _getpid()
+#else
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "wtree3.h"
+
+/* Test database path */
+static char test_db_path[256];
+static wtree3_db_t *test_db = NULL;
+
+static bool field_extractor(const void *value, size_t value_len,
+                            void *user_data,
+                            void **out_key, size_t *out_len);
+
+/* ============================================================
+ * Test Fixtures
+ * ============================================================ */
+
+static int setup_db(void **state) {
+    (void)state;
+
+#ifdef _WIN32
+    snprintf(test_db_path, sizeof(test_db_path), "%s\\test_wtree3_metrics_%d",
+             getenv("TEMP"), getpid());
+#else
+    snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_wtree3_metrics_%d", getpid());
+#endif
+    mkdir(test_db_path, 0755);
+
+    gerror_t error = {0};
+    test_db = wtree3_db_open(test_db_path, 64 * 1024 * 1024, 128, WTREE3_VERSION(1, 0), 0, &error);
+    if (!test_db) {
+        fprintf(stderr, "Failed to create test database: %s\n", error.message);
+        return -1;
+    }
+
+    for (uint32_t flags = 0; flags <= 0x03; flags++) {
+        int rc = wtree3_db_register_key_extractor(test_db, WTREE3_VERSION(1, 0), flags,
+                                                  field_extractor, &error);
+        if (rc != WTREE3_OK) {
+            fprintf(stderr, "Failed to register extractor for flags=0x%02x: %s\n", flags, error.message);
+            wtree3_db_close(test_db);
+            test_db = NULL;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int teardown_db(void **state) {
+    (void)state;
+
+    if (test_db) {
+        wtree3_db_close(test_db);
+        test_db = NULL;
+    }
+
+    char cmd[512];
+#ifdef _WIN32
+    snprintf(cmd, sizeof(cmd), "rd /s /q \"%s\"", test_db_path);
+#else
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", test_db_path);
+#endif
+    (void)system(cmd);
+
+    return 0;
+}
+
+/* Index the 3-char prefix of the value */
+static bool field_extractor(const void *value, size_t value_len,
+                            void *user_data,
+                            void **out_key, size_t *out_len) {
+    (void)user_data;
+    if (value_len < 3) return false;
+
+    char *key = malloc(3);
+    if (!key) return false;
+
+    memcpy(key, value, 3);
+    *out_key = key;
+    *out_len = 3;
+    return true;
+}
+
+/* ============================================================
+ * Helpers
+ * ============================================================ */
+
+static void put(wtree3_tree_t *tree, const char *key, const char *value) {
+    gerror_t error = {0};
+    assert_int_equal(WTREE3_OK,
+                     wtree3_insert_one(tree, key, strlen(key), value, strlen(value), &error));
+}
+
+static wtree3_metrics_t snapshot(void) {
+    gerror_t error = {0};
+    wtree3_metrics_t m;
+    assert_int_equal(WTREE3_OK, wtree3_db_metrics(test_db, &m, &error));
+    return m;
+}
+
+static bool count_entry(const void *key, size_t key_len,
+                        const void *value, size_t value_len, void *user_data) {
+    (void)key; (void)key_len; (void)value; (void)value_len;
+    (*(int *)user_data)++;
+    return true;
+}
+
+static void enable(bool on) {
+    gerror_t error = {0};
+    assert_int_equal(WTREE3_OK, wtree3_db_enable_metrics(test_db, on, &error));
+    if (on) wtree3_db_metrics_reset(test_db);
+}
+
+/* ============================================================
+ * Tests
+ * ============================================================ */
+
+static void test_metrics_disabled(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "m_off", 0, 0, &error);
+    assert_non_null(tree);
+    put(tree, "k1", "aaa-1");
+
+    wtree3_metrics_t m = snapshot();
+    for (int op = 0; op < WTREE3_METRIC_COUNT; op++) {
+        assert_int_equal(m.ops[op].count, 0);
+    }
+
+    wtree3_counters_t c;
+    assert_int_equal(WTREE3_OK, wtree3_tree_metrics(tree, NULL, &c, &error));
+    assert_int_equal(c.ops[WTREE3_METRIC_INSERT], 0);
+
+    wtree3_tree_close(tree);
+}
+
+static void test_metrics_crud_counts(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "m_crud", 0, 0, &error);
+    assert_non_null(tree);
+    enable(true);
+
+    put(tree, "k1", "aaa-1");
+    put(tree, "k2", "aaa-2");
+    assert_int_equal(WTREE3_OK, wtree3_update(tree, "k1", 2, "bbb-1", 5, &error));
+    assert_int_equal(WTREE3_OK, wtree3_upsert(tree, "k3", 2, "ccc-3", 5, &error));
+
+    void *value = NULL;
+    size_t value_len = 0;
+    assert_int_equal(WTREE3_OK, wtree3_get(tree, "k1", 2, &value, &value_len, &error));
+    free(value);
+
+    bool deleted = false;
+    assert_int_equal(WTREE3_OK, wtree3_delete_one(tree, "k2", 2, &deleted, &error));
+    assert_true(deleted);
+
+    int seen = 0;
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+    assert_int_equal(WTREE3_OK,
+                     wtree3_scan_range_txn(txn, tree, NULL, 0, NULL, 0, count_entry, &seen, &error));
+    wtree3_txn_abort(txn);
+    assert_int_equal(seen, 2);
+
+    /* Upsert is timed once as UPSERT, not again as INSERT */
+    wtree3_metrics_t m = snapshot();
+    assert_int_equal(m.ops[WTREE3_METRIC_INSERT].count, 2);
+    assert_int_equal(m.ops[WTREE3_METRIC_UPDATE].count, 1);
+    assert_int_equal(m.ops[WTREE3_METRIC_UPSERT].count, 1);
+    assert_int_equal(m.ops[WTREE3_METRIC_DELETE].count, 1);
+    assert_int_equal(m.ops[WTREE3_METRIC_GET].count, 1);
+    assert_int_equal(m.ops[WTREE3_METRIC_SCAN].count, 1);
+
+    /* Percentiles are ordered and bounded by the max */
+    const wtree3_histogram_t *h = &m.ops[WTREE3_METRIC_INSERT];
+    assert_true(h->p50 <= h->p99);
+    assert_true(h->p99 <= h->p999);
+    assert_true(h->p999 <= h->max);
+    assert_true(h->max <= h->sum);
+
+    wtree3_counters_t c;
+    assert_int_equal(WTREE3_OK, wtree3_tree_metrics(tree, NULL, &c, &error));
+    assert_int_equal(c.ops[WTREE3_METRIC_INSERT], 2);
+    assert_int_equal(c.ops[WTREE3_METRIC_GET], 1);
+    assert_int_equal(c.ops[WTREE3_METRIC_SCAN], 1);
+
+    enable(false);
+    wtree3_tree_close(tree);
+}
+
+static void test_metrics_commit_bytes(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "m_commit", 0, 0, &error);
+    assert_non_null(tree);
+    enable(true);
+
+    /* One txn writing 2 + 5 and 2 + 5 bytes */
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(txn);
+    assert_int_equal(WTREE3_OK, wtree3_insert_one_txn(txn, tree, "k1", 2, "aaa-1", 5, &error));
+    assert_int_equal(WTREE3_OK, wtree3_insert_one_txn(txn, tree, "k2", 2, "aaa-2", 5, &error));
+    assert_int_equal(WTREE3_OK, wtree3_txn_commit(txn, &error));
+
+    /* Aborted writes do not leak into the next commit */
+    txn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(txn);
+    assert_int_equal(WTREE3_OK, wtree3_insert_one_txn(txn, tree, "k3", 2, "aaa-3", 5, &error));
+    wtree3_txn_abort(txn);
+
+    put(tree, "k4", "aaa-4");
+
+    wtree3_metrics_t m = snapshot();
+    assert_int_equal(m.ops[WTREE3_METRIC_COMMIT].count, 2);
+    assert_int_equal(m.commit_bytes.count, 2);
+    assert_int_equal(m.commit_bytes.sum, 14 + 7);
+    assert_int_equal(m.commit_bytes.max, 14);
+
+    assert_int_equal(WTREE3_OK, wtree3_db_sync(test_db, true, &error));
+    m = snapshot();
+    assert_int_equal(m.ops[WTREE3_METRIC_SYNC].count, 1);
+
+    enable(false);
+    wtree3_tree_close(tree);
+}
+
+static void test_metrics_index_counters(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "m_index", 0, 0, &error);
+    assert_non_null(tree);
+    wtree3_index_config_t cfg = {.name = "tag_idx", .unique = true};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &cfg, &error));
+    enable(true);
+
+    put(tree, "k1", "aaa-1");
+    put(tree, "k2", "bbb-2");
+    assert_int_equal(WTREE3_OK, wtree3_update(tree, "k1", 2, "ccc-1", 5, &error));
+
+    /* Unique violation: probed, nothing added */
+    assert_int_equal(WTREE3_INDEX_ERROR,
+                     wtree3_insert_one(tree, "k3", 2, "bbb-3", 5, &error));
+
+    bool deleted = false;
+    assert_int_equal(WTREE3_OK, wtree3_delete_one(tree, "k2", 2, &deleted, &error));
+
+    wtree3_counters_t c;
+    assert_int_equal(WTREE3_OK, wtree3_tree_metrics(tree, "tag_idx", &c, &error));
+    assert_int_equal(c.ops[WTREE3_METRIC_INSERT], 3);       /* aaa, bbb, ccc */
+    assert_int_equal(c.ops[WTREE3_METRIC_DELETE], 2);       /* aaa on update, bbb */
+    assert_int_equal(c.ops[WTREE3_METRIC_UNIQUE_CHECK], 4); /* 3 inserts + changed update */
+    assert_true(c.ops[WTREE3_METRIC_EXTRACT] >= 5);
+
+    wtree3_metrics_t m = snapshot();
+    assert_int_equal(m.ops[WTREE3_METRIC_INDEX_MAINT].count, 5);
+
+    enable(false);
+    wtree3_tree_close(tree);
+}
+
+static void test_metrics_errors_and_reset(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "m_errors", 0, 0, &error);
+    assert_non_null(tree);
+    enable(true);
+
+    put(tree, "k1", "aaa-1");
+    assert_int_equal(WTREE3_KEY_EXISTS, wtree3_insert_one(tree, "k1", 2, "aaa-1", 5, &error));
+
+    void *value = NULL;
+    size_t value_len = 0;
+    assert_int_equal(WTREE3_NOT_FOUND, wtree3_get(tree, "zz", 2, &value, &value_len, &error));
+
+    wtree3_metrics_t m = snapshot();
+    assert_true(m.errors[WTREE3_METRIC_ERR_KEY_EXISTS] >= 1);
+    assert_true(m.errors[WTREE3_METRIC_ERR_NOT_FOUND] >= 1);
+
+    wtree3_db_metrics_reset(test_db);
+    m = snapshot();
+    assert_int_equal(m.ops[WTREE3_METRIC_INSERT].count, 0);
+    assert_int_equal(m.ops[WTREE3_METRIC_GET].max, 0);
+    assert_int_equal(m.errors[WTREE3_METRIC_ERR_NOT_FOUND], 0);
+
+    /* Tree counts survive a database-wide reset */
+    wtree3_counters_t c;
+    assert_int_equal(WTREE3_OK, wtree3_tree_metrics(tree, NULL, &c, &error));
+    assert_int_equal(c.ops[WTREE3_METRIC_INSERT], 2);
+
+    /* Disabled databases stop recording */
+    enable(false);
+    assert_int_equal(WTREE3_OK, wtree3_get(tree, "k1", 2, &value, &value_len, &error));
+    free(value);
+    m = snapshot();
+    assert_int_equal(m.ops[WTREE3_METRIC_GET].count, 0);
+
+    wtree3_tree_close(tree);
+}
+
+static void test_metrics_invalid(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "m_invalid", 0, 0, &error);
+    assert_non_null(tree);
+
+    wtree3_metrics_t m;
+    wtree3_counters_t c;
+    assert_int_equal(WTREE3_EINVAL, wtree3_db_enable_metrics(NULL, true, &error));
+    assert_int_equal(WTREE3_EINVAL, wtree3_db_metrics(NULL, &m, &error));
+    assert_int_equal(WTREE3_EINVAL, wtree3_db_metrics(test_db, NULL, &error));
+    assert_int_equal(WTREE3_EINVAL, wtree3_tree_metrics(NULL, NULL, &c, &error));
+    assert_int_equal(WTREE3_EINVAL, wtree3_tree_metrics(tree, NULL, NULL, &error));
+    assert_int_equal(WTREE3_NOT_FOUND, wtree3_tree_metrics(tree, "missing", &c, &error));
+    wtree3_db_metrics_reset(NULL);
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Main
+ * ============================================================ */
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_metrics_disabled),
+        cmocka_unit_test(test_metrics_crud_counts),
+        cmocka_unit_test(test_metrics_commit_bytes),
+        cmocka_unit_test(test_metrics_index_counters),
+        cmocka_unit_test(test_metrics_errors_and_reset),
+        cmocka_unit_test(test_metrics_invalid),
+    };
+
+    return cmocka_run_group_tests(tests, setup_db, teardown_db);
+}
@@ -0,0 +1,359 @@
+/*
+ * test_wtree3_parallel_scan.c - Tests for the parallel partitioned scan
+ *
+ * Tests that wtree3_scan_parallel():
+ * - Visits every entry of the range exactly once, across all workers
+ * - Reduces partials in key order
+ * - Honors inclusive start/end bounds at partition edges
+ * - Falls back to a single inline scan for small trees
+ * - Reads one consistent snapshot while a writer commits concurrently
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+    #include <process.h>
+    #define mkdir(path, mode) _mkdir(path)
+    #define getpid() _getpid()
+#else
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "wtree3.h"
+#include "wthread.h"
+
+#define ROW_COUNT 20000
+#define SCAN_THREADS 4
+
+/* Test database path */
+static char test_db_path[256];
+static wtree3_db_t *test_db = NULL;
+
+/* ============================================================
+ * Test Fixtures
+ * ============================================================ */
+
+static int setup_db(void **state) {
+    (void)state;
+
+#ifdef _WIN32
+    snprintf(test_db_path, sizeof(test_db_path), "%s\\test_wtree3_parallel_scan_%d",
+             getenv("TEMP"), getpid());
+#else
+    snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_wtree3_parallel_scan_%d", getpid());
+#endif
+    mkdir(test_db_path, 0755);
+
+    gerror_t error = {0};
+    test_db = wtree3_db_open(test_db_path, 128 * 1024 * 1024, 128, WTREE3_VERSION(1, 0), 0, &error);
+    if (!test_db) {
+        fprintf(stderr, "Failed to create test database: %s\n", error.message);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int teardown_db(void **state) {
+    (void)state;
+
+    if (test_db) {
+        wtree3_db_close(test_db);
+        test_db = NULL;
+    }
+
+    char cmd[512];
+#ifdef _WIN32
+    snprintf(cmd, sizeof(cmd), "rd /s /q \"%s\"", test_db_path);
+#else
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", test_db_path);
+#endif
+    (void)system(cmd);
+
+    return 0;
+}
+
+/* ============================================================
+ * Helpers
+ * ============================================================ */
+
+/* Keys "k000000".."k019999", value = row number */
+static wtree3_tree_t *create_filled_tree(const char *name, int rows) {
+    gerror_t error = {0};
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, name, 0, 0, &error);
+    assert_non_null(tree);
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(txn);
+
+    char key[16];
+    for (int i = 0; i < rows; i++) {
+        uint64_t value = (uint64_t)i;
+        snprintf(key, sizeof(key), "k%06d", i);
+        assert_int_equal(WTREE3_OK,
+                         wtree3_insert_one_txn(txn, tree, key, strlen(key),
+                                               &value, sizeof(value), &error));
+    }
+    assert_int_equal(WTREE3_OK, wtree3_txn_commit(txn, &error));
+    return tree;
+}
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum;
+    int64_t min_row;
+    int64_t max_row;
+} sum_partial_t;
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t partitions;
+    int64_t last_max;              /* max_row of the previous partition */
+    bool ordered;
+} sum_result_t;
+
+static bool sum_rows(const void *key, size_t key_len,
+                     const void *value, size_t value_len,
+                     void *user_data) {
+    (void)key;
+    (void)key_len;
+
+    /* Runs on worker threads - no cmocka asserts here */
+    sum_partial_t *p = (sum_partial_t *)user_data;
+    uint64_t row = 0;
+    memcpy(&row, value, value_len < sizeof(row) ? value_len : sizeof(row));
+
+    if (p->count == 0) p->min_row = (int64_t)row;
+    p->max_row = (int64_t)row;
+    p->count++;
+    p->sum += row;
+    return true;
+}
+
+static void reduce_sums(void *partial, void *user_data) {
+    const sum_partial_t *p = (const sum_partial_t *)partial;
+    sum_result_t *r = (sum_result_t *)user_data;
+
+    r->partitions++;
+    if (p->count == 0) return;
+    if (p->min_row <= r->last_max) r->ordered = false;
+    r->last_max = p->max_row;
+    r->count += p->count;
+    r->sum += p->sum;
+}
+
+static sum_result_t run_sum(wtree3_tree_t *tree,
+                            const char *start, const char *end,
+                            unsigned int threads) {
+    gerror_t error = {0};
+    sum_result_t result = {.last_max = -1, .ordered = true};
+    wtree3_parallel_scan_opts_t opts = {.threads = threads,
+                                        .partial_size = sizeof(sum_partial_t)};
+
+    int rc = wtree3_scan_parallel(tree,
+                                  start, start ? strlen(start) : 0,
+                                  end, end ? strlen(end) : 0,
+                                  &opts, sum_rows, reduce_sums, &result, &error);
+    assert_int_equal(rc, WTREE3_OK);
+    return result;
+}
+
+/* ============================================================
+ * Coverage and Ordering
+ * ============================================================ */
+
+static void test_parallel_full_scan(void **state) {
+    (void)state;
+
+    wtree3_tree_t *tree = create_filled_tree("pscan_full", ROW_COUNT);
+
+    sum_result_t r = run_sum(tree, NULL, NULL, SCAN_THREADS);
+    assert_true(r.partitions > 1);
+    assert_true(r.partitions <= SCAN_THREADS);
+    assert_true(r.ordered);
+    assert_int_equal(r.count, ROW_COUNT);
+    assert_int_equal(r.sum, (uint64_t)ROW_COUNT * (ROW_COUNT - 1) / 2);
+
+    wtree3_tree_close(tree);
+}
+
+static void test_parallel_bounded_scan(void **state) {
+    (void)state;
+
+    wtree3_tree_t *tree = create_filled_tree("pscan_bounds", ROW_COUNT);
+
+    /* Both bounds are inclusive: rows 1000..15000 */
+    sum_result_t r = run_sum(tree, "k001000", "k015000", SCAN_THREADS);
+    assert_true(r.ordered);
+    assert_int_equal(r.count, 14001);
+    assert_int_equal(r.sum, (uint64_t)(1000 + 15000) * 14001 / 2);
+
+    /* Bounds that are not keys themselves */
+    r = run_sum(tree, "k0010005", "k0150005", SCAN_THREADS);
+    assert_int_equal(r.count, 14000);
+
+    /* Empty range */
+    r = run_sum(tree, "x", NULL, SCAN_THREADS);
+    assert_int_equal(r.count, 0);
+
+    wtree3_tree_close(tree);
+}
+
+static void test_parallel_small_tree_inline(void **state) {
+    (void)state;
+
+    wtree3_tree_t *tree = create_filled_tree("pscan_small", 10);
+
+    /* Too few rows to be worth splitting: one partition */
+    sum_result_t r = run_sum(tree, NULL, NULL, 8);
+    assert_int_equal(r.partitions, 1);
+    assert_int_equal(r.count, 10);
+    assert_int_equal(r.sum, 45);
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Snapshot Consistency
+ * ============================================================ */
+
+typedef struct {
+    wtree3_tree_t *tree;
+    volatile bool stop;
+    int committed;
+    int failures;
+} writer_ctx_t;
+
+/* Each commit adds one key at each end of the key space */
+static void *writer_thread(void *arg) {
+    writer_ctx_t *ctx = (writer_ctx_t *)arg;
+    gerror_t error = {0};
+    char key[16];
+
+    while (!ctx->stop && ctx->committed < 2000) {
+        uint64_t value = 0;
+        wtree3_txn_t *txn = wtree3_txn_begin(test_db, true, &error);
+        if (!txn) {
+            ctx->failures++;
+            break;
+        }
+
+        snprintf(key, sizeof(key), "a%06d", ctx->committed);
+        int rc = wtree3_insert_one_txn(txn, ctx->tree, key, strlen(key),
+                                       &value, sizeof(value), &error);
+        snprintf(key, sizeof(key), "z%06d", ctx->committed);
+        if (rc == 0) {
+            rc = wtree3_insert_one_txn(txn, ctx->tree, key, strlen(key),
+                                       &value, sizeof(value), &error);
+        }
+        if (rc == 0) rc = wtree3_txn_commit(txn, &error);
+        else wtree3_txn_abort(txn);
+
+        if (rc != 0) {
+            ctx->failures++;
+            break;
+        }
+        ctx->committed++;
+    }
+    return NULL;
+}
+
+typedef struct {
+    uint64_t a_keys;
+    uint64_t z_keys;
+} edge_partial_t;
+
+static bool count_edges(const void *key, size_t key_len,
+                        const void *value, size_t value_len,
+                        void *user_data) {
+    (void)key_len;
+    (void)value;
+    (void)value_len;
+
+    edge_partial_t *p = (edge_partial_t *)user_data;
+    char c = *(const char *)key;
+    if (c == 'a') p->a_keys++;
+    if (c == 'z') p->z_keys++;
+    return true;
+}
+
+static void reduce_edges(void *partial, void *user_data) {
+    const edge_partial_t *p = (const edge_partial_t *)partial;
+    edge_partial_t *total = (edge_partial_t *)user_data;
+    total->a_keys += p->a_keys;
+    total->z_keys += p->z_keys;
+}
+
+static void test_parallel_single_snapshot(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = create_filled_tree("pscan_snapshot", ROW_COUNT);
+
+    writer_ctx_t ctx = {.tree = tree};
+    wthread_t writer;
+    assert_int_equal(0, wthread_create(&writer, writer_thread, &ctx));
+
+    /* The first and last partitions see the same commits, or none */
+    wtree3_parallel_scan_opts_t opts = {.threads = SCAN_THREADS,
+                                        .partial_size = sizeof(edge_partial_t)};
+    for (int round = 0; round < 20; round++) {
+        edge_partial_t total = {0};
+        int rc = wtree3_scan_parallel(tree, NULL, 0, NULL, 0, &opts,
+                                      count_edges, reduce_edges, &total, &error);
+        assert_int_equal(rc, WTREE3_OK);
+        assert_int_equal(total.a_keys, total.z_keys);
+    }
+
+    ctx.stop = true;
+    assert_int_equal(0, wthread_join(writer, NULL));
+    assert_int_equal(0, ctx.failures);
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Error Cases
+ * ============================================================ */
+
+static void test_parallel_null_params(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = create_filled_tree("pscan_null", 10);
+
+    assert_int_equal(WTREE3_EINVAL,
+                     wtree3_scan_parallel(NULL, NULL, 0, NULL, 0, NULL,
+                                          sum_rows, NULL, NULL, &error));
+    assert_int_equal(WTREE3_EINVAL,
+                     wtree3_scan_parallel(tree, NULL, 0, NULL, 0, NULL,
+                                          NULL, NULL, NULL, &error));
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Main
+ * ============================================================ */
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_parallel_full_scan),
+        cmocka_unit_test(test_parallel_bounded_scan),
+        cmocka_unit_test(test_parallel_small_tree_inline),
+        cmocka_unit_test(test_parallel_single_snapshot),
+        cmocka_unit_test(test_parallel_null_params),
+    };
+
+    return cmocka_run_group_tests(tests, setup_db, teardown_db);
+}
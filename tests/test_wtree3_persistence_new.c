@@ -9,6 +9,7 @@
  * - load_index_metadata (wtree3_index_persist.c)
  * - wtree3_tree_list_persisted_indexes (wtree3_index_persist.c)
  * - wtree3_index_get_extractor_id (wtree3_index_persist.c)
+ * - wtree3_tree_count / wtree3_tree_count_txn across reopen and aborts
  */
 
 #include <stdarg.h>
@@ -471,6 +472,72 @@ static void test_persistence_different_flag_combinations(void **state) {
     wtree3_tree_close(tree);
 }
 
+/* ============================================================
+ * Entry Counts
+ * ============================================================ */
+
+static void test_entry_count_persisted(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "counted", 0, 0, &error);
+    assert_non_null(tree);
+
+    for (int i = 0; i < 10; i++) {
+        int rc = wtree3_insert_one(tree, &i, sizeof(i), "v", 1, &error);
+        assert_int_equal(rc, WTREE3_OK);
+    }
+    /* Upserting a new key counts too */
+    int extra = 99;
+    assert_int_equal(WTREE3_OK, wtree3_upsert(tree, &extra, sizeof(extra), "v", 1, &error));
+    assert_int_equal(wtree3_tree_count(tree), 11);
+
+    /* Aborted delete: visible inside the txn only */
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(txn);
+    int first = 0;
+    bool deleted = false;
+    assert_int_equal(WTREE3_OK,
+                     wtree3_delete_one_txn(txn, tree, &first, sizeof(first), &deleted, &error));
+    assert_true(deleted);
+    assert_int_equal(wtree3_tree_count_txn(txn, tree), 10);
+    wtree3_txn_abort(txn);
+    assert_int_equal(wtree3_tree_count(tree), 11);
+    wtree3_tree_close(tree);
+
+    /* Reopen the environment; a stale entry_count argument is ignored */
+    wtree3_db_close(test_db);
+    test_db = wtree3_db_open(test_db_path, 64 * 1024 * 1024, 32, TEST_VERSION, 0, &error);
+    assert_non_null(test_db);
+    tree = wtree3_tree_open(test_db, "counted", 0, 12345, &error);
+    assert_non_null(tree);
+    assert_int_equal(wtree3_tree_count(tree), 11);
+
+    wtree3_tree_close(tree);
+}
+
+static void test_entry_count_shared_handles(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    /* Two handles on one tree, as two processes sharing the env would have */
+    wtree3_tree_t *a = wtree3_tree_open(test_db, "shared", 0, 0, &error);
+    wtree3_tree_t *b = wtree3_tree_open(test_db, "shared", 0, 0, &error);
+    assert_non_null(a);
+    assert_non_null(b);
+
+    assert_int_equal(WTREE3_OK, wtree3_insert_one(a, "x", 1, "1", 1, &error));
+    assert_int_equal(WTREE3_OK, wtree3_insert_one(b, "y", 1, "2", 1, &error));
+    assert_int_equal(wtree3_tree_count(a), 2);
+    assert_int_equal(wtree3_tree_count(b), 2);
+
+    assert_int_equal(wtree3_tree_count(NULL), 0);
+    assert_int_equal(wtree3_tree_count_txn(NULL, a), 0);
+
+    wtree3_tree_close(a);
+    wtree3_tree_close(b);
+}
+
 /* ============================================================
  * Main Test Suite
  * ============================================================ */
@@ -483,6 +550,8 @@ int main(void) {
         cmocka_unit_test_setup_teardown(test_persistence_with_user_data, setup_db, teardown_db),
         cmocka_unit_test_setup_teardown(test_drop_index_removes_metadata, setup_db, teardown_db),
         cmocka_unit_test_setup_teardown(test_persistence_different_flag_combinations, setup_db, teardown_db),
+        cmocka_unit_test_setup_teardown(test_entry_count_persisted, setup_db, teardown_db),
+        cmocka_unit_test_setup_teardown(test_entry_count_shared_handles, setup_db, teardown_db),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
@@ -0,0 +1,363 @@
+/*
+ * test_wtree3_read_pool.c - Tests for the read transaction pool
+ *
+ * Tests that auto-transaction reads served from recycled txns:
+ * - Always see the latest committed data (renewed snapshot)
+ * - Reuse cached cursors safely, including after a DBI slot is reused
+ *   by a database of a different shape
+ * - Keep working with the pool resized, disabled and across db_resize
+ * - Stay correct with many reader threads and a concurrent writer
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+    #include <process.h>
+    #define mkdir(path, mode) _mkdir(path)
+    #define getpid() _getpid()
+#else
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "wtree3.h"
+#include "wthread.h"
+
+#define THREAD_COUNT 8
+#define READS_PER_THREAD 2000
+#define ROW_COUNT 100
+
+/* Test database path */
+static char test_db_path[256];
+static wtree3_db_t *test_db = NULL;
+
+static bool prefix_key_extractor(const void *value, size_t value_len,
+                                 void *user_data,
+                                 void **out_key, size_t *out_len);
+
+/* ============================================================
+ * Test Fixtures
+ * ============================================================ */
+
+static int setup_db(void **state) {
+    (void)state;
+
+#ifdef _WIN32
+    snprintf(test_db_path, sizeof(test_db_path), "%s\\test_wtree3_read_pool_%d",
+             getenv("TEMP"), getpid());
+#else
+    snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_wtree3_read_pool_%d", getpid());
+#endif
+    mkdir(test_db_path, 0755);
+
+    gerror_t error = {0};
+    test_db = wtree3_db_open(test_db_path, 64 * 1024 * 1024, 128, WTREE3_VERSION(1, 0), 0, &error);
+    if (!test_db) {
+        fprintf(stderr, "Failed to create test database: %s\n", error.message);
+        return -1;
+    }
+
+    for (uint32_t flags = 0; flags <= 0x03; flags++) {
+        int rc = wtree3_db_register_key_extractor(test_db, WTREE3_VERSION(1, 0), flags,
+                                                  prefix_key_extractor, &error);
+        if (rc != WTREE3_OK) {
+            fprintf(stderr, "Failed to register extractor for flags=0x%02x: %s\n", flags, error.message);
+            wtree3_db_close(test_db);
+            test_db = NULL;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int teardown_db(void **state) {
+    (void)state;
+
+    if (test_db) {
+        wtree3_db_close(test_db);
+        test_db = NULL;
+    }
+
+    char cmd[512];
+#ifdef _WIN32
+    snprintf(cmd, sizeof(cmd), "rd /s /q \"%s\"", test_db_path);
+#else
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", test_db_path);
+#endif
+    (void)system(cmd);
+
+    return 0;
+}
+
+/* Extract first 3 chars as index key */
+static bool prefix_key_extractor(const void *value, size_t value_len,
+                                 void *user_data,
+                                 void **out_key, size_t *out_len) {
+    (void)user_data;
+
+    size_t key_len = (value_len < 3) ? value_len : 3;
+    char *key = malloc(key_len);
+    if (!key) return false;
+
+    memcpy(key, value, key_len);
+    *out_key = key;
+    *out_len = key_len;
+    return true;
+}
+
+/* ============================================================
+ * Helpers
+ * ============================================================ */
+
+static wtree3_tree_t *create_filled_tree(const char *name, bool with_index) {
+    gerror_t error = {0};
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, name, 0, 0, &error);
+    assert_non_null(tree);
+
+    if (with_index) {
+        wtree3_index_config_t config = {.name = "prefix_idx"};
+        assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &config, &error));
+    }
+
+    char key[32], value[32];
+    for (int i = 0; i < ROW_COUNT; i++) {
+        snprintf(key, sizeof(key), "k%04d", i);
+        snprintf(value, sizeof(value), "g%02d-%04d", i % 10, i);
+        assert_int_equal(WTREE3_OK,
+                         wtree3_insert_one(tree, key, strlen(key), value, strlen(value), &error));
+    }
+    return tree;
+}
+
+static int count_iterator(wtree3_tree_t *tree) {
+    gerror_t error = {0};
+    wtree3_iterator_t *iter = wtree3_iterator_create(tree, &error);
+    assert_non_null(iter);
+
+    int n = 0;
+    for (bool ok = wtree3_iterator_first(iter); ok; ok = wtree3_iterator_next(iter)) n++;
+    wtree3_iterator_close(iter);
+    return n;
+}
+
+static int count_index_group(wtree3_tree_t *tree, const char *group) {
+    gerror_t error = {0};
+    wtree3_iterator_t *iter = wtree3_index_seek(tree, "prefix_idx", group, 3, &error);
+    assert_non_null(iter);
+
+    int n = 0;
+    while (wtree3_iterator_valid(iter)) {
+        const void *k;
+        size_t k_len;
+        assert_true(wtree3_iterator_key(iter, &k, &k_len));
+        if (k_len != 3 || memcmp(k, group, 3) != 0) break;
+        n++;
+        if (!wtree3_iterator_next(iter)) break;
+    }
+    wtree3_iterator_close(iter);
+    return n;
+}
+
+/* ============================================================
+ * Snapshot Freshness
+ * ============================================================ */
+
+static void test_pooled_reads_see_latest_commit(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = create_filled_tree("pool_fresh", true);
+
+    for (int round = 0; round < 50; round++) {
+        char key[32], value[32];
+        snprintf(key, sizeof(key), "new%04d", round);
+        snprintf(value, sizeof(value), "g%02d-new", round % 10);
+
+        /* Warm the pool, then write, then read again through the pool */
+        assert_false(wtree3_exists(tree, key, strlen(key), &error));
+        assert_int_equal(ROW_COUNT + round, count_iterator(tree));
+
+        assert_int_equal(WTREE3_OK,
+                         wtree3_insert_one(tree, key, strlen(key), value, strlen(value), &error));
+
+        assert_true(wtree3_exists(tree, key, strlen(key), &error));
+        void *got = NULL;
+        size_t got_len = 0;
+        assert_int_equal(WTREE3_OK, wtree3_get(tree, key, strlen(key), &got, &got_len, &error));
+        assert_int_equal(strlen(value), got_len);
+        assert_memory_equal(value, got, got_len);
+        free(got);
+
+        assert_int_equal(ROW_COUNT + round + 1, count_iterator(tree));
+    }
+
+    /* 10 originals per group plus 5 new rows per group */
+    assert_int_equal(15, count_index_group(tree, "g03"));
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Cursor Cache
+ * ============================================================ */
+
+static void test_cursor_cache_survives_dbi_reuse(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *keep = create_filled_tree("pool_keep", false);
+    wtree3_tree_t *doomed = create_filled_tree("pool_doomed", false);
+
+    /* Cache a cursor for the doomed tree's (non-DUPSORT) DBI */
+    assert_int_equal(ROW_COUNT, count_iterator(doomed));
+    wtree3_tree_close(doomed);
+    assert_int_equal(WTREE3_OK, wtree3_tree_delete(test_db, "pool_doomed", &error));
+
+    /* The freed DBI slot is likely reused by this DUPSORT index DB */
+    wtree3_index_config_t config = {.name = "prefix_idx"};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(keep, &config, &error));
+    assert_int_equal(WTREE3_OK, wtree3_tree_populate_index(keep, "prefix_idx", &error));
+
+    for (int i = 0; i < 10; i++) {
+        assert_int_equal(10, count_index_group(keep, "g07"));
+        assert_int_equal(ROW_COUNT, count_iterator(keep));
+    }
+
+    wtree3_tree_close(keep);
+}
+
+/* ============================================================
+ * Configuration
+ * ============================================================ */
+
+static void test_pool_resize_and_disable(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    assert_int_equal(WTREE3_EINVAL, wtree3_db_set_read_pool_size(NULL, 4, &error));
+
+    wtree3_tree_t *tree = create_filled_tree("pool_config", true);
+    assert_int_equal(ROW_COUNT, count_iterator(tree));
+
+    assert_int_equal(WTREE3_OK, wtree3_db_set_read_pool_size(test_db, 1, &error));
+    assert_int_equal(ROW_COUNT, count_iterator(tree));
+    assert_int_equal(10, count_index_group(tree, "g01"));
+
+    /* Disabled: every read begins and ends its own txn */
+    assert_int_equal(WTREE3_OK, wtree3_db_set_read_pool_size(test_db, 0, &error));
+    assert_int_equal(ROW_COUNT, count_iterator(tree));
+    assert_true(wtree3_exists(tree, "k0001", 5, &error));
+
+    assert_int_equal(WTREE3_OK, wtree3_db_set_read_pool_size(test_db, 32, &error));
+    assert_int_equal(ROW_COUNT, count_iterator(tree));
+
+    /* Resizing the map drains idle txns first */
+    size_t mapsize = wtree3_db_get_mapsize(test_db);
+    assert_int_equal(WTREE3_OK, wtree3_db_resize(test_db, mapsize * 2, &error));
+    assert_int_equal(ROW_COUNT, count_iterator(tree));
+    assert_true(wtree3_exists(tree, "k0099", 5, &error));
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Concurrent Readers
+ * ============================================================ */
+
+typedef struct {
+    wtree3_tree_t *tree;
+    int thread_id;
+    int failures;
+} reader_ctx_t;
+
+static void *reader_thread(void *arg) {
+    reader_ctx_t *ctx = (reader_ctx_t *)arg;
+    gerror_t error = {0};
+    char key[32];
+
+    for (int i = 0; i < READS_PER_THREAD; i++) {
+        int row = (i * 7 + ctx->thread_id) % ROW_COUNT;
+        snprintf(key, sizeof(key), "k%04d", row);
+
+        void *value = NULL;
+        size_t value_len = 0;
+        if (wtree3_get(ctx->tree, key, strlen(key), &value, &value_len, &error) != WTREE3_OK) {
+            ctx->failures++;
+            continue;
+        }
+        free(value);
+
+        if (i % 100 == 0) {
+            wtree3_iterator_t *iter = wtree3_index_seek(ctx->tree, "prefix_idx", "g05", 3, &error);
+            if (!iter || !wtree3_iterator_valid(iter)) ctx->failures++;
+            wtree3_iterator_close(iter);
+        }
+    }
+    return NULL;
+}
+
+static void *writer_thread(void *arg) {
+    reader_ctx_t *ctx = (reader_ctx_t *)arg;
+    gerror_t error = {0};
+    char key[32], value[32];
+
+    for (int i = 0; i < 200; i++) {
+        snprintf(key, sizeof(key), "w%04d", i);
+        snprintf(value, sizeof(value), "g%02d-w", i % 10);
+        if (wtree3_insert_one(ctx->tree, key, strlen(key), value, strlen(value), &error) != WTREE3_OK) {
+            ctx->failures++;
+        }
+    }
+    return NULL;
+}
+
+static void test_pool_concurrent_readers(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = create_filled_tree("pool_threads", true);
+    assert_int_equal(WTREE3_OK, wtree3_db_set_read_pool_size(test_db, 4, &error));
+
+    wthread_t threads[THREAD_COUNT + 1];
+    reader_ctx_t ctx[THREAD_COUNT + 1];
+    for (int t = 0; t < THREAD_COUNT; t++) {
+        ctx[t] = (reader_ctx_t){.tree = tree, .thread_id = t};
+        assert_int_equal(0, wthread_create(&threads[t], reader_thread, &ctx[t]));
+    }
+    ctx[THREAD_COUNT] = (reader_ctx_t){.tree = tree, .thread_id = THREAD_COUNT};
+    assert_int_equal(0, wthread_create(&threads[THREAD_COUNT], writer_thread, &ctx[THREAD_COUNT]));
+
+    for (int t = 0; t <= THREAD_COUNT; t++) {
+        assert_int_equal(0, wthread_join(threads[t], NULL));
+        assert_int_equal(0, ctx[t].failures);
+    }
+
+    assert_int_equal(ROW_COUNT + 200, wtree3_tree_count(tree));
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Main
+ * ============================================================ */
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_pooled_reads_see_latest_commit),
+        cmocka_unit_test(test_cursor_cache_survives_dbi_reuse),
+        cmocka_unit_test(test_pool_resize_and_disable),
+        cmocka_unit_test(test_pool_concurrent_readers),
+    };
+
+    return cmocka_run_group_tests(tests, setup_db, teardown_db);
+}
@@ -0,0 +1,405 @@
+/*
+ * test_wtree3_reserve.c - Tests for reserved (serialize in place) inserts
+ *
+ * Tests that:
+ * - A value written into a reservation is stored and indexed on commit
+ * - Duplicate keys are refused up front and leave nothing pending
+ * - Other writes and the txn commit are refused while a reservation is
+ *   pending, and the uncommitted row never becomes visible
+ * - A unique index violation found on commit removes the reserved row
+ * - Codec trees refuse reservations
+ * - Index entries stay correct when the index writes of commit_reserved
+ *   spill dirty pages, the reserved value's overflow pages included
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+    #include <process.h>
+    #define mkdir(path, mode) _mkdir(path)
+    #define getpid() _getpid()
+#else
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "wtree3.h"
+
+/* Test database path */
+static char test_db_path[256];
+static wtree3_db_t *test_db = NULL;
+
+static bool prefix_extractor(const void *value, size_t value_len,
+                             void *user_data,
+                             void **out_key, size_t *out_len);
+
+/* ============================================================
+ * Test Fixtures
+ * ============================================================ */
+
+static int setup_db(void **state) {
+    (void)state;
+
+#ifdef _WIN32
+    snprintf(test_db_path, sizeof(test_db_path), "%s\\test_wtree3_reserve_%d",
+             getenv("TEMP"), getpid());
+#else
+    snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_wtree3_reserve_%d", getpid());
+#endif
+    mkdir(test_db_path, 0755);
+
+    gerror_t error = {0};
+    test_db = wtree3_db_open(test_db_path, 128 * 1024 * 1024, 128, WTREE3_VERSION(1, 0), 0, &error);
+    if (!test_db) {
+        fprintf(stderr, "Failed to create test database: %s\n", error.message);
+        return -1;
+    }
+
+    for (uint32_t flags = 0; flags <= 0x03; flags++) {
+        int rc = wtree3_db_register_key_extractor(test_db, WTREE3_VERSION(1, 0), flags,
+                                                  prefix_extractor, &error);
+        if (rc != WTREE3_OK) {
+            fprintf(stderr, "Failed to register extractor for flags=0x%02x: %s\n", flags, error.message);
+            wtree3_db_close(test_db);
+            test_db = NULL;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int teardown_db(void **state) {
+    (void)state;
+
+    if (test_db) {
+        wtree3_db_close(test_db);
+        test_db = NULL;
+    }
+
+    char cmd[512];
+#ifdef _WIN32
+    snprintf(cmd, sizeof(cmd), "rd /s /q \"%s\"", test_db_path);
+#else
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", test_db_path);
+#endif
+    (void)system(cmd);
+
+    return 0;
+}
+
+/* Index the value up to its first '|' (the whole value if there is none) */
+static bool prefix_extractor(const void *value, size_t value_len,
+                             void *user_data,
+                             void **out_key, size_t *out_len) {
+    (void)user_data;
+    const char *bar = memchr(value, '|', value_len);
+    size_t len = bar ? (size_t)(bar - (const char *)value) : value_len;
+    if (len == 0) return false;
+
+    char *key = malloc(len);
+    if (!key) return false;
+
+    memcpy(key, value, len);
+    *out_key = key;
+    *out_len = len;
+    return true;
+}
+
+/* ============================================================
+ * Reserve and Commit
+ * ============================================================ */
+
+static void test_reserve_commit(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "reserve_basic", 0, 0, &error);
+    assert_non_null(tree);
+    wtree3_index_config_t group = {.name = "group_idx"};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &group, &error));
+
+    /* Large records are the point: 16 KB, serialized straight into the page */
+    const size_t len = 16 * 1024;
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(txn);
+    for (int i = 0; i < 8; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "rec:%02d", i);
+
+        void *p = NULL;
+        assert_int_equal(WTREE3_OK, wtree3_reserve_txn(txn, tree, key, strlen(key), len, &p, &error));
+        assert_non_null(p);
+        memset(p, 'a' + i, len);
+        memcpy(p, i % 2 ? "odd|" : "even|", i % 2 ? 4 : 5);
+        assert_int_equal(WTREE3_OK, wtree3_commit_reserved(txn, &error));
+    }
+    assert_int_equal(WTREE3_OK, wtree3_txn_commit(txn, &error));
+
+    assert_int_equal(8, wtree3_tree_count(tree));
+
+    void *value;
+    size_t value_len;
+    assert_int_equal(WTREE3_OK, wtree3_get(tree, "rec:03", 6, &value, &value_len, &error));
+    assert_int_equal(len, value_len);
+    assert_memory_equal("odd|", value, 4);
+    assert_int_equal('a' + 3, ((char *)value)[len - 1]);
+    free(value);
+
+    wtree3_iterator_t *iter = wtree3_index_seek(tree, "group_idx", "even", 4, &error);
+    assert_non_null(iter);
+    int found = 0;
+    while (wtree3_iterator_valid(iter)) {
+        const void *ik;
+        size_t ik_len;
+        assert_true(wtree3_iterator_key(iter, &ik, &ik_len));
+        if (ik_len != 4 || memcmp(ik, "even", 4) != 0) break;
+        found++;
+        wtree3_iterator_next(iter);
+    }
+    wtree3_iterator_close(iter);
+    assert_int_equal(4, found);
+
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+    wtree3_tree_close(tree);
+}
+
+static void test_reserve_duplicate_key(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "reserve_dup", 0, 0, &error);
+    assert_non_null(tree);
+    assert_int_equal(WTREE3_OK, wtree3_insert_one(tree, "k", 1, "old|v", 5, &error));
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(txn);
+    void *p = (void *)1;
+    assert_int_equal(WTREE3_KEY_EXISTS, wtree3_reserve_txn(txn, tree, "k", 1, 8, &p, &error));
+    assert_null(p);
+
+    /* Nothing pending: the txn keeps working and commits */
+    assert_int_equal(WTREE3_EINVAL, wtree3_commit_reserved(txn, &error));
+    assert_int_equal(WTREE3_OK, wtree3_upsert_txn(txn, tree, "k2", 2, "new|v", 5, &error));
+    assert_int_equal(WTREE3_OK, wtree3_txn_commit(txn, &error));
+
+    assert_int_equal(2, wtree3_tree_count(tree));
+    wtree3_tree_close(tree);
+}
+
+static void test_reserve_pending_blocks_writes(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "reserve_pending", 0, 0, &error);
+    assert_non_null(tree);
+    wtree3_index_config_t group = {.name = "group_idx"};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &group, &error));
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(txn);
+    void *p;
+    assert_int_equal(WTREE3_OK, wtree3_reserve_txn(txn, tree, "a", 1, 6, &p, &error));
+    memcpy(p, "grp|xx", 6);
+
+    assert_int_equal(WTREE3_EINVAL, wtree3_insert_one_txn(txn, tree, "b", 1, "grp|yy", 6, &error));
+    assert_int_equal(WTREE3_EINVAL, wtree3_reserve_txn(txn, tree, "c", 1, 6, &p, &error));
+
+    /* Committing with the reservation open aborts the txn */
+    assert_int_equal(WTREE3_EINVAL, wtree3_txn_commit(txn, &error));
+
+    assert_int_equal(0, wtree3_tree_count(tree));
+    assert_false(wtree3_exists(tree, "a", 1, &error));
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+    wtree3_tree_close(tree);
+}
+
+static void test_reserve_unique_violation(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "reserve_unique", 0, 0, &error);
+    assert_non_null(tree);
+    wtree3_index_config_t uniq = {.name = "uniq_idx", .unique = true};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &uniq, &error));
+    assert_int_equal(WTREE3_OK, wtree3_insert_one(tree, "k1", 2, "taken|1", 7, &error));
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(txn);
+    void *p;
+    assert_int_equal(WTREE3_OK, wtree3_reserve_txn(txn, tree, "k2", 2, 7, &p, &error));
+    memcpy(p, "taken|2", 7);
+    assert_int_equal(WTREE3_INDEX_ERROR, wtree3_commit_reserved(txn, &error));
+
+    /* The reserved row is gone again and the txn takes other writes */
+    assert_false(wtree3_exists_txn(txn, tree, "k2", 2, &error));
+    assert_int_equal(WTREE3_OK, wtree3_insert_one_txn(txn, tree, "k3", 2, "free|3", 6, &error));
+    assert_int_equal(WTREE3_OK, wtree3_txn_commit(txn, &error));
+
+    assert_int_equal(2, wtree3_tree_count(tree));
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+    wtree3_tree_close(tree);
+}
+
+static void test_reserve_codec_tree(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "reserve_codec", 0, 0, &error);
+    assert_non_null(tree);
+    assert_int_equal(WTREE3_OK, wtree3_tree_set_codec(tree, &(wtree3_codec_config_t){0}, &error));
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(txn);
+    void *p;
+    assert_int_equal(WTREE3_EINVAL, wtree3_reserve_txn(txn, tree, "k", 1, 128, &p, &error));
+    assert_int_equal(WTREE3_OK, wtree3_txn_commit(txn, &error));
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Spilling Transactions
+ * ============================================================ */
+
+/*
+ * Enough 32 KB reservations in one txn to run past LMDB's dirty page
+ * budget (MDB_IDL_UM_MAX pages, 512 MB with 4 KB pages). After that the
+ * index puts in commit_reserved spill dirty pages - newest first, so the
+ * reserved value's own overflow pages are among them. Every index must
+ * still match its row.
+ */
+#define SPILL_ROWS      20000
+#define SPILL_VALUE_LEN (32 * 1024)
+#define SPILL_MAP_SIZE  ((size_t)1536 * 1024 * 1024)
+
+/* Index field N of a '|'-separated value (N from user_data, default 0) */
+static bool field_extractor(const void *value, size_t value_len,
+                            void *user_data,
+                            void **out_key, size_t *out_len) {
+    int field = user_data ? *(const char *)user_data - '0' : 0;
+    const char *p = (const char *)value;
+    const char *end = p + value_len;
+    for (; field > 0; field--) {
+        const char *bar = memchr(p, '|', (size_t)(end - p));
+        if (!bar) return false;
+        p = bar + 1;
+    }
+    const char *bar = memchr(p, '|', (size_t)(end - p));
+    size_t len = bar ? (size_t)(bar - p) : (size_t)(end - p);
+    if (len == 0) return false;
+
+    char *key = malloc(len);
+    if (!key) return false;
+
+    memcpy(key, p, len);
+    *out_key = key;
+    *out_len = len;
+    return true;
+}
+
+static void test_reserve_spilling_txn(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    char path[300];
+    snprintf(path, sizeof(path), "%s_spill", test_db_path);
+    mkdir(path, 0755);
+    wtree3_db_t *db = wtree3_db_open(path, SPILL_MAP_SIZE, 16, WTREE3_VERSION(1, 0), 0, &error);
+    assert_non_null(db);
+    for (uint32_t flags = 0; flags <= 0x03; flags++) {
+        assert_int_equal(WTREE3_OK, wtree3_db_register_key_extractor(db, WTREE3_VERSION(1, 0), flags,
+                                                                     field_extractor, &error));
+    }
+
+    wtree3_tree_t *tree = wtree3_tree_open(db, "records", 0, 0, &error);
+    assert_non_null(tree);
+    wtree3_index_config_t ids = {.name = "id_idx", .user_data = "0", .user_data_len = 2,
+                                 .unique = true};
+    wtree3_index_config_t groups = {.name = "group_idx", .user_data = "1", .user_data_len = 2};
+    wtree3_index_config_t shards = {.name = "shard_idx", .user_data = "2", .user_data_len = 2};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &ids, &error));
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &groups, &error));
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &shards, &error));
+
+    wtree3_txn_t *txn = wtree3_txn_begin(db, true, &error);
+    assert_non_null(txn);
+    for (int i = 0; i < SPILL_ROWS; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "rec:%05d", i);
+
+        void *p = NULL;
+        assert_int_equal(WTREE3_OK, wtree3_reserve_txn(txn, tree, key, strlen(key),
+                                                       SPILL_VALUE_LEN, &p, &error));
+        memset(p, 'a' + i % 26, SPILL_VALUE_LEN);
+        char head[32];
+        int n = snprintf(head, sizeof(head), "id%05d|g%03d|s%02d|", i, i % 1000, i % 50);
+        memcpy(p, head, (size_t)n);
+        assert_int_equal(WTREE3_OK, wtree3_commit_reserved(txn, &error));
+    }
+    assert_int_equal(WTREE3_OK, wtree3_txn_commit(txn, &error));
+
+    assert_int_equal(SPILL_ROWS, wtree3_tree_count(tree));
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+
+    /* Spot checks: the unique id leads back to its own row */
+    for (int i = 0; i < SPILL_ROWS; i += 997) {
+        char id[16], key[16];
+        snprintf(id, sizeof(id), "id%05d", i);
+        snprintf(key, sizeof(key), "rec:%05d", i);
+
+        wtree3_iterator_t *iter = wtree3_index_seek(tree, "id_idx", id, strlen(id), &error);
+        assert_non_null(iter);
+        assert_true(wtree3_iterator_valid(iter));
+        const void *mk;
+        size_t mk_len;
+        assert_true(wtree3_index_iterator_main_key(iter, &mk, &mk_len));
+        assert_int_equal(strlen(key), mk_len);
+        assert_memory_equal(key, mk, mk_len);
+        wtree3_iterator_close(iter);
+
+        void *value;
+        size_t value_len;
+        assert_int_equal(WTREE3_OK, wtree3_get(tree, key, strlen(key), &value, &value_len, &error));
+        assert_int_equal(SPILL_VALUE_LEN, value_len);
+        assert_memory_equal(id, value, strlen(id));
+        assert_int_equal('a' + i % 26, ((char *)value)[value_len - 1]);
+        free(value);
+    }
+
+    wtree3_tree_close(tree);
+    wtree3_db_close(db);
+
+    char cmd[512];
+#ifdef _WIN32
+    snprintf(cmd, sizeof(cmd), "rd /s /q \"%s\"", path);
+#else
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", path);
+#endif
+    (void)system(cmd);
+}
+
+/* ============================================================
+ * Main
+ * ============================================================ */
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_reserve_commit),
+        cmocka_unit_test(test_reserve_duplicate_key),
+        cmocka_unit_test(test_reserve_pending_blocks_writes),
+        cmocka_unit_test(test_reserve_unique_violation),
+        cmocka_unit_test(test_reserve_codec_tree),
+        cmocka_unit_test(test_reserve_spilling_txn),
+    };
+
+    return cmocka_run_group_tests(tests, setup_db, teardown_db);
+}
@@ -0,0 +1,554 @@
+/*
+ * test_wtree3_shard.c - Tests for sharded databases
+ *
+ * Tests that:
+ * - Keys land on the shard wtree3_sharded_shard_of() names and point
+ *   operations find them there
+ * - Merged scans return every shard's keys in one ascending stream,
+ *   range layouts skip shards outside the range
+ * - Range layouts over integer keys, which route bytewise, scan every
+ *   shard and still find each key in range
+ * - Parallel scans see every entry once and stop when asked
+ * - Index scans fan out and merge by index key
+ * - Writers on different shards run concurrently
+ * - The layout is stored, reused with shards = 0 and checked on reopen
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <process.h>
+    #define getpid() _getpid()
+#else
+    #include <unistd.h>
+#endif
+
+#include "wtree3.h"
+#include "wthread.h"
+
+#define SHARDS 4
+#define ROWS 400
+
+static char test_db_path[256];
+
+static bool prefix_extractor(const void *value, size_t value_len,
+                             void *user_data,
+                             void **out_key, size_t *out_len);
+
+/* ============================================================
+ * Test Fixtures
+ * ============================================================ */
+
+static int setup_path(void **state) {
+    (void)state;
+    static int run = 0;
+#ifdef _WIN32
+    snprintf(test_db_path, sizeof(test_db_path), "%s\\test_wtree3_shard_%d_%d",
+             getenv("TEMP"), getpid(), run++);
+#else
+    snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_wtree3_shard_%d_%d", getpid(), run++);
+#endif
+    return 0;
+}
+
+static int teardown_path(void **state) {
+    (void)state;
+    char cmd[512];
+#ifdef _WIN32
+    snprintf(cmd, sizeof(cmd), "rd /s /q \"%s\"", test_db_path);
+#else
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", test_db_path);
+#endif
+    (void)system(cmd);
+    return 0;
+}
+
+static wtree3_sharded_db_t *open_hash(size_t shards, gerror_t *error) {
+    wtree3_shard_config_t config = {
+        .shards = shards,
+        .mode = WTREE3_SHARD_HASH,
+        .mapsize = 32 * 1024 * 1024,
+        .max_dbs = 16,
+        .version = WTREE3_VERSION(1, 0),
+    };
+    return wtree3_sharded_db_open(test_db_path, &config, error);
+}
+
+/* Index the value up to its first '|' */
+static bool prefix_extractor(const void *value, size_t value_len,
+                             void *user_data,
+                             void **out_key, size_t *out_len) {
+    (void)user_data;
+    const char *bar = memchr(value, '|', value_len);
+    size_t len = bar ? (size_t)(bar - (const char *)value) : value_len;
+    if (len == 0) return false;
+
+    char *key = malloc(len);
+    if (!key) return false;
+    memcpy(key, value, len);
+    *out_key = key;
+    *out_len = len;
+    return true;
+}
+
+static void fill(wtree3_sharded_tree_t *st, int rows) {
+    gerror_t error = {0};
+    for (int i = 0; i < rows; i++) {
+        char key[16], value[32];
+        snprintf(key, sizeof(key), "k%05d", i);
+        int len = snprintf(value, sizeof(value), "g%02d|row-%d", i % 10, i);
+        assert_int_equal(WTREE3_OK, wtree3_sharded_insert_one(st, key, strlen(key),
+                                                              value, (size_t)len, &error));
+    }
+}
+
+/* Collects keys and checks they ascend */
+typedef struct {
+    int count;
+    int out_of_order;
+    char last[32];
+    int stop_after;                 /* 0 = never stop */
+} collect_ctx_t;
+
+static bool collect_keys(const void *key, size_t key_len, const void *value,
+                         size_t value_len, void *user_data) {
+    (void)value;
+    (void)value_len;
+    collect_ctx_t *ctx = (collect_ctx_t *)user_data;
+    char cur[32];
+    snprintf(cur, sizeof(cur), "%.*s", (int)key_len, (const char *)key);
+    if (ctx->count > 0 && strcmp(ctx->last, cur) >= 0) ctx->out_of_order++;
+    memcpy(ctx->last, cur, sizeof(cur));
+    ctx->count++;
+    return ctx->stop_after == 0 || ctx->count < ctx->stop_after;
+}
+
+/* ============================================================
+ * Routing and Point Operations
+ * ============================================================ */
+
+static void test_point_ops_route(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_sharded_db_t *sdb = open_hash(SHARDS, &error);
+    assert_non_null(sdb);
+    assert_int_equal(SHARDS, wtree3_sharded_db_count(sdb));
+    assert_null(wtree3_sharded_db_shard(sdb, SHARDS));
+
+    wtree3_sharded_tree_t *st = wtree3_sharded_tree_open(sdb, "items", 0, &error);
+    assert_non_null(st);
+    fill(st, ROWS);
+    assert_int_equal(ROWS, wtree3_sharded_tree_count(st));
+
+    /* Each key is on its shard and nowhere else, and every shard got some */
+    int64_t per_shard = 0;
+    for (size_t s = 0; s < SHARDS; s++) {
+        int64_t n = wtree3_tree_count(wtree3_sharded_tree_shard(st, s));
+        assert_true(n > 0);
+        per_shard += n;
+    }
+    assert_int_equal(ROWS, per_shard);
+
+    for (int i = 0; i < ROWS; i += 37) {
+        char key[16];
+        snprintf(key, sizeof(key), "k%05d", i);
+        size_t home = wtree3_sharded_shard_of(sdb, key, strlen(key));
+        for (size_t s = 0; s < SHARDS; s++) {
+            bool there = wtree3_exists(wtree3_sharded_tree_shard(st, s), key, strlen(key), &error);
+            assert_int_equal(s == home, there);
+        }
+
+        void *value = NULL;
+        size_t value_len = 0;
+        assert_int_equal(WTREE3_OK, wtree3_sharded_get(st, key, strlen(key), &value, &value_len, &error));
+        assert_memory_equal("g", value, 1);
+        free(value);
+    }
+
+    assert_int_equal(WTREE3_KEY_EXISTS, wtree3_sharded_insert_one(st, "k00001", 6, "x", 1, &error));
+    assert_int_equal(WTREE3_OK, wtree3_sharded_update(st, "k00001", 6, "g99|new", 7, &error));
+    assert_int_equal(WTREE3_OK, wtree3_sharded_upsert(st, "z", 1, "g00|z", 5, &error));
+    bool deleted = false;
+    assert_int_equal(WTREE3_OK, wtree3_sharded_delete_one(st, "k00002", 6, &deleted, &error));
+    assert_true(deleted);
+    assert_false(wtree3_sharded_exists(st, "k00002", 6, &error));
+    assert_true(wtree3_sharded_exists(st, "z", 1, &error));
+    assert_int_equal(ROWS, wtree3_sharded_tree_count(st));
+
+    wtree3_sharded_tree_close(st);
+    wtree3_sharded_db_close(sdb);
+}
+
+/* ============================================================
+ * Scans
+ * ============================================================ */
+
+static void test_merged_scan(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_sharded_db_t *sdb = open_hash(SHARDS, &error);
+    assert_non_null(sdb);
+    wtree3_sharded_tree_t *st = wtree3_sharded_tree_open(sdb, "items", 0, &error);
+    assert_non_null(st);
+    fill(st, ROWS);
+
+    collect_ctx_t all = {0};
+    assert_int_equal(WTREE3_OK, wtree3_sharded_scan_range(st, NULL, 0, NULL, 0,
+                                                          collect_keys, &all, &error));
+    assert_int_equal(ROWS, all.count);
+    assert_int_equal(0, all.out_of_order);
+
+    /* Inclusive bounds */
+    collect_ctx_t some = {0};
+    assert_int_equal(WTREE3_OK, wtree3_sharded_scan_range(st, "k00100", 6, "k00199", 6,
+                                                          collect_keys, &some, &error));
+    assert_int_equal(100, some.count);
+    assert_int_equal(0, some.out_of_order);
+    assert_string_equal("k00199", some.last);
+
+    collect_ctx_t stopped = {.stop_after = 10};
+    assert_int_equal(WTREE3_OK, wtree3_sharded_scan_range(st, NULL, 0, NULL, 0,
+                                                          collect_keys, &stopped, &error));
+    assert_int_equal(10, stopped.count);
+    assert_string_equal("k00009", stopped.last);
+
+    wtree3_sharded_tree_close(st);
+    wtree3_sharded_db_close(sdb);
+}
+
+typedef struct {
+    uint64_t count;
+    uint64_t stop_at;               /* 0 = never stop */
+} par_ctx_t;
+
+static bool count_entry(const void *key, size_t key_len, const void *value,
+                        size_t value_len, void *user_data) {
+    (void)key;
+    (void)key_len;
+    (void)value;
+    (void)value_len;
+    par_ctx_t *ctx = (par_ctx_t *)user_data;
+    watomic_add_u64(&ctx->count, 1);
+    return ctx->stop_at == 0 || watomic_load_u64(&ctx->count) < ctx->stop_at;
+}
+
+static void test_parallel_scan(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_sharded_db_t *sdb = open_hash(SHARDS, &error);
+    assert_non_null(sdb);
+    wtree3_sharded_tree_t *st = wtree3_sharded_tree_open(sdb, "items", 0, &error);
+    assert_non_null(st);
+    fill(st, ROWS);
+
+    par_ctx_t all = {0};
+    assert_int_equal(WTREE3_OK, wtree3_sharded_scan_parallel(st, NULL, 0, NULL, 0,
+                                                             count_entry, &all, &error));
+    assert_int_equal(ROWS, all.count);
+
+    /* Stopping is best effort across threads, but well short of everything */
+    par_ctx_t early = {.stop_at = 5};
+    assert_int_equal(WTREE3_OK, wtree3_sharded_scan_parallel(st, NULL, 0, NULL, 0,
+                                                             count_entry, &early, &error));
+    assert_true(early.count >= 5 && early.count < ROWS);
+
+    wtree3_sharded_tree_close(st);
+    wtree3_sharded_db_close(sdb);
+}
+
+typedef struct {
+    int count;
+    int bad_group;
+    int out_of_order;
+    char last_group[8];
+} group_ctx_t;
+
+static bool collect_group(const void *key, size_t key_len, const void *value,
+                          size_t value_len, void *user_data) {
+    (void)key;
+    (void)key_len;
+    group_ctx_t *ctx = (group_ctx_t *)user_data;
+    char group[8];
+    snprintf(group, sizeof(group), "%.*s", value_len < 3 ? (int)value_len : 3, (const char *)value);
+    if (strcmp(group, "g03") < 0 || strcmp(group, "g05") > 0) ctx->bad_group++;
+    if (ctx->count > 0 && strcmp(ctx->last_group, group) > 0) ctx->out_of_order++;
+    memcpy(ctx->last_group, group, sizeof(group));
+    ctx->count++;
+    return true;
+}
+
+static void test_index_scan(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_sharded_db_t *sdb = open_hash(SHARDS, &error);
+    assert_non_null(sdb);
+    assert_int_equal(WTREE3_OK, wtree3_sharded_db_register_key_extractor(
+        sdb, WTREE3_VERSION(1, 0), 0x00, prefix_extractor, &error));
+
+    wtree3_sharded_tree_t *st = wtree3_sharded_tree_open(sdb, "items", 0, &error);
+    assert_non_null(st);
+    wtree3_index_config_t group = {.name = "group_idx"};
+    assert_int_equal(WTREE3_OK, wtree3_sharded_tree_add_index(st, &group, &error));
+    fill(st, ROWS);
+
+    group_ctx_t ctx = {0};
+    assert_int_equal(WTREE3_OK, wtree3_sharded_index_scan(st, "group_idx", "g03", 3, "g05", 3,
+                                                          collect_group, &ctx, &error));
+    assert_int_equal(3 * ROWS / 10, ctx.count);
+    assert_int_equal(0, ctx.bad_group);
+    assert_int_equal(0, ctx.out_of_order);
+
+    assert_int_equal(WTREE3_NOT_FOUND, wtree3_sharded_index_scan(st, "nope_idx", NULL, 0, NULL, 0,
+                                                                 collect_group, &ctx, &error));
+
+    /* Dropped everywhere */
+    assert_int_equal(WTREE3_OK, wtree3_sharded_tree_drop_index(st, "group_idx", &error));
+    for (size_t s = 0; s < SHARDS; s++) {
+        assert_false(wtree3_tree_has_index(wtree3_sharded_tree_shard(st, s), "group_idx"));
+    }
+
+    wtree3_sharded_tree_close(st);
+    wtree3_sharded_db_close(sdb);
+}
+
+/* ============================================================
+ * Range Layout
+ * ============================================================ */
+
+static void test_range_layout(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    MDB_val splits[2] = {
+        {.mv_size = 6, .mv_data = "k00100"},
+        {.mv_size = 6, .mv_data = "k00300"},
+    };
+    wtree3_shard_config_t config = {
+        .shards = 3,
+        .mode = WTREE3_SHARD_RANGE,
+        .splits = splits,
+        .mapsize = 32 * 1024 * 1024,
+        .max_dbs = 16,
+        .version = WTREE3_VERSION(1, 0),
+    };
+    wtree3_sharded_db_t *sdb = wtree3_sharded_db_open(test_db_path, &config, &error);
+    assert_non_null(sdb);
+
+    assert_int_equal(0, wtree3_sharded_shard_of(sdb, "k00099", 6));
+    assert_int_equal(1, wtree3_sharded_shard_of(sdb, "k00100", 6));
+    assert_int_equal(1, wtree3_sharded_shard_of(sdb, "k00299", 6));
+    assert_int_equal(2, wtree3_sharded_shard_of(sdb, "k00300", 6));
+    assert_int_equal(0, wtree3_sharded_shard_of(sdb, "a", 1));
+
+    wtree3_sharded_tree_t *st = wtree3_sharded_tree_open(sdb, "items", 0, &error);
+    assert_non_null(st);
+    fill(st, ROWS);
+    assert_int_equal(100, wtree3_tree_count(wtree3_sharded_tree_shard(st, 0)));
+    assert_int_equal(200, wtree3_tree_count(wtree3_sharded_tree_shard(st, 1)));
+    assert_int_equal(100, wtree3_tree_count(wtree3_sharded_tree_shard(st, 2)));
+
+    collect_ctx_t span = {0};
+    assert_int_equal(WTREE3_OK, wtree3_sharded_scan_range(st, "k00050", 6, "k00349", 6,
+                                                          collect_keys, &span, &error));
+    assert_int_equal(300, span.count);
+    assert_int_equal(0, span.out_of_order);
+
+    wtree3_sharded_tree_close(st);
+    wtree3_sharded_db_close(sdb);
+
+    /* Descending splits are refused */
+    MDB_val bad[2] = { splits[1], splits[0] };
+    config.splits = bad;
+    char other[300];
+    snprintf(other, sizeof(other), "%s_bad", test_db_path);
+    assert_null(wtree3_sharded_db_open(other, &config, &error));
+    assert_int_equal(WTREE3_EINVAL, error.code);
+    char cmd[512];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", other);
+    (void)system(cmd);
+}
+
+/* Counts uint32_t keys and checks they ascend numerically */
+typedef struct {
+    int count;
+    int out_of_order;
+    uint32_t last;
+    bool saw_256;
+} int_ctx_t;
+
+static bool collect_ints(const void *key, size_t key_len, const void *value,
+                         size_t value_len, void *user_data) {
+    (void)value;
+    (void)value_len;
+    int_ctx_t *ctx = (int_ctx_t *)user_data;
+    uint32_t k;
+    assert_int_equal(sizeof(k), key_len);
+    memcpy(&k, key, sizeof(k));
+    if (ctx->count > 0 && k <= ctx->last) ctx->out_of_order++;
+    if (k == 256) ctx->saw_256 = true;
+    ctx->last = k;
+    ctx->count++;
+    return true;
+}
+
+static void test_range_layout_integer_keys(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    /* Split at 100 in native (little-endian) bytes: 256 = 00 01 00 00
+     * sorts bytewise before 100 = 64 00 00 00 and routes to shard 0 */
+    uint32_t split = 100;
+    MDB_val splits[1] = {{.mv_size = sizeof(split), .mv_data = &split}};
+    wtree3_shard_config_t config = {
+        .shards = 2,
+        .mode = WTREE3_SHARD_RANGE,
+        .splits = splits,
+        .mapsize = 32 * 1024 * 1024,
+        .max_dbs = 16,
+        .version = WTREE3_VERSION(1, 0),
+    };
+    wtree3_sharded_db_t *sdb = wtree3_sharded_db_open(test_db_path, &config, &error);
+    assert_non_null(sdb);
+    uint32_t k256 = 256;
+    if (wtree3_sharded_shard_of(sdb, &k256, sizeof(k256)) != 0) {   /* Big-endian host */
+        wtree3_sharded_db_close(sdb);
+        skip();
+    }
+
+    wtree3_sharded_tree_t *st = wtree3_sharded_tree_open(sdb, "ints", MDB_INTEGERKEY, &error);
+    assert_non_null(st);
+    for (uint32_t k = 0; k < ROWS; k++) {
+        assert_int_equal(WTREE3_OK, wtree3_sharded_insert_one(st, &k, sizeof(k), "v", 1, &error));
+    }
+
+    uint32_t lo = 200, hi = 300;
+    int_ctx_t merged = {0};
+    assert_int_equal(WTREE3_OK, wtree3_sharded_scan_range(st, &lo, sizeof(lo), &hi, sizeof(hi),
+                                                          collect_ints, &merged, &error));
+    assert_int_equal(101, merged.count);
+    assert_int_equal(0, merged.out_of_order);
+    assert_true(merged.saw_256);
+
+    par_ctx_t parallel = {0};
+    assert_int_equal(WTREE3_OK, wtree3_sharded_scan_parallel(st, &lo, sizeof(lo), &hi, sizeof(hi),
+                                                             count_entry, &parallel, &error));
+    assert_int_equal(101, parallel.count);
+
+    wtree3_sharded_tree_close(st);
+    wtree3_sharded_db_close(sdb);
+}
+
+/* ============================================================
+ * Layout Persistence
+ * ============================================================ */
+
+static void test_layout_reopen(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_sharded_db_t *sdb = open_hash(SHARDS, &error);
+    assert_non_null(sdb);
+    wtree3_sharded_tree_t *st = wtree3_sharded_tree_open(sdb, "items", 0, &error);
+    assert_non_null(st);
+    fill(st, 50);
+    wtree3_sharded_tree_close(st);
+    wtree3_sharded_db_close(sdb);
+
+    /* A different shard count would misroute every key */
+    assert_null(open_hash(SHARDS + 1, &error));
+    assert_int_equal(WTREE3_EINVAL, error.code);
+
+    /* shards = 0 takes the stored layout */
+    sdb = open_hash(0, &error);
+    assert_non_null(sdb);
+    assert_int_equal(SHARDS, wtree3_sharded_db_count(sdb));
+    st = wtree3_sharded_tree_open(sdb, "items", 0, &error);
+    assert_non_null(st);
+    assert_int_equal(50, wtree3_sharded_tree_count(st));
+    assert_true(wtree3_sharded_exists(st, "k00042", 6, &error));
+    wtree3_sharded_tree_close(st);
+    wtree3_sharded_db_close(sdb);
+}
+
+/* ============================================================
+ * Concurrent Writers
+ * ============================================================ */
+
+#define WRITERS SHARDS
+#define WRITER_OPS 500
+
+typedef struct {
+    wtree3_sharded_tree_t *st;
+    int id;
+    int failures;
+} writer_ctx_t;
+
+static void *writer_thread(void *arg) {
+    writer_ctx_t *ctx = (writer_ctx_t *)arg;
+    gerror_t error = {0};
+    for (int i = 0; i < WRITER_OPS; i++) {
+        char key[32], value[32];
+        snprintf(key, sizeof(key), "w%d:%05d", ctx->id, i);
+        int len = snprintf(value, sizeof(value), "g%02d|w", i % 10);
+        if (wtree3_sharded_upsert(ctx->st, key, strlen(key), value, (size_t)len, &error) != WTREE3_OK) {
+            ctx->failures++;
+        }
+    }
+    return NULL;
+}
+
+static void test_concurrent_writers(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_sharded_db_t *sdb = open_hash(SHARDS, &error);
+    assert_non_null(sdb);
+    wtree3_sharded_tree_t *st = wtree3_sharded_tree_open(sdb, "items", 0, &error);
+    assert_non_null(st);
+
+    wthread_t threads[WRITERS];
+    writer_ctx_t ctx[WRITERS];
+    for (int t = 0; t < WRITERS; t++) {
+        ctx[t] = (writer_ctx_t){.st = st, .id = t};
+        assert_int_equal(0, wthread_create(&threads[t], writer_thread, &ctx[t]));
+    }
+    for (int t = 0; t < WRITERS; t++) {
+        assert_int_equal(0, wthread_join(threads[t], NULL));
+        assert_int_equal(0, ctx[t].failures);
+    }
+
+    assert_int_equal(WRITERS * WRITER_OPS, wtree3_sharded_tree_count(st));
+
+    wtree3_sharded_tree_close(st);
+    wtree3_sharded_db_close(sdb);
+}
+
+/* ============================================================
+ * Main
+ * ============================================================ */
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_point_ops_route, setup_path, teardown_path),
+        cmocka_unit_test_setup_teardown(test_merged_scan, setup_path, teardown_path),
+        cmocka_unit_test_setup_teardown(test_parallel_scan, setup_path, teardown_path),
+        cmocka_unit_test_setup_teardown(test_index_scan, setup_path, teardown_path),
+        cmocka_unit_test_setup_teardown(test_range_layout, setup_path, teardown_path),
+        cmocka_unit_test_setup_teardown(test_range_layout_integer_keys, setup_path, teardown_path),
+        cmocka_unit_test_setup_teardown(test_layout_reopen, setup_path, teardown_path),
+        cmocka_unit_test_setup_teardown(test_concurrent_writers, setup_path, teardown_path),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,476 @@
+/*
+ * test_wtree3_snapshot.c - Tests for streaming tree snapshots
+ *
+ * Tests that:
+ * - Export/import round-trips rows, index entries and metadata, with and
+ *   without block compression
+ * - Indexes exported without entries, or imported with
+ *   WTREE3_SNAPSHOT_REBUILD_INDEXES, are rebuilt and verify
+ * - Compressed trees stay compressed and read back the original values
+ * - Truncated or corrupt streams and existing targets are rejected and
+ *   leave nothing behind
+ * - A failing write callback aborts the export
+ * - wtree3_db_copy() produces an environment that opens with the same data
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+    #include <process.h>
+    #define mkdir(path, mode) _mkdir(path)
+    #define getpid() _getpid()
+#else
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "wtree3.h"
+
+/* Test database path */
+static char test_db_path[256];
+static char copy_db_path[256];
+static wtree3_db_t *test_db = NULL;
+
+static bool prefix_extractor(const void *value, size_t value_len,
+                             void *user_data,
+                             void **out_key, size_t *out_len);
+
+/* ============================================================
+ * Test Fixtures
+ * ============================================================ */
+
+static wtree3_db_t *open_db(const char *path) {
+    gerror_t error = {0};
+    wtree3_db_t *db = wtree3_db_open(path, 64 * 1024 * 1024, 128, WTREE3_VERSION(1, 0), 0, &error);
+    if (!db) {
+        fprintf(stderr, "Failed to open database %s: %s\n", path, error.message);
+        return NULL;
+    }
+
+    for (uint32_t flags = 0; flags <= 0x03; flags++) {
+        int rc = wtree3_db_register_key_extractor(db, WTREE3_VERSION(1, 0), flags,
+                                                  prefix_extractor, &error);
+        if (rc != WTREE3_OK) {
+            fprintf(stderr, "Failed to register extractor for flags=0x%02x: %s\n", flags, error.message);
+            wtree3_db_close(db);
+            return NULL;
+        }
+    }
+    return db;
+}
+
+static void remove_dir(const char *path) {
+    char cmd[512];
+#ifdef _WIN32
+    snprintf(cmd, sizeof(cmd), "rd /s /q \"%s\"", path);
+#else
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", path);
+#endif
+    (void)system(cmd);
+}
+
+static int setup_db(void **state) {
+    (void)state;
+
+#ifdef _WIN32
+    snprintf(test_db_path, sizeof(test_db_path), "%s\\test_wtree3_snapshot_%d",
+             getenv("TEMP"), getpid());
+    snprintf(copy_db_path, sizeof(copy_db_path), "%s\\test_wtree3_snapshot_copy_%d",
+             getenv("TEMP"), getpid());
+#else
+    snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_wtree3_snapshot_%d", getpid());
+    snprintf(copy_db_path, sizeof(copy_db_path), "/tmp/test_wtree3_snapshot_copy_%d", getpid());
+#endif
+    mkdir(test_db_path, 0755);
+
+    test_db = open_db(test_db_path);
+    return test_db ? 0 : -1;
+}
+
+static int teardown_db(void **state) {
+    (void)state;
+
+    if (test_db) {
+        wtree3_db_close(test_db);
+        test_db = NULL;
+    }
+    remove_dir(test_db_path);
+    remove_dir(copy_db_path);
+    return 0;
+}
+
+/* Index the first 8 bytes of the value */
+static bool prefix_extractor(const void *value, size_t value_len,
+                             void *user_data,
+                             void **out_key, size_t *out_len) {
+    (void)user_data;
+    if (value_len < 8) return false;
+
+    char *key = malloc(8);
+    if (!key) return false;
+
+    memcpy(key, value, 8);
+    *out_key = key;
+    *out_len = 8;
+    return true;
+}
+
+/* ============================================================
+ * Helpers
+ * ============================================================ */
+
+/* Growable in-memory stream */
+typedef struct {
+    unsigned char *data;
+    size_t len;
+    size_t cap;
+    size_t pos;          /* Read position */
+    size_t fail_after;   /* Writer fails once len would pass this (0 = never) */
+} membuf_t;
+
+static int mem_write(const void *data, size_t len, void *user_data) {
+    membuf_t *buf = (membuf_t *)user_data;
+    if (buf->fail_after && buf->len + len > buf->fail_after) return -1;
+    if (buf->len + len > buf->cap) {
+        size_t cap = buf->cap ? buf->cap : 4096;
+        while (cap < buf->len + len) cap *= 2;
+        unsigned char *grown = realloc(buf->data, cap);
+        if (!grown) return -1;
+        buf->data = grown;
+        buf->cap = cap;
+    }
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    return 0;
+}
+
+static int mem_read(void *out, size_t len, void *user_data) {
+    membuf_t *buf = (membuf_t *)user_data;
+    if (len > buf->len - buf->pos) return -1;
+    memcpy(out, buf->data + buf->pos, len);
+    buf->pos += len;
+    return 0;
+}
+
+static void membuf_free(membuf_t *buf) {
+    free(buf->data);
+    memset(buf, 0, sizeof(*buf));
+}
+
+/* Row i: key "k00000", value "g000000N" (N = i % 10) + repetitive filler */
+static size_t make_value(int i, char *buf, size_t cap) {
+    size_t len = (size_t)(i % 5 == 0 ? 12 : 100 + (i % 7) * 60);
+    if (len > cap) len = cap;
+    snprintf(buf, cap, "g%07d", i % 10);
+    for (size_t p = 8; p < len; p++) buf[p] = "status=active;"[(p + (size_t)i) % 14];
+    return len;
+}
+
+static wtree3_tree_t *create_source(const char *name, int rows, bool compressed) {
+    gerror_t error = {0};
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, name, 0, 0, &error);
+    assert_non_null(tree);
+
+    if (compressed) {
+        wtree3_codec_config_t codec = {0};
+        assert_int_equal(WTREE3_OK, wtree3_tree_set_codec(tree, &codec, &error));
+    }
+
+    wtree3_index_config_t cfg = {.name = "group_idx"};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &cfg, &error));
+
+    char key[16], value[1024];
+    for (int i = 0; i < rows; i++) {
+        snprintf(key, sizeof(key), "k%05d", i);
+        size_t len = make_value(i, value, sizeof(value));
+        assert_int_equal(WTREE3_OK, wtree3_insert_one(tree, key, strlen(key), value, len, &error));
+    }
+    return tree;
+}
+
+static size_t index_hits(wtree3_tree_t *tree, const char *group) {
+    gerror_t error = {0};
+    wtree3_iterator_t *iter = wtree3_index_seek(tree, "group_idx", group, 8, &error);
+    if (!iter) return 0;
+    size_t hits = 0;
+    while (wtree3_iterator_valid(iter)) {
+        const void *k;
+        size_t klen;
+        if (!wtree3_iterator_key(iter, &k, &klen) || klen != 8 || memcmp(k, group, 8) != 0) break;
+        hits++;
+        wtree3_iterator_next(iter);
+    }
+    wtree3_iterator_close(iter);
+    return hits;
+}
+
+/* Every row of a tree created by create_source(name, rows, ...) */
+static void assert_rows(wtree3_tree_t *tree, int rows) {
+    gerror_t error = {0};
+    assert_int_equal(wtree3_tree_count(tree), rows);
+
+    char key[16], expect[1024];
+    for (int i = 0; i < rows; i++) {
+        snprintf(key, sizeof(key), "k%05d", i);
+        void *value = NULL;
+        size_t value_len = 0;
+        assert_int_equal(WTREE3_OK, wtree3_get(tree, key, strlen(key), &value, &value_len, &error));
+        size_t len = make_value(i, expect, sizeof(expect));
+        assert_int_equal(value_len, len);
+        assert_memory_equal(value, expect, len);
+        free(value);
+    }
+
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+    assert_int_equal(index_hits(tree, "g0000003"), (size_t)(rows / 10));
+}
+
+static void export_tree(wtree3_tree_t *tree, unsigned int flags, membuf_t *buf) {
+    gerror_t error = {0};
+    assert_int_equal(WTREE3_OK, wtree3_tree_export(tree, flags, mem_write, buf, &error));
+    assert_true(buf->len > 0);
+}
+
+static wtree3_tree_t *import_tree(const char *name, unsigned int flags, membuf_t *buf) {
+    gerror_t error = {0};
+    buf->pos = 0;
+    wtree3_tree_t *tree = wtree3_tree_import(test_db, name, flags, mem_read, buf, &error);
+    if (!tree) fprintf(stderr, "Import failed: %s\n", error.message);
+    assert_non_null(tree);
+    assert_int_equal(buf->pos, buf->len);
+    return tree;
+}
+
+/* ============================================================
+ * Round Trips
+ * ============================================================ */
+
+static void test_snapshot_roundtrip(void **state) {
+    (void)state;
+
+    wtree3_tree_t *src = create_source("s_src", 1200, false);
+    membuf_t buf = {0};
+    export_tree(src, 0, &buf);
+
+    wtree3_tree_t *copy = import_tree("s_copy", 0, &buf);
+    assert_rows(copy, 1200);
+
+    /* The import stands on its own: writes keep both in step */
+    gerror_t error = {0};
+    char value[1024];
+    size_t len = make_value(3, value, sizeof(value));
+    assert_int_equal(WTREE3_OK, wtree3_insert_one(copy, "k99999", 6, value, len, &error));
+    assert_int_equal(index_hits(copy, "g0000003"), 121);
+    assert_int_equal(index_hits(src, "g0000003"), 120);
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(copy, &error));
+
+    /* And survives a reopen */
+    wtree3_tree_close(copy);
+    copy = wtree3_tree_open(test_db, "s_copy", 0, 0, &error);
+    assert_non_null(copy);
+    assert_int_equal(wtree3_tree_count(copy), 1201);
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(copy, &error));
+
+    wtree3_tree_close(copy);
+    wtree3_tree_close(src);
+    membuf_free(&buf);
+}
+
+static void test_snapshot_compressed_blocks(void **state) {
+    (void)state;
+
+    wtree3_tree_t *src = create_source("s_zsrc", 1000, false);
+    membuf_t plain = {0}, packed = {0};
+    export_tree(src, 0, &plain);
+    export_tree(src, WTREE3_SNAPSHOT_COMPRESS, &packed);
+
+    /* Repetitive rows shrink a lot */
+    assert_true(packed.len < plain.len / 2);
+
+    wtree3_tree_t *copy = import_tree("s_zcopy", 0, &packed);
+    assert_rows(copy, 1000);
+
+    wtree3_tree_close(copy);
+    wtree3_tree_close(src);
+    membuf_free(&plain);
+    membuf_free(&packed);
+}
+
+static void test_snapshot_codec_tree(void **state) {
+    (void)state;
+
+    /* Values travel as stored, the codec record travels with them */
+    wtree3_tree_t *src = create_source("s_csrc", 500, true);
+    membuf_t buf = {0};
+    export_tree(src, 0, &buf);
+
+    wtree3_tree_t *copy = import_tree("s_ccopy", 0, &buf);
+    assert_rows(copy, 500);
+
+    wtree3_tree_close(copy);
+    wtree3_tree_close(src);
+    membuf_free(&buf);
+}
+
+static void test_snapshot_rebuilds_indexes(void **state) {
+    (void)state;
+
+    wtree3_tree_t *src = create_source("s_rsrc", 800, false);
+
+    /* Definitions only: the import rebuilds */
+    membuf_t lean = {0}, full = {0};
+    export_tree(src, WTREE3_SNAPSHOT_NO_INDEXES, &lean);
+    export_tree(src, 0, &full);
+    assert_true(lean.len < full.len);
+
+    wtree3_tree_t *copy = import_tree("s_rcopy1", 0, &lean);
+    assert_rows(copy, 800);
+    wtree3_tree_close(copy);
+
+    /* Entries in the stream are skipped on request */
+    copy = import_tree("s_rcopy2", WTREE3_SNAPSHOT_REBUILD_INDEXES, &full);
+    assert_rows(copy, 800);
+    wtree3_tree_close(copy);
+
+    wtree3_tree_close(src);
+    membuf_free(&lean);
+    membuf_free(&full);
+}
+
+static void test_snapshot_from_read_txn(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *src = create_source("s_tsrc", 300, false);
+
+    /* Everything comes from the txn's snapshot */
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+    membuf_t buf = {0};
+    assert_int_equal(WTREE3_OK, wtree3_tree_export_txn(txn, src, 0, mem_write, &buf, &error));
+    wtree3_txn_abort(txn);
+
+    wtree3_tree_t *copy = import_tree("s_tcopy", 0, &buf);
+    assert_rows(copy, 300);
+
+    wtree3_tree_close(copy);
+    wtree3_tree_close(src);
+    membuf_free(&buf);
+}
+
+/* ============================================================
+ * Errors
+ * ============================================================ */
+
+static void test_snapshot_bad_streams(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *src = create_source("s_bsrc", 400, false);
+    membuf_t buf = {0};
+    export_tree(src, WTREE3_SNAPSHOT_COMPRESS, &buf);
+
+    /* The stored name already exists */
+    buf.pos = 0;
+    assert_null(wtree3_tree_import(test_db, NULL, 0, mem_read, &buf, &error));
+    assert_int_equal(error.code, WTREE3_EINVAL);
+
+    /* Truncated */
+    size_t full_len = buf.len;
+    buf.len = full_len / 2;
+    buf.pos = 0;
+    memset(&error, 0, sizeof(error));
+    assert_null(wtree3_tree_import(test_db, "s_bad", 0, mem_read, &buf, &error));
+    assert_int_equal(error.code, WTREE3_ERROR);
+    assert_int_equal(wtree3_tree_exists(test_db, "s_bad", &error), 0);
+    buf.len = full_len;
+
+    /* One flipped payload byte fails its block checksum */
+    buf.data[buf.len / 2] ^= 0x5a;
+    buf.pos = 0;
+    memset(&error, 0, sizeof(error));
+    assert_null(wtree3_tree_import(test_db, "s_bad", 0, mem_read, &buf, &error));
+    assert_int_equal(error.code, WTREE3_ERROR);
+    assert_int_equal(wtree3_tree_exists(test_db, "s_bad", &error), 0);
+
+    /* Not a snapshot */
+    buf.data[0] = 'X';
+    buf.pos = 0;
+    memset(&error, 0, sizeof(error));
+    assert_null(wtree3_tree_import(test_db, "s_bad", 0, mem_read, &buf, &error));
+    assert_int_equal(error.code, WTREE3_EINVAL);
+
+    /* A failing writer aborts the export */
+    membuf_t short_buf = {.fail_after = 256};
+    memset(&error, 0, sizeof(error));
+    assert_int_equal(WTREE3_ERROR, wtree3_tree_export(src, 0, mem_write, &short_buf, &error));
+
+    assert_int_equal(WTREE3_EINVAL, wtree3_tree_export(NULL, 0, mem_write, &short_buf, &error));
+    assert_int_equal(WTREE3_EINVAL, wtree3_tree_export(src, 0, NULL, &short_buf, &error));
+    assert_null(wtree3_tree_import(test_db, "s_bad", 0, NULL, &buf, &error));
+
+    wtree3_tree_close(src);
+    membuf_free(&buf);
+    membuf_free(&short_buf);
+}
+
+/* ============================================================
+ * Environment Copy
+ * ============================================================ */
+
+static void test_db_copy_compact(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *src = create_source("s_env", 600, false);
+
+    /* Free pages left by deletes are not copied */
+    size_t deleted = 0;
+    assert_int_equal(WTREE3_OK, wtree3_tree_clear(src, &deleted, &error));
+    assert_int_equal(deleted, 600);
+    wtree3_tree_close(src);
+    src = create_source("s_env2", 600, false);
+
+    mkdir(copy_db_path, 0755);
+    assert_int_equal(WTREE3_OK, wtree3_db_copy(test_db, copy_db_path, true, &error));
+
+    wtree3_db_t *copy_db = open_db(copy_db_path);
+    assert_non_null(copy_db);
+    wtree3_tree_t *copy = wtree3_tree_open(copy_db, "s_env2", 0, 0, &error);
+    assert_non_null(copy);
+    assert_int_equal(wtree3_tree_count(copy), 600);
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(copy, &error));
+    assert_int_equal(index_hits(copy, "g0000007"), 60);
+
+    wtree3_tree_close(copy);
+    wtree3_db_close(copy_db);
+    wtree3_tree_close(src);
+
+    assert_int_equal(WTREE3_EINVAL, wtree3_db_copy(test_db, NULL, true, &error));
+}
+
+/* ============================================================
+ * Main
+ * ============================================================ */
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_snapshot_roundtrip),
+        cmocka_unit_test(test_snapshot_compressed_blocks),
+        cmocka_unit_test(test_snapshot_codec_tree),
+        cmocka_unit_test(test_snapshot_rebuilds_indexes),
+        cmocka_unit_test(test_snapshot_from_read_txn),
+        cmocka_unit_test(test_snapshot_bad_streams),
+        cmocka_unit_test(test_db_copy_compact),
+    };
+
+    return cmocka_run_group_tests(tests, setup_db, teardown_db);
+}
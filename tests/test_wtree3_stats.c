@@ -0,0 +1,426 @@
+/*
+ * test_wtree3_stats.c - Tests for statistics and range cardinality estimates
+ *
+ * Tests that:
+ * - Unanalyzed trees estimate the live entry count, points stay exact
+ * - wtree3_tree_analyze() records entry/distinct/duplicate counts
+ * - Range estimates land within a histogram bucket of the true count
+ * - Skewed index keys are estimated per key, not by average
+ * - Estimates scale with growth after the analyze
+ * - Stats records go away with their index/tree and never load as indexes
+ * - Parallel scans over analyzed trees still see every entry once
+ * - Invalid parameters and missing indexes are rejected
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+    #include <process.h>
+    #define mkdir(path, mode) _mkdir(path)
+    #define getpid() _getpid()
+#else
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "wtree3.h"
+
+/* One histogram bucket of slack: entries/64, rounded up, on each bound */
+#define BUCKET_SLACK(n) (2 * ((n) / 64 + 1))
+
+/* Test database path */
+static char test_db_path[256];
+static wtree3_db_t *test_db = NULL;
+
+static bool field_extractor(const void *value, size_t value_len,
+                            void *user_data,
+                            void **out_key, size_t *out_len);
+
+/* ============================================================
+ * Test Fixtures
+ * ============================================================ */
+
+static int setup_db(void **state) {
+    (void)state;
+
+#ifdef _WIN32
+    snprintf(test_db_path, sizeof(test_db_path), "%s\\test_wtree3_stats_%d",
+             getenv("TEMP"), getpid());
+#else
+    snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_wtree3_stats_%d", getpid());
+#endif
+    mkdir(test_db_path, 0755);
+
+    gerror_t error = {0};
+    test_db = wtree3_db_open(test_db_path, 64 * 1024 * 1024, 128, WTREE3_VERSION(1, 0), 0, &error);
+    if (!test_db) {
+        fprintf(stderr, "Failed to create test database: %s\n", error.message);
+        return -1;
+    }
+
+    for (uint32_t flags = 0; flags <= 0x03; flags++) {
+        int rc = wtree3_db_register_key_extractor(test_db, WTREE3_VERSION(1, 0), flags,
+                                                  field_extractor, &error);
+        if (rc != WTREE3_OK) {
+            fprintf(stderr, "Failed to register extractor for flags=0x%02x: %s\n", flags, error.message);
+            wtree3_db_close(test_db);
+            test_db = NULL;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int teardown_db(void **state) {
+    (void)state;
+
+    if (test_db) {
+        wtree3_db_close(test_db);
+        test_db = NULL;
+    }
+
+    char cmd[512];
+#ifdef _WIN32
+    snprintf(cmd, sizeof(cmd), "rd /s /q \"%s\"", test_db_path);
+#else
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", test_db_path);
+#endif
+    (void)system(cmd);
+
+    return 0;
+}
+
+/* Index the 3-char prefix of the value */
+static bool field_extractor(const void *value, size_t value_len,
+                            void *user_data,
+                            void **out_key, size_t *out_len) {
+    (void)user_data;
+    if (value_len < 3) return false;
+
+    char *key = malloc(3);
+    if (!key) return false;
+
+    memcpy(key, value, 3);
+    *out_key = key;
+    *out_len = 3;
+    return true;
+}
+
+/* ============================================================
+ * Helpers
+ * ============================================================ */
+
+/* Keys "k00000".., value "<tag>-<i>" with tag given per row */
+static void put_row(wtree3_tree_t *tree, int i, const char *tag) {
+    gerror_t error = {0};
+    char key[16], value[32];
+    snprintf(key, sizeof(key), "k%05d", i);
+    snprintf(value, sizeof(value), "%s-%d", tag, i);
+    assert_int_equal(WTREE3_OK,
+                     wtree3_insert_one(tree, key, strlen(key), value, strlen(value), &error));
+}
+
+static wtree3_tree_t *create_tree(const char *name, int rows, int stride) {
+    gerror_t error = {0};
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, name, 0, 0, &error);
+    assert_non_null(tree);
+
+    for (int i = 0; i < rows; i++) put_row(tree, i * stride, "aaa");
+    return tree;
+}
+
+static uint64_t estimate(wtree3_tree_t *tree, const char *index_name,
+                         const char *start, const char *end) {
+    gerror_t error = {0};
+    uint64_t n = UINT64_MAX;
+    assert_int_equal(WTREE3_OK,
+                     wtree3_estimate_range(tree, index_name,
+                                           start, start ? strlen(start) : 0,
+                                           end, end ? strlen(end) : 0,
+                                           &n, &error));
+    return n;
+}
+
+static void assert_near(uint64_t actual, uint64_t expected, uint64_t slack) {
+    uint64_t diff = actual > expected ? actual - expected : expected - actual;
+    if (diff > slack) {
+        fail_msg("estimate %llu, expected %llu +/- %llu",
+                 (unsigned long long)actual, (unsigned long long)expected,
+                 (unsigned long long)slack);
+    }
+}
+
+/* ============================================================
+ * Main Tree Estimates
+ * ============================================================ */
+
+static void test_estimate_without_stats(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = create_tree("s_fresh", 200, 1);
+
+    /* Upper bound: the whole tree */
+    assert_int_equal(estimate(tree, NULL, "k00010", "k00019"), 200);
+    assert_int_equal(estimate(tree, NULL, NULL, NULL), 200);
+
+    /* Points are exact regardless */
+    assert_int_equal(estimate(tree, NULL, "k00010", "k00010"), 1);
+    assert_int_equal(estimate(tree, NULL, "k99999", "k99999"), 0);
+
+    /* Inverted ranges are empty */
+    assert_int_equal(estimate(tree, NULL, "k00019", "k00010"), 0);
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+    wtree3_stats_t st;
+    assert_int_equal(WTREE3_NOT_FOUND, wtree3_stats_get_txn(txn, tree, NULL, &st, &error));
+    wtree3_txn_abort(txn);
+
+    wtree3_tree_close(tree);
+}
+
+static void test_estimate_main_range(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = create_tree("s_main", 1000, 1);
+    assert_int_equal(WTREE3_OK, wtree3_tree_analyze(tree, &error));
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+    wtree3_stats_t st;
+    assert_int_equal(WTREE3_OK, wtree3_stats_get_txn(txn, tree, NULL, &st, &error));
+    assert_int_equal(st.entries, 1000);
+    assert_int_equal(st.distinct_keys, 1000);
+    assert_int_equal(st.max_dups, 1);
+    assert_true(st.samples > 32 && st.samples <= 64);
+    wtree3_txn_abort(txn);
+
+    assert_int_equal(estimate(tree, NULL, NULL, NULL), 1000);
+    assert_near(estimate(tree, NULL, "k00100", "k00299"), 200, BUCKET_SLACK(1000));
+    assert_near(estimate(tree, NULL, NULL, "k00499"), 500, BUCKET_SLACK(1000));
+    assert_near(estimate(tree, NULL, "k00900", NULL), 100, BUCKET_SLACK(1000));
+
+    /* Bounds between keys */
+    assert_near(estimate(tree, NULL, "k00100x", "k00200x"), 100, BUCKET_SLACK(1000));
+    assert_int_equal(estimate(tree, NULL, "a", "b"), 0);
+    assert_int_equal(estimate(tree, NULL, "z", NULL), 0);
+
+    wtree3_tree_close(tree);
+}
+
+static void test_estimate_scales_with_growth(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    /* Even keys analyzed, odd keys added afterwards */
+    wtree3_tree_t *tree = create_tree("s_growth", 500, 2);
+    assert_int_equal(WTREE3_OK, wtree3_tree_analyze(tree, &error));
+    for (int i = 0; i < 500; i++) put_row(tree, i * 2 + 1, "aaa");
+
+    assert_int_equal(estimate(tree, NULL, NULL, NULL), 1000);
+    assert_near(estimate(tree, NULL, "k00000", "k00399"), 400, 2 * BUCKET_SLACK(500));
+
+    /* A fresh analyze sees the new keys directly */
+    assert_int_equal(WTREE3_OK, wtree3_tree_analyze(tree, &error));
+    assert_near(estimate(tree, NULL, "k00000", "k00399"), 400, BUCKET_SLACK(1000));
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Index Estimates
+ * ============================================================ */
+
+static void test_estimate_index_skewed(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "s_index", 0, 0, &error);
+    assert_non_null(tree);
+    wtree3_index_config_t cfg = {.name = "tag_idx"};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &cfg, &error));
+
+    /* 900 rows share "aaa"; 100 rows spread over b00..b49 */
+    char tag[8];
+    for (int i = 0; i < 1000; i++) {
+        if (i < 900) {
+            put_row(tree, i, "aaa");
+        } else {
+            snprintf(tag, sizeof(tag), "b%02d", (i - 900) / 2);
+            put_row(tree, i, tag);
+        }
+    }
+    assert_int_equal(WTREE3_OK, wtree3_index_analyze(tree, "tag_idx", &error));
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+    wtree3_stats_t st;
+    assert_int_equal(WTREE3_OK, wtree3_stats_get_txn(txn, tree, "tag_idx", &st, &error));
+    assert_int_equal(st.entries, 1000);
+    assert_int_equal(st.distinct_keys, 51);
+    assert_int_equal(st.max_dups, 900);
+
+    /* Only the index was analyzed */
+    assert_int_equal(WTREE3_NOT_FOUND, wtree3_stats_get_txn(txn, tree, NULL, &st, &error));
+    wtree3_txn_abort(txn);
+
+    /* Exact per-key counts, not entries / distinct */
+    assert_int_equal(estimate(tree, "tag_idx", "aaa", "aaa"), 900);
+    assert_int_equal(estimate(tree, "tag_idx", "b07", "b07"), 2);
+    assert_int_equal(estimate(tree, "tag_idx", "zzz", "zzz"), 0);
+
+    assert_near(estimate(tree, "tag_idx", "b00", "b49"), 100, BUCKET_SLACK(1000));
+    assert_near(estimate(tree, "tag_idx", "aaa", "b24"), 950, BUCKET_SLACK(1000));
+    assert_int_equal(estimate(tree, "tag_idx", NULL, NULL), 1000);
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Lifecycle
+ * ============================================================ */
+
+static void test_stats_lifecycle(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = create_tree("s_life", 100, 1);
+    wtree3_index_config_t cfg = {.name = "tag_idx"};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &cfg, &error));
+    assert_int_equal(WTREE3_OK, wtree3_tree_populate_index(tree, "tag_idx", &error));
+    assert_int_equal(WTREE3_OK, wtree3_tree_analyze(tree, &error));
+
+    /* Stats records are not mistaken for persisted indexes on reopen */
+    wtree3_tree_close(tree);
+    tree = wtree3_tree_open(test_db, "s_life", 0, 0, &error);
+    assert_non_null(tree);
+    assert_int_equal(wtree3_tree_index_count(tree), 1);
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+    wtree3_stats_t st;
+    assert_int_equal(WTREE3_OK, wtree3_stats_get_txn(txn, tree, "tag_idx", &st, &error));
+    assert_int_equal(st.entries, 100);
+    wtree3_txn_abort(txn);
+
+    /* Dropping the index drops its stats */
+    assert_int_equal(WTREE3_OK, wtree3_tree_drop_index(tree, "tag_idx", &error));
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &cfg, &error));
+    txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+    assert_int_equal(WTREE3_NOT_FOUND, wtree3_stats_get_txn(txn, tree, "tag_idx", &st, &error));
+    assert_int_equal(WTREE3_OK, wtree3_stats_get_txn(txn, tree, NULL, &st, &error));
+    wtree3_txn_abort(txn);
+
+    /* Deleting the tree drops the rest */
+    wtree3_tree_close(tree);
+    assert_int_equal(WTREE3_OK, wtree3_tree_delete(test_db, "s_life", &error));
+    tree = wtree3_tree_open(test_db, "s_life", 0, 0, &error);
+    assert_non_null(tree);
+    txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+    assert_int_equal(WTREE3_NOT_FOUND, wtree3_stats_get_txn(txn, tree, NULL, &st, &error));
+    wtree3_txn_abort(txn);
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Parallel Scan Partitioning
+ * ============================================================ */
+
+static bool count_row(const void *key, size_t key_len,
+                      const void *value, size_t value_len,
+                      void *user_data) {
+    (void)key; (void)key_len; (void)value; (void)value_len;
+    (*(uint64_t *)user_data)++;
+    return true;
+}
+
+static void sum_rows(void *partial, void *user_data) {
+    *(uint64_t *)user_data += *(uint64_t *)partial;
+}
+
+static void test_parallel_scan_histogram_splits(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    /* Dense low keys, sparse high keys: bisection would skew the slices */
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "s_pscan", 0, 0, &error);
+    assert_non_null(tree);
+    for (int i = 0; i < 5000; i++) put_row(tree, i < 4500 ? i : i * 20, "aaa");
+    assert_int_equal(WTREE3_OK, wtree3_tree_analyze(tree, &error));
+
+    wtree3_parallel_scan_opts_t opts = {.threads = 4, .partial_size = sizeof(uint64_t)};
+    uint64_t total = 0;
+    assert_int_equal(WTREE3_OK,
+                     wtree3_scan_parallel(tree, NULL, 0, NULL, 0, &opts,
+                                          count_row, sum_rows, &total, &error));
+    assert_int_equal(total, 5000);
+
+    /* Bounded range, split points outside it are ignored */
+    total = 0;
+    assert_int_equal(WTREE3_OK,
+                     wtree3_scan_parallel(tree, "k01000", 6, "k03999", 6, &opts,
+                                          count_row, sum_rows, &total, &error));
+    assert_int_equal(total, 3000);
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Errors
+ * ============================================================ */
+
+static void test_stats_errors(void **state) {
+    (void)state;
+    gerror_t error = {0};
+    uint64_t n;
+
+    wtree3_tree_t *tree = create_tree("s_errors", 10, 1);
+
+    assert_int_equal(WTREE3_EINVAL, wtree3_tree_analyze(NULL, &error));
+    assert_int_equal(WTREE3_EINVAL, wtree3_index_analyze(tree, NULL, &error));
+    assert_int_equal(WTREE3_NOT_FOUND, wtree3_index_analyze(tree, "missing", &error));
+
+    assert_int_equal(WTREE3_EINVAL,
+                     wtree3_estimate_range(NULL, NULL, NULL, 0, NULL, 0, &n, &error));
+    assert_int_equal(WTREE3_EINVAL,
+                     wtree3_estimate_range(tree, NULL, NULL, 0, NULL, 0, NULL, &error));
+    assert_int_equal(WTREE3_NOT_FOUND,
+                     wtree3_estimate_range(tree, "missing", NULL, 0, NULL, 0, &n, &error));
+
+    wtree3_stats_t st;
+    assert_int_equal(WTREE3_EINVAL, wtree3_stats_get_txn(NULL, tree, NULL, &st, &error));
+
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Main
+ * ============================================================ */
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_estimate_without_stats),
+        cmocka_unit_test(test_estimate_main_range),
+        cmocka_unit_test(test_estimate_scales_with_growth),
+        cmocka_unit_test(test_estimate_index_skewed),
+        cmocka_unit_test(test_stats_lifecycle),
+        cmocka_unit_test(test_parallel_scan_histogram_splits),
+        cmocka_unit_test(test_stats_errors),
+    };
+
+    return cmocka_run_group_tests(tests, setup_db, teardown_db);
+}
@@ -652,6 +652,261 @@ static void test_get_many_missing_keys(void **state) {
     wtree3_tree_close(tree);
 }
 
+/* ============================================================
+ * Batch Scan Tests
+ * ============================================================ */
+
+/* Batch callback that collects keys and records page sizes */
+typedef struct {
+    scan_collector_t keys;
+    size_t pages;
+    size_t page_sizes[16];
+    size_t max_pages;          /* Stop after this many pages (0 = no limit) */
+} batch_collector_t;
+
+static bool collect_batch(const wtree3_batch_entry_t *entries, size_t count,
+                          void *user_data) {
+    batch_collector_t *bc = (batch_collector_t*)user_data;
+
+    for (size_t i = 0; i < count; i++) {
+        collect_keys(entries[i].key.mv_data, entries[i].key.mv_size,
+                     entries[i].value.mv_data, entries[i].value.mv_size,
+                     &bc->keys);
+    }
+    if (bc->pages < 16) bc->page_sizes[bc->pages] = count;
+    bc->pages++;
+    return bc->max_pages == 0 || bc->pages < bc->max_pages;
+}
+
+static void test_scan_range_batch_full(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "batch_full", 0, 0, &error);
+    assert_non_null(tree);
+
+    populate_tree(tree);
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+
+    /* 7 entries in pages of 3 */
+    wtree3_batch_entry_t page[3];
+    batch_collector_t bc = {0};
+    int rc = wtree3_scan_range_batch_txn(txn, tree, NULL, 0, NULL, 0,
+                                         page, 3, collect_batch, &bc, &error);
+    assert_int_equal(rc, 0);
+    assert_string_equal(bc.keys.buffer, "key1,key2,key3,key5,key7,key8,key9");
+    assert_int_equal(bc.pages, 3);
+    assert_int_equal(bc.page_sizes[0], 3);
+    assert_int_equal(bc.page_sizes[1], 3);
+    assert_int_equal(bc.page_sizes[2], 1);
+
+    wtree3_txn_abort(txn);
+    wtree3_tree_close(tree);
+}
+
+static void test_scan_range_batch_bound_mid_page(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "batch_bound", 0, 0, &error);
+    assert_non_null(tree);
+
+    populate_tree(tree);
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+
+    /* key2..key6: the second page crosses the bound and must be cut */
+    wtree3_batch_entry_t page[2];
+    batch_collector_t bc = {0};
+    int rc = wtree3_scan_range_batch_txn(txn, tree,
+                                         "key2", strlen("key2") + 1,
+                                         "key6", strlen("key6") + 1,
+                                         page, 2, collect_batch, &bc, &error);
+    assert_int_equal(rc, 0);
+    assert_string_equal(bc.keys.buffer, "key2,key3,key5");
+    assert_int_equal(bc.pages, 2);
+    assert_int_equal(bc.page_sizes[1], 1);
+
+    /* Bound exactly at the end of a page: no trailing empty callback */
+    memset(&bc, 0, sizeof(bc));
+    rc = wtree3_scan_range_batch_txn(txn, tree,
+                                     "key2", strlen("key2") + 1,
+                                     "key3", strlen("key3") + 1,
+                                     page, 2, collect_batch, &bc, &error);
+    assert_int_equal(rc, 0);
+    assert_string_equal(bc.keys.buffer, "key2,key3");
+    assert_int_equal(bc.pages, 1);
+
+    /* Range with no keys in it */
+    memset(&bc, 0, sizeof(bc));
+    rc = wtree3_scan_range_batch_txn(txn, tree,
+                                     "key4", strlen("key4") + 1,
+                                     "key4z", strlen("key4z") + 1,
+                                     page, 2, collect_batch, &bc, &error);
+    assert_int_equal(rc, 0);
+    assert_int_equal(bc.pages, 0);
+
+    wtree3_txn_abort(txn);
+    wtree3_tree_close(tree);
+}
+
+static void test_scan_range_batch_early_stop(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "batch_stop", 0, 0, &error);
+    assert_non_null(tree);
+
+    populate_tree(tree);
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+
+    /* Single-entry pages, stop after two */
+    wtree3_batch_entry_t page[1];
+    batch_collector_t bc = {.max_pages = 2};
+    int rc = wtree3_scan_range_batch_txn(txn, tree, NULL, 0, NULL, 0,
+                                         page, 1, collect_batch, &bc, &error);
+    assert_int_equal(rc, 0);
+    assert_string_equal(bc.keys.buffer, "key1,key2");
+    assert_int_equal(bc.pages, 2);
+
+    wtree3_txn_abort(txn);
+    wtree3_tree_close(tree);
+}
+
+static void test_scan_reverse_batch_partial(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "batch_rev", 0, 0, &error);
+    assert_non_null(tree);
+
+    populate_tree(tree);
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+
+    /* From key6 (missing, starts at key5) down to key2 */
+    wtree3_batch_entry_t page[2];
+    batch_collector_t bc = {0};
+    int rc = wtree3_scan_reverse_batch_txn(txn, tree,
+                                           "key6", strlen("key6") + 1,
+                                           "key2", strlen("key2") + 1,
+                                           page, 2, collect_batch, &bc, &error);
+    assert_int_equal(rc, 0);
+    assert_string_equal(bc.keys.buffer, "key5,key3,key2");
+    assert_int_equal(bc.pages, 2);
+
+    /* Whole tree */
+    wtree3_batch_entry_t big[16];
+    memset(&bc, 0, sizeof(bc));
+    rc = wtree3_scan_reverse_batch_txn(txn, tree, NULL, 0, NULL, 0,
+                                       big, 16, collect_batch, &bc, &error);
+    assert_int_equal(rc, 0);
+    assert_string_equal(bc.keys.buffer, "key9,key8,key7,key5,key3,key2,key1");
+    assert_int_equal(bc.pages, 1);
+
+    wtree3_txn_abort(txn);
+    wtree3_tree_close(tree);
+}
+
+static void test_scan_prefix_batch(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "batch_prefix", 0, 0, &error);
+    assert_non_null(tree);
+
+    wtree3_insert_one(tree, "post:1", 7, "hello", 6, &error);
+    wtree3_insert_one(tree, "user:1", 7, "alice", 6, &error);
+    wtree3_insert_one(tree, "user:2", 7, "bob", 4, &error);
+    wtree3_insert_one(tree, "user:3", 7, "carol", 6, &error);
+    wtree3_insert_one(tree, "zeta:1", 7, "z", 2, &error);
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+
+    /* Page of 4 reaches past the prefix and is cut to 3 */
+    wtree3_batch_entry_t page[4];
+    batch_collector_t bc = {0};
+    int rc = wtree3_scan_prefix_batch_txn(txn, tree, "user:", 5,
+                                          page, 4, collect_batch, &bc, &error);
+    assert_int_equal(rc, 0);
+    assert_string_equal(bc.keys.buffer, "user:1,user:2,user:3");
+    assert_int_equal(bc.pages, 1);
+    assert_int_equal(bc.page_sizes[0], 3);
+
+    /* Values are zero-copy and stay valid after the callback */
+    assert_int_equal(page[1].value.mv_size, 4);
+    assert_string_equal((const char*)page[1].value.mv_data, "bob");
+
+    memset(&bc, 0, sizeof(bc));
+    rc = wtree3_scan_prefix_batch_txn(txn, tree, "xyz:", 4,
+                                      page, 4, collect_batch, &bc, &error);
+    assert_int_equal(rc, 0);
+    assert_int_equal(bc.pages, 0);
+
+    wtree3_txn_abort(txn);
+    wtree3_tree_close(tree);
+}
+
+static void test_get_many_unsorted_input(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "get_many_unsorted", 0, 0, &error);
+    assert_non_null(tree);
+
+    populate_tree(tree);
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+
+    /* Enough keys to take the sorted path: descending, repeated and missing */
+    wtree3_kv_t keys[] = {
+        {.key = "key9", .key_len = 5},
+        {.key = "key8", .key_len = 5},
+        {.key = "key6", .key_len = 5},  /* doesn't exist */
+        {.key = "key5", .key_len = 5},
+        {.key = "key9", .key_len = 5},  /* repeated */
+        {.key = "key3", .key_len = 5},
+        {.key = "key0", .key_len = 5},  /* doesn't exist */
+        {.key = "key1", .key_len = 5},
+        {.key = "key6", .key_len = 5},  /* repeated, doesn't exist */
+        {.key = "key2", .key_len = 5}
+    };
+    const char *expected[] = {"val9", "val8", NULL, "val5", "val9",
+                              "val3", NULL, "val1", NULL, "val2"};
+
+    const void *values[10];
+    size_t value_lens[10];
+    int rc = wtree3_get_many_txn(txn, tree, keys, 10, values, value_lens, &error);
+    assert_int_equal(rc, 0);
+
+    bool results[10];
+    rc = wtree3_exists_many_txn(txn, tree, keys, 10, results, &error);
+    assert_int_equal(rc, 0);
+
+    for (size_t i = 0; i < 10; i++) {
+        if (expected[i]) {
+            assert_string_equal((const char*)values[i], expected[i]);
+            assert_int_equal(value_lens[i], 5);
+            assert_true(results[i]);
+        } else {
+            assert_null(values[i]);
+            assert_int_equal(value_lens[i], 0);
+            assert_false(results[i]);
+        }
+    }
+
+    wtree3_txn_abort(txn);
+    wtree3_tree_close(tree);
+}
+
 /* ============================================================
  * Error Cases
  * ============================================================ */
@@ -670,6 +925,18 @@ static void test_scan_null_params(void **state) {
                                    NULL, NULL, &error);
     assert_int_equal(rc, WTREE3_EINVAL);
 
+    /* Batch scans need a page buffer with room for at least one entry */
+    wtree3_batch_entry_t page[1];
+    rc = wtree3_scan_range_batch_txn(txn, tree, NULL, 0, NULL, 0,
+                                     page, 0, collect_batch, NULL, &error);
+    assert_int_equal(rc, WTREE3_EINVAL);
+    rc = wtree3_scan_reverse_batch_txn(txn, tree, NULL, 0, NULL, 0,
+                                       NULL, 1, collect_batch, NULL, &error);
+    assert_int_equal(rc, WTREE3_EINVAL);
+    rc = wtree3_scan_prefix_batch_txn(txn, tree, "k", 1,
+                                      page, 1, NULL, NULL, &error);
+    assert_int_equal(rc, WTREE3_EINVAL);
+
     wtree3_txn_abort(txn);
     wtree3_tree_close(tree);
 }
@@ -714,6 +981,13 @@ int main(void) {
         cmocka_unit_test_setup_teardown(test_scan_prefix_basic, setup_db, teardown_db),
         cmocka_unit_test_setup_teardown(test_scan_prefix_no_match, setup_db, teardown_db),
 
+        /* Batch scans */
+        cmocka_unit_test_setup_teardown(test_scan_range_batch_full, setup_db, teardown_db),
+        cmocka_unit_test_setup_teardown(test_scan_range_batch_bound_mid_page, setup_db, teardown_db),
+        cmocka_unit_test_setup_teardown(test_scan_range_batch_early_stop, setup_db, teardown_db),
+        cmocka_unit_test_setup_teardown(test_scan_reverse_batch_partial, setup_db, teardown_db),
+        cmocka_unit_test_setup_teardown(test_scan_prefix_batch, setup_db, teardown_db),
+
         /* Modify operations */
         cmocka_unit_test_setup_teardown(test_modify_update_existing, setup_db, teardown_db),
         cmocka_unit_test_setup_teardown(test_modify_insert_new, setup_db, teardown_db),
@@ -723,6 +997,7 @@ int main(void) {
         /* Get many operations */
         cmocka_unit_test_setup_teardown(test_get_many_basic, setup_db, teardown_db),
         cmocka_unit_test_setup_teardown(test_get_many_missing_keys, setup_db, teardown_db),
+        cmocka_unit_test_setup_teardown(test_get_many_unsorted_input, setup_db, teardown_db),
 
         /* Error cases */
         cmocka_unit_test_setup_teardown(test_scan_null_params, setup_db, teardown_db),
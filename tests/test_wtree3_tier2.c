@@ -3,7 +3,9 @@
  *
  * Tests specialized bulk operations including:
  * - Conditional bulk delete (delete_if)
+ * - Range delete and tree clear with index maintenance (delete_range, tree_clear)
  * - Range collection with predicates (collect_range)
+ * - Arena-backed and zero-copy result sets (collect_range_result)
  * - Batch existence checks (exists_many)
  */
 
@@ -305,6 +307,188 @@ static void test_delete_if_all(void **state) {
     wtree3_tree_close(tree);
 }
 
+/* ============================================================
+ * Range Delete and Clear Tests
+ * ============================================================ */
+
+/* Indexed record: group is shared, id unique */
+typedef struct {
+    uint32_t group;
+    uint32_t id;
+} range_record_t;
+
+#define RANGE_ROWS 1500             /* Several index flushes per delete */
+
+static const wtree3_key_spec_t range_group_spec = {
+    .part_count = 1,
+    .parts = {{.offset = offsetof(range_record_t, group), .type = WTREE3_KEY_U32}},
+};
+
+static const wtree3_key_spec_t range_id_spec = {
+    .part_count = 1,
+    .parts = {{.offset = offsetof(range_record_t, id), .type = WTREE3_KEY_U32}},
+};
+
+static wtree3_tree_t *open_indexed_tree(const char *name) {
+    gerror_t error = {0};
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, name, 0, 0, &error);
+    assert_non_null(tree);
+
+    wtree3_index_config_t group_cfg = {.name = "group_idx", .key_spec = &range_group_spec};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &group_cfg, &error));
+    wtree3_index_config_t id_cfg = {.name = "id_idx", .key_spec = &range_id_spec, .unique = true};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &id_cfg, &error));
+
+    for (uint32_t i = 1; i <= RANGE_ROWS; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "key%05u", i);
+        range_record_t r = {.group = i % 4, .id = i};
+        assert_int_equal(WTREE3_OK, wtree3_insert_one(tree, key, strlen(key) + 1,
+                                                      &r, sizeof(r), &error));
+    }
+    return tree;
+}
+
+static bool count_postings(const wtree3_index_page_t *page, void *user_data) {
+    *(size_t *)user_data += page->count;
+    return true;
+}
+
+/* Main keys stored under one group of group_idx */
+static size_t group_postings(wtree3_tree_t *tree, uint32_t group) {
+    gerror_t error = {0};
+    unsigned char key[8];
+    size_t key_len = 0;
+    range_record_t probe = {.group = group};
+    assert_int_equal(WTREE3_OK, wtree3_key_spec_encode(&range_group_spec, &probe, sizeof(probe),
+                                                       key, sizeof(key), &key_len, &error));
+
+    size_t n = 0;
+    assert_int_equal(WTREE3_OK, wtree3_index_get_all(tree, "group_idx", key, key_len,
+                                                     count_postings, &n, &error));
+    return n;
+}
+
+static void test_delete_range_indexed(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = open_indexed_tree("delete_range_idx");
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(txn);
+
+    size_t deleted = 0;
+    int rc = wtree3_delete_range_txn(txn, tree, "key00100", 9, "key01299", 9, &deleted, &error);
+    assert_int_equal(rc, 0);
+    assert_int_equal(deleted, 1200);
+    assert_int_equal(wtree3_txn_commit(txn, &error), 0);
+
+    assert_int_equal(wtree3_tree_count(tree), RANGE_ROWS - 1200);
+    assert_int_equal(wtree3_verify_indexes(tree, &error), 0);
+
+    size_t expected = 0;
+    for (uint32_t i = 1; i <= RANGE_ROWS; i++) {
+        if ((i < 100 || i > 1299) && i % 4 == 1) expected++;
+    }
+    assert_int_equal(group_postings(tree, 1), expected);
+
+    /* Freed unique keys can be taken again */
+    range_record_t r = {.group = 1, .id = 500};
+    rc = wtree3_insert_one(tree, "again", 6, &r, sizeof(r), &error);
+    assert_int_equal(rc, 0);
+    assert_int_equal(group_postings(tree, 1), expected + 1);
+
+    wtree3_tree_close(tree);
+}
+
+static void test_delete_if_indexed(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = open_indexed_tree("delete_if_idx");
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(txn);
+
+    size_t deleted = 0;
+    int rc = wtree3_delete_if_txn(txn, tree, NULL, 0, NULL, 0,
+                                  predicate_even_keys, NULL, &deleted, &error);
+    assert_int_equal(rc, 0);
+    assert_int_equal(deleted, RANGE_ROWS / 2);
+    assert_int_equal(wtree3_txn_commit(txn, &error), 0);
+
+    assert_int_equal(wtree3_verify_indexes(tree, &error), 0);
+    assert_int_equal(group_postings(tree, 0), 0);
+    assert_int_equal(group_postings(tree, 2), 0);
+    assert_int_equal(group_postings(tree, 1), RANGE_ROWS / 4);
+
+    wtree3_tree_close(tree);
+}
+
+static void test_delete_range_unbounded_clears(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = open_indexed_tree("delete_range_all");
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(txn);
+
+    size_t deleted = 0;
+    int rc = wtree3_delete_range_txn(txn, tree, NULL, 0, NULL, 0, &deleted, &error);
+    assert_int_equal(rc, 0);
+    assert_int_equal(deleted, RANGE_ROWS);
+    assert_int_equal(wtree3_tree_count_txn(txn, tree), 0);
+
+    /* Aborting brings everything back */
+    wtree3_txn_abort(txn);
+    assert_int_equal(wtree3_tree_count(tree), RANGE_ROWS);
+    assert_int_equal(group_postings(tree, 3), RANGE_ROWS / 4);
+    assert_int_equal(wtree3_verify_indexes(tree, &error), 0);
+
+    wtree3_tree_close(tree);
+}
+
+static void test_tree_clear(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = open_indexed_tree("tree_clear");
+
+    size_t deleted = 0;
+    assert_int_equal(wtree3_tree_clear(tree, &deleted, &error), 0);
+    assert_int_equal(deleted, RANGE_ROWS);
+    assert_int_equal(wtree3_tree_count(tree), 0);
+    assert_int_equal(group_postings(tree, 0), 0);
+    assert_int_equal(wtree3_verify_indexes(tree, &error), 0);
+
+    /* Indexes survive the clear and keep maintaining new rows */
+    assert_int_equal(wtree3_tree_index_count(tree), 2);
+    range_record_t r = {.group = 0, .id = 1};
+    assert_int_equal(wtree3_insert_one(tree, "k", 2, &r, sizeof(r), &error), 0);
+    assert_int_equal(group_postings(tree, 0), 1);
+    assert_int_equal(wtree3_verify_indexes(tree, &error), 0);
+
+    wtree3_tree_close(tree);
+}
+
+static void test_tree_clear_readonly_txn(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "clear_ro", 0, 0, &error);
+    assert_non_null(tree);
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, false, &error);
+    assert_int_equal(wtree3_tree_clear_txn(txn, tree, NULL, &error), WTREE3_EINVAL);
+    assert_int_equal(wtree3_delete_range_txn(txn, tree, "a", 2, "b", 2, NULL, &error),
+                     WTREE3_EINVAL);
+
+    wtree3_txn_abort(txn);
+    wtree3_tree_close(tree);
+}
+
 /* ============================================================
  * Collect Range Tests
  * ============================================================ */
@@ -507,6 +691,113 @@ static void test_collect_range_empty(void **state) {
     wtree3_tree_close(tree);
 }
 
+/* ============================================================
+ * Result Set Tests
+ * ============================================================ */
+
+static void test_collect_result_arena(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "result_arena", 0, 0, &error);
+    assert_non_null(tree);
+
+    /* Enough rows to grow the arena and the entry table several times */
+    for (int i = 0; i < 2000; i++) {
+        char key[32], value[128];
+        snprintf(key, sizeof(key), "k%05d", i);
+        memset(value, 'a' + i % 26, sizeof(value));
+        assert_int_equal(0, wtree3_insert_one(tree, key, strlen(key) + 1,
+                                              value, (size_t)(i % 100) + 1, &error));
+    }
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+    wtree3_result_t *res = NULL;
+    int rc = wtree3_collect_range_result_txn(txn, tree, NULL, 0, NULL, 0, NULL, NULL,
+                                             0, 0, &res, &error);
+    assert_int_equal(rc, 0);
+    wtree3_txn_abort(txn);
+
+    /* Copies outlive the transaction */
+    assert_int_equal(wtree3_result_count(res), 2000);
+    const wtree3_batch_entry_t *e = wtree3_result_entries(res);
+    for (int i = 0; i < 2000; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "k%05d", i);
+        assert_int_equal(e[i].key.mv_size, strlen(key) + 1);
+        assert_string_equal((const char *)e[i].key.mv_data, key);
+        assert_int_equal(e[i].value.mv_size, (size_t)(i % 100) + 1);
+        assert_int_equal(((const char *)e[i].value.mv_data)[0], 'a' + i % 26);
+    }
+    wtree3_result_free(res);
+
+    /* Bounded and filtered */
+    populate_numbered_tree(tree, 10);
+    txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+    threshold_ctx_t ctx = {.threshold = 5};
+    rc = wtree3_collect_range_result_txn(txn, tree, "key", 4, NULL, 0,
+                                         predicate_above_threshold, &ctx, 3, 0, &res, &error);
+    assert_int_equal(rc, 0);
+    assert_int_equal(wtree3_result_count(res), 3);
+    e = wtree3_result_entries(res);
+    assert_string_equal((const char *)e[0].key.mv_data, "key10");
+    assert_string_equal((const char *)e[1].key.mv_data, "key6");
+    assert_string_equal((const char *)e[2].value.mv_data, "value7");
+    wtree3_result_free(res);
+
+    /* Empty range */
+    rc = wtree3_collect_range_result_txn(txn, tree, "zzz", 4, NULL, 0, NULL, NULL,
+                                         0, 0, &res, &error);
+    assert_int_equal(rc, 0);
+    assert_int_equal(wtree3_result_count(res), 0);
+    wtree3_result_free(res);
+
+    wtree3_txn_abort(txn);
+    wtree3_tree_close(tree);
+}
+
+static void test_collect_result_zero_copy(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "result_zc", 0, 0, &error);
+    assert_non_null(tree);
+    populate_numbered_tree(tree, 10);
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, false, &error);
+    assert_non_null(txn);
+
+    wtree3_result_t *res = NULL;
+    int rc = wtree3_collect_range_result_txn(txn, tree, "key3", 5, "key5", 5, NULL, NULL,
+                                             0, WTREE3_COLLECT_ZERO_COPY, &res, &error);
+    assert_int_equal(rc, 0);
+    assert_int_equal(wtree3_result_count(res), 3);
+
+    /* Same bytes the map hands out */
+    const wtree3_batch_entry_t *e = wtree3_result_entries(res);
+    const void *value;
+    size_t value_len;
+    assert_int_equal(0, wtree3_get_txn(txn, tree, "key4", 5, &value, &value_len, &error));
+    assert_ptr_equal(e[1].value.mv_data, value);
+    assert_string_equal((const char *)e[1].key.mv_data, "key4");
+    assert_string_equal((const char *)e[2].value.mv_data, "value5");
+
+    wtree3_result_free(res);
+    wtree3_result_free(NULL);
+
+    /* Parameter checks */
+    assert_int_equal(WTREE3_EINVAL,
+                     wtree3_collect_range_result_txn(txn, tree, NULL, 0, NULL, 0, NULL, NULL,
+                                                     0, 0, NULL, &error));
+    assert_int_equal(wtree3_result_count(NULL), 0);
+    assert_null(wtree3_result_entries(NULL));
+
+    wtree3_txn_abort(txn);
+    wtree3_tree_close(tree);
+}
+
 /* ============================================================
  * Exists Many Tests
  * ============================================================ */
@@ -684,6 +975,13 @@ int main(void) {
         cmocka_unit_test_setup_teardown(test_delete_if_empty_result, setup_db, teardown_db),
         cmocka_unit_test_setup_teardown(test_delete_if_all, setup_db, teardown_db),
 
+        /* Range delete and clear */
+        cmocka_unit_test_setup_teardown(test_delete_range_indexed, setup_db, teardown_db),
+        cmocka_unit_test_setup_teardown(test_delete_if_indexed, setup_db, teardown_db),
+        cmocka_unit_test_setup_teardown(test_delete_range_unbounded_clears, setup_db, teardown_db),
+        cmocka_unit_test_setup_teardown(test_tree_clear, setup_db, teardown_db),
+        cmocka_unit_test_setup_teardown(test_tree_clear_readonly_txn, setup_db, teardown_db),
+
         /* Collect range */
         cmocka_unit_test_setup_teardown(test_collect_range_all, setup_db, teardown_db),
         cmocka_unit_test_setup_teardown(test_collect_range_with_predicate, setup_db, teardown_db),
@@ -691,6 +989,10 @@ int main(void) {
         cmocka_unit_test_setup_teardown(test_collect_range_partial, setup_db, teardown_db),
         cmocka_unit_test_setup_teardown(test_collect_range_empty, setup_db, teardown_db),
 
+        /* Result sets */
+        cmocka_unit_test_setup_teardown(test_collect_result_arena, setup_db, teardown_db),
+        cmocka_unit_test_setup_teardown(test_collect_result_zero_copy, setup_db, teardown_db),
+
         /* Exists many */
         cmocka_unit_test_setup_teardown(test_exists_many_all_exist, setup_db, teardown_db),
         cmocka_unit_test_setup_teardown(test_exists_many_mixed, setup_db, teardown_db),
@@ -8,6 +8,7 @@
  * - Index maintenance during upsert
  * - Transaction-based and auto-transaction upsert
  * - Error cases
+ * - Allocation-free merges (merge_into), in place and through indexes
  */
 
 #include <stdarg.h>
@@ -985,6 +986,216 @@ static void test_upsert_many_counter_batch(void **state) {
     wtree3_tree_close(tree);
 }
 
+/* ============================================================
+ * Allocation-Free Merge Tests
+ * ============================================================ */
+
+/* 64-bit counter addition; user_data counts calls */
+static bool merge_into_add_u64(const void *existing_value, size_t existing_len,
+                               const void *new_value, size_t new_len,
+                               void *user_data, void *out, size_t out_cap, size_t *out_len) {
+    (void)existing_len;
+    (void)new_len;
+    if (user_data) (*(int *)user_data)++;
+
+    *out_len = sizeof(uint64_t);
+    if (out_cap < sizeof(uint64_t)) return true;
+
+    uint64_t a, b;
+    memcpy(&a, existing_value, sizeof(a));
+    memcpy(&b, new_value, sizeof(b));
+    a += b;
+    memcpy(out, &a, sizeof(a));
+    return true;
+}
+
+/* "old" + "new"; user_data counts calls */
+static bool merge_into_concat(const void *existing_value, size_t existing_len,
+                              const void *new_value, size_t new_len,
+                              void *user_data, void *out, size_t out_cap, size_t *out_len) {
+    if (user_data) (*(int *)user_data)++;
+
+    *out_len = existing_len + new_len;
+    if (out_cap < *out_len) return true;
+
+    memcpy(out, existing_value, existing_len);
+    memcpy((char *)out + existing_len, new_value, new_len);
+    return true;
+}
+
+static bool merge_into_failing(const void *existing_value, size_t existing_len,
+                               const void *new_value, size_t new_len,
+                               void *user_data, void *out, size_t out_cap, size_t *out_len) {
+    (void)existing_value;
+    (void)existing_len;
+    (void)new_value;
+    (void)new_len;
+    (void)user_data;
+    /* Scribble over the reserve before failing: the old value must survive */
+    if (out_cap > 0) memset(out, 'X', out_cap);
+    *out_len = out_cap;
+    return false;
+}
+
+static void test_upsert_merge_into_counter(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "merge_into_counter", 0, 0, &error);
+    assert_non_null(tree);
+
+    int calls = 0;
+    wtree3_tree_set_merge_into_fn(tree, merge_into_add_u64, &calls);
+
+    /* First upsert inserts, the rest merge in place */
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(txn);
+    for (uint64_t i = 1; i <= 100; i++) {
+        assert_int_equal(WTREE3_OK, wtree3_upsert_txn(txn, tree, "hits", 4, &i, sizeof(i), &error));
+    }
+    assert_int_equal(WTREE3_OK, wtree3_txn_commit(txn, &error));
+
+    /* Fixed size: one call per merge, never a retry */
+    assert_int_equal(99, calls);
+
+    void *value;
+    size_t value_len;
+    assert_int_equal(WTREE3_OK, wtree3_get(tree, "hits", 4, &value, &value_len, &error));
+    assert_int_equal(sizeof(uint64_t), value_len);
+    uint64_t total;
+    memcpy(&total, value, sizeof(total));
+    assert_int_equal(5050, total);
+    free(value);
+    assert_int_equal(1, wtree3_tree_count(tree));
+
+    wtree3_tree_close(tree);
+}
+
+static void test_upsert_merge_into_resize(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "merge_into_resize", 0, 0, &error);
+    assert_non_null(tree);
+
+    int calls = 0;
+    wtree3_tree_set_merge_into_fn(tree, merge_into_concat, &calls);
+
+    assert_int_equal(WTREE3_OK, wtree3_upsert(tree, "k", 1, "ab", 2, &error));
+    assert_int_equal(WTREE3_OK, wtree3_upsert(tree, "k", 1, "cde", 3, &error));
+    assert_int_equal(WTREE3_OK, wtree3_upsert(tree, "k", 1, "f", 1, &error));
+
+    /* Growing values: the first reserve is too small, the retry fits */
+    assert_int_equal(4, calls);
+
+    void *value;
+    size_t value_len;
+    assert_int_equal(WTREE3_OK, wtree3_get(tree, "k", 1, &value, &value_len, &error));
+    assert_int_equal(6, value_len);
+    assert_memory_equal("abcdef", value, 6);
+    free(value);
+
+    /* Setting merge_fn replaces the allocation-free callback */
+    wtree3_tree_set_merge_fn(tree, merge_concat, NULL);
+    assert_int_equal(WTREE3_OK, wtree3_upsert(tree, "k", 1, "g", 1, &error));
+    assert_int_equal(4, calls);
+
+    wtree3_tree_close(tree);
+}
+
+static void test_upsert_merge_into_with_index(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "merge_into_idx", 0, 0, &error);
+    assert_non_null(tree);
+
+    wtree3_index_config_t idx_config = {.name = "prefix_idx"};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &idx_config, &error));
+    wtree3_tree_set_merge_into_fn(tree, merge_into_concat, NULL);
+
+    /* Indexed trees merge on the stack, then update index and row together */
+    assert_int_equal(WTREE3_OK, wtree3_upsert(tree, "key1", 4, "ab", 2, &error));
+    assert_int_equal(WTREE3_OK, wtree3_upsert(tree, "key1", 4, "c123", 4, &error));
+
+    wtree3_iterator_t *iter = wtree3_index_seek(tree, "prefix_idx", "abc123", 6, &error);
+    assert_non_null(iter);
+    assert_true(wtree3_iterator_valid(iter));
+    wtree3_iterator_close(iter);
+
+    iter = wtree3_index_seek(tree, "prefix_idx", "ab", 2, &error);
+    assert_non_null(iter);
+    assert_false(wtree3_iterator_valid(iter));
+    wtree3_iterator_close(iter);
+
+    /* Larger than the stack scratch: merged on the heap */
+    char big[600];
+    memset(big, 'z', sizeof(big));
+    assert_int_equal(WTREE3_OK, wtree3_upsert(tree, "key1", 4, big, sizeof(big), &error));
+
+    void *value;
+    size_t value_len;
+    assert_int_equal(WTREE3_OK, wtree3_get(tree, "key1", 4, &value, &value_len, &error));
+    assert_int_equal(6 + sizeof(big), value_len);
+    assert_memory_equal("abc123", value, 6);
+    free(value);
+
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+    wtree3_tree_close(tree);
+}
+
+static void test_upsert_merge_into_failure_keeps_value(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "merge_into_fail", 0, 0, &error);
+    assert_non_null(tree);
+
+    assert_int_equal(WTREE3_OK, wtree3_insert_one(tree, "key1", 4, "original", 8, &error));
+    wtree3_tree_set_merge_into_fn(tree, merge_into_failing, NULL);
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(txn);
+    assert_int_equal(WTREE3_ERROR, wtree3_upsert_txn(txn, tree, "key1", 4, "new", 3, &error));
+
+    /* The txn is still usable and the old value is back in place */
+    assert_int_equal(WTREE3_OK, wtree3_upsert_txn(txn, tree, "key2", 4, "other", 5, &error));
+    assert_int_equal(WTREE3_OK, wtree3_txn_commit(txn, &error));
+
+    void *value;
+    size_t value_len;
+    assert_int_equal(WTREE3_OK, wtree3_get(tree, "key1", 4, &value, &value_len, &error));
+    assert_int_equal(8, value_len);
+    assert_memory_equal("original", value, 8);
+    free(value);
+
+    wtree3_tree_close(tree);
+}
+
+/* Upserting a row onto its own unique index key is not a violation */
+static void test_upsert_unique_index_same_key(void **state) {
+    (void)state;
+    gerror_t error = {0};
+
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "upsert_uniq_same", 0, 0, &error);
+    assert_non_null(tree);
+
+    wtree3_index_config_t idx_config = {.name = "unique_prefix", .unique = true};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &idx_config, &error));
+
+    assert_int_equal(WTREE3_OK, wtree3_insert_one(tree, "key1", 4, "abc123", 6, &error));
+    assert_int_equal(WTREE3_OK, wtree3_upsert(tree, "key1", 4, "abc123", 6, &error));
+
+    void *value;
+    size_t value_len;
+    assert_int_equal(WTREE3_OK, wtree3_get(tree, "key1", 4, &value, &value_len, &error));
+    assert_memory_equal("abc123", value, 6);
+    free(value);
+
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+    wtree3_tree_close(tree);
+}
+
 /* ============================================================
  * Main
  * ============================================================ */
@@ -1022,6 +1233,13 @@ int main(void) {
         cmocka_unit_test(test_upsert_many_error_cases),
         cmocka_unit_test(test_upsert_many_unique_violation),
         cmocka_unit_test(test_upsert_many_counter_batch),
+
+        /* Allocation-free merge tests */
+        cmocka_unit_test(test_upsert_merge_into_counter),
+        cmocka_unit_test(test_upsert_merge_into_resize),
+        cmocka_unit_test(test_upsert_merge_into_with_index),
+        cmocka_unit_test(test_upsert_merge_into_failure_keeps_value),
+        cmocka_unit_test(test_upsert_unique_index_same_key),
     };
 
     return cmocka_run_group_tests(tests, setup_db, teardown_db);
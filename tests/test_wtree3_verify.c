@@ -0,0 +1,445 @@
+/*
+ * test_wtree3_verify.c - Tests for incremental index verification
+ *
+ * Tests that:
+ * - A consistent tree verifies clean in full, parallel and sampled modes
+ * - Rows missing from an index, orphaned entries and duplicate unique
+ *   keys are each reported once through the callback, in every mode
+ * - A walk stopped by max_rows or by the callback resumes from its
+ *   checkpoint without skipping or repeating rows
+ * - Sampling extrapolates the mismatch rate to the whole tree
+ * - Throttled walks honour their row rate and still see everything
+ * - wtree3_verify_indexes() stops at the first mismatch
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+    #include <process.h>
+    #define mkdir(path, mode) _mkdir(path)
+    #define getpid() _getpid()
+#else
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "wtree3.h"
+#include "wthread.h"
+
+/* Test database path */
+static char test_db_path[256];
+static wtree3_db_t *test_db = NULL;
+
+static bool prefix_extractor(const void *value, size_t value_len,
+                             void *user_data,
+                             void **out_key, size_t *out_len);
+
+/* ============================================================
+ * Test Fixtures
+ * ============================================================ */
+
+static int setup_db(void **state) {
+    (void)state;
+
+#ifdef _WIN32
+    snprintf(test_db_path, sizeof(test_db_path), "%s\\test_wtree3_verify_%d",
+             getenv("TEMP"), getpid());
+#else
+    snprintf(test_db_path, sizeof(test_db_path), "/tmp/test_wtree3_verify_%d", getpid());
+#endif
+    mkdir(test_db_path, 0755);
+
+    gerror_t error = {0};
+    test_db = wtree3_db_open(test_db_path, 128 * 1024 * 1024, 128, WTREE3_VERSION(1, 0), 0, &error);
+    if (!test_db) {
+        fprintf(stderr, "Failed to create test database: %s\n", error.message);
+        return -1;
+    }
+
+    for (uint32_t flags = 0; flags <= 0x03; flags++) {
+        int rc = wtree3_db_register_key_extractor(test_db, WTREE3_VERSION(1, 0), flags,
+                                                  prefix_extractor, &error);
+        if (rc != WTREE3_OK) {
+            fprintf(stderr, "Failed to register extractor for flags=0x%02x: %s\n", flags, error.message);
+            wtree3_db_close(test_db);
+            test_db = NULL;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int teardown_db(void **state) {
+    (void)state;
+
+    if (test_db) {
+        wtree3_db_close(test_db);
+        test_db = NULL;
+    }
+
+    char cmd[512];
+#ifdef _WIN32
+    snprintf(cmd, sizeof(cmd), "rd /s /q \"%s\"", test_db_path);
+#else
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", test_db_path);
+#endif
+    (void)system(cmd);
+
+    return 0;
+}
+
+/* Index the value up to its first '|' (the whole value if there is none) */
+static bool prefix_extractor(const void *value, size_t value_len,
+                             void *user_data,
+                             void **out_key, size_t *out_len) {
+    (void)user_data;
+    const char *bar = memchr(value, '|', value_len);
+    size_t len = bar ? (size_t)(bar - (const char *)value) : value_len;
+    if (len == 0) return false;
+
+    char *key = malloc(len);
+    if (!key) return false;
+
+    memcpy(key, value, len);
+    *out_key = key;
+    *out_len = len;
+    return true;
+}
+
+/* ============================================================
+ * Helpers
+ * ============================================================ */
+
+#define ROWS 5000
+
+/* Rows "k:00000".."k:NNNNN" indexed by group (non-unique) and by id (unique) */
+static wtree3_tree_t *create_tree(const char *name, int rows) {
+    gerror_t error = {0};
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, name, 0, 0, &error);
+    assert_non_null(tree);
+
+    wtree3_index_config_t group = {.name = "group_idx"};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &group, &error));
+
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(txn);
+    for (int i = 0; i < rows; i++) {
+        char key[16], value[32];
+        snprintf(key, sizeof(key), "k:%05d", i);
+        int len = snprintf(value, sizeof(value), "g%02d|payload-%d", i % 37, i);
+        assert_int_equal(WTREE3_OK, wtree3_insert_one_txn(txn, tree, key, strlen(key),
+                                                          value, (size_t)len, &error));
+    }
+    assert_int_equal(WTREE3_OK, wtree3_txn_commit(txn, &error));
+    return tree;
+}
+
+/* Write straight to LMDB, behind the indexes' back */
+static void raw_write(const char *dbi_name, const char *key, const char *value) {
+    gerror_t error = {0};
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(txn);
+
+    MDB_txn *mtxn = wtree3_txn_get_mdb(txn);
+    MDB_dbi dbi;
+    assert_int_equal(0, mdb_dbi_open(mtxn, dbi_name, 0, &dbi));
+    MDB_val k = {.mv_size = strlen(key), .mv_data = (void *)key};
+    if (value) {
+        MDB_val v = {.mv_size = strlen(value), .mv_data = (void *)value};
+        assert_int_equal(0, mdb_put(mtxn, dbi, &k, &v, 0));
+    } else {
+        assert_int_equal(0, mdb_del(mtxn, dbi, &k, NULL));
+    }
+    assert_int_equal(WTREE3_OK, wtree3_txn_commit(txn, &error));
+}
+
+/* 4 rows deleted (orphans in group_idx) and 3 rows the index never saw */
+static void corrupt(const char *name) {
+    raw_write(name, "k:00010", NULL);
+    raw_write(name, "k:01234", NULL);
+    raw_write(name, "k:02500", NULL);
+    raw_write(name, "k:04999", NULL);
+    raw_write(name, "x:1", "zz1|hidden");
+    raw_write(name, "x:2", "zz2|hidden");
+    raw_write(name, "x:3", "zz3|hidden");
+}
+
+typedef struct {
+    wmutex_t lock;
+    int kinds[WTREE3_VERIFY_DUPLICATE + 1];
+    int total;
+    int stop_after;                 /* Return false after this many (0 = never) */
+} mismatches_t;
+
+static bool collect(const wtree3_verify_mismatch_t *m, void *user_data) {
+    mismatches_t *c = (mismatches_t *)user_data;
+    wmutex_lock(&c->lock);
+    assert_string_equal(m->index_name, m->kind == WTREE3_VERIFY_DUPLICATE ? "id_idx" : "group_idx");
+    if (m->kind == WTREE3_VERIFY_ORPHAN) {
+        assert_non_null(m->pk);
+        assert_memory_equal(m->pk, "k:", 2);
+    }
+    c->kinds[m->kind]++;
+    c->total++;
+    bool go_on = c->stop_after == 0 || c->total < c->stop_after;
+    wmutex_unlock(&c->lock);
+    return go_on;
+}
+
+static void init_collect(mismatches_t *c) {
+    memset(c, 0, sizeof(*c));
+    assert_int_equal(0, wmutex_init(&c->lock));
+}
+
+/* ============================================================
+ * Tests
+ * ============================================================ */
+
+static void test_verify_clean(void **state) {
+    (void)state;
+    gerror_t error = {0};
+    wtree3_tree_t *tree = create_tree("v_clean", ROWS);
+
+    wtree3_verify_report_t report;
+    wtree3_verify_opts_t opts = {.check_orphans = true};
+    assert_int_equal(WTREE3_OK, wtree3_tree_verify(tree, &opts, &report, &error));
+    assert_true(report.complete);
+    assert_int_equal(report.rows_checked, ROWS);
+    assert_int_equal(report.entries_checked, ROWS);
+    assert_int_equal(report.total_rows, ROWS);
+    assert_int_equal(report.mismatches, 0);
+
+    opts.threads = 4;
+    assert_int_equal(WTREE3_OK, wtree3_tree_verify(tree, &opts, &report, &error));
+    assert_true(report.complete);
+    assert_int_equal(report.rows_checked, ROWS);
+    assert_int_equal(report.entries_checked, ROWS);
+
+    wtree3_verify_opts_t sampled = {.sample_rows = 200, .seed = 7, .check_orphans = true};
+    assert_int_equal(WTREE3_OK, wtree3_tree_verify(tree, &sampled, &report, &error));
+    assert_int_equal(report.rows_checked, 200);
+    assert_int_equal(report.entries_checked, 200);
+    assert_int_equal(report.est_mismatches, 0);
+
+    /* Defaults: row pass only */
+    assert_int_equal(WTREE3_OK, wtree3_tree_verify(tree, NULL, &report, &error));
+    assert_int_equal(report.entries_checked, 0);
+    assert_int_equal(WTREE3_OK, wtree3_verify_indexes(tree, &error));
+
+    assert_int_equal(WTREE3_EINVAL, wtree3_tree_verify(NULL, NULL, NULL, &error));
+    wtree3_tree_close(tree);
+}
+
+static void test_verify_reports_mismatches(void **state) {
+    (void)state;
+    gerror_t error = {0};
+    wtree3_tree_t *tree = create_tree("v_bad", ROWS);
+    corrupt("v_bad");
+
+    for (unsigned int threads = 1; threads <= 4; threads += 3) {
+        mismatches_t seen;
+        init_collect(&seen);
+        wtree3_verify_report_t report;
+        wtree3_verify_opts_t opts = {
+            .threads = threads,
+            .check_orphans = true,
+            .on_mismatch = collect,
+            .user_data = &seen,
+        };
+        assert_int_equal(WTREE3_INDEX_ERROR, wtree3_tree_verify(tree, &opts, &report, &error));
+        assert_non_null(strstr(error.message, "group_idx"));
+        assert_true(report.complete);
+        assert_int_equal(report.rows_checked, ROWS - 4 + 3);
+        assert_int_equal(report.entries_checked, ROWS);
+        assert_int_equal(report.mismatches, 7);
+        assert_int_equal(seen.kinds[WTREE3_VERIFY_MISSING], 3);
+        assert_int_equal(seen.kinds[WTREE3_VERIFY_ORPHAN], 4);
+        wmutex_destroy(&seen.lock);
+    }
+
+    /* The classic check stops at the first one */
+    assert_int_equal(WTREE3_INDEX_ERROR, wtree3_verify_indexes(tree, &error));
+    assert_non_null(strstr(error.message, "missing entry"));
+    wtree3_tree_close(tree);
+}
+
+static void test_verify_unique_duplicates(void **state) {
+    (void)state;
+    gerror_t error = {0};
+    wtree3_tree_t *tree = wtree3_tree_open(test_db, "v_unique", 0, 0, &error);
+    assert_non_null(tree);
+    wtree3_index_config_t cfg = {.name = "id_idx", .unique = true};
+    assert_int_equal(WTREE3_OK, wtree3_tree_add_index(tree, &cfg, &error));
+
+    assert_int_equal(WTREE3_OK, wtree3_insert_one(tree, "a", 1, "id1", 3, &error));
+    assert_int_equal(WTREE3_OK, wtree3_insert_one(tree, "b", 1, "id2", 3, &error));
+    assert_int_equal(WTREE3_OK, wtree3_insert_one(tree, "c", 1, "id3", 3, &error));
+
+    /* A second entry under id1 pointing at row "b"; the index DB keeps dups */
+    raw_write("idx:v_unique:id_idx", "id1", "b");
+
+    mismatches_t seen;
+    init_collect(&seen);
+    wtree3_verify_report_t report;
+    wtree3_verify_opts_t opts = {.check_orphans = true, .on_mismatch = collect, .user_data = &seen};
+    assert_int_equal(WTREE3_INDEX_ERROR, wtree3_tree_verify(tree, &opts, &report, &error));
+    assert_int_equal(seen.kinds[WTREE3_VERIFY_DUPLICATE], 1);
+    assert_int_equal(seen.total, 1);
+    assert_int_equal(report.entries_checked, 4);
+
+    assert_int_equal(WTREE3_INDEX_ERROR, wtree3_verify_indexes(tree, &error));
+    assert_non_null(strstr(error.message, "unique constraint"));
+    wmutex_destroy(&seen.lock);
+    wtree3_tree_close(tree);
+}
+
+static void test_verify_checkpoint_resume(void **state) {
+    (void)state;
+    gerror_t error = {0};
+    wtree3_tree_t *tree = create_tree("v_resume", ROWS);
+    corrupt("v_resume");
+
+    mismatches_t seen;
+    init_collect(&seen);
+    wtree3_verify_checkpoint_t cp = {0};
+    wtree3_verify_report_t report;
+    wtree3_verify_opts_t opts = {
+        .check_orphans = true,
+        .chunk_rows = 128,
+        .max_rows = 700,
+        .resume = &cp,
+        .checkpoint = &cp,
+        .on_mismatch = collect,
+        .user_data = &seen,
+    };
+
+    /* A background job: a bounded slice per run, continuing where the last stopped */
+    uint64_t rows = 0, entries = 0;
+    int runs = 0;
+    do {
+        int rc = wtree3_tree_verify(tree, &opts, &report, &error);
+        assert_true(rc == WTREE3_OK || rc == WTREE3_INDEX_ERROR);
+        assert_true(report.rows_checked + report.entries_checked <= 700);
+        rows += report.rows_checked;
+        entries += report.entries_checked;
+        assert_int_equal(cp.active, !report.complete);
+        runs++;
+    } while (!report.complete && runs < 100);
+
+    assert_true(report.complete);
+    assert_int_equal(runs, (2 * ROWS - 1 + 699) / 700);
+    assert_int_equal(rows, ROWS - 4 + 3);
+    assert_int_equal(entries, ROWS);
+    assert_int_equal(seen.kinds[WTREE3_VERIFY_MISSING], 3);
+    assert_int_equal(seen.kinds[WTREE3_VERIFY_ORPHAN], 4);
+
+    /* Stopping from the callback leaves a checkpoint just past the mismatch */
+    init_collect(&seen);
+    seen.stop_after = 1;
+    opts.max_rows = 0;
+    opts.chunk_rows = 0;
+    assert_int_equal(WTREE3_INDEX_ERROR, wtree3_tree_verify(tree, &opts, &report, &error));
+    assert_false(report.complete);
+    assert_true(cp.active);
+    assert_int_equal(seen.total, 1);
+
+    seen.stop_after = 0;
+    assert_int_equal(WTREE3_INDEX_ERROR, wtree3_tree_verify(tree, &opts, &report, &error));
+    assert_true(report.complete);
+    assert_false(cp.active);
+    assert_int_equal(seen.total, 7);
+    wmutex_destroy(&seen.lock);
+    wtree3_tree_close(tree);
+}
+
+static void test_verify_sampled(void **state) {
+    (void)state;
+    gerror_t error = {0};
+    wtree3_tree_t *tree = create_tree("v_sampled", 2000);
+
+    /* 500 hidden rows: a fifth of the tree is missing from the index */
+    wtree3_txn_t *txn = wtree3_txn_begin(test_db, true, &error);
+    assert_non_null(txn);
+    MDB_txn *mtxn = wtree3_txn_get_mdb(txn);
+    MDB_dbi dbi;
+    assert_int_equal(0, mdb_dbi_open(mtxn, "v_sampled", 0, &dbi));
+    for (int i = 0; i < 500; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "k:%05d~", i * 4);
+        MDB_val k = {.mv_size = strlen(key), .mv_data = key};
+        MDB_val v = {.mv_size = 10, .mv_data = "zz|hidden!"};
+        assert_int_equal(0, mdb_put(mtxn, dbi, &k, &v, 0));
+    }
+    assert_int_equal(WTREE3_OK, wtree3_txn_commit(txn, &error));
+
+    for (int analyzed = 0; analyzed <= 1; analyzed++) {
+        if (analyzed) assert_int_equal(WTREE3_OK, wtree3_tree_analyze(tree, &error));
+
+        wtree3_verify_report_t report;
+        wtree3_verify_opts_t opts = {.sample_rows = 400, .seed = 42};
+        assert_int_equal(WTREE3_INDEX_ERROR, wtree3_tree_verify(tree, &opts, &report, &error));
+        assert_int_equal(report.rows_checked, 400);
+        assert_int_equal(report.total_rows, 2500);
+        assert_true(report.mismatches > 0 && report.mismatches < 400);
+        /* 500 expected; binomial noise at n = 400 is well inside this */
+        assert_in_range(report.est_mismatches, 250, 750);
+    }
+    wtree3_tree_close(tree);
+}
+
+static void test_verify_throttled(void **state) {
+    (void)state;
+    gerror_t error = {0};
+    wtree3_tree_t *tree = create_tree("v_throttled", 2000);
+
+    wtree3_verify_report_t report;
+    wtree3_verify_opts_t opts = {
+        .check_orphans = true,
+        .chunk_rows = 100,
+        .rows_per_sec = 20000,
+        .bytes_per_sec = 1024 * 1024 * 1024,
+        .drop_pages = true,
+    };
+    uint64_t t0 = wtime_now_us();
+    assert_int_equal(WTREE3_OK, wtree3_tree_verify(tree, &opts, &report, &error));
+    uint64_t elapsed = wtime_now_us() - t0;
+
+    assert_true(report.complete);
+    assert_int_equal(report.rows_checked, 2000);
+    assert_int_equal(report.entries_checked, 2000);
+    /* 4000 checks at 20000/s: the last chunk's sleep is skipped, so >= 190 ms */
+    assert_true(elapsed >= 150000);
+
+    /* Throttling and page hints apply to sampling too */
+    opts.sample_rows = 300;
+    opts.rows_per_sec = 0;
+    assert_int_equal(WTREE3_OK, wtree3_tree_verify(tree, &opts, &report, &error));
+    assert_int_equal(report.rows_checked, 300);
+    wtree3_tree_close(tree);
+}
+
+/* ============================================================
+ * Main
+ * ============================================================ */
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_verify_clean),
+        cmocka_unit_test(test_verify_reports_mismatches),
+        cmocka_unit_test(test_verify_unique_duplicates),
+        cmocka_unit_test(test_verify_checkpoint_resume),
+        cmocka_unit_test(test_verify_sampled),
+        cmocka_unit_test(test_verify_throttled),
+    };
+
+    return cmocka_run_group_tests(tests, setup_db, teardown_db);
+}